@@ -0,0 +1,211 @@
+/*
+    ChibiOS - Copyright (C) 2006..2018 Giovanni Di Sirio
+
+    Licensed under the Apache License, Version 2.0 (the "License");
+    you may not use this file except in compliance with the License.
+    You may obtain a copy of the License at
+
+        http://www.apache.org/licenses/LICENSE-2.0
+
+    Unless required by applicable law or agreed to in writing, software
+    distributed under the License is distributed on an "AS IS" BASIS,
+    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+    See the License for the specific language governing permissions and
+    limitations under the License.
+*/
+
+#include "ch.h"
+#include "hal.h"
+#include "nbuf.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+
+/*===========================================================================*/
+/* NBuf related.                                                             */
+/*===========================================================================*/
+
+#define READERS_NUM         3
+#define BUFFERS_NUM         (READERS_NUM + 2)
+#define FRAME_WORDS         64
+
+#define WRITER_PERIOD_MS    1
+#define READER_HOLD_MS      3
+
+#define READER_STACK_SIZE   4096
+#define READER_PRIORITY     (NORMALPRIO + 1)
+
+#define LATENCY_LOOPS       10000000
+
+static nbuf_t nbuf;
+static uint32_t frames[BUFFERS_NUM][FRAME_WORDS];
+
+static virtual_timer_t writer_vt;
+static uint32_t writer_seq;
+static uint32_t start_seq;
+
+static THD_WORKING_AREA(reader_wa[READERS_NUM], READER_STACK_SIZE);
+
+static volatile uint32_t reads[READERS_NUM];
+static volatile uint32_t fresh[READERS_NUM];
+static volatile uint32_t torn;
+
+/*
+ * Frame content, every word depends on the sequence number.
+ */
+static uint32_t frame_word(uint32_t seq, size_t i) {
+
+  return (seq * 2654435761U) ^ (uint32_t)i;
+}
+
+/*
+ * Fills the back buffer and publishes it, from the virtual timer callback
+ * so the producer runs in interrupt context.
+ */
+static void writer_cb(void *arg) {
+
+  uint32_t *back;
+  size_t i;
+
+  (void)arg;
+
+  back = (uint32_t *)nbufGetBackX(&nbuf);
+  writer_seq = (writer_seq + 1U) & 0xFFFFFFU;
+  for (i = 0; i < FRAME_WORDS; ++i)
+    back[i] = frame_word(writer_seq, i);
+  nbufSwapBackX(&nbuf);
+
+  chSysLockFromISR();
+  chVTSetI(&writer_vt, TIME_MS2I(WRITER_PERIOD_MS), writer_cb, NULL);
+  chSysUnlockFromISR();
+}
+
+/*
+ * Reads the latest frame, holding it across several writer periods so the
+ * producer has to skip the pinned buffer.
+ */
+static THD_FUNCTION(reader_thread, arg) {
+
+  const size_t id = (size_t)arg;
+  const uint32_t *front;
+  uint32_t seq, last = 0U;
+  size_t i;
+  bool ok;
+
+  chRegSetThreadName("reader_thread");
+  for (;;) {
+    front = (const uint32_t *)nbufAcquireFrontX(&nbuf, &seq);
+    chThdSleepMilliseconds(READER_HOLD_MS + id);
+    ok = true;
+    for (i = 0; i < FRAME_WORDS; ++i)
+      ok = ok && (front[i] == frame_word(seq, i));
+    nbufReleaseFrontX(&nbuf, front);
+
+    /* The front buffer left by the latency loop holds no frame.*/
+    if (seq != start_seq) {
+      if (!ok)
+        torn++;
+      if (seq != last)
+        fresh[id]++;
+    }
+    last = seq;
+    reads[id]++;
+  }
+}
+
+/*
+ * Measures the cost of the lock-free calls, without contention.
+ */
+static void measure_latency(void) {
+
+  systime_t start;
+  sysinterval_t elapsed;
+  const void *front;
+  uint32_t i;
+
+  start = chVTGetSystemTimeX();
+  for (i = 0; i < LATENCY_LOOPS; ++i)
+    nbufSwapBackX(&nbuf);
+  elapsed = chVTTimeElapsedSinceX(start);
+  printf("swap back: %.1f ns\n",
+         (double)TIME_I2US(elapsed) * 1000.0 / LATENCY_LOOPS);
+
+  start = chVTGetSystemTimeX();
+  for (i = 0; i < LATENCY_LOOPS; ++i) {
+    front = nbufAcquireFrontX(&nbuf, NULL);
+    nbufReleaseFrontX(&nbuf, front);
+  }
+  elapsed = chVTTimeElapsedSinceX(start);
+  printf("acquire + release front: %.1f ns\n",
+         (double)TIME_I2US(elapsed) * 1000.0 / LATENCY_LOOPS);
+}
+
+/*===========================================================================*/
+/* Initialization and main thread.                                           */
+/*===========================================================================*/
+
+/*
+ * Simulator main.
+ */
+int main(void) {
+
+  void *buffers[BUFFERS_NUM];
+  size_t i;
+
+  /*
+   * System initializations.
+   * - HAL initialization, this also initializes the configured device drivers
+   *   and performs the board-specific initializations.
+   * - Kernel initialization, the main() function becomes a thread and the
+   *   RTOS is active.
+   */
+  halInit();
+  chSysInit();
+
+  for (i = 0; i < BUFFERS_NUM; ++i)
+    buffers[i] = frames[i];
+  nbufObjectInit(&nbuf, buffers, BUFFERS_NUM);
+
+  measure_latency();
+
+  /*
+   * Writer timer and reader threads started for the N-buffer demo, the
+   * latency loop left the sequence number running.
+   */
+  start_seq = nbufGetSequenceX(&nbuf);
+  writer_seq = start_seq;
+  chVTObjectInit(&writer_vt);
+  chVTSet(&writer_vt, TIME_MS2I(WRITER_PERIOD_MS), writer_cb, NULL);
+
+  for (i = 0; i < READERS_NUM; ++i)
+    chThdCreateStatic(reader_wa[i], sizeof(reader_wa[i]),
+                      READER_PRIORITY, reader_thread, (void *)i);
+
+  /*
+   * Prints the statistics, a torn frame stops the demo.
+   */
+  for (;;) {
+    chThdSleepMilliseconds(1000);
+    printf("frames %u", (unsigned)nbufGetSequenceX(&nbuf));
+    for (i = 0; i < READERS_NUM; ++i)
+      printf(", reader %u: %u/%u", (unsigned)i,
+             (unsigned)fresh[i], (unsigned)reads[i]);
+    printf("\n");
+    if (torn != 0U)
+      chSysHalt("ERROR: torn frame");
+  }
+
+  return 0;
+}
+
+/*
+ * Critical error function.
+ */
+void halt(const char *reason) {
+
+  fflush(stdout);
+  fputs("\n", stdout);
+  fputs(reason, stderr);
+  fflush(stderr);
+  exit(1);
+}
@@ -0,0 +1,177 @@
+/*
+    ChibiOS - Copyright (C) 2006..2018 Giovanni Di Sirio
+
+    Licensed under the Apache License, Version 2.0 (the "License");
+    you may not use this file except in compliance with the License.
+    You may obtain a copy of the License at
+
+        http://www.apache.org/licenses/LICENSE-2.0
+
+    Unless required by applicable law or agreed to in writing, software
+    distributed under the License is distributed on an "AS IS" BASIS,
+    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+    See the License for the specific language governing permissions and
+    limitations under the License.
+*/
+
+#ifndef HALCONF_COMMUNITY_H
+#define HALCONF_COMMUNITY_H
+
+/**
+ * @brief   Enables the community overlay.
+ */
+#if !defined(HAL_USE_COMMUNITY) || defined(__DOXYGEN__)
+#define HAL_USE_COMMUNITY           TRUE
+#endif
+
+/**
+ * @brief   Enables the FSMC subsystem.
+ */
+#if !defined(HAL_USE_FSMC) || defined(__DOXYGEN__)
+#define HAL_USE_FSMC                FALSE
+#endif
+
+/**
+ * @brief   Enables the SDRAM subsystem.
+ */
+#if !defined(HAL_USE_SDRAM) || defined(__DOXYGEN__)
+#define HAL_USE_SDRAM               FALSE
+#endif
+
+/**
+ * @brief   Enables the SRAM subsystem.
+ */
+#if !defined(HAL_USE_SRAM) || defined(__DOXYGEN__)
+#define HAL_USE_SRAM                FALSE
+#endif
+
+/**
+ * @brief   Enables the NAND subsystem.
+ */
+#if !defined(HAL_USE_NAND) || defined(__DOXYGEN__)
+#define HAL_USE_NAND                FALSE
+#endif
+
+/**
+ * @brief   Enables the 1-wire subsystem.
+ */
+#if !defined(HAL_USE_ONEWIRE) || defined(__DOXYGEN__)
+#define HAL_USE_ONEWIRE             FALSE
+#endif
+
+/**
+ * @brief   Enables the EICU subsystem.
+ */
+#if !defined(HAL_USE_EICU) || defined(__DOXYGEN__)
+#define HAL_USE_EICU                FALSE
+#endif
+
+/**
+ * @brief   Enables the CRC subsystem.
+ */
+#if !defined(HAL_USE_CRC) || defined(__DOXYGEN__)
+#define HAL_USE_CRC                 FALSE
+#endif
+
+/**
+ * @brief   Enables the RNG subsystem.
+ */
+#if !defined(HAL_USE_RNG) || defined(__DOXYGEN__)
+#define HAL_USE_RNG                 FALSE
+#endif
+
+/**
+ * @brief   Enables the EEPROM subsystem.
+ */
+#if !defined(HAL_USE_EEPROM) || defined(__DOXYGEN__)
+#define HAL_USE_EEPROM              FALSE
+#endif
+
+/**
+ * @brief   Enables the TIMCAP subsystem.
+ */
+#if !defined(HAL_USE_TIMCAP) || defined(__DOXYGEN__)
+#define HAL_USE_TIMCAP              FALSE
+#endif
+
+/**
+ * @brief   Enables the COMP subsystem.
+ */
+#if !defined(HAL_USE_COMP) || defined(__DOXYGEN__)
+#define HAL_USE_COMP                FALSE
+#endif
+
+/**
+ * @brief   Enables the QEI subsystem.
+ */
+#if !defined(HAL_USE_QEI) || defined(__DOXYGEN__)
+#define HAL_USE_QEI                 FALSE
+#endif
+
+/**
+ * @brief   Enables the USBH subsystem.
+ */
+#if !defined(HAL_USE_USBH) || defined(__DOXYGEN__)
+#define HAL_USE_USBH                TRUE
+#endif
+
+/**
+ * @brief   Enables the USB_MSD subsystem.
+ */
+#if !defined(HAL_USE_USB_MSD) || defined(__DOXYGEN__)
+#define HAL_USE_USB_MSD             FALSE
+#endif
+
+/*===========================================================================*/
+/* USBH driver related settings.                                             */
+/*===========================================================================*/
+
+/* main driver */
+#define HAL_USBH_PORT_DEBOUNCE_TIME                   200
+#define HAL_USBH_PORT_RESET_TIMEOUT                   500
+#define HAL_USBH_DEVICE_ADDRESS_STABILIZATION         20
+#define HAL_USBH_CONTROL_REQUEST_DEFAULT_TIMEOUT      OSAL_MS2I(1000)
+#define HAL_USBH_USE_MAIN_THREAD                      FALSE
+#if !defined(HAL_USBH_USE_PARALLEL_ENUMERATION)
+#define HAL_USBH_USE_PARALLEL_ENUMERATION             TRUE
+#endif
+
+/* class drivers, the scripted device is vendor specific */
+#define HAL_USBH_USE_MSD                              FALSE
+#define HAL_USBH_USE_FTDI                             FALSE
+#define HAL_USBH_USE_AOA                              FALSE
+#define HAL_USBH_USE_UVC                              FALSE
+#define HAL_USBH_USE_HID                              FALSE
+#define HAL_USBH_USE_ADDITIONAL_CLASS_DRIVERS         FALSE
+
+/* HUB */
+#define HAL_USBH_USE_HUB                              TRUE
+
+#define HAL_USBHHUB_MAX_INSTANCES                     1
+#define HAL_USBHHUB_MAX_PORTS                         7
+
+/* simulated host controller */
+#define SIM_USBH_USE_USBH1                            TRUE
+
+/* debug, not supported by the simulated host controller */
+#define USBH_DEBUG_ENABLE                             FALSE
+#define USBH_DEBUG_MULTI_HOST                         FALSE
+
+#define USBH_DEBUG_ENABLE_TRACE                       FALSE
+#define USBH_DEBUG_ENABLE_INFO                        FALSE
+#define USBH_DEBUG_ENABLE_WARNINGS                    FALSE
+#define USBH_DEBUG_ENABLE_ERRORS                      FALSE
+
+#define USBH_LLD_DEBUG_ENABLE_TRACE                   FALSE
+#define USBH_LLD_DEBUG_ENABLE_INFO                    FALSE
+#define USBH_LLD_DEBUG_ENABLE_WARNINGS                FALSE
+#define USBH_LLD_DEBUG_ENABLE_ERRORS                  FALSE
+
+#define USBHHUB_DEBUG_ENABLE_TRACE                    FALSE
+#define USBHHUB_DEBUG_ENABLE_INFO                     FALSE
+#define USBHHUB_DEBUG_ENABLE_WARNINGS                 FALSE
+#define USBHHUB_DEBUG_ENABLE_ERRORS                   FALSE
+
+#endif /* HALCONF_COMMUNITY_H */
+
+/** @} */
@@ -0,0 +1,257 @@
+/*
+    ChibiOS - Copyright (C) 2006..2018 Giovanni Di Sirio
+
+    Licensed under the Apache License, Version 2.0 (the "License");
+    you may not use this file except in compliance with the License.
+    You may obtain a copy of the License at
+
+        http://www.apache.org/licenses/LICENSE-2.0
+
+    Unless required by applicable law or agreed to in writing, software
+    distributed under the License is distributed on an "AS IS" BASIS,
+    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+    See the License for the specific language governing permissions and
+    limitations under the License.
+*/
+
+#include "ch.h"
+#include "hal.h"
+#include "usbh/dev/hub.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+
+/*===========================================================================*/
+/* Scripted device related.                                                  */
+/*===========================================================================*/
+
+/*
+ * Vendor specific device without endpoints, no class driver claims it so
+ * it stays configured and idle.
+ */
+static const uint8_t dev_device_descriptor[] = {
+  18, USBH_DT_DEVICE,
+  0x00, 0x02,                               /* bcdUSB */
+  0xFF, 0x00, 0x00, 64,
+  0x83, 0x04,                               /* idVendor */
+  0x40, 0x57,                               /* idProduct */
+  0x00, 0x01,                               /* bcdDevice */
+  1, 2, 0, 1
+};
+
+static const uint8_t dev_config_descriptor[] = {
+  9, USBH_DT_CONFIG, 18, 0, 1, 1, 0, 0x80, 50,
+  9, USBH_DT_INTERFACE, 0, 0, 0, 0xFF, 0x00, 0x00, 0
+};
+
+static const char *const dev_strings[] = {"ChibiOS", "Simulated device"};
+
+static usbhsim_response_t dev_control(usbhsim_device_t *sdp,
+                                      const usbh_control_request_t *req,
+                                      uint8_t *buf, uint32_t *len) {
+
+  (void)sdp;
+  (void)req;
+  (void)buf;
+  (void)len;
+  return USBHSIM_STALL;
+}
+
+static usbhsim_response_t dev_transfer(usbhsim_device_t *sdp, uint8_t ep,
+                                       uint8_t *buf, uint32_t len,
+                                       uint32_t *actual) {
+
+  (void)sdp;
+  (void)ep;
+  (void)buf;
+  (void)len;
+  (void)actual;
+  return USBHSIM_STALL;
+}
+
+static const usbhsim_config_t dev_config = {
+  USBH_DEVSPEED_FULL,
+  dev_device_descriptor,
+  dev_config_descriptor,
+  dev_strings, 2,
+  dev_control,
+  dev_transfer
+};
+
+/*===========================================================================*/
+/* Hub related.                                                              */
+/*===========================================================================*/
+
+#define HUB_PORTS           HAL_USBHHUB_MAX_PORTS
+#define ENUM_TIMEOUT_MS     30000
+#define BENCH_TRIALS        4
+
+static usbhsim_hub_t hub;
+static usbhsim_device_t devices[HUB_PORTS];
+
+static const char *const speeds[] = {"low", "full", "high"};
+
+/*
+ * Devices configured behind the hub, zero while the hub driver is not
+ * loaded.
+ */
+static unsigned configured(void) {
+
+  usbh_port_t *port;
+  unsigned n = 0;
+
+  if (USBHHUBD[0].dev == NULL)
+    return 0;
+  for (port = USBHHUBD[0].ports; port != NULL; port = port->next) {
+    if (port->device.status == USBH_DEVSTATUS_CONFIGURED)
+      n++;
+  }
+  return n;
+}
+
+/*
+ * Runs the host main loop until n devices are configured behind the hub,
+ * returns the milliseconds it took.
+ */
+static unsigned wait_configured(unsigned n) {
+
+  systime_t start = chVTGetSystemTimeX();
+
+  while (configured() != n) {
+    if (chVTTimeElapsedSinceX(start) > TIME_MS2I(ENUM_TIMEOUT_MS))
+      chSysHalt("ERROR: enumeration timeout");
+    usbhMainLoop(&USBHD1);
+    chThdSleepMilliseconds(1);
+  }
+  return (unsigned)TIME_I2MS(chVTTimeElapsedSinceX(start));
+}
+
+/*
+ * Runs the host main loop until the hub driver is unloaded.
+ */
+static void wait_unloaded(void) {
+
+  while (USBHHUBD[0].dev != NULL) {
+    usbhMainLoop(&USBHD1);
+    chThdSleepMilliseconds(1);
+  }
+}
+
+static void print_device(const char *name, const usbh_device_t *dev) {
+
+  printf("%s: %04x:%04x, address %u, %s speed\n", name,
+         dev->devDesc.idVendor, dev->devDesc.idProduct,
+         dev->address, speeds[dev->speed]);
+}
+
+static void print_tree(void) {
+
+  usbh_port_t *port;
+  char name[16];
+
+  print_device("root port", USBHHUBD[0].dev);
+  for (port = USBHHUBD[0].ports; port != NULL; port = port->next) {
+    if (port->device.status != USBH_DEVSTATUS_CONFIGURED)
+      continue;
+    snprintf(name, sizeof(name), "  hub port %u", port->number);
+    print_device(name, &port->device);
+  }
+}
+
+/*
+ * Time from the hub attach to every port enumerated, with a device on
+ * each of the ports.
+ */
+static void hub_benchmark(void) {
+
+  unsigned i, ms, min = ~0U, max = 0, sum = 0;
+
+  for (i = 1; i < HUB_PORTS; ++i)
+    usbhsimHubAttach(&hub, i + 1, &devices[i]);
+
+  for (i = 0; i < BENCH_TRIALS; ++i) {
+    usbhsimDetach(&USBHD1);
+    wait_unloaded();
+    usbhsimAttach(&USBHD1, usbhsimHubGetDevice(&hub));
+    ms = wait_configured(HUB_PORTS);
+    if (ms < min)
+      min = ms;
+    if (ms > max)
+      max = ms;
+    sum += ms;
+  }
+
+  printf("%u port hub, parallel enumeration %s: %u/%u/%u ms "
+         "(min/avg/max of %u)\n", HUB_PORTS,
+         HAL_USBH_USE_PARALLEL_ENUMERATION ? "on" : "off",
+         min, sum / BENCH_TRIALS, max, BENCH_TRIALS);
+}
+
+/*===========================================================================*/
+/* Initialization and main thread.                                           */
+/*===========================================================================*/
+
+/*
+ * Simulator main.
+ */
+int main(void) {
+
+  const usbhsim_stats_t *stats;
+  unsigned i;
+
+  /*
+   * System initializations.
+   * - HAL initialization, this also initializes the configured device drivers
+   *   and performs the board-specific initializations.
+   * - Kernel initialization, the main() function becomes a thread and the
+   *   RTOS is active.
+   */
+  halInit();
+  chSysInit();
+
+  usbhStart(&USBHD1);
+  usbhsimHubObjectInit(&hub, USBH_DEVSPEED_FULL, HUB_PORTS);
+  for (i = 0; i < HUB_PORTS; ++i)
+    usbhsimDeviceObjectInit(&devices[i], &dev_config, NULL);
+
+  /*
+   * The built-in hub with one device, attached to the root port.
+   */
+  usbhsimHubAttach(&hub, 1, &devices[0]);
+  usbhsimAttach(&USBHD1, usbhsimHubGetDevice(&hub));
+  printf("hub and device enumerated in %u ms\n", wait_configured(1));
+  print_tree();
+
+  /*
+   * Hub timing benchmark, the other ports filled.
+   */
+  hub_benchmark();
+  print_tree();
+
+  stats = usbhsimGetStats(&USBHD1);
+  printf("%u frames, %u transactions, %u NAKs, %u URBs\n",
+         (unsigned)stats->frames, (unsigned)stats->transactions,
+         (unsigned)stats->naks, (unsigned)stats->urbs);
+
+  /*
+   * Normal main() thread activity, the host keeps serving the hub.
+   */
+  for (;;) {
+    usbhMainLoop(&USBHD1);
+    chThdSleepMilliseconds(100);
+  }
+
+  return 0;
+}
+
+/*
+ * Critical error function.
+ */
+void halt(const char *reason) {
+
+  fflush(stdout);
+  fputs("\n", stdout);
+  fputs(reason, stderr);
+  fflush(stderr);
+  exit(1);
+}
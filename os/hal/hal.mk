@@ -24,6 +24,7 @@ HALSRC_CONTRIB += ${CHIBIOS_CONTRIB}/os/hal/src/hal_sdram.c
 endif
 ifneq ($(findstring HAL_USE_ONEWIRE TRUE,$(HALCONF)),)
 HALSRC_CONTRIB += ${CHIBIOS_CONTRIB}/os/hal/src/hal_onewire.c
+HALSRC_CONTRIB += ${CHIBIOS_CONTRIB}/os/hal/src/hal_onewire_sweep.c
 endif
 ifneq ($(findstring HAL_USE_EICU TRUE,$(HALCONF)),)
 HALSRC_CONTRIB += ${CHIBIOS_CONTRIB}/os/hal/src/hal_eicu.c
@@ -63,6 +64,9 @@ endif
 ifneq ($(findstring EEPROM_USE_EE24XX TRUE,$(HALCONF)),)
 HALSRC_CONTRIB += ${CHIBIOS_CONTRIB}/os/hal/src/hal_ee24xx.c
 endif
+ifneq ($(findstring EEPROM_USE_EEFLASH TRUE,$(HALCONF)),)
+HALSRC_CONTRIB += ${CHIBIOS_CONTRIB}/os/hal/src/hal_eeflash.c
+endif
 endif
 ifneq ($(findstring HAL_USE_TIMCAP TRUE,$(HALCONF)),)
 HALSRC_CONTRIB += ${CHIBIOS_CONTRIB}/os/hal/src/hal_timcap.c
@@ -89,6 +93,7 @@ HALSRC_CONTRIB := ${CHIBIOS_CONTRIB}/os/hal/src/hal_community.c \
                   ${CHIBIOS_CONTRIB}/os/hal/src/hal_sram.c \
                   ${CHIBIOS_CONTRIB}/os/hal/src/hal_sdram.c \
                   ${CHIBIOS_CONTRIB}/os/hal/src/hal_onewire.c \
+                  ${CHIBIOS_CONTRIB}/os/hal/src/hal_onewire_sweep.c \
                   ${CHIBIOS_CONTRIB}/os/hal/src/hal_eicu.c \
                   ${CHIBIOS_CONTRIB}/os/hal/src/hal_crc.c \
                   ${CHIBIOS_CONTRIB}/os/hal/src/hal_rng.c \
@@ -103,6 +108,7 @@ HALSRC_CONTRIB := ${CHIBIOS_CONTRIB}/os/hal/src/hal_community.c \
                   ${CHIBIOS_CONTRIB}/os/hal/src/usbh/hal_usbh_uvc.c \
                   ${CHIBIOS_CONTRIB}/os/hal/src/hal_ee24xx.c \
                   ${CHIBIOS_CONTRIB}/os/hal/src/hal_ee25xx.c \
+                  ${CHIBIOS_CONTRIB}/os/hal/src/hal_eeflash.c \
                   ${CHIBIOS_CONTRIB}/os/hal/src/hal_eeprom.c \
                   ${CHIBIOS_CONTRIB}/os/hal/src/hal_timcap.c \
                   ${CHIBIOS_CONTRIB}/os/hal/src/hal_qei.c \
@@ -49,6 +49,14 @@
 #define CRC_USE_MUTUAL_EXCLUSION        TRUE
 #endif
 
+/**
+ * @brief   Enables the @p crcCombine() API.
+ * @note    Disabling this option saves code space.
+ */
+#if !defined(CRC_USE_COMBINE) || defined(__DOXYGEN__)
+#define CRC_USE_COMBINE                 TRUE
+#endif
+
 /*===========================================================================*/
 /* Derived constants and error checks.                                       */
 /*===========================================================================*/
@@ -147,6 +155,10 @@ extern "C" {
   void crcStartCalc(CRCDriver *crcp, size_t n, const void *buf);
   void crcStartCalcI(CRCDriver *crcp, size_t n, const void *buf);
 #endif
+#if CRC_USE_COMBINE == TRUE
+  uint32_t crcCombine(CRCDriver *crcp, uint32_t crc_a, uint32_t crc_b,
+                      size_t len_b);
+#endif
 #if CRC_USE_MUTUAL_EXCLUSION == TRUE
   void crcAcquireUnit(CRCDriver *crcp);
   void crcReleaseUnit(CRCDriver *crcp);
@@ -61,6 +61,16 @@ typedef struct {
 #define I2CEepromFileOpen(efs, eepcfg, eepdev) \
   EepromFileOpen((EepromFileStream *)efs, (EepromFileConfig *)eepcfg, eepdev);
 
+#ifdef __cplusplus
+extern "C" {
+#endif
+  size_t I2CEepromFileStreamWrite(I2CEepromFileStream *efs,
+                                  const uint8_t *bp, size_t n);
+  msg_t I2CEepromFileSync(I2CEepromFileStream *efs);
+#ifdef __cplusplus
+}
+#endif
+
 #endif /* #if defined(EEPROM_USE_EE24XX) && EEPROM_USE_EE24XX */
 
 #endif // HAL_EE24XX_H
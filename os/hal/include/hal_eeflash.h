@@ -0,0 +1,159 @@
+/*
+    ChibiOS - Copyright (C) 2006..2018 Giovanni Di Sirio
+
+    Licensed under the Apache License, Version 2.0 (the "License");
+    you may not use this file except in compliance with the License.
+    You may obtain a copy of the License at
+
+        http://www.apache.org/licenses/LICENSE-2.0
+
+    Unless required by applicable law or agreed to in writing, software
+    distributed under the License is distributed on an "AS IS" BASIS,
+    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+    See the License for the specific language governing permissions and
+    limitations under the License.
+*/
+
+#ifndef HAL_EEFLASH_H
+#define HAL_EEFLASH_H
+
+#include "hal.h"
+
+#if defined(HAL_USE_EEPROM) && HAL_USE_EEPROM && EEPROM_USE_EEFLASH
+
+#define EEPROM_DEV_FLASH 0xEF
+
+/**
+ * @brief   Largest record size supported.
+ */
+#ifndef EEPROM_EEFLASH_MAX_RECORD
+#define EEPROM_EEFLASH_MAX_RECORD 32
+#endif
+
+/**
+ * @brief   EEPROM emulation configuration.
+ * @details The emulated memory is made of @p size / @p record_size records,
+ *          each one rewritten as a whole. Updated records are appended to
+ *          a log spread over @p sectors_count flash sectors, so a sector is
+ *          erased only once the log has wrapped around.
+ * @note    At most (sectors_count - 1) sectors worth of records may be
+ *          live; keep the emulated size well below that, compaction copies
+ *          the live records of the oldest sector each time it is reclaimed.
+ */
+typedef struct {
+  /**
+   * Flash device, e.g. an @p EFlashDriver.
+   */
+  BaseFlash       *flashp;
+  /**
+   * First sector of the log.
+   */
+  flash_sector_t  first_sector;
+  /**
+   * Number of sectors of the log, at least 2.
+   */
+  flash_sector_t  sectors_count;
+  /**
+   * Data bytes of a record.
+   */
+  uint16_t        record_size;
+  /**
+   * Size of the emulated memory, multiple of @p record_size.
+   */
+  uint32_t        size;
+  /**
+   * RAM index, one entry per record: (size / record_size) entries.
+   */
+  flash_offset_t  *index;
+} EEFlashConfig;
+
+/**
+ * @brief   EEPROM emulation counters.
+ */
+typedef struct {
+  uint32_t        writes;       /**< Records appended to the log.          */
+  uint32_t        unchanged;    /**< Writes skipped, same data.            */
+  uint32_t        copies;       /**< Records moved by compaction.          */
+  uint32_t        erases;       /**< Sectors erased.                       */
+} EEFlashStats;
+
+/**
+ * @brief   EEPROM emulation driver.
+ */
+typedef struct {
+  const EEFlashConfig *config;
+  /* Sector receiving the records and next free offset in it. */
+  flash_sector_t  head;
+  flash_offset_t  wrptr;
+  /* Oldest sector of the log. */
+  flash_sector_t  tail;
+  /* Sequence number of the head sector. */
+  uint32_t        seq;
+  /* Sectors in the log, the others are erased. */
+  flash_sector_t  used;
+  /* Program unit and slot layout. */
+  uint16_t        unit;
+  uint16_t        slot_size;
+  uint8_t         erased;
+  EEFlashStats    stats;
+  /* Record being programmed, and record being modified by the stream. */
+  uint8_t         buf[4 + EEPROM_EEFLASH_MAX_RECORD];
+  uint8_t         rmw[EEPROM_EEFLASH_MAX_RECORD];
+} EEFlashDriver;
+
+/**
+ * @extends EepromFileConfig
+ * @note    @p size and @p pagesize must match the emulation @p size and
+ *          @p record_size, @p write_time is not used.
+ */
+typedef struct {
+  _eeprom_file_config_data
+  /**
+   * Emulation holding the file.
+   */
+  EEFlashDriver   *eeflp;
+} EEFlashFileConfig;
+
+/**
+ * @brief   @p EEFlashFileStream specific data.
+ */
+#define _eeprom_file_stream_data_flash                                      \
+  _eeprom_file_stream_data
+
+/**
+ * @extends EepromFileStream
+ *
+ * @brief   EEPROM file stream driver class for emulated EEPROM.
+ */
+typedef struct {
+  const struct EepromFileStreamVMT *vmt;
+  _eeprom_file_stream_data_flash
+  /* Overwritten parent data member. */
+  const EEFlashFileConfig *cfg;
+} EEFlashFileStream;
+
+/**
+ * Open emulated EEPROM as file and return pointer to the file stream object
+ * @pre       The emulation must have been started.
+ */
+#define EEFlashFileOpen(efs, eepcfg, eepdev) \
+  EepromFileOpen((EepromFileStream *)efs, (EepromFileConfig *)eepcfg, eepdev);
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+  void eeflashObjectInit(EEFlashDriver *eeflp);
+  flash_error_t eeflashStart(EEFlashDriver *eeflp, const EEFlashConfig *config);
+  void eeflashStop(EEFlashDriver *eeflp);
+  flash_error_t eeflashRead(EEFlashDriver *eeflp, uint32_t record,
+                            uint8_t *buf);
+  flash_error_t eeflashWrite(EEFlashDriver *eeflp, uint32_t record,
+                             const uint8_t *buf);
+  void eeflashGetStats(EEFlashDriver *eeflp, EEFlashStats *stats);
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* #if defined(HAL_USE_EEPROM) && HAL_USE_EEPROM && EEPROM_USE_EEFLASH */
+
+#endif // HAL_EEFLASH_H
@@ -39,13 +39,38 @@
 #define EEPROM_USE_EE24XX FALSE
 #endif
 
+/**
+ * @brief   EEPROM emulated in flash sectors, see hal_eeflash.h.
+ */
+#ifndef EEPROM_USE_EEFLASH
+#define EEPROM_USE_EEFLASH FALSE
+#endif
+
+/**
+ * @brief   Per stream line cache.
+ * @details Small reads are served from a RAM copy of the EEPROM line and
+ *          small writes are merged in it until the stream is flushed, seeks
+ *          out of the line or is closed.
+ */
+#ifndef EEPROM_USE_CACHE
+#define EEPROM_USE_CACHE FALSE
+#endif
+
+/**
+ * @brief   Size of the cache line, power of two. Lines never cross a page,
+ *          so chips with smaller pages use only a part of it.
+ */
+#ifndef EEPROM_CACHE_SIZE
+#define EEPROM_CACHE_SIZE 64
+#endif
+
 #if (HAL_USE_EEPROM == TRUE) || defined(__DOXYGEN__)
 
-#if EEPROM_USE_EE25XX && EEPROM_USE_EE24XX
-#define EEPROM_TABLE_SIZE 2
-#elif EEPROM_USE_EE25XX || EEPROM_USE_EE24XX
-#define EEPROM_TABLE_SIZE 1
-#else
+#define EEPROM_TABLE_SIZE ((EEPROM_USE_EE25XX ? 1 : 0) +                 \
+                           (EEPROM_USE_EE24XX ? 1 : 0) +                 \
+                           (EEPROM_USE_EEFLASH ? 1 : 0))
+
+#if !EEPROM_USE_EE25XX && !EEPROM_USE_EE24XX && !EEPROM_USE_EEFLASH
 #error "No EEPROM device selected!"
 #endif
 
@@ -57,6 +82,11 @@
 #error "24xx enabled but I2C driver is disabled!"
 #endif
 
+#if EEPROM_USE_CACHE && ((EEPROM_CACHE_SIZE < 2) ||                         \
+                         ((EEPROM_CACHE_SIZE & (EEPROM_CACHE_SIZE - 1)) != 0))
+#error "EEPROM_CACHE_SIZE must be a power of two"
+#endif
+
 #define _eeprom_file_config_data                                            \
   /* Lower barrier of file in EEPROM memory array. */                       \
   uint32_t        barrier_low;                                              \
@@ -71,6 +101,35 @@
 
 typedef uint32_t fileoffset_t;
 
+#if EEPROM_USE_CACHE || defined(__DOXYGEN__)
+/**
+ * @brief   Cache counters. Each hit and each merged write is a bus
+ *          transaction saved, each write-back is one spent.
+ */
+typedef struct {
+  uint32_t        read_hits;    /**< Reads served from the cache.          */
+  uint32_t        read_misses;  /**< Line fills.                           */
+  uint32_t        writes;       /**< Writes merged in the cache.           */
+  uint32_t        writebacks;   /**< Lines written back to the IC.         */
+} EepromCacheStats;
+
+#define _eeprom_file_stream_cache_data                                      \
+  /* Copy of the EEPROM line holding cache_pos. */                          \
+  uint8_t                     cache[EEPROM_CACHE_SIZE];                     \
+  /* File position of cache[0]. */                                          \
+  uint32_t                    cache_pos;                                    \
+  /* Bytes of the line inside the file, 0 when no line is selected. */      \
+  uint16_t                    cache_len;                                    \
+  /* The line has been read from the IC. */                                 \
+  bool                        cache_valid;                                  \
+  /* Bytes modified since the last write-back, [lo, hi). */                 \
+  uint16_t                    dirty_lo;                                     \
+  uint16_t                    dirty_hi;                                     \
+  EepromCacheStats            cache_stats;
+#else
+#define _eeprom_file_stream_cache_data
+#endif
+
 typedef struct {
   _eeprom_file_config_data
 } EepromFileConfig;
@@ -82,6 +141,7 @@ typedef struct {
   _base_sequential_stream_data                                                    \
   uint32_t                    errors;                                       \
   uint32_t                    position;                                     \
+  _eeprom_file_stream_cache_data
 
 /**
  * @extends BaseFileStreamVMT
@@ -90,6 +150,11 @@ typedef struct {
  */
 struct EepromFileStreamVMT {
   _file_stream_methods
+#if EEPROM_USE_CACHE
+  /* Uncached transfers at the current position, used by the cache. */
+  size_t (*raw_write)(void *instance, const uint8_t *bp, size_t n);
+  size_t (*raw_read)(void *instance, uint8_t *bp, size_t n);
+#endif
 };
 
 /**
@@ -129,6 +194,10 @@ uint32_t EepromReadWord(EepromFileStream *efs);
 size_t EepromWriteByte(EepromFileStream *efs, uint8_t data);
 size_t EepromWriteHalfword(EepromFileStream *efs, uint16_t data);
 size_t EepromWriteWord(EepromFileStream *efs, uint32_t data);
+msg_t EepromFileFlush(EepromFileStream *efs);
+#if EEPROM_USE_CACHE
+void EepromFileGetCacheStats(EepromFileStream *efs, EepromCacheStats *stats);
+#endif
 
 msg_t eepfs_getsize(void *ip, fileoffset_t *offset);
 msg_t eepfs_getposition(void *ip, fileoffset_t *offset);
@@ -137,9 +206,15 @@ msg_t eepfs_close(void *ip);
 msg_t eepfs_geterror(void *ip);
 msg_t eepfs_put(void *ip, uint8_t b);
 msg_t eepfs_get(void *ip);
+#if EEPROM_USE_CACHE
+size_t eepfs_write(void *ip, const uint8_t *bp, size_t n);
+size_t eepfs_read(void *ip, uint8_t *bp, size_t n);
+void eepfs_invalidate(void *ip);
+#endif
 
 #include "hal_ee24xx.h"
 #include "hal_ee25xx.h"
+#include "hal_eeflash.h"
 
 #endif /* #if defined(HAL_USE_EEPROM) && HAL_USE_EEPROM */
 #endif /* HAL_EEPROM_H_ */
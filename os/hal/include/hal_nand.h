@@ -37,7 +37,11 @@
 #define NAND_CMD_READ0          0x00
 #define NAND_CMD_RNDOUT         0x05
 #define NAND_CMD_PAGEPROG       0x10
+#define NAND_CMD_PLANE_PROG     0x11
+#define NAND_CMD_CACHEPROG      0x15
 #define NAND_CMD_READ0_CONFIRM  0x30
+#define NAND_CMD_READ_CACHE     0x31
+#define NAND_CMD_READ_CACHE_END 0x3F
 #define NAND_CMD_READOOB        0x50
 #define NAND_CMD_ERASE          0x60
 #define NAND_CMD_STATUS         0x70
@@ -48,6 +52,13 @@
 #define NAND_CMD_ERASE_CONFIRM  0xD0
 #define NAND_CMD_RESET          0xFF
 
+/*
+ * Status register bits (0x70 command)
+ */
+#define NAND_STATUS_FAIL        0x01
+#define NAND_STATUS_READY       0x40
+#define NAND_STATUS_NOT_WP      0x80
+
 /*===========================================================================*/
 /* Driver pre-compile time settings.                                         */
 /*===========================================================================*/
@@ -59,6 +70,32 @@
 #define NAND_USE_MUTUAL_EXCLUSION     FALSE
 #endif
 
+/**
+ * @brief   Enables the on-flash bad block table.
+ * @details When enabled @p nandStart() loads the bad block map from a table
+ *          stored in the last @p NAND_BBT_BLOCKS blocks of the device, the
+ *          full scan only runs when no valid table is found. The table is
+ *          rewritten by @p nandMarkBad().
+ * @note    The table blocks are reported as bad by @p nandIsBad().
+ * @warning The table takes the last @p NAND_BBT_BLOCKS blocks of the device
+ *          and erases them when it is created. On a device already holding
+ *          data, move it out of those blocks first: @p nandStart() refuses
+ *          to create the table over programmed pages and returns
+ *          @p HAL_FAILED.
+ */
+#if !defined(NAND_USE_BBT) || defined(__DOXYGEN__)
+#define NAND_USE_BBT                  FALSE
+#endif
+
+/**
+ * @brief   Number of blocks reserved for the bad block table.
+ * @details Two copies of the table are kept in the first two good blocks
+ *          of the reserved area, the others are spares.
+ */
+#if !defined(NAND_BBT_BLOCKS) || defined(__DOXYGEN__)
+#define NAND_BBT_BLOCKS               4
+#endif
+
 /*===========================================================================*/
 /* Derived constants and error checks.                                       */
 /*===========================================================================*/
@@ -66,6 +103,10 @@
 #error "NAND_USE_MUTUAL_EXCLUSION requires CH_CFG_USE_MUTEXES and/or CH_CFG_USE_SEMAPHORES"
 #endif
 
+#if NAND_USE_BBT && (NAND_BBT_BLOCKS < 2)
+#error "NAND_BBT_BLOCKS must be at least 2"
+#endif
+
 /*===========================================================================*/
 /* Driver data structures and types.                                         */
 /*===========================================================================*/
@@ -93,6 +134,17 @@ typedef struct NANDDriver NANDDriver;
 
 #include "hal_nand_lld.h"
 
+/**
+ * @brief   Cache and multi-plane operations support.
+ * @details Low level drivers implementing @p nand_lld_read_cached(),
+ *          @p nand_lld_write_cached(), @p nand_lld_write_multiplane() and
+ *          @p nand_lld_erase_multiplane() define it to @p TRUE, otherwise
+ *          the high level functions fall back to single page operations.
+ */
+#if !defined(NAND_SUPPORTS_CACHE_OPS) || defined(__DOXYGEN__)
+#define NAND_SUPPORTS_CACHE_OPS       FALSE
+#endif
+
 /*===========================================================================*/
 /* Driver macros.                                                            */
 /*===========================================================================*/
@@ -106,7 +158,7 @@ extern "C" {
 #endif
   void nandInit(void);
   void nandObjectInit(NANDDriver *nandp);
-  void nandStart(NANDDriver *nandp, const NANDConfig *config, bitmap_t *bb_map);
+  bool nandStart(NANDDriver *nandp, const NANDConfig *config, bitmap_t *bb_map);
   void nandStop(NANDDriver *nandp);
   uint8_t nandErase(NANDDriver *nandp, uint32_t die, uint32_t logun,
                     uint32_t plane, uint32_t block);
@@ -128,6 +180,19 @@ extern "C" {
   uint8_t nandWritePageSpare(NANDDriver *nandp, uint32_t die, uint32_t logun,
                              uint32_t plane, uint32_t block, uint32_t page,
                              const void *spare, size_t sparelen);
+  void nandReadSequential(NANDDriver *nandp, uint32_t die, uint32_t logun,
+                          uint32_t plane, uint32_t block, uint32_t page,
+                          uint32_t npages, void *data, size_t pagelen);
+  uint8_t nandWriteSequential(NANDDriver *nandp, uint32_t die, uint32_t logun,
+                              uint32_t plane, uint32_t block, uint32_t page,
+                              uint32_t npages, const void *data,
+                              size_t pagelen);
+  uint8_t nandWritePageMultiPlane(NANDDriver *nandp, uint32_t die,
+                                  uint32_t logun, uint32_t block,
+                                  uint32_t page, const void *data,
+                                  size_t pagelen);
+  uint8_t nandEraseMultiPlane(NANDDriver *nandp, uint32_t die, uint32_t logun,
+                              uint32_t block);
   uint16_t nandReadBadMark(NANDDriver *nandp, uint32_t die, uint32_t logun,
                            uint32_t plane, uint32_t block, uint32_t page);
   void nandMarkBad(NANDDriver *nandp, uint32_t die, uint32_t logun, 
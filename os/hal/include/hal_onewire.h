@@ -41,6 +41,7 @@
  */
 #define ONEWIRE_CMD_READ_ROM              0x33
 #define ONEWIRE_CMD_SEARCH_ROM            0xF0
+#define ONEWIRE_CMD_ALARM_SEARCH          0xEC
 #define ONEWIRE_CMD_MATCH_ROM             0x55
 #define ONEWIRE_CMD_SKIP_ROM              0xCC
 #define ONEWIRE_CMD_CONVERT_TEMP          0x44
@@ -59,15 +60,57 @@
 /*===========================================================================*/
 /* Driver pre-compile time settings.                                         */
 /*===========================================================================*/
+/**
+ * @brief   Enables the PWM bus master.
+ * @details Every time slot is generated by a PWM channel and handled by
+ *          its interrupt.
+ */
+#if !defined(ONEWIRE_USE_PWM) || defined(__DOXYGEN__)
+#define ONEWIRE_USE_PWM                   TRUE
+#endif
+
+/**
+ * @brief   Enables the UART bus master.
+ * @details Every time slot is a UART character, so the slots of several
+ *          bytes are moved by a single DMA transfer.
+ */
+#if !defined(ONEWIRE_USE_UART) || defined(__DOXYGEN__)
+#define ONEWIRE_USE_UART                  FALSE
+#endif
+
+/**
+ * @brief   Bus bytes moved by a single UART transfer.
+ * @note    The driver keeps a buffer of 8 characters per byte.
+ */
+#if !defined(ONEWIRE_UART_BUFFER_BYTES) || defined(__DOXYGEN__)
+#define ONEWIRE_UART_BUFFER_BYTES         8
+#endif
+
 #if ONEWIRE_SYNTH_SEARCH_TEST && !ONEWIRE_USE_SEARCH_ROM
 #error "Synthetic search rom test needs ONEWIRE_USE_SEARCH_ROM"
 #endif
 
+#if ONEWIRE_SYNTH_SEARCH_TEST && !ONEWIRE_USE_PWM
+#error "Synthetic search rom test needs ONEWIRE_USE_PWM"
+#endif
+
 /*===========================================================================*/
 /* Derived constants and error checks.                                       */
 /*===========================================================================*/
-#if !HAL_USE_PWM
-#error "1-wire Driver requires HAL_USE_PWM"
+#if !ONEWIRE_USE_PWM && !ONEWIRE_USE_UART
+#error "1-wire Driver requires ONEWIRE_USE_PWM or ONEWIRE_USE_UART"
+#endif
+
+#if ONEWIRE_USE_PWM && !HAL_USE_PWM
+#error "1-wire PWM master requires HAL_USE_PWM"
+#endif
+
+#if ONEWIRE_USE_UART && !HAL_USE_UART
+#error "1-wire UART master requires HAL_USE_UART"
+#endif
+
+#if ONEWIRE_UART_BUFFER_BYTES < 1
+#error "ONEWIRE_UART_BUFFER_BYTES must be at least 1"
 #endif
 
 #if !HAL_USE_PAL
@@ -108,7 +151,8 @@ typedef enum {
 typedef enum {
   ONEWIRE_SEARCH_ROM_SUCCESS = 0,   /**< ROM successfully discovered.       */
   ONEWIRE_SEARCH_ROM_LAST = 1,      /**< Last ROM successfully discovered.  */
-  ONEWIRE_SEARCH_ROM_ERROR = 2      /**< Error happened during search.      */
+  ONEWIRE_SEARCH_ROM_ERROR = 2,     /**< Error happened during search.      */
+  ONEWIRE_SEARCH_ROM_NONE = 3       /**< No (more) device answered.         */
 } search_rom_result_t;
 
 /**
@@ -124,6 +168,7 @@ typedef enum {
  * @brief   Driver configuration structure.
  */
 typedef struct {
+#if ONEWIRE_USE_PWM
   /**
    * @brief Pointer to @p PWM driver used for communication.
    */
@@ -150,6 +195,7 @@ typedef struct {
    * @brief Number of PWM channel used as sample interrupt generator.
    */
   size_t                    sample_channel;
+#endif /* ONEWIRE_USE_PWM */
   /**
    * @brief   Port Identifier.
    * @details This type can be a scalar or some kind of pointer, do not make
@@ -184,6 +230,21 @@ typedef struct {
    */
   onewire_pullup_release_t  pullup_release;
 #endif
+#if ONEWIRE_USE_UART
+  /**
+   * @brief   Pointer to @p UART driver used for communication.
+   * @details When not @p NULL the bus is mastered by the UART instead of
+   *          the PWM. TX and RX must both be connected to the bus, i.e.
+   *          an open drain TX in half duplex mode.
+   */
+  UARTDriver                *uartd;
+  /**
+   * @brief   Pointer to configuration structure for underlying UART driver.
+   * @note    It is NOT constant because 1-wire driver sets the speed and
+   *          the receive end callback. The other callbacks must be @p NULL.
+   */
+  UARTConfig                *uartcfg;
+#endif /* ONEWIRE_USE_UART */
 } onewireConfig;
 
 #if ONEWIRE_USE_SEARCH_ROM
@@ -251,7 +312,48 @@ typedef struct {
    * @note    Negative values use to point out of device tree's root.
    */
   int8_t            prev_zero_branch;
+  /**
+   * @brief   Search command, normal or alarm search.
+   */
+  uint8_t           cmd;
+  /**
+   * @brief   Family code the search is restricted to, negative for any.
+   */
+  int16_t           family;
 } onewire_search_rom_t;
+
+/**
+ * @brief     Cache of the ROMs present on a bus.
+ * @details   The cache is refreshed by @p onewireCacheStep(), one search
+ *            pass per call, so the bus is rescanned in the background at a
+ *            constant cost per call whatever the number of devices.
+ */
+typedef struct {
+  /**
+   * @brief   ROMs, 8 bytes each, kept in search order.
+   */
+  uint8_t               *roms;
+  /**
+   * @brief   Capacity of @p roms in ROMs count.
+   */
+  size_t                size;
+  /**
+   * @brief   ROMs in the cache.
+   */
+  size_t                count;
+  /**
+   * @brief   Index of the ROM expected from the next search pass.
+   */
+  size_t                next;
+  /**
+   * @brief   Bool flag. True while a scan is in progress.
+   */
+  bool                  scanning;
+  /**
+   * @brief   Search state kept between passes.
+   */
+  onewire_search_rom_t  search;
+} onewireRomCache;
 #endif /* ONEWIRE_USE_SEARCH_ROM */
 
 /**
@@ -289,10 +391,17 @@ typedef struct {
   uint32_t      bytes: ONEWIRE_REG_BYTES_WIDTH;
 } onewire_reg_t;
 
+/**
+ * @brief     Bus master operations, private to the driver.
+ */
+struct onewire_master;
+
 /**
  * @brief     Structure representing an 1-wire driver.
+ * @note      Any number of drivers can be started, each one on its own
+ *            PWM or UART. @p OWD1 is provided for the single bus case.
  */
-typedef struct {
+typedef struct onewire_driver {
   /**
    * @brief   Onewire registry.
    */
@@ -301,6 +410,10 @@ typedef struct {
    * @brief   Onewire config.
    */
   const onewireConfig   *config;
+  /**
+   * @brief   Bus master in use.
+   */
+  const struct onewire_master *master;
   /**
    * @brief   Pointer to I/O data buffer.
    */
@@ -315,6 +428,16 @@ typedef struct {
    * @brief   Thread waiting for I/O completion.
    */
   thread_reference_t  thread;
+  /**
+   * @brief   Next started driver.
+   */
+  struct onewire_driver *next;
+#if ONEWIRE_USE_UART
+  /**
+   * @brief   UART characters of the time slots, sent and received in place.
+   */
+  uint8_t               slots[ONEWIRE_UART_BUFFER_BYTES * 8];
+#endif /* ONEWIRE_USE_UART */
 } onewireDriver;
 
 /*===========================================================================*/
@@ -341,6 +464,16 @@ extern "C" {
 #if ONEWIRE_USE_SEARCH_ROM
   size_t onewireSearchRom(onewireDriver *owp,
                           uint8_t *result, size_t max_rom_cnt);
+  size_t onewireAlarmSearch(onewireDriver *owp,
+                            uint8_t *result, size_t max_rom_cnt);
+  size_t onewireSearchFamily(onewireDriver *owp, uint8_t family,
+                             uint8_t *result, size_t max_rom_cnt);
+  void onewireSearchBegin(onewireDriver *owp, uint8_t cmd, int16_t family);
+  search_rom_result_t onewireSearchNext(onewireDriver *owp, uint8_t *rom);
+  bool onewireVerifyRom(onewireDriver *owp, const uint8_t *rom);
+  void onewireCacheObjectInit(onewireRomCache *cache,
+                              uint8_t *roms, size_t size);
+  bool onewireCacheStep(onewireDriver *owp, onewireRomCache *cache);
 #endif /* ONEWIRE_USE_SEARCH_ROM */
 #if ONEWIRE_SYNTH_SEARCH_TEST
   void _synth_ow_write_bit(onewireDriver *owp, ioline_t bit);
@@ -351,6 +484,8 @@ extern "C" {
 }
 #endif
 
+#include "hal_onewire_sweep.h"
+
 #endif /* HAL_USE_ONEWIRE */
 
 #endif /* HAL_ONEWIRE_H_ */
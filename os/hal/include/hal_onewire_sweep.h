@@ -0,0 +1,118 @@
+/*
+    ChibiOS - Copyright (C) 2006..2018 Giovanni Di Sirio
+
+    Licensed under the Apache License, Version 2.0 (the "License");
+    you may not use this file except in compliance with the License.
+    You may obtain a copy of the License at
+
+        http://www.apache.org/licenses/LICENSE-2.0
+
+    Unless required by applicable law or agreed to in writing, software
+    distributed under the License is distributed on an "AS IS" BASIS,
+    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+    See the License for the specific language governing permissions and
+    limitations under the License.
+*/
+
+/**
+ * @file    hal_onewire_sweep.h
+ * @brief   1-wire temperature sweep over several buses.
+ *
+ * @addtogroup onewire
+ * @{
+ */
+
+#ifndef HAL_ONEWIRE_SWEEP_H_
+#define HAL_ONEWIRE_SWEEP_H_
+
+#if (HAL_USE_ONEWIRE == TRUE) || defined(__DOXYGEN__)
+
+/*===========================================================================*/
+/* Driver constants.                                                         */
+/*===========================================================================*/
+/**
+ * @brief   Scratchpad length of DS18B20 and compatible sensors, CRC included.
+ */
+#define ONEWIRE_SCRATCHPAD_LEN            9U
+
+/**
+ * @brief   Maximum number of buses swept together.
+ */
+#define ONEWIRE_SWEEP_MAX_BUSES           32U
+
+/*===========================================================================*/
+/* Driver pre-compile time settings.                                         */
+/*===========================================================================*/
+/**
+ * @brief   Interval between two polls of the conversion status.
+ */
+#if !defined(ONEWIRE_SWEEP_POLL_INTERVAL) || defined(__DOXYGEN__)
+#define ONEWIRE_SWEEP_POLL_INTERVAL       OSAL_MS2I(10)
+#endif
+
+/**
+ * @brief   Reads repeated after a CRC error.
+ */
+#if !defined(ONEWIRE_SWEEP_RETRIES) || defined(__DOXYGEN__)
+#define ONEWIRE_SWEEP_RETRIES             1
+#endif
+
+/*===========================================================================*/
+/* Driver data structures and types.                                         */
+/*===========================================================================*/
+/**
+ * @brief   Result of a sensor in a sweep.
+ */
+typedef enum {
+  ONEWIRE_SWEEP_OK = 0,             /**< Scratchpad read and valid.         */
+  ONEWIRE_SWEEP_NO_PRESENCE = 1,    /**< No presence pulse on the bus.      */
+  ONEWIRE_SWEEP_CRC_ERROR = 2,      /**< Scratchpad never read correctly.   */
+  ONEWIRE_SWEEP_TIMEOUT = 3         /**< Scratchpad valid, but the bus did
+                                         not signal the conversion end.     */
+} onewire_sweep_status_t;
+
+/**
+ * @brief   Sensors of a bus taking part in a sweep.
+ */
+typedef struct {
+  /**
+   * @brief   Started driver of the bus.
+   */
+  onewireDriver           *owp;
+  /**
+   * @brief   ROMs of the sensors, 8 bytes each.
+   * @note    May be @p NULL when @p count is 1.
+   */
+  const uint8_t           *roms;
+  /**
+   * @brief   Number of sensors.
+   */
+  size_t                  count;
+  /**
+   * @brief   Scratchpads read, @p ONEWIRE_SCRATCHPAD_LEN bytes per sensor.
+   */
+  uint8_t                 *scratchpads;
+  /**
+   * @brief   Result per sensor.
+   */
+  onewire_sweep_status_t  *status;
+} onewireSweepBus;
+
+/*===========================================================================*/
+/* External declarations.                                                    */
+/*===========================================================================*/
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+  size_t onewireSweep(const onewireSweepBus *buses, size_t n,
+                      sysinterval_t timeout);
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* HAL_USE_ONEWIRE */
+
+#endif /* HAL_ONEWIRE_SWEEP_H_ */
+
+/** @} */
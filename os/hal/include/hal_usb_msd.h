@@ -120,6 +120,10 @@ typedef struct {
    * @brief   USB endpoint number.
    */
   usbep_t   ep;
+  /**
+   * @brief   Length of the asynchronous transfer in progress.
+   */
+  size_t    pending;
 } usb_scsi_transport_handler_t;
 
 
@@ -188,6 +192,11 @@ extern "C" {
                 BaseBlockDevice *blkdev, uint8_t *blkbuf,
                 const scsi_inquiry_response_t *scsi_inquiry_response,
                 const scsi_unit_serial_number_inquiry_response_t *serialInquiry);
+  void msdStartBuffered(USBMassStorageDriver *msdp, USBDriver *usbp,
+                        BaseBlockDevice *blkdev, uint8_t *blkbuf,
+                        size_t blkbuf_size,
+                        const scsi_inquiry_response_t *scsi_inquiry_response,
+                        const scsi_unit_serial_number_inquiry_response_t *serialInquiry);
   void msdStop(USBMassStorageDriver *msdp);
   bool msd_request_hook(USBDriver *usbp);
 #ifdef __cplusplus
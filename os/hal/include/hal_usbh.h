@@ -56,6 +56,28 @@
 #define HAL_USBH_USE_IAD     HAL_USBH_USE_UVC
 #endif
 
+/* Internal main loop thread, woken by the driver events; when disabled the
+ * application must call usbhMainLoop() periodically. */
+#ifndef HAL_USBH_USE_MAIN_THREAD
+#define HAL_USBH_USE_MAIN_THREAD		FALSE
+#endif
+
+#ifndef HAL_USBH_MAIN_THREAD_STACK
+#define HAL_USBH_MAIN_THREAD_STACK		1024
+#endif
+
+#ifndef HAL_USBH_MAIN_THREAD_PRIO
+#define HAL_USBH_MAIN_THREAD_PRIO		NORMALPRIO
+#endif
+
+/* Enumerate the ports concurrently: the debounce, reset and settling delays
+ * of a port no longer stall the others. The enumerations are advanced by
+ * usbhMainLoop(), which must then be called every few milliseconds while
+ * usbhIsEnumerating(); the main thread does so by itself. */
+#ifndef HAL_USBH_USE_PARALLEL_ENUMERATION
+#define HAL_USBH_USE_PARALLEL_ENUMERATION	FALSE
+#endif
+
 #if (HAL_USE_USBH == TRUE) || defined(__DOXYGEN__)
 
 #include "osal.h"
@@ -72,6 +94,10 @@
 #define USBH_MAX_ADDRESSES				(HAL_USBHHUB_MAX_PORTS + 1)
 #endif
 
+/* Event flags broadcast on USBHDriver.event */
+#define USBH_EVENT_PORT_CHANGE		((eventflags_t)1)	/* root port status change */
+#define USBH_EVENT_HUB_CHANGE		((eventflags_t)2)	/* hub status change URB */
+
 enum usbh_status {
 	USBH_STATUS_STOPPED = 0,
 	USBH_STATUS_STARTED,
@@ -88,6 +114,16 @@ enum usbh_devstatus {
 	USBH_DEVSTATUS_CONFIGURED,
 };
 
+/* Enumeration progress of a port */
+enum usbh_portenum {
+	USBH_PORTENUM_IDLE = 0,
+	USBH_PORTENUM_DEBOUNCE,
+	USBH_PORTENUM_WAIT_DEFAULT,		/* another device is at address 0 */
+	USBH_PORTENUM_RESET,
+	USBH_PORTENUM_RECOVERY,
+	USBH_PORTENUM_ADDRESS,
+};
+
 enum usbh_devspeed {
 	USBH_DEVSPEED_LOW = 0,
 	USBH_DEVSPEED_FULL,
@@ -145,6 +181,7 @@ typedef struct USBHHubDriver USBHHubDriver;
 typedef enum usbh_status usbh_status_t;
 typedef enum usbh_devspeed usbh_devspeed_t;
 typedef enum usbh_devstatus usbh_devstatus_t;
+typedef enum usbh_portenum usbh_portenum_t;
 typedef enum usbh_epdir usbh_epdir_t;
 typedef enum usbh_eptype usbh_eptype_t;
 typedef enum usbh_epstatus usbh_epstatus_t;
@@ -236,6 +273,14 @@ struct usbh_port {
 
 	uint8_t number;
 
+	/* enumeration */
+	usbh_portenum_t enum_state;
+	systime_t enum_time;			/* start of the current delay */
+	sysinterval_t enum_delay;
+	systime_t enum_reset_time;
+	uint8_t enum_resets;			/* reset attempts left */
+	uint8_t enum_retries;			/* enumeration attempts left */
+
 	usbh_device_t device;
 
 	/* Low level part */
@@ -277,6 +322,21 @@ struct USBHDriver {
 	struct list_head hubs;
 #endif
 
+	/* status changes, see USBH_EVENT_* */
+	event_source_t event;
+
+	/* enumeration */
+	usbh_port_t *default_port;		/* port whose device is at address 0 */
+	uint8_t enumerating;			/* ports being enumerated */
+#if HAL_USBH_USE_PARALLEL_ENUMERATION
+	sysinterval_t enum_wait;		/* until the next enumeration step */
+#endif
+
+#if HAL_USBH_USE_MAIN_THREAD
+	thread_t *main_thread;
+	THD_WORKING_AREA(main_wa, HAL_USBH_MAIN_THREAD_STACK);
+#endif
+
 	/* Low level part */
 	_usbhdriver_ll_data
 
@@ -441,6 +501,12 @@ extern "C" {
 
 	/* Main loop */
 	void usbhMainLoop(USBHDriver *usbh);
+	static inline event_source_t *usbhGetEventSource(USBHDriver *usbh) {
+		return &usbh->event;
+	}
+	static inline bool usbhIsEnumerating(USBHDriver *usbh) {
+		return usbh->enumerating != 0;
+	}
 
 #ifdef __cplusplus
 }
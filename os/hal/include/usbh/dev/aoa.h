@@ -26,10 +26,36 @@
 /* Driver pre-compile time settings.                                         */
 /*===========================================================================*/
 
+/**
+ * @brief   Number of IN URBs (and 64 byte buffers) of the channel.
+ * @details Values above 1 keep a transfer armed while the application
+ *          drains the previous ones.
+ */
+#if !defined(HAL_USBHAOA_IN_URBS)
+#define HAL_USBHAOA_IN_URBS						2
+#endif
+
+/**
+ * @brief   Number of OUT URBs (and 64 byte buffers) of the channel.
+ * @details Values above 1 let the application fill a buffer while the
+ *          previous ones are on the bus.
+ */
+#if !defined(HAL_USBHAOA_OUT_URBS)
+#define HAL_USBHAOA_OUT_URBS					2
+#endif
+
 /*===========================================================================*/
 /* Derived constants and error checks.                                       */
 /*===========================================================================*/
 
+#if (HAL_USBHAOA_IN_URBS < 1) || (HAL_USBHAOA_IN_URBS > 8)
+#error "HAL_USBHAOA_IN_URBS must be within 1 and 8"
+#endif
+
+#if (HAL_USBHAOA_OUT_URBS < 1) || (HAL_USBHAOA_OUT_URBS > 8)
+#error "HAL_USBHAOA_OUT_URBS must be within 1 and 8"
+#endif
+
 /*===========================================================================*/
 /* Driver data structures and types.                                         */
 /*===========================================================================*/
@@ -53,6 +79,15 @@ typedef enum {
 	USBHAOA_AUDIO_MODE_2CH_16BIT_PCM_44100 = 1,
 } usbhaoa_audio_mode_t;
 
+typedef struct {
+	uint32_t in_bytes;		/* data bytes received */
+	uint32_t out_bytes;		/* data bytes sent */
+	uint32_t in_urbs;		/* IN transfers that carried data */
+	uint32_t out_urbs;		/* OUT transfers completed */
+	uint32_t in_full;		/* IN transfers completed with no other URB armed */
+	uint32_t errors;		/* transfers failed: IN retried, OUT dropped */
+} usbhaoa_channel_stats_t;
+
 typedef struct {
 	struct _aoa_channel_cfg {
 		const char *manufacturer;
@@ -85,18 +120,28 @@ struct USBHAOAChannel {
 	_base_asynchronous_channel_data
 
 	usbh_ep_t epin;
-	usbh_urb_t iq_urb;
+	usbh_urb_t iq_urb[HAL_USBHAOA_IN_URBS];
 	threads_queue_t	iq_waiting;
 	uint32_t iq_counter;
-	USBH_DECLARE_STRUCT_MEMBER(uint8_t iq_buff[64]);
+	USBH_DECLARE_STRUCT_MEMBER(uint8_t iq_buff[HAL_USBHAOA_IN_URBS][64]);
 	uint8_t *iq_ptr;
+	/* completed URBs with data, in arrival order; the head is being read */
+	uint8_t iq_ready[HAL_USBHAOA_IN_URBS];
+	uint8_t iq_ready_head;
+	uint8_t iq_ready_count;
 
 	usbh_ep_t epout;
-	usbh_urb_t oq_urb;
+	usbh_urb_t oq_urb[HAL_USBHAOA_OUT_URBS];
 	threads_queue_t	oq_waiting;
 	uint32_t oq_counter;
-	USBH_DECLARE_STRUCT_MEMBER(uint8_t oq_buff[64]);
+	USBH_DECLARE_STRUCT_MEMBER(uint8_t oq_buff[HAL_USBHAOA_OUT_URBS][64]);
 	uint8_t *oq_ptr;
+	/* URB being filled by the writers */
+	uint8_t oq_wr;
+	/* an OUT transfer failed, reported to the next writer */
+	bool oq_error;
+
+	usbhaoa_channel_stats_t stats;
 
 	virtual_timer_t vt;
 
@@ -143,6 +188,8 @@ extern "C" {
 	/* AOA device driver */
 	void usbhaoaChannelStart(USBHAOADriver *aoap);
 	void usbhaoaChannelStop(USBHAOADriver *aoap);
+	void usbhaoaChannelGetStats(USBHAOADriver *aoap, usbhaoa_channel_stats_t *stats);
+	void usbhaoaChannelResetStats(USBHAOADriver *aoap);
 #ifdef __cplusplus
 }
 #endif
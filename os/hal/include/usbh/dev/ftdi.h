@@ -26,9 +26,35 @@
 /* Driver pre-compile time settings.                                         */
 /*===========================================================================*/
 
+/**
+ * @brief   Number of IN URBs (and 64 byte buffers) per port.
+ * @details Values above 1 keep a transfer armed while the application
+ *          drains the previous ones.
+ */
+#if !defined(HAL_USBHFTDI_IN_URBS)
+#define HAL_USBHFTDI_IN_URBS					2
+#endif
+
+/**
+ * @brief   Number of OUT URBs (and 64 byte buffers) per port.
+ * @details Values above 1 let the application fill a buffer while the
+ *          previous ones are on the bus.
+ */
+#if !defined(HAL_USBHFTDI_OUT_URBS)
+#define HAL_USBHFTDI_OUT_URBS					2
+#endif
+
 /*===========================================================================*/
 /* Derived constants and error checks.                                       */
 /*===========================================================================*/
+
+#if (HAL_USBHFTDI_IN_URBS < 1) || (HAL_USBHFTDI_IN_URBS > 8)
+#error "HAL_USBHFTDI_IN_URBS must be within 1 and 8"
+#endif
+
+#if (HAL_USBHFTDI_OUT_URBS < 1) || (HAL_USBHFTDI_OUT_URBS > 8)
+#error "HAL_USBHFTDI_OUT_URBS must be within 1 and 8"
+#endif
 #define USBHFTDI_FRAMING_DATABITS_7    (0x7 << 0)
 #define USBHFTDI_FRAMING_DATABITS_8    (0x8 << 0)
 #define USBHFTDI_FRAMING_PARITY_NONE   (0x0 << 8)
@@ -72,6 +98,16 @@ typedef enum {
 	USBHFTDIP_STATE_READY = 3
 } usbhftdip_state_t;
 
+typedef struct {
+	uint32_t in_bytes;		/* data bytes received, status bytes excluded */
+	uint32_t out_bytes;		/* data bytes sent */
+	uint32_t in_urbs;		/* IN transfers that carried data */
+	uint32_t out_urbs;		/* OUT transfers completed */
+	uint32_t in_full;		/* IN transfers completed with no other URB armed */
+	uint32_t overruns;		/* receive overruns reported by the chip */
+	uint32_t errors;		/* transfers failed: IN retried, OUT dropped */
+} usbhftdip_stats_t;
+
 
 #define _ftdi_port_driver_methods                                          \
   _base_asynchronous_channel_methods
@@ -93,19 +129,29 @@ struct USBHFTDIPortDriver {
 	usbhftdip_state_t state;
 
 	usbh_ep_t epin;
-	usbh_urb_t iq_urb;
+	usbh_urb_t iq_urb[HAL_USBHFTDI_IN_URBS];
 	threads_queue_t	iq_waiting;
 	uint32_t iq_counter;
-	USBH_DECLARE_STRUCT_MEMBER(uint8_t iq_buff[64]);
+	USBH_DECLARE_STRUCT_MEMBER(uint8_t iq_buff[HAL_USBHFTDI_IN_URBS][64]);
 	uint8_t *iq_ptr;
+	/* completed URBs with data, in arrival order; the head is being read */
+	uint8_t iq_ready[HAL_USBHFTDI_IN_URBS];
+	uint8_t iq_ready_head;
+	uint8_t iq_ready_count;
 
 
 	usbh_ep_t epout;
-	usbh_urb_t oq_urb;
+	usbh_urb_t oq_urb[HAL_USBHFTDI_OUT_URBS];
 	threads_queue_t	oq_waiting;
 	uint32_t oq_counter;
-	USBH_DECLARE_STRUCT_MEMBER(uint8_t oq_buff[64]);
+	USBH_DECLARE_STRUCT_MEMBER(uint8_t oq_buff[HAL_USBHFTDI_OUT_URBS][64]);
 	uint8_t *oq_ptr;
+	/* URB being filled by the writers */
+	uint8_t oq_wr;
+	/* an OUT transfer failed, reported to the next writer */
+	bool oq_error;
+
+	usbhftdip_stats_t stats;
 
 	virtual_timer_t vt;
 	uint8_t ifnum;
@@ -141,6 +187,8 @@ extern "C" {
 	/* FTDI port driver */
 	void usbhftdipStart(USBHFTDIPortDriver *ftdipp, const USBHFTDIPortConfig *config);
 	void usbhftdipStop(USBHFTDIPortDriver *ftdipp);
+	void usbhftdipGetStats(USBHFTDIPortDriver *ftdipp, usbhftdip_stats_t *stats);
+	void usbhftdipResetStats(USBHFTDIPortDriver *ftdipp);
 #ifdef __cplusplus
 }
 #endif
@@ -34,10 +34,37 @@
 #define HAL_USBHHID_USE_INTERRUPT_OUT 				FALSE
 #endif
 
+/**
+ * @brief   Parses the report descriptor when the interface is loaded.
+ * @details The layout of the reports is compiled into a table of fields,
+ *          decoded later with @p usbhhidDecodeReport() without re-parsing.
+ */
+#if !defined(HAL_USBHHID_USE_REPORT_PARSER)
+#define HAL_USBHHID_USE_REPORT_PARSER				FALSE
+#endif
+
+/**
+ * @brief   Maximum number of fields kept per HID instance.
+ */
+#if !defined(HAL_USBHHID_MAX_FIELDS)
+#define HAL_USBHHID_MAX_FIELDS						32
+#endif
+
+/**
+ * @brief   Size of the buffer the report descriptors are read into.
+ */
+#if !defined(HAL_USBHHID_MAX_REPORT_DESCRIPTOR)
+#define HAL_USBHHID_MAX_REPORT_DESCRIPTOR			512
+#endif
+
 /*===========================================================================*/
 /* Derived constants and error checks.                                       */
 /*===========================================================================*/
 
+#if HAL_USBHHID_USE_REPORT_PARSER && (HAL_USBHHID_MAX_FIELDS < 1)
+#error "HAL_USBHHID_MAX_FIELDS must be at least 1"
+#endif
+
 
 /*===========================================================================*/
 /* Driver data structures and types.                                         */
@@ -67,6 +94,33 @@ typedef enum {
 	USBHHID_PROTOCOL_REPORT = 1,
 } usbhhid_protocol_t;
 
+/* Flags of a field: the bits of its Input/Output/Feature item, plus
+ * USBHHID_FIELD_SIGNED when the logical range is signed */
+#define USBHHID_FIELD_CONSTANT			(1 << 0)
+#define USBHHID_FIELD_VARIABLE			(1 << 1)
+#define USBHHID_FIELD_RELATIVE			(1 << 2)
+#define USBHHID_FIELD_WRAP				(1 << 3)
+#define USBHHID_FIELD_NONLINEAR			(1 << 4)
+#define USBHHID_FIELD_NO_PREFERRED		(1 << 5)
+#define USBHHID_FIELD_NULL_STATE		(1 << 6)
+#define USBHHID_FIELD_SIGNED			(1 << 7)
+
+#define USBHHID_USAGE(page, id)			(((uint32_t)(page) << 16) | (id))
+
+/* One report field, as compiled from the report descriptor. For array
+ * fields (USBHHID_FIELD_VARIABLE clear) usage is the first usage of the
+ * array: a value v selects usage + v - logical_min. */
+typedef struct {
+	uint32_t usage;				/* usage page << 16 | usage ID */
+	int32_t logical_min;
+	int32_t logical_max;
+	uint16_t bit_offset;		/* from the start of the report data, after the ID */
+	uint8_t bit_size;			/* 1 to 32 */
+	uint8_t report_id;			/* 0 if the device uses no report IDs */
+	uint8_t type;				/* usbhhid_reporttype_t */
+	uint8_t flags;
+} usbhhid_field_t;
+
 typedef struct USBHHIDDriver USBHHIDDriver;
 typedef struct USBHHIDConfig USBHHIDConfig;
 
@@ -97,6 +151,11 @@ struct USBHHIDDriver {
 	const USBHHIDConfig *config;
 
 	semaphore_t sem;
+
+#if HAL_USBHHID_USE_REPORT_PARSER
+	usbhhid_field_t fields[HAL_USBHHID_MAX_FIELDS];
+	uint16_t fields_count;
+#endif
 };
 
 
@@ -135,6 +194,31 @@ extern "C" {
 	}
 
 	void usbhhidStart(USBHHIDDriver *hidp, const USBHHIDConfig *cfg);
+
+	/* Report descriptor parser */
+	bool usbhhidParseReportDescriptor(const uint8_t *desc, uint16_t len,
+			usbhhid_field_t *fields, uint16_t max_fields, uint16_t *count);
+	int32_t usbhhidExtractField(const usbhhid_field_t *field,
+			const uint8_t *report, uint16_t len);
+	uint16_t usbhhidDecodeFields(const usbhhid_field_t *fields, uint16_t count,
+			usbhhid_reporttype_t report_type, const uint8_t *report, uint16_t len,
+			int32_t *values);
+	const usbhhid_field_t *usbhhidFindField(const usbhhid_field_t *fields, uint16_t count,
+			usbhhid_reporttype_t report_type, uint32_t usage);
+#if HAL_USBHHID_USE_REPORT_PARSER
+	static inline const usbhhid_field_t *usbhhidGetFields(USBHHIDDriver *hidp, uint16_t *count) {
+		*count = hidp->fields_count;
+		return hidp->fields;
+	}
+
+	/* Decodes an input report received in report mode; values has one
+	 * entry per field, those of other reports are left untouched */
+	static inline uint16_t usbhhidDecodeReport(USBHHIDDriver *hidp,
+			const uint8_t *report, uint16_t len, int32_t *values) {
+		return usbhhidDecodeFields(hidp->fields, hidp->fields_count,
+				USBHHID_REPORTTYPE_INPUT, report, len, values);
+	}
+#endif
 #ifdef __cplusplus
 }
 #endif
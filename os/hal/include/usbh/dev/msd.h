@@ -33,11 +33,54 @@
 /* Driver pre-compile time settings.                                         */
 /*===========================================================================*/
 
+/**
+ * @brief   Enables the asynchronous request queue.
+ * @details Requests are executed by a worker thread; adjacent requests are
+ *          merged into a single READ(10)/WRITE(10) and sequential reads are
+ *          followed by a read-ahead. The synchronous block API is routed
+ *          through the same queue.
+ */
+#if !defined(HAL_USBHMSD_USE_ASYNC)
+#define HAL_USBHMSD_USE_ASYNC					FALSE
+#endif
+
+/**
+ * @brief   Stack size of the asynchronous worker thread.
+ */
+#if !defined(HAL_USBHMSD_ASYNC_THREAD_STACK)
+#define HAL_USBHMSD_ASYNC_THREAD_STACK			1024
+#endif
+
+/**
+ * @brief   Priority of the asynchronous worker thread.
+ */
+#if !defined(HAL_USBHMSD_ASYNC_THREAD_PRIO)
+#define HAL_USBHMSD_ASYNC_THREAD_PRIO			NORMALPRIO
+#endif
+
+/**
+ * @brief   Maximum number of queued requests merged in one transaction.
+ */
+#if !defined(HAL_USBHMSD_ASYNC_MAX_COALESCE)
+#define HAL_USBHMSD_ASYNC_MAX_COALESCE			8
+#endif
+
+/**
+ * @brief   Size in bytes of the per-LUN read-ahead buffer, 0 disables it.
+ */
+#if !defined(HAL_USBHMSD_READAHEAD_SIZE)
+#define HAL_USBHMSD_READAHEAD_SIZE				4096
+#endif
+
 
 /*===========================================================================*/
 /* Derived constants and error checks.                                       */
 /*===========================================================================*/
 
+#if HAL_USBHMSD_USE_ASYNC && (HAL_USBHMSD_ASYNC_MAX_COALESCE < 1)
+#error "HAL_USBHMSD_ASYNC_MAX_COALESCE must be at least 1"
+#endif
+
 
 /*===========================================================================*/
 /* Driver data structures and types.                                         */
@@ -53,6 +96,49 @@ struct USBHMassStorageDriverVMT {
 typedef struct USBHMassStorageLUNDriver USBHMassStorageLUNDriver;
 typedef struct USBHMassStorageDriver USBHMassStorageDriver;
 
+#if HAL_USBHMSD_USE_ASYNC
+typedef struct usbhmsd_request usbhmsd_request_t;
+typedef void (*usbhmsd_callback_t)(usbhmsd_request_t *req);
+
+typedef enum {
+	USBHMSD_REQSTATUS_IDLE = 0,
+	USBHMSD_REQSTATUS_PENDING,
+	USBHMSD_REQSTATUS_OK,
+	USBHMSD_REQSTATUS_FAILED,
+} usbhmsd_reqstatus_t;
+
+struct usbhmsd_request {
+	usbhmsd_request_t *next;
+	USBHMassStorageLUNDriver *lunp;
+
+	uint32_t startblk;
+	uint8_t *buffer;
+	uint32_t n;
+	bool write;
+
+	volatile usbhmsd_reqstatus_t status;
+
+	/* called from the worker thread on completion, may be NULL */
+	usbhmsd_callback_t callback;
+	void *userData;
+
+	thread_reference_t waitingThread;
+};
+
+typedef struct {
+	/* SCSI READ(10)/WRITE(10) commands sent to the device */
+	uint32_t transactions;
+	/* requests completed */
+	uint32_t requests;
+	/* requests merged into the transaction of a previous request */
+	uint32_t coalesced;
+	/* requests served from the read-ahead buffer */
+	uint32_t readahead_hits;
+	/* read-ahead transactions */
+	uint32_t readaheads;
+} usbhmsd_stats_t;
+#endif
+
 struct USBHMassStorageLUNDriver {
 	/* inherited from abstract block driver */
 	const struct USBHMassStorageDriverVMT *vmt;
@@ -65,6 +151,17 @@ struct USBHMassStorageLUNDriver {
 	USBHMassStorageDriver *msdp;
 
 	USBHMassStorageLUNDriver *next;
+
+#if HAL_USBHMSD_USE_ASYNC
+	/* block following the last read, for sequential access detection */
+	uint32_t next_read_blk;
+	usbhmsd_stats_t stats;
+#if HAL_USBHMSD_READAHEAD_SIZE > 0
+	uint32_t ra_start;
+	uint32_t ra_count;
+	USBH_DECLARE_STRUCT_MEMBER(uint8_t ra_buff[HAL_USBHMSD_READAHEAD_SIZE]);
+#endif
+#endif
 };
 
 
@@ -96,6 +193,21 @@ extern "C" {
 	bool usbhmsdLUNIsProtected(USBHMassStorageLUNDriver *lunp);
 
 	USBHDriver *usbhmsdLUNGetHost(const USBHMassStorageLUNDriver *lunp);
+
+#if HAL_USBHMSD_USE_ASYNC
+	/* Asynchronous API */
+	void usbhmsdLUNSubmitRead(USBHMassStorageLUNDriver *lunp, usbhmsd_request_t *req,
+					uint32_t startblk, uint8_t *buffer, uint32_t n,
+					usbhmsd_callback_t callback, void *user);
+	void usbhmsdLUNSubmitWrite(USBHMassStorageLUNDriver *lunp, usbhmsd_request_t *req,
+					uint32_t startblk, const uint8_t *buffer, uint32_t n,
+					usbhmsd_callback_t callback, void *user);
+	bool usbhmsdRequestWait(usbhmsd_request_t *req);
+	static inline bool usbhmsdRequestIsBusy(const usbhmsd_request_t *req) {
+		return req->status == USBHMSD_REQSTATUS_PENDING;
+	}
+	void usbhmsdLUNGetStats(USBHMassStorageLUNDriver *lunp, usbhmsd_stats_t *stats);
+#endif
 #ifdef __cplusplus
 }
 #endif
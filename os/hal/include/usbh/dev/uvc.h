@@ -28,6 +28,21 @@
 /* Driver pre-compile time settings.                                         */
 /*===========================================================================*/
 
+/**
+ * @brief   Enables the frame assembly mode.
+ * @details When a frame ring is set with @p usbhuvcSetFrameBuffers() the
+ *          payloads are copied, without the UVC headers, into the ring
+ *          buffers and only whole frames are posted to the mailbox as
+ *          @p USBHUVC_MESSAGETYPE_FRAME messages.
+ * @note    The copy is done in the ISO completion callback, so at interrupt
+ *          level: one payload per callback, at most wMaxPacketSize bytes
+ *          of the selected alternate setting per service interval. The
+ *          stream is copied once, as the application would copy the data
+ *          messages of the packet mode.
+ */
+#if !defined(HAL_USBHUVC_USE_FRAME_ASSEMBLY)
+#define HAL_USBHUVC_USE_FRAME_ASSEMBLY			FALSE
+#endif
 
 /*===========================================================================*/
 /* Derived constants and error checks.                                       */
@@ -312,6 +327,7 @@ typedef struct USBHUVCDriver USBHUVCDriver;
 
 #define USBHUVC_MESSAGETYPE_STATUS	1
 #define USBHUVC_MESSAGETYPE_DATA	2
+#define USBHUVC_MESSAGETYPE_FRAME	3
 
 
 #define _usbhuvc_message_base_data				\
@@ -333,6 +349,29 @@ typedef struct {
 	USBH_DECLARE_STRUCT_MEMBER(uint8_t data[USBHUVC_MAX_STATUS_PACKET_SZ]);
 } usbhuvc_message_status_t;
 
+#if HAL_USBHUVC_USE_FRAME_ASSEMBLY
+/* Frame message; timestamp is the arrival time of the first payload and
+ * length is unused, the frame size is in len. */
+typedef struct {
+	_usbhuvc_message_base_data
+	uint8_t *buff;			/* frame buffer, set by usbhuvcSetFrameBuffers */
+	uint32_t size;			/* size of buff */
+	uint32_t len;			/* payload bytes in buff */
+	uint32_t sequence;		/* frame counter, gaps mean lost frames */
+	uint32_t pts;			/* dwPresentationTime, valid if flags & UVC_HDR_PT */
+	uint8_t flags;			/* bmHeaderInfo bits seen in the frame */
+	uint8_t busy;			/* driver use: out of the free pool */
+} usbhuvc_frame_t;
+#endif
+
+typedef struct {
+	uint32_t packets;		/* ISO payloads received */
+	uint32_t overruns;		/* payloads or frames lost: pool or mailbox full */
+	uint32_t frames;		/* frames delivered */
+	uint32_t dropped;		/* incomplete frames discarded (ERR, overflow, bus error) */
+	uint32_t fps;			/* frames delivered in the last second */
+} usbhuvc_stats_t;
+
 
 typedef enum {
 	USBHUVC_STATE_UNINITIALIZED = 0,	//must call usbhuvcObjectInit
@@ -373,6 +412,23 @@ struct USBHUVCDriver {
 	usbhuvc_message_status_t mp_status_buffer[HAL_USBHUVC_STATUS_PACKETS_COUNT];
 
 	mutex_t mtx;
+
+	usbhuvc_stats_t stats;
+
+#if HAL_USBHUVC_USE_FRAME_ASSEMBLY
+	/* frame ring */
+	usbhuvc_frame_t *frames;
+	uint32_t frames_count;
+	memory_pool_t mp_frames;
+
+	/* frame being assembled */
+	usbhuvc_frame_t *frame;
+	uint8_t fid;
+	uint8_t fa_state;
+	uint32_t sequence;
+	systime_t fps_start;
+	uint32_t fps_count;
+#endif
 };
 
 
@@ -450,6 +506,13 @@ extern "C" {
 	static inline void usbhuvcFreeStatusMessage(USBHUVCDriver *uvcdp, usbhuvc_message_status_t *msg) {
 		chPoolFree(&uvcdp->mp_status, msg);
 	}
+#if HAL_USBHUVC_USE_FRAME_ASSEMBLY
+	bool usbhuvcSetFrameBuffers(USBHUVCDriver *uvcdp, usbhuvc_frame_t *frames,
+			uint32_t count, uint8_t *buff, uint32_t frame_sz);
+	void usbhuvcFreeFrame(USBHUVCDriver *uvcdp, usbhuvc_frame_t *frame);
+#endif
+	void usbhuvcGetStats(USBHUVCDriver *uvcdp, usbhuvc_stats_t *stats);
+	void usbhuvcResetStats(USBHUVCDriver *uvcdp);
 #ifdef __cplusplus
 }
 #endif
@@ -34,6 +34,7 @@ extern const usbh_classdriverinfo_t usbhaoaClassDriverInfo;
 #endif
 #if HAL_USBH_USE_MSD
 extern const usbh_classdriverinfo_t usbhmsdClassDriverInfo;
+void _usbhmsd_async_start(void);
 #endif
 #if HAL_USBH_USE_HID
 extern const usbh_classdriverinfo_t usbhhidClassDriverInfo;
@@ -50,6 +51,9 @@ void _usbhub_port_object_init(usbh_port_t *port, USBHDriver *usbh, uint8_t numbe
 #endif
 
 void _usbh_port_disconnected(usbh_port_t *port);
+static inline void _usbh_notifyI(USBHDriver *usbh, eventflags_t flags) {
+	osalEventBroadcastFlagsI(&usbh->event, flags);
+}
 void _usbh_urb_completeI(usbh_urb_t *urb, usbh_urbstatus_t status);
 bool _usbh_urb_abortI(usbh_urb_t *urb, usbh_urbstatus_t status);
 void _usbh_urb_abort_and_waitS(usbh_urb_t *urb, usbh_urbstatus_t status);
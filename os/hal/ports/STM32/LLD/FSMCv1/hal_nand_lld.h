@@ -258,6 +258,13 @@ struct NANDDriver {
    * @details One bit per block. All memory allocation is user's responsibility.
    */
   bitmap_t                  *bb_map;
+#if NAND_USE_BBT || defined(__DOXYGEN__)
+  /**
+   * @brief   The bad block table is in use.
+   * @details @p false when @p nandStart() did not create the table.
+   */
+  bool                      bbt_active;
+#endif
 };
 
 /*===========================================================================*/
@@ -135,6 +135,16 @@
 #define TRDT_VALUE_FS 5
 #define TRDT_VALUE_HS 9
 
+#if STM32_USBH_NAK_BUDGET < 0 || STM32_USBH_NAK_BUDGET > 255
+#error "STM32_USBH_NAK_BUDGET must be within 0 and 255"
+#endif
+
+#if STM32_USBH_USE_STATS
+#define _stats_inc(host, field)		((host)->stats.field++)
+#else
+#define _stats_inc(host, field)		do {} while (0)
+#endif
+
 #define _USBH_DEBUG_HELPER_ENABLE_TRACE		USBH_LLD_DEBUG_ENABLE_TRACE
 #define _USBH_DEBUG_HELPER_ENABLE_INFO		USBH_LLD_DEBUG_ENABLE_INFO
 #define _USBH_DEBUG_HELPER_ENABLE_WARNINGS	USBH_LLD_DEBUG_ENABLE_WARNINGS
@@ -168,6 +178,31 @@ static inline void _save_dt_mask(usbh_ep_t *ep, uint32_t hctsiz) {
 	ep->dt_mask = hctsiz & HCTSIZ_DPID_MASK;
 }
 
+/* True when a Bulk IN transfer has re-armed its channel STM32_USBH_NAK_BUDGET
+ * times; a budget of 0 re-arms forever. */
+static inline bool _nak_budget_spent(usbh_ep_t *ep) {
+#if STM32_USBH_NAK_BUDGET > 0
+	return (ep->type == USBH_EPTYPE_BULK) && (ep->xfer.nak_count >= STM32_USBH_NAK_BUDGET);
+#else
+	(void)ep;
+	return FALSE;
+#endif
+}
+
+/* Parks a Bulk IN endpoint that keeps NAKing; the SOF interrupt moves it back
+ * to the pending queue after ep->nak_backoff frames. */
+static void _nak_park(USBHDriver *host, usbh_ep_t *ep) {
+	ep->xfer.u.frame_counter = ep->nak_backoff;
+	if (ep->nak_backoff <= STM32_USBH_NAK_MAX_BACKOFF / 2) {
+		ep->nak_backoff *= 2;
+	} else {
+		ep->nak_backoff = STM32_USBH_NAK_MAX_BACKOFF;
+	}
+	list_move_tail(&ep->node, &host->ep_nak_list);
+	host->otg->GINTMSK |= GINTMSK_SOFM;
+	_stats_inc(host, nak_parked);
+}
+
 /*===========================================================================*/
 /* Functions called from many places.                                        */
 /*===========================================================================*/
@@ -327,6 +362,7 @@ static bool _activate_ep(USBHDriver *host, usbh_ep_t *ep) {
 
 	}
 	ep->xfer.partial = 0;
+	ep->xfer.nak_count = 0;
 
 	if (ep->type == USBH_EPTYPE_ISO) {
 		ep->dt_mask = HCTSIZ_DPID_DATA0;
@@ -484,7 +520,8 @@ static void _try_commit_p(USBHDriver *host, bool sof) {
 	}
 
 	if (list_empty(&host->ep_pending_lists[USBH_EPTYPE_ISO])
-		&& list_empty(&host->ep_pending_lists[USBH_EPTYPE_INT])) {
+		&& list_empty(&host->ep_pending_lists[USBH_EPTYPE_INT])
+		&& list_empty(&host->ep_nak_list)) {
 		host->otg->GINTMSK &= ~GINTMSK_SOFM;
 	} else {
 		host->otg->GINTMSK |= GINTMSK_SOFM;
@@ -518,6 +555,7 @@ static void _purge_pending(USBHDriver *host) {
 	_purge_queue(host, &host->ep_pending_lists[1]);
 	_purge_queue(host, &host->ep_pending_lists[2]);
 	_purge_queue(host, &host->ep_pending_lists[3]);
+	_purge_queue(host, &host->ep_nak_list);
 }
 
 static uint32_t _write_packet(struct list_head *list, uint32_t space_available) {
@@ -619,6 +657,7 @@ void usbh_lld_ep_object_init(usbh_ep_t *ep) {
 	default:
 		chDbgCheck(0);
 	}
+	ep->nak_backoff = 1;
 	ep->active_list = &host->ep_active_lists[ep->type];
 	ep->pending_list = &host->ep_pending_lists[ep->type];
 	INIT_LIST_HEAD(&ep->urb_list);
@@ -790,11 +829,14 @@ static inline void _frmor_int(USBHDriver *host, stm32_hc_management_t *hcm, stm3
 static inline void _nak_int(USBHDriver *host, stm32_hc_management_t *hcm, stm32_otg_host_chn_t *hc) {
 	usbh_ep_t *const ep = hcm->ep;
 	osalDbgAssert(hcm->ep->type != USBH_EPTYPE_ISO, "NAK should not happen in ISO endpoints");
-	if (!ep->in || (ep->type == USBH_EPTYPE_INT)) {
+	_stats_inc(host, nak);
+	if (!ep->in || (ep->type == USBH_EPTYPE_INT) || _nak_budget_spent(ep)) {
+		/* Bulk IN: out of budget, release the channel and retry from SOF */
 		hc->HCINTMSK &= ~HCINTMSK_NAKM;
 		_halt_channel(host, hcm, USBH_LLD_HALTREASON_NAK);
 	} else {
 		/* restart directly, no need to halt it in this case */
+		ep->xfer.nak_count++;
 		ep->xfer.error_count = 0;
 		hc->HCINTMSK &= ~HCINTMSK_ACKM;
 		hc->HCCHAR |= HCCHAR_CHENA;
@@ -817,6 +859,7 @@ static inline void _stall_int(USBHDriver *host, stm32_hc_management_t *hcm, stm3
 static void _complete_bulk_int(USBHDriver *host, stm32_hc_management_t *hcm, usbh_ep_t *ep, usbh_urb_t *urb, uint32_t hctsiz) {
 	_release_channel(host, hcm);
 	_save_dt_mask(ep, hctsiz);
+	ep->nak_backoff = 1;
 	if (_update_urb(ep, hctsiz, urb, TRUE)) {
 		uepdbgf("done");
 		_transfer_completedI(ep, urb, USBH_URBSTATUS_OK);
@@ -956,12 +999,18 @@ static inline void _chh_int(USBHDriver *host, stm32_hc_management_t *hcm, stm32_
 	} else {
 		_release_channel(host, hcm);
 		_save_dt_mask(ep, hctsiz);
+		const uint32_t actual = urb->actualLength;
 		bool done = _update_urb(ep, hctsiz, urb, FALSE);
 
 		switch (reason) {
 		case USBH_LLD_HALTREASON_NAK:
 			if ((ep->type == USBH_EPTYPE_INT) && ep->in) {
 				_transfer_completedI(ep, urb, USBH_URBSTATUS_TIMEOUT);
+			} else if ((ep->type == USBH_EPTYPE_BULK) && ep->in && !done) {
+				if (urb->actualLength != actual)
+					ep->nak_backoff = 1;
+				ep->xfer.error_count = 0;
+				_nak_park(host, ep);
 			} else {
 				ep->xfer.error_count = 0;
 				_move_to_pending_queue(ep);
@@ -1015,6 +1064,8 @@ static void _hcint_n_int(USBHDriver *host, uint8_t chn) {
 	hcint &= hc->HCINTMSK;
 	hc->HCINT = hcint;
 
+	_stats_inc(host, hcint);
+
 	osalDbgCheck((hcint & HCINTMSK_AHBERRM) == 0);
 	osalDbgCheck(hcm->ep);
 
@@ -1119,6 +1170,24 @@ static inline void _sof_int(USBHDriver *host) {
 
 	/* real SOF interrupt */
 	udbg("SOF");
+	_stats_inc(host, sof);
+
+	/* retry the parked Bulk IN endpoints whose wait expired; the wait counts
+	 * frames, so a high speed port only walks the list on microframe 0 */
+	if (((host->otg->HPRT & HPRT_PSPD_MASK) != HPRT_PSPD_HS)
+			|| ((host->otg->HFNUM & 7) == 0)) {
+		usbh_ep_t *ep, *tmp;
+		bool retry = FALSE;
+		list_for_each_entry_safe(ep, usbh_ep_t, tmp, &host->ep_nak_list, node) {
+			if (--ep->xfer.u.frame_counter == 0) {
+				_move_to_pending_queue(ep);
+				retry = TRUE;
+			}
+		}
+		if (retry)
+			_try_commit_np(host);
+	}
+
 	_try_commit_p(host, TRUE);
 }
 
@@ -1371,6 +1440,8 @@ static void usb_lld_serve_interrupt(USBHDriver *host) {
 	stm32_otg_t *const otg = host->otg;
 	uint32_t gintsts = otg->GINTSTS;
 
+	_stats_inc(host, isr);
+
 	/* check host mode */
 	if (!(gintsts & GINTSTS_CMOD)) {
 		uerr("Device mode");
@@ -1394,6 +1465,8 @@ static void usb_lld_serve_interrupt(USBHDriver *host) {
 
 	otg->GINTSTS = gintsts;
 
+	const usbh_portcstatus_t c_status = host->rootport.lld_c_status;
+
 	if (gintsts & GINTSTS_SOF)
 		_sof_int(host);
 	if (gintsts & GINTSTS_RXFLVL)
@@ -1411,6 +1484,9 @@ static void usb_lld_serve_interrupt(USBHDriver *host) {
 	if (gintsts & GINTSTS_IPXFR) {
 		uerr("IPXFRM");
 	}
+
+	if (host->rootport.lld_c_status & ~c_status)
+		_usbh_notifyI(host, USBH_EVENT_PORT_CHANGE);
 }
 
 
@@ -1516,6 +1592,7 @@ static void _init(USBHDriver *host) {
 		INIT_LIST_HEAD(&host->ep_active_lists[i]);
 		INIT_LIST_HEAD(&host->ep_pending_lists[i]);
 	}
+	INIT_LIST_HEAD(&host->ep_nak_list);
 }
 
 void usbh_lld_init(void) {
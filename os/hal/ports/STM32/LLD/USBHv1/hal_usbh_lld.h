@@ -25,6 +25,28 @@
 #include "osal.h"
 #include "stm32_otg.h"
 
+/* Number of NAKs a Bulk IN transfer re-arms directly before it is parked
+ * and retried from the SOF interrupt; 0 re-arms on every NAK. */
+#if !defined(STM32_USBH_NAK_BUDGET)
+#define STM32_USBH_NAK_BUDGET				8
+#endif
+
+/* Maximum number of frames (1ms, also at high speed) a parked Bulk IN
+ * endpoint waits before its retry. The wait starts at 1 and doubles every
+ * time the endpoint is parked again without having received data. */
+#if !defined(STM32_USBH_NAK_MAX_BACKOFF)
+#define STM32_USBH_NAK_MAX_BACKOFF			8
+#endif
+
+/* Interrupt counters in USBHDriver.stats */
+#if !defined(STM32_USBH_USE_STATS)
+#define STM32_USBH_USE_STATS				FALSE
+#endif
+
+#if STM32_USBH_NAK_MAX_BACKOFF < 1 || STM32_USBH_NAK_MAX_BACKOFF > 255
+#error "STM32_USBH_NAK_MAX_BACKOFF must be within 1 and 255"
+#endif
+
 /* TODO:
  *
  * - Implement ISO/INT OUT and test
@@ -60,6 +82,20 @@ typedef struct stm32_hc_management {
 	usbh_lld_halt_reason_t halt_reason;
 } stm32_hc_management_t;
 
+typedef struct {
+	uint32_t isr;			/* OTG interrupts served */
+	uint32_t hcint;			/* channel interrupts */
+	uint32_t sof;			/* SOF interrupts */
+	uint32_t nak;			/* NAK interrupts */
+	uint32_t nak_parked;	/* Bulk IN transfers parked after the NAK budget */
+} stm32_usbh_stats_t;
+
+#if STM32_USBH_USE_STATS
+#define _usbh_lld_stats_data	stm32_usbh_stats_t stats;
+#else
+#define _usbh_lld_stats_data
+#endif
+
 
 #define _usbhdriver_ll_data											\
 	stm32_otg_t *otg;												\
@@ -72,7 +108,10 @@ typedef struct stm32_hc_management {
 	/* Enpoints being processed */									\
 	struct list_head ep_active_lists[4];							\
 	/* Pending endpoints */											\
-	struct list_head ep_pending_lists[4];
+	struct list_head ep_pending_lists[4];							\
+	/* Bulk IN endpoints waiting for a NAK retry */					\
+	struct list_head ep_nak_list;									\
+	_usbh_lld_stats_data
 
 
 #define _usbh_ep_ll_data																\
@@ -84,6 +123,7 @@ typedef struct stm32_hc_management {
 		uint32_t			hcchar;														\
 		uint32_t 			dt_mask;			/* data-toggle mask */					\
 		int32_t				trace_level;		/* enable tracing */					\
+		uint8_t				nak_backoff;		/* next NAK retry delay (frames) */		\
 		/* current transfer */															\
 		struct {																		\
 			stm32_hc_management_t *hcm;				/* assigned channel */				\
@@ -92,10 +132,11 @@ typedef struct stm32_hc_management {
 			uint32_t			partial;			/* this transfer's partial length */\
 			uint16_t			packets;			/* packets allocated */				\
 			union {																		\
-				uint32_t			frame_counter;		/* frame counter (for INT) */	\
+				uint32_t			frame_counter;		/* frame counter (INT, parked BULK) */	\
 				usbh_lld_ctrlphase_t	ctrl_phase;		/* control phase (for CTRL) */	\
 			} u;																		\
 			uint8_t				error_count;		/* error count */					\
+			uint8_t				nak_count;			/* NAKs re-armed directly */		\
 		} xfer;
 
 
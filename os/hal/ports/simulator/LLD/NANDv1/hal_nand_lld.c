@@ -0,0 +1,643 @@
+/*
+    ChibiOS/HAL - Copyright (C) 2014 Uladzimir Pylinsky aka barthess
+
+    Licensed under the Apache License, Version 2.0 (the "License");
+    you may not use this file except in compliance with the License.
+    You may obtain a copy of the License at
+
+        http://www.apache.org/licenses/LICENSE-2.0
+
+    Unless required by applicable law or agreed to in writing, software
+    distributed under the License is distributed on an "AS IS" BASIS,
+    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+    See the License for the specific language governing permissions and
+    limitations under the License.
+*/
+
+/**
+ * @file    hal_nand_lld.c
+ * @brief   Simulated NAND Driver subsystem low level driver source.
+ *
+ * @addtogroup NAND
+ * @{
+ */
+
+#include "hal.h"
+
+#if (HAL_USE_NAND == TRUE) || defined(__DOXYGEN__)
+
+#include <string.h>
+
+/*===========================================================================*/
+/* Driver local definitions.                                                 */
+/*===========================================================================*/
+
+/*===========================================================================*/
+/* Driver exported variables.                                                */
+/*===========================================================================*/
+
+/**
+ * @brief   NAND1 driver identifier.
+ */
+#if SIM_NAND_USE_NAND1 || defined(__DOXYGEN__)
+NANDDriver NANDD1;
+#endif
+
+/*===========================================================================*/
+/* Driver local types.                                                       */
+/*===========================================================================*/
+
+/*===========================================================================*/
+/* Driver local variables and types.                                         */
+/*===========================================================================*/
+
+/*===========================================================================*/
+/* Driver local functions.                                                   */
+/*===========================================================================*/
+
+/**
+ * @brief   Size of a page including the spare area.
+ *
+ * @notapi
+ */
+static size_t page_size(const NANDConfig *cfg) {
+
+  return cfg->page_data_size + cfg->page_spare_size;
+}
+
+/**
+ * @brief   Number of rows (pages) in a single die.
+ *
+ * @notapi
+ */
+static uint32_t die_rows(const NANDConfig *cfg) {
+
+  return cfg->loguns * cfg->planes * cfg->blocks * cfg->pages_per_block;
+}
+
+/**
+ * @brief   Decodes the address cycles and returns a pointer into storage.
+ *
+ * @param[in] nandp         pointer to the @p NANDDriver object
+ * @param[in] addr          pointer to address buffer
+ * @param[in] addrlen       length of address
+ * @param[in] colcycles     number of column cycles in the address
+ * @param[out] room         bytes available from the pointer to page end
+ *
+ * @notapi
+ */
+static uint8_t *decode_addr(NANDDriver *nandp, const uint8_t *addr,
+                            size_t addrlen, size_t colcycles, size_t *room) {
+
+  const NANDConfig *cfg = nandp->config;
+  uint32_t column = 0, row = 0;
+  size_t i;
+
+  for (i = 0; i < colcycles; i++) {
+    column |= (uint32_t)addr[i] << (8 * i);
+  }
+  for (i = colcycles; i < addrlen; i++) {
+    row |= (uint32_t)addr[i] << (8 * (i - colcycles));
+  }
+
+  osalDbgCheck((row < die_rows(cfg)) && (column < page_size(cfg)) &&
+               (nandp->die < cfg->dies));
+
+  *room = page_size(cfg) - column;
+  return &cfg->storage[((size_t)nandp->die * die_rows(cfg) + row) *
+                       page_size(cfg) + column];
+}
+
+/**
+ * @brief   Returns the status of a program or erase operation.
+ *
+ * @param[in] nandp         pointer to the @p NANDDriver object
+ * @param[in] ptr           pointer into storage of the operation
+ *
+ * @notapi
+ */
+static uint8_t op_status(NANDDriver *nandp, const uint8_t *ptr) {
+
+  const NANDConfig *cfg = nandp->config;
+  uint8_t status = NAND_STATUS_READY | NAND_STATUS_NOT_WP;
+
+  if (NULL != nandp->fail_map) {
+    size_t row = (size_t)(ptr - cfg->storage) / page_size(cfg);
+    if (bitmapGet(nandp->fail_map, row / cfg->pages_per_block)) {
+      status |= NAND_STATUS_FAIL;
+    }
+  }
+  return status;
+}
+
+/**
+ * @brief   Flips random bits of the page data area in a read buffer.
+ *
+ * @param[in] nandp         pointer to the @p NANDDriver object
+ * @param[in] src           pointer into storage of the read
+ * @param[in,out] data      read buffer
+ * @param[in] datalen       size of data buffer in bytes
+ *
+ * @notapi
+ */
+static void inject_flips(NANDDriver *nandp, const uint8_t *src,
+                         uint8_t *data, size_t datalen) {
+
+  const NANDConfig *cfg = nandp->config;
+  size_t column = (size_t)(src - cfg->storage) % page_size(cfg);
+  size_t len;
+  uint32_t i;
+
+  if (column >= cfg->page_data_size) {
+    return;
+  }
+  len = cfg->page_data_size - column;
+  if (len > datalen) {
+    len = datalen;
+  }
+  for (i = 0; i < nandp->read_flips; i++) {
+    /* xorshift32.*/
+    nandp->prng ^= nandp->prng << 13;
+    nandp->prng ^= nandp->prng >> 17;
+    nandp->prng ^= nandp->prng << 5;
+    data[(nandp->prng >> 3) % len] ^= (uint8_t)(1U << (nandp->prng & 7U));
+    nandp->stats.flips++;
+  }
+}
+
+/**
+ * @brief   Checks that @p npages rows starting at @p ptr are in the
+ *          selected die.
+ *
+ * @notapi
+ */
+static bool rows_in_die(NANDDriver *nandp, const uint8_t *ptr, size_t npages) {
+
+  const NANDConfig *cfg = nandp->config;
+  size_t row = (size_t)(ptr - cfg->storage) / page_size(cfg);
+
+  return (row % die_rows(cfg)) + npages <= die_rows(cfg);
+}
+
+/**
+ * @brief   Accounts the bus transfer time of @p len bytes.
+ *
+ * @notapi
+ */
+static uint64_t xfer_ns(NANDDriver *nandp, size_t len) {
+
+  return (uint64_t)len * nandp->config->t_byte_ns;
+}
+
+/**
+ * @brief   Returns the larger of two durations.
+ *
+ * @notapi
+ */
+static uint64_t max_ns(uint64_t a, uint64_t b) {
+
+  return a > b ? a : b;
+}
+
+/**
+ * @brief   Programs a page register into the array.
+ * @details A failing page is still programmed, its content is unreliable
+ *          but bad block marks written on it persist as on most devices.
+ *
+ * @return  The operation status.
+ *
+ * @notapi
+ */
+static uint8_t program(NANDDriver *nandp, uint8_t *dst, const uint8_t *src,
+                       size_t len) {
+
+  size_t i;
+
+  for (i = 0; i < len; i++) {
+    dst[i] &= src[i];
+  }
+  nandp->stats.programs++;
+  nandp->stats.bytes += len;
+  return op_status(nandp, dst);
+}
+
+/**
+ * @brief   Reads the array into a buffer, injecting bit errors.
+ *
+ * @notapi
+ */
+static void fetch(NANDDriver *nandp, uint8_t *dst, const uint8_t *src,
+                  size_t len) {
+
+  memcpy(dst, src, len);
+  if (nandp->read_flips > 0U) {
+    inject_flips(nandp, src, dst, len);
+  }
+  nandp->stats.reads++;
+  nandp->stats.bytes += len;
+}
+
+/**
+ * @brief   Erases the block containing @p dst.
+ *
+ * @return  The operation status.
+ *
+ * @notapi
+ */
+static uint8_t erase(NANDDriver *nandp, uint8_t *dst) {
+
+  const NANDConfig *cfg = nandp->config;
+  uint8_t status = op_status(nandp, dst);
+
+  if ((status & NAND_STATUS_FAIL) == 0) {
+    memset(dst, 0xFF, page_size(cfg) * cfg->pages_per_block);
+  }
+  nandp->stats.erases++;
+  return status;
+}
+
+/*===========================================================================*/
+/* Driver interrupt handlers.                                                */
+/*===========================================================================*/
+
+/*===========================================================================*/
+/* Driver exported functions.                                                */
+/*===========================================================================*/
+
+/**
+ * @brief   Low level NAND driver initialization.
+ *
+ * @notapi
+ */
+void nand_lld_init(void) {
+
+#if SIM_NAND_USE_NAND1
+  /* Driver initialization.*/
+  nandObjectInit(&NANDD1);
+  NANDD1.die    = 0;
+  NANDD1.cmd    = 0;
+  NANDD1.status = NAND_STATUS_READY | NAND_STATUS_NOT_WP;
+  NANDD1.bb_map = NULL;
+  NANDD1.fail_map = NULL;
+  NANDD1.read_flips = 0;
+  NANDD1.prng = 0x2545F491U;
+  memset(&NANDD1.stats, 0, sizeof(NANDD1.stats));
+#endif /* SIM_NAND_USE_NAND1 */
+}
+
+/**
+ * @brief   Configures and activates the NAND peripheral.
+ *
+ * @param[in] nandp         pointer to the @p NANDDriver object
+ *
+ * @notapi
+ */
+void nand_lld_start(NANDDriver *nandp) {
+
+  osalDbgCheck(nandp->config->storage != NULL);
+
+  if (nandp->state == NAND_STOP) {
+    nandp->die = 0;
+    nandp->status = NAND_STATUS_READY | NAND_STATUS_NOT_WP;
+  }
+}
+
+/**
+ * @brief   Deactivates the NAND peripheral.
+ *
+ * @param[in] nandp         pointer to the @p NANDDriver object
+ *
+ * @notapi
+ */
+void nand_lld_stop(NANDDriver *nandp) {
+
+  (void)nandp;
+}
+
+/**
+ * @brief   Read data from NAND.
+ *
+ * @param[in] nandp         pointer to the @p NANDDriver object
+ * @param[out] data         pointer to data buffer
+ * @param[in] datalen       size of data buffer in bytes
+ * @param[in] addr          pointer to address buffer
+ * @param[in] addrlen       length of address
+ * @param[out] ecc          pointer to store computed ECC. Ignored when NULL.
+ *
+ * @note    The simulated device has no hardware ECC, @p ecc is zeroed.
+ *
+ * @notapi
+ */
+void nand_lld_read_data(NANDDriver *nandp, uint16_t *data, size_t datalen,
+                        uint8_t *addr, size_t addrlen, uint32_t *ecc) {
+
+  size_t room;
+  const uint8_t *src;
+
+  nandp->state = NAND_READ;
+  src = decode_addr(nandp, addr, addrlen, nandp->config->colcycles, &room);
+  osalDbgCheck(datalen <= room);
+
+  fetch(nandp, (uint8_t *)data, src, datalen);
+  nandp->stats.time_ns += nandp->config->t_read_ns + xfer_ns(nandp, datalen);
+
+  if (NULL != ecc) {
+    *ecc = 0;
+  }
+  nandp->state = NAND_READY;
+}
+
+/**
+ * @brief   Write data to NAND.
+ * @details Programming can only clear bits, as on a real device.
+ *
+ * @param[in] nandp         pointer to the @p NANDDriver object
+ * @param[in] data          buffer with data to be written
+ * @param[in] datalen       size of data buffer in bytes
+ * @param[in] addr          pointer to address buffer
+ * @param[in] addrlen       length of address
+ * @param[out] ecc          pointer to store computed ECC. Ignored when NULL.
+ *
+ * @return    The operation status reported by NAND IC (0x70 command).
+ *
+ * @notapi
+ */
+uint8_t nand_lld_write_data(NANDDriver *nandp, const uint16_t *data,
+                size_t datalen, uint8_t *addr, size_t addrlen, uint32_t *ecc) {
+
+  size_t room;
+  uint8_t *dst;
+
+  nandp->state = NAND_WRITE;
+  dst = decode_addr(nandp, addr, addrlen, nandp->config->colcycles, &room);
+  osalDbgCheck(datalen <= room);
+
+  nandp->status = program(nandp, dst, (const uint8_t *)data, datalen);
+  nandp->stats.time_ns += xfer_ns(nandp, datalen) + nandp->config->t_prog_ns;
+
+  if (NULL != ecc) {
+    *ecc = 0;
+  }
+  nandp->state = NAND_READY;
+
+  return nand_lld_read_status(nandp);
+}
+
+/**
+ * @brief   Soft reset NAND device.
+ *
+ * @param[in] nandp         pointer to the @p NANDDriver object
+ *
+ * @notapi
+ */
+void nand_lld_reset(NANDDriver *nandp) {
+
+  nandp->cmd = NAND_CMD_RESET;
+  nandp->status = NAND_STATUS_READY | NAND_STATUS_NOT_WP;
+}
+
+/**
+ * @brief   Erase block.
+ *
+ * @param[in] nandp         pointer to the @p NANDDriver object
+ * @param[in] addr          pointer to address buffer
+ * @param[in] addrlen       length of address
+ *
+ * @return    The operation status reported by NAND IC (0x70 command).
+ *
+ * @notapi
+ */
+uint8_t nand_lld_erase(NANDDriver *nandp, uint8_t *addr, size_t addrlen) {
+
+  size_t room;
+  uint8_t *dst;
+
+  nandp->state = NAND_ERASE;
+  dst = decode_addr(nandp, addr, addrlen, 0, &room);
+
+  nandp->status = erase(nandp, dst);
+  nandp->stats.time_ns += nandp->config->t_erase_ns;
+  nandp->state = NAND_READY;
+
+  return nand_lld_read_status(nandp);
+}
+
+/**
+ * @brief   Reads consecutive pages with the cache read commands.
+ * @details The array read of a page (0x31) overlaps the transfer of the
+ *          previous one from the cache register, the last page is fetched
+ *          with 0x3F.
+ *
+ * @param[in] nandp         pointer to the @p NANDDriver object
+ * @param[out] data         pointer to data buffer, @p npages pages
+ * @param[in] datalen       bytes read from each page
+ * @param[in] addr          address of the first page
+ * @param[in] addrlen       length of address
+ * @param[in] npages        number of pages
+ *
+ * @notapi
+ */
+void nand_lld_read_cached(NANDDriver *nandp, uint16_t *data,
+                size_t datalen, uint8_t *addr, size_t addrlen, size_t npages) {
+
+  const NANDConfig *cfg = nandp->config;
+  uint8_t *dst = (uint8_t *)data;
+  const uint8_t *src;
+  size_t room, i;
+
+  nandp->state = NAND_READ;
+  src = decode_addr(nandp, addr, addrlen, cfg->colcycles, &room);
+  osalDbgCheck((datalen <= room) && (npages > 0U) &&
+               rows_in_die(nandp, src, npages));
+
+  for (i = 0; i < npages; i++) {
+    fetch(nandp, dst, src, datalen);
+    dst += datalen;
+    src += page_size(cfg);
+  }
+  nandp->cmd = NAND_CMD_READ_CACHE_END;
+  nandp->stats.time_ns += cfg->t_read_ns +
+      ((npages - 1U) * max_ns(cfg->t_read_ns, xfer_ns(nandp, datalen))) +
+      xfer_ns(nandp, datalen);
+  nandp->state = NAND_READY;
+}
+
+/**
+ * @brief   Writes consecutive pages with the cache program command.
+ * @details The transfer of a page overlaps the programming of the previous
+ *          one (0x15), the last page is confirmed with 0x10.
+ *
+ * @param[in] nandp         pointer to the @p NANDDriver object
+ * @param[in] data          buffer with data to be written, @p npages pages
+ * @param[in] datalen       bytes written to each page
+ * @param[in] addr          address of the first page
+ * @param[in] addrlen       length of address
+ * @param[in] npages        number of pages
+ *
+ * @return    The status bits of all the programs ORed together.
+ *
+ * @notapi
+ */
+uint8_t nand_lld_write_cached(NANDDriver *nandp, const uint16_t *data,
+                size_t datalen, uint8_t *addr, size_t addrlen, size_t npages) {
+
+  const NANDConfig *cfg = nandp->config;
+  const uint8_t *src = (const uint8_t *)data;
+  uint8_t status = 0;
+  uint8_t *dst;
+  size_t room, i;
+
+  nandp->state = NAND_WRITE;
+  dst = decode_addr(nandp, addr, addrlen, cfg->colcycles, &room);
+  osalDbgCheck((datalen <= room) && (npages > 0U) &&
+               rows_in_die(nandp, dst, npages));
+
+  for (i = 0; i < npages; i++) {
+    status |= program(nandp, dst, src, datalen);
+    src += datalen;
+    dst += page_size(cfg);
+  }
+  nandp->cmd = NAND_CMD_PAGEPROG;
+  nandp->status = status;
+  nandp->stats.time_ns += xfer_ns(nandp, datalen) +
+      ((npages - 1U) * max_ns(xfer_ns(nandp, datalen), cfg->t_prog_ns)) +
+      cfg->t_prog_ns;
+  nandp->state = NAND_READY;
+
+  return status;
+}
+
+/**
+ * @brief   Programs a page on several planes at once.
+ * @details The page registers are loaded one after the other (0x11) and
+ *          programmed together, the array time is paid once.
+ *
+ * @param[in] nandp         pointer to the @p NANDDriver object
+ * @param[in] data          buffer with data to be written, @p nplanes pages
+ * @param[in] datalen       bytes written to each page
+ * @param[in] addr          @p nplanes addresses, one per plane
+ * @param[in] addrlen       length of a single address
+ * @param[in] nplanes       number of planes
+ *
+ * @return    The status bits of all the planes ORed together.
+ *
+ * @notapi
+ */
+uint8_t nand_lld_write_multiplane(NANDDriver *nandp, const uint16_t *data,
+                size_t datalen, uint8_t *addr, size_t addrlen, size_t nplanes) {
+
+  const NANDConfig *cfg = nandp->config;
+  const uint8_t *src = (const uint8_t *)data;
+  uint8_t status = 0;
+  uint8_t *dst;
+  size_t room, i;
+
+  nandp->state = NAND_WRITE;
+  for (i = 0; i < nplanes; i++) {
+    dst = decode_addr(nandp, &addr[i * addrlen], addrlen, cfg->colcycles,
+                      &room);
+    osalDbgCheck(datalen <= room);
+    status |= program(nandp, dst, src, datalen);
+    src += datalen;
+  }
+  nandp->cmd = NAND_CMD_PAGEPROG;
+  nandp->status = status;
+  nandp->stats.time_ns += xfer_ns(nandp, datalen * nplanes) + cfg->t_prog_ns;
+  nandp->state = NAND_READY;
+
+  return status;
+}
+
+/**
+ * @brief   Erases a block on several planes at once.
+ *
+ * @param[in] nandp         pointer to the @p NANDDriver object
+ * @param[in] addr          @p nplanes block addresses, one per plane
+ * @param[in] addrlen       length of a single address
+ * @param[in] nplanes       number of planes
+ *
+ * @return    The status bits of all the planes ORed together.
+ *
+ * @notapi
+ */
+uint8_t nand_lld_erase_multiplane(NANDDriver *nandp, uint8_t *addr,
+                size_t addrlen, size_t nplanes) {
+
+  uint8_t status = 0;
+  size_t room, i;
+
+  nandp->state = NAND_ERASE;
+  for (i = 0; i < nplanes; i++) {
+    status |= erase(nandp, decode_addr(nandp, &addr[i * addrlen], addrlen,
+                                       0, &room));
+  }
+  nandp->cmd = NAND_CMD_ERASE_CONFIRM;
+  nandp->status = status;
+  nandp->stats.time_ns += nandp->config->t_erase_ns;
+  nandp->state = NAND_READY;
+
+  return status;
+}
+
+/**
+ * @brief   Send addres to NAND.
+ *
+ * @param[in] nandp         pointer to the @p NANDDriver object
+ * @param[in] len           length of address array
+ * @param[in] addr          pointer to address array
+ *
+ * @notapi
+ */
+void nand_lld_write_addr(NANDDriver *nandp, const uint8_t *addr, size_t len) {
+
+  (void)nandp;
+  (void)addr;
+  (void)len;
+}
+
+/**
+ * @brief   Send command to NAND.
+ *
+ * @param[in] nandp         pointer to the @p NANDDriver object
+ * @param[in] cmd           command value
+ *
+ * @notapi
+ */
+void nand_lld_write_cmd(NANDDriver *nandp, uint8_t cmd) {
+
+  nandp->cmd = cmd;
+}
+
+/**
+ * @brief   Read status byte from NAND.
+ *
+ * @param[in] nandp         pointer to the @p NANDDriver object
+ *
+ * @return    Status byte.
+ *
+ * @notapi
+ */
+uint8_t nand_lld_read_status(NANDDriver *nandp) {
+
+  nandp->cmd = NAND_CMD_STATUS;
+  return nandp->status;
+}
+
+/**
+ * @brief   Read ID of the nand flash
+ *
+ * @param[in] nandp         pointer to the @p NANDDriver object
+ *
+ * @return    4 bytes ID of the nandflash
+ *
+ * @notapi
+ */
+uint32_t nand_lld_read_id(NANDDriver *nandp) {
+
+  nandp->cmd = NAND_CMD_READID;
+  return nandp->config->id;
+}
+
+#endif /* HAL_USE_NAND */
+
+/** @} */
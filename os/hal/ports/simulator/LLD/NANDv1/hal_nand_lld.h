@@ -0,0 +1,336 @@
+/*
+    ChibiOS/HAL - Copyright (C) 2014 Uladzimir Pylinsky aka barthess
+
+    Licensed under the Apache License, Version 2.0 (the "License");
+    you may not use this file except in compliance with the License.
+    You may obtain a copy of the License at
+
+        http://www.apache.org/licenses/LICENSE-2.0
+
+    Unless required by applicable law or agreed to in writing, software
+    distributed under the License is distributed on an "AS IS" BASIS,
+    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+    See the License for the specific language governing permissions and
+    limitations under the License.
+*/
+
+/**
+ * @file    hal_nand_lld.h
+ * @brief   Simulated NAND Driver subsystem low level driver header.
+ * @details The memory array is kept in a RAM buffer provided by the
+ *          application, page program clears bits and block erase sets
+ *          them as a real NAND array does. The array and bus timings of the
+ *          configuration are accumulated in the statistics, so the gain of
+ *          cache and multi-plane operations can be measured.
+ *
+ * @addtogroup NAND
+ * @{
+ */
+
+#ifndef HAL_NAND_LLD_H_
+#define HAL_NAND_LLD_H_
+
+#include "bitmap.h"
+
+#if (HAL_USE_NAND == TRUE) || defined(__DOXYGEN__)
+
+/*===========================================================================*/
+/* Driver constants.                                                         */
+/*===========================================================================*/
+#define NAND_MIN_PAGE_SIZE       256
+#define NAND_MAX_PAGE_SIZE       8192
+
+/**
+ * @brief   The driver implements cache read/program and multi-plane
+ *          program/erase.
+ */
+#define NAND_SUPPORTS_CACHE_OPS  TRUE
+
+/*===========================================================================*/
+/* Driver pre-compile time settings.                                         */
+/*===========================================================================*/
+
+/**
+ * @name    Configuration options
+ * @{
+ */
+/**
+ * @brief   NAND driver enable switch.
+ * @details If set to @p TRUE the support for NAND1 is included.
+ */
+#if !defined(SIM_NAND_USE_NAND1) || defined(__DOXYGEN__)
+#define SIM_NAND_USE_NAND1                TRUE
+#endif
+/** @} */
+
+/*===========================================================================*/
+/* Derived constants and error checks.                                       */
+/*===========================================================================*/
+
+#if !SIM_NAND_USE_NAND1
+#error "NAND driver activated but no NAND peripheral assigned"
+#endif
+
+/*===========================================================================*/
+/* Driver data structures and types.                                         */
+/*===========================================================================*/
+
+/**
+ * @brief   Type of a structure representing an NAND driver.
+ */
+typedef struct NANDDriver NANDDriver;
+
+/**
+ * @brief   Simulated device operation counters.
+ */
+typedef struct {
+  /**
+   * @brief   Page (or spare) read operations.
+   */
+  uint32_t                  reads;
+  /**
+   * @brief   Page (or spare) program operations.
+   */
+  uint32_t                  programs;
+  /**
+   * @brief   Block erase operations.
+   */
+  uint32_t                  erases;
+  /**
+   * @brief   Bytes moved across the bus.
+   */
+  uint32_t                  bytes;
+  /**
+   * @brief   Bit errors injected in read data.
+   */
+  uint32_t                  flips;
+  /**
+   * @brief   Modelled device time in nanoseconds.
+   */
+  uint64_t                  time_ns;
+} nandsimstats_t;
+
+/**
+ * @brief   Driver configuration structure.
+ */
+typedef struct {
+  /**
+   * @brief   Number of dies in NAND device.
+   */
+  uint32_t                  dies;
+  /**
+   * @brief   Number of logical units in NAND device.
+   */
+  uint32_t                  loguns;
+  /**
+   * @brief   Number of planes in NAND device.
+   */
+  uint32_t                  planes;
+  /**
+   * @brief   Number of erase blocks in NAND device.
+   */
+  uint32_t                  blocks;
+  /**
+   * @brief   Number of data bytes in page.
+   */
+  uint32_t                  page_data_size;
+  /**
+   * @brief   Number of spare bytes in page.
+   */
+  uint32_t                  page_spare_size;
+  /**
+   * @brief   Number of pages in block.
+   */
+  uint32_t                  pages_per_block;
+  /**
+   * @brief   Number of write cycles for row addressing.
+   */
+  uint8_t                   rowcycles;
+  /**
+   * @brief   Number of write cycles for column addressing.
+   */
+  uint8_t                   colcycles;
+
+  /* End of the mandatory fields.*/
+  /**
+   * @brief   Memory array storage.
+   * @details Pages are stored with their spare area, the buffer size is
+   *          dies * loguns * planes * blocks * pages_per_block *
+   *          (page_data_size + page_spare_size) bytes.
+   */
+  uint8_t                   *storage;
+  /**
+   * @brief   Value returned by the read ID command.
+   */
+  uint32_t                  id;
+  /**
+   * @brief   Array to page register transfer time (tR) in nanoseconds.
+   */
+  uint32_t                  t_read_ns;
+  /**
+   * @brief   Page program time (tPROG) in nanoseconds.
+   */
+  uint32_t                  t_prog_ns;
+  /**
+   * @brief   Block erase time (tBERS) in nanoseconds.
+   */
+  uint32_t                  t_erase_ns;
+  /**
+   * @brief   Bus transfer time of a byte in nanoseconds.
+   */
+  uint32_t                  t_byte_ns;
+} NANDConfig;
+
+/**
+ * @brief   Structure representing an NAND driver.
+ */
+struct NANDDriver {
+  /**
+   * @brief   Driver state.
+   */
+  nandstate_t               state;
+  /**
+   * @brief   Current configuration data.
+   */
+  const NANDConfig          *config;
+#if NAND_USE_MUTUAL_EXCLUSION || defined(__DOXYGEN__)
+#if CH_CFG_USE_MUTEXES || defined(__DOXYGEN__)
+  /**
+   * @brief   Mutex protecting the bus.
+   */
+  mutex_t                   mutex;
+#elif CH_CFG_USE_SEMAPHORES
+  semaphore_t               semaphore;
+#endif
+#endif /* NAND_USE_MUTUAL_EXCLUSION */
+  /* End of the mandatory fields.*/
+  /**
+   * @brief   Currently selected die.
+   */
+  uint32_t                  die;
+  /**
+   * @brief   Last command latched.
+   */
+  uint8_t                   cmd;
+  /**
+   * @brief   Status of the last program or erase operation.
+   */
+  uint8_t                   status;
+  /**
+   * @brief   Operation counters.
+   */
+  nandsimstats_t            stats;
+  /**
+   * @brief   Blocks failing program and erase operations, @p NULL if none.
+   * @details One bit per block of the die row space, used to simulate
+   *          blocks wearing out.
+   */
+  bitmap_t                  *fail_map;
+  /**
+   * @brief   Bit errors injected in each page data read.
+   * @details The errors are transient, the array content is not altered.
+   */
+  uint32_t                  read_flips;
+  /**
+   * @brief   State of the bit errors position generator.
+   */
+  uint32_t                  prng;
+  /**
+   * @brief   Pointer to bad block map.
+   * @details One bit per block. All memory allocation is user's responsibility.
+   */
+  bitmap_t                  *bb_map;
+#if NAND_USE_BBT || defined(__DOXYGEN__)
+  /**
+   * @brief   The bad block table is in use.
+   * @details @p false when @p nandStart() did not create the table.
+   */
+  bool                      bbt_active;
+#endif
+};
+
+/*===========================================================================*/
+/* Driver macros.                                                            */
+/*===========================================================================*/
+
+/**
+ * @brief   Selects the simulated die.
+ * @note    To be called from @p hook_for_chipselect_nand_flash().
+ *
+ * @param[in] nandp         pointer to the @p NANDDriver object
+ * @param[in] d             die number
+ *
+ * @api
+ */
+#define nandsimSelectDie(nandp, d) ((nandp)->die = (d))
+
+/**
+ * @brief   Sets the map of blocks failing program and erase operations.
+ *
+ * @param[in] nandp         pointer to the @p NANDDriver object
+ * @param[in] map           pointer to the @p bitmap_t object or @p NULL
+ *
+ * @api
+ */
+#define nandsimSetFailMap(nandp, map) ((nandp)->fail_map = (map))
+
+/**
+ * @brief   Sets the number of bit errors injected in each page data read.
+ *
+ * @param[in] nandp         pointer to the @p NANDDriver object
+ * @param[in] n             bit errors per read, zero disables injection
+ *
+ * @api
+ */
+#define nandsimSetReadFlips(nandp, n) ((nandp)->read_flips = (n))
+
+/**
+ * @brief   Returns a pointer to the simulated device counters.
+ *
+ * @param[in] nandp         pointer to the @p NANDDriver object
+ *
+ * @api
+ */
+#define nandsimGetStats(nandp) (&(nandp)->stats)
+
+/*===========================================================================*/
+/* External declarations.                                                    */
+/*===========================================================================*/
+
+#if SIM_NAND_USE_NAND1 && !defined(__DOXYGEN__)
+extern NANDDriver NANDD1;
+#endif
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+  void nand_lld_init(void);
+  void nand_lld_start(NANDDriver *nandp);
+  void nand_lld_stop(NANDDriver *nandp);
+  uint8_t nand_lld_erase(NANDDriver *nandp, uint8_t *addr, size_t addrlen);
+  void nand_lld_read_data(NANDDriver *nandp, uint16_t *data,
+                size_t datalen, uint8_t *addr, size_t addrlen, uint32_t *ecc);
+  void nand_lld_write_addr(NANDDriver *nandp, const uint8_t *addr, size_t len);
+  void nand_lld_write_cmd(NANDDriver *nandp, uint8_t cmd);
+  uint8_t nand_lld_write_data(NANDDriver *nandp, const uint16_t *data,
+                size_t datalen, uint8_t *addr, size_t addrlen, uint32_t *ecc);
+  uint8_t nand_lld_read_status(NANDDriver *nandp);
+  void nand_lld_reset(NANDDriver *nandp);
+  uint32_t nand_lld_read_id(NANDDriver *nandp);
+  void nand_lld_read_cached(NANDDriver *nandp, uint16_t *data,
+                size_t datalen, uint8_t *addr, size_t addrlen, size_t npages);
+  uint8_t nand_lld_write_cached(NANDDriver *nandp, const uint16_t *data,
+                size_t datalen, uint8_t *addr, size_t addrlen, size_t npages);
+  uint8_t nand_lld_write_multiplane(NANDDriver *nandp, const uint16_t *data,
+                size_t datalen, uint8_t *addr, size_t addrlen, size_t nplanes);
+  uint8_t nand_lld_erase_multiplane(NANDDriver *nandp, uint8_t *addr,
+                size_t addrlen, size_t nplanes);
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* HAL_USE_NAND */
+
+#endif /* HAL_NAND_LLD_H_ */
+
+/** @} */
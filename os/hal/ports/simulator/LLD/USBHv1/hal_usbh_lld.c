@@ -0,0 +1,874 @@
+/*
+    ChibiOS - Copyright (C) 2006..2017 Giovanni Di Sirio
+              Copyright (C) 2015..2019 Diego Ismirlian, (dismirlian(at)google's mail)
+
+    Licensed under the Apache License, Version 2.0 (the "License");
+    you may not use this file except in compliance with the License.
+    You may obtain a copy of the License at
+
+        http://www.apache.org/licenses/LICENSE-2.0
+
+    Unless required by applicable law or agreed to in writing, software
+    distributed under the License is distributed on an "AS IS" BASIS,
+    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+    See the License for the specific language governing permissions and
+    limitations under the License.
+*/
+
+#include "hal.h"
+
+#if HAL_USE_USBH
+#include "usbh/internal.h"
+#include <string.h>
+
+#define _USBH_DEBUG_HELPER_ENABLE_TRACE		USBH_LLD_DEBUG_ENABLE_TRACE
+#define _USBH_DEBUG_HELPER_ENABLE_INFO		USBH_LLD_DEBUG_ENABLE_INFO
+#define _USBH_DEBUG_HELPER_ENABLE_WARNINGS	USBH_LLD_DEBUG_ENABLE_WARNINGS
+#define _USBH_DEBUG_HELPER_ENABLE_ERRORS	USBH_LLD_DEBUG_ENABLE_ERRORS
+#include "usbh/debug_helpers.h"
+
+#if SIM_USBH_USE_USBH1
+USBHDriver USBHD1;
+#endif
+#if SIM_USBH_USE_USBH2
+USBHDriver USBHD2;
+#endif
+
+/* Bus bytes in a frame and protocol bytes of a transaction (tokens,
+ * handshake, CRC, inter-packet gaps), by speed */
+static const uint32_t _frame_bytes[] = {187, 1500, 60000};
+static const uint32_t _overhead[] = {13, 13, 55};
+
+#define _REQTYPE_TYPE_MASK		0x60
+#define _REQTYPE_RECIP_MASK		0x1f
+
+/*===========================================================================*/
+/* Little helper functions.                                                  */
+/*===========================================================================*/
+static inline usbh_urb_t *_active_urb(usbh_ep_t *ep) {
+	return list_first_entry(&ep->urb_list, usbh_urb_t, node);
+}
+
+static inline uint32_t _halt_bit(uint8_t ep) {
+	return 1U << ((ep & 0x0F) + ((ep & 0x80) ? 16 : 0));
+}
+
+static inline usbh_devspeed_t _bus_speed(USBHDriver *host) {
+	return host->port.device ? host->port.device->config->speed : USBH_DEVSPEED_FULL;
+}
+
+static usbhsim_device_t *_find_device(usbhsim_port_t *port, uint8_t address) {
+	usbhsim_device_t *const dev = port->device;
+	uint8_t i;
+
+	if ((dev == NULL) || !(port->status & USBH_PORTSTATUS_ENABLE))
+		return NULL;
+
+	if (dev->address == address)
+		return dev;
+
+	if (dev->hub) {
+		for (i = 0; i < dev->hub->nports; i++) {
+			usbhsim_device_t *const d = _find_device(&dev->hub->ports[i], address);
+			if (d)
+				return d;
+		}
+	}
+
+	return NULL;
+}
+
+static void _transfer_completedI(USBHDriver *host, usbh_ep_t *ep, usbh_urb_t *urb, usbh_urbstatus_t status) {
+	osalDbgCheckClassI();
+
+	/* remove URB from EP's queue */
+	list_del_init(&urb->node);
+	host->stats.urbs++;
+
+	/* see the STM32 driver: if the callback resubmits, the EP stays queued */
+	_usbh_urb_completeI(urb, status);
+
+	if (list_empty(&ep->urb_list)) {
+		/* no more URBs to process in this EP, remove EP from the host's queue */
+		list_del_init(&ep->node);
+	}
+}
+
+static void _move_all(struct list_head *dst, struct list_head *src) {
+	INIT_LIST_HEAD(dst);
+	while (!list_empty(src))
+		list_move_tail(src->next, dst);
+}
+
+static void _purge_queue(USBHDriver *host, struct list_head *list) {
+	usbh_ep_t *ep, *tmp;
+	list_for_each_entry_safe(ep, usbh_ep_t, tmp, list, node) {
+		while (!list_empty(&ep->urb_list)) {
+			_transfer_completedI(host, ep, _active_urb(ep), USBH_URBSTATUS_DISCONNECTED);
+		}
+	}
+}
+
+/*===========================================================================*/
+/* Simulated devices.                                                        */
+/*===========================================================================*/
+
+static void _device_reset(usbhsim_device_t *dev) {
+	dev->address = 0;
+	dev->configuration = 0;
+	dev->halted = 0;
+}
+
+static uint32_t _copy(uint8_t *buf, uint32_t len, const uint8_t *src, uint32_t srclen) {
+	if (len > srclen)
+		len = srclen;
+	memcpy(buf, src, len);
+	return len;
+}
+
+static uint32_t _string(usbhsim_device_t *dev, uint8_t index, uint8_t *buf, uint32_t len) {
+	uint8_t desc[2 + 2 * 126];
+	uint32_t n = 0;
+
+	if (index == 0) {
+		desc[2] = 0x09;
+		desc[3] = 0x04;
+		n = 4;
+	} else {
+		const char *s = dev->config->strings[index - 1];
+		for (n = 2; *s && (n < sizeof(desc)); n += 2) {
+			desc[n] = (uint8_t)*s++;
+			desc[n + 1] = 0;
+		}
+	}
+	desc[0] = (uint8_t)n;
+	desc[1] = USBH_DT_STRING;
+	return _copy(buf, len, desc, n);
+}
+
+/* Standard requests answered from the descriptors. Returns false for the
+ * requests left to the device. */
+static bool _std_request(usbhsim_device_t *dev, const usbh_control_request_t *req,
+		uint8_t *buf, uint32_t *len, usbhsim_response_t *r) {
+
+	const uint8_t *const cfg = dev->config->config_descriptor;
+	*r = USBHSIM_ACK;
+
+	if ((req->bmRequestType & _REQTYPE_TYPE_MASK) != USBH_REQTYPE_TYPE_STANDARD)
+		return false;
+
+	switch ((req->bmRequestType << 8) | req->bRequest) {
+	case (USBH_REQTYPE_STANDARDIN(USBH_REQTYPE_RECIP_DEVICE) << 8) | USBH_REQ_GET_DESCRIPTOR:
+		switch (req->wValue >> 8) {
+		case USBH_DT_DEVICE:
+			*len = _copy(buf, *len, dev->config->device_descriptor, USBH_DT_DEVICE_SIZE);
+			break;
+		case USBH_DT_CONFIG:
+			if ((req->wValue & 0xff) != 0) {
+				*r = USBHSIM_STALL;
+				break;
+			}
+			*len = _copy(buf, *len, cfg, cfg[2] | (cfg[3] << 8));
+			break;
+		case USBH_DT_STRING:
+			if ((req->wValue & 0xff) > dev->config->strings_count) {
+				*r = USBHSIM_STALL;
+				break;
+			}
+			*len = _string(dev, req->wValue & 0xff, buf, *len);
+			break;
+		default:
+			return false;
+		}
+		break;
+
+	case (USBH_REQTYPE_STANDARDOUT(USBH_REQTYPE_RECIP_DEVICE) << 8) | USBH_REQ_SET_ADDRESS:
+		/* applied by the caller after the status stage */
+		break;
+
+	case (USBH_REQTYPE_STANDARDOUT(USBH_REQTYPE_RECIP_DEVICE) << 8) | USBH_REQ_SET_CONFIGURATION:
+		if ((req->wValue != 0) && (req->wValue != cfg[5])) {
+			*r = USBHSIM_STALL;
+			break;
+		}
+		dev->configuration = (uint8_t)req->wValue;
+		dev->halted = 0;
+		break;
+
+	case (USBH_REQTYPE_STANDARDIN(USBH_REQTYPE_RECIP_DEVICE) << 8) | USBH_REQ_GET_CONFIGURATION:
+		*len = _copy(buf, *len, &dev->configuration, 1);
+		break;
+
+	case (USBH_REQTYPE_STANDARDIN(USBH_REQTYPE_RECIP_DEVICE) << 8) | USBH_REQ_GET_STATUS:
+	case (USBH_REQTYPE_STANDARDIN(USBH_REQTYPE_RECIP_INTERFACE) << 8) | USBH_REQ_GET_STATUS:
+	case (USBH_REQTYPE_STANDARDIN(USBH_REQTYPE_RECIP_ENDPOINT) << 8) | USBH_REQ_GET_STATUS: {
+		uint8_t status[2] = {0, 0};
+		if ((req->bmRequestType & _REQTYPE_RECIP_MASK) == USBH_REQTYPE_RECIP_ENDPOINT)
+			status[0] = (dev->halted & _halt_bit(req->wIndex)) ? 1 : 0;
+		*len = _copy(buf, *len, status, 2);
+	}	break;
+
+	case (USBH_REQTYPE_STANDARDOUT(USBH_REQTYPE_RECIP_ENDPOINT) << 8) | USBH_REQ_CLEAR_FEATURE:
+		dev->halted &= ~_halt_bit(req->wIndex);
+		break;
+
+	case (USBH_REQTYPE_STANDARDOUT(USBH_REQTYPE_RECIP_ENDPOINT) << 8) | USBH_REQ_SET_FEATURE:
+		dev->halted |= _halt_bit(req->wIndex);
+		break;
+
+	case (USBH_REQTYPE_STANDARDOUT(USBH_REQTYPE_RECIP_DEVICE) << 8) | USBH_REQ_CLEAR_FEATURE:
+	case (USBH_REQTYPE_STANDARDOUT(USBH_REQTYPE_RECIP_DEVICE) << 8) | USBH_REQ_SET_FEATURE:
+		/* remote wakeup, test mode */
+		break;
+
+	default:
+		return false;
+	}
+
+	return true;
+}
+
+/*===========================================================================*/
+/* Ports and the hub model.                                                  */
+/*===========================================================================*/
+
+static void _port_reset(usbhsim_port_t *port) {
+	port->status &= ~(USBH_PORTSTATUS_LOW_SPEED | USBH_PORTSTATUS_HIGH_SPEED);
+	if ((port->status & USBH_PORTSTATUS_CONNECTION) && port->device) {
+		_device_reset(port->device);
+		if (port->device->config->speed == USBH_DEVSPEED_LOW)
+			port->status |= USBH_PORTSTATUS_LOW_SPEED;
+		else if (port->device->config->speed == USBH_DEVSPEED_HIGH)
+			port->status |= USBH_PORTSTATUS_HIGH_SPEED;
+		port->status |= USBH_PORTSTATUS_ENABLE;
+	}
+	port->c_status |= USBH_PORTSTATUS_C_RESET;
+}
+
+/* An attached device is powered up: it answers at the default address and
+ * the ports of a hub are unpowered, with the devices behind them */
+static void _device_power_up(usbhsim_device_t *dev) {
+	uint8_t i;
+
+	_device_reset(dev);
+	if (dev->hub == NULL)
+		return;
+
+	for (i = 0; i < dev->hub->nports; i++) {
+		usbhsim_port_t *const port = &dev->hub->ports[i];
+		port->status = 0;
+		port->c_status = 0;
+		if (port->device) {
+			port->status = USBH_PORTSTATUS_CONNECTION;
+			port->c_status = USBH_PORTSTATUS_C_CONNECTION;
+			_device_power_up(port->device);
+		}
+	}
+}
+
+static void _port_connect(usbhsim_port_t *port, usbhsim_device_t *dev) {
+	_device_power_up(dev);
+	port->device = dev;
+	port->status = (port->status & USBH_PORTSTATUS_POWER) | USBH_PORTSTATUS_CONNECTION;
+	port->c_status |= USBH_PORTSTATUS_C_CONNECTION;
+}
+
+static void _port_disconnect(usbhsim_port_t *port) {
+	if (port->status & USBH_PORTSTATUS_ENABLE)
+		port->c_status |= USBH_PORTSTATUS_C_ENABLE;
+	port->device = NULL;
+	port->status &= USBH_PORTSTATUS_POWER;
+	port->c_status |= USBH_PORTSTATUS_C_CONNECTION;
+}
+
+/* Port requests, common to the root port and the simulated hubs */
+static usbhsim_response_t _port_request(usbhsim_port_t *port, uint16_t typereq,
+		uint16_t wvalue, uint8_t *buf, uint32_t *len) {
+
+	switch (typereq) {
+	case GetPortStatus: {
+		const uint8_t status[4] = {
+			port->status & 0xff, port->status >> 8,
+			port->c_status & 0xff, port->c_status >> 8
+		};
+		*len = _copy(buf, *len, status, 4);
+	}	break;
+
+	case ClearPortFeature:
+		switch (wvalue) {
+		case USBH_PORT_FEAT_ENABLE:
+			port->status &= ~USBH_PORTSTATUS_ENABLE;
+			break;
+		case USBH_PORT_FEAT_POWER:
+			port->status &= ~(USBH_PORTSTATUS_POWER | USBH_PORTSTATUS_ENABLE);
+			break;
+		case USBH_PORT_FEAT_SUSPEND:
+			port->status &= ~USBH_PORTSTATUS_SUSPEND;
+			break;
+		case USBH_PORT_FEAT_C_CONNECTION:
+		case USBH_PORT_FEAT_C_ENABLE:
+		case USBH_PORT_FEAT_C_SUSPEND:
+		case USBH_PORT_FEAT_C_OVERCURRENT:
+		case USBH_PORT_FEAT_C_RESET:
+			port->c_status &= ~(1 << (wvalue - USBH_PORT_FEAT_C_CONNECTION));
+			break;
+		default:
+			return USBHSIM_STALL;
+		}
+		break;
+
+	case SetPortFeature:
+		switch (wvalue) {
+		case USBH_PORT_FEAT_RESET:
+			_port_reset(port);
+			break;
+		case USBH_PORT_FEAT_POWER:
+			port->status |= USBH_PORTSTATUS_POWER;
+			break;
+		case USBH_PORT_FEAT_SUSPEND:
+			port->status |= USBH_PORTSTATUS_SUSPEND;
+			break;
+		default:
+			return USBHSIM_STALL;
+		}
+		break;
+
+	default:
+		return USBHSIM_STALL;
+	}
+
+	return USBHSIM_ACK;
+}
+
+static const uint8_t _hub_device_descriptor[][USBH_DT_DEVICE_SIZE] = {
+	{
+		USBH_DT_DEVICE_SIZE, USBH_DT_DEVICE,
+		0x10, 0x01,		/* bcdUSB */
+		0x09, 0x00, 0x00, 64,
+		0x09, 0x12,		/* idVendor */
+		0x01, 0x00,		/* idProduct */
+		0x00, 0x01,		/* bcdDevice */
+		0, 0, 0, 1
+	}, {
+		USBH_DT_DEVICE_SIZE, USBH_DT_DEVICE,
+		0x00, 0x02,		/* bcdUSB */
+		0x09, 0x00, 0x01, 64,
+		0x09, 0x12,		/* idVendor */
+		0x02, 0x00,		/* idProduct */
+		0x00, 0x01,		/* bcdDevice */
+		0, 0, 0, 1
+	}
+};
+
+static const uint8_t _hub_config_descriptor[][25] = {
+	{
+		USBH_DT_CONFIG_SIZE, USBH_DT_CONFIG, 25, 0, 1, 1, 0, 0xe0, 0,
+		USBH_DT_INTERFACE_SIZE, USBH_DT_INTERFACE, 0, 0, 1, 0x09, 0x00, 0x00, 0,
+		USBH_DT_ENDPOINT_SIZE, USBH_DT_ENDPOINT, 0x81, USBH_EPTYPE_INT, 1, 0, 12
+	}, {
+		USBH_DT_CONFIG_SIZE, USBH_DT_CONFIG, 25, 0, 1, 1, 0, 0xe0, 0,
+		USBH_DT_INTERFACE_SIZE, USBH_DT_INTERFACE, 0, 0, 1, 0x09, 0x00, 0x00, 0,
+		USBH_DT_ENDPOINT_SIZE, USBH_DT_ENDPOINT, 0x81, USBH_EPTYPE_INT, 1, 0, 8
+	}
+};
+
+static usbhsim_response_t _hub_control(usbhsim_device_t *dev,
+		const usbh_control_request_t *req, uint8_t *buf, uint32_t *len) {
+
+	usbhsim_hub_t *const hub = dev->hub;
+	const uint16_t typereq = (req->bmRequestType << 8) | req->bRequest;
+
+	switch (typereq) {
+	case GetHubDescriptor: {
+		const uint8_t desc[] = {
+			9, USBH_DT_HUB, hub->nports,
+			0x09, 0x00,		/* wHubCharacteristics: per-port power and overcurrent */
+			1, 0,			/* bPwrOn2PwrGood, bHubContrCurrent */
+			0x00, 0xff		/* DeviceRemovable, PortPwrCtrlMask */
+		};
+		*len = _copy(buf, *len, desc, sizeof(desc));
+	}	break;
+
+	case GetHubStatus: {
+		const uint8_t status[4] = {0, 0, 0, 0};
+		*len = _copy(buf, *len, status, 4);
+	}	break;
+
+	case ClearHubFeature:
+	case SetHubFeature:
+		break;
+
+	case GetPortStatus:
+	case ClearPortFeature:
+	case SetPortFeature:
+		if ((req->wIndex < 1) || (req->wIndex > hub->nports))
+			return USBHSIM_STALL;
+		return _port_request(&hub->ports[req->wIndex - 1], typereq, req->wValue, buf, len);
+
+	default:
+		return USBHSIM_STALL;
+	}
+
+	return USBHSIM_ACK;
+}
+
+static usbhsim_response_t _hub_transfer(usbhsim_device_t *dev,
+		uint8_t ep, uint8_t *buf, uint32_t len, uint32_t *actual) {
+
+	usbhsim_hub_t *const hub = dev->hub;
+	uint8_t bitmap = 0;
+	uint8_t i;
+
+	if ((ep != 0x81) || (len == 0))
+		return USBHSIM_STALL;
+
+	for (i = 0; i < hub->nports; i++) {
+		if (hub->ports[i].c_status)
+			bitmap |= 1 << (i + 1);
+	}
+
+	if (bitmap == 0)
+		return USBHSIM_NAK;
+
+	buf[0] = bitmap;
+	*actual = 1;
+	return USBHSIM_ACK;
+}
+
+static const usbhsim_config_t _hub_config[] = {
+	{
+		USBH_DEVSPEED_FULL,
+		_hub_device_descriptor[0],
+		_hub_config_descriptor[0],
+		NULL, 0,
+		_hub_control,
+		_hub_transfer
+	}, {
+		USBH_DEVSPEED_HIGH,
+		_hub_device_descriptor[1],
+		_hub_config_descriptor[1],
+		NULL, 0,
+		_hub_control,
+		_hub_transfer
+	}
+};
+
+/*===========================================================================*/
+/* Bus scheduler.                                                            */
+/*===========================================================================*/
+
+static bool _control(USBHDriver *host, usbhsim_device_t *dev, usbh_ep_t *ep,
+		usbh_urb_t *urb, uint32_t *budget) {
+
+	const usbh_control_request_t *const req = (const usbh_control_request_t *)urb->setup_buff;
+	const bool in = (req->bmRequestType & USBH_REQTYPE_DIR_IN) != 0;
+	uint32_t len = req->wLength;
+	uint32_t cost;
+	usbhsim_response_t r;
+
+	if (len > urb->requestedLength)
+		len = urb->requestedLength;
+
+	/* setup, data and status stages; a long data stage may need more than
+	 * the rest of the frame, it is not split */
+	if (*budget == 0)
+		return FALSE;
+	cost = 3 * _overhead[_bus_speed(host)] + 8 + len;
+	*budget = (cost < *budget) ? *budget - cost : 0;
+	host->stats.transactions++;
+
+	if (!_std_request(dev, req, urb->buff, &len, &r)) {
+		if (dev->config->control) {
+			r = dev->config->control(dev, req, urb->buff, &len);
+		} else if (req->bRequest == USBH_REQ_SET_INTERFACE) {
+			r = USBHSIM_ACK;
+		} else {
+			r = USBHSIM_STALL;
+		}
+	}
+
+	switch (r) {
+	case USBHSIM_ACK:
+		urb->actualLength = len;
+		if (in)
+			host->stats.bytes_in += len;
+		else
+			host->stats.bytes_out += len;
+		if (req->bRequest == USBH_REQ_SET_ADDRESS
+				&& req->bmRequestType == USBH_REQTYPE_STANDARDOUT(USBH_REQTYPE_RECIP_DEVICE))
+			dev->address = (uint8_t)req->wValue;
+		_transfer_completedI(host, ep, urb, USBH_URBSTATUS_OK);
+		return TRUE;
+	case USBHSIM_NAK:
+		host->stats.naks++;
+		ep->nak_frame = host->stats.frames;
+		return FALSE;
+	case USBHSIM_STALL:
+		host->stats.stalls++;
+		_transfer_completedI(host, ep, urb, USBH_URBSTATUS_STALL);
+		return FALSE;
+	default:
+		host->stats.errors++;
+		_transfer_completedI(host, ep, urb, USBH_URBSTATUS_ERROR);
+		return FALSE;
+	}
+}
+
+/* Runs one transaction of the URB at the head of the EP's queue. Returns
+ * TRUE if it moved data. */
+static bool _transaction(USBHDriver *host, usbh_ep_t *ep, uint32_t *budget) {
+	usbh_urb_t *const urb = _active_urb(ep);
+	usbhsim_device_t *const dev = _find_device(&host->port, ep->device->address);
+	const uint8_t epaddr = ep->address | (ep->in ? 0x80 : 0);
+	const uint32_t overhead = _overhead[_bus_speed(host)];
+	uint32_t len, actual;
+	usbhsim_response_t r;
+
+	if (dev == NULL) {
+		/* nobody answers */
+		if (*budget < overhead)
+			return FALSE;
+		*budget -= overhead;
+		host->stats.errors++;
+		_transfer_completedI(host, ep, urb, USBH_URBSTATUS_ERROR);
+		return FALSE;
+	}
+
+	if (ep->type == USBH_EPTYPE_CTRL)
+		return _control(host, dev, ep, urb, budget);
+
+	len = urb->requestedLength - urb->actualLength;
+	if (len > ep->wMaxPacketSize)
+		len = ep->wMaxPacketSize;
+	if (*budget < overhead + len)
+		return FALSE;
+
+	actual = ep->in ? 0 : len;
+	if (dev->halted & _halt_bit(epaddr)) {
+		r = USBHSIM_STALL;
+	} else if (dev->config->transfer) {
+		r = dev->config->transfer(dev, epaddr, (uint8_t *)urb->buff + urb->actualLength, len, &actual);
+	} else {
+		r = USBHSIM_STALL;
+	}
+	host->stats.transactions++;
+
+	if ((r == USBHSIM_NAK) && (ep->type == USBH_EPTYPE_ISO)) {
+		/* no handshake in ISO, the device just had nothing to send */
+		r = USBHSIM_ACK;
+		actual = 0;
+	}
+
+	switch (r) {
+	case USBHSIM_ACK:
+		osalDbgAssert(actual <= len, "babble");
+		if (!ep->in)
+			actual = len;
+		*budget -= overhead + actual;
+		urb->actualLength += actual;
+		if (ep->in)
+			host->stats.bytes_in += actual;
+		else
+			host->stats.bytes_out += actual;
+		if ((ep->type == USBH_EPTYPE_ISO)
+				|| (actual < ep->wMaxPacketSize)
+				|| (urb->actualLength == urb->requestedLength)) {
+			_transfer_completedI(host, ep, urb, USBH_URBSTATUS_OK);
+		}
+		return TRUE;
+
+	case USBHSIM_NAK:
+		*budget -= overhead;
+		host->stats.naks++;
+		if ((ep->type == USBH_EPTYPE_INT) && ep->in) {
+			_transfer_completedI(host, ep, urb, USBH_URBSTATUS_TIMEOUT);
+		} else {
+			ep->nak_frame = host->stats.frames;
+		}
+		return FALSE;
+
+	case USBHSIM_STALL:
+		*budget -= overhead;
+		host->stats.stalls++;
+		if (ep->type != USBH_EPTYPE_ISO) {
+			dev->halted |= _halt_bit(epaddr);
+			ep->status = USBH_EPSTATUS_HALTED;
+		}
+		_transfer_completedI(host, ep, urb, USBH_URBSTATUS_STALL);
+		return FALSE;
+
+	default:
+		*budget -= overhead;
+		host->stats.errors++;
+		_transfer_completedI(host, ep, urb, USBH_URBSTATUS_ERROR);
+		return FALSE;
+	}
+}
+
+static void _frameI(USBHDriver *host) {
+	struct list_head work;
+	usbh_ep_t *ep;
+	uint32_t budget = _frame_bytes[_bus_speed(host)];
+	bool progress;
+	int i;
+
+	host->stats.frames++;
+
+	/* periodic endpoints, once in each due microframe */
+	for (i = 0; i < 8; i++, host->uframe++) {
+		_move_all(&work, &host->ep_periodic);
+		while (!list_empty(&work)) {
+			ep = list_first_entry(&work, usbh_ep_t, node);
+			list_move_tail(&ep->node, &host->ep_periodic);
+			if ((int32_t)(host->uframe - ep->next_uframe) < 0)
+				continue;
+			ep->next_uframe = host->uframe + ep->interval;
+			_transaction(host, ep, &budget);
+		}
+	}
+
+	/* control and bulk endpoints, a packet each per round until the
+	 * frame is full or they all NAK */
+	do {
+		progress = FALSE;
+		_move_all(&work, &host->ep_async);
+		while (!list_empty(&work)) {
+			ep = list_first_entry(&work, usbh_ep_t, node);
+			list_move_tail(&ep->node, &host->ep_async);
+			if (ep->nak_frame == host->stats.frames)
+				continue;
+			if (_transaction(host, ep, &budget))
+				progress = TRUE;
+		}
+	} while (progress);
+}
+
+static void _vt(void *p) {
+	USBHDriver *const host = (USBHDriver *)p;
+	int i;
+
+	osalSysLockFromISR();
+	for (i = 0; i < SIM_USBH_FRAMES_PER_TICK; i++)
+		_frameI(host);
+	chVTSetI(&host->vt, OSAL_MS2I(1), _vt, host);
+	osalSysUnlockFromISR();
+}
+
+
+/*===========================================================================*/
+/* API.                                                                      */
+/*===========================================================================*/
+
+void usbh_lld_ep_object_init(usbh_ep_t *ep) {
+	uint8_t b = ep->bInterval ? ep->bInterval : 1;
+
+	if ((ep->device->speed == USBH_DEVSPEED_HIGH) || (ep->type == USBH_EPTYPE_ISO)) {
+		if (b > 16)
+			b = 16;
+		ep->interval = 1U << (b - 1);
+	} else {
+		ep->interval = b;
+	}
+	if (ep->device->speed != USBH_DEVSPEED_HIGH)
+		ep->interval *= 8;
+
+	ep->next_uframe = 0;
+	ep->nak_frame = 0;
+	INIT_LIST_HEAD(&ep->urb_list);
+	INIT_LIST_HEAD(&ep->node);
+}
+
+void usbh_lld_ep_open(usbh_ep_t *ep) {
+	uepinfof("Open EP");
+	ep->status = USBH_EPSTATUS_OPEN;
+}
+
+void usbh_lld_ep_close(usbh_ep_t *ep) {
+	usbh_urb_t *urb;
+	uepinfof("Closing EP...");
+	while (!list_empty(&ep->urb_list)) {
+		urb = list_first_entry(&ep->urb_list, usbh_urb_t, node);
+		uepinfof("Abort URB, USBH_URBSTATUS_DISCONNECTED");
+		_usbh_urb_abort_and_waitS(urb, USBH_URBSTATUS_DISCONNECTED);
+	}
+	uepinfof("Closed");
+	ep->status = USBH_EPSTATUS_CLOSED;
+}
+
+bool usbh_lld_ep_reset(usbh_ep_t *ep) {
+	(void)ep;
+	return TRUE;
+}
+
+void usbh_lld_urb_submit(usbh_urb_t *urb) {
+	usbh_ep_t *const ep = urb->ep;
+	USBHDriver *const host = ep->device->host;
+
+	if (!(host->port.status & USBH_PORTSTATUS_ENABLE)) {
+		uepwarnf("Can't submit URB, port disabled");
+		_usbh_urb_completeI(urb, USBH_URBSTATUS_DISCONNECTED);
+		return;
+	}
+
+	/* add the URB to the EP's queue */
+	list_add_tail(&urb->node, &ep->urb_list);
+
+	/* schedule the EP if it wasn't */
+	if (list_empty(&ep->node)) {
+		if (usbhEPIsPeriodic(ep)) {
+			if ((int32_t)(host->uframe - ep->next_uframe) > 0)
+				ep->next_uframe = host->uframe;
+			list_add_tail(&ep->node, &host->ep_periodic);
+		} else {
+			list_add_tail(&ep->node, &host->ep_async);
+		}
+	}
+}
+
+/* Transactions run atomically in the frame timer, so a queued URB can
+ * always be completed right away */
+bool usbh_lld_urb_abort(usbh_urb_t *urb, usbh_urbstatus_t status) {
+	osalDbgCheck(usbhURBIsBusy(urb));
+
+	usbh_ep_t *const ep = urb->ep;
+	osalDbgCheck(ep);
+
+	_transfer_completedI(ep->device->host, ep, urb, status);
+	return TRUE;
+}
+
+static void _init(USBHDriver *host) {
+	usbhObjectInit(host);
+	memset(&host->port, 0, sizeof(host->port));
+	INIT_LIST_HEAD(&host->ep_periodic);
+	INIT_LIST_HEAD(&host->ep_async);
+	chVTObjectInit(&host->vt);
+	host->uframe = 0;
+	memset(&host->stats, 0, sizeof(host->stats));
+}
+
+void usbh_lld_init(void) {
+#if SIM_USBH_USE_USBH1
+	_init(&USBHD1);
+#endif
+#if SIM_USBH_USE_USBH2
+	_init(&USBHD2);
+#endif
+}
+
+/* Called by usbhStart() and usbhStop() with the kernel locked */
+void usbh_lld_start(USBHDriver *host) {
+	host->port.status |= USBH_PORTSTATUS_POWER;
+	chVTSetI(&host->vt, OSAL_MS2I(1), _vt, host);
+}
+
+void usbh_lld_stop(USBHDriver *host) {
+	chVTResetI(&host->vt);
+	_purge_queue(host, &host->ep_periodic);
+	_purge_queue(host, &host->ep_async);
+	host->port.status &= ~(USBH_PORTSTATUS_POWER | USBH_PORTSTATUS_ENABLE);
+	osalOsRescheduleS();
+}
+
+/*===========================================================================*/
+/* Root Hub request handler.                                                 */
+/*===========================================================================*/
+usbh_urbstatus_t usbh_lld_root_hub_request(USBHDriver *host, uint8_t bmRequestType, uint8_t bRequest,
+		uint16_t wvalue, uint16_t windex, uint16_t wlength, uint8_t *buf) {
+
+	const uint16_t typereq = (bmRequestType << 8) | bRequest;
+	uint32_t len = wlength;
+	usbhsim_response_t r = USBHSIM_ACK;
+
+	osalSysLock();
+	switch (typereq) {
+	case ClearHubFeature:
+	case SetHubFeature:
+		break;
+
+	case GetHubStatus:
+		osalDbgCheck(wlength >= 4);
+		memset(buf, 0, 4);
+		break;
+
+	case GetPortStatus:
+	case ClearPortFeature:
+	case SetPortFeature:
+		osalDbgAssert(windex == 1, "invalid windex");
+		r = _port_request(&host->port, typereq, wvalue, buf, &len);
+		break;
+
+	default:
+		r = USBHSIM_STALL;
+		break;
+	}
+	osalSysUnlock();
+
+	return (r == USBHSIM_ACK) ? USBH_URBSTATUS_OK : USBH_URBSTATUS_STALL;
+}
+
+uint8_t usbh_lld_roothub_get_statuschange_bitmap(USBHDriver *host) {
+	return host->port.c_status ? (1 << 1) : 0;
+}
+
+/*===========================================================================*/
+/* Simulated bus API.                                                        */
+/*===========================================================================*/
+
+void usbhsimDeviceObjectInit(usbhsim_device_t *dev, const usbhsim_config_t *config, void *user) {
+	osalDbgCheck((dev != NULL) && (config != NULL)
+			&& (config->device_descriptor != NULL)
+			&& (config->config_descriptor != NULL));
+	memset(dev, 0, sizeof(*dev));
+	dev->config = config;
+	dev->user = user;
+}
+
+void usbhsimAttach(USBHDriver *usbh, usbhsim_device_t *dev) {
+	osalDbgCheck((usbh != NULL) && (dev != NULL));
+	osalSysLock();
+	osalDbgAssert(usbh->port.device == NULL, "port busy");
+	_port_connect(&usbh->port, dev);
+	_usbh_notifyI(usbh, USBH_EVENT_PORT_CHANGE);
+	osalOsRescheduleS();
+	osalSysUnlock();
+}
+
+void usbhsimDetach(USBHDriver *usbh) {
+	osalDbgCheck(usbh != NULL);
+	osalSysLock();
+	_port_disconnect(&usbh->port);
+	_purge_queue(usbh, &usbh->ep_periodic);
+	_purge_queue(usbh, &usbh->ep_async);
+	_usbh_notifyI(usbh, USBH_EVENT_PORT_CHANGE);
+	osalOsRescheduleS();
+	osalSysUnlock();
+}
+
+void usbhsimHubObjectInit(usbhsim_hub_t *hub, usbh_devspeed_t speed, uint8_t nports) {
+	osalDbgCheck((hub != NULL) && (speed != USBH_DEVSPEED_LOW)
+			&& (nports > 0) && (nports <= USBHSIM_HUB_MAX_PORTS));
+	memset(hub, 0, sizeof(*hub));
+	usbhsimDeviceObjectInit(&hub->dev, &_hub_config[speed == USBH_DEVSPEED_HIGH], NULL);
+	hub->dev.hub = hub;
+	hub->nports = nports;
+}
+
+/* Devices behind a hub are noticed by the host at its next status change
+ * poll */
+void usbhsimHubAttach(usbhsim_hub_t *hub, uint8_t port, usbhsim_device_t *dev) {
+	osalDbgCheck((hub != NULL) && (dev != NULL) && (port >= 1) && (port <= hub->nports));
+	osalSysLock();
+	osalDbgAssert(hub->ports[port - 1].device == NULL, "port busy");
+	_port_connect(&hub->ports[port - 1], dev);
+	osalSysUnlock();
+}
+
+void usbhsimHubDetach(usbhsim_hub_t *hub, uint8_t port) {
+	osalDbgCheck((hub != NULL) && (port >= 1) && (port <= hub->nports));
+	osalSysLock();
+	_port_disconnect(&hub->ports[port - 1]);
+	osalSysUnlock();
+}
+
+#endif
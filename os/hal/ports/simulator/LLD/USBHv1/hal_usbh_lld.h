@@ -0,0 +1,219 @@
+/*
+    ChibiOS - Copyright (C) 2006..2017 Giovanni Di Sirio
+              Copyright (C) 2015..2019 Diego Ismirlian, (dismirlian(at)google's mail)
+
+    Licensed under the Apache License, Version 2.0 (the "License");
+    you may not use this file except in compliance with the License.
+    You may obtain a copy of the License at
+
+        http://www.apache.org/licenses/LICENSE-2.0
+
+    Unless required by applicable law or agreed to in writing, software
+    distributed under the License is distributed on an "AS IS" BASIS,
+    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+    See the License for the specific language governing permissions and
+    limitations under the License.
+*/
+
+/*
+ * Simulated USB host controller.
+ *
+ * The bus is driven by a virtual timer: at every frame the periodic
+ * endpoints due in each of the 8 microframes are served first, then the
+ * control and bulk endpoints share what is left of the frame bandwidth,
+ * one packet per endpoint and round. Every transaction costs its payload
+ * plus a fixed protocol overhead, so the throughput measured in frames is
+ * close to the one of a real bus of the same speed.
+ *
+ * Devices are scripted by the application: a usbhsim_config_t gives the
+ * descriptors, served by the simulator for the standard requests, and two
+ * callbacks for the other control requests and for the data endpoints.
+ * A hub model is built in, so trees of devices can be enumerated.
+ */
+
+#ifndef HAL_USBH_LLD_H
+#define HAL_USBH_LLD_H
+
+#include "hal.h"
+
+#if HAL_USE_USBH
+
+#include "osal.h"
+
+/* USBHD1 driver enable switch */
+#if !defined(SIM_USBH_USE_USBH1)
+#define SIM_USBH_USE_USBH1					TRUE
+#endif
+
+/* USBHD2 driver enable switch, a second independent bus */
+#if !defined(SIM_USBH_USE_USBH2)
+#define SIM_USBH_USE_USBH2					FALSE
+#endif
+
+/* Frames run at every timer tick; values above 1 run the bus faster than
+ * real time, the statistics are kept in frames anyway. */
+#if !defined(SIM_USBH_FRAMES_PER_TICK)
+#define SIM_USBH_FRAMES_PER_TICK			1
+#endif
+
+#if !SIM_USBH_USE_USBH1 && !SIM_USBH_USE_USBH2
+#error "USBH driver activated but no USBH peripheral assigned"
+#endif
+
+#if SIM_USBH_FRAMES_PER_TICK < 1
+#error "SIM_USBH_FRAMES_PER_TICK must be at least 1"
+#endif
+
+/* The debug helpers timestamp with the OTG frame registers */
+#if defined(USBH_DEBUG_ENABLE) && USBH_DEBUG_ENABLE
+#error "USBH_DEBUG_ENABLE is not supported by the simulated host"
+#endif
+
+/* Maximum number of downstream ports of a simulated hub (one status
+ * change byte) */
+#define USBHSIM_HUB_MAX_PORTS				7
+
+typedef struct usbhsim_device usbhsim_device_t;
+typedef struct usbhsim_hub usbhsim_hub_t;
+
+/* Handshake of a simulated device */
+typedef enum {
+	USBHSIM_ACK,
+	USBHSIM_NAK,
+	USBHSIM_STALL,
+	USBHSIM_ERROR		/* no handshake (CRC, timeout) */
+} usbhsim_response_t;
+
+/* Control requests not handled by the simulator. For IN requests buf has
+ * room for *len bytes and *len must be set to the bytes returned; for OUT
+ * requests buf holds *len bytes. Called from the frame timer in the
+ * I-locked state. */
+typedef usbhsim_response_t (*usbhsim_control_cb_t)(usbhsim_device_t *dev,
+		const usbh_control_request_t *req, uint8_t *buf, uint32_t *len);
+
+/* One transaction on a data endpoint; ep includes the direction bit. For
+ * IN endpoints up to len bytes are written to buf and *actual is set, a
+ * short packet ends the transfer. For OUT endpoints buf holds len bytes.
+ * Called from the frame timer in the I-locked state. */
+typedef usbhsim_response_t (*usbhsim_transfer_cb_t)(usbhsim_device_t *dev,
+		uint8_t ep, uint8_t *buf, uint32_t len, uint32_t *actual);
+
+typedef struct {
+	usbh_devspeed_t speed;
+	const uint8_t *device_descriptor;
+	const uint8_t *config_descriptor;	/* whole configuration, one only */
+	const char * const *strings;		/* string descriptors 1..n, ASCII */
+	uint8_t strings_count;
+	usbhsim_control_cb_t control;
+	usbhsim_transfer_cb_t transfer;
+} usbhsim_config_t;
+
+struct usbhsim_device {
+	const usbhsim_config_t *config;
+	void *user;							/* application data */
+	usbhsim_hub_t *hub;					/* set if the device is a hub */
+	uint8_t address;
+	uint8_t configuration;
+	uint32_t halted;					/* halted endpoints, IN ones from bit 16 */
+};
+
+typedef struct {
+	usbhsim_device_t *device;
+	uint16_t status;
+	uint16_t c_status;
+} usbhsim_port_t;
+
+struct usbhsim_hub {
+	usbhsim_device_t dev;
+	uint8_t nports;
+	usbhsim_port_t ports[USBHSIM_HUB_MAX_PORTS];
+};
+
+typedef struct {
+	uint32_t frames;
+	uint32_t transactions;
+	uint32_t naks;
+	uint32_t stalls;
+	uint32_t errors;
+	uint32_t urbs;			/* URBs completed */
+	uint64_t bytes_in;
+	uint64_t bytes_out;
+} usbhsim_stats_t;
+
+
+#define _usbhdriver_ll_data											\
+	/* root port */													\
+	usbhsim_port_t port;											\
+	/* endpoints with queued URBs */								\
+	struct list_head ep_periodic;									\
+	struct list_head ep_async;										\
+	virtual_timer_t vt;												\
+	uint32_t uframe;												\
+	usbhsim_stats_t stats;
+
+
+#define _usbh_ep_ll_data																\
+		struct list_head	urb_list;			/* list of URBs queued in this EP */	\
+		struct list_head	node;				/* this EP */							\
+		uint32_t			interval;			/* polling interval (microframes) */	\
+		uint32_t			next_uframe;		/* next service (periodic) */			\
+		uint32_t			nak_frame;			/* last NAK (non-periodic) */
+
+
+#define _usbh_port_ll_data
+
+#define _usbh_device_ll_data
+
+#define _usbh_hub_ll_data
+
+#define _usbh_urb_ll_data		\
+	struct list_head node;
+
+
+#define usbh_lld_urb_object_init(urb) 									\
+		do {															\
+			INIT_LIST_HEAD(&urb->node);									\
+		} while (0)
+
+
+#define usbh_lld_urb_object_reset(urb) 									\
+		do {															\
+			osalDbgAssert(list_empty(&urb->node), "wrong state");		\
+		} while (0)
+
+void usbh_lld_init(void);
+void usbh_lld_start(USBHDriver *usbh);
+void usbh_lld_stop(USBHDriver *usbh);
+void usbh_lld_ep_object_init(usbh_ep_t *ep);
+void usbh_lld_ep_open(usbh_ep_t *ep);
+void usbh_lld_ep_close(usbh_ep_t *ep);
+bool usbh_lld_ep_reset(usbh_ep_t *ep);
+void usbh_lld_urb_submit(usbh_urb_t *urb);
+bool usbh_lld_urb_abort(usbh_urb_t *urb, usbh_urbstatus_t status);
+usbh_urbstatus_t usbh_lld_root_hub_request(USBHDriver *usbh, uint8_t bmRequestType, uint8_t bRequest,
+		uint16_t wvalue, uint16_t windex, uint16_t wlength, uint8_t *buf);
+uint8_t usbh_lld_roothub_get_statuschange_bitmap(USBHDriver *usbh);
+
+/* Simulated bus */
+void usbhsimDeviceObjectInit(usbhsim_device_t *dev, const usbhsim_config_t *config, void *user);
+void usbhsimAttach(USBHDriver *usbh, usbhsim_device_t *dev);
+void usbhsimDetach(USBHDriver *usbh);
+void usbhsimHubObjectInit(usbhsim_hub_t *hub, usbh_devspeed_t speed, uint8_t nports);
+void usbhsimHubAttach(usbhsim_hub_t *hub, uint8_t port, usbhsim_device_t *dev);
+void usbhsimHubDetach(usbhsim_hub_t *hub, uint8_t port);
+#define usbhsimHubGetDevice(hub)	(&(hub)->dev)
+#define usbhsimGetStats(usbh)		(&(usbh)->stats)
+
+#define USBH_LLD_DEFINE_BUFFER(var) var __attribute__((aligned(4)))
+#define USBH_LLD_DECLARE_STRUCT_MEMBER(member) member __attribute__((aligned(4)))
+
+#if SIM_USBH_USE_USBH1
+extern USBHDriver USBHD1;
+#endif
+#if SIM_USBH_USE_USBH2
+extern USBHDriver USBHD2;
+#endif
+
+#endif
+
+#endif /* HAL_USBH_LLD_H */
@@ -37,6 +37,64 @@
 /* Driver local functions.                                                   */
 /*===========================================================================*/
 
+#if (CRC_USE_COMBINE == TRUE) || defined(__DOXYGEN__)
+/**
+ * @brief   Reflects the @p nbits low order bits of @p data.
+ */
+static uint32_t crc_reflect(uint32_t data, uint32_t nbits) {
+  uint32_t reflection = 0;
+  uint32_t bit;
+
+  for (bit = 0; bit < nbits; bit++) {
+    reflection = (reflection << 1) | (data & 1U);
+    data >>= 1;
+  }
+
+  return reflection;
+}
+
+/**
+ * @brief   Brings a CRC value to the LSB first register domain and back.
+ * @details Appending zeros does not depend on the data bit order, so both
+ *          reflected and MSB first configurations are combined in the
+ *          reflected domain, the mapping is its own inverse.
+ */
+static uint32_t crc_to_reflected(const CRCConfig *config, uint32_t crc) {
+
+  return config->reflect_remainder ? crc :
+                                     crc_reflect(crc, config->poly_size);
+}
+
+/**
+ * @brief   Multiplies a GF(2) matrix by a vector.
+ */
+static uint32_t gf2_matrix_times(const uint32_t *mat, uint32_t vec) {
+  uint32_t sum = 0;
+
+  while (vec != 0U) {
+    if ((vec & 1U) != 0U) {
+      sum ^= *mat;
+    }
+    vec >>= 1;
+    mat++;
+  }
+
+  return sum;
+}
+
+/**
+ * @brief   Squares a GF(2) matrix of @p width columns.
+ */
+static void gf2_matrix_square(uint32_t *square, const uint32_t *mat,
+                              uint32_t width) {
+  uint32_t n;
+
+  for (n = 0; n < width; n++) {
+    square[n] = gf2_matrix_times(mat, mat[n]);
+  }
+}
+#endif /* CRC_USE_COMBINE == TRUE */
+
 /*===========================================================================*/
 /* Driver exported functions.                                                */
 /*===========================================================================*/
@@ -227,6 +285,85 @@ void crcStartCalcI(CRCDriver *crcp, size_t n, const void *buf) {
 }
 #endif
 
+#if (CRC_USE_COMBINE == TRUE) || defined(__DOXYGEN__)
+/**
+ * @brief   Combines the CRCs of two consecutive buffers.
+ * @details Returns the CRC of the concatenation A|B given the CRC of A,
+ *          the CRC of B and the length of B, both computed from the
+ *          configured initial value with the active configuration.
+ *          This allows chunks of a buffer to be checksummed independently,
+ *          out of order or in parallel, and merged afterwards.
+ * @note    The cost is O(log(len_b)) GF(2) matrix squarings and does not
+ *          depend on the data, the CRC unit is not used.
+ *
+ * @param[in] crcp      pointer to the @p CRCDriver object
+ * @param[in] crc_a     final CRC of the first buffer
+ * @param[in] crc_b     final CRC of the second buffer
+ * @param[in] len_b     length of the second buffer in bytes
+ * @return              The final CRC of the concatenated buffers.
+ *
+ * @api
+ */
+uint32_t crcCombine(CRCDriver *crcp, uint32_t crc_a, uint32_t crc_b,
+                    size_t len_b) {
+  const CRCConfig *config;
+  uint32_t even[32], odd[32];
+  uint32_t width, mask, row, n, crc;
+
+  osalDbgCheck(crcp != NULL);
+  osalDbgAssert((crcp->state == CRC_READY) && (crcp->config != NULL),
+                "not ready");
+
+  config = crcp->config;
+  width  = config->poly_size;
+  mask   = 1UL << (width - 1);
+  mask  |= mask - 1;
+
+  if (len_b == 0U) {
+    return crc_a;
+  }
+
+  /* Register of A, seen as if B had been processed from a zero initial
+     value.*/
+  crc = crc_to_reflected(config, (crc_a ^ config->final_val) & mask) ^
+        crc_reflect(config->initial_val, width);
+
+  /* Operator for one zero bit.*/
+  odd[0] = crc_reflect(config->poly, width);
+  row = 1;
+  for (n = 1; n < width; n++) {
+    odd[n] = row;
+    row <<= 1;
+  }
+
+  /* Operators for two and four zero bits.*/
+  gf2_matrix_square(even, odd, width);
+  gf2_matrix_square(odd, even, width);
+
+  /* Applies len_b zero bytes, one squaring per bit of len_b.*/
+  do {
+    gf2_matrix_square(even, odd, width);
+    if ((len_b & 1U) != 0U) {
+      crc = gf2_matrix_times(even, crc);
+    }
+    len_b >>= 1;
+    if (len_b == 0U) {
+      break;
+    }
+
+    gf2_matrix_square(odd, even, width);
+    if ((len_b & 1U) != 0U) {
+      crc = gf2_matrix_times(odd, crc);
+    }
+    len_b >>= 1;
+  } while (len_b != 0U);
+
+  crc ^= crc_to_reflected(config, (crc_b ^ config->final_val) & mask);
+
+  return (crc_to_reflected(config, crc) ^ config->final_val) & mask;
+}
+#endif /* CRC_USE_COMBINE == TRUE */
+
 #if (CRC_USE_MUTUAL_EXCLUSION == TRUE) || defined(__DOXYGEN__)
 /**
  * @brief   Gains exclusive access to the CRC unit.
@@ -108,6 +108,64 @@ static systime_t calc_timeout(I2CDriver *i2cp, size_t txbytes, size_t rxbytes) {
   return TIME_MS2I(tmo);
 }
 
+/**
+ * @brief   I2C transaction with ACK polling.
+ * @details During its internal write cycle the IC does not acknowledge its
+ *          address, so the transaction is retried until it does or until
+ *          @p write_time expires. The bus is released between the attempts.
+ *
+ * @param[in] eepcfg    pointer to configuration structure of eeprom file
+ * @param[in] txbuf     pointer to buffer to be transmitted
+ * @param[in] txbytes   number of bytes to be transmitted
+ * @param[out] rxbuf    pointer to buffer to be received
+ * @param[in] rxbytes   number of bytes to be received
+ */
+static msg_t eeprom_transmit_polled(const I2CEepromFileConfig *eepcfg,
+                                    const uint8_t *txbuf, size_t txbytes,
+                                    uint8_t *rxbuf, size_t rxbytes) {
+
+  msg_t status;
+  i2cflags_t errors;
+  systime_t tmo = calc_timeout(eepcfg->i2cp, txbytes, rxbytes);
+  systime_t now = chVTGetSystemTimeX();
+
+  while (true) {
+#if I2C_USE_MUTUAL_EXCLUSION
+    i2cAcquireBus(eepcfg->i2cp);
+#endif
+
+    status = i2cMasterTransmitTimeout(eepcfg->i2cp, eepcfg->addr,
+                                      txbuf, txbytes, rxbuf, rxbytes, tmo);
+    errors = i2cGetErrors(eepcfg->i2cp);
+
+#if I2C_USE_MUTUAL_EXCLUSION
+    i2cReleaseBus(eepcfg->i2cp);
+#endif
+
+    /* anything but a NACK is final */
+    if ((status != MSG_RESET) || ((errors & I2C_ACK_FAILURE) == 0))
+      return status;
+
+    if ((chVTGetSystemTimeX() - now) > eepcfg->write_time)
+      return status;
+
+    chThdYield();
+  }
+}
+
+/**
+ * @brief   Waits the end of the write cycle of the IC.
+ * @details Polls with a bare address write, which does not start a new
+ *          write cycle.
+ *
+ * @param[in] eepcfg    pointer to configuration structure of eeprom file
+ */
+static msg_t eeprom_wait(const I2CEepromFileConfig *eepcfg) {
+
+  eeprom_split_addr(eepcfg->write_buf, eepcfg->barrier_low);
+  return eeprom_transmit_polled(eepcfg, eepcfg->write_buf, 2, NULL, 0);
+}
+
 /**
  * @brief   EEPROM read routine.
  *
@@ -119,31 +177,20 @@ static systime_t calc_timeout(I2CDriver *i2cp, size_t txbytes, size_t rxbytes) {
 static msg_t eeprom_read(const I2CEepromFileConfig *eepcfg,
                          uint32_t offset, uint8_t *data, size_t len) {
 
-  msg_t status = MSG_RESET;
-  systime_t tmo = calc_timeout(eepcfg->i2cp, 2, len);
-
   osalDbgAssert(((len <= eepcfg->size) && ((offset + len) <= eepcfg->size)),
              "out of device bounds");
 
   eeprom_split_addr(eepcfg->write_buf, (offset + eepcfg->barrier_low));
 
-#if I2C_USE_MUTUAL_EXCLUSION
-  i2cAcquireBus(eepcfg->i2cp);
-#endif
-
-  status = i2cMasterTransmitTimeout(eepcfg->i2cp, eepcfg->addr,
-                                    eepcfg->write_buf, 2, data, len, tmo);
-
-#if I2C_USE_MUTUAL_EXCLUSION
-  i2cReleaseBus(eepcfg->i2cp);
-#endif
-
-  return status;
+  /* the IC may still be busy with the last page written */
+  return eeprom_transmit_polled(eepcfg, eepcfg->write_buf, 2, data, len);
 }
 
 /**
  * @brief   EEPROM write routine.
- * @details Function writes data to EEPROM.
+ * @details Function writes data to EEPROM. It returns as soon as the IC has
+ *          accepted the page, without waiting for the write cycle: the next
+ *          transaction is ACK polled.
  * @pre     Data must be fit to single EEPROM page.
  *
  * @param[in] eepcfg  pointer to configuration structure of eeprom file
@@ -153,9 +200,6 @@ static msg_t eeprom_read(const I2CEepromFileConfig *eepcfg,
  */
 static msg_t eeprom_write(const I2CEepromFileConfig *eepcfg, uint32_t offset,
                           const uint8_t *data, size_t len) {
-  msg_t status = MSG_RESET;
-  systime_t tmo = calc_timeout(eepcfg->i2cp, (len + 2), 0);
-
   osalDbgAssert(((len <= eepcfg->size) && ((offset + len) <= eepcfg->size)),
              "out of device bounds");
   osalDbgAssert((((offset + eepcfg->barrier_low) / eepcfg->pagesize) ==
@@ -167,21 +211,7 @@ static msg_t eeprom_write(const I2CEepromFileConfig *eepcfg, uint32_t offset,
   /* write data bytes */
   memcpy(&(eepcfg->write_buf[2]), data, len);
 
-#if I2C_USE_MUTUAL_EXCLUSION
-  i2cAcquireBus(eepcfg->i2cp);
-#endif
-
-  status = i2cMasterTransmitTimeout(eepcfg->i2cp, eepcfg->addr,
-                                    eepcfg->write_buf, (len + 2), NULL, 0, tmo);
-
-#if I2C_USE_MUTUAL_EXCLUSION
-  i2cReleaseBus(eepcfg->i2cp);
-#endif
-
-  /* wait until EEPROM process data */
-  chThdSleep(eepcfg->write_time);
-
-  return status;
+  return eeprom_transmit_polled(eepcfg, eepcfg->write_buf, (len + 2), NULL, 0);
 }
 
 /**
@@ -215,13 +245,14 @@ static msg_t __fitted_write(void *ip, const uint8_t *data, size_t len, uint32_t
 }
 
 /**
- * @brief     Write data to EEPROM.
+ * @brief     Write data to EEPROM without waiting the last write cycle.
  * @details   Only one EEPROM page can be written at once. So function
  *            splits large data chunks in small EEPROM transactions if needed.
+ *            Each page is sent as soon as the IC acknowledges again.
  * @note      To achieve the maximum efficiency use write operations
  *            aligned to EEPROM page boundaries.
  */
-static size_t write(void *ip, const uint8_t *bp, size_t n) {
+static size_t __write(void *ip, const uint8_t *bp, size_t n) {
 
   size_t   len = 0;      /* bytes to be written per transaction */
   uint32_t written = 0;  /* total bytes successfully written */
@@ -279,6 +310,36 @@ static size_t write(void *ip, const uint8_t *bp, size_t n) {
   return written;
 }
 
+/**
+ * @brief     Write data to EEPROM.
+ * @details   Returns once the data has been programmed. If the IC does not
+ *            come back from the write cycle of the last page, the bytes of
+ *            that page are not counted and the position is moved back to
+ *            them.
+ */
+static size_t write(void *ip, const uint8_t *bp, size_t n) {
+
+  size_t written = __write(ip, bp, n);
+  uint32_t last;
+
+  if (written == 0)
+    return 0;
+
+  if (eeprom_wait(((I2CEepromFileStream *)ip)->cfg) != MSG_OK) {
+    /* bytes of the last page, programmed or not */
+    last = (((EepromFileStream *)ip)->cfg->barrier_low +
+            eepfs_getposition(ip, NULL)) % ((EepromFileStream *)ip)->cfg->pagesize;
+    if (last == 0)
+      last = ((EepromFileStream *)ip)->cfg->pagesize;
+    if (last > written)
+      last = written;
+    written -= last;
+    eepfs_lseek(ip, eepfs_getposition(ip, NULL) - last);
+  }
+
+  return written;
+}
+
 /**
  * Read some bytes from current position in file. After successful
  * read operation the position pointer will be increased by the number
@@ -337,8 +398,13 @@ static size_t read(void *ip, uint8_t *bp, size_t n) {
 
 static const struct EepromFileStreamVMT vmt = {
   (size_t)0,
+#if EEPROM_USE_CACHE
+  eepfs_write,
+  eepfs_read,
+#else
   write,
   read,
+#endif
   eepfs_put,
   eepfs_get,
   eepfs_close,
@@ -346,6 +412,10 @@ static const struct EepromFileStreamVMT vmt = {
   eepfs_getsize,
   eepfs_getposition,
   eepfs_lseek,
+#if EEPROM_USE_CACHE
+  write,
+  read,
+#endif
 };
 
 EepromDevice eepdev_24xx = {
@@ -353,4 +423,40 @@ EepromDevice eepdev_24xx = {
   &vmt
 };
 
+/**
+ * @brief     Streams data to EEPROM.
+ * @details   Like @p fileStreamWrite() but returns as soon as the IC has
+ *            accepted the last page, so the caller can do something else
+ *            during its write cycle. Later accesses wait for it by
+ *            themselves, @p I2CEepromFileSync() waits for it explicitly.
+ *
+ * @param[in] efs   pointer to opened file stream
+ * @param[in] bp    pointer to data to be written
+ * @param[in] n     number of bytes to be written
+ * @return          number of bytes written
+ */
+size_t I2CEepromFileStreamWrite(I2CEepromFileStream *efs,
+                                const uint8_t *bp, size_t n) {
+
+  osalDbgCheck((efs != NULL) && (efs->vmt == &vmt));
+
+#if EEPROM_USE_CACHE
+  eepfs_invalidate(efs);
+#endif
+  return __write(efs, bp, n);
+}
+
+/**
+ * @brief     Waits until the IC has programmed the data written.
+ *
+ * @param[in] efs   pointer to opened file stream
+ * @return          MSG_OK when the IC is ready
+ */
+msg_t I2CEepromFileSync(I2CEepromFileStream *efs) {
+
+  osalDbgCheck((efs != NULL) && (efs->vmt == &vmt));
+
+  return eeprom_wait(efs->cfg);
+}
+
 #endif /* EEPROM_USE_EE24XX */
@@ -384,8 +384,13 @@ static size_t read(void *ip, uint8_t *bp, size_t n) {
 
 static const struct EepromFileStreamVMT vmt = {
   (size_t)0,
+#if EEPROM_USE_CACHE
+  eepfs_write,
+  eepfs_read,
+#else
   write,
   read,
+#endif
   eepfs_put,
   eepfs_get,
   eepfs_close,
@@ -393,6 +398,10 @@ static const struct EepromFileStreamVMT vmt = {
   eepfs_getsize,
   eepfs_getposition,
   eepfs_lseek,
+#if EEPROM_USE_CACHE
+  write,
+  read,
+#endif
 };
 
 EepromDevice eepdev_25xx = {
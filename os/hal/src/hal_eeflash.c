@@ -0,0 +1,681 @@
+/*
+    ChibiOS - Copyright (C) 2006..2018 Giovanni Di Sirio
+
+    Licensed under the Apache License, Version 2.0 (the "License");
+    you may not use this file except in compliance with the License.
+    You may obtain a copy of the License at
+
+        http://www.apache.org/licenses/LICENSE-2.0
+
+    Unless required by applicable law or agreed to in writing, software
+    distributed under the License is distributed on an "AS IS" BASIS,
+    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+    See the License for the specific language governing permissions and
+    limitations under the License.
+*/
+
+/*****************************************************************************
+ * LOG FORMAT
+ *****************************************************************************
+The log sectors form a ring, from the oldest (tail) to the one being written
+(head); at least one sector is kept erased. Each sector starts with a header
+holding a sequence number, consecutive along the ring, and is followed by
+record slots:
+
+  header:  magic (4) | seq (4) | ~seq (4)
+  slot:    key (2) | crc16 (2) | data (record_size) | pad | commit (4) | pad
+
+The body and the commit marker start on a flash page (program unit) boundary
+and each is programmed once, the commit marker after the body. The key is
+stored big endian with its top bit set opposite to the erased state, so an
+interrupted program leaves the slot visibly used once its first byte is in.
+A slot is valid when it is committed and its CRC matches; the last valid slot
+of a key, in log order, holds its current value.
+
+When the head is full the log moves to the erased sector. If no erased sector
+is left, the live records of the tail are copied to the head and the tail is
+erased. After a power failure the log is rebuilt from the sector chain: torn
+slots are skipped, sectors out of the chain are erased and an interrupted
+compaction is completed.
+*********************************************************************/
+
+#include "hal_eeflash.h"
+#include <string.h>
+
+#if (defined(HAL_USE_EEPROM) && HAL_USE_EEPROM && EEPROM_USE_EEFLASH) || defined(__DOXYGEN__)
+
+/*
+ ******************************************************************************
+ * DEFINES
+ ******************************************************************************
+ */
+#define EEFLASH_MAGIC       0x4C464545U   /* "EEFL" */
+#define EEFLASH_HEADER_SIZE 12U
+#define EEFLASH_SLOT_HEAD   4U            /* key and crc */
+
+/* no record at this index entry, it is a header offset */
+#define EEFLASH_NONE        ((flash_offset_t)0)
+
+/*
+ *******************************************************************************
+ * LOCAL FUNCTIONS
+ *******************************************************************************
+ */
+static uint16_t crc16(uint16_t crc, const uint8_t *p, size_t n) {
+
+  while (n--) {
+    crc ^= (uint16_t)(*p++) << 8;
+    for (unsigned i = 0; i < 8; i++)
+      crc = (crc & 0x8000U) ? (uint16_t)((crc << 1) ^ 0x1021U) : (uint16_t)(crc << 1);
+  }
+  return crc;
+}
+
+static size_t round_up(size_t n, size_t unit) {
+
+  return ((n + unit - 1) / unit) * unit;
+}
+
+static size_t body_size(EEFlashDriver *eeflp) {
+
+  return EEFLASH_SLOT_HEAD + eeflp->config->record_size;
+}
+
+static flash_sector_t ring_next(EEFlashDriver *eeflp, flash_sector_t s) {
+
+  return (s + 1 == eeflp->config->sectors_count) ? 0 : s + 1;
+}
+
+static flash_sector_t ring_prev(EEFlashDriver *eeflp, flash_sector_t s) {
+
+  return (s == 0) ? eeflp->config->sectors_count - 1 : s - 1;
+}
+
+static flash_offset_t sector_offset(EEFlashDriver *eeflp, flash_sector_t s) {
+
+  return flashGetSectorOffset(eeflp->config->flashp,
+                              eeflp->config->first_sector + s);
+}
+
+static flash_offset_t sector_end(EEFlashDriver *eeflp, flash_sector_t s) {
+
+  return sector_offset(eeflp, s) +
+         flashGetSectorSize(eeflp->config->flashp,
+                            eeflp->config->first_sector + s);
+}
+
+static flash_offset_t first_slot(EEFlashDriver *eeflp, flash_sector_t s) {
+
+  return sector_offset(eeflp, s) + round_up(EEFLASH_HEADER_SIZE, eeflp->unit);
+}
+
+/* the commit marker has all the bits programmed */
+static uint32_t commit_marker(EEFlashDriver *eeflp) {
+
+  return (eeflp->erased == 0xFF) ? 0x00000000U : 0xFFFFFFFFU;
+}
+
+static bool is_erased(EEFlashDriver *eeflp, const uint8_t *p, size_t n) {
+
+  while (n--) {
+    if (*p++ != eeflp->erased)
+      return false;
+  }
+  return true;
+}
+
+/**
+ * @brief   Reads the sequence number of a sector.
+ * @return  false if the sector has no valid header.
+ */
+static bool read_header(EEFlashDriver *eeflp, flash_sector_t s, uint32_t *seq) {
+
+  uint32_t hdr[3];
+
+  if (flashRead(eeflp->config->flashp, sector_offset(eeflp, s),
+                sizeof(hdr), (uint8_t *)hdr) != FLASH_NO_ERROR)
+    return false;
+  if ((hdr[0] != EEFLASH_MAGIC) || ((hdr[1] ^ hdr[2]) != 0xFFFFFFFFU))
+    return false;
+  *seq = hdr[1];
+  return true;
+}
+
+static flash_error_t erase_sector(EEFlashDriver *eeflp, flash_sector_t s) {
+
+  BaseFlash *flashp = eeflp->config->flashp;
+  flash_error_t err;
+
+  err = flashStartEraseSector(flashp, eeflp->config->first_sector + s);
+  if (err == FLASH_NO_ERROR)
+    err = flashWaitErase(flashp);
+  eeflp->stats.erases++;
+  return err;
+}
+
+/**
+ * @brief   Makes an erased sector the head of the log.
+ */
+static flash_error_t open_sector(EEFlashDriver *eeflp, flash_sector_t s,
+                                 uint32_t seq) {
+
+  uint32_t hdr[3] = {EEFLASH_MAGIC, seq, ~seq};
+  flash_error_t err;
+
+  err = flashProgram(eeflp->config->flashp, sector_offset(eeflp, s),
+                     sizeof(hdr), (const uint8_t *)hdr);
+  if (err != FLASH_NO_ERROR)
+    return err;
+
+  eeflp->head  = s;
+  eeflp->seq   = seq;
+  eeflp->wrptr = first_slot(eeflp, s);
+  eeflp->used++;
+  return FLASH_NO_ERROR;
+}
+
+/**
+ * @brief   Reads a slot.
+ * @details The body is left in the driver buffer.
+ * @return  The key if the slot is valid, -1 if it is erased, -2 otherwise.
+ */
+static int32_t read_slot(EEFlashDriver *eeflp, flash_offset_t offset) {
+
+  BaseFlash *flashp = eeflp->config->flashp;
+  const size_t body = body_size(eeflp);
+  uint32_t commit;
+  uint16_t key, crc;
+
+  if ((flashRead(flashp, offset, body, eeflp->buf) != FLASH_NO_ERROR) ||
+      (flashRead(flashp, offset + round_up(body, eeflp->unit),
+                 sizeof(commit), (uint8_t *)&commit) != FLASH_NO_ERROR))
+    return -2;
+
+  if (is_erased(eeflp, eeflp->buf, body) &&
+      is_erased(eeflp, (const uint8_t *)&commit, sizeof(commit)))
+    return -1;
+
+  if (commit != commit_marker(eeflp))
+    return -2;
+
+  key = (uint16_t)(((eeflp->buf[0] & 0x7FU) << 8) | eeflp->buf[1]);
+  memcpy(&crc, &eeflp->buf[2], sizeof(crc));
+  if ((key >= (eeflp->config->size / eeflp->config->record_size)) ||
+      (crc16(crc16(0xFFFFU, &eeflp->buf[0], 2), &eeflp->buf[4],
+             eeflp->config->record_size) != crc))
+    return -2;
+
+  return key;
+}
+
+/**
+ * @brief   Appends a record to the head.
+ * @pre     The head must have room for it.
+ */
+static flash_error_t append(EEFlashDriver *eeflp, uint16_t key,
+                            const uint8_t *data) {
+
+  BaseFlash *flashp = eeflp->config->flashp;
+  const size_t body = body_size(eeflp);
+  const flash_offset_t offset = eeflp->wrptr;
+  const uint32_t commit = commit_marker(eeflp);
+  uint16_t crc;
+  flash_error_t err;
+
+  osalDbgAssert(offset + eeflp->slot_size <= sector_end(eeflp, eeflp->head),
+                "no room");
+
+  if (data != &eeflp->buf[EEFLASH_SLOT_HEAD])
+    memcpy(&eeflp->buf[EEFLASH_SLOT_HEAD], data, eeflp->config->record_size);
+  eeflp->buf[0] = (uint8_t)((key >> 8) | (~eeflp->erased & 0x80U));
+  eeflp->buf[1] = (uint8_t)key;
+  crc = crc16(crc16(0xFFFFU, &eeflp->buf[0], 2), &eeflp->buf[4],
+              eeflp->config->record_size);
+  memcpy(&eeflp->buf[2], &crc, sizeof(crc));
+
+  /* the slot is used even if programming fails */
+  eeflp->wrptr += eeflp->slot_size;
+
+  err = flashProgram(flashp, offset, body, eeflp->buf);
+  if (err == FLASH_NO_ERROR)
+    err = flashProgram(flashp, offset + round_up(body, eeflp->unit),
+                       sizeof(commit), (const uint8_t *)&commit);
+  if (err != FLASH_NO_ERROR)
+    return err;
+
+  eeflp->config->index[key] = offset;
+  return FLASH_NO_ERROR;
+}
+
+/**
+ * @brief   Moves the live records of the tail to the head and erases it.
+ */
+static flash_error_t compact(EEFlashDriver *eeflp) {
+
+  const flash_sector_t s = eeflp->tail;
+  const flash_offset_t end = sector_end(eeflp, s);
+  flash_offset_t offset;
+  flash_error_t err;
+  int32_t key;
+
+  osalDbgAssert(s != eeflp->head, "compacting the head");
+
+  for (offset = first_slot(eeflp, s); offset + eeflp->slot_size <= end;
+       offset += eeflp->slot_size) {
+    key = read_slot(eeflp, offset);
+    if ((key < 0) || (eeflp->config->index[key] != offset))
+      continue;
+    if (eeflp->wrptr + eeflp->slot_size > sector_end(eeflp, eeflp->head))
+      return FLASH_ERROR_PROGRAM;
+    err = append(eeflp, (uint16_t)key, &eeflp->buf[EEFLASH_SLOT_HEAD]);
+    if (err != FLASH_NO_ERROR)
+      return err;
+    eeflp->stats.copies++;
+  }
+
+  err = erase_sector(eeflp, s);
+  if (err != FLASH_NO_ERROR)
+    return err;
+  eeflp->tail = ring_next(eeflp, s);
+  eeflp->used--;
+  return FLASH_NO_ERROR;
+}
+
+/**
+ * @brief   Makes sure the head has room for a record.
+ */
+static flash_error_t make_room(EEFlashDriver *eeflp) {
+
+  flash_sector_t tries = 0;
+  flash_error_t err;
+
+  while (eeflp->wrptr + eeflp->slot_size > sector_end(eeflp, eeflp->head)) {
+    /* every sector full of live records: the log is too small */
+    if (tries++ > eeflp->config->sectors_count)
+      return FLASH_ERROR_PROGRAM;
+
+    err = open_sector(eeflp, ring_next(eeflp, eeflp->head), eeflp->seq + 1);
+    if (err != FLASH_NO_ERROR)
+      return err;
+
+    /* keep one sector erased */
+    if (eeflp->used == eeflp->config->sectors_count) {
+      err = compact(eeflp);
+      if (err != FLASH_NO_ERROR)
+        return err;
+    }
+  }
+  return FLASH_NO_ERROR;
+}
+
+/**
+ * @brief   Indexes the records of a sector.
+ * @return  Offset following the last used slot.
+ */
+static flash_offset_t scan_sector(EEFlashDriver *eeflp, flash_sector_t s) {
+
+  const flash_offset_t end = sector_end(eeflp, s);
+  flash_offset_t offset, last;
+  int32_t key;
+
+  /* slots skipped after a reset are erased, scan up to the end */
+  last = first_slot(eeflp, s);
+  for (offset = last; offset + eeflp->slot_size <= end;
+       offset += eeflp->slot_size) {
+    key = read_slot(eeflp, offset);
+    if (key == -1)
+      continue;
+    if (key >= 0)
+      eeflp->config->index[key] = offset;
+    last = offset + eeflp->slot_size;
+  }
+  return last;
+}
+
+/*
+ *******************************************************************************
+ * EXPORTED FUNCTIONS
+ *******************************************************************************
+ */
+
+/**
+ * @brief   Initializes an emulation object.
+ */
+void eeflashObjectInit(EEFlashDriver *eeflp) {
+
+  memset(eeflp, 0, sizeof(*eeflp));
+}
+
+/**
+ * @brief   Mounts the log, formatting the sectors if none is valid.
+ * @details Rebuilds the RAM index and repairs what a power failure may have
+ *          left behind.
+ * @pre     The flash device must be started.
+ */
+flash_error_t eeflashStart(EEFlashDriver *eeflp, const EEFlashConfig *config) {
+
+  const flash_descriptor_t *desc;
+  flash_sector_t s, head = 0, chain;
+  uint32_t seq, head_seq = 0;
+  uint32_t records, per_sector;
+  bool found = false;
+  flash_error_t err;
+
+  osalDbgCheck((eeflp != NULL) && (config != NULL) &&
+               (config->flashp != NULL) && (config->index != NULL));
+  osalDbgCheck((config->sectors_count >= 2) && (config->record_size > 0) &&
+               (config->record_size <= EEPROM_EEFLASH_MAX_RECORD) &&
+               ((config->size % config->record_size) == 0));
+
+  desc = flashGetDescriptor(config->flashp);
+  eeflp->config = config;
+  eeflp->unit = (desc->page_size > 0) ? desc->page_size : 1;
+  eeflp->erased = (desc->attributes & FLASH_ATTR_ERASED_IS_ONE) ? 0xFF : 0x00;
+  eeflp->slot_size = round_up(body_size(eeflp), eeflp->unit) +
+                     round_up(sizeof(uint32_t), eeflp->unit);
+  memset(&eeflp->stats, 0, sizeof(eeflp->stats));
+
+  /* all the live records must fit outside the spare sector */
+  records = config->size / config->record_size;
+  per_sector = (sector_end(eeflp, 0) - first_slot(eeflp, 0)) /
+               eeflp->slot_size;
+  osalDbgAssert(records <= 0x8000U, "too many records");
+  osalDbgAssert(records < (config->sectors_count - 1) * per_sector,
+                "log too small");
+  for (s = 1; s < config->sectors_count; s++) {
+    osalDbgAssert(sector_end(eeflp, s) - sector_offset(eeflp, s) ==
+                  sector_end(eeflp, 0) - sector_offset(eeflp, 0),
+                  "sectors of different sizes");
+  }
+
+  for (s = 0; s < records; s++)
+    config->index[s] = EEFLASH_NONE;
+
+  /* the head is the sector with the highest sequence */
+  for (s = 0; s < config->sectors_count; s++) {
+    if (read_header(eeflp, s, &seq) && (!found || ((int32_t)(seq - head_seq) > 0))) {
+      head = s;
+      head_seq = seq;
+      found = true;
+    }
+  }
+
+  eeflp->used = 0;
+  if (!found) {
+    /* blank or foreign content */
+    for (s = 0; s < config->sectors_count; s++) {
+      if (flashVerifyErase(config->flashp, config->first_sector + s) !=
+          FLASH_NO_ERROR) {
+        err = erase_sector(eeflp, s);
+        if (err != FLASH_NO_ERROR)
+          return err;
+      }
+    }
+    eeflp->tail = 0;
+    return open_sector(eeflp, 0, 1);
+  }
+
+  /* walk back along the chain of consecutive sequence numbers */
+  chain = 1;
+  eeflp->tail = head;
+  for (s = ring_prev(eeflp, head); s != head; s = ring_prev(eeflp, s)) {
+    if (!read_header(eeflp, s, &seq) || (seq != head_seq - chain))
+      break;
+    eeflp->tail = s;
+    chain++;
+  }
+
+  /* anything out of the chain is erased */
+  for (s = ring_next(eeflp, head); s != eeflp->tail; s = ring_next(eeflp, s)) {
+    if (flashVerifyErase(config->flashp, config->first_sector + s) !=
+        FLASH_NO_ERROR) {
+      err = erase_sector(eeflp, s);
+      if (err != FLASH_NO_ERROR)
+        return err;
+    }
+  }
+
+  /* index from the oldest to the newest record */
+  s = eeflp->tail;
+  while (true) {
+    eeflp->wrptr = scan_sector(eeflp, s);
+    if (s == head)
+      break;
+    s = ring_next(eeflp, s);
+  }
+  eeflp->head = head;
+  eeflp->seq = head_seq;
+  eeflp->used = chain;
+
+  /* An interrupted program may leave no visible bit behind but the unit
+     must not be programmed again: skip the slot after the last one. */
+  eeflp->wrptr += eeflp->slot_size;
+  if ((eeflp->wrptr + eeflp->slot_size > sector_end(eeflp, head)) &&
+      (chain < config->sectors_count)) {
+    /* same for a header being programmed into the next sector */
+    err = erase_sector(eeflp, ring_next(eeflp, head));
+    if (err != FLASH_NO_ERROR)
+      return err;
+  }
+
+  /* a compaction was interrupted */
+  while (eeflp->used == config->sectors_count) {
+    err = compact(eeflp);
+    if (err != FLASH_NO_ERROR)
+      return err;
+  }
+
+  return FLASH_NO_ERROR;
+}
+
+/**
+ * @brief   Stops the emulation.
+ */
+void eeflashStop(EEFlashDriver *eeflp) {
+
+  osalDbgCheck(eeflp != NULL);
+
+  eeflp->config = NULL;
+}
+
+/**
+ * @brief   Reads a record.
+ * @details Records never written read as erased flash.
+ *
+ * @param[in] eeflp     pointer to the emulation object
+ * @param[in] record    record number
+ * @param[out] buf      buffer of @p record_size bytes
+ */
+flash_error_t eeflashRead(EEFlashDriver *eeflp, uint32_t record, uint8_t *buf) {
+
+  const EEFlashConfig *config = eeflp->config;
+
+  osalDbgCheck((config != NULL) && (buf != NULL) &&
+               (record < config->size / config->record_size));
+
+  if (config->index[record] == EEFLASH_NONE) {
+    memset(buf, eeflp->erased, config->record_size);
+    return FLASH_NO_ERROR;
+  }
+  return flashRead(config->flashp, config->index[record] + EEFLASH_SLOT_HEAD,
+                   config->record_size, buf);
+}
+
+/**
+ * @brief   Writes a record.
+ * @details The record is appended to the log, unless its content does not
+ *          change. The new content is in place once the function returns,
+ *          a power failure before leaves the previous one.
+ *
+ * @param[in] eeflp     pointer to the emulation object
+ * @param[in] record    record number
+ * @param[in] buf       buffer of @p record_size bytes
+ */
+flash_error_t eeflashWrite(EEFlashDriver *eeflp, uint32_t record,
+                           const uint8_t *buf) {
+
+  const EEFlashConfig *config = eeflp->config;
+  flash_error_t err;
+
+  osalDbgCheck((config != NULL) && (buf != NULL) &&
+               (record < config->size / config->record_size));
+
+  /* no wear for nothing */
+  err = eeflashRead(eeflp, record, &eeflp->buf[EEFLASH_SLOT_HEAD]);
+  if (err != FLASH_NO_ERROR)
+    return err;
+  if (memcmp(&eeflp->buf[EEFLASH_SLOT_HEAD], buf, config->record_size) == 0) {
+    eeflp->stats.unchanged++;
+    return FLASH_NO_ERROR;
+  }
+
+  err = make_room(eeflp);
+  if (err != FLASH_NO_ERROR)
+    return err;
+
+  err = append(eeflp, (uint16_t)record, buf);
+  if (err == FLASH_NO_ERROR)
+    eeflp->stats.writes++;
+  return err;
+}
+
+/**
+ * @brief   Returns the emulation counters.
+ */
+void eeflashGetStats(EEFlashDriver *eeflp, EEFlashStats *stats) {
+
+  osalDbgCheck((eeflp != NULL) && (stats != NULL));
+
+  *stats = eeflp->stats;
+}
+
+/*
+ *******************************************************************************
+ * FILE STREAM
+ *******************************************************************************
+ */
+
+/**
+ * @brief   Determines and returns size of data that can be processed
+ */
+static size_t __clamp_size(void *ip, size_t n) {
+
+  if (((size_t)eepfs_getposition(ip, NULL) + n) > (size_t)eepfs_getsize(ip, NULL))
+    return eepfs_getsize(ip, NULL) - eepfs_getposition(ip, NULL);
+  else
+    return n;
+}
+
+/**
+ * @brief     Write data to the emulated EEPROM.
+ * @details   Partially written records are read, modified and written back.
+ */
+static size_t write(void *ip, const uint8_t *bp, size_t n) {
+
+  const EEFlashFileConfig *cfg = ((EEFlashFileStream *)ip)->cfg;
+  EEFlashDriver *eeflp = cfg->eeflp;
+  const uint16_t recsize = eeflp->config->record_size;
+  uint32_t written = 0;
+  uint32_t addr, record, offset;
+  size_t len;
+  const uint8_t *src;
+
+  osalDbgCheck((ip != NULL) && (((EepromFileStream *)ip)->vmt != NULL));
+
+  n = __clamp_size(ip, n);
+
+  while (written < n) {
+    addr   = cfg->barrier_low + eepfs_getposition(ip, NULL);
+    record = addr / recsize;
+    offset = addr % recsize;
+    len    = recsize - offset;
+    if (len > (n - written))
+      len = n - written;
+
+    src = bp;
+    if (len != recsize) {
+      if (eeflashRead(eeflp, record, eeflp->rmw) != FLASH_NO_ERROR)
+        break;
+      memcpy(&eeflp->rmw[offset], bp, len);
+      src = eeflp->rmw;
+    }
+    if (eeflashWrite(eeflp, record, src) != FLASH_NO_ERROR)
+      break;
+
+    written += len;
+    bp += len;
+    eepfs_lseek(ip, eepfs_getposition(ip, NULL) + len);
+  }
+
+  return written;
+}
+
+/**
+ * Read some bytes from current position in file. After successful
+ * read operation the position pointer will be increased by the number
+ * of read bytes.
+ */
+static size_t read(void *ip, uint8_t *bp, size_t n) {
+
+  const EEFlashFileConfig *cfg = ((EEFlashFileStream *)ip)->cfg;
+  EEFlashDriver *eeflp = cfg->eeflp;
+  const uint16_t recsize = eeflp->config->record_size;
+  uint32_t done = 0;
+  uint32_t addr, record, offset;
+  size_t len;
+
+  osalDbgCheck((ip != NULL) && (((EepromFileStream *)ip)->vmt != NULL));
+
+  n = __clamp_size(ip, n);
+
+  while (done < n) {
+    addr   = cfg->barrier_low + eepfs_getposition(ip, NULL);
+    record = addr / recsize;
+    offset = addr % recsize;
+    len    = recsize - offset;
+    if (len > (n - done))
+      len = n - done;
+
+    if (eeflp->config->index[record] == EEFLASH_NONE)
+      memset(bp, eeflp->erased, len);
+    else if (flashRead(eeflp->config->flashp,
+                       eeflp->config->index[record] + EEFLASH_SLOT_HEAD + offset,
+                       len, bp) != FLASH_NO_ERROR)
+      break;
+
+    done += len;
+    bp += len;
+    eepfs_lseek(ip, eepfs_getposition(ip, NULL) + len);
+  }
+
+  return done;
+}
+
+static const struct EepromFileStreamVMT vmt = {
+  (size_t)0,
+#if EEPROM_USE_CACHE
+  eepfs_write,
+  eepfs_read,
+#else
+  write,
+  read,
+#endif
+  eepfs_put,
+  eepfs_get,
+  eepfs_close,
+  eepfs_geterror,
+  eepfs_getsize,
+  eepfs_getposition,
+  eepfs_lseek,
+#if EEPROM_USE_CACHE
+  write,
+  read,
+#endif
+};
+
+EepromDevice eepdev_flash = {
+  EEPROM_DEV_FLASH,
+  &vmt
+};
+
+#endif /* EEPROM_USE_EEFLASH */
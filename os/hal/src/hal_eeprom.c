@@ -33,6 +33,7 @@
 
 extern EepromDevice eepdev_24xx;
 extern EepromDevice eepdev_25xx;
+extern EepromDevice eepdev_flash;
 
 EepromDevice *__eeprom_drv_table[] = {
   /* I2C related. */
@@ -52,6 +53,11 @@ EepromDevice *__eeprom_drv_table[] = {
 # endif
 
 #endif /* HAL_USE_SPI */
+
+  /* Internal flash. */
+#if EEPROM_USE_EEFLASH
+  &eepdev_flash,
+#endif
 };
 
 
@@ -96,6 +102,13 @@ EepromFileStream *EepromFileOpen(EepromFileStream *efs,
   efs->cfg      = eepcfg;
   efs->errors   = FILE_OK;
   efs->position = 0;
+#if EEPROM_USE_CACHE
+  efs->cache_len   = 0;
+  efs->cache_valid = false;
+  efs->dirty_lo    = 0;
+  efs->dirty_hi    = 0;
+  memset(&efs->cache_stats, 0, sizeof(efs->cache_stats));
+#endif
   return (EepromFileStream *)efs;
 }
 
@@ -135,6 +148,268 @@ size_t EepromWriteWord(EepromFileStream *efs, uint32_t data) {
   return fileStreamWrite(efs, (uint8_t *)&data, sizeof(data));
 }
 
+#if EEPROM_USE_CACHE
+/*
+ * Cache lines are aligned on EEPROM_CACHE_SIZE (or on the page when it is
+ * smaller) in the memory array, so a write-back always fits in one page.
+ * The line may be cut by the file barriers.
+ */
+
+/**
+ * @brief   Size of the cache line of the stream.
+ */
+static uint16_t cache_linesize(EepromFileStream *efs) {
+
+  if (efs->cfg->pagesize < EEPROM_CACHE_SIZE)
+    return efs->cfg->pagesize;
+  return EEPROM_CACHE_SIZE;
+}
+
+/**
+ * @brief   Checks whether file position @p pos is in the selected line.
+ */
+static bool cache_holds(EepromFileStream *efs, uint32_t pos) {
+
+  return (efs->cache_len > 0) && (pos >= efs->cache_pos) &&
+         (pos < (efs->cache_pos + efs->cache_len));
+}
+
+/**
+ * @brief   Selects the line holding file position @p pos, not read yet.
+ * @pre     The cache must be clean.
+ */
+static void cache_select(EepromFileStream *efs, uint32_t pos) {
+
+  const uint32_t linesize = cache_linesize(efs);
+  uint32_t start = (efs->cfg->barrier_low + pos) & ~(linesize - 1);
+  uint32_t end = start + linesize;
+
+  if (start < efs->cfg->barrier_low)
+    start = efs->cfg->barrier_low;
+  if (end > efs->cfg->barrier_hi)
+    end = efs->cfg->barrier_hi;
+
+  efs->cache_pos   = start - efs->cfg->barrier_low;
+  efs->cache_len   = end - start;
+  efs->cache_valid = false;
+}
+
+/**
+ * @brief   Writes the modified bytes of the line back to the IC.
+ */
+static msg_t cache_writeback(EepromFileStream *efs) {
+
+  uint32_t position;
+  size_t len;
+  size_t written;
+
+  if (efs->dirty_lo == efs->dirty_hi)
+    return MSG_OK;
+
+  /* clean before the transfer, the driver seeks while writing */
+  len = efs->dirty_hi - efs->dirty_lo;
+  position = efs->position;
+  efs->position = efs->cache_pos + efs->dirty_lo;
+  efs->dirty_hi = efs->dirty_lo;
+
+  written = efs->vmt->raw_write(efs, &efs->cache[efs->dirty_lo], len);
+  efs->position = position;
+  efs->cache_stats.writebacks++;
+
+  if (written != len) {
+    /* the line content is not known anymore */
+    efs->cache_len = 0;
+    efs->errors = FILE_ERROR;
+    return MSG_RESET;
+  }
+  return MSG_OK;
+}
+
+/**
+ * @brief   Reads the selected line from the IC.
+ */
+static msg_t cache_fill(EepromFileStream *efs) {
+
+  uint32_t position;
+  size_t len;
+
+  /* bytes written in the line go to the IC first */
+  if (cache_writeback(efs) != MSG_OK)
+    return MSG_RESET;
+
+  position = efs->position;
+  efs->position = efs->cache_pos;
+  len = efs->vmt->raw_read(efs, efs->cache, efs->cache_len);
+  efs->position = position;
+  efs->cache_stats.read_misses++;
+
+  if (len != efs->cache_len) {
+    efs->cache_len = 0;
+    efs->errors = FILE_ERROR;
+    return MSG_RESET;
+  }
+  efs->cache_valid = true;
+  return MSG_OK;
+}
+
+/**
+ * @brief   Cached write.
+ * @details Writes shorter than a line are merged in the cache, longer ones
+ *          go straight to the IC.
+ */
+size_t eepfs_write(void *ip, const uint8_t *bp, size_t n) {
+
+  EepromFileStream *efs = (EepromFileStream *)ip;
+  size_t done = 0;
+  size_t len;
+  uint32_t offset;
+
+  osalDbgCheck((ip != NULL) && (efs->vmt != NULL));
+
+  if ((efs->position + n) > (uint32_t)eepfs_getsize(ip, NULL))
+    n = eepfs_getsize(ip, NULL) - efs->position;
+  if (n == 0)
+    return 0;
+
+  if (n >= cache_linesize(efs)) {
+    eepfs_invalidate(ip);
+    return efs->vmt->raw_write(ip, bp, n);
+  }
+
+  while (done < n) {
+    if (!cache_holds(efs, efs->position)) {
+      if (cache_writeback(efs) != MSG_OK)
+        break;
+      cache_select(efs, efs->position);
+    }
+
+    offset = efs->position - efs->cache_pos;
+    len = efs->cache_len - offset;
+    if (len > (n - done))
+      len = n - done;
+
+    /* the dirty range must stay contiguous when the rest of the line has
+       not been read */
+    if (!efs->cache_valid && (efs->dirty_lo != efs->dirty_hi) &&
+        ((offset > efs->dirty_hi) || ((offset + len) < efs->dirty_lo))) {
+      if (cache_writeback(efs) != MSG_OK)
+        break;
+    }
+
+    memcpy(&efs->cache[offset], &bp[done], len);
+
+    if (efs->dirty_lo == efs->dirty_hi) {
+      efs->dirty_lo = offset;
+      efs->dirty_hi = offset + len;
+    }
+    else {
+      if (offset < efs->dirty_lo)
+        efs->dirty_lo = offset;
+      if ((offset + len) > efs->dirty_hi)
+        efs->dirty_hi = offset + len;
+    }
+
+    efs->cache_stats.writes++;
+    efs->position += len;
+    done += len;
+  }
+
+  return done;
+}
+
+/**
+ * @brief   Cached read.
+ * @details Reads shorter than a line are served from the cache, longer ones
+ *          come straight from the IC.
+ */
+size_t eepfs_read(void *ip, uint8_t *bp, size_t n) {
+
+  EepromFileStream *efs = (EepromFileStream *)ip;
+  size_t done = 0;
+  size_t len;
+  uint32_t offset;
+
+  osalDbgCheck((ip != NULL) && (efs->vmt != NULL));
+
+  if ((efs->position + n) > (uint32_t)eepfs_getsize(ip, NULL))
+    n = eepfs_getsize(ip, NULL) - efs->position;
+  if (n == 0)
+    return 0;
+
+  if (n >= cache_linesize(efs)) {
+    if (cache_writeback(efs) != MSG_OK)
+      return 0;
+    return efs->vmt->raw_read(ip, bp, n);
+  }
+
+  while (done < n) {
+    if (!cache_holds(efs, efs->position)) {
+      if (cache_writeback(efs) != MSG_OK)
+        break;
+      cache_select(efs, efs->position);
+    }
+
+    if (!efs->cache_valid) {
+      if (cache_fill(efs) != MSG_OK)
+        break;
+    }
+    else {
+      efs->cache_stats.read_hits++;
+    }
+
+    offset = efs->position - efs->cache_pos;
+    len = efs->cache_len - offset;
+    if (len > (n - done))
+      len = n - done;
+    memcpy(&bp[done], &efs->cache[offset], len);
+
+    efs->position += len;
+    done += len;
+  }
+
+  return done;
+}
+
+/**
+ * @brief   Writes back and drops the cached line, for drivers accessing the
+ *          IC behind the cache.
+ */
+void eepfs_invalidate(void *ip) {
+
+  EepromFileStream *efs = (EepromFileStream *)ip;
+
+  osalDbgCheck((ip != NULL) && (efs->vmt != NULL));
+
+  (void)cache_writeback(efs);
+  efs->cache_len = 0;
+}
+
+/**
+ * @brief   Returns the cache counters of the stream.
+ */
+void EepromFileGetCacheStats(EepromFileStream *efs, EepromCacheStats *stats) {
+
+  osalDbgCheck((efs != NULL) && (efs->vmt != NULL) && (stats != NULL));
+
+  *stats = efs->cache_stats;
+}
+#endif /* EEPROM_USE_CACHE */
+
+/**
+ * @brief   Writes the data merged in the cache to the IC.
+ * @return  FILE_OK, or FILE_ERROR if the write-back failed.
+ */
+msg_t EepromFileFlush(EepromFileStream *efs) {
+
+  osalDbgCheck((efs != NULL) && (efs->vmt != NULL));
+
+#if EEPROM_USE_CACHE
+  if (cache_writeback(efs) != MSG_OK)
+    return FILE_ERROR;
+#endif
+  return FILE_OK;
+}
+
 msg_t eepfs_getsize(void *ip, fileoffset_t *offset) {
 
   uint32_t h, l;
@@ -163,19 +438,28 @@ msg_t eepfs_lseek(void *ip, fileoffset_t offset) {
   size = eepfs_getsize(ip, NULL);
   if (offset > size)
     offset = size;
+#if EEPROM_USE_CACHE
+  /* leaving the line ends the write combining */
+  if (!cache_holds((EepromFileStream *)ip, offset))
+    (void)cache_writeback((EepromFileStream *)ip);
+#endif
   ((EepromFileStream *)ip)->position = offset;
   return offset;
 }
 
 msg_t eepfs_close(void *ip) {
 
+  msg_t status;
+
   osalDbgCheck((ip != NULL) && (((EepromFileStream *)ip)->vmt != NULL));
 
+  status = EepromFileFlush((EepromFileStream *)ip);
+
   ((EepromFileStream *)ip)->errors   = FILE_OK;
   ((EepromFileStream *)ip)->position = 0;
   ((EepromFileStream *)ip)->vmt      = NULL;
   ((EepromFileStream *)ip)->cfg      = NULL;
-  return FILE_OK;
+  return status;
 }
 
 msg_t eepfs_geterror(void *ip) {
@@ -186,15 +470,22 @@ msg_t eepfs_geterror(void *ip) {
 
 msg_t eepfs_put(void *ip, uint8_t b) {
 
-  (void)ip;
-  (void)b;
-  return 0;
+  osalDbgCheck((ip != NULL) && (((EepromFileStream *)ip)->vmt != NULL));
+
+  if (((EepromFileStream *)ip)->vmt->write(ip, &b, 1) != 1)
+    return STM_RESET;
+  return STM_OK;
 }
 
 msg_t eepfs_get(void *ip) {
 
-  (void)ip;
-  return 0;
+  uint8_t b;
+
+  osalDbgCheck((ip != NULL) && (((EepromFileStream *)ip)->vmt != NULL));
+
+  if (((EepromFileStream *)ip)->vmt->read(ip, &b, 1) != 1)
+    return STM_RESET;
+  return b;
 }
 
 #endif /* #if defined(HAL_USE_EEPROM) && HAL_USE_EEPROM */
@@ -32,6 +32,16 @@
 /* Driver local definitions.                                                 */
 /*===========================================================================*/
 
+/**
+ * @brief   Bad block table signature, "BBT0".
+ */
+#define BBT_MAGIC               0x30544242U
+
+/**
+ * @brief   Number of copies of the bad block table.
+ */
+#define BBT_COPIES              2U
+
 /*===========================================================================*/
 /* Driver exported variables.                                                */
 /*===========================================================================*/
@@ -40,6 +50,32 @@
 /* Driver local types.                                                       */
 /*===========================================================================*/
 
+#if NAND_USE_BBT || defined(__DOXYGEN__)
+/**
+ * @brief   Bad block table header.
+ * @details Stored in the first page of a table block, the map follows in
+ *          the next pages.
+ */
+typedef struct {
+  /**
+   * @brief   @p BBT_MAGIC.
+   */
+  uint32_t                  magic;
+  /**
+   * @brief   Incremented at each table update, the highest copy wins.
+   */
+  uint32_t                  version;
+  /**
+   * @brief   Number of blocks of the device.
+   */
+  uint32_t                  nblocks;
+  /**
+   * @brief   CRC32 of version, nblocks and map.
+   */
+  uint32_t                  crc;
+} bbt_header_t;
+#endif /* NAND_USE_BBT */
+
 /*===========================================================================*/
 /* Driver local variables.                                                   */
 /*===========================================================================*/
@@ -301,6 +337,357 @@ static void scan_bad_blocks(NANDDriver *nandp) {
   }
 }
 
+/**
+ * @brief   Writes the bad block marks of a block.
+ *
+ * @param[in] nandp         pointer to the @p NANDDriver object
+ * @param[in] die           die number in nand flash
+ * @param[in] logun         logical unit number in nand flash
+ * @param[in] plane         plane number in nand flash
+ * @param[in] block         block number
+ *
+ * @notapi
+ */
+static void write_bad_mark(NANDDriver *nandp, uint32_t die, uint32_t logun,
+                           uint32_t plane, uint32_t block) {
+
+  uint16_t bb_mark = 0;
+
+  nandWritePageSpare(nandp, die, logun, plane, block, 0, &bb_mark, sizeof(bb_mark));
+  nandWritePageSpare(nandp, die, logun, plane, block, 1, &bb_mark, sizeof(bb_mark));
+}
+
+#if NAND_USE_BBT || defined(__DOXYGEN__)
+/**
+ * @brief   Total number of blocks of the device.
+ *
+ * @param[in] cfg           pointer to the @p NANDConfig object
+ *
+ * @notapi
+ */
+static uint32_t total_blocks(const NANDConfig *cfg) {
+
+  return cfg->dies * cfg->loguns * cfg->planes * cfg->blocks;
+}
+
+/**
+ * @brief   Splits a block number of total blocks in NAND coordinates.
+ * @details The numbering is the same used by the bad block map.
+ *
+ * @param[in] cfg           pointer to the @p NANDConfig object
+ * @param[in] n             block number of total blocks
+ * @param[out] addr         die, logical unit, plane and block numbers
+ *
+ * @notapi
+ */
+static void block_coords(const NANDConfig *cfg, uint32_t n, uint32_t *addr) {
+
+  addr[3] = n % cfg->blocks;
+  n /= cfg->blocks;
+  addr[2] = n % cfg->planes;
+  n /= cfg->planes;
+  addr[1] = n % cfg->loguns;
+  addr[0] = n / cfg->loguns;
+}
+
+/**
+ * @brief   Size in bytes of the map stored in the table.
+ *
+ * @param[in] cfg           pointer to the @p NANDConfig object
+ *
+ * @notapi
+ */
+static size_t bbt_map_size(const NANDConfig *cfg) {
+
+  const size_t bits = sizeof(bitmap_word_t) * 8;
+
+  return ((total_blocks(cfg) + bits - 1) / bits) * sizeof(bitmap_word_t);
+}
+
+/**
+ * @brief   CRC32 of a table.
+ *
+ * @param[in] hdr           pointer to the table header
+ * @param[in] map           pointer to the map
+ * @param[in] len           map size in bytes
+ *
+ * @notapi
+ */
+static uint32_t bbt_crc(const bbt_header_t *hdr, const void *map, size_t len) {
+
+  static const uint32_t nibble[16] = {
+    0x00000000, 0x1DB71064, 0x3B6E20C8, 0x26D930AC,
+    0x76DC4190, 0x6B6B51F4, 0x4DB26158, 0x5005713C,
+    0xEDB88320, 0xF00F9344, 0xD6D6A3E8, 0xCB61B38C,
+    0x9B64C2B0, 0x86D3D2D4, 0xA00AE278, 0xBDBDF21C
+  };
+  const uint8_t *p = (const uint8_t *)&hdr->version;
+  uint32_t crc = 0xFFFFFFFF;
+  size_t i;
+
+  /* version and nblocks first, then the map.*/
+  for (i = 0; i < 2 * sizeof(uint32_t) + len; i++) {
+    if (i == 2 * sizeof(uint32_t)) {
+      p = map;
+    }
+    crc ^= *p++;
+    crc = (crc >> 4) ^ nibble[crc & 0x0F];
+    crc = (crc >> 4) ^ nibble[crc & 0x0F];
+  }
+  return ~crc;
+}
+
+/**
+ * @brief   Reads the table header of a reserved block.
+ *
+ * @param[in] nandp         pointer to the @p NANDDriver object
+ * @param[in] n             block number of total blocks
+ * @param[out] hdr          pointer to the header
+ *
+ * @return                  header validity
+ * @retval true             the block holds a table for this device.
+ * @retval false            no table found.
+ *
+ * @notapi
+ */
+static bool bbt_read_header(NANDDriver *nandp, uint32_t n, bbt_header_t *hdr) {
+
+  uint32_t a[4];
+
+  block_coords(nandp->config, n, a);
+  nandReadPageData(nandp, a[0], a[1], a[2], a[3], 0, hdr, sizeof(*hdr), NULL);
+  return (BBT_MAGIC == hdr->magic) &&
+         (total_blocks(nandp->config) == hdr->nblocks);
+}
+
+/**
+ * @brief   Loads the map of a table in the bad block map.
+ *
+ * @param[in] nandp         pointer to the @p NANDDriver object
+ * @param[in] n             block number of total blocks
+ * @param[in] hdr           pointer to the header read from the block
+ *
+ * @return                  The operation status.
+ * @retval HAL_SUCCESS      the map has been loaded.
+ * @retval HAL_FAILED       the map is corrupt.
+ *
+ * @notapi
+ */
+static bool bbt_read_map(NANDDriver *nandp, uint32_t n,
+                         const bbt_header_t *hdr) {
+
+  const size_t ds = nandp->config->page_data_size;
+  const size_t size = bbt_map_size(nandp->config);
+  uint8_t *map = (uint8_t *)nandp->bb_map->array;
+  uint32_t a[4], page;
+  size_t off;
+
+  block_coords(nandp->config, n, a);
+  for (page = 1, off = 0; off < size; page++, off += ds) {
+    nandReadPageData(nandp, a[0], a[1], a[2], a[3], page, &map[off],
+                     (size - off) < ds ? (size - off) : ds, NULL);
+  }
+  return bbt_crc(hdr, map, size) == hdr->crc ? HAL_SUCCESS : HAL_FAILED;
+}
+
+/**
+ * @brief   Loads the newest valid table in the bad block map.
+ * @details An older copy is used if the newest one is corrupt.
+ *
+ * @param[in] nandp         pointer to the @p NANDDriver object
+ *
+ * @return                  The operation status.
+ * @retval HAL_SUCCESS      the map has been loaded.
+ * @retval HAL_FAILED       no valid table found.
+ *
+ * @notapi
+ */
+static bool bbt_load(NANDDriver *nandp) {
+
+  const uint32_t first = total_blocks(nandp->config) - NAND_BBT_BLOCKS;
+  bbt_header_t hdr[NAND_BBT_BLOCKS];
+  bool valid[NAND_BBT_BLOCKS];
+  uint32_t i, best;
+
+  for (i = 0; i < NAND_BBT_BLOCKS; i++) {
+    valid[i] = bbt_read_header(nandp, first + i, &hdr[i]);
+  }
+
+  while (true) {
+    best = NAND_BBT_BLOCKS;
+    for (i = 0; i < NAND_BBT_BLOCKS; i++) {
+      if (valid[i] &&
+          ((best == NAND_BBT_BLOCKS) || (hdr[i].version > hdr[best].version))) {
+        best = i;
+      }
+    }
+    if (best == NAND_BBT_BLOCKS) {
+      return HAL_FAILED;
+    }
+    if (HAL_SUCCESS == bbt_read_map(nandp, first + best, &hdr[best])) {
+      return HAL_SUCCESS;
+    }
+    valid[best] = false;
+  }
+}
+
+/**
+ * @brief   Writes a copy of the table in a reserved block.
+ *
+ * @param[in] nandp         pointer to the @p NANDDriver object
+ * @param[in] a             die, logical unit, plane and block numbers
+ * @param[in] hdr           pointer to the header
+ *
+ * @return                  The operation status.
+ * @retval HAL_SUCCESS      the copy has been written.
+ * @retval HAL_FAILED       erase or program failed.
+ *
+ * @notapi
+ */
+static bool bbt_write_copy(NANDDriver *nandp, const uint32_t *a,
+                           const bbt_header_t *hdr) {
+
+  const size_t ds = nandp->config->page_data_size;
+  const size_t size = bbt_map_size(nandp->config);
+  const uint8_t *map = (const uint8_t *)nandp->bb_map->array;
+  uint32_t page;
+  size_t off;
+
+  if (nandErase(nandp, a[0], a[1], a[2], a[3]) & NAND_STATUS_FAIL) {
+    return HAL_FAILED;
+  }
+  /* Pages are programmed in order, the header first. A copy interrupted
+     before the map is complete fails the CRC check.*/
+  if (nandWritePageData(nandp, a[0], a[1], a[2], a[3], 0,
+                        hdr, sizeof(*hdr), NULL) & NAND_STATUS_FAIL) {
+    return HAL_FAILED;
+  }
+  for (page = 1, off = 0; off < size; page++, off += ds) {
+    if (nandWritePageData(nandp, a[0], a[1], a[2], a[3], page, &map[off],
+                          (size - off) < ds ? (size - off) : ds,
+                          NULL) & NAND_STATUS_FAIL) {
+      return HAL_FAILED;
+    }
+  }
+  return HAL_SUCCESS;
+}
+
+/**
+ * @brief   Checks that the reserved blocks can be taken by the table.
+ * @details The blocks belong to the table if one of them holds a table
+ *          header, even an old or corrupt one. Otherwise every page of the
+ *          good reserved blocks, data and spare, must be erased.
+ * @note    Only called when no valid table is found, it reads the whole
+ *          reserved area in small chunks.
+ *
+ * @param[in] nandp         pointer to the @p NANDDriver object
+ *
+ * @return                  The operation status.
+ * @retval HAL_SUCCESS      the reserved blocks can be erased.
+ * @retval HAL_FAILED       a reserved block holds data that is not a table.
+ *
+ * @notapi
+ */
+static bool bbt_check_area(NANDDriver *nandp) {
+
+  const NANDConfig *cfg = nandp->config;
+  const uint32_t first = total_blocks(cfg) - NAND_BBT_BLOCKS;
+  const size_t addrlen = cfg->rowcycles + cfg->colcycles;
+  const size_t size = cfg->page_data_size + cfg->page_spare_size;
+  uint8_t addr[addrlen];
+  uint32_t buf[16];
+  bbt_header_t hdr;
+  uint32_t i, page, a[4];
+  size_t off, len, k;
+
+  for (i = 0; i < NAND_BBT_BLOCKS; i++) {
+    if (bbt_read_header(nandp, first + i, &hdr)) {
+      return HAL_SUCCESS;
+    }
+  }
+
+  for (i = 0; i < NAND_BBT_BLOCKS; i++) {
+    block_coords(cfg, first + i, a);
+    if (readIsBlockBad(nandp, a[0], a[1], a[2], a[3])) {
+      continue;
+    }
+    hook_for_chipselect_nand_flash(a[0]);
+    for (page = 0; page < cfg->pages_per_block; page++) {
+      for (off = 0; off < size; off += len) {
+        len = (size - off) < sizeof(buf) ? (size - off) : sizeof(buf);
+        calc_addr(cfg, a[1], a[2], a[3], page, off, addr, addrlen);
+        nand_lld_read_data(nandp, (void *)buf, len, addr, addrlen, NULL);
+        for (k = 0; k < len; k++) {
+          if (0xFF != ((const uint8_t *)buf)[k]) {
+            return HAL_FAILED;
+          }
+        }
+      }
+    }
+  }
+  return HAL_SUCCESS;
+}
+
+/**
+ * @brief   Marks the reserved blocks as bad in the map.
+ *
+ * @param[in] nandp         pointer to the @p NANDDriver object
+ *
+ * @notapi
+ */
+static void bbt_reserve(NANDDriver *nandp) {
+
+  const uint32_t total = total_blocks(nandp->config);
+  uint32_t n;
+
+  for (n = total - NAND_BBT_BLOCKS; n < total; n++) {
+    bitmapSet(nandp->bb_map, n);
+  }
+}
+
+/**
+ * @brief   Writes the bad block map as a new table version.
+ * @details The copies are written one after the other in the first good
+ *          reserved blocks, so a valid copy survives an interrupted update.
+ *          Reserved blocks failing erase or program are marked bad.
+ *
+ * @param[in] nandp         pointer to the @p NANDDriver object
+ *
+ * @notapi
+ */
+static void bbt_store(NANDDriver *nandp) {
+
+  const uint32_t first = total_blocks(nandp->config) - NAND_BBT_BLOCKS;
+  bbt_header_t hdr;
+  uint32_t i, a[4], version = 0, copies = 0;
+
+  for (i = 0; i < NAND_BBT_BLOCKS; i++) {
+    if (bbt_read_header(nandp, first + i, &hdr) && (hdr.version > version)) {
+      version = hdr.version;
+    }
+  }
+
+  hdr.magic   = BBT_MAGIC;
+  hdr.version = version + 1;
+  hdr.nblocks = total_blocks(nandp->config);
+  hdr.crc     = bbt_crc(&hdr, nandp->bb_map->array,
+                        bbt_map_size(nandp->config));
+
+  for (i = 0; (i < NAND_BBT_BLOCKS) && (copies < BBT_COPIES); i++) {
+    block_coords(nandp->config, first + i, a);
+    if (readIsBlockBad(nandp, a[0], a[1], a[2], a[3])) {
+      continue;
+    }
+    if (HAL_SUCCESS == bbt_write_copy(nandp, a, &hdr)) {
+      copies++;
+    }
+    else {
+      write_bad_mark(nandp, a[0], a[1], a[2], a[3]);
+    }
+  }
+}
+#endif /* NAND_USE_BBT */
+
 /*===========================================================================*/
 /* Driver exported functions.                                                */
 /*===========================================================================*/
@@ -340,14 +727,26 @@ void nandObjectInit(NANDDriver *nandp) {
 
 /**
  * @brief   Configures and activates the NAND peripheral.
+ * @details When @p NAND_USE_BBT is enabled the bad block map is loaded from
+ *          the on-flash table, the table is rebuilt by a full scan if it is
+ *          missing or corrupt.
+ * @warning Creating the table erases the last @p NAND_BBT_BLOCKS blocks.
+ *          It is refused if they hold programmed pages that are not table
+ *          pages: the map is then built by a full scan, the blocks are left
+ *          untouched and usable, and @p HAL_FAILED is returned. Erase them
+ *          to let the next start create the table.
  *
  * @param[in] nandp         pointer to the @p NANDDriver object
  * @param[in] config        pointer to the @p NANDConfig object
  * @param[in] bb_map        pointer to the bad block map or @NULL if not need
  *
+ * @return                  The operation status.
+ * @retval HAL_SUCCESS      the driver is started.
+ * @retval HAL_FAILED       the driver is started without bad block table.
+ *
  * @api
  */
-void nandStart(NANDDriver *nandp, const NANDConfig *config, bitmap_t *bb_map) {
+bool nandStart(NANDDriver *nandp, const NANDConfig *config, bitmap_t *bb_map) {
 
   osalDbgCheck((nandp != NULL) && (config != NULL));
   osalDbgAssert((nandp->state == NAND_STOP) ||
@@ -365,10 +764,29 @@ void nandStart(NANDDriver *nandp, const NANDConfig *config, bitmap_t *bb_map) {
     nand_lld_reset(nandp);
   }
 
+#if NAND_USE_BBT
+  nandp->bbt_active = false;
+#endif
   if (NULL != bb_map) {
     nandp->bb_map = bb_map;
+#if NAND_USE_BBT
+    osalDbgCheck(bitmapGetBitsCount(bb_map) >= total_blocks(config));
+    if (HAL_SUCCESS != bbt_load(nandp)) {
+      scan_bad_blocks(nandp);
+      if (HAL_SUCCESS != bbt_check_area(nandp)) {
+        return HAL_FAILED;
+      }
+      bbt_reserve(nandp);
+      bbt_store(nandp);
+    }
+    bbt_reserve(nandp);
+    nandp->bbt_active = true;
+#else
     scan_bad_blocks(nandp);
+#endif
   }
+
+  return HAL_SUCCESS;
 }
 
 /**
@@ -616,8 +1034,245 @@ uint8_t nandWritePageSpare(NANDDriver *nandp, uint32_t die, uint32_t logun,
   return nand_lld_write_data(nandp, spare, sparelen, addr, addrlen, NULL);
 }
 
+/**
+ * @brief   Read consecutive pages of a block.
+ * @details Uses the cache read commands when the low level driver supports
+ *          them, the array read of a page then overlaps the transfer of the
+ *          previous one.
+ *
+ * @param[in] nandp         pointer to the @p NANDDriver object
+ * @param[in] die           die number in nand flash
+ * @param[in] logun         logical unit number in nand flash
+ * @param[in] plane         plane number in nand flash
+ * @param[in] block         block number
+ * @param[in] page          first page number related to begin of block
+ * @param[in] npages        number of pages, not crossing the block end
+ * @param[out] data         buffer to store data, @p npages * @p pagelen
+ *                          bytes, half word aligned
+ * @param[in] pagelen       bytes read from each page, half word aligned
+ *
+ * @api
+ */
+void nandReadSequential(NANDDriver *nandp, uint32_t die, uint32_t logun,
+                        uint32_t plane, uint32_t block, uint32_t page,
+                        uint32_t npages, void *data, size_t pagelen) {
+
+  const NANDConfig *cfg = nandp->config;
+
+  osalDbgCheck((nandp != NULL) && (data != NULL) && (npages > 0));
+  osalDbgCheck((pagelen <= (cfg->page_data_size + cfg->page_spare_size)));
+  osalDbgCheck(page + npages <= cfg->pages_per_block);
+  osalDbgAssert(nandp->state == NAND_READY, "invalid state");
+
+#if NAND_SUPPORTS_CACHE_OPS
+  {
+    const size_t addrlen = cfg->rowcycles + cfg->colcycles;
+    uint8_t addr[addrlen];
+
+    osalDbgCheck(die <= cfg->dies);
+    osalDbgCheck(logun <= cfg->loguns);
+    osalDbgCheck(plane <= cfg->planes);
+    osalDbgCheck(block <= cfg->blocks);
+
+    /* generates chipselect for a particular die if need be */
+    hook_for_chipselect_nand_flash(die);
+    calc_addr(cfg, logun, plane, block, page, 0, addr, addrlen);
+    nand_lld_read_cached(nandp, data, pagelen, addr, addrlen, npages);
+  }
+#else
+  {
+    uint8_t *p = data;
+    uint32_t i;
+
+    for (i = 0; i < npages; i++, p += pagelen) {
+      nandReadPageWhole(nandp, die, logun, plane, block, page + i,
+                        p, pagelen);
+    }
+  }
+#endif
+}
+
+/**
+ * @brief   Write consecutive pages of a block.
+ * @details Uses the cache program command when the low level driver
+ *          supports it, the transfer of a page then overlaps the
+ *          programming of the previous one.
+ *
+ * @param[in] nandp         pointer to the @p NANDDriver object
+ * @param[in] die           die number in nand flash
+ * @param[in] logun         logical unit number in nand flash
+ * @param[in] plane         plane number in nand flash
+ * @param[in] block         block number
+ * @param[in] page          first page number related to begin of block
+ * @param[in] npages        number of pages, not crossing the block end
+ * @param[in] data          buffer with data to be written,
+ *                          @p npages * @p pagelen bytes, half word aligned
+ * @param[in] pagelen       bytes written to each page, half word aligned
+ *
+ * @return    The status bits of all the pages ORed together, a failure
+ *            does not tell which page failed.
+ *
+ * @api
+ */
+uint8_t nandWriteSequential(NANDDriver *nandp, uint32_t die, uint32_t logun,
+                            uint32_t plane, uint32_t block, uint32_t page,
+                            uint32_t npages, const void *data,
+                            size_t pagelen) {
+
+  const NANDConfig *cfg = nandp->config;
+
+  osalDbgCheck((nandp != NULL) && (data != NULL) && (npages > 0));
+  osalDbgCheck((pagelen <= (cfg->page_data_size + cfg->page_spare_size)));
+  osalDbgCheck(page + npages <= cfg->pages_per_block);
+  osalDbgAssert(nandp->state == NAND_READY, "invalid state");
+
+#if NAND_SUPPORTS_CACHE_OPS
+  {
+    const size_t addrlen = cfg->rowcycles + cfg->colcycles;
+    uint8_t addr[addrlen];
+
+    osalDbgCheck(die <= cfg->dies);
+    osalDbgCheck(logun <= cfg->loguns);
+    osalDbgCheck(plane <= cfg->planes);
+    osalDbgCheck(block <= cfg->blocks);
+
+    /* generates chipselect for a particular die if need be */
+    hook_for_chipselect_nand_flash(die);
+    calc_addr(cfg, logun, plane, block, page, 0, addr, addrlen);
+    return nand_lld_write_cached(nandp, data, pagelen, addr, addrlen, npages);
+  }
+#else
+  {
+    const uint8_t *p = data;
+    uint8_t status = 0;
+    uint32_t i;
+
+    for (i = 0; i < npages; i++, p += pagelen) {
+      status |= nandWritePageWhole(nandp, die, logun, plane, block, page + i,
+                                   p, pagelen);
+    }
+    return status;
+  }
+#endif
+}
+
+/**
+ * @brief   Write the same page on all the planes of a logical unit.
+ * @details Uses a multi-plane program when the low level driver supports
+ *          it, the program time is then paid once for all the planes.
+ *
+ * @param[in] nandp         pointer to the @p NANDDriver object
+ * @param[in] die           die number in nand flash
+ * @param[in] logun         logical unit number in nand flash
+ * @param[in] block         block number in each plane
+ * @param[in] page          page number related to begin of block
+ * @param[in] data          buffer with data to be written, one @p pagelen
+ *                          chunk per plane, half word aligned
+ * @param[in] pagelen       bytes written to each page, half word aligned
+ *
+ * @return    The status bits of all the planes ORed together.
+ *
+ * @api
+ */
+uint8_t nandWritePageMultiPlane(NANDDriver *nandp, uint32_t die,
+                                uint32_t logun, uint32_t block,
+                                uint32_t page, const void *data,
+                                size_t pagelen) {
+
+  const NANDConfig *cfg = nandp->config;
+
+  osalDbgCheck((nandp != NULL) && (data != NULL));
+  osalDbgCheck((pagelen <= (cfg->page_data_size + cfg->page_spare_size)));
+  osalDbgAssert(nandp->state == NAND_READY, "invalid state");
+
+#if NAND_SUPPORTS_CACHE_OPS
+  {
+    const size_t addrlen = cfg->rowcycles + cfg->colcycles;
+    uint8_t addr[addrlen * cfg->planes];
+    uint32_t p;
+
+    osalDbgCheck(die <= cfg->dies);
+    osalDbgCheck(logun <= cfg->loguns);
+    osalDbgCheck(block <= cfg->blocks);
+
+    /* generates chipselect for a particular die if need be */
+    hook_for_chipselect_nand_flash(die);
+    for (p = 0; p < cfg->planes; p++) {
+      calc_addr(cfg, logun, p, block, page, 0, &addr[p * addrlen], addrlen);
+    }
+    return nand_lld_write_multiplane(nandp, data, pagelen, addr, addrlen,
+                                     cfg->planes);
+  }
+#else
+  {
+    const uint8_t *d = data;
+    uint8_t status = 0;
+    uint32_t p;
+
+    for (p = 0; p < cfg->planes; p++, d += pagelen) {
+      status |= nandWritePageWhole(nandp, die, logun, p, block, page,
+                                   d, pagelen);
+    }
+    return status;
+  }
+#endif
+}
+
+/**
+ * @brief   Erase the same block on all the planes of a logical unit.
+ * @details Uses a multi-plane erase when the low level driver supports it.
+ *
+ * @param[in] nandp         pointer to the @p NANDDriver object
+ * @param[in] die           die number in nand flash
+ * @param[in] logun         logical unit number in nand flash
+ * @param[in] block         block number in each plane
+ *
+ * @return    The status bits of all the planes ORed together.
+ *
+ * @api
+ */
+uint8_t nandEraseMultiPlane(NANDDriver *nandp, uint32_t die, uint32_t logun,
+                            uint32_t block) {
+
+  const NANDConfig *cfg = nandp->config;
+
+  osalDbgCheck(nandp != NULL);
+  osalDbgAssert(nandp->state == NAND_READY, "invalid state");
+
+#if NAND_SUPPORTS_CACHE_OPS
+  {
+    const size_t addrlen = cfg->rowcycles;
+    uint8_t addr[addrlen * cfg->planes];
+    uint32_t p;
+
+    osalDbgCheck(die <= cfg->dies);
+    osalDbgCheck(logun <= cfg->loguns);
+    osalDbgCheck(block <= cfg->blocks);
+
+    /* generates chipselect for a particular die if need be */
+    hook_for_chipselect_nand_flash(die);
+    for (p = 0; p < cfg->planes; p++) {
+      calc_blk_addr(cfg, logun, p, block, &addr[p * addrlen], addrlen);
+    }
+    return nand_lld_erase_multiplane(nandp, addr, addrlen, cfg->planes);
+  }
+#else
+  {
+    uint8_t status = 0;
+    uint32_t p;
+
+    for (p = 0; p < cfg->planes; p++) {
+      status |= nandErase(nandp, die, logun, p, block);
+    }
+    return status;
+  }
+#endif
+}
+
 /**
  * @brief   Mark block as bad.
+ * @details When @p NAND_USE_BBT is enabled and the block was not already
+ *          in the map the on-flash table is updated.
  *
  * @param[in] nandp         pointer to the @p NANDDriver object
  * @param[in] die           die number in nand flash
@@ -630,10 +1285,7 @@ uint8_t nandWritePageSpare(NANDDriver *nandp, uint32_t die, uint32_t logun,
 void nandMarkBad(NANDDriver *nandp, uint32_t die, uint32_t logun,
                  uint32_t plane, uint32_t block) {
 
-  uint16_t bb_mark = 0;
-
-  nandWritePageSpare(nandp, die, logun, plane, block, 0, &bb_mark, sizeof(bb_mark));
-  nandWritePageSpare(nandp, die, logun, plane, block, 1, &bb_mark, sizeof(bb_mark));
+  write_bad_mark(nandp, die, logun, plane, block);
 
   if (NULL != nandp->bb_map){
     uint32_t block_number_of_total_blocks = block +
@@ -644,7 +1296,16 @@ void nandMarkBad(NANDDriver *nandp, uint32_t die, uint32_t logun,
         /* NAND_BLOCKS_PER_PLANE * NAND_PLANES_PER_LOGUN * NAND_LOGUNS_PER_DIE */
         (nandp->config->blocks * nandp->config->planes * nandp->config->loguns * die);
 
+#if NAND_USE_BBT
+    if (0 == bitmapGet(nandp->bb_map, block_number_of_total_blocks)) {
+      bitmapSet(nandp->bb_map, block_number_of_total_blocks);
+      if (nandp->bbt_active) {
+        bbt_store(nandp);
+      }
+    }
+#else
     bitmapSet(nandp->bb_map, block_number_of_total_blocks);
+#endif
   }
 }
 
@@ -34,6 +34,16 @@
 
 For data write it is only master channel needed. Data bit width updates
 on every timer overflow event.
+
+3) UART master (Maxim's AN214): TX and RX tied to the bus, every character
+   is a time slot. At 115200 baud the start bit and the data bits of 0x00
+   hold the bus low for 78us (write 0), 0xFF only for the start bit (write 1
+   and read slot). The character received back is 0xFF unless a slave
+   pulled the bus low, i.e. read a 0. Reset is 0xF0 at 9600 baud.
+
+   The slots of ONEWIRE_UART_BUFFER_BYTES bytes are sent and received back
+   by a single pair of DMA transfers, a search ROM step (direction of the
+   previous bit and two read slots) by another one.
 */
 
 /*===========================================================================*/
@@ -81,9 +91,33 @@ on every timer overflow event.
 #define ONEWIRE_RESET_SAMPLE_WIDTH    550
 #define ONEWIRE_RESET_TOTAL_WIDTH     960
 
+/**
+ * @brief     UART speeds and characters.
+ */
+#define ONEWIRE_UART_RESET_SPEED      9600
+#define ONEWIRE_UART_DATA_SPEED       115200
+#define ONEWIRE_UART_RESET            0xF0
+#define ONEWIRE_UART_ZERO             0x00
+#define ONEWIRE_UART_ONE              0xFF
+
+/**
+ * @brief     Bus master operations.
+ */
+struct onewire_master {
+  void (*start)(onewireDriver *owp);
+  void (*stop)(onewireDriver *owp);
+  bool (*reset)(onewireDriver *owp);
+  void (*read)(onewireDriver *owp, uint8_t *rxbuf, size_t rxbytes);
+  void (*write)(onewireDriver *owp, uint8_t *txbuf, size_t txbytes);
+#if ONEWIRE_USE_SEARCH_ROM
+  void (*search_rom)(onewireDriver *owp);
+#endif
+};
+
 /**
  * @brief     Local function declarations.
  */
+#if ONEWIRE_USE_PWM
 static void ow_reset_cb(PWMDriver *pwmp, onewireDriver *owp);
 static void pwm_reset_cb(PWMDriver *pwmp);
 static void ow_read_bit_cb(PWMDriver *pwmp, onewireDriver *owp);
@@ -94,6 +128,11 @@ static void pwm_write_bit_cb(PWMDriver *pwmp);
 static void ow_search_rom_cb(PWMDriver *pwmp, onewireDriver *owp);
 static void pwm_search_rom_cb(PWMDriver *pwmp);
 #endif
+#endif /* ONEWIRE_USE_PWM */
+#if ONEWIRE_USE_UART
+static void ow_uart_rxend_cb(UARTDriver *uartp, onewireDriver *owp);
+static void uart_rxend_cb(UARTDriver *uartp);
+#endif
 
 /*===========================================================================*/
 /* Driver exported variables.                                                */
@@ -106,6 +145,11 @@ onewireDriver OWD1;
 /*===========================================================================*/
 /* Driver local variables and types.                                         */
 /*===========================================================================*/
+/**
+ * @brief     Started drivers, the adapters look up the callback owner here.
+ */
+static onewireDriver *ow_drivers;
+
 /**
  * @brief     Look up table for fast 1-wire CRC calculation
  */
@@ -147,6 +191,7 @@ static const uint8_t onewire_crc_table[256] = {
 /*===========================================================================*/
 /* Driver local functions.                                                   */
 /*===========================================================================*/
+#if ONEWIRE_USE_PWM
 /**
  * @brief     Put bus in idle mode.
  */
@@ -168,6 +213,7 @@ static void ow_bus_active(onewireDriver *owp) {
       owp->config->pad_mode_active);
 #endif
 }
+#endif /* ONEWIRE_USE_PWM */
 
 /**
  * @brief     Function performing read of single bit.
@@ -182,25 +228,42 @@ static ioline_t ow_read_bit(onewireDriver *owp) {
 #endif
 }
 
+#if ONEWIRE_USE_PWM
+/**
+ * @brief     Finds the driver using a PWM.
+ * @note      Callable from ISR.
+ */
+static onewireDriver *pwm_owp(PWMDriver *pwmp) {
+  onewireDriver *owp = ow_drivers;
+
+#if ONEWIRE_USE_UART
+  while ((owp->config->pwmd != pwmp) || (NULL != owp->config->uartd))
+#else
+  while (owp->config->pwmd != pwmp)
+#endif
+    owp = owp->next;
+  return owp;
+}
+
 /**
  * @brief     PWM adapter
  */
 static void pwm_reset_cb(PWMDriver *pwmp) {
-  ow_reset_cb(pwmp, &OWD1);
+  ow_reset_cb(pwmp, pwm_owp(pwmp));
 }
 
 /**
  * @brief     PWM adapter
  */
 static void pwm_read_bit_cb(PWMDriver *pwmp) {
-  ow_read_bit_cb(pwmp, &OWD1);
+  ow_read_bit_cb(pwmp, pwm_owp(pwmp));
 }
 
 /**
  * @brief     PWM adapter
  */
 static void pwm_write_bit_cb(PWMDriver *pwmp) {
-  ow_write_bit_cb(pwmp, &OWD1);
+  ow_write_bit_cb(pwmp, pwm_owp(pwmp));
 }
 
 #if ONEWIRE_USE_SEARCH_ROM
@@ -208,7 +271,7 @@ static void pwm_write_bit_cb(PWMDriver *pwmp) {
  * @brief     PWM adapter
  */
 static void pwm_search_rom_cb(PWMDriver *pwmp) {
-  ow_search_rom_cb(pwmp, &OWD1);
+  ow_search_rom_cb(pwmp, pwm_owp(pwmp));
 }
 #endif /* ONEWIRE_USE_SEARCH_ROM */
 
@@ -340,6 +403,7 @@ static void ow_write_bit_cb(PWMDriver *pwmp, onewireDriver *owp) {
   ow_write_bit_I(owp, (*owp->buf >> owp->reg.bit) & 1);
   owp->reg.bit++;
 }
+#endif /* ONEWIRE_USE_PWM */
 
 #if ONEWIRE_USE_SEARCH_ROM
 /**
@@ -422,6 +486,37 @@ static uint8_t collision_handler(onewire_search_rom_t *sr) {
   }
 }
 
+/**
+ * @brief     Chooses the branch to follow from the two bits read.
+ *
+ * @param[in,out] sr    pointer to the @p onewire_search_rom_t helper structure
+ * @param[in] bit_buf   direct bit in bit 0, complemented bit in bit 1
+ *
+ * @return              Bit to be written, -1 on error.
+ */
+static int search_decide(onewire_search_rom_t *sr, uint8_t bit_buf) {
+
+  switch(bit_buf){
+  case 0b11:
+    /* no one device on bus or any other fail happened */
+    sr->reg.result = ONEWIRE_SEARCH_ROM_ERROR;
+    return -1;
+  case 0b01:
+    /* all slaves have 1 in this position */
+    store_bit(sr, 1);
+    return 1;
+  case 0b10:
+    /* all slaves have 0 in this position */
+    store_bit(sr, 0);
+    return 0;
+  default:
+    /* collision */
+    sr->reg.single_device = false;
+    return collision_handler(sr);
+  }
+}
+
+#if ONEWIRE_USE_PWM
 /**
  * @brief     1-wire search ROM callback.
  * @note      Must be called from PWM's ISR.
@@ -434,6 +529,7 @@ static uint8_t collision_handler(onewire_search_rom_t *sr) {
 static void ow_search_rom_cb(PWMDriver *pwmp, onewireDriver *owp) {
 
   onewire_search_rom_t *sr = &owp->search_rom;
+  int bit;
 
   if (0 == sr->reg.bit_step) {                    /* read direct bit */
     sr->reg.bit_buf |= ow_read_bit(owp);
@@ -442,28 +538,10 @@ static void ow_search_rom_cb(PWMDriver *pwmp, onewireDriver *owp) {
   else if (1 == sr->reg.bit_step) {               /* read complement bit */
     sr->reg.bit_buf |= ow_read_bit(owp) << 1;
     sr->reg.bit_step++;
-    switch(sr->reg.bit_buf){
-    case 0b11:
-      /* no one device on bus or any other fail happened */
-      sr->reg.result = ONEWIRE_SEARCH_ROM_ERROR;
+    bit = search_decide(sr, sr->reg.bit_buf);
+    if (bit < 0)
       goto THE_END;
-      break;
-    case 0b01:
-      /* all slaves have 1 in this position */
-      store_bit(sr, 1);
-      ow_write_bit_I(owp, 1);
-      break;
-    case 0b10:
-      /* all slaves have 0 in this position */
-      store_bit(sr, 0);
-      ow_write_bit_I(owp, 0);
-      break;
-    case 0b00:
-      /* collision */
-      sr->reg.single_device = false;
-      ow_write_bit_I(owp, collision_handler(sr));
-      break;
-    }
+    ow_write_bit_I(owp, bit);
   }
   else {                                      /* start next step */
     #if !ONEWIRE_SYNTH_SEARCH_TEST
@@ -495,6 +573,7 @@ THE_END:
   osalSysUnlockFromISR();
 #endif
 }
+#endif /* ONEWIRE_USE_PWM */
 
 /**
  * @brief       Helper function. Initialize structures required by 'search ROM'.
@@ -530,76 +609,76 @@ static void search_clean_iteration(onewire_search_rom_t *sr) {
   sr->reg.bit_buf = 0;
   sr->reg.result = ONEWIRE_SEARCH_ROM_LAST;
 }
-#endif /* ONEWIRE_USE_SEARCH_ROM */
-
-/*===========================================================================*/
-/* Driver exported functions.                                                */
-/*===========================================================================*/
 
 /**
- * @brief   Calculates 1-wire CRC.
- *
- * @param[in] buf     pointer to the data buffer
- * @param[in] len     lenght of data buffer
+ * @brief       Helper function. Makes the next search pass follow a path.
+ * @details     At every collision the pass takes the bit of @p path, then
+ *              the 0-branch once @p path has been exhausted, as a first
+ *              pass would.
  *
- * @init
+ * @param[in] sr        pointer to the @p onewire_search_rom_t helper structure
+ * @param[in] path      ROM bits to follow
+ * @param[in] len       length of @p path in bytes
  */
-uint8_t onewireCRC(const uint8_t *buf, size_t len) {
-  uint8_t ret = 0;
-  size_t i;
-
-  for (i=0; i<len; i++)
-    ret = onewire_crc_table[ret ^ buf[i]];
+static void search_preset(onewire_search_rom_t *sr,
+                          const uint8_t *path, size_t len) {
 
-  return ret;
+  memset(sr->prev_path, 0, 8);
+  memcpy(sr->prev_path, path, len);
+  sr->reg.search_iter = ONEWIRE_SEARCH_ROM_NEXT;
+  /* out of the tree, every collision follows the path */
+  sr->last_zero_branch = 64;
+  sr->prev_zero_branch = -1;
 }
 
 /**
- * @brief   Initializes @p onewireDriver structure.
- *
- * @param[out] owp    pointer to the @p onewireDriver object
+ * @brief       Helper function. Compares ROMs in search order.
+ * @details     The search takes the 0-branch first, starting from the least
+ *              significant bit of the first byte.
  *
- * @init
+ * @return      Negative, zero or positive when @p a comes before, is equal
+ *              or comes after @p b.
  */
-void onewireObjectInit(onewireDriver *owp) {
+static int rom_cmp(const uint8_t *a, const uint8_t *b) {
 
-  osalDbgCheck(NULL != owp);
+  uint8_t diff;
+  size_t i;
 
-  owp->config = NULL;
-  owp->reg.slave_present = false;
-  owp->reg.state = ONEWIRE_STOP;
-  owp->thread = NULL;
+  for (i = 0; i < 8; i++) {
+    diff = a[i] ^ b[i];
+    if (0 != diff) {
+      diff &= -diff; /* lowest differing bit */
+      return (0 != (a[i] & diff)) ? 1 : -1;
+    }
+  }
+  return 0;
+}
 
-  owp->reg.bytes = 0;
-  owp->reg.bit = 0;
-  owp->reg.final_timeslot = false;
-  owp->buf = NULL;
+/**
+ * @brief       Helper function. Drops cached ROMs from @p first on.
+ */
+static void cache_remove(onewireRomCache *cache, size_t first, size_t n) {
 
-#if ONEWIRE_USE_STRONG_PULLUP
-  owp->reg.need_pullup = false;
-#endif
+  memmove(cache->roms + 8 * first, cache->roms + 8 * (first + n),
+          8 * (cache->count - first - n));
+  cache->count -= n;
 }
+#endif /* ONEWIRE_USE_SEARCH_ROM */
 
+#if ONEWIRE_USE_PWM
+/*===========================================================================*/
+/* PWM bus master.                                                           */
+/*===========================================================================*/
 /**
- * @brief   Configures and activates the 1-wire driver.
+ * @brief     Starts the PWM bus master.
  *
  * @param[in] owp       pointer to the @p onewireDriver object
- * @param[in] config    pointer to the @p onewireConfig object
- *
- * @api
  */
-void onewireStart(onewireDriver *owp, const onewireConfig *config) {
+static void ow_pwm_start(onewireDriver *owp) {
 
-  osalDbgCheck((NULL != owp) && (NULL != config));
-  osalDbgAssert(PWM_STOP == config->pwmd->state,
+  osalDbgAssert(PWM_STOP == owp->config->pwmd->state,
       "PWM will be started by onewire driver internally");
-  osalDbgAssert(ONEWIRE_STOP == owp->reg.state, "Invalid state");
-#if ONEWIRE_USE_STRONG_PULLUP
-  osalDbgCheck((NULL != config->pullup_assert) &&
-               (NULL != config->pullup_release));
-#endif
 
-  owp->config = config;
   owp->config->pwmcfg->frequency = ONEWIRE_PWM_FREQUENCY;
   owp->config->pwmcfg->period = ONEWIRE_RESET_TOTAL_WIDTH;
 
@@ -608,47 +687,29 @@ void onewireStart(onewireDriver *owp, const onewireConfig *config) {
       owp->config->pad_mode_active);
 #endif
   ow_bus_idle(owp);
-  owp->reg.state = ONEWIRE_READY;
 }
 
 /**
- * @brief   Deactivates the UART peripheral.
+ * @brief     Stops the PWM bus master.
  *
  * @param[in] owp       pointer to the @p onewireDriver object
- *
- * @api
  */
-void onewireStop(onewireDriver *owp) {
-  osalDbgCheck(NULL != owp);
-#if ONEWIRE_USE_STRONG_PULLUP
-  owp->config->pullup_release();
-#endif
+static void ow_pwm_stop(onewireDriver *owp) {
+
   ow_bus_idle(owp);
   pwmStop(owp->config->pwmd);
-  owp->config = NULL;
-  owp->reg.state = ONEWIRE_STOP;
 }
 
 /**
- * @brief     Generate reset pulse on bus.
+ * @brief     Generates reset pulse with the PWM.
  *
  * @param[in] owp       pointer to the @p onewireDriver object
- *
- * @return              Bool flag denoting device presence.
- * @retval true         There is at least one device on bus.
  */
-bool onewireReset(onewireDriver *owp) {
+static bool ow_pwm_reset(onewireDriver *owp) {
   PWMDriver *pwmd;
   PWMConfig *pwmcfg;
   size_t mch, sch;
 
-  osalDbgCheck(NULL != owp);
-  osalDbgAssert(owp->reg.state == ONEWIRE_READY, "Invalid state");
-
-  /* short circuit on bus or any other device transmit data */
-  if (PAL_LOW == ow_read_bit(owp))
-    return false;
-
   pwmd = owp->config->pwmd;
   pwmcfg = owp->config->pwmcfg;
   mch = owp->config->master_channel;
@@ -679,25 +740,17 @@ bool onewireReset(onewireDriver *owp) {
 }
 
 /**
- * @brief     Read some bytes from slave device.
+ * @brief     Reads bytes with the PWM.
  *
  * @param[in] owp       pointer to the @p onewireDriver object
- * @param[out] rxbuf    pointer to the buffer for read data
+ * @param[out] rxbuf    pointer to the zeroed buffer for read data
  * @param[in] rxbytes   amount of data to be received
  */
-void onewireRead(onewireDriver *owp, uint8_t *rxbuf, size_t rxbytes) {
+static void ow_pwm_read(onewireDriver *owp, uint8_t *rxbuf, size_t rxbytes) {
   PWMDriver *pwmd;
   PWMConfig *pwmcfg;
   size_t mch, sch;
 
-  osalDbgCheck((NULL != owp) && (NULL != rxbuf));
-  osalDbgCheck((rxbytes > 0) && (rxbytes <= ONEWIRE_MAX_TRANSACTION_LEN));
-  osalDbgAssert(owp->reg.state == ONEWIRE_READY, "Invalid state");
-
-  /* Buffer zeroing. This is important because of driver collects
-     bits using |= operation.*/
-  memset(rxbuf, 0, rxbytes);
-
   pwmd = owp->config->pwmd;
   pwmcfg = owp->config->pwmcfg;
   mch = owp->config->master_channel;
@@ -727,28 +780,17 @@ void onewireRead(onewireDriver *owp, uint8_t *rxbuf, size_t rxbytes) {
 }
 
 /**
- * @brief     Write some bytes to slave device.
+ * @brief     Writes bytes with the PWM.
  *
- * @param[in] owp           pointer to the @p onewireDriver object
- * @param[in] txbuf         pointer to the buffer with data to be written
- * @param[in] txbytes       amount of data to be written
- * @param[in] pullup_time   how long strong pull up must be activated. Set
- *                          it to 0 if not needed.
+ * @param[in] owp       pointer to the @p onewireDriver object
+ * @param[in] txbuf     pointer to the buffer with data to be written
+ * @param[in] txbytes   amount of data to be written
  */
-void onewireWrite(onewireDriver *owp, uint8_t *txbuf,
-                  size_t txbytes, systime_t pullup_time) {
+static void ow_pwm_write(onewireDriver *owp, uint8_t *txbuf, size_t txbytes) {
   PWMDriver *pwmd;
   PWMConfig *pwmcfg;
   size_t mch, sch;
 
-  osalDbgCheck((NULL != owp) && (NULL != txbuf));
-  osalDbgCheck((txbytes > 0) && (txbytes <= ONEWIRE_MAX_TRANSACTION_LEN));
-  osalDbgAssert(owp->reg.state == ONEWIRE_READY, "Invalid state");
-#if !ONEWIRE_USE_STRONG_PULLUP
-  osalDbgAssert(0 == pullup_time,
-      "Non zero time is valid only when strong pull enabled");
-#endif
-
   pwmd = owp->config->pwmd;
   pwmcfg = owp->config->pwmcfg;
   mch = owp->config->master_channel;
@@ -766,13 +808,6 @@ void onewireWrite(onewireDriver *owp, uint8_t *txbuf,
   pwmcfg->channels[sch].callback = NULL;
   pwmcfg->channels[sch].mode = PWM_OUTPUT_DISABLED;
 
-#if ONEWIRE_USE_STRONG_PULLUP
-  if (pullup_time > 0) {
-    owp->reg.state = ONEWIRE_PULL_UP;
-    owp->reg.need_pullup = true;
-  }
-#endif
-
   ow_bus_active(owp);
   osalSysLock();
   pwmEnablePeriodicNotificationI(pwmd);
@@ -781,99 +816,836 @@ void onewireWrite(onewireDriver *owp, uint8_t *txbuf,
 
   pwmDisablePeriodicNotification(pwmd);
   ow_bus_idle(owp);
-
-#if ONEWIRE_USE_STRONG_PULLUP
-  if (pullup_time > 0) {
-    osalThreadSleep(pullup_time);
-    owp->config->pullup_release();
-    owp->reg.state = ONEWIRE_READY;
-  }
-#endif
 }
 
 #if ONEWIRE_USE_SEARCH_ROM
 /**
- * @brief   Performs tree search on bus.
- * @note    This function does internal 1-wire reset calls every search
- *          iteration.
+ * @brief     Discovers one ROM with the PWM.
+ * @pre       Search ROM command already sent.
  *
- * @param[in] owp         pointer to a @p OWDriver object
- * @param[out] result     pointer to buffer for discovered ROMs
- * @param[in] max_rom_cnt buffer size in ROMs count for overflow prevention
- *
- * @return              Count of discovered ROMs. May be more than max_rom_cnt.
- * @retval 0            no ROMs found or communication error occurred.
+ * @param[in] owp       pointer to the @p onewireDriver object
  */
-size_t onewireSearchRom(onewireDriver *owp, uint8_t *result,
-                        size_t max_rom_cnt) {
+static void ow_pwm_search_rom(onewireDriver *owp) {
   PWMDriver *pwmd;
   PWMConfig *pwmcfg;
-  uint8_t cmd;
   size_t mch, sch;
 
-  osalDbgCheck(NULL != owp);
-  osalDbgAssert(ONEWIRE_READY == owp->reg.state, "Invalid state");
-  osalDbgCheck((max_rom_cnt <= 256) && (max_rom_cnt > 0));
-
   pwmd = owp->config->pwmd;
   pwmcfg = owp->config->pwmcfg;
-  cmd = ONEWIRE_CMD_SEARCH_ROM;
   mch = owp->config->master_channel;
   sch = owp->config->sample_channel;
 
-  search_clean_start(&owp->search_rom);
+  /* Reconfiguration always needed because of previous call onewireWrite.*/
+  pwmcfg->period = ONEWIRE_ZERO_WIDTH + ONEWIRE_RECOVERY_WIDTH;
+  pwmcfg->callback = NULL;
+  pwmcfg->channels[mch].callback = NULL;
+  pwmcfg->channels[mch].mode = owp->config->pwmmode;
+  pwmcfg->channels[sch].callback = pwm_search_rom_cb;
+  pwmcfg->channels[sch].mode = PWM_OUTPUT_DISABLED;
 
-  do {
-    /* every search must be started from reset pulse */
-    if (false == onewireReset(owp))
-      return 0;
+  ow_bus_active(owp);
+  osalSysLock();
+  pwmEnableChannelI(pwmd, mch, ONEWIRE_ONE_WIDTH);
+  pwmEnableChannelI(pwmd, sch, ONEWIRE_SAMPLE_WIDTH);
+  pwmEnableChannelNotificationI(pwmd, sch);
+  osalThreadSuspendS(&owp->thread);
+  osalSysUnlock();
 
-    /* initialize buffer to store result */
-    if (owp->search_rom.reg.devices_found >= max_rom_cnt)
-      owp->search_rom.retbuf = result + 8*(max_rom_cnt-1);
-    else
-      owp->search_rom.retbuf = result + 8*owp->search_rom.reg.devices_found;
-    memset(owp->search_rom.retbuf, 0, 8);
-
-    /* clean iteration state */
-    search_clean_iteration(&owp->search_rom);
-
-    /**/
-    onewireWrite(&OWD1, &cmd, 1, 0);
-
-    /* Reconfiguration always needed because of previous call onewireWrite.*/
-    pwmcfg->period = ONEWIRE_ZERO_WIDTH + ONEWIRE_RECOVERY_WIDTH;
-    pwmcfg->callback = NULL;
-    pwmcfg->channels[mch].callback = NULL;
-    pwmcfg->channels[mch].mode = owp->config->pwmmode;
-    pwmcfg->channels[sch].callback = pwm_search_rom_cb;
-    pwmcfg->channels[sch].mode = PWM_OUTPUT_DISABLED;
-
-    ow_bus_active(owp);
-    osalSysLock();
-    pwmEnableChannelI(pwmd, mch, ONEWIRE_ONE_WIDTH);
-    pwmEnableChannelI(pwmd, sch, ONEWIRE_SAMPLE_WIDTH);
-    pwmEnableChannelNotificationI(pwmd, sch);
-    osalThreadSuspendS(&owp->thread);
-    osalSysUnlock();
-
-    ow_bus_idle(owp);
-
-    if (ONEWIRE_SEARCH_ROM_ERROR != owp->search_rom.reg.result) {
-      /* check CRC and return 0 (0 == error) if mismatch */
-      if (owp->search_rom.retbuf[7] != onewireCRC(owp->search_rom.retbuf, 7))
-        return 0;
-      /* store cached result for usage in next iteration */
-      memcpy(owp->search_rom.prev_path, owp->search_rom.retbuf, 8);
-    }
+  ow_bus_idle(owp);
+
+  /* The last slot was cut at its sample point, a slave sending a 0 may
+     still hold the bus low.*/
+  osalThreadSleepMicroseconds(ONEWIRE_ZERO_WIDTH - ONEWIRE_SAMPLE_WIDTH);
+}
+#endif /* ONEWIRE_USE_SEARCH_ROM */
+
+/**
+ * @brief     PWM bus master.
+ */
+static const struct onewire_master pwm_master = {
+  ow_pwm_start,
+  ow_pwm_stop,
+  ow_pwm_reset,
+  ow_pwm_read,
+  ow_pwm_write,
+#if ONEWIRE_USE_SEARCH_ROM
+  ow_pwm_search_rom
+#endif
+};
+#endif /* ONEWIRE_USE_PWM */
+
+#if ONEWIRE_USE_UART
+/*===========================================================================*/
+/* UART bus master.                                                          */
+/*===========================================================================*/
+/**
+ * @brief     Sets the UART speed.
+ *
+ * @param[in] owp       pointer to the @p onewireDriver object
+ * @param[in] speed     baud rate
+ */
+static void ow_uart_speed(onewireDriver *owp, uint32_t speed) {
+
+  if (owp->config->uartcfg->speed != speed) {
+    owp->config->uartcfg->speed = speed;
+    uartStart(owp->config->uartd, owp->config->uartcfg);
   }
-  while (ONEWIRE_SEARCH_ROM_SUCCESS == owp->search_rom.reg.result);
+}
 
-  /**/
-  if (ONEWIRE_SEARCH_ROM_ERROR == owp->search_rom.reg.result)
-    return 0;
-  else
-    return owp->search_rom.reg.devices_found;
+/**
+ * @brief     Exchanges time slots with the bus.
+ * @details   Every character sent comes back from the bus once its slot
+ *            is over, the received one overwrites it in @p slots.
+ *
+ * @param[in] owp       pointer to the @p onewireDriver object
+ * @param[in] n         number of time slots
+ *
+ * @return              The operation status.
+ * @retval false        the UART did not complete the transfer in time.
+ */
+static bool ow_uart_xfer(onewireDriver *owp, size_t n) {
+  UARTDriver *uartd = owp->config->uartd;
+  sysinterval_t timeout;
+  msg_t msg;
+
+  /* twice the frames time, at least 2ms */
+  timeout = OSAL_US2I((uint32_t)n * 20U * 1000000U /
+                      owp->config->uartcfg->speed) + OSAL_MS2I(2);
+
+  osalSysLock();
+  uartStartReceiveI(uartd, n, owp->slots);
+  uartStartSendI(uartd, n, owp->slots);
+  msg = osalThreadSuspendTimeoutS(&owp->thread, timeout);
+  if (MSG_OK != msg) {
+    (void)uartStopReceiveI(uartd);
+    (void)uartStopSendI(uartd);
+  }
+  osalSysUnlock();
+
+  return MSG_OK == msg;
+}
+
+/**
+ * @brief     UART adapter
+ */
+static void uart_rxend_cb(UARTDriver *uartp) {
+  onewireDriver *owp = ow_drivers;
+
+  while (owp->config->uartd != uartp)
+    owp = owp->next;
+  ow_uart_rxend_cb(uartp, owp);
+}
+
+/**
+ * @brief     1-wire time slots exchanged callback.
+ * @note      Must be called from UART's ISR.
+ *
+ * @param[in] uartp     pointer to the @p UARTDriver object
+ * @param[in] owp       pointer to the @p onewireDriver object
+ *
+ * @notapi
+ */
+static void ow_uart_rxend_cb(UARTDriver *uartp, onewireDriver *owp) {
+
+  (void)uartp;
+
+#if ONEWIRE_USE_STRONG_PULLUP
+  if (owp->reg.need_pullup) {
+    owp->config->pullup_assert();
+    owp->reg.need_pullup = false;
+  }
+#endif
+
+  osalSysLockFromISR();
+  osalThreadResumeI(&owp->thread, MSG_OK);
+  osalSysUnlockFromISR();
+}
+
+/**
+ * @brief     Starts the UART bus master.
+ *
+ * @param[in] owp       pointer to the @p onewireDriver object
+ */
+static void ow_uart_start(onewireDriver *owp) {
+
+  owp->config->uartcfg->speed = ONEWIRE_UART_DATA_SPEED;
+  owp->config->uartcfg->rxend_cb = uart_rxend_cb;
+  uartStart(owp->config->uartd, owp->config->uartcfg);
+  palSetPadMode(owp->config->port, owp->config->pad,
+      owp->config->pad_mode_active);
+}
+
+/**
+ * @brief     Stops the UART bus master.
+ *
+ * @param[in] owp       pointer to the @p onewireDriver object
+ */
+static void ow_uart_stop(onewireDriver *owp) {
+
+#if defined(STM32F1XX)
+  palSetPadMode(owp->config->port, owp->config->pad,
+      owp->config->pad_mode_idle);
+#endif
+  uartStop(owp->config->uartd);
+}
+
+/**
+ * @brief     Generates reset pulse with the UART.
+ * @details   The reset character holds the bus low for 5 bits at the reset
+ *            speed, the presence pulse of any slave corrupts its high bits.
+ *
+ * @param[in] owp       pointer to the @p onewireDriver object
+ */
+static bool ow_uart_reset(onewireDriver *owp) {
+  bool done;
+  uint8_t c;
+
+  ow_uart_speed(owp, ONEWIRE_UART_RESET_SPEED);
+  owp->slots[0] = ONEWIRE_UART_RESET;
+  done = ow_uart_xfer(owp, 1);
+  c = owp->slots[0];
+  ow_uart_speed(owp, ONEWIRE_UART_DATA_SPEED);
+
+  /* a bus low during the whole character is a short circuit */
+  return done && (ONEWIRE_UART_RESET != c) && (0 != c);
+}
+
+/**
+ * @brief     Reads bytes with the UART.
+ *
+ * @param[in] owp       pointer to the @p onewireDriver object
+ * @param[out] rxbuf    pointer to the zeroed buffer for read data
+ * @param[in] rxbytes   amount of data to be received
+ */
+static void ow_uart_read(onewireDriver *owp, uint8_t *rxbuf, size_t rxbytes) {
+  size_t chunk, i;
+
+  while (rxbytes > 0) {
+    chunk = (rxbytes < ONEWIRE_UART_BUFFER_BYTES) ?
+            rxbytes : ONEWIRE_UART_BUFFER_BYTES;
+
+    /* read slots are write 1 slots, slaves pull the bus low for 0 */
+    memset(owp->slots, ONEWIRE_UART_ONE, chunk * 8);
+    if (false == ow_uart_xfer(owp, chunk * 8))
+      return;
+
+    for (i = 0; i < chunk * 8; i++) {
+      if (ONEWIRE_UART_ONE == owp->slots[i])
+        rxbuf[i / 8] |= 1U << (i % 8);
+    }
+    rxbuf += chunk;
+    rxbytes -= chunk;
+  }
+}
+
+/**
+ * @brief     Writes bytes with the UART.
+ *
+ * @param[in] owp       pointer to the @p onewireDriver object
+ * @param[in] txbuf     pointer to the buffer with data to be written
+ * @param[in] txbytes   amount of data to be written
+ */
+static void ow_uart_write(onewireDriver *owp, uint8_t *txbuf, size_t txbytes) {
+  size_t chunk, i;
+#if ONEWIRE_USE_STRONG_PULLUP
+  bool pullup = owp->reg.need_pullup;
+#endif
+
+  while (txbytes > 0) {
+    chunk = (txbytes < ONEWIRE_UART_BUFFER_BYTES) ?
+            txbytes : ONEWIRE_UART_BUFFER_BYTES;
+
+    for (i = 0; i < chunk * 8; i++) {
+      owp->slots[i] = ((txbuf[i / 8] >> (i % 8)) & 1) ?
+                      ONEWIRE_UART_ONE : ONEWIRE_UART_ZERO;
+    }
+#if ONEWIRE_USE_STRONG_PULLUP
+    /* pull up asserted from the ISR right after the last slot */
+    owp->reg.need_pullup = pullup && (chunk == txbytes);
+#endif
+    if (false == ow_uart_xfer(owp, chunk * 8)) {
+#if ONEWIRE_USE_STRONG_PULLUP
+      owp->reg.need_pullup = false;
+#endif
+      return;
+    }
+
+    txbuf += chunk;
+    txbytes -= chunk;
+  }
+}
+
+#if ONEWIRE_USE_SEARCH_ROM
+/**
+ * @brief     Discovers one ROM with the UART.
+ * @details   The direction chosen for a bit and the two read slots of the
+ *            next one are exchanged in a single transfer.
+ * @pre       Search ROM command already sent.
+ *
+ * @param[in] owp       pointer to the @p onewireDriver object
+ */
+static void ow_uart_search_rom(onewireDriver *owp) {
+  onewire_search_rom_t *sr = &owp->search_rom;
+  size_t n = 0;
+  int bit;
+
+  while (true) {
+    owp->slots[n++] = ONEWIRE_UART_ONE;
+    owp->slots[n++] = ONEWIRE_UART_ONE;
+    if (false == ow_uart_xfer(owp, n)) {
+      sr->reg.result = ONEWIRE_SEARCH_ROM_ERROR;
+      return;
+    }
+
+    bit = search_decide(sr, (ONEWIRE_UART_ONE == owp->slots[n - 2]) |
+                            ((ONEWIRE_UART_ONE == owp->slots[n - 1]) << 1));
+    if (bit < 0)
+      return;
+    owp->slots[0] = bit ? ONEWIRE_UART_ONE : ONEWIRE_UART_ZERO;
+    n = 1;
+
+    /* one ROM successfully discovered */
+    if (64 == sr->reg.rombit) {
+      if (false == ow_uart_xfer(owp, n)) {
+        sr->reg.result = ONEWIRE_SEARCH_ROM_ERROR;
+        return;
+      }
+      sr->reg.devices_found++;
+      sr->reg.search_iter = ONEWIRE_SEARCH_ROM_NEXT;
+      if (true == sr->reg.single_device)
+        sr->reg.result = ONEWIRE_SEARCH_ROM_LAST;
+      return;
+    }
+  }
+}
+#endif /* ONEWIRE_USE_SEARCH_ROM */
+
+/**
+ * @brief     UART bus master.
+ */
+static const struct onewire_master uart_master = {
+  ow_uart_start,
+  ow_uart_stop,
+  ow_uart_reset,
+  ow_uart_read,
+  ow_uart_write,
+#if ONEWIRE_USE_SEARCH_ROM
+  ow_uart_search_rom
+#endif
+};
+#endif /* ONEWIRE_USE_UART */
+
+/*===========================================================================*/
+/* Driver exported functions.                                                */
+/*===========================================================================*/
+
+/**
+ * @brief   Calculates 1-wire CRC.
+ *
+ * @param[in] buf     pointer to the data buffer
+ * @param[in] len     lenght of data buffer
+ *
+ * @init
+ */
+uint8_t onewireCRC(const uint8_t *buf, size_t len) {
+  uint8_t ret = 0;
+  size_t i;
+
+  for (i=0; i<len; i++)
+    ret = onewire_crc_table[ret ^ buf[i]];
+
+  return ret;
+}
+
+/**
+ * @brief   Initializes @p onewireDriver structure.
+ *
+ * @param[out] owp    pointer to the @p onewireDriver object
+ *
+ * @init
+ */
+void onewireObjectInit(onewireDriver *owp) {
+
+  osalDbgCheck(NULL != owp);
+
+  owp->config = NULL;
+  owp->master = NULL;
+  owp->next = NULL;
+  owp->reg.slave_present = false;
+  owp->reg.state = ONEWIRE_STOP;
+  owp->thread = NULL;
+
+  owp->reg.bytes = 0;
+  owp->reg.bit = 0;
+  owp->reg.final_timeslot = false;
+  owp->buf = NULL;
+
+#if ONEWIRE_USE_STRONG_PULLUP
+  owp->reg.need_pullup = false;
+#endif
+}
+
+/**
+ * @brief   Configures and activates the 1-wire driver.
+ * @details The bus is mastered by the UART when @p uartd is set in the
+ *          configuration, by the PWM otherwise.
+ *
+ * @param[in] owp       pointer to the @p onewireDriver object
+ * @param[in] config    pointer to the @p onewireConfig object
+ *
+ * @api
+ */
+void onewireStart(onewireDriver *owp, const onewireConfig *config) {
+
+  osalDbgCheck((NULL != owp) && (NULL != config));
+  osalDbgAssert(ONEWIRE_STOP == owp->reg.state, "Invalid state");
+#if ONEWIRE_USE_STRONG_PULLUP
+  osalDbgCheck((NULL != config->pullup_assert) &&
+               (NULL != config->pullup_release));
+#endif
+
+  owp->config = config;
+#if ONEWIRE_USE_PWM && ONEWIRE_USE_UART
+  owp->master = (NULL != config->uartd) ? &uart_master : &pwm_master;
+#elif ONEWIRE_USE_UART
+  osalDbgCheck(NULL != config->uartd);
+  owp->master = &uart_master;
+#else
+  owp->master = &pwm_master;
+#endif
+  owp->master->start(owp);
+
+  osalSysLock();
+  owp->next = ow_drivers;
+  ow_drivers = owp;
+  osalSysUnlock();
+
+  owp->reg.state = ONEWIRE_READY;
+}
+
+/**
+ * @brief   Deactivates the 1-wire driver.
+ *
+ * @param[in] owp       pointer to the @p onewireDriver object
+ *
+ * @api
+ */
+void onewireStop(onewireDriver *owp) {
+  onewireDriver **pp;
+
+  osalDbgCheck(NULL != owp);
+#if ONEWIRE_USE_STRONG_PULLUP
+  owp->config->pullup_release();
+#endif
+  owp->master->stop(owp);
+
+  osalSysLock();
+  for (pp = &ow_drivers; *pp != owp; pp = &(*pp)->next)
+    ;
+  *pp = owp->next;
+  osalSysUnlock();
+
+  owp->config = NULL;
+  owp->master = NULL;
+  owp->reg.state = ONEWIRE_STOP;
+}
+
+/**
+ * @brief     Generate reset pulse on bus.
+ *
+ * @param[in] owp       pointer to the @p onewireDriver object
+ *
+ * @return              Bool flag denoting device presence.
+ * @retval true         There is at least one device on bus.
+ */
+bool onewireReset(onewireDriver *owp) {
+
+  osalDbgCheck(NULL != owp);
+  osalDbgAssert(owp->reg.state == ONEWIRE_READY, "Invalid state");
+
+  /* short circuit on bus or any other device transmit data */
+  if (PAL_LOW == ow_read_bit(owp))
+    return false;
+
+  return owp->master->reset(owp);
+}
+
+/**
+ * @brief     Read some bytes from slave device.
+ *
+ * @param[in] owp       pointer to the @p onewireDriver object
+ * @param[out] rxbuf    pointer to the buffer for read data
+ * @param[in] rxbytes   amount of data to be received
+ */
+void onewireRead(onewireDriver *owp, uint8_t *rxbuf, size_t rxbytes) {
+
+  osalDbgCheck((NULL != owp) && (NULL != rxbuf));
+  osalDbgCheck((rxbytes > 0) && (rxbytes <= ONEWIRE_MAX_TRANSACTION_LEN));
+  osalDbgAssert(owp->reg.state == ONEWIRE_READY, "Invalid state");
+
+  /* Buffer zeroing. This is important because of driver collects
+     bits using |= operation.*/
+  memset(rxbuf, 0, rxbytes);
+
+  owp->master->read(owp, rxbuf, rxbytes);
+}
+
+/**
+ * @brief     Write some bytes to slave device.
+ *
+ * @param[in] owp           pointer to the @p onewireDriver object
+ * @param[in] txbuf         pointer to the buffer with data to be written
+ * @param[in] txbytes       amount of data to be written
+ * @param[in] pullup_time   how long strong pull up must be activated. Set
+ *                          it to 0 if not needed.
+ */
+void onewireWrite(onewireDriver *owp, uint8_t *txbuf,
+                  size_t txbytes, systime_t pullup_time) {
+
+  osalDbgCheck((NULL != owp) && (NULL != txbuf));
+  osalDbgCheck((txbytes > 0) && (txbytes <= ONEWIRE_MAX_TRANSACTION_LEN));
+  osalDbgAssert(owp->reg.state == ONEWIRE_READY, "Invalid state");
+#if !ONEWIRE_USE_STRONG_PULLUP
+  osalDbgAssert(0 == pullup_time,
+      "Non zero time is valid only when strong pull enabled");
+#endif
+
+#if ONEWIRE_USE_STRONG_PULLUP
+  if (pullup_time > 0) {
+    owp->reg.state = ONEWIRE_PULL_UP;
+    owp->reg.need_pullup = true;
+  }
+#endif
+
+  owp->master->write(owp, txbuf, txbytes);
+
+#if ONEWIRE_USE_STRONG_PULLUP
+  if (pullup_time > 0) {
+    osalThreadSleep(pullup_time);
+    owp->config->pullup_release();
+    owp->reg.state = ONEWIRE_READY;
+  }
+#endif
+}
+
+#if ONEWIRE_USE_SEARCH_ROM
+/**
+ * @brief   Starts an incremental search.
+ * @details Every following call to @p onewireSearchNext() runs one search
+ *          pass and returns one ROM, so the caller may stop at any time.
+ *
+ * @param[in] owp       pointer to a @p OWDriver object
+ * @param[in] cmd       @p ONEWIRE_CMD_SEARCH_ROM, or
+ *                      @p ONEWIRE_CMD_ALARM_SEARCH to discover only the
+ *                      devices whose alarm flag is set
+ * @param[in] family    family code the search is restricted to, negative
+ *                      for any. The passes go straight to the devices of
+ *                      this family instead of walking the whole tree.
+ */
+void onewireSearchBegin(onewireDriver *owp, uint8_t cmd, int16_t family) {
+
+  onewire_search_rom_t *sr = &owp->search_rom;
+  uint8_t code;
+
+  osalDbgCheck(NULL != owp);
+  osalDbgCheck((ONEWIRE_CMD_SEARCH_ROM == cmd) ||
+               (ONEWIRE_CMD_ALARM_SEARCH == cmd));
+  osalDbgCheck(family <= 0xFF);
+
+  search_clean_start(sr);
+  sr->cmd = cmd;
+  sr->family = family;
+  if (family >= 0) {
+    code = (uint8_t)family;
+    search_preset(sr, &code, 1);
+  }
+  sr->reg.result = ONEWIRE_SEARCH_ROM_SUCCESS;
+}
+
+/**
+ * @brief   Runs one pass of the search started by @p onewireSearchBegin().
+ * @note    This function does internal 1-wire reset call.
+ *
+ * @param[in] owp       pointer to a @p OWDriver object
+ * @param[out] rom      pointer to 8 bytes buffer for the discovered ROM
+ *
+ * @return              The pass result.
+ * @retval ONEWIRE_SEARCH_ROM_SUCCESS   ROM discovered, more may follow.
+ * @retval ONEWIRE_SEARCH_ROM_LAST      ROM discovered, it was the last one.
+ * @retval ONEWIRE_SEARCH_ROM_NONE      no presence pulse, no device taking
+ *                                      part in the search or no more devices
+ *                                      of the family searched.
+ * @retval ONEWIRE_SEARCH_ROM_ERROR     communication error.
+ */
+search_rom_result_t onewireSearchNext(onewireDriver *owp, uint8_t *rom) {
+
+  onewire_search_rom_t *sr = &owp->search_rom;
+  uint8_t cmd;
+
+  osalDbgCheck((NULL != owp) && (NULL != rom));
+  osalDbgAssert(ONEWIRE_READY == owp->reg.state, "Invalid state");
+
+  if (ONEWIRE_SEARCH_ROM_SUCCESS != sr->reg.result)
+    return ONEWIRE_SEARCH_ROM_NONE;
+
+  /* every search must be started from reset pulse */
+  if (false == onewireReset(owp)) {
+    sr->reg.result = ONEWIRE_SEARCH_ROM_NONE;
+    return ONEWIRE_SEARCH_ROM_NONE;
+  }
+
+  /* initialize buffer to store result */
+  sr->retbuf = rom;
+  memset(rom, 0, 8);
+
+  /* clean iteration state */
+  search_clean_iteration(sr);
+
+  cmd = sr->cmd;
+  onewireWrite(owp, &cmd, 1, 0);
+
+  owp->master->search_rom(owp);
+
+  if (ONEWIRE_SEARCH_ROM_ERROR == sr->reg.result) {
+    /* nobody answered the very first bit */
+    if (0 == sr->reg.rombit)
+      sr->reg.result = ONEWIRE_SEARCH_ROM_NONE;
+    return sr->reg.result;
+  }
+  if (rom[7] != onewireCRC(rom, 7)) {
+    sr->reg.result = ONEWIRE_SEARCH_ROM_ERROR;
+    return ONEWIRE_SEARCH_ROM_ERROR;
+  }
+  /* devices of a family are contiguous in search order */
+  if ((sr->family >= 0) && (rom[0] != sr->family)) {
+    sr->reg.result = ONEWIRE_SEARCH_ROM_NONE;
+    return ONEWIRE_SEARCH_ROM_NONE;
+  }
+
+  /* after a preset pass the branch to turn is the last 0 taken */
+  if (sr->last_zero_branch >= 64)
+    sr->last_zero_branch = sr->prev_zero_branch;
+
+  /* store cached result for usage in next iteration */
+  memcpy(sr->prev_path, rom, 8);
+  return sr->reg.result;
+}
+
+/**
+ * @brief   Performs a whole search.
+ */
+static size_t search_all(onewireDriver *owp, uint8_t cmd, int16_t family,
+                         uint8_t *result, size_t max_rom_cnt) {
+  search_rom_result_t res;
+  uint8_t *rom;
+  size_t found = 0;
+
+  osalDbgCheck((NULL != owp) && (NULL != result));
+  osalDbgCheck((max_rom_cnt <= 256) && (max_rom_cnt > 0));
+
+  onewireSearchBegin(owp, cmd, family);
+
+  do {
+    if (found >= max_rom_cnt)
+      rom = result + 8*(max_rom_cnt-1);
+    else
+      rom = result + 8*found;
+
+    res = onewireSearchNext(owp, rom);
+    if ((ONEWIRE_SEARCH_ROM_SUCCESS == res) ||
+        (ONEWIRE_SEARCH_ROM_LAST == res))
+      found++;
+  }
+  while (ONEWIRE_SEARCH_ROM_SUCCESS == res);
+
+  if (ONEWIRE_SEARCH_ROM_ERROR == res)
+    return 0;
+  else
+    return found;
+}
+
+/**
+ * @brief   Performs tree search on bus.
+ * @note    This function does internal 1-wire reset calls every search
+ *          iteration.
+ *
+ * @param[in] owp         pointer to a @p OWDriver object
+ * @param[out] result     pointer to buffer for discovered ROMs
+ * @param[in] max_rom_cnt buffer size in ROMs count for overflow prevention
+ *
+ * @return              Count of discovered ROMs. May be more than max_rom_cnt.
+ * @retval 0            no ROMs found or communication error occurred.
+ */
+size_t onewireSearchRom(onewireDriver *owp, uint8_t *result,
+                        size_t max_rom_cnt) {
+
+  return search_all(owp, ONEWIRE_CMD_SEARCH_ROM, -1, result, max_rom_cnt);
+}
+
+/**
+ * @brief   Performs tree search of the devices with alarm flag set.
+ * @note    Costs one search pass per alarming device, whatever the number
+ *          of devices on bus.
+ *
+ * @param[in] owp         pointer to a @p OWDriver object
+ * @param[out] result     pointer to buffer for discovered ROMs
+ * @param[in] max_rom_cnt buffer size in ROMs count for overflow prevention
+ *
+ * @return              Count of discovered ROMs. May be more than max_rom_cnt.
+ * @retval 0            no device in alarm or communication error occurred.
+ */
+size_t onewireAlarmSearch(onewireDriver *owp, uint8_t *result,
+                          size_t max_rom_cnt) {
+
+  return search_all(owp, ONEWIRE_CMD_ALARM_SEARCH, -1, result, max_rom_cnt);
+}
+
+/**
+ * @brief   Performs tree search of the devices of a family.
+ * @note    Costs one search pass per device of the family, plus one when
+ *          devices of other families follow in search order.
+ *
+ * @param[in] owp         pointer to a @p OWDriver object
+ * @param[in] family      family code, first byte of the ROM
+ * @param[out] result     pointer to buffer for discovered ROMs
+ * @param[in] max_rom_cnt buffer size in ROMs count for overflow prevention
+ *
+ * @return              Count of discovered ROMs. May be more than max_rom_cnt.
+ * @retval 0            no ROMs found or communication error occurred.
+ */
+size_t onewireSearchFamily(onewireDriver *owp, uint8_t family,
+                           uint8_t *result, size_t max_rom_cnt) {
+
+  return search_all(owp, ONEWIRE_CMD_SEARCH_ROM, family, result, max_rom_cnt);
+}
+
+/**
+ * @brief   Checks that a device is present on bus.
+ * @details A single search pass follows the path of @p rom at every
+ *          collision, it returns @p rom only if the device took part.
+ *          Unlike MATCH ROM, which the selected device does not answer,
+ *          this works with devices of any family.
+ * @note    This function does internal 1-wire reset call.
+ *
+ * @param[in] owp       pointer to a @p OWDriver object
+ * @param[in] rom       ROM of the device
+ *
+ * @return              True when the device answered.
+ */
+bool onewireVerifyRom(onewireDriver *owp, const uint8_t *rom) {
+
+  search_rom_result_t res;
+  uint8_t found[8];
+
+  osalDbgCheck(NULL != rom);
+
+  onewireSearchBegin(owp, ONEWIRE_CMD_SEARCH_ROM, -1);
+  search_preset(&owp->search_rom, rom, 8);
+  res = onewireSearchNext(owp, found);
+
+  return ((ONEWIRE_SEARCH_ROM_SUCCESS == res) ||
+          (ONEWIRE_SEARCH_ROM_LAST == res)) && (0 == memcmp(found, rom, 8));
+}
+
+/**
+ * @brief   Initializes a ROM cache.
+ *
+ * @param[out] cache    pointer to the @p onewireRomCache object
+ * @param[in] roms      buffer for the ROMs
+ * @param[in] size      buffer size in ROMs count
+ */
+void onewireCacheObjectInit(onewireRomCache *cache,
+                            uint8_t *roms, size_t size) {
+
+  osalDbgCheck((NULL != cache) && (NULL != roms) && (size > 0));
+
+  cache->roms = roms;
+  cache->size = size;
+  cache->count = 0;
+  cache->next = 0;
+  cache->scanning = false;
+}
+
+/**
+ * @brief   Refreshes a ROM cache by one search pass.
+ * @details Search passes return the ROMs in the order of the cache, each
+ *          pass is merged into it: cached ROMs skipped by the search are
+ *          dropped, new ones are inserted. Once the last ROM has been
+ *          found the scan starts over, so a device plugged or unplugged
+ *          shows up in the cache within one scan.
+ * @note    This function does internal 1-wire reset call. Other searches
+ *          may be run on the same driver between two steps.
+ * @note    ROMs not fitting in the cache are ignored.
+ *
+ * @param[in] owp       pointer to a @p OWDriver object
+ * @param[in,out] cache pointer to the @p onewireRomCache object
+ *
+ * @return              True when the cache content changed.
+ */
+bool onewireCacheStep(onewireDriver *owp, onewireRomCache *cache) {
+
+  search_rom_result_t res;
+  uint8_t rom[8];
+  bool changed = false;
+  size_t n;
+  int cmp = 1;
+
+  osalDbgCheck((NULL != owp) && (NULL != cache));
+
+  if (cache->scanning) {
+    owp->search_rom = cache->search;
+  }
+  else {
+    onewireSearchBegin(owp, ONEWIRE_CMD_SEARCH_ROM, -1);
+    cache->next = 0;
+    cache->scanning = true;
+  }
+
+  res = onewireSearchNext(owp, rom);
+  cache->search = owp->search_rom;
+
+  switch (res) {
+  case ONEWIRE_SEARCH_ROM_SUCCESS:
+  case ONEWIRE_SEARCH_ROM_LAST:
+    /* cached ROMs coming before the one found are gone */
+    n = 0;
+    while ((cache->next + n < cache->count) &&
+           ((cmp = rom_cmp(cache->roms + 8 * (cache->next + n), rom)) < 0))
+      n++;
+    if (n > 0) {
+      cache_remove(cache, cache->next, n);
+      changed = true;
+    }
+    if ((cache->next < cache->count) && (0 == cmp)) {
+      cache->next++;
+    }
+    else if (cache->count < cache->size) {
+      memmove(cache->roms + 8 * (cache->next + 1),
+              cache->roms + 8 * cache->next,
+              8 * (cache->count - cache->next));
+      memcpy(cache->roms + 8 * cache->next, rom, 8);
+      cache->count++;
+      cache->next++;
+      changed = true;
+    }
+    if (ONEWIRE_SEARCH_ROM_SUCCESS == res)
+      break;
+    /* Falls through.*/
+  case ONEWIRE_SEARCH_ROM_NONE:
+    /* end of scan, the ROMs not found are gone */
+    if (cache->next < cache->count) {
+      cache_remove(cache, cache->next, cache->count - cache->next);
+      changed = true;
+    }
+    cache->scanning = false;
+    break;
+  default:
+    /* scan again, the cache is kept as is */
+    cache->scanning = false;
+    break;
+  }
+
+  return changed;
 }
 #endif /* ONEWIRE_USE_SEARCH_ROM */
 
@@ -0,0 +1,217 @@
+/*
+    ChibiOS - Copyright (C) 2006..2018 Giovanni Di Sirio
+
+    Licensed under the Apache License, Version 2.0 (the "License");
+    you may not use this file except in compliance with the License.
+    You may obtain a copy of the License at
+
+        http://www.apache.org/licenses/LICENSE-2.0
+
+    Unless required by applicable law or agreed to in writing, software
+    distributed under the License is distributed on an "AS IS" BASIS,
+    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+    See the License for the specific language governing permissions and
+    limitations under the License.
+*/
+
+/*===========================================================================*/
+/* Main ideas:                                                               */
+/*===========================================================================
+
+A temperature conversion takes up to 750ms, reading a scratchpad a few
+milliseconds. Instead of converting sensor by sensor, or bus by bus, the
+sweep:
+
+1) broadcasts SKIP ROM + CONVERT T on every bus, so all the sensors
+   convert at the same time;
+2) polls the buses with read slots, a converting sensor holds them at 0;
+3) reads the scratchpads of a bus as soon as its conversions end, while
+   the other buses are still converting, one MATCH ROM + READ SCRATCHPAD
+   write and one read per sensor, and checks them with onewireCRC().
+
+A sweep of N sensors over any number of buses takes at most one conversion
+time plus N scratchpad reads. The driver calls are synchronous, so the
+reads of different buses cannot overlap each other, but the reads of the
+buses converting faster, e.g. at a lower resolution, overlap the
+conversion of the slower ones.
+
+The sensors must be externally powered: parasite powered ones need the
+strong pull up for the whole conversion and do not answer the polls.
+*/
+
+/**
+ * @file    hal_onewire_sweep.c
+ * @brief   1-wire temperature sweep over several buses.
+ *
+ * @addtogroup onewire
+ * @{
+ */
+
+#include "hal.h"
+
+#if (HAL_USE_ONEWIRE == TRUE) || defined(__DOXYGEN__)
+
+#include <string.h>
+
+/*===========================================================================*/
+/* Driver local functions.                                                   */
+/*===========================================================================*/
+/**
+ * @brief     Starts the conversion of all the sensors of a bus.
+ *
+ * @return    false if no sensor answered the reset.
+ */
+static bool sweep_convert(const onewireSweepBus *bus) {
+  uint8_t cmd[2];
+
+  if (false == onewireReset(bus->owp))
+    return false;
+
+  cmd[0] = ONEWIRE_CMD_SKIP_ROM;
+  cmd[1] = ONEWIRE_CMD_CONVERT_TEMP;
+  onewireWrite(bus->owp, cmd, sizeof(cmd), 0);
+  return true;
+}
+
+/**
+ * @brief     Reads the scratchpad of a sensor.
+ *
+ * @param[in] bus       the bus
+ * @param[in] i         sensor number on the bus
+ * @param[out] sp       scratchpad buffer
+ */
+static onewire_sweep_status_t sweep_read(const onewireSweepBus *bus,
+                                         size_t i, uint8_t *sp) {
+  static const uint8_t zero[ONEWIRE_SCRATCHPAD_LEN];
+  uint8_t cmd[10];
+  size_t len, tries;
+
+  /* a single sensor does not need to be addressed */
+  if (1 == bus->count) {
+    cmd[0] = ONEWIRE_CMD_SKIP_ROM;
+    cmd[1] = ONEWIRE_CMD_READ_SCRATCHPAD;
+    len = 2;
+  }
+  else {
+    cmd[0] = ONEWIRE_CMD_MATCH_ROM;
+    memcpy(&cmd[1], &bus->roms[i * 8], 8);
+    cmd[9] = ONEWIRE_CMD_READ_SCRATCHPAD;
+    len = 10;
+  }
+
+  for (tries = 0; tries <= ONEWIRE_SWEEP_RETRIES; tries++) {
+    if (false == onewireReset(bus->owp))
+      return ONEWIRE_SWEEP_NO_PRESENCE;
+    onewireWrite(bus->owp, cmd, len, 0);
+    onewireRead(bus->owp, sp, ONEWIRE_SCRATCHPAD_LEN);
+
+    /* a bus stuck low reads as zeroes, with a good CRC */
+    if ((sp[ONEWIRE_SCRATCHPAD_LEN - 1] ==
+         onewireCRC(sp, ONEWIRE_SCRATCHPAD_LEN - 1)) &&
+        (0 != memcmp(sp, zero, ONEWIRE_SCRATCHPAD_LEN)))
+      return ONEWIRE_SWEEP_OK;
+  }
+  return ONEWIRE_SWEEP_CRC_ERROR;
+}
+
+/**
+ * @brief     Reads the scratchpads of all the sensors of a bus.
+ *
+ * @param[in] bus       the bus
+ * @param[in] timedout  the end of the conversion was not seen
+ *
+ * @return    Number of sensors read with @p ONEWIRE_SWEEP_OK status.
+ */
+static size_t sweep_collect(const onewireSweepBus *bus, bool timedout) {
+  onewire_sweep_status_t st;
+  size_t i, ok = 0;
+
+  for (i = 0; i < bus->count; i++) {
+    st = sweep_read(bus, i, &bus->scratchpads[i * ONEWIRE_SCRATCHPAD_LEN]);
+    if ((ONEWIRE_SWEEP_OK == st) && timedout)
+      st = ONEWIRE_SWEEP_TIMEOUT;
+    if (ONEWIRE_SWEEP_OK == st)
+      ok++;
+    bus->status[i] = st;
+  }
+  return ok;
+}
+
+/*===========================================================================*/
+/* Driver exported functions.                                                */
+/*===========================================================================*/
+
+/**
+ * @brief   Converts and reads the temperature of all the sensors of
+ *          several buses.
+ * @details The conversions of all the buses run at the same time, the
+ *          sensors of a bus are read as soon as its conversions end. The
+ *          sweep takes at most one conversion time plus the scratchpad
+ *          reads.
+ *
+ * @param[in] buses     array of buses
+ * @param[in] n         number of buses
+ * @param[in] timeout   longest conversion time, 750ms for 12 bits
+ *                      resolution
+ *
+ * @return              Number of sensors read with
+ *                      @p ONEWIRE_SWEEP_OK status.
+ *
+ * @api
+ */
+size_t onewireSweep(const onewireSweepBus *buses, size_t n,
+                    sysinterval_t timeout) {
+  uint32_t converting = 0, unread = 0, ready;
+  systime_t start;
+  size_t b, i, ok = 0;
+  bool timedout = false;
+  uint8_t poll;
+
+  osalDbgCheck((NULL != buses) && (n > 0) && (n <= ONEWIRE_SWEEP_MAX_BUSES));
+
+  /* broadcast */
+  for (b = 0; b < n; b++) {
+    osalDbgCheck((NULL != buses[b].owp) && (NULL != buses[b].scratchpads) &&
+                 (NULL != buses[b].status) &&
+                 ((NULL != buses[b].roms) || (buses[b].count <= 1)));
+    if ((buses[b].count > 0) && sweep_convert(&buses[b]))
+      unread |= 1U << b;
+    else {
+      for (i = 0; i < buses[b].count; i++)
+        buses[b].status[i] = ONEWIRE_SWEEP_NO_PRESENCE;
+    }
+  }
+  converting = unread;
+
+  /* wait for the slowest sensor, not N conversion times, reading the
+     buses done in the meantime */
+  start = osalOsGetSystemTimeX();
+  while (0 != unread) {
+    for (b = 0; b < n; b++) {
+      if (converting & (1U << b)) {
+        onewireRead(buses[b].owp, &poll, 1);
+        if (0 != poll)
+          converting &= ~(1U << b);
+      }
+    }
+    if (osalTimeDiffX(start, osalOsGetSystemTimeX()) >= timeout)
+      timedout = true;
+
+    ready = timedout ? unread : (unread & ~converting);
+    if (0 == ready) {
+      osalThreadSleep(ONEWIRE_SWEEP_POLL_INTERVAL);
+      continue;
+    }
+    for (b = 0; b < n; b++) {
+      if (ready & (1U << b))
+        ok += sweep_collect(&buses[b], 0 != (converting & (1U << b)));
+    }
+    unread &= ~ready;
+  }
+
+  return ok;
+}
+
+#endif /* HAL_USE_ONEWIRE */
+
+/** @} */
@@ -195,6 +195,119 @@ static uint32_t scsi_transport_receive(const SCSITransport *transport,
     return 0;
 }
 
+/**
+ * @brief   SCSI transport asynchronous transmit start function.
+ *
+ * @param[in] transport pointer to the @p SCSITransport object
+ * @param[in] data      payload
+ * @param[in] len       number of bytes to be transmitted
+ *
+ * @return              The operation status.
+ * @retval false        transfer started.
+ * @retval true         endpoint not available.
+ *
+ * @notapi
+ */
+static bool scsi_transport_start_transmit(const SCSITransport *transport,
+                                          const uint8_t *data, size_t len) {
+
+  usb_scsi_transport_handler_t *trp = transport->handler;
+
+  osalSysLock();
+  if ((usbGetDriverStateI(trp->usbp) != USB_ACTIVE) ||
+      usbGetTransmitStatusI(trp->usbp, trp->ep)) {
+    osalSysUnlock();
+    return true;
+  }
+  trp->pending = len;
+  usbStartTransmitI(trp->usbp, trp->ep, data, len);
+  osalSysUnlock();
+  return false;
+}
+
+/**
+ * @brief   SCSI transport asynchronous receive start function.
+ *
+ * @param[in] transport pointer to the @p SCSITransport object
+ * @param[in] data      payload
+ * @param[in] len       number bytes to be received
+ *
+ * @return              The operation status.
+ * @retval false        transfer started.
+ * @retval true         endpoint not available.
+ *
+ * @notapi
+ */
+static bool scsi_transport_start_receive(const SCSITransport *transport,
+                                         uint8_t *data, size_t len) {
+
+  usb_scsi_transport_handler_t *trp = transport->handler;
+
+  osalSysLock();
+  if ((usbGetDriverStateI(trp->usbp) != USB_ACTIVE) ||
+      usbGetReceiveStatusI(trp->usbp, trp->ep)) {
+    osalSysUnlock();
+    return true;
+  }
+  trp->pending = len;
+  usbStartReceiveI(trp->usbp, trp->ep, data, len);
+  osalSysUnlock();
+  return false;
+}
+
+/**
+ * @brief   SCSI transport asynchronous transfer wait function.
+ * @details The transfer may have already completed, in that case the
+ *          calling thread is not suspended.
+ *
+ * @param[in] transport pointer to the @p SCSITransport object
+ * @param[in] transmit  direction of the pending transfer
+ *
+ * @return              Number of successfully transferred bytes.
+ *
+ * @notapi
+ */
+static uint32_t scsi_transport_wait(const SCSITransport *transport,
+                                    bool transmit) {
+
+  usb_scsi_transport_handler_t *trp = transport->handler;
+  USBDriver *usbp = trp->usbp;
+  msg_t msg;
+
+  osalSysLock();
+  if (transmit) {
+    if (usbGetTransmitStatusI(usbp, trp->ep)) {
+      msg = osalThreadSuspendS(&usbp->epc[trp->ep]->in_state->thread);
+    }
+    else {
+      msg = MSG_OK;
+    }
+    if ((MSG_OK == msg) && (usbGetDriverStateI(usbp) == USB_ACTIVE)) {
+      msg = (msg_t)trp->pending;
+    }
+    else {
+      msg = MSG_RESET;
+    }
+  }
+  else {
+    if (usbGetReceiveStatusI(usbp, trp->ep)) {
+      msg = osalThreadSuspendS(&usbp->epc[trp->ep]->out_state->thread);
+    }
+    else if (usbGetDriverStateI(usbp) == USB_ACTIVE) {
+      msg = (msg_t)usbGetReceiveTransactionSizeX(usbp, trp->ep);
+    }
+    else {
+      msg = MSG_RESET;
+    }
+  }
+  osalSysUnlock();
+
+  if (MSG_RESET != msg)
+    return (uint32_t)msg;
+  else
+    return 0;
+}
+
 /**
  * @brief   Fills and sends CSW message.
  *
@@ -350,6 +463,33 @@ void msdStart(USBMassStorageDriver *msdp, USBDriver *usbp,
               const scsi_inquiry_response_t *inquiry,
               const scsi_unit_serial_number_inquiry_response_t *serialInquiry) {
 
+  msdStartBuffered(msdp, usbp, blkdev, blkbuf, 0, inquiry, serialInquiry);
+}
+
+/**
+ * @brief   Configures and activates the USB mass storage driver.
+ * @details The working area buffer is split in two halves so that USB
+ *          transfers overlap the block device accesses, each half holds
+ *          as many blocks as fit and is moved in a single transfer.
+ *
+ * @param[in] msdp      pointer to the @p USBMassStorageDriver object
+ * @param[in] usbp      pointer to the @p USBDriver object
+ * @param[in] blkdev    pointer to the @p BaseBlockDevice object
+ * @param[in] blkbuf    pointer to the working area buffer, must be allocated
+ *                      by user, should be big enough to store at least
+ *                      2 data blocks
+ * @param[in] blkbuf_size size of the working area buffer in bytes
+ * @param[in] inquiry   pointer to the SCSI inquiry response structure,
+ *                      set it to @p NULL to use default hardcoded value.
+ *
+ * @api
+ */
+void msdStartBuffered(USBMassStorageDriver *msdp, USBDriver *usbp,
+                      BaseBlockDevice *blkdev, uint8_t *blkbuf,
+                      size_t blkbuf_size,
+                      const scsi_inquiry_response_t *inquiry,
+                      const scsi_unit_serial_number_inquiry_response_t *serialInquiry) {
+
   osalDbgCheck((msdp != NULL) && (usbp != NULL)
               && (blkdev != NULL) && (blkbuf != NULL));
   osalDbgAssert((msdp->state == USB_MSD_STOP), "invalid state");
@@ -361,6 +501,9 @@ void msdStart(USBMassStorageDriver *msdp, USBDriver *usbp,
   msdp->scsi_transport.handler  = &msdp->usb_scsi_transport_handler;
   msdp->scsi_transport.transmit = scsi_transport_transmit;
   msdp->scsi_transport.receive  = scsi_transport_receive;
+  msdp->scsi_transport.start_transmit = scsi_transport_start_transmit;
+  msdp->scsi_transport.start_receive  = scsi_transport_start_receive;
+  msdp->scsi_transport.wait           = scsi_transport_wait;
 
   if (NULL == inquiry) {
     msdp->scsi_config.inquiry_response = &default_scsi_inquiry_response;
@@ -375,6 +518,7 @@ void msdStart(USBMassStorageDriver *msdp, USBDriver *usbp,
     msdp->scsi_config.unit_serial_number_inquiry_response = serialInquiry;
   }
   msdp->scsi_config.blkbuf = blkbuf;
+  msdp->scsi_config.blkbuf_size = blkbuf_size;
   msdp->scsi_config.blkdev = blkdev;
   msdp->scsi_config.transport = &msdp->scsi_transport;
 
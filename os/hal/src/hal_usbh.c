@@ -21,6 +21,7 @@
 
 #include "usbh/internal.h"
 #include "usbh/dev/hub.h"
+#include "usbh/dev/msd.h"
 #include <string.h>
 
 #define _USBH_DEBUG_HELPER_ENABLE_TRACE		USBH_DEBUG_ENABLE_TRACE
@@ -36,6 +37,10 @@ struct usbh_debug_helper usbh_debug;
 
 static void _classdriver_process_device(usbh_device_t *dev);
 static bool _classdriver_load(usbh_device_t *dev, uint8_t *descbuff, uint16_t rem);
+#if HAL_USBH_USE_MAIN_THREAD
+static void _main_thread_start(USBHDriver *usbh);
+static void _main_thread_stop(USBHDriver *usbh);
+#endif
 
 #if HAL_USBH_USE_ADDITIONAL_CLASS_DRIVERS
 #include "usbh_additional_class_drivers.h"
@@ -74,6 +79,10 @@ static inline void _check_urb(usbh_urb_t *urb) {
 void usbhObjectInit(USBHDriver *usbh) {
 	memset(usbh, 0, sizeof(*usbh));
 	usbh->status = USBH_STATUS_STOPPED;
+	osalEventObjectInit(&usbh->event);
+#if HAL_USBH_USE_PARALLEL_ENUMERATION
+	usbh->enum_wait = TIME_INFINITE;
+#endif
 #if HAL_USBH_USE_HUB
 	INIT_LIST_HEAD(&usbh->hubs);
 	_usbhub_port_object_init(&usbh->rootport, usbh, 0, 1);
@@ -94,10 +103,24 @@ void usbhStart(USBHDriver *usbh) {
 	usbh_lld_start(usbh);
 	usbh->status = USBH_STATUS_STARTED;
 	osalSysUnlock();
+
+#if HAL_USBH_USE_MSD
+#if HAL_USBHMSD_USE_ASYNC
+	_usbhmsd_async_start();
+#endif
+#endif
+
+#if HAL_USBH_USE_MAIN_THREAD
+	_main_thread_start(usbh);
+#endif
 }
 
 void usbhStop(USBHDriver *usbh) {
 
+#if HAL_USBH_USE_MAIN_THREAD
+	_main_thread_stop(usbh);
+#endif
+
 	osalSysLock();
 	osalDbgAssert((usbh->status == USBH_STATUS_STARTED), "invalid state");
 	usbh_lld_stop(usbh);
@@ -620,6 +643,8 @@ static bool _device_configure(usbh_device_t *dev, uint8_t bConfiguration) {
 	return HAL_FAILED;
 }
 
+/* Default address phase: reads bMaxPacketSize0 and moves the device to its
+ * own address. */
 static bool _device_enumerate(usbh_device_t *dev) {
 
 	udevinfo("Enumerate.");
@@ -656,8 +681,12 @@ static bool _device_enumerate(usbh_device_t *dev) {
 	_ep0_object_init(dev, dev->devDesc.bMaxPacketSize0);
 	usbhEPOpen(&dev->ctrl);
 
-	udevinfof("Wait stabilization...");
-	osalThreadSleepMilliseconds(HAL_USBH_DEVICE_ADDRESS_STABILIZATION);
+	return HAL_SUCCESS;
+}
+
+/* Called once the address has had time to settle. On failure the address
+ * stays assigned, the caller releases it. */
+static bool _device_read_descriptor(usbh_device_t *dev) {
 
 	/* address is set */
 	dev->status = USBH_DEVSTATUS_ADDRESS;
@@ -667,8 +696,6 @@ static bool _device_enumerate(usbh_device_t *dev) {
 	if (usbhStdReqGetDeviceDescriptor(dev, sizeof(dev->devDesc),
 			(uint8_t *)&dev->devDesc)) {
 		udeverr("Error");
-		_device_setaddress(dev, 0);
-		_free_address(dev->host, addr);
 		return HAL_FAILED;
 	}
 
@@ -844,6 +871,10 @@ static void _port_process_status_change(usbh_port_t *port) {
 
 	_port_update_status(port);
 
+	/* the enumeration handles the changes of its port */
+	if (port->enum_state != USBH_PORTENUM_IDLE)
+		return;
+
 	if (port->c_status & USBH_PORTSTATUS_C_CONNECTION) {
 		port->c_status &= ~USBH_PORTSTATUS_C_CONNECTION;
 		usbhhubClearFeaturePort(port, USBH_PORT_FEAT_C_CONNECTION);
@@ -885,143 +916,263 @@ static void _port_process_status_change(usbh_port_t *port) {
 
 }
 
-static void _port_connected(usbh_port_t *port) {
-	/* connected */
+/*
+ * Port enumeration.
+ *
+ * The enumeration of a port is a state machine: each step runs its control
+ * transfers and sets the delay the USB spec wants before the next one
+ * (debounce, reset, reset recovery, SET_ADDRESS settling). Without
+ * HAL_USBH_USE_PARALLEL_ENUMERATION the steps are run back to back by
+ * _port_connected(), sleeping in between. With it, usbhMainLoop() advances
+ * every enumerating port, so the delays of several ports overlap. Only the
+ * delays do: the control transfers of a step still block the main loop
+ * until they complete, so the ports take turns for them.
+ *
+ * Only one device at a time may answer at the default address: a port takes
+ * host->default_port before resetting its device and gives it back once
+ * SET_ADDRESS is done.
+ */
+
+static void _port_enum_goto(usbh_port_t *port, usbh_portenum_t state,
+		sysinterval_t delay) {
+	port->enum_state = state;
+	port->enum_time = osalOsGetSystemTimeX();
+	port->enum_delay = delay;
+}
 
-	systime_t start;
-	uint8_t i;
-	uint8_t retries;
+static void _port_enum_release(usbh_port_t *port) {
+	USBHDriver *const host = port->device.host;
+	if (host->default_port == port)
+		host->default_port = NULL;
+}
+
+static void _port_enum_finish(usbh_port_t *port) {
+	_port_enum_release(port);
+	port->enum_state = USBH_PORTENUM_IDLE;
+	port->device.host->enumerating--;
+}
+
+static void _port_enum_abort(usbh_port_t *port) {
+	uporterrf("Port %d: abort", port->number);
+	_port_enum_finish(port);
+
+	if (port->device.ctrl.status != USBH_EPSTATUS_UNINITIALIZED)
+		usbhEPClose(&port->device.ctrl);
+	if (port->device.address) {
+		_free_address(port->device.host, port->device.address);
+		port->device.address = 0;
+	}
+	port->device.status = USBH_DEVSTATUS_DISCONNECTED;
+}
+
+static void _port_enum_reset(usbh_port_t *port) {
+	uportinfof("Port %d: Try reset...", port->number);
+	/* TODO: check that port is actually disabled */
+	port->c_status &= ~(USBH_PORTSTATUS_C_RESET | USBH_PORTSTATUS_C_ENABLE);
+	_port_reset(port);
+	port->enum_reset_time = osalOsGetSystemTimeX();
+	/* give it some time to reset (min. 10ms) */
+	_port_enum_goto(port, USBH_PORTENUM_RESET, OSAL_MS2I(20));
+}
+
+static void _port_enum_retry(usbh_port_t *port) {
+	/* enumeration failed */
+	usbhEPClose(&port->device.ctrl);
+	if (port->device.address) {
+		_free_address(port->device.host, port->device.address);
+		port->device.address = 0;
+	}
+	_port_enum_release(port);
+
+	if (!--port->enum_retries) {
+		uportwarnf("Port %d: enumeration failed; abort", port->number);
+		_port_enum_abort(port);
+		return;
+	}
+
+	/* retry reset & enumeration */
+	uportwarnf("Port %d: enumeration failed; retry reset & enumeration", port->number);
+	port->enum_resets = 3;
+	_port_enum_goto(port, USBH_PORTENUM_WAIT_DEFAULT, 0);
+}
+
+static void _port_enum_step(usbh_port_t *port) {
+	USBHDriver *const host = port->device.host;
 	usbh_devspeed_t speed;
 	USBH_DEFINE_BUFFER(usbh_string_descriptor_t strdesc);
 
-	port->device.status = USBH_DEVSTATUS_ATTACHED;
-	uportinfof("Port %d: attached, wait debounce...", port->number);
-
-	/* wait for attach de-bounce */
-	osalThreadSleepMilliseconds(HAL_USBH_PORT_DEBOUNCE_TIME);
+	if ((port->enum_state == USBH_PORTENUM_DEBOUNCE)
+			|| (port->enum_state == USBH_PORTENUM_RESET)) {
+		_port_update_status(port);
+	}
 
 	/* check disconnection */
-	_port_update_status(port);
 	if (port->c_status & USBH_PORTSTATUS_C_CONNECTION) {
 		port->c_status &= ~USBH_PORTSTATUS_C_CONNECTION;
 		usbhhubClearFeaturePort(port, USBH_PORT_FEAT_C_CONNECTION);
-		uportwarnf("Port %d: connection state changed; abort #1", port->number);
-		goto abort;
-	}
-
-	/* make sure that the device is still connected */
-	if ((port->status & USBH_PORTSTATUS_CONNECTION) == 0) {
-		uportwarnf("Port %d: device is disconnected", port->number);
-		goto abort;
+		uportwarnf("Port %d: connection state changed; abort", port->number);
+		_port_enum_abort(port);
+		return;
 	}
 
-	uportinfof("Port %d: connected", port->number);
-	port->device.status = USBH_DEVSTATUS_CONNECTED;
-	retries = 3;
+	switch (port->enum_state) {
+	case USBH_PORTENUM_DEBOUNCE:
+		/* make sure that the device is still connected */
+		if ((port->status & USBH_PORTSTATUS_CONNECTION) == 0) {
+			uportwarnf("Port %d: device is disconnected", port->number);
+			_port_enum_abort(port);
+			return;
+		}
 
-reset:
-	for (i = 0; i < 3; i++) {
-		uportinfof("Port %d: Try reset...", port->number);
-		/* TODO: check that port is actually disabled */
-		port->c_status &= ~(USBH_PORTSTATUS_C_RESET | USBH_PORTSTATUS_C_ENABLE);
-		_port_reset(port);
-		osalThreadSleepMilliseconds(20);	/* give it some time to reset (min. 10ms) */
-		start = osalOsGetSystemTimeX();
-		while (TRUE) {
-			_port_update_status(port);
-
-			/* check for disconnection */
-			if (port->c_status & USBH_PORTSTATUS_C_CONNECTION) {
-				port->c_status &= ~USBH_PORTSTATUS_C_CONNECTION;
-				usbhhubClearFeaturePort(port, USBH_PORT_FEAT_C_CONNECTION);
-				uportwarnf("Port %d: connection state changed; abort #2", port->number);
-				goto abort;
-			}
+		uportinfof("Port %d: connected", port->number);
+		port->device.status = USBH_DEVSTATUS_CONNECTED;
+		port->enum_retries = 3;
+		port->enum_resets = 3;
+		/* fall through */
 
-			/* check for reset completion */
-			if (port->c_status & USBH_PORTSTATUS_C_RESET) {
-				port->c_status &= ~USBH_PORTSTATUS_C_RESET;
-				usbhhubClearFeaturePort(port, USBH_PORT_FEAT_C_RESET);
+	case USBH_PORTENUM_WAIT_DEFAULT:
+		if ((host->default_port != NULL) && (host->default_port != port)) {
+			/* another device is at the default address */
+			_port_enum_goto(port, USBH_PORTENUM_WAIT_DEFAULT, OSAL_MS2I(1));
+			return;
+		}
+		host->default_port = port;
+		_port_enum_reset(port);
+		return;
 
-				if ((port->status & (USBH_PORTSTATUS_ENABLE | USBH_PORTSTATUS_CONNECTION))
-						== (USBH_PORTSTATUS_ENABLE | USBH_PORTSTATUS_CONNECTION)) {
-					goto reset_success;
-				}
+	case USBH_PORTENUM_RESET:
+		/* check for reset completion */
+		if (port->c_status & USBH_PORTSTATUS_C_RESET) {
+			port->c_status &= ~USBH_PORTSTATUS_C_RESET;
+			usbhhubClearFeaturePort(port, USBH_PORT_FEAT_C_RESET);
+
+			if ((port->status & (USBH_PORTSTATUS_ENABLE | USBH_PORTSTATUS_CONNECTION))
+					== (USBH_PORTSTATUS_ENABLE | USBH_PORTSTATUS_CONNECTION)) {
+				uportinfof("Port %d: Reset OK, recovery...", port->number);
+				_port_enum_goto(port, USBH_PORTENUM_RECOVERY, OSAL_MS2I(100));
+				return;
 			}
+		}
 
-			/* check for timeout */
-			if (osalOsGetSystemTimeX() - start > HAL_USBH_PORT_RESET_TIMEOUT) {
-				uportwarnf("Port %d: reset timeout", port->number);
-				break;
+		/* check for timeout */
+		if (osalOsGetSystemTimeX() - port->enum_reset_time > HAL_USBH_PORT_RESET_TIMEOUT) {
+			uportwarnf("Port %d: reset timeout", port->number);
+			if (!--port->enum_resets) {
+				/* reset procedure failed; abort */
+				_port_enum_abort(port);
+				return;
 			}
+			_port_enum_reset(port);
+			return;
 		}
-	}
 
-	/* reset procedure failed; abort */
-	goto abort;
+		/* poll again */
+		_port_enum_goto(port, USBH_PORTENUM_RESET, OSAL_MS2I(1));
+		return;
 
-reset_success:
-	uportinfof("Port %d: Reset OK, recovery...", port->number);
+	case USBH_PORTENUM_RECOVERY:
+		/* initialize object */
+		if (port->status & USBH_PORTSTATUS_LOW_SPEED) {
+			speed = USBH_DEVSPEED_LOW;
+		} else if (port->status & USBH_PORTSTATUS_HIGH_SPEED) {
+			speed = USBH_DEVSPEED_HIGH;
+		} else {
+			speed = USBH_DEVSPEED_FULL;
+		}
+		_device_initialize(&port->device, speed);
+		usbhEPOpen(&port->device.ctrl);
 
-	/* reset recovery */
-	osalThreadSleepMilliseconds(100);
+		/* device with default address (0), try enumeration */
+		if (_device_enumerate(&port->device) != HAL_SUCCESS) {
+			_port_enum_retry(port);
+			return;
+		}
 
-	/* initialize object */
-	if (port->status & USBH_PORTSTATUS_LOW_SPEED) {
-		speed = USBH_DEVSPEED_LOW;
-	} else if (port->status & USBH_PORTSTATUS_HIGH_SPEED) {
-		speed = USBH_DEVSPEED_HIGH;
-	} else {
-		speed = USBH_DEVSPEED_FULL;
-	}
-	_device_initialize(&port->device, speed);
-	usbhEPOpen(&port->device.ctrl);
+		/* the device left the default address */
+		_port_enum_release(port);
 
-	/* device with default address (0), try enumeration */
-	if (_device_enumerate(&port->device) != HAL_SUCCESS) {
-		/* enumeration failed */
-		usbhEPClose(&port->device.ctrl);
+		uportinfof("Port %d: Wait stabilization...", port->number);
+		_port_enum_goto(port, USBH_PORTENUM_ADDRESS,
+				OSAL_MS2I(HAL_USBH_DEVICE_ADDRESS_STABILIZATION));
+		return;
+
+	case USBH_PORTENUM_ADDRESS:
+		if (_device_read_descriptor(&port->device) != HAL_SUCCESS) {
+			_port_enum_retry(port);
+			return;
+		}
 
-		if (!--retries) {
-			uportwarnf("Port %d: enumeration failed; abort", port->number);
-			goto abort;
+		/* load the default language ID */
+		uportinfof("Port %d: Loading langID0...", port->number);
+		if (!usbhStdReqGetStringDescriptor(&port->device, 0, 0,
+				USBH_DT_STRING_SIZE, (uint8_t *)&strdesc)
+			&& (strdesc.bLength >= 4)
+			&& !usbhStdReqGetStringDescriptor(&port->device, 0, 0,
+				4, (uint8_t *)&strdesc)) {
+
+			port->device.langID0 = strdesc.wData[0];
+			uportinfof("Port %d: langID0=%04x", port->number, port->device.langID0);
 		}
 
-		/* retry reset & enumeration */
-		uportwarnf("Port %d: enumeration failed; retry reset & enumeration", port->number);
-		goto reset;
-	}
+		/* check if the device has only one configuration */
+		if (port->device.devDesc.bNumConfigurations == 1) {
+			uportinfof("Port %d: device has only one configuration", port->number);
+			_device_configure(&port->device, 0);
+		}
 
-	/* load the default language ID */
-	uportinfof("Port %d: Loading langID0...", port->number);
-	if (!usbhStdReqGetStringDescriptor(&port->device, 0, 0,
-			USBH_DT_STRING_SIZE, (uint8_t *)&strdesc)
-		&& (strdesc.bLength >= 4)
-		&& !usbhStdReqGetStringDescriptor(&port->device, 0, 0,
-			4, (uint8_t *)&strdesc)) {
+		_port_enum_finish(port);
+		_classdriver_process_device(&port->device);
+		return;
 
-		port->device.langID0 = strdesc.wData[0];
-		uportinfof("Port %d: langID0=%04x", port->number, port->device.langID0);
+	default:
+		osalDbgAssert(FALSE, "invalid state");
+		return;
 	}
+}
 
-	/* check if the device has only one configuration */
-	if (port->device.devDesc.bNumConfigurations == 1) {
-		uportinfof("Port %d: device has only one configuration", port->number);
-		_device_configure(&port->device, 0);
+/* Runs the steps that are due; returns the time until the next one, or
+ * TIME_INFINITE once the enumeration is over. */
+static sysinterval_t _port_enum_process(usbh_port_t *port) {
+	while (port->enum_state != USBH_PORTENUM_IDLE) {
+		const sysinterval_t elapsed =
+				(sysinterval_t)(osalOsGetSystemTimeX() - port->enum_time);
+		if (elapsed < port->enum_delay)
+			return port->enum_delay - elapsed;
+		_port_enum_step(port);
 	}
+	return TIME_INFINITE;
+}
 
-	_classdriver_process_device(&port->device);
-	return;
+static void _port_connected(usbh_port_t *port) {
+	/* connected */
 
-abort:
-	uporterrf("Port %d: abort", port->number);
-	port->device.status = USBH_DEVSTATUS_DISCONNECTED;
+	port->device.status = USBH_DEVSTATUS_ATTACHED;
+	port->device.address = 0;
+	port->device.host->enumerating++;
+	uportinfof("Port %d: attached, wait debounce...", port->number);
+
+	/* wait for attach de-bounce */
+	_port_enum_goto(port, USBH_PORTENUM_DEBOUNCE,
+			OSAL_MS2I(HAL_USBH_PORT_DEBOUNCE_TIME));
+
+#if !HAL_USBH_USE_PARALLEL_ENUMERATION
+	sysinterval_t wait;
+	while ((wait = _port_enum_process(port)) != TIME_INFINITE) {
+		osalThreadSleep(wait);
+	}
+#endif
 }
 
 void _usbh_port_disconnected(usbh_port_t *port) {
 	if (port->device.status == USBH_DEVSTATUS_DISCONNECTED)
 		return;
 
+	/* no driver is loaded before the enumeration is over */
+	if (port->enum_state != USBH_PORTENUM_IDLE) {
+		_port_enum_abort(port);
+		return;
+	}
+
 	uportinfof("Port %d: disconnected", port->number);
 
 	/* unload drivers */
@@ -1150,6 +1301,17 @@ static void _hub_process(USBHDriver *host) {
 /*===========================================================================*/
 /* Main processing loop (enumeration, loading/unloading drivers, etc).       */
 /*===========================================================================*/
+#if HAL_USBH_USE_PARALLEL_ENUMERATION
+static sysinterval_t _enum_process_ports(usbh_port_t *port, sysinterval_t wait) {
+	for (; port != NULL; port = port->next) {
+		const sysinterval_t w = _port_enum_process(port);
+		if (w < wait)
+			wait = w;
+	}
+	return wait;
+}
+#endif
+
 void usbhMainLoop(USBHDriver *usbh) {
 
 	if (usbh->status == USBH_STATUS_STOPPED)
@@ -1168,8 +1330,59 @@ void usbhMainLoop(USBHDriver *usbh) {
 	/* process root hub */
 	_hub_process(usbh);
 #endif
+
+#if HAL_USBH_USE_PARALLEL_ENUMERATION
+	/* advance the enumerations */
+	usbh->enum_wait = _enum_process_ports(&usbh->rootport, TIME_INFINITE);
+#if HAL_USBH_USE_HUB
+	list_for_each_entry_safe(hub, USBHHubDriver, temp, &usbh->hubs, node) {
+		usbh->enum_wait = _enum_process_ports(hub->ports, usbh->enum_wait);
+	}
+#endif
+#endif
+}
+
+#if HAL_USBH_USE_MAIN_THREAD
+/* The listener is registered before the first pass, so changes that happen
+ * while a pass is running leave the event pending and cause another one. */
+static THD_FUNCTION(_main_thread, arg) {
+	USBHDriver *const usbh = (USBHDriver *)arg;
+	event_listener_t el;
+
+	chRegSetThreadName("USBH");
+	chEvtRegister(&usbh->event, &el, 0);
+
+	while (!chThdShouldTerminateX()) {
+		usbhMainLoop(usbh);
+#if HAL_USBH_USE_PARALLEL_ENUMERATION
+		/* wake up for the next enumeration step */
+		chEvtWaitAnyTimeout(EVENT_MASK(0), usbh->enum_wait);
+#else
+		chEvtWaitAny(EVENT_MASK(0));
+#endif
+		chEvtGetAndClearFlags(&el);
+	}
+
+	chEvtUnregister(&usbh->event, &el);
+}
+
+static void _main_thread_start(USBHDriver *usbh) {
+	osalDbgAssert(usbh->main_thread == NULL, "already started");
+	usbh->main_thread = chThdCreateStatic(usbh->main_wa, sizeof(usbh->main_wa),
+			HAL_USBH_MAIN_THREAD_PRIO, _main_thread, usbh);
 }
 
+/* Must not be called from the main thread itself (i.e. from a class driver
+ * load/unload or from an enumeration hook). */
+static void _main_thread_stop(USBHDriver *usbh) {
+	osalDbgAssert(usbh->main_thread != chThdGetSelfX(), "called from main thread");
+	chThdTerminate(usbh->main_thread);
+	osalEventBroadcastFlags(&usbh->event, 0);
+	chThdWait(usbh->main_thread);
+	usbh->main_thread = NULL;
+}
+#endif
+
 /*===========================================================================*/
 /* Class driver loader.                                                      */
 /*===========================================================================*/
@@ -284,18 +284,34 @@ static void _aoa_unload(usbh_baseclassdriver_t *drv) {
 /* ------------------------------------ */
 
 static void _submitOutI(USBHAOAChannel *aoacp, uint32_t len) {
+	usbh_urb_t *const urb = &aoacp->oq_urb[aoacp->oq_wr];
 	uclassdrvdbgf("AOA: Submit OUT %d", len);
-	aoacp->oq_urb.requestedLength = len;
-	usbhURBObjectResetI(&aoacp->oq_urb);
-	usbhURBSubmitI(&aoacp->oq_urb);
+	urb->requestedLength = len;
+	usbhURBObjectResetI(urb);
+	usbhURBSubmitI(urb);
+
+	/* the writers go on with the next buffer, and wait there if it's still
+	 * on the bus */
+	if (++aoacp->oq_wr == HAL_USBHAOA_OUT_URBS)
+		aoacp->oq_wr = 0;
+	aoacp->oq_ptr = aoacp->oq_buff[aoacp->oq_wr];
+	aoacp->oq_counter = 64;
+}
+
+/* Reports a failed OUT transfer once: its data was dropped */
+static bool _out_failedS(USBHAOAChannel *aoacp) {
+	if (!aoacp->oq_error)
+		return false;
+	aoacp->oq_error = false;
+	return true;
 }
 
 static void _out_cb(usbh_urb_t *urb) {
 	USBHAOAChannel *const aoacp = (USBHAOAChannel *)urb->userData;
 	switch (urb->status) {
 	case USBH_URBSTATUS_OK:
-		aoacp->oq_ptr = aoacp->oq_buff;
-		aoacp->oq_counter = 64;
+		aoacp->stats.out_urbs++;
+		aoacp->stats.out_bytes += urb->actualLength;
 		chThdDequeueNextI(&aoacp->oq_waiting, Q_OK);
 		chnAddFlagsI(aoacp, CHN_OUTPUT_EMPTY | CHN_TRANSMISSION_END);
 		return;
@@ -306,10 +322,13 @@ static void _out_cb(usbh_urb_t *urb) {
 		return;
 	default:
 		uclassdrverrf("AOA: URB OUT status unexpected = %d", urb->status);
-		break;
+		aoacp->stats.errors++;
+		/* a retry would go after the URBs already queued and reorder the
+		 * data: drop this one, the next writer gets the error */
+		aoacp->oq_error = true;
+		chThdDequeueAllI(&aoacp->oq_waiting, Q_OK);
+		return;
 	}
-	usbhURBObjectResetI(&aoacp->oq_urb);
-	usbhURBSubmitI(&aoacp->oq_urb);
 }
 
 static size_t _write_timeout(USBHAOAChannel *aoacp, const uint8_t *bp,
@@ -319,15 +338,16 @@ static size_t _write_timeout(USBHAOAChannel *aoacp, const uint8_t *bp,
 	size_t w = 0;
 	osalSysLock();
 	while (true) {
-		if (aoacp->state != USBHAOA_CHANNEL_STATE_READY) {
+		if ((aoacp->state != USBHAOA_CHANNEL_STATE_READY) || _out_failedS(aoacp)) {
 			osalSysUnlock();
 			return w;
 		}
-		while (usbhURBIsBusy(&aoacp->oq_urb)) {
+		if (usbhURBIsBusy(&aoacp->oq_urb[aoacp->oq_wr])) {
 			if (chThdEnqueueTimeoutS(&aoacp->oq_waiting, timeout) != Q_OK) {
 				osalSysUnlock();
 				return w;
 			}
+			continue;
 		}
 
 		*aoacp->oq_ptr++ = *bp++;
@@ -348,12 +368,13 @@ static size_t _write_timeout(USBHAOAChannel *aoacp, const uint8_t *bp,
 static msg_t _put_timeout(USBHAOAChannel *aoacp, uint8_t b, systime_t timeout) {
 
 	osalSysLock();
-	if (aoacp->state != USBHAOA_CHANNEL_STATE_READY) {
-		osalSysUnlock();
-		return Q_RESET;
-	}
-
-	while (usbhURBIsBusy(&aoacp->oq_urb)) {
+	while (true) {
+		if ((aoacp->state != USBHAOA_CHANNEL_STATE_READY) || _out_failedS(aoacp)) {
+			osalSysUnlock();
+			return Q_RESET;
+		}
+		if (!usbhURBIsBusy(&aoacp->oq_urb[aoacp->oq_wr]))
+			break;
 		msg_t msg = chThdEnqueueTimeoutS(&aoacp->oq_waiting, timeout);
 		if (msg < Q_OK) {
 			osalSysUnlock();
@@ -378,10 +399,45 @@ static msg_t _put(USBHAOAChannel *aoacp, uint8_t b) {
 	return _put_timeout(aoacp, b, TIME_INFINITE);
 }
 
-static void _submitInI(USBHAOAChannel *aoacp) {
+static void _submitInI(USBHAOAChannel *aoacp, usbh_urb_t *urb) {
+	(void)aoacp;
 	uclassdrvdbg("AOA: Submit IN");
-	usbhURBObjectResetI(&aoacp->iq_urb);
-	usbhURBSubmitI(&aoacp->iq_urb);
+	usbhURBObjectResetI(urb);
+	usbhURBSubmitI(urb);
+}
+
+/* Points the readers to the data of the oldest completed URB, if any */
+static void _in_loadI(USBHAOAChannel *aoacp) {
+	if (aoacp->iq_ready_count) {
+		const usbh_urb_t *const urb = &aoacp->iq_urb[aoacp->iq_ready[aoacp->iq_ready_head]];
+		aoacp->iq_ptr = (uint8_t *)urb->buff;
+		aoacp->iq_counter = urb->actualLength;
+	}
+}
+
+/* The readers are done with the oldest completed URB: re-arm it */
+static void _in_releaseI(USBHAOAChannel *aoacp) {
+	const uint8_t i = aoacp->iq_ready[aoacp->iq_ready_head];
+	if (++aoacp->iq_ready_head == HAL_USBHAOA_IN_URBS)
+		aoacp->iq_ready_head = 0;
+	aoacp->iq_ready_count--;
+	_submitInI(aoacp, &aoacp->iq_urb[i]);
+	_in_loadI(aoacp);
+}
+
+/* Submits the IN URBs that are neither on the bus nor waiting to be read */
+static void _in_armI(USBHAOAChannel *aoacp) {
+	uint8_t i, j;
+	for (i = 0; i < HAL_USBHAOA_IN_URBS; i++) {
+		if (usbhURBIsBusy(&aoacp->iq_urb[i]))
+			continue;
+		for (j = 0; j < aoacp->iq_ready_count; j++) {
+			if (aoacp->iq_ready[(aoacp->iq_ready_head + j) % HAL_USBHAOA_IN_URBS] == i)
+				break;
+		}
+		if (j == aoacp->iq_ready_count)
+			_submitInI(aoacp, &aoacp->iq_urb[i]);
+	}
 }
 
 static void _in_cb(usbh_urb_t *urb) {
@@ -392,8 +448,14 @@ static void _in_cb(usbh_urb_t *urb) {
 			uurbdbgf("AOA: URB IN no data");
 		} else {
 			uurbdbgf("AOA: URB IN data len=%d", urb->actualLength);
-			aoacp->iq_ptr = aoacp->iq_buff;
-			aoacp->iq_counter = urb->actualLength;
+			aoacp->iq_ready[(aoacp->iq_ready_head + aoacp->iq_ready_count)
+					% HAL_USBHAOA_IN_URBS] = (uint8_t)(urb - aoacp->iq_urb);
+			if (aoacp->iq_ready_count++ == 0)
+				_in_loadI(aoacp);
+			if (aoacp->iq_ready_count == HAL_USBHAOA_IN_URBS)
+				aoacp->stats.in_full++;
+			aoacp->stats.in_urbs++;
+			aoacp->stats.in_bytes += urb->actualLength;
 			chThdDequeueNextI(&aoacp->iq_waiting, Q_OK);
 			chnAddFlagsI(aoacp, CHN_INPUT_AVAILABLE);
 		}
@@ -407,7 +469,8 @@ static void _in_cb(usbh_urb_t *urb) {
 		break;
 	default:
 		uurberrf("AOA: URB IN status unexpected = %d", urb->status);
-		_submitInI(aoacp);
+		aoacp->stats.errors++;
+		_submitInI(aoacp, urb);
 		break;
 	}
 }
@@ -425,8 +488,7 @@ static size_t _read_timeout(USBHAOAChannel *aoacp, uint8_t *bp,
 			return r;
 		}
 		while (aoacp->iq_counter == 0) {
-			if (!usbhURBIsBusy(&aoacp->iq_urb))
-				_submitInI(aoacp);
+			_in_armI(aoacp);
 			if (chThdEnqueueTimeoutS(&aoacp->iq_waiting, timeout) != Q_OK) {
 				osalSysUnlock();
 				return r;
@@ -434,7 +496,7 @@ static size_t _read_timeout(USBHAOAChannel *aoacp, uint8_t *bp,
 		}
 		*bp++ = *aoacp->iq_ptr++;
 		if (--aoacp->iq_counter == 0) {
-			_submitInI(aoacp);
+			_in_releaseI(aoacp);
 			osalOsRescheduleS();
 		}
 		osalSysUnlock();
@@ -456,8 +518,7 @@ static msg_t _get_timeout(USBHAOAChannel *aoacp, systime_t timeout) {
 		return Q_RESET;
 	}
 	while (aoacp->iq_counter == 0) {
-		if (!usbhURBIsBusy(&aoacp->iq_urb))
-			_submitInI(aoacp);
+		_in_armI(aoacp);
 		msg_t msg = chThdEnqueueTimeoutS(&aoacp->iq_waiting, timeout);
 		if (msg < Q_OK) {
 			osalSysUnlock();
@@ -466,7 +527,7 @@ static msg_t _get_timeout(USBHAOAChannel *aoacp, systime_t timeout) {
 	}
 	b = *aoacp->iq_ptr++;
 	if (--aoacp->iq_counter == 0) {
-		_submitInI(aoacp);
+		_in_releaseI(aoacp);
 		osalOsRescheduleS();
 	}
 	osalSysUnlock();
@@ -520,12 +581,12 @@ static void _vt(void *p) {
 	USBHAOAChannel *const aoacp = (USBHAOAChannel *)p;
 	osalSysLockFromISR();
 	if (aoacp->state == USBHAOA_CHANNEL_STATE_READY) {
-		uint32_t len = aoacp->oq_ptr - aoacp->oq_buff;
-		if (len && !usbhURBIsBusy(&aoacp->oq_urb)) {
+		uint32_t len = aoacp->oq_ptr - aoacp->oq_buff[aoacp->oq_wr];
+		if (len && !usbhURBIsBusy(&aoacp->oq_urb[aoacp->oq_wr])) {
 			_submitOutI(aoacp, len);
 		}
-		if ((aoacp->iq_counter == 0) && !usbhURBIsBusy(&aoacp->iq_urb)) {
-			_submitInI(aoacp);
+		if (aoacp->iq_counter == 0) {
+			_in_armI(aoacp);
 		}
 		chVTSetI(&aoacp->vt, OSAL_MS2I(16), _vt, aoacp);
 	}
@@ -546,18 +607,27 @@ void usbhaoaChannelStart(USBHAOADriver *aoap) {
 	if (aoacp->state == USBHAOA_CHANNEL_STATE_READY)
 		return;
 
-	usbhURBObjectInit(&aoacp->oq_urb, &aoacp->epout, _out_cb, aoacp, aoacp->oq_buff, 0);
+	uint8_t i;
+	for (i = 0; i < HAL_USBHAOA_OUT_URBS; i++)
+		usbhURBObjectInit(&aoacp->oq_urb[i], &aoacp->epout, _out_cb, aoacp, aoacp->oq_buff[i], 0);
 	chThdQueueObjectInit(&aoacp->oq_waiting);
+	aoacp->oq_wr = 0;
+	aoacp->oq_error = false;
 	aoacp->oq_counter = 64;
-	aoacp->oq_ptr = aoacp->oq_buff;
+	aoacp->oq_ptr = aoacp->oq_buff[0];
 	usbhEPOpen(&aoacp->epout);
 
-	usbhURBObjectInit(&aoacp->iq_urb, &aoacp->epin, _in_cb, aoacp, aoacp->iq_buff, 64);
+	for (i = 0; i < HAL_USBHAOA_IN_URBS; i++)
+		usbhURBObjectInit(&aoacp->iq_urb[i], &aoacp->epin, _in_cb, aoacp, aoacp->iq_buff[i], 64);
 	chThdQueueObjectInit(&aoacp->iq_waiting);
+	aoacp->iq_ready_head = 0;
+	aoacp->iq_ready_count = 0;
 	aoacp->iq_counter = 0;
-	aoacp->iq_ptr = aoacp->iq_buff;
+	aoacp->iq_ptr = aoacp->iq_buff[0];
+	memset(&aoacp->stats, 0, sizeof(aoacp->stats));
 	usbhEPOpen(&aoacp->epin);
-	usbhURBSubmit(&aoacp->iq_urb);
+	for (i = 0; i < HAL_USBHAOA_IN_URBS; i++)
+		usbhURBSubmit(&aoacp->iq_urb[i]);
 
 	chVTObjectInit(&aoacp->vt);
 	chVTSet(&aoacp->vt, OSAL_MS2I(16), _vt, aoacp);
@@ -575,6 +645,18 @@ void usbhaoaChannelStop(USBHAOADriver *aoap) {
 	osalSysUnlock();
 }
 
+void usbhaoaChannelGetStats(USBHAOADriver *aoap, usbhaoa_channel_stats_t *stats) {
+	osalSysLock();
+	*stats = aoap->channel.stats;
+	osalSysUnlock();
+}
+
+void usbhaoaChannelResetStats(USBHAOADriver *aoap) {
+	osalSysLock();
+	memset(&aoap->channel.stats, 0, sizeof(aoap->channel.stats));
+	osalSysUnlock();
+}
+
 /* ------------------------------------ */
 /*      General AOA functions           */
 /* ------------------------------------ */
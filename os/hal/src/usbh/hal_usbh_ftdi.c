@@ -377,18 +377,34 @@ static usbh_urbstatus_t _set_baudrate(USBHFTDIPortDriver *ftdipp, uint32_t baudr
 
 
 static void _submitOutI(USBHFTDIPortDriver *ftdipp, uint32_t len) {
+	usbh_urb_t *const urb = &ftdipp->oq_urb[ftdipp->oq_wr];
 	uclassdrvdbgf("FTDI: Submit OUT %d", len);
-	ftdipp->oq_urb.requestedLength = len;
-	usbhURBObjectResetI(&ftdipp->oq_urb);
-	usbhURBSubmitI(&ftdipp->oq_urb);
+	urb->requestedLength = len;
+	usbhURBObjectResetI(urb);
+	usbhURBSubmitI(urb);
+
+	/* the writers go on with the next buffer, and wait there if it's still
+	 * on the bus */
+	if (++ftdipp->oq_wr == HAL_USBHFTDI_OUT_URBS)
+		ftdipp->oq_wr = 0;
+	ftdipp->oq_ptr = ftdipp->oq_buff[ftdipp->oq_wr];
+	ftdipp->oq_counter = 64;
+}
+
+/* Reports a failed OUT transfer once: its data was dropped */
+static bool _out_failedS(USBHFTDIPortDriver *ftdipp) {
+	if (!ftdipp->oq_error)
+		return false;
+	ftdipp->oq_error = false;
+	return true;
 }
 
 static void _out_cb(usbh_urb_t *urb) {
 	USBHFTDIPortDriver *const ftdipp = (USBHFTDIPortDriver *)urb->userData;
 	switch (urb->status) {
 	case USBH_URBSTATUS_OK:
-		ftdipp->oq_ptr = ftdipp->oq_buff;
-		ftdipp->oq_counter = 64;
+		ftdipp->stats.out_urbs++;
+		ftdipp->stats.out_bytes += urb->actualLength;
 		chThdDequeueNextI(&ftdipp->oq_waiting, Q_OK);
 		return;
 	case USBH_URBSTATUS_DISCONNECTED:
@@ -397,10 +413,13 @@ static void _out_cb(usbh_urb_t *urb) {
 		return;
 	default:
 		uurberrf("FTDI: URB OUT status unexpected = %d", urb->status);
-		break;
+		ftdipp->stats.errors++;
+		/* a retry would go after the URBs already queued and reorder the
+		 * data: drop this one, the next writer gets the error */
+		ftdipp->oq_error = true;
+		chThdDequeueAllI(&ftdipp->oq_waiting, Q_OK);
+		return;
 	}
-	usbhURBObjectResetI(&ftdipp->oq_urb);
-	usbhURBSubmitI(&ftdipp->oq_urb);
 }
 
 static size_t _write_timeout(USBHFTDIPortDriver *ftdipp, const uint8_t *bp,
@@ -410,15 +429,16 @@ static size_t _write_timeout(USBHFTDIPortDriver *ftdipp, const uint8_t *bp,
 	size_t w = 0;
 	osalSysLock();
 	while (true) {
-		if (ftdipp->state != USBHFTDIP_STATE_READY) {
+		if ((ftdipp->state != USBHFTDIP_STATE_READY) || _out_failedS(ftdipp)) {
 			osalSysUnlock();
 			return w;
 		}
-		while (usbhURBIsBusy(&ftdipp->oq_urb)) {
+		if (usbhURBIsBusy(&ftdipp->oq_urb[ftdipp->oq_wr])) {
 			if (chThdEnqueueTimeoutS(&ftdipp->oq_waiting, timeout) != Q_OK) {
 				osalSysUnlock();
 				return w;
 			}
+			continue;
 		}
 
 		*ftdipp->oq_ptr++ = *bp++;
@@ -439,12 +459,13 @@ static size_t _write_timeout(USBHFTDIPortDriver *ftdipp, const uint8_t *bp,
 static msg_t _put_timeout(USBHFTDIPortDriver *ftdipp, uint8_t b, systime_t timeout) {
 
 	osalSysLock();
-	if (ftdipp->state != USBHFTDIP_STATE_READY) {
-		osalSysUnlock();
-		return Q_RESET;
-	}
-
-	while (usbhURBIsBusy(&ftdipp->oq_urb)) {
+	while (true) {
+		if ((ftdipp->state != USBHFTDIP_STATE_READY) || _out_failedS(ftdipp)) {
+			osalSysUnlock();
+			return Q_RESET;
+		}
+		if (!usbhURBIsBusy(&ftdipp->oq_urb[ftdipp->oq_wr]))
+			break;
 		msg_t msg = chThdEnqueueTimeoutS(&ftdipp->oq_waiting, timeout);
 		if (msg < Q_OK) {
 			osalSysUnlock();
@@ -469,10 +490,45 @@ static msg_t _put(USBHFTDIPortDriver *ftdipp, uint8_t b) {
 	return _put_timeout(ftdipp, b, TIME_INFINITE);
 }
 
-static void _submitInI(USBHFTDIPortDriver *ftdipp) {
+static void _submitInI(USBHFTDIPortDriver *ftdipp, usbh_urb_t *urb) {
+	(void)ftdipp;
 	uclassdrvdbg("FTDI: Submit IN");
-	usbhURBObjectResetI(&ftdipp->iq_urb);
-	usbhURBSubmitI(&ftdipp->iq_urb);
+	usbhURBObjectResetI(urb);
+	usbhURBSubmitI(urb);
+}
+
+/* Points the readers to the data of the oldest completed URB, if any */
+static void _in_loadI(USBHFTDIPortDriver *ftdipp) {
+	if (ftdipp->iq_ready_count) {
+		const usbh_urb_t *const urb = &ftdipp->iq_urb[ftdipp->iq_ready[ftdipp->iq_ready_head]];
+		ftdipp->iq_ptr = (uint8_t *)urb->buff + 2;
+		ftdipp->iq_counter = urb->actualLength - 2;
+	}
+}
+
+/* The readers are done with the oldest completed URB: re-arm it */
+static void _in_releaseI(USBHFTDIPortDriver *ftdipp) {
+	const uint8_t i = ftdipp->iq_ready[ftdipp->iq_ready_head];
+	if (++ftdipp->iq_ready_head == HAL_USBHFTDI_IN_URBS)
+		ftdipp->iq_ready_head = 0;
+	ftdipp->iq_ready_count--;
+	_submitInI(ftdipp, &ftdipp->iq_urb[i]);
+	_in_loadI(ftdipp);
+}
+
+/* Submits the IN URBs that are neither on the bus nor waiting to be read */
+static void _in_armI(USBHFTDIPortDriver *ftdipp) {
+	uint8_t i, j;
+	for (i = 0; i < HAL_USBHFTDI_IN_URBS; i++) {
+		if (usbhURBIsBusy(&ftdipp->iq_urb[i]))
+			continue;
+		for (j = 0; j < ftdipp->iq_ready_count; j++) {
+			if (ftdipp->iq_ready[(ftdipp->iq_ready_head + j) % HAL_USBHFTDI_IN_URBS] == i)
+				break;
+		}
+		if (j == ftdipp->iq_ready_count)
+			_submitInI(ftdipp, &ftdipp->iq_urb[i]);
+	}
 }
 
 static void _in_cb(usbh_urb_t *urb) {
@@ -481,13 +537,23 @@ static void _in_cb(usbh_urb_t *urb) {
 	case USBH_URBSTATUS_OK:
 		if (urb->actualLength < 2) {
 			uurbwarnf("FTDI: URB IN actualLength = %d, < 2", urb->actualLength);
-		} else if (urb->actualLength > 2) {
+			break;
+		}
+		if (((uint8_t *)urb->buff)[1] & FTDI_RS_OE)
+			ftdipp->stats.overruns++;
+		if (urb->actualLength > 2) {
 			uurbdbgf("FTDI: URB IN data len=%d, status=%02x %02x",
 					urb->actualLength - 2,
 					((uint8_t *)urb->buff)[0],
 					((uint8_t *)urb->buff)[1]);
-			ftdipp->iq_ptr = ftdipp->iq_buff + 2;
-			ftdipp->iq_counter = urb->actualLength - 2;
+			ftdipp->iq_ready[(ftdipp->iq_ready_head + ftdipp->iq_ready_count)
+					% HAL_USBHFTDI_IN_URBS] = (uint8_t)(urb - ftdipp->iq_urb);
+			if (ftdipp->iq_ready_count++ == 0)
+				_in_loadI(ftdipp);
+			if (ftdipp->iq_ready_count == HAL_USBHFTDI_IN_URBS)
+				ftdipp->stats.in_full++;
+			ftdipp->stats.in_urbs++;
+			ftdipp->stats.in_bytes += urb->actualLength - 2;
 			chThdDequeueNextI(&ftdipp->iq_waiting, Q_OK);
 			return;
 		} else {
@@ -503,9 +569,10 @@ static void _in_cb(usbh_urb_t *urb) {
 		return;
 	default:
 		uurberrf("FTDI: URB IN status unexpected = %d", urb->status);
+		ftdipp->stats.errors++;
 		break;
 	}
-	_submitInI(ftdipp);
+	_submitInI(ftdipp, urb);
 }
 
 static size_t _read_timeout(USBHFTDIPortDriver *ftdipp, uint8_t *bp,
@@ -521,8 +588,7 @@ static size_t _read_timeout(USBHFTDIPortDriver *ftdipp, uint8_t *bp,
 			return r;
 		}
 		while (ftdipp->iq_counter == 0) {
-			if (!usbhURBIsBusy(&ftdipp->iq_urb))
-				_submitInI(ftdipp);
+			_in_armI(ftdipp);
 			if (chThdEnqueueTimeoutS(&ftdipp->iq_waiting, timeout) != Q_OK) {
 				osalSysUnlock();
 				return r;
@@ -530,7 +596,7 @@ static size_t _read_timeout(USBHFTDIPortDriver *ftdipp, uint8_t *bp,
 		}
 		*bp++ = *ftdipp->iq_ptr++;
 		if (--ftdipp->iq_counter == 0) {
-			_submitInI(ftdipp);
+			_in_releaseI(ftdipp);
 			osalOsRescheduleS();
 		}
 		osalSysUnlock();
@@ -552,8 +618,7 @@ static msg_t _get_timeout(USBHFTDIPortDriver *ftdipp, systime_t timeout) {
 		return Q_RESET;
 	}
 	while (ftdipp->iq_counter == 0) {
-		if (!usbhURBIsBusy(&ftdipp->iq_urb))
-			_submitInI(ftdipp);
+		_in_armI(ftdipp);
 		msg_t msg = chThdEnqueueTimeoutS(&ftdipp->iq_waiting, timeout);
 		if (msg < Q_OK) {
 			osalSysUnlock();
@@ -562,7 +627,7 @@ static msg_t _get_timeout(USBHFTDIPortDriver *ftdipp, systime_t timeout) {
 	}
 	b = *ftdipp->iq_ptr++;
 	if (--ftdipp->iq_counter == 0) {
-		_submitInI(ftdipp);
+		_in_releaseI(ftdipp);
 		osalOsRescheduleS();
 	}
 	osalSysUnlock();
@@ -588,12 +653,12 @@ static msg_t _ctl(USBHFTDIPortDriver *ftdipp, unsigned int operation, void *arg)
 static void _vt(void *p) {
 	USBHFTDIPortDriver *const ftdipp = (USBHFTDIPortDriver *)p;
 	osalSysLockFromISR();
-	uint32_t len = ftdipp->oq_ptr - ftdipp->oq_buff;
-	if (len && !usbhURBIsBusy(&ftdipp->oq_urb)) {
+	uint32_t len = ftdipp->oq_ptr - ftdipp->oq_buff[ftdipp->oq_wr];
+	if (len && !usbhURBIsBusy(&ftdipp->oq_urb[ftdipp->oq_wr])) {
 		_submitOutI(ftdipp, len);
 	}
-	if ((ftdipp->iq_counter == 0) && !usbhURBIsBusy(&ftdipp->iq_urb)) {
-		_submitInI(ftdipp);
+	if (ftdipp->iq_counter == 0) {
+		_in_armI(ftdipp);
 	}
 	chVTSetI(&ftdipp->vt, OSAL_MS2I(16), _vt, ftdipp);
 	osalSysUnlockFromISR();
@@ -663,18 +728,27 @@ void usbhftdipStart(USBHFTDIPortDriver *ftdipp, const USBHFTDIPortConfig *config
 		wValue = (config->xoff_character << 8) | config->xon_character;
 	_ftdi_port_control(ftdipp, FTDI_COMMAND_SETFLOW, wValue, config->handshake, 0, NULL);
 
-	usbhURBObjectInit(&ftdipp->oq_urb, &ftdipp->epout, _out_cb, ftdipp, ftdipp->oq_buff, 0);
+	uint8_t i;
+	for (i = 0; i < HAL_USBHFTDI_OUT_URBS; i++)
+		usbhURBObjectInit(&ftdipp->oq_urb[i], &ftdipp->epout, _out_cb, ftdipp, ftdipp->oq_buff[i], 0);
 	chThdQueueObjectInit(&ftdipp->oq_waiting);
+	ftdipp->oq_wr = 0;
+	ftdipp->oq_error = false;
 	ftdipp->oq_counter = 64;
-	ftdipp->oq_ptr = ftdipp->oq_buff;
+	ftdipp->oq_ptr = ftdipp->oq_buff[0];
 	usbhEPOpen(&ftdipp->epout);
 
-	usbhURBObjectInit(&ftdipp->iq_urb, &ftdipp->epin, _in_cb, ftdipp, ftdipp->iq_buff, 64);
+	for (i = 0; i < HAL_USBHFTDI_IN_URBS; i++)
+		usbhURBObjectInit(&ftdipp->iq_urb[i], &ftdipp->epin, _in_cb, ftdipp, ftdipp->iq_buff[i], 64);
 	chThdQueueObjectInit(&ftdipp->iq_waiting);
+	ftdipp->iq_ready_head = 0;
+	ftdipp->iq_ready_count = 0;
 	ftdipp->iq_counter = 0;
-	ftdipp->iq_ptr = ftdipp->iq_buff;
+	ftdipp->iq_ptr = ftdipp->iq_buff[0];
+	memset(&ftdipp->stats, 0, sizeof(ftdipp->stats));
 	usbhEPOpen(&ftdipp->epin);
-	usbhURBSubmit(&ftdipp->iq_urb);
+	for (i = 0; i < HAL_USBHFTDI_IN_URBS; i++)
+		usbhURBSubmit(&ftdipp->iq_urb[i]);
 
 	chVTObjectInit(&ftdipp->vt);
 	chVTSet(&ftdipp->vt, OSAL_MS2I(16), _vt, ftdipp);
@@ -683,6 +757,18 @@ void usbhftdipStart(USBHFTDIPortDriver *ftdipp, const USBHFTDIPortConfig *config
 	osalMutexUnlock(&ftdipp->ftdip->mtx);
 }
 
+void usbhftdipGetStats(USBHFTDIPortDriver *ftdipp, usbhftdip_stats_t *stats) {
+	osalSysLock();
+	*stats = ftdipp->stats;
+	osalSysUnlock();
+}
+
+void usbhftdipResetStats(USBHFTDIPortDriver *ftdipp) {
+	osalSysLock();
+	memset(&ftdipp->stats, 0, sizeof(ftdipp->stats));
+	osalSysUnlock();
+}
+
 static void _ftdi_object_init(USBHFTDIDriver *ftdip) {
 	osalDbgCheck(ftdip != NULL);
 	memset(ftdip, 0, sizeof(*ftdip));
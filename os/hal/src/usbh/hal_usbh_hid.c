@@ -62,6 +62,65 @@ const usbh_classdriverinfo_t usbhhidClassDriverInfo = {
 	"HID", &class_driver_vmt
 };
 
+/* Each host runs its own enumeration, so loads on different hosts can
+ * overlap: they are serialized, for the allocation of the instances (the
+ * core sets dev right after the load returns) and for the report
+ * descriptor buffer */
+static mutex_t _load_mtx;
+
+#if HAL_USBHHID_USE_REPORT_PARSER
+#define USBH_HID_DT_HID				0x21
+#define USBH_HID_DT_REPORT			0x22
+
+/* Shared by all the instances, under _load_mtx */
+static USBH_DEFINE_BUFFER(uint8_t _report_desc[HAL_USBHHID_MAX_REPORT_DESCRIPTOR]);
+
+static void _load_fields(USBHHIDDriver *hidp, usbh_device_t *dev, const if_iterator_t *iif) {
+	generic_iterator_t ics;
+	uint16_t len = 0;
+	uint8_t i;
+
+	hidp->fields_count = 0;
+
+	/* the HID descriptor gives the length of the report descriptor */
+	for (cs_iter_init(&ics, (const generic_iterator_t *)iif); ics.valid; cs_iter_next(&ics)) {
+		const uint8_t *const d = ics.curr;
+		if ((d[1] != USBH_HID_DT_HID) || (d[0] < 6))
+			continue;
+		for (i = 0; (i < d[5]) && (9 + 3 * i <= d[0]); i++) {
+			if (d[6 + 3 * i] == USBH_HID_DT_REPORT) {
+				len = d[7 + 3 * i] | (d[8 + 3 * i] << 8);
+				break;
+			}
+		}
+	}
+
+	if (len == 0) {
+		udevwarn("HID: No report descriptor");
+		return;
+	}
+	if (len > sizeof(_report_desc)) {
+		udevwarnf("HID: Report descriptor too long (%d bytes)", len);
+		return;
+	}
+
+	if (usbhControlRequest(dev,
+			USBH_REQTYPE_STANDARDIN(USBH_REQTYPE_RECIP_INTERFACE), USBH_REQ_GET_DESCRIPTOR,
+			USBH_HID_DT_REPORT << 8, hidp->ifnum, len, _report_desc) != USBH_URBSTATUS_OK) {
+		udeverr("HID: Can't read the report descriptor");
+		return;
+	}
+
+	if (usbhhidParseReportDescriptor(_report_desc, len, hidp->fields,
+			HAL_USBHHID_MAX_FIELDS, &hidp->fields_count) != HAL_SUCCESS) {
+		udevwarnf("HID: Report descriptor malformed or too large, %d fields kept",
+				hidp->fields_count);
+	} else {
+		udevinfof("HID: %d report fields", hidp->fields_count);
+	}
+}
+#endif
+
 static usbh_baseclassdriver_t *_hid_load(usbh_device_t *dev, const uint8_t *descriptor, uint16_t rem) {
 	int i;
 	USBHHIDDriver *hidp;
@@ -78,6 +137,8 @@ static usbh_baseclassdriver_t *_hid_load(usbh_device_t *dev, const uint8_t *desc
 	}
 
 
+	osalMutexLock(&_load_mtx);
+
 	/* alloc driver */
 	for (i = 0; i < HAL_USBHHID_MAX_INSTANCES; i++) {
 		if (USBHHIDD[i].dev == NULL) {
@@ -89,6 +150,7 @@ static usbh_baseclassdriver_t *_hid_load(usbh_device_t *dev, const uint8_t *desc
 	udevwarn("Can't alloc HID driver");
 
 	/* can't alloc */
+	osalMutexUnlock(&_load_mtx);
 	return NULL;
 
 alloc_ok:
@@ -147,12 +209,18 @@ alloc_ok:
 		goto deinit;
 	}
 
+#if HAL_USBHHID_USE_REPORT_PARSER
+	_load_fields(hidp, dev, &iif);
+#endif
+
 	hidp->state = USBHHID_STATE_ACTIVE;
 
+	osalMutexUnlock(&_load_mtx);
 	return (usbh_baseclassdriver_t *)hidp;
 
 deinit:
 	/* Here, the enpoints are closed, and the driver is unlinked */
+	osalMutexUnlock(&_load_mtx);
 	return NULL;
 }
 
@@ -293,6 +361,353 @@ usbh_urbstatus_t usbhhidSetProtocol(USBHHIDDriver *hidp, uint8_t protocol) {
 			protocol, hidp->ifnum, 0, NULL);
 }
 
+/*===========================================================================*/
+/* Report descriptor parser.                                                 */
+/*===========================================================================*/
+
+#define _HID_ITEM_MAIN				0
+#define _HID_ITEM_GLOBAL			1
+#define _HID_ITEM_LOCAL				2
+#define _HID_ITEM_LONG				0xFE
+
+#define _HID_MAIN_INPUT				0x8
+#define _HID_MAIN_OUTPUT			0x9
+#define _HID_MAIN_COLLECTION		0xA
+#define _HID_MAIN_FEATURE			0xB
+#define _HID_MAIN_END_COLLECTION	0xC
+
+#define _HID_GLOBAL_USAGE_PAGE		0x0
+#define _HID_GLOBAL_LOGICAL_MIN		0x1
+#define _HID_GLOBAL_LOGICAL_MAX		0x2
+#define _HID_GLOBAL_REPORT_SIZE		0x7
+#define _HID_GLOBAL_REPORT_ID		0x8
+#define _HID_GLOBAL_REPORT_COUNT	0x9
+#define _HID_GLOBAL_PUSH			0xA
+#define _HID_GLOBAL_POP				0xB
+
+#define _HID_LOCAL_USAGE			0x0
+#define _HID_LOCAL_USAGE_MIN		0x1
+#define _HID_LOCAL_USAGE_MAX		0x2
+
+#define _HID_MAX_USAGES				16
+#define _HID_MAX_REPORT_IDS			8
+#define _HID_STACK_DEPTH			4
+
+typedef struct {
+	uint32_t usage_page;
+	int32_t logical_min;
+	int32_t logical_max;		/* sign extended */
+	uint32_t logical_max_u;		/* zero extended, for the unsigned ranges */
+	uint32_t report_size;
+	uint32_t report_count;
+	uint8_t report_id;
+} _hid_globals_t;
+
+typedef struct {
+	uint32_t usages[_HID_MAX_USAGES];
+	uint8_t nusages;
+	bool has_min;
+	bool has_max;
+	uint32_t usage_min;
+	uint32_t usage_max;
+} _hid_locals_t;
+
+typedef struct {
+	uint8_t id;
+	uint16_t bits[3];			/* by report type */
+} _hid_report_ofs_t;
+
+/* Usage of the i-th element of a main item */
+static uint32_t _usage_at(const _hid_locals_t *l, uint32_t i) {
+	if (l->nusages)
+		return l->usages[(i < l->nusages) ? i : (uint32_t)l->nusages - 1];
+	if (l->has_min) {
+		uint32_t u = l->usage_min + i;
+		if (l->has_max && (u > l->usage_max))
+			u = l->usage_max;
+		return u;
+	}
+	return 0;
+}
+
+static uint32_t _extend_usage(const _hid_globals_t *g, uint32_t u, uint8_t size) {
+	/* 4 byte usages carry their page */
+	return (size == 4) ? u : ((g->usage_page << 16) | u);
+}
+
+bool usbhhidParseReportDescriptor(const uint8_t *desc, uint16_t len,
+		usbhhid_field_t *fields, uint16_t max_fields, uint16_t *count) {
+
+	_hid_globals_t g;
+	_hid_globals_t stack[_HID_STACK_DEPTH];
+	uint8_t sp = 0;
+	_hid_locals_t l;
+	_hid_report_ofs_t ofs[_HID_MAX_REPORT_IDS];
+	uint8_t nofs = 0;
+	uint16_t n = 0;
+	uint8_t depth = 0;
+	bool ret = HAL_SUCCESS;
+	uint16_t i = 0;
+
+	osalDbgCheck((desc != NULL) && (count != NULL) && ((fields != NULL) || (max_fields == 0)));
+
+	memset(&g, 0, sizeof(g));
+	memset(&l, 0, sizeof(l));
+
+	while (i < len) {
+		const uint8_t prefix = desc[i];
+		uint8_t size, type, tag;
+		uint32_t u = 0;
+		int32_t s = 0;
+
+		if (prefix == _HID_ITEM_LONG) {
+			if (i + 2 >= len)
+				goto malformed;
+			i += 3 + desc[i + 1];
+			continue;
+		}
+
+		size = prefix & 3;
+		if (size == 3)
+			size = 4;
+		type = (prefix >> 2) & 3;
+		tag = prefix >> 4;
+		if (i + 1 + size > len)
+			goto malformed;
+
+		switch (size) {
+		case 1:
+			u = desc[i + 1];
+			s = (int8_t)u;
+			break;
+		case 2:
+			u = desc[i + 1] | (desc[i + 2] << 8);
+			s = (int16_t)u;
+			break;
+		case 4:
+			u = desc[i + 1] | (desc[i + 2] << 8)
+					| ((uint32_t)desc[i + 3] << 16) | ((uint32_t)desc[i + 4] << 24);
+			s = (int32_t)u;
+			break;
+		}
+		i += 1 + size;
+
+		switch (type) {
+		case _HID_ITEM_MAIN:
+			if ((tag == _HID_MAIN_INPUT) || (tag == _HID_MAIN_OUTPUT) || (tag == _HID_MAIN_FEATURE)) {
+				const uint8_t rtype = (tag == _HID_MAIN_INPUT) ? USBHHID_REPORTTYPE_INPUT
+						: (tag == _HID_MAIN_OUTPUT) ? USBHHID_REPORTTYPE_OUTPUT
+						: USBHHID_REPORTTYPE_FEATURE;
+				const uint32_t total = g.report_size * g.report_count;
+				uint16_t *bits;
+				uint8_t j;
+
+				if ((g.report_size > 32) || (g.report_count > 0xffff))
+					goto malformed;
+
+				for (j = 0; j < nofs; j++) {
+					if (ofs[j].id == g.report_id)
+						break;
+				}
+				if (j == nofs) {
+					if (nofs == _HID_MAX_REPORT_IDS)
+						goto malformed;
+					memset(&ofs[nofs], 0, sizeof(ofs[nofs]));
+					ofs[nofs++].id = g.report_id;
+				}
+				bits = &ofs[j].bits[rtype - 1];
+				if (*bits + total > 0xffff)
+					goto malformed;
+
+				if (!(u & USBHHID_FIELD_CONSTANT) && total) {
+					uint8_t flags = (uint8_t)(u & 0x7f);
+					int32_t max = g.logical_max;
+					uint32_t k;
+
+					if (g.logical_min < 0)
+						flags |= USBHHID_FIELD_SIGNED;
+					else
+						max = (int32_t)g.logical_max_u;
+
+					for (k = 0; k < g.report_count; k++) {
+						if (n == max_fields) {
+							ret = HAL_FAILED;
+							break;
+						}
+						fields[n].usage = (flags & USBHHID_FIELD_VARIABLE) ?
+								_usage_at(&l, k) : _usage_at(&l, 0);
+						fields[n].logical_min = g.logical_min;
+						fields[n].logical_max = max;
+						fields[n].bit_offset = *bits + k * g.report_size;
+						fields[n].bit_size = (uint8_t)g.report_size;
+						fields[n].report_id = g.report_id;
+						fields[n].type = rtype;
+						fields[n].flags = flags;
+						n++;
+					}
+				}
+				*bits += total;
+			} else if (tag == _HID_MAIN_COLLECTION) {
+				depth++;
+			} else if (tag == _HID_MAIN_END_COLLECTION) {
+				if (depth == 0)
+					goto malformed;
+				depth--;
+			} else {
+				goto malformed;
+			}
+			memset(&l, 0, sizeof(l));
+			break;
+
+		case _HID_ITEM_GLOBAL:
+			switch (tag) {
+			case _HID_GLOBAL_USAGE_PAGE:
+				g.usage_page = u & 0xffff;
+				break;
+			case _HID_GLOBAL_LOGICAL_MIN:
+				g.logical_min = s;
+				break;
+			case _HID_GLOBAL_LOGICAL_MAX:
+				g.logical_max = s;
+				g.logical_max_u = u;
+				break;
+			case _HID_GLOBAL_REPORT_SIZE:
+				g.report_size = u;
+				break;
+			case _HID_GLOBAL_REPORT_ID:
+				if ((u == 0) || (u > 0xff))
+					goto malformed;
+				g.report_id = (uint8_t)u;
+				break;
+			case _HID_GLOBAL_REPORT_COUNT:
+				g.report_count = u;
+				break;
+			case _HID_GLOBAL_PUSH:
+				if (sp == _HID_STACK_DEPTH)
+					goto malformed;
+				stack[sp++] = g;
+				break;
+			case _HID_GLOBAL_POP:
+				if (sp == 0)
+					goto malformed;
+				g = stack[--sp];
+				break;
+			default:
+				/* physical range, units */
+				break;
+			}
+			break;
+
+		case _HID_ITEM_LOCAL:
+			switch (tag) {
+			case _HID_LOCAL_USAGE:
+				if (l.nusages < _HID_MAX_USAGES)
+					l.usages[l.nusages++] = _extend_usage(&g, u, size);
+				break;
+			case _HID_LOCAL_USAGE_MIN:
+				l.usage_min = _extend_usage(&g, u, size);
+				l.has_min = true;
+				break;
+			case _HID_LOCAL_USAGE_MAX:
+				l.usage_max = _extend_usage(&g, u, size);
+				l.has_max = true;
+				break;
+			default:
+				/* designators, strings, delimiters */
+				break;
+			}
+			break;
+
+		default:
+			goto malformed;
+		}
+	}
+
+	if (depth != 0)
+		goto malformed;
+
+	*count = n;
+	return ret;
+
+malformed:
+	*count = n;
+	return HAL_FAILED;
+}
+
+int32_t usbhhidExtractField(const usbhhid_field_t *field,
+		const uint8_t *report, uint16_t len) {
+
+	const uint32_t mask = (field->bit_size == 32) ? 0xffffffffU : ((1U << field->bit_size) - 1);
+	const uint32_t first = field->bit_offset >> 3;
+	uint32_t last = (field->bit_offset + field->bit_size - 1) >> 3;
+	uint64_t acc = 0;
+	uint32_t v;
+
+	if (field->report_id) {
+		if (len == 0)
+			return 0;
+		report++;
+		len--;
+	}
+	if (last >= len)
+		return 0;
+
+	/* little endian, at most 5 bytes */
+	for (;;) {
+		acc = (acc << 8) | report[last];
+		if (last == first)
+			break;
+		last--;
+	}
+	v = (uint32_t)(acc >> (field->bit_offset & 7)) & mask;
+
+	if ((field->flags & USBHHID_FIELD_SIGNED) && (v & ~(mask >> 1)))
+		v |= ~mask;
+
+	return (int32_t)v;
+}
+
+uint16_t usbhhidDecodeFields(const usbhhid_field_t *fields, uint16_t count,
+		usbhhid_reporttype_t report_type, const uint8_t *report, uint16_t len,
+		int32_t *values) {
+
+	uint32_t bits;
+	uint8_t id = 0;
+	uint16_t n = 0;
+	uint16_t i;
+
+	if ((count == 0) || (len == 0))
+		return 0;
+
+	/* either all or none of the reports have an ID */
+	if (fields[0].report_id) {
+		id = report[0];
+		len--;
+	}
+	bits = (uint32_t)len << 3;
+
+	for (i = 0; i < count; i++) {
+		const usbhhid_field_t *const f = &fields[i];
+		if ((f->report_id != id) || (f->type != (uint8_t)report_type)
+				|| ((uint32_t)f->bit_offset + f->bit_size > bits))
+			continue;
+		values[i] = usbhhidExtractField(f, report, len + (id ? 1 : 0));
+		n++;
+	}
+
+	return n;
+}
+
+const usbhhid_field_t *usbhhidFindField(const usbhhid_field_t *fields, uint16_t count,
+		usbhhid_reporttype_t report_type, uint32_t usage) {
+	uint16_t i;
+	for (i = 0; i < count; i++) {
+		if ((fields[i].usage == usage) && (fields[i].type == (uint8_t)report_type))
+			return &fields[i];
+	}
+	return NULL;
+}
+
 static void _hid_object_init(USBHHIDDriver *hidp) {
 	osalDbgCheck(hidp != NULL);
 	memset(hidp, 0, sizeof(*hidp));
@@ -306,6 +721,7 @@ static void _hid_init(void) {
 	for (i = 0; i < HAL_USBHHID_MAX_INSTANCES; i++) {
 		_hid_object_init(&USBHHIDD[i]);
 	}
+	osalMutexObjectInit(&_load_mtx);
 }
 
 #endif
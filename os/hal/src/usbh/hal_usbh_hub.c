@@ -101,6 +101,8 @@ static void _urb_complete(usbh_urb_t *urb) {
 			*sc++ |= *r++;
 
 		uurbinfof("HUB: change, %08x", hubdp->statuschange);
+		if (hubdp->statuschange)
+			_usbh_notifyI(hubdp->dev->host, USBH_EVENT_HUB_CHANGE);
 	}	break;
 	case USBH_URBSTATUS_DISCONNECTED:
 		uurbwarn("HUB: URB disconnected, aborting poll");
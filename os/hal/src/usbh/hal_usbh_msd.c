@@ -233,6 +233,12 @@ typedef struct {
 	uint32_t data_processed;
 } msd_transaction_t;
 
+/* Data phase segment; a transaction's data phase may span several buffers */
+typedef struct {
+	void *buff;
+	uint32_t len;
+} msd_sg_t;
+
 typedef enum {
 	MSD_BOTRESULT_OK,
 	MSD_BOTRESULT_DISCONNECTED,
@@ -266,7 +272,8 @@ static bool _msd_bot_reset(USBHMassStorageDriver *msdp) {
 	return usbhEPReset(&msdp->epin) && usbhEPReset(&msdp->epout);
 }
 
-static msd_bot_result_t _msd_bot_transaction(msd_transaction_t *tran, USBHMassStorageLUNDriver *lunp, void *data) {
+static msd_bot_result_t _msd_bot_transaction(msd_transaction_t *tran, USBHMassStorageLUNDriver *lunp,
+		const msd_sg_t *sg, uint8_t nsg) {
 
 	USBHMassStorageDriver *const msdp = lunp->msdp;
 
@@ -300,11 +307,21 @@ static msd_bot_result_t _msd_bot_transaction(msd_transaction_t *tran, USBHMassSt
 	data_actual_len = 0;
 	if (tran->cbw->dCBWDataTransferLength) {
 		usbh_ep_t *const ep = tran->cbw->bmCBWFlags & MSD_CBWFLAGS_D2H ? &msdp->epin : &msdp->epout;
-		status = usbhBulkTransfer(
-				ep,
-				data,
-				tran->cbw->dCBWDataTransferLength,
-				&data_actual_len, OSAL_MS2I(20000));
+		uint8_t i;
+
+		status = USBH_URBSTATUS_OK;
+		for (i = 0; i < nsg; i++) {
+			status = usbhBulkTransfer(
+					ep,
+					sg[i].buff,
+					sg[i].len,
+					&actual_len, OSAL_MS2I(20000));
+			data_actual_len += actual_len;
+
+			/* a short packet terminates the data phase */
+			if ((status != USBH_URBSTATUS_OK) || (actual_len < sg[i].len))
+				break;
+		}
 
 		if (status == USBH_URBSTATUS_CANCELLED) {
 			uclassdrverr("\tMSD: Data phase: USBH_URBSTATUS_CANCELLED");
@@ -476,14 +493,14 @@ typedef __PACKED_STRUCT {
 
 static msd_result_t scsi_requestsense(USBHMassStorageLUNDriver *lunp, scsi_sense_response_t *resp);
 
-static msd_result_t _scsi_perform_transaction(USBHMassStorageLUNDriver *lunp,
-		msd_transaction_t *transaction, void *data) {
+static msd_result_t _scsi_perform_transaction_sg(USBHMassStorageLUNDriver *lunp,
+		msd_transaction_t *transaction, const msd_sg_t *sg, uint8_t nsg) {
 
 	USBHMassStorageDriver *const msdp = lunp->msdp;
 	(void)msdp;
 
 	msd_bot_result_t res;
-	res = _msd_bot_transaction(transaction, lunp, data);
+	res = _msd_bot_transaction(transaction, lunp, sg, nsg);
 	if (res != MSD_BOTRESULT_OK) {
 		return (msd_result_t)res;
 	}
@@ -504,6 +521,15 @@ static msd_result_t _scsi_perform_transaction(USBHMassStorageLUNDriver *lunp,
 	return MSD_RESULT_OK;
 }
 
+static msd_result_t _scsi_perform_transaction(USBHMassStorageLUNDriver *lunp,
+		msd_transaction_t *transaction, void *data) {
+	msd_sg_t sg;
+
+	sg.buff = data;
+	sg.len = transaction->cbw->dCBWDataTransferLength;
+	return _scsi_perform_transaction_sg(lunp, transaction, &sg, 1);
+}
+
 static msd_result_t scsi_inquiry(USBHMassStorageLUNDriver *lunp, scsi_inquiry_response_t *resp) {
 	USBH_DEFINE_BUFFER(msd_cbw_t cbw);
 	msd_transaction_t transaction;
@@ -590,16 +616,17 @@ static msd_result_t scsi_readcapacity10(USBHMassStorageLUNDriver *lunp, scsi_rea
 }
 
 
-static msd_result_t scsi_read10(USBHMassStorageLUNDriver *lunp, uint32_t lba, uint16_t n, uint8_t *data, uint32_t *actual_len) {
+static msd_result_t scsi_rw10_sg(USBHMassStorageLUNDriver *lunp, bool write, uint32_t lba, uint16_t n,
+		const msd_sg_t *sg, uint8_t nsg, uint32_t *actual_len) {
 	USBH_DEFINE_BUFFER(msd_cbw_t cbw);
 	msd_transaction_t transaction;
 	msd_result_t res;
 
 	memset(cbw.CBWCB, 0, sizeof(cbw.CBWCB));
 	cbw.dCBWDataTransferLength = n * lunp->info.blk_size;
-	cbw.bmCBWFlags = MSD_CBWFLAGS_D2H;
+	cbw.bmCBWFlags = write ? MSD_CBWFLAGS_H2D : MSD_CBWFLAGS_D2H;
 	cbw.bCBWCBLength = 10;
-	cbw.CBWCB[0] = SCSI_CMD_READ_10;
+	cbw.CBWCB[0] = write ? SCSI_CMD_WRITE_10 : SCSI_CMD_READ_10;
 	cbw.CBWCB[2] = (uint8_t)(lba >> 24);
 	cbw.CBWCB[3] = (uint8_t)(lba >> 16);
 	cbw.CBWCB[4] = (uint8_t)(lba >> 8);
@@ -608,7 +635,7 @@ static msd_result_t scsi_read10(USBHMassStorageLUNDriver *lunp, uint32_t lba, ui
 	cbw.CBWCB[8] = (uint8_t)(n);
 	transaction.cbw = &cbw;
 
-	res = _scsi_perform_transaction(lunp, &transaction, data);
+	res = _scsi_perform_transaction_sg(lunp, &transaction, sg, nsg);
 	if (actual_len) {
 		*actual_len = transaction.data_processed;
 	}
@@ -622,37 +649,23 @@ static msd_result_t scsi_read10(USBHMassStorageLUNDriver *lunp, uint32_t lba, ui
 	return res;
 }
 
-static msd_result_t scsi_write10(USBHMassStorageLUNDriver *lunp, uint32_t lba, uint16_t n, const uint8_t *data, uint32_t *actual_len) {
-	USBH_DEFINE_BUFFER(msd_cbw_t cbw);
-	msd_transaction_t transaction;
-	msd_result_t res;
+static msd_result_t scsi_read10(USBHMassStorageLUNDriver *lunp, uint32_t lba, uint16_t n, uint8_t *data, uint32_t *actual_len) {
+	msd_sg_t sg;
 
-	memset(cbw.CBWCB, 0, sizeof(cbw.CBWCB));
-	cbw.dCBWDataTransferLength = n * lunp->info.blk_size;
-	cbw.bmCBWFlags = MSD_CBWFLAGS_H2D;
-	cbw.bCBWCBLength = 10;
-	cbw.CBWCB[0] = SCSI_CMD_WRITE_10;
-	cbw.CBWCB[2] = (uint8_t)(lba >> 24);
-	cbw.CBWCB[3] = (uint8_t)(lba >> 16);
-	cbw.CBWCB[4] = (uint8_t)(lba >> 8);
-	cbw.CBWCB[5] = (uint8_t)(lba);
-	cbw.CBWCB[7] = (uint8_t)(n >> 8);
-	cbw.CBWCB[8] = (uint8_t)(n);
-	transaction.cbw = &cbw;
+	sg.buff = data;
+	sg.len = n * lunp->info.blk_size;
+	return scsi_rw10_sg(lunp, false, lba, n, &sg, 1, actual_len);
+}
 
-	res = _scsi_perform_transaction(lunp, &transaction, (void *)data);
-	if (actual_len) {
-		*actual_len = transaction.data_processed;
-	}
-	if (res == MSD_RESULT_OK) {
-		//transaction is OK; check length
-		if (transaction.data_processed < cbw.dCBWDataTransferLength) {
-			res = MSD_RESULT_TRANSPORT_ERROR;
-		}
-	}
+#if !HAL_USBHMSD_USE_ASYNC
+static msd_result_t scsi_write10(USBHMassStorageLUNDriver *lunp, uint32_t lba, uint16_t n, const uint8_t *data, uint32_t *actual_len) {
+	msd_sg_t sg;
 
-	return res;
+	sg.buff = (void *)data;
+	sg.len = n * lunp->info.blk_size;
+	return scsi_rw10_sg(lunp, true, lba, n, &sg, 1, actual_len);
 }
+#endif
 
 
 
@@ -680,6 +693,9 @@ static void _lun_object_deinit(USBHMassStorageLUNDriver *lunp) {
 	lunp->msdp = NULL;
 	lunp->next = NULL;
 	memset(&lunp->info, 0, sizeof(lunp->info));
+#if HAL_USBHMSD_USE_ASYNC && (HAL_USBHMSD_READAHEAD_SIZE > 0)
+	lunp->ra_count = 0;
+#endif
 	lunp->state = BLK_STOP;
 	chSemSignal(&lunp->sem);
 }
@@ -777,6 +793,12 @@ bool usbhmsdLUNConnect(USBHMassStorageLUNDriver *lunp) {
 		(uint32_t)(((uint64_t)lunp->info.blk_size * lunp->info.blk_num) / (1024UL * 1024UL)));
 
 	uclassdrvinfo("MSD Connected.");
+#if HAL_USBHMSD_USE_ASYNC
+	lunp->next_read_blk = 0;
+#if HAL_USBHMSD_READAHEAD_SIZE > 0
+	lunp->ra_count = 0;
+#endif
+#endif
 	lunp->state = BLK_READY;
 	chSemSignal(&lunp->sem);
 	return HAL_SUCCESS;
@@ -812,6 +834,13 @@ bool usbhmsdLUNRead(USBHMassStorageLUNDriver *lunp, uint32_t startblk,
                 uint8_t *buffer, uint32_t n) {
 
 	osalDbgCheck(lunp != NULL);
+#if HAL_USBHMSD_USE_ASYNC
+	usbhmsd_request_t req;
+
+	req.status = USBHMSD_REQSTATUS_IDLE;
+	usbhmsdLUNSubmitRead(lunp, &req, startblk, buffer, n, NULL, NULL);
+	return usbhmsdRequestWait(&req);
+#else
 	bool ret = HAL_FAILED;
 	uint16_t blocks;
 	msd_result_t res;
@@ -851,12 +880,20 @@ exit:
 	lunp->state = BLK_READY;
 	chSemSignal(&lunp->sem);
 	return ret;
+#endif
 }
 
 bool usbhmsdLUNWrite(USBHMassStorageLUNDriver *lunp, uint32_t startblk,
                 const uint8_t *buffer, uint32_t n) {
 
 	osalDbgCheck(lunp != NULL);
+#if HAL_USBHMSD_USE_ASYNC
+	usbhmsd_request_t req;
+
+	req.status = USBHMSD_REQSTATUS_IDLE;
+	usbhmsdLUNSubmitWrite(lunp, &req, startblk, buffer, n, NULL, NULL);
+	return usbhmsdRequestWait(&req);
+#else
 	bool ret = HAL_FAILED;
 	uint16_t blocks;
 	msd_result_t res;
@@ -896,6 +933,7 @@ exit:
 	lunp->state = BLK_READY;
 	chSemSignal(&lunp->sem);
 	return ret;
+#endif
 }
 
 bool usbhmsdLUNSync(USBHMassStorageLUNDriver *lunp) {
@@ -934,6 +972,343 @@ USBHDriver *usbhmsdLUNGetHost(const USBHMassStorageLUNDriver *lunp) {
 	return lunp->msdp->dev->host;
 }
 
+#if HAL_USBHMSD_USE_ASYNC
+/*===========================================================================*/
+/* Asynchronous request queue                                                */
+/*===========================================================================*/
+
+static struct {
+	usbhmsd_request_t *head;
+	usbhmsd_request_t *tail;
+	thread_reference_t worker;
+	thread_t *thread;
+} _async;
+
+static THD_WORKING_AREA(_async_wa, HAL_USBHMSD_ASYNC_THREAD_STACK);
+
+static void _async_submit(USBHMassStorageLUNDriver *lunp, usbhmsd_request_t *req,
+		uint32_t startblk, uint8_t *buffer, uint32_t n, bool write,
+		usbhmsd_callback_t callback, void *user) {
+
+	osalDbgCheck((lunp != NULL) && (req != NULL));
+	osalDbgCheck((buffer != NULL) && (n > 0));
+	osalDbgAssert(req->status != USBHMSD_REQSTATUS_PENDING, "request busy");
+
+	req->next = NULL;
+	req->lunp = lunp;
+	req->startblk = startblk;
+	req->buffer = buffer;
+	req->n = n;
+	req->write = write;
+	req->callback = callback;
+	req->userData = user;
+	req->waitingThread = NULL;
+	req->status = USBHMSD_REQSTATUS_PENDING;
+
+	osalSysLock();
+	/* nothing would ever complete the request: fail it right away, in the
+	 * caller's context */
+	if ((_async.thread == NULL) || (lunp->state < BLK_READY)) {
+		req->status = USBHMSD_REQSTATUS_FAILED;
+		osalSysUnlock();
+		if (callback != NULL) {
+			callback(req);
+		}
+		return;
+	}
+	if (_async.tail != NULL) {
+		_async.tail->next = req;
+	} else {
+		_async.head = req;
+	}
+	_async.tail = req;
+	osalThreadResumeS(&_async.worker, MSG_OK);
+	osalSysUnlock();
+}
+
+/* Dequeues the head request plus the following ones that can be merged with
+ * it in a single command: same LUN, same direction, adjacent blocks. */
+static uint8_t _async_dequeue(usbhmsd_request_t **batch) {
+	usbhmsd_request_t *req;
+	uint32_t next, total;
+	uint8_t count;
+
+	osalSysLock();
+	while (_async.head == NULL) {
+		osalThreadSuspendS(&_async.worker);
+	}
+
+	req = _async.head;
+	_async.head = req->next;
+	batch[0] = req;
+	count = 1;
+	next = req->startblk + req->n;
+	total = req->n;
+
+	while ((count < HAL_USBHMSD_ASYNC_MAX_COALESCE)
+			&& ((req = _async.head) != NULL)
+			&& (req->lunp == batch[0]->lunp)
+			&& (req->write == batch[0]->write)
+			&& (req->startblk == next)
+			&& (total + req->n <= 0xffff)) {
+		_async.head = req->next;
+		batch[count++] = req;
+		next += req->n;
+		total += req->n;
+	}
+
+	if (_async.head == NULL) {
+		_async.tail = NULL;
+	}
+	osalSysUnlock();
+
+	return count;
+}
+
+static void _async_complete(usbhmsd_request_t *req, bool ok) {
+	const usbhmsd_callback_t callback = req->callback;
+
+	/* a synchronous waiter may release the request as soon as the status
+	 * changes, so it is not touched afterwards unless there is a callback */
+	osalSysLock();
+	req->status = (ok == HAL_SUCCESS) ? USBHMSD_REQSTATUS_OK : USBHMSD_REQSTATUS_FAILED;
+	osalThreadResumeS(&req->waitingThread, MSG_OK);
+	osalSysUnlock();
+
+	if (callback != NULL) {
+		callback(req);
+	}
+}
+
+#if HAL_USBHMSD_READAHEAD_SIZE > 0
+/* Serves the batch from the read-ahead buffer if it is fully contained */
+static bool _async_readahead_serve(USBHMassStorageLUNDriver *lunp,
+		usbhmsd_request_t **batch, uint8_t count) {
+	const uint32_t start = batch[0]->startblk;
+	const uint32_t end = batch[count - 1]->startblk + batch[count - 1]->n;
+	uint8_t i;
+
+	if ((lunp->ra_count == 0)
+			|| (start < lunp->ra_start)
+			|| (end > lunp->ra_start + lunp->ra_count)) {
+		return false;
+	}
+
+	for (i = 0; i < count; i++) {
+		memcpy(batch[i]->buffer,
+				&lunp->ra_buff[(batch[i]->startblk - lunp->ra_start) * lunp->info.blk_size],
+				batch[i]->n * lunp->info.blk_size);
+	}
+	lunp->stats.readahead_hits += count;
+	return true;
+}
+
+/* Prefetches the blocks following a sequential read */
+static void _async_readahead(USBHMassStorageLUNDriver *lunp) {
+	uint32_t next, blocks;
+
+	chSemWait(&lunp->sem);
+	if (lunp->state != BLK_READY) {
+		goto exit;
+	}
+
+	next = lunp->next_read_blk;
+	if ((lunp->ra_count != 0)
+			&& (next >= lunp->ra_start)
+			&& (next < lunp->ra_start + lunp->ra_count)) {
+		/* still buffered */
+		goto exit;
+	}
+
+	blocks = HAL_USBHMSD_READAHEAD_SIZE / lunp->info.blk_size;
+	if (next >= lunp->info.blk_num) {
+		blocks = 0;
+	} else if (blocks > lunp->info.blk_num - next) {
+		blocks = lunp->info.blk_num - next;
+	}
+	if (blocks == 0) {
+		goto exit;
+	}
+
+	lunp->state = BLK_READING;
+	lunp->ra_count = 0;
+	lunp->stats.readaheads++;
+	if (scsi_read10(lunp, next, (uint16_t)blocks, lunp->ra_buff, NULL) == MSD_RESULT_OK) {
+		lunp->ra_start = next;
+		lunp->ra_count = blocks;
+	}
+	lunp->state = BLK_READY;
+
+exit:
+	chSemSignal(&lunp->sem);
+}
+#endif
+
+static void _async_execute(usbhmsd_request_t **batch, uint8_t count) {
+	USBHMassStorageLUNDriver *const lunp = batch[0]->lunp;
+	USBHMassStorageDriver *msdp;
+	const bool write = batch[0]->write;
+	bool ret = HAL_FAILED;
+	bool sequential = false;
+	msd_sg_t sg[HAL_USBHMSD_ASYNC_MAX_COALESCE];
+	uint32_t total;
+	uint8_t i;
+
+	chSemWait(&lunp->sem);
+	if (lunp->state != BLK_READY) {
+		chSemSignal(&lunp->sem);
+		goto complete;
+	}
+	lunp->state = write ? BLK_WRITING : BLK_READING;
+	msdp = lunp->msdp;
+	(void)msdp;
+
+	if (write) {
+#if HAL_USBHMSD_READAHEAD_SIZE > 0
+		lunp->ra_count = 0;
+#endif
+	} else {
+		sequential = (batch[0]->startblk == lunp->next_read_blk);
+		lunp->next_read_blk = batch[count - 1]->startblk + batch[count - 1]->n;
+#if HAL_USBHMSD_READAHEAD_SIZE > 0
+		if (_async_readahead_serve(lunp, batch, count)) {
+			ret = HAL_SUCCESS;
+			goto done;
+		}
+#endif
+	}
+
+	if (count == 1) {
+		/* single request, possibly larger than one command */
+		uint32_t startblk = batch[0]->startblk;
+		uint8_t *buffer = batch[0]->buffer;
+		uint32_t n = batch[0]->n;
+		uint16_t blocks;
+
+		while (n) {
+			blocks = (n > 0xffff) ? 0xffff : (uint16_t)n;
+			sg[0].buff = buffer;
+			sg[0].len = blocks * lunp->info.blk_size;
+			lunp->stats.transactions++;
+			if (scsi_rw10_sg(lunp, write, startblk, blocks, sg, 1, NULL) != MSD_RESULT_OK) {
+				goto done;
+			}
+			n -= blocks;
+			startblk += blocks;
+			buffer += blocks * lunp->info.blk_size;
+		}
+	} else {
+		total = 0;
+		for (i = 0; i < count; i++) {
+			sg[i].buff = batch[i]->buffer;
+			sg[i].len = batch[i]->n * lunp->info.blk_size;
+			total += batch[i]->n;
+		}
+		uclassdrvinfof("Merged %d requests, %u blocks", count, total);
+		lunp->stats.transactions++;
+		lunp->stats.coalesced += count - 1;
+		if (scsi_rw10_sg(lunp, write, batch[0]->startblk, (uint16_t)total, sg, count, NULL) != MSD_RESULT_OK) {
+			goto done;
+		}
+	}
+
+	ret = HAL_SUCCESS;
+
+done:
+	lunp->state = BLK_READY;
+	chSemSignal(&lunp->sem);
+
+complete:
+	lunp->stats.requests += count;
+	for (i = 0; i < count; i++) {
+		_async_complete(batch[i], ret);
+	}
+
+#if HAL_USBHMSD_READAHEAD_SIZE > 0
+	/* prefetch only when the bus would otherwise be idle */
+	if (!write && (ret == HAL_SUCCESS) && sequential && (_async.head == NULL)) {
+		_async_readahead(lunp);
+	}
+#else
+	(void)sequential;
+#endif
+}
+
+static THD_FUNCTION(_async_thread, arg) {
+	usbhmsd_request_t *batch[HAL_USBHMSD_ASYNC_MAX_COALESCE];
+	uint8_t count;
+	(void)arg;
+
+	chRegSetThreadName("USBHMSD");
+
+	for (;;) {
+		count = _async_dequeue(batch);
+		_async_execute(batch, count);
+	}
+}
+
+/* Called by usbhStart(), the class driver init runs from halInit() before
+ * the kernel is initialized and cannot create the worker. */
+void _usbhmsd_async_start(void) {
+	if (_async.thread == NULL) {
+		_async.thread = chThdCreateStatic(_async_wa, sizeof(_async_wa),
+				HAL_USBHMSD_ASYNC_THREAD_PRIO, _async_thread, NULL);
+	}
+}
+
+/**
+ * @brief   Queues an asynchronous read.
+ * @note    The callback, if any, is invoked from the worker thread after
+ *          @p req->status has been set; it must not issue synchronous
+ *          block operations. A request with a callback must stay valid
+ *          until the callback returns.
+ * @note    If the LUN is not ready or the host has not been started the
+ *          request fails immediately, the callback is then invoked from
+ *          the caller's context.
+ */
+void usbhmsdLUNSubmitRead(USBHMassStorageLUNDriver *lunp, usbhmsd_request_t *req,
+		uint32_t startblk, uint8_t *buffer, uint32_t n,
+		usbhmsd_callback_t callback, void *user) {
+	_async_submit(lunp, req, startblk, buffer, n, false, callback, user);
+}
+
+/**
+ * @brief   Queues an asynchronous write.
+ * @note    Writes to adjacent blocks queued back to back are merged into a
+ *          single WRITE(10) command.
+ */
+void usbhmsdLUNSubmitWrite(USBHMassStorageLUNDriver *lunp, usbhmsd_request_t *req,
+		uint32_t startblk, const uint8_t *buffer, uint32_t n,
+		usbhmsd_callback_t callback, void *user) {
+	_async_submit(lunp, req, startblk, (uint8_t *)buffer, n, true, callback, user);
+}
+
+/**
+ * @brief   Waits for the completion of a queued request.
+ *
+ * @return  HAL_SUCCESS if the request completed successfully.
+ */
+bool usbhmsdRequestWait(usbhmsd_request_t *req) {
+	osalDbgCheck(req != NULL);
+
+	osalSysLock();
+	if (req->status == USBHMSD_REQSTATUS_PENDING) {
+		osalThreadSuspendS(&req->waitingThread);
+	}
+	osalSysUnlock();
+
+	return (req->status == USBHMSD_REQSTATUS_OK) ? HAL_SUCCESS : HAL_FAILED;
+}
+
+void usbhmsdLUNGetStats(USBHMassStorageLUNDriver *lunp, usbhmsd_stats_t *stats) {
+	osalDbgCheck((lunp != NULL) && (stats != NULL));
+
+	osalSysLock();
+	*stats = lunp->stats;
+	osalSysUnlock();
+}
+#endif
+
 static void _msd_object_init(USBHMassStorageDriver *msdp) {
 	osalDbgCheck(msdp != NULL);
 	memset(msdp, 0, sizeof(*msdp));
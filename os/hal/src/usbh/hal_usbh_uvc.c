@@ -196,10 +196,12 @@ static void _post(USBHUVCDriver *uvcdp, usbh_urb_t *urb, memory_pool_t *mp, uint
 				uurberr("UVC: error, mailbox overrun");
 			}
 			/* couldn't post the message, free the newly allocated buffer */
-			chPoolFreeI(&uvcdp->mp_status, new_msg);
+			chPoolFreeI(mp, new_msg);
+			uvcdp->stats.overruns++;
 		}
 	} else {
 		uurberrf("UVC: error, %s pool overrun", mp == &uvcdp->mp_data ? "data" : "status");
+		uvcdp->stats.overruns++;
 	}
 }
 
@@ -230,6 +232,121 @@ static void _cb_int(usbh_urb_t *urb) {
 	usbhURBSubmitI(urb);
 }
 
+#if HAL_USBHUVC_USE_FRAME_ASSEMBLY
+/* frame assembly states */
+#define _FA_SYNC	0	/* just started, the current frame may be partial */
+#define _FA_RECV	1	/* assembling uvcdp->frame */
+#define _FA_SKIP	2	/* discarding until the next FID toggle */
+
+/* Frames are busy from the allocation until they are given back by the
+ * application, or by the driver when dropped or purged from the mailbox. */
+static void _frame_freeI(USBHUVCDriver *uvcdp, usbhuvc_frame_t *frame) {
+	frame->busy = 0;
+	chPoolFreeI(&uvcdp->mp_frames, frame);
+}
+
+static void _frame_dropI(USBHUVCDriver *uvcdp) {
+	_frame_freeI(uvcdp, uvcdp->frame);
+	uvcdp->frame = NULL;
+	uvcdp->fa_state = _FA_SKIP;
+	uvcdp->stats.dropped++;
+}
+
+static void _frame_deliverI(USBHUVCDriver *uvcdp) {
+	usbhuvc_frame_t *const frame = uvcdp->frame;
+	uvcdp->frame = NULL;
+	uvcdp->fa_state = _FA_SKIP;
+
+	if (frame->len == 0) {
+		/* header-only payloads, nothing to deliver */
+		_frame_freeI(uvcdp, frame);
+		return;
+	}
+
+	frame->type = USBHUVC_MESSAGETYPE_FRAME;
+	frame->length = 0;
+	if (chMBPostI(&uvcdp->mb, (msg_t)frame) != MSG_OK) {
+		uurberr("UVC: error, mailbox overrun");
+		_frame_freeI(uvcdp, frame);
+		uvcdp->stats.overruns++;
+		return;
+	}
+	uvcdp->stats.frames++;
+
+	/* frame rate, averaged over windows of about one second */
+	uvcdp->fps_count++;
+	const sysinterval_t elapsed = chTimeDiffX(uvcdp->fps_start, osalOsGetSystemTimeX());
+	if (elapsed >= OSAL_MS2I(1000)) {
+		uvcdp->stats.fps = (uvcdp->fps_count * OSAL_MS2I(1000) + elapsed / 2) / elapsed;
+		uvcdp->fps_start += elapsed;
+		uvcdp->fps_count = 0;
+	}
+}
+
+/* Runs in the ISO callback: the copy is bounded by the packet buffer, one
+ * wMaxPacketSize payload per service interval. */
+static void _frame_payloadI(USBHUVCDriver *uvcdp, const uint8_t *buff, uint32_t len) {
+	const uint8_t hdr = buff[0];
+	const uint8_t info = buff[1];
+	const uint8_t fid = info & UVC_HDR_FID;
+	usbhuvc_frame_t *frame;
+
+	if (fid != uvcdp->fid) {
+		uvcdp->fid = fid;
+
+		/* a frame still open missed its EOF; the FID toggle ends it as well */
+		if (uvcdp->fa_state == _FA_RECV)
+			_frame_deliverI(uvcdp);
+
+		if (uvcdp->fa_state == _FA_SYNC) {
+			/* the stream may have been joined in the middle of a frame */
+			uvcdp->fa_state = _FA_SKIP;
+		} else {
+			frame = (usbhuvc_frame_t *)chPoolAllocI(&uvcdp->mp_frames);
+			if (frame == NULL) {
+				uurberr("UVC: error, frame pool overrun");
+				uvcdp->stats.overruns++;
+				uvcdp->sequence++;
+			} else {
+				frame->timestamp = osalOsGetSystemTimeX();
+				frame->sequence = uvcdp->sequence++;
+				frame->len = 0;
+				frame->flags = 0;
+				frame->busy = 1;
+				uvcdp->frame = frame;
+				uvcdp->fa_state = _FA_RECV;
+			}
+		}
+	}
+
+	if (uvcdp->fa_state != _FA_RECV)
+		return;
+
+	frame = uvcdp->frame;
+	frame->flags |= info;
+	if ((info & UVC_HDR_PT) && (hdr >= 6))
+		frame->pts = buff[2] | (buff[3] << 8) | (buff[4] << 16) | ((uint32_t)buff[5] << 24);
+
+	if (info & UVC_HDR_ERR) {
+		uurbwarn("UVC: frame error, dropped");
+		_frame_dropI(uvcdp);
+		return;
+	}
+
+	len -= hdr;
+	if (len > frame->size - frame->len) {
+		uurbwarn("UVC: frame buffer overflow, dropped");
+		_frame_dropI(uvcdp);
+		return;
+	}
+	memcpy(frame->buff + frame->len, buff + hdr, len);
+	frame->len += len;
+
+	if (info & UVC_HDR_EOF)
+		_frame_deliverI(uvcdp);
+}
+#endif
+
 static void _cb_iso(usbh_urb_t *urb) {
 	USBHUVCDriver *uvcdp = (USBHUVCDriver *)urb->userData;
 
@@ -241,6 +358,11 @@ static void _cb_iso(usbh_urb_t *urb) {
 
 	if (urb->status != USBH_URBSTATUS_OK) {
 		uurberrf("UVC: ISO IN error, unexpected status = %d", urb->status);
+#if HAL_USBHUVC_USE_FRAME_ASSEMBLY
+		/* a payload was lost, the frame is incomplete */
+		if (uvcdp->fa_state == _FA_RECV)
+			_frame_dropI(uvcdp);
+#endif
 	} else if (urb->actualLength >= 2) {
 		const uint8_t *const buff = (const uint8_t *)urb->buff;
 		if (buff[0] < 2) {
@@ -256,6 +378,12 @@ static void _cb_iso(usbh_urb_t *urb) {
 						buff[1] & UVC_HDR_ERR,
 						buff[1] & UVC_HDR_EOH);
 
+			uvcdp->stats.packets++;
+#if HAL_USBHUVC_USE_FRAME_ASSEMBLY
+			if (uvcdp->frames_count) {
+				_frame_payloadI(uvcdp, buff, urb->actualLength);
+			} else
+#endif
 			if ((urb->actualLength > buff[0])
 					|| (buff[1] & (UVC_HDR_EOF | UVC_HDR_ERR))) {
 				_post(uvcdp, urb, &uvcdp->mp_data, USBHUVC_MESSAGETYPE_DATA);
@@ -304,6 +432,42 @@ bool usbhuvcStreamStart(USBHUVCDriver *uvcdp, uint16_t min_ep_sz) {
 	if (_set_vs_alternate(uvcdp, min_ep_sz) != HAL_SUCCESS)
 		goto exit;
 
+#if HAL_USBHUVC_USE_FRAME_ASSEMBLY
+	if (uvcdp->frames_count) {
+		//payloads are copied to the frame ring, a single packet buffer is enough
+		uvcdp->mp_data_buffer = chHeapAlloc(NULL, uvcdp->ep_iso.wMaxPacketSize);
+		if (uvcdp->mp_data_buffer == NULL) {
+			uclassdrverr("Couldn't reserve RAM");
+			goto failed;
+		}
+
+		//rebuild the frame ring, the frames still held by the application
+		//join it when they are freed
+		osalSysLock();
+		chPoolObjectInit(&uvcdp->mp_frames, sizeof(usbhuvc_frame_t), NULL);
+		for (datapackets = 0; datapackets < uvcdp->frames_count; datapackets++) {
+			if (!uvcdp->frames[datapackets].busy)
+				chPoolFreeI(&uvcdp->mp_frames, &uvcdp->frames[datapackets]);
+		}
+		osalSysUnlock();
+		uvcdp->frame = NULL;
+		uvcdp->fid = 0xff;
+		uvcdp->fa_state = _FA_SYNC;
+		uvcdp->sequence = 0;
+		uvcdp->fps_start = osalOsGetSystemTimeX();
+		uvcdp->fps_count = 0;
+		chMBResumeX(&uvcdp->mb);
+
+		usbhEPOpen(&uvcdp->ep_iso);
+		usbhURBObjectInit(&uvcdp->urb_iso, &uvcdp->ep_iso, _cb_iso, uvcdp,
+				uvcdp->mp_data_buffer, uvcdp->ep_iso.wMaxPacketSize);
+		usbhURBSubmit(&uvcdp->urb_iso);
+
+		ret = HAL_SUCCESS;
+		goto exit;
+	}
+#endif
+
 	//reserve working RAM
 	data_sz = (uvcdp->ep_iso.wMaxPacketSize + sizeof(usbhuvc_message_data_t) + 3) & ~3;
 	datapackets = HAL_USBHUVC_WORK_RAM_SIZE / data_sz;
@@ -350,8 +514,10 @@ bool usbhuvcStreamStart(USBHUVCDriver *uvcdp, uint16_t min_ep_sz) {
 
 failed:
 	_set_vs_alternate(uvcdp, 0);
-	if (uvcdp->mp_data_buffer)
+	if (uvcdp->mp_data_buffer) {
 		chHeapFree(uvcdp->mp_data_buffer);
+		uvcdp->mp_data_buffer = 0;
+	}
 
 exit:
 	osalSysLock();
@@ -376,8 +542,26 @@ bool usbhuvcStreamStop(USBHUVCDriver *uvcdp) {
 	//close the ISO endpoint
 	usbhEPCloseS(&uvcdp->ep_iso);
 
-	//purge the mailbox
+	//purge the mailbox; the data messages are in the working memory, freed
+	//below, the others go back to their pool
+	msg_t msg;
+	while (chMBFetchI(&uvcdp->mb, &msg) == MSG_OK) {
+		usbhuvc_message_base_t *const base = (usbhuvc_message_base_t *)msg;
+		if (base->type == USBHUVC_MESSAGETYPE_STATUS)
+			chPoolFreeI(&uvcdp->mp_status, base);
+#if HAL_USBHUVC_USE_FRAME_ASSEMBLY
+		else if (base->type == USBHUVC_MESSAGETYPE_FRAME)
+			((usbhuvc_frame_t *)base)->busy = 0;
+#endif
+	}
 	chMBResetI(&uvcdp->mb);		//TODO: the status messages are lost!!
+#if HAL_USBHUVC_USE_FRAME_ASSEMBLY
+	//the frame being assembled as well
+	if (uvcdp->frame != NULL) {
+		uvcdp->frame->busy = 0;
+		uvcdp->frame = NULL;
+	}
+#endif
 	chMtxLockS(&uvcdp->mtx);
 	osalSysUnlock();
 
@@ -395,6 +579,56 @@ bool usbhuvcStreamStop(USBHUVCDriver *uvcdp) {
 	return HAL_SUCCESS;
 }
 
+#if HAL_USBHUVC_USE_FRAME_ASSEMBLY
+bool usbhuvcSetFrameBuffers(USBHUVCDriver *uvcdp, usbhuvc_frame_t *frames,
+		uint32_t count, uint8_t *buff, uint32_t frame_sz) {
+	uint32_t i;
+
+	osalDbgCheck(uvcdp && ((count == 0) || (frames && buff && frame_sz)));
+
+	osalSysLock();
+	if ((uvcdp->state == USBHUVC_STATE_STREAMING)
+			|| (uvcdp->state == USBHUVC_STATE_BUSY)) {
+		osalSysUnlock();
+		return HAL_FAILED;
+	}
+	osalSysUnlock();
+
+	for (i = 0; i < count; i++) {
+		frames[i].buff = buff;
+		frames[i].size = frame_sz;
+		frames[i].busy = 0;
+		buff += frame_sz;
+	}
+	chPoolObjectInit(&uvcdp->mp_frames, sizeof(usbhuvc_frame_t), NULL);
+	uvcdp->frames = frames;
+	uvcdp->frames_count = count;
+	return HAL_SUCCESS;
+}
+
+void usbhuvcFreeFrame(USBHUVCDriver *uvcdp, usbhuvc_frame_t *frame) {
+	osalSysLock();
+	/* frames of a previous ring or already given back are ignored; a frame
+	 * freed while the stream is stopped is kept by the next start */
+	if ((frame >= uvcdp->frames) && (frame < uvcdp->frames + uvcdp->frames_count)
+			&& frame->busy)
+		_frame_freeI(uvcdp, frame);
+	osalSysUnlock();
+}
+#endif
+
+void usbhuvcGetStats(USBHUVCDriver *uvcdp, usbhuvc_stats_t *stats) {
+	osalSysLock();
+	*stats = uvcdp->stats;
+	osalSysUnlock();
+}
+
+void usbhuvcResetStats(USBHUVCDriver *uvcdp) {
+	osalSysLock();
+	memset(&uvcdp->stats, 0, sizeof(uvcdp->stats));
+	osalSysUnlock();
+}
+
 bool usbhuvcFindVSDescriptor(USBHUVCDriver *uvcdp,
 		generic_iterator_t *ics,
 		uint8_t bDescriptorSubtype,
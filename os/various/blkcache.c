@@ -0,0 +1,555 @@
+/*
+    ChibiOS - Copyright (C) 2006..2018 Giovanni Di Sirio
+
+    Licensed under the Apache License, Version 2.0 (the "License");
+    you may not use this file except in compliance with the License.
+    You may obtain a copy of the License at
+
+        http://www.apache.org/licenses/LICENSE-2.0
+
+    Unless required by applicable law or agreed to in writing, software
+    distributed under the License is distributed on an "AS IS" BASIS,
+    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+    See the License for the specific language governing permissions and
+    limitations under the License.
+*/
+
+/**
+ * @file    blkcache.c
+ * @brief   Block cache layer for block devices source.
+ * @details The cache wraps any @p BaseBlockDevice (MMC, SDC, USBH MSD LUNs,
+ *          RAM disks) and exposes itself as a @p BaseBlockDevice. Lines are
+ *          replaced in LRU order, writes are held in the cache until the
+ *          line is evicted or the cache is synchronized. Misses on a
+ *          sequential access pattern fetch the following blocks in the same
+ *          device operation. Transfers larger than half the cache bypass it.
+ * @note    The cache is not reentrant, the caller must serialize accesses
+ *          as FatFs does for each volume.
+ *
+ * @addtogroup blkcache
+ * @{
+ */
+
+#include "hal.h"
+
+#include "blkcache.h"
+
+#include <string.h>
+
+/*===========================================================================*/
+/* Driver local definitions.                                                 */
+/*===========================================================================*/
+
+/*===========================================================================*/
+/* Driver exported variables.                                                */
+/*===========================================================================*/
+
+/*===========================================================================*/
+/* Driver local variables.                                                   */
+/*===========================================================================*/
+
+/*===========================================================================*/
+/* Driver local functions.                                                   */
+/*===========================================================================*/
+
+/*
+ * Lines are packed at the device block size, not at the configured line
+ * size, so that adjacent lines form the contiguous buffer of a multi-block
+ * device operation.
+ */
+static uint8_t *line_data(const BlockCache *bcp, uint32_t i) {
+
+  return &bcp->config->buffer[i * bcp->info.blk_size];
+}
+
+static void line_touch(BlockCache *bcp, uint32_t i) {
+  blkcache_line_t *lines = bcp->config->lines;
+  uint32_t j;
+
+  if (++bcp->stamp == 0U) {
+    /* Stamp wrapped, collapsing the history of valid lines.*/
+    for (j = 0; j < bcp->config->nlines; j++) {
+      if (lines[j].stamp != 0U) {
+        lines[j].stamp = 1U;
+      }
+    }
+    bcp->stamp = 2U;
+  }
+  lines[i].stamp = bcp->stamp;
+}
+
+static uint32_t line_find(const BlockCache *bcp, uint32_t blk) {
+  const blkcache_line_t *lines = bcp->config->lines;
+  uint32_t i;
+
+  for (i = 0; i < bcp->config->nlines; i++) {
+    if ((lines[i].stamp != 0U) && (lines[i].blk == blk)) {
+      return i;
+    }
+  }
+  return BLKCACHE_NO_LINE;
+}
+
+static void lines_invalidate(BlockCache *bcp) {
+  uint32_t i;
+
+  for (i = 0; i < bcp->config->nlines; i++) {
+    bcp->config->lines[i].stamp = 0U;
+    bcp->config->lines[i].dirty = false;
+  }
+  bcp->stamp = 0U;
+  bcp->next_blk = 0U;
+}
+
+/*
+ * Writes back @p n lines starting from @p i, the lines must be dirty and
+ * must hold consecutive blocks.
+ */
+static bool lines_write_back(BlockCache *bcp, uint32_t i, uint32_t n) {
+  uint32_t k;
+
+  cacheBufferFlush(line_data(bcp, i), n * bcp->info.blk_size);
+  bcp->stats.dev_writes++;
+  if (blkWrite(bcp->config->dev, bcp->config->lines[i].blk,
+               line_data(bcp, i), n)) {
+    return HAL_FAILED;
+  }
+  for (k = 0; k < n; k++) {
+    bcp->config->lines[i + k].dirty = false;
+  }
+  return HAL_SUCCESS;
+}
+
+/*
+ * Selects the window of @p n adjacent lines having the oldest most recent
+ * use, for n == 1 this is plain LRU replacement.
+ */
+static uint32_t window_select(const BlockCache *bcp, uint32_t n) {
+  const blkcache_line_t *lines = bcp->config->lines;
+  uint32_t i, k, best = 0U, best_stamp = 0xFFFFFFFFU;
+
+  for (i = 0; i + n <= bcp->config->nlines; i++) {
+    uint32_t newest = 0U;
+    for (k = 0; k < n; k++) {
+      if (lines[i + k].stamp > newest) {
+        newest = lines[i + k].stamp;
+      }
+    }
+    if (newest < best_stamp) {
+      best_stamp = newest;
+      best = i;
+      if (newest == 0U) {
+        break;
+      }
+    }
+  }
+  return best;
+}
+
+/*
+ * Frees the window of @p n lines starting from @p i writing back the dirty
+ * ones, consecutive dirty blocks are written in a single operation.
+ */
+static bool window_evict(BlockCache *bcp, uint32_t i, uint32_t n) {
+  blkcache_line_t *lines = bcp->config->lines;
+  uint32_t end = i + n;
+
+  while (i < end) {
+    uint32_t run = 1U;
+
+    if (!lines[i].dirty) {
+      lines[i].stamp = 0U;
+      i++;
+      continue;
+    }
+    while ((i + run < end) && lines[i + run].dirty &&
+           (lines[i + run].blk == lines[i].blk + run)) {
+      run++;
+    }
+    if (lines_write_back(bcp, i, run)) {
+      return HAL_FAILED;
+    }
+    while (run > 0U) {
+      lines[i++].stamp = 0U;
+      run--;
+    }
+  }
+  return HAL_SUCCESS;
+}
+
+/*
+ * Reads @p n blocks into a window of adjacent lines with a single device
+ * operation, returns the first line of the window.
+ */
+static uint32_t window_fill(BlockCache *bcp, uint32_t startblk, uint32_t n) {
+  blkcache_line_t *lines = bcp->config->lines;
+  uint32_t i, k;
+
+  i = window_select(bcp, n);
+  if (window_evict(bcp, i, n)) {
+    return BLKCACHE_NO_LINE;
+  }
+  bcp->stats.dev_reads++;
+  if (blkRead(bcp->config->dev, startblk, line_data(bcp, i), n)) {
+    return BLKCACHE_NO_LINE;
+  }
+  for (k = 0; k < n; k++) {
+    lines[i + k].blk = startblk + k;
+    lines[i + k].dirty = false;
+    line_touch(bcp, i + k);
+  }
+  return i;
+}
+
+/*
+ * Counts the blocks from @p startblk that are not in the cache, up to @p n.
+ */
+static uint32_t miss_run(const BlockCache *bcp, uint32_t startblk,
+                         uint32_t n) {
+  uint32_t run = 1U;
+
+  while ((run < n) && (line_find(bcp, startblk + run) == BLKCACHE_NO_LINE)) {
+    run++;
+  }
+  return run;
+}
+
+/*
+ * Checks that the underlying device is still ready, the cache contents are
+ * dropped if the media went away.
+ */
+static bool device_check(BlockCache *bcp) {
+
+  if (BLK_READY != bcp->state) {
+    return HAL_FAILED;
+  }
+  if (BLK_READY != blkGetDriverState(bcp->config->dev)) {
+    lines_invalidate(bcp);
+    bcp->state = BLK_ACTIVE;
+    return HAL_FAILED;
+  }
+  return HAL_SUCCESS;
+}
+
+/*
+ * Interface implementation.
+ */
+static bool is_inserted(void *instance) {
+  BlockCache *bcp = instance;
+  return blkIsInserted(bcp->config->dev);
+}
+
+static bool is_protected(void *instance) {
+  BlockCache *bcp = instance;
+  return blkIsWriteProtected(bcp->config->dev);
+}
+
+static bool connect(void *instance) {
+  BlockCache *bcp = instance;
+  BaseBlockDevice *dev = bcp->config->dev;
+
+  if (BLK_READY == bcp->state) {
+    return HAL_SUCCESS;
+  }
+
+  /* Devices already connected externally are not connected again.*/
+  if ((BLK_READY != blkGetDriverState(dev)) && blkConnect(dev)) {
+    return HAL_FAILED;
+  }
+  if (blkGetInfo(dev, &bcp->info) ||
+      (bcp->info.blk_size > bcp->config->line_size)) {
+    return HAL_FAILED;
+  }
+  lines_invalidate(bcp);
+  bcp->state = BLK_READY;
+  return HAL_SUCCESS;
+}
+
+static bool disconnect(void *instance) {
+  BlockCache *bcp = instance;
+  bool err = HAL_SUCCESS;
+
+  if (BLK_READY == bcp->state) {
+    err = blkcacheFlush(bcp);
+    lines_invalidate(bcp);
+    bcp->state = BLK_ACTIVE;
+  }
+  if (blkDisconnect(bcp->config->dev)) {
+    err = HAL_FAILED;
+  }
+  return err;
+}
+
+static bool read(void *instance, uint32_t startblk,
+                 uint8_t *buffer, uint32_t n) {
+  BlockCache *bcp = instance;
+  const uint32_t bs = bcp->info.blk_size;
+  bool sequential;
+
+  if (device_check(bcp) || (startblk + n > bcp->info.blk_num)) {
+    return HAL_FAILED;
+  }
+
+  sequential = (startblk == bcp->next_blk) || (n > 1U);
+  bcp->next_blk = startblk + n;
+
+  while (n > 0U) {
+    uint32_t i = line_find(bcp, startblk);
+    uint32_t run;
+
+    if (i != BLKCACHE_NO_LINE) {
+      memcpy(buffer, line_data(bcp, i), bs);
+      line_touch(bcp, i);
+      bcp->stats.hits++;
+      run = 1U;
+    }
+    else {
+      run = miss_run(bcp, startblk, n);
+      bcp->stats.misses += run;
+      if (run > bcp->config->nlines / 2U) {
+        /* Large transfer, bypassing the cache in order to not flush it.*/
+        bcp->stats.dev_reads++;
+        if (blkRead(bcp->config->dev, startblk, buffer, run)) {
+          return HAL_FAILED;
+        }
+      }
+      else {
+        uint32_t total = run;
+
+        if (sequential) {
+          uint32_t limit = run + bcp->config->readahead;
+          if (limit > bcp->config->nlines) {
+            limit = bcp->config->nlines;
+          }
+          while ((total < limit) &&
+                 (startblk + total < bcp->info.blk_num) &&
+                 (line_find(bcp, startblk + total) == BLKCACHE_NO_LINE)) {
+            total++;
+          }
+        }
+        i = window_fill(bcp, startblk, total);
+        if (i == BLKCACHE_NO_LINE) {
+          return HAL_FAILED;
+        }
+        bcp->stats.readahead += total - run;
+        memcpy(buffer, line_data(bcp, i), run * bs);
+      }
+    }
+    startblk += run;
+    buffer   += run * bs;
+    n        -= run;
+  }
+  return HAL_SUCCESS;
+}
+
+static bool write(void *instance, uint32_t startblk,
+                  const uint8_t *buffer, uint32_t n) {
+  BlockCache *bcp = instance;
+  blkcache_line_t *lines = bcp->config->lines;
+  const uint32_t bs = bcp->info.blk_size;
+
+  if (device_check(bcp) || (startblk + n > bcp->info.blk_num)) {
+    return HAL_FAILED;
+  }
+
+  while (n > 0U) {
+    uint32_t i = line_find(bcp, startblk);
+    uint32_t run = 1U;
+
+    if (i != BLKCACHE_NO_LINE) {
+      bcp->stats.hits++;
+    }
+    else {
+      run = miss_run(bcp, startblk, n);
+      bcp->stats.misses += run;
+      if (run > bcp->config->nlines / 2U) {
+        /* Large transfer, written through without allocating lines.*/
+        cacheBufferFlush(buffer, run * bs);
+        bcp->stats.dev_writes++;
+        if (blkWrite(bcp->config->dev, startblk, buffer, run)) {
+          return HAL_FAILED;
+        }
+        startblk += run;
+        buffer   += run * bs;
+        n        -= run;
+        continue;
+      }
+      run = 1U;
+      i = window_select(bcp, 1U);
+      if (window_evict(bcp, i, 1U)) {
+        return HAL_FAILED;
+      }
+      lines[i].blk = startblk;
+    }
+    memcpy(line_data(bcp, i), buffer, bs);
+    lines[i].dirty = true;
+    line_touch(bcp, i);
+    startblk += run;
+    buffer   += bs;
+    n        -= run;
+  }
+  return HAL_SUCCESS;
+}
+
+static bool sync(void *instance) {
+  BlockCache *bcp = instance;
+
+  if (device_check(bcp) || blkcacheFlush(bcp)) {
+    return HAL_FAILED;
+  }
+  return blkSync(bcp->config->dev);
+}
+
+static bool get_info(void *instance, BlockDeviceInfo *bdip) {
+  BlockCache *bcp = instance;
+
+  if (BLK_READY != bcp->state) {
+    return HAL_FAILED;
+  }
+  *bdip = bcp->info;
+  return HAL_SUCCESS;
+}
+
+/**
+ *
+ */
+static const struct BaseBlockDeviceVMT vmt = {
+    (size_t)0,
+    is_inserted,
+    is_protected,
+    connect,
+    disconnect,
+    read,
+    write,
+    sync,
+    get_info
+};
+
+/*===========================================================================*/
+/* Driver interrupt handlers.                                                */
+/*===========================================================================*/
+
+/*===========================================================================*/
+/* Driver exported functions.                                                */
+/*===========================================================================*/
+
+/**
+ * @brief   Block cache object initialization.
+ *
+ * @param[in] bcp       pointer to @p BlockCache object
+ *
+ * @init
+ */
+void blkcacheObjectInit(BlockCache *bcp) {
+
+  bcp->vmt    = &vmt;
+  bcp->state  = BLK_STOP;
+  bcp->config = NULL;
+}
+
+/**
+ * @brief   Starts the block cache.
+ * @details The cache becomes usable after a successful @p blkConnect(), the
+ *          underlying device is connected only if it is not already ready.
+ *
+ * @param[in] bcp       pointer to @p BlockCache object
+ * @param[in] config    pointer to the @p BlockCacheConfig object
+ *
+ * @api
+ */
+void blkcacheStart(BlockCache *bcp, const BlockCacheConfig *config) {
+
+  osalDbgCheck((bcp != NULL) && (config != NULL) && (config->dev != NULL) &&
+               (config->lines != NULL) && (config->buffer != NULL) &&
+               (config->nlines > 0U));
+  osalDbgAssert((bcp->state == BLK_STOP) || (bcp->state == BLK_ACTIVE),
+                "invalid state");
+
+  bcp->config = config;
+  memset(&bcp->stats, 0, sizeof(bcp->stats));
+  lines_invalidate(bcp);
+  bcp->state = BLK_ACTIVE;
+}
+
+/**
+ * @brief   Stops the block cache.
+ * @note    Dirty lines are discarded, use @p blkSync() or
+ *          @p blkDisconnect() before stopping.
+ *
+ * @param[in] bcp       pointer to @p BlockCache object
+ *
+ * @api
+ */
+void blkcacheStop(BlockCache *bcp) {
+
+  osalDbgCheck(bcp != NULL);
+  osalDbgAssert((bcp->state == BLK_STOP) || (bcp->state == BLK_ACTIVE) ||
+                (bcp->state == BLK_READY), "invalid state");
+
+  bcp->config = NULL;
+  bcp->state  = BLK_STOP;
+}
+
+/**
+ * @brief   Writes back all the dirty lines.
+ * @details Lines are written in ascending block order, dirty lines holding
+ *          consecutive blocks in adjacent lines are written together.
+ *
+ * @param[in] bcp       pointer to @p BlockCache object
+ * @return              The operation status.
+ * @retval HAL_SUCCESS  operation succeeded.
+ * @retval HAL_FAILED   a device write failed, the lines not yet written
+ *                      remain dirty.
+ *
+ * @api
+ */
+bool blkcacheFlush(BlockCache *bcp) {
+  blkcache_line_t *lines;
+
+  osalDbgCheck(bcp != NULL);
+
+  if (BLK_READY != bcp->state) {
+    return HAL_SUCCESS;
+  }
+
+  lines = bcp->config->lines;
+  while (true) {
+    uint32_t i, first = BLKCACHE_NO_LINE, run = 1U;
+
+    for (i = 0; i < bcp->config->nlines; i++) {
+      if (lines[i].dirty &&
+          ((first == BLKCACHE_NO_LINE) || (lines[i].blk < lines[first].blk))) {
+        first = i;
+      }
+    }
+    if (first == BLKCACHE_NO_LINE) {
+      return HAL_SUCCESS;
+    }
+    while ((first + run < bcp->config->nlines) && lines[first + run].dirty &&
+           (lines[first + run].blk == lines[first].blk + run)) {
+      run++;
+    }
+    if (lines_write_back(bcp, first, run)) {
+      return HAL_FAILED;
+    }
+  }
+}
+
+/**
+ * @brief   Drops the cache contents, dirty lines included.
+ * @note    To be used when the media has been replaced.
+ *
+ * @param[in] bcp       pointer to @p BlockCache object
+ *
+ * @api
+ */
+void blkcacheInvalidate(BlockCache *bcp) {
+
+  osalDbgCheck(bcp != NULL);
+
+  if (bcp->config != NULL) {
+    lines_invalidate(bcp);
+  }
+}
+
+/** @} */
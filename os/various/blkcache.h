@@ -0,0 +1,165 @@
+/*
+    ChibiOS - Copyright (C) 2006..2018 Giovanni Di Sirio
+
+    Licensed under the Apache License, Version 2.0 (the "License");
+    you may not use this file except in compliance with the License.
+    You may obtain a copy of the License at
+
+        http://www.apache.org/licenses/LICENSE-2.0
+
+    Unless required by applicable law or agreed to in writing, software
+    distributed under the License is distributed on an "AS IS" BASIS,
+    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+    See the License for the specific language governing permissions and
+    limitations under the License.
+*/
+
+/**
+ * @file    blkcache.h
+ * @brief   Block cache layer for block devices header.
+ *
+ * @addtogroup blkcache
+ * @{
+ */
+
+#ifndef BLKCACHE_H_
+#define BLKCACHE_H_
+
+/*===========================================================================*/
+/* Driver constants.                                                         */
+/*===========================================================================*/
+
+/**
+ * @brief   Marker for a lookup that did not find a cache line.
+ */
+#define BLKCACHE_NO_LINE            0xFFFFFFFFU
+
+/*===========================================================================*/
+/* Driver pre-compile time settings.                                         */
+/*===========================================================================*/
+
+/*===========================================================================*/
+/* Derived constants and error checks.                                       */
+/*===========================================================================*/
+
+/*===========================================================================*/
+/* Driver data structures and types.                                         */
+/*===========================================================================*/
+
+/**
+ * @brief   Descriptor of a single cache line.
+ * @note    A line with a zero @p stamp is free.
+ */
+typedef struct {
+  /** @brief Block number held by the line.*/
+  uint32_t      blk;
+  /** @brief LRU stamp, higher is more recently used.*/
+  uint32_t      stamp;
+  /** @brief The line holds data not yet written to the device.*/
+  bool          dirty;
+} blkcache_line_t;
+
+/**
+ * @brief   Block cache statistics.
+ */
+typedef struct {
+  /** @brief Blocks served from the cache.*/
+  uint32_t      hits;
+  /** @brief Blocks not found in the cache.*/
+  uint32_t      misses;
+  /** @brief Blocks fetched ahead of a sequential access.*/
+  uint32_t      readahead;
+  /** @brief Read operations issued to the underlying device.*/
+  uint32_t      dev_reads;
+  /** @brief Write operations issued to the underlying device.*/
+  uint32_t      dev_writes;
+} blkcache_stats_t;
+
+/**
+ * @brief   Block cache configuration.
+ */
+typedef struct {
+  /**
+   * @brief   Underlying block device.
+   */
+  BaseBlockDevice       *dev;
+  /**
+   * @brief   Lines descriptors array, @p nlines elements.
+   */
+  blkcache_line_t       *lines;
+  /**
+   * @brief   Lines data buffer, @p nlines * @p line_size bytes.
+   * @note    Must satisfy the DMA alignment constraints of the device.
+   */
+  uint8_t               *buffer;
+  /**
+   * @brief   Number of lines in the cache.
+   */
+  uint32_t              nlines;
+  /**
+   * @brief   Size of a line, it is the largest supported block size.
+   * @note    Lines are packed at the block size of the connected device,
+   *          with smaller blocks the tail of the buffer is unused.
+   */
+  uint32_t              line_size;
+  /**
+   * @brief   Number of blocks fetched ahead on sequential reads.
+   * @note    Zero disables read-ahead.
+   */
+  uint32_t              readahead;
+} BlockCacheConfig;
+
+typedef struct BlockCache BlockCache;
+
+/**
+ *
+ */
+#define _blkcache_device_data                                               \
+  _base_block_device_data                                                   \
+  const BlockCacheConfig    *config;                                        \
+  BlockDeviceInfo           info;                                           \
+  uint32_t                  stamp;                                          \
+  uint32_t                  next_blk;                                       \
+  blkcache_stats_t          stats;
+
+/**
+ * @brief   Block cache object, it is a block device itself.
+ */
+struct BlockCache {
+  /** @brief Virtual Methods Table.*/
+  const struct BaseBlockDeviceVMT *vmt;
+  _blkcache_device_data
+};
+
+/*===========================================================================*/
+/* Driver macros.                                                            */
+/*===========================================================================*/
+
+/**
+ * @brief   Returns a pointer to the cache statistics.
+ *
+ * @param[in] bcp       pointer to @p BlockCache object
+ *
+ * @api
+ */
+#define blkcacheGetStats(bcp) (&(bcp)->stats)
+
+/*===========================================================================*/
+/* External declarations.                                                    */
+/*===========================================================================*/
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+  void blkcacheObjectInit(BlockCache *bcp);
+  void blkcacheStart(BlockCache *bcp, const BlockCacheConfig *config);
+  void blkcacheStop(BlockCache *bcp);
+  bool blkcacheFlush(BlockCache *bcp);
+  void blkcacheInvalidate(BlockCache *bcp);
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* BLKCACHE_H_ */
+
+/** @} */
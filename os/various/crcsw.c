@@ -26,6 +26,8 @@
 
 #include "hal.h"
 
+#include <string.h>
+
 #if HAL_USE_CRC || defined(__DOXYGEN__)
 
 #if CRCSW_USE_CRC1 || defined(__DOXYGEN__)
@@ -177,15 +179,149 @@ const CRCConfig crcsw_crc16_config = {
 };
 #endif
 
+#if CRCSW_PRESETS || defined(__DOXYGEN__)
+const CRCConfig crcsw_crc8_config = {
+  .poly_size         = 8,
+  .poly              = 0x07,
+  .initial_val       = 0x00,
+  .final_val         = 0x00,
+  .reflect_data      = 0,
+  .reflect_remainder = 0,
+  .table             = NULL
+};
+
+const CRCConfig crcsw_crc8_maxim_config = {
+  .poly_size         = 8,
+  .poly              = 0x31,
+  .initial_val       = 0x00,
+  .final_val         = 0x00,
+  .reflect_data      = 1,
+  .reflect_remainder = 1,
+  .table             = NULL
+};
+
+const CRCConfig crcsw_crc16_arc_config = {
+  .poly_size         = 16,
+  .poly              = 0x8005,
+  .initial_val       = 0x0000,
+  .final_val         = 0x0000,
+  .reflect_data      = 1,
+  .reflect_remainder = 1,
+  .table             = NULL
+};
+
+const CRCConfig crcsw_crc16_ccitt_false_config = {
+  .poly_size         = 16,
+  .poly              = 0x1021,
+  .initial_val       = 0xFFFF,
+  .final_val         = 0x0000,
+  .reflect_data      = 0,
+  .reflect_remainder = 0,
+  .table             = NULL
+};
+
+const CRCConfig crcsw_crc16_kermit_config = {
+  .poly_size         = 16,
+  .poly              = 0x1021,
+  .initial_val       = 0x0000,
+  .final_val         = 0x0000,
+  .reflect_data      = 1,
+  .reflect_remainder = 1,
+  .table             = NULL
+};
+
+const CRCConfig crcsw_crc16_modbus_config = {
+  .poly_size         = 16,
+  .poly              = 0x8005,
+  .initial_val       = 0xFFFF,
+  .final_val         = 0x0000,
+  .reflect_data      = 1,
+  .reflect_remainder = 1,
+  .table             = NULL
+};
+
+const CRCConfig crcsw_crc16_xmodem_config = {
+  .poly_size         = 16,
+  .poly              = 0x1021,
+  .initial_val       = 0x0000,
+  .final_val         = 0x0000,
+  .reflect_data      = 0,
+  .reflect_remainder = 0,
+  .table             = NULL
+};
+
+const CRCConfig crcsw_crc32_ieee_config = {
+  .poly_size         = 32,
+  .poly              = 0x04C11DB7,
+  .initial_val       = 0xFFFFFFFF,
+  .final_val         = 0xFFFFFFFF,
+  .reflect_data      = 1,
+  .reflect_remainder = 1,
+  .table             = NULL
+};
+
+const CRCConfig crcsw_crc32c_config = {
+  .poly_size         = 32,
+  .poly              = 0x1EDC6F41,
+  .initial_val       = 0xFFFFFFFF,
+  .final_val         = 0xFFFFFFFF,
+  .reflect_data      = 1,
+  .reflect_remainder = 1,
+  .table             = NULL
+};
+
+const CRCConfig crcsw_crc32_mpeg2_config = {
+  .poly_size         = 32,
+  .poly              = 0x04C11DB7,
+  .initial_val       = 0xFFFFFFFF,
+  .final_val         = 0x00000000,
+  .reflect_data      = 0,
+  .reflect_remainder = 0,
+  .table             = NULL
+};
+
+/**
+ * @brief   Catalogue of the preset configurations.
+ */
+const CRCSWPreset crcsw_presets[] = {
+  {"CRC-8",              &crcsw_crc8_config,              0x000000F4},
+  {"CRC-8/MAXIM",        &crcsw_crc8_maxim_config,        0x000000A1},
+  {"CRC-16/ARC",         &crcsw_crc16_arc_config,         0x0000BB3D},
+  {"CRC-16/CCITT-FALSE", &crcsw_crc16_ccitt_false_config, 0x000029B1},
+  {"CRC-16/KERMIT",      &crcsw_crc16_kermit_config,      0x00002189},
+  {"CRC-16/MODBUS",      &crcsw_crc16_modbus_config,      0x00004B37},
+  {"CRC-16/XMODEM",      &crcsw_crc16_xmodem_config,      0x000031C3},
+  {"CRC-32",             &crcsw_crc32_ieee_config,        0xCBF43926},
+  {"CRC-32C",            &crcsw_crc32c_config,            0xE3069283},
+  {"CRC-32/MPEG-2",      &crcsw_crc32_mpeg2_config,       0x0376E6E7}
+};
+
+/**
+ * @brief   Number of entries in @p crcsw_presets.
+ */
+const size_t crcsw_presets_count = sizeof(crcsw_presets) / sizeof(crcsw_presets[0]);
+#endif
+
 /*===========================================================================*/
 /* Driver local variables and types.                                         */
 /*===========================================================================*/
 
+#if CRCSW_GENERATED_TABLES || defined(__DOXYGEN__)
+/**
+ * @brief   Table sets shared by the driver instances.
+ */
+static CRCSWTables crcsw_tables[CRCSW_TABLE_SETS];
+
+/**
+ * @brief   Number of table set acquisitions, for the LRU order of the sets.
+ */
+static uint32_t crcsw_tables_uses;
+#endif
+
 /*===========================================================================*/
 /* Driver local functions.                                                   */
 /*===========================================================================*/
 
-#if (CRCSW_PROGRAMMABLE == TRUE)
 static uint32_t reflect(uint32_t data, uint8_t nBits) {
   uint32_t reflection = 0x00000000;
   uint8_t  bit;
@@ -202,8 +338,239 @@ static uint32_t reflect(uint32_t data, uint8_t nBits) {
 
   return reflection;
 }
+
+/**
+ * @brief   Returns the mask covering @p nBits low order bits.
+ */
+static inline uint32_t crc_mask(uint8_t nBits) {
+  uint32_t mask = 1UL << (nBits - 1);
+
+  return mask | (mask - 1);
+}
+
+#if CRCSW_GENERATED_TABLES || defined(__DOXYGEN__)
+/**
+ * @brief   Generates the lookup tables for a configuration.
+ * @details Table 0 is the classic byte-wise table, table k is table 0
+ *          followed by k zero bytes.
+ *          Reflected configurations use LSB first tables, the others use
+ *          MSB first tables with the polynomial left aligned to bit 31.
+ *
+ * @param[in] config    pointer to the @p CRCConfig object
+ * @param[out] table    array of @p CRCSW_SLICE_BY tables of 256 entries
+ *
+ * @notapi
+ */
+static void crc_gen_slice_tables(const CRCConfig *config,
+                                 uint32_t table[CRCSW_SLICE_BY][256]) {
+  uint32_t i, k;
+  uint8_t bit;
+
+  if (config->reflect_data) {
+    uint32_t poly = reflect(config->poly, config->poly_size);
+
+    for (i = 0; i < 256; i++) {
+      uint32_t crc = i;
+      for (bit = 0; bit < 8; bit++) {
+        crc = (crc & 1) ? (crc >> 1) ^ poly : (crc >> 1);
+      }
+      table[0][i] = crc;
+    }
+    for (i = 0; i < 256; i++) {
+      for (k = 1; k < CRCSW_SLICE_BY; k++) {
+        uint32_t crc = table[k - 1][i];
+        table[k][i] = table[0][crc & 0xFF] ^ (crc >> 8);
+      }
+    }
+  }
+  else {
+    uint32_t poly = config->poly << (32 - config->poly_size);
+
+    for (i = 0; i < 256; i++) {
+      uint32_t crc = i << 24;
+      for (bit = 0; bit < 8; bit++) {
+        crc = (crc & 0x80000000) ? (crc << 1) ^ poly : (crc << 1);
+      }
+      table[0][i] = crc;
+    }
+    for (i = 0; i < 256; i++) {
+      for (k = 1; k < CRCSW_SLICE_BY; k++) {
+        uint32_t crc = table[k - 1][i];
+        table[k][i] = table[0][crc >> 24] ^ (crc << 8);
+      }
+    }
+  }
+}
+
+/**
+ * @brief   Releases the table set of a driver.
+ * @note    The set stays valid, it is reused by the next driver with the
+ *          same polynomial unless it is needed for another one.
+ *
+ * @param[in] crcp      pointer to the @p CRCDriver object
+ *
+ * @notapi
+ */
+static void crc_release_tables(CRCDriver *crcp) {
+
+  if (crcp->tables != NULL) {
+    crcp->tables->refs--;
+    crcp->tables = NULL;
+  }
+  crcp->table_config = NULL;
+}
+
+/**
+ * @brief   Acquires the table set of the configuration.
+ * @details A valid set generated for the same polynomial, width and
+ *          @p reflect_data is shared, else the tables are generated in an
+ *          unused set, preferably one that does not hold valid tables,
+ *          then the least recently used one. The generation is done outside the kernel lock.
+ *          Nothing is done when the byte-wise kernel can use the table
+ *          provided by the configuration.
+ *
+ * @param[in] crcp      pointer to the @p CRCDriver object
+ *
+ * @notapi
+ */
+static void crc_prepare_tables(CRCDriver *crcp) {
+  const CRCConfig *config = crcp->config;
+  CRCSWTables *tp = NULL;
+  bool generate = true;
+  syssts_t sts;
+  unsigned i;
+
+  if ((crcp->table_config == config) ||
+      ((CRCSW_SLICE_BY == 1) && (config->table != NULL))) {
+    return;
+  }
+
+  sts = osalSysGetStatusAndLockX();
+  crc_release_tables(crcp);
+  for (i = 0; i < CRCSW_TABLE_SETS; i++) {
+    CRCSWTables *p = &crcsw_tables[i];
+
+    if (p->valid && (p->poly == config->poly) &&
+        (p->poly_size == config->poly_size) &&
+        (p->reflect_data == config->reflect_data)) {
+      tp = p;
+      generate = false;
+      break;
+    }
+    /* Unused sets, the ones without valid tables first, then the least
+       recently used one.*/
+    if ((p->refs == 0U) &&
+        ((tp == NULL) || (tp->valid && !p->valid) ||
+         ((tp->valid == p->valid) && (p->last_use < tp->last_use)))) {
+      tp = p;
+    }
+  }
+  osalDbgAssert(tp != NULL, "no free table set, increase CRCSW_TABLE_SETS");
+  tp->refs++;
+  tp->last_use = ++crcsw_tables_uses;
+  if (generate) {
+    tp->valid        = false;
+    tp->poly         = config->poly;
+    tp->poly_size    = config->poly_size;
+    tp->reflect_data = config->reflect_data;
+  }
+  osalSysRestoreStatusX(sts);
+
+  if (generate) {
+    crc_gen_slice_tables(config, tp->table);
+    sts = osalSysGetStatusAndLockX();
+    tp->valid = true;
+    osalSysRestoreStatusX(sts);
+  }
+  crcp->tables       = tp;
+  crcp->table_config = config;
+}
+
+/**
+ * @brief   Slice-by-N kernel, reflected (LSB first) variant.
+ *
+ * @param[in] table     slice tables
+ * @param[in] crc       current reflected remainder
+ * @param[in] n         size of buf in bytes
+ * @param[in] p         data to process
+ * @return              The updated remainder.
+ *
+ * @notapi
+ */
+static uint32_t crc_slice_reflected(const uint32_t table[CRCSW_SLICE_BY][256],
+                                    uint32_t crc, size_t n, const uint8_t *p) {
+#if CRCSW_SLICE_BY > 1
+  unsigned k;
+
+  while (n >= CRCSW_SLICE_BY) {
+    uint32_t acc = 0;
+    for (k = 0; k < CRCSW_SLICE_BY; k += 4) {
+      uint32_t w = (uint32_t)p[k] | ((uint32_t)p[k + 1] << 8) |
+                   ((uint32_t)p[k + 2] << 16) | ((uint32_t)p[k + 3] << 24);
+      if (k == 0) {
+        w ^= crc;
+      }
+      acc ^= table[CRCSW_SLICE_BY - 1 - k][w & 0xFF] ^
+             table[CRCSW_SLICE_BY - 2 - k][(w >> 8) & 0xFF] ^
+             table[CRCSW_SLICE_BY - 3 - k][(w >> 16) & 0xFF] ^
+             table[CRCSW_SLICE_BY - 4 - k][w >> 24];
+    }
+    crc = acc;
+    p += CRCSW_SLICE_BY;
+    n -= CRCSW_SLICE_BY;
+  }
 #endif
 
+  while (n--) {
+    crc = table[0][(crc ^ *p++) & 0xFF] ^ (crc >> 8);
+  }
+
+  return crc;
+}
+
+/**
+ * @brief   Slice-by-N kernel, MSB first variant.
+ *
+ * @param[in] table     slice tables
+ * @param[in] crc       current remainder, left aligned to bit 31
+ * @param[in] n         size of buf in bytes
+ * @param[in] p         data to process
+ * @return              The updated remainder.
+ *
+ * @notapi
+ */
+static uint32_t crc_slice_normal(const uint32_t table[CRCSW_SLICE_BY][256],
+                                 uint32_t crc, size_t n, const uint8_t *p) {
+#if CRCSW_SLICE_BY > 1
+  unsigned k;
+
+  while (n >= CRCSW_SLICE_BY) {
+    uint32_t acc = 0;
+    for (k = 0; k < CRCSW_SLICE_BY; k += 4) {
+      uint32_t w = ((uint32_t)p[k] << 24) | ((uint32_t)p[k + 1] << 16) |
+                   ((uint32_t)p[k + 2] << 8) | (uint32_t)p[k + 3];
+      if (k == 0) {
+        w ^= crc;
+      }
+      acc ^= table[CRCSW_SLICE_BY - 1 - k][w >> 24] ^
+             table[CRCSW_SLICE_BY - 2 - k][(w >> 16) & 0xFF] ^
+             table[CRCSW_SLICE_BY - 3 - k][(w >> 8) & 0xFF] ^
+             table[CRCSW_SLICE_BY - 4 - k][w & 0xFF];
+    }
+    crc = acc;
+    p += CRCSW_SLICE_BY;
+    n -= CRCSW_SLICE_BY;
+  }
+#endif
+
+  while (n--) {
+    crc = table[0][(crc >> 24) ^ *p++] ^ (crc << 8);
+  }
+
+  return crc;
+}
+#endif /* CRCSW_GENERATED_TABLES */
+
 /*===========================================================================*/
 /* Driver interrupt handlers.                                                */
 /*===========================================================================*/
@@ -219,11 +586,19 @@ static uint32_t reflect(uint32_t data, uint8_t nBits) {
  */
 void crc_lld_init(void) {
   crcObjectInit(&CRCD1);
-  CRCD1.crc = CRCD1.config->initial_val;
+  CRCD1.crc = 0;
+#if CRCSW_GENERATED_TABLES
+  CRCD1.table_config = NULL;
+  CRCD1.tables = NULL;
+#endif
 }
 
 /**
  * @brief   Configures and activates the CRC peripheral.
+ * @note    This function is invoked by @p crcStart() with the kernel
+ *          locked, the lookup tables are only released here, they are
+ *          acquired by @p crcswPrepareTable() or by the first
+ *          calculation.
  *
  * @param[in] crcp      pointer to the @p CRCDriver object
  *
@@ -243,6 +618,12 @@ void crc_lld_start(CRCDriver *crcp) {
   osalDbgAssert(crcp->config == CRCSW_CRC16_TABLE_CONFIG,
       "config must be CRCSW_CRC16_TABLE_CONFIG");
 #endif
+#endif
+  osalDbgAssert((crcp->config->poly_size >= 8) &&
+                (crcp->config->poly_size <= 32), "invalid poly_size");
+
+#if CRCSW_GENERATED_TABLES
+  crc_release_tables(crcp);
 #endif
   crc_lld_reset(crcp);
 }
@@ -256,7 +637,12 @@ void crc_lld_start(CRCDriver *crcp) {
  * @notapi
  */
 void crc_lld_stop(CRCDriver *crcp) {
+
+#if CRCSW_GENERATED_TABLES
+  crc_release_tables(crcp);
+#else
   (void)crcp;
+#endif
 }
 
 /**
@@ -267,11 +653,20 @@ void crc_lld_stop(CRCDriver *crcp) {
  * @notapi
  */
 void crc_lld_reset(CRCDriver *crcp) {
-  crcp->crc = crcp->config->initial_val;
+  const CRCConfig *config = crcp->config;
+
+  if (config->reflect_data) {
+    crcp->crc = reflect(config->initial_val, config->poly_size);
+  }
+  else {
+    crcp->crc = config->initial_val << (32 - config->poly_size);
+  }
 }
 
 /**
  * @brief   Returns calculated CRC from last reset
+ * @note    The first calculation after @p crcStart() generates the lookup
+ *          tables if @p crcswPrepareTable() has not been called.
  *
  * @param[in] crcp      pointer to the @p CRCDriver object
  * @param[in] n         size of buf in bytes
@@ -280,58 +675,127 @@ void crc_lld_reset(CRCDriver *crcp) {
  * @notapi
  */
 uint32_t crc_lld_calc(CRCDriver *crcp, size_t n, const void *buf) {
-  uint32_t i;
-  uint32_t crc;
+  const CRCConfig *config = crcp->config;
+  const uint8_t *p = (const uint8_t *)buf;
+  uint32_t crc = crcp->crc;
+
 #if (CRCSW_CRC32_TABLE == TRUE) || (CRCSW_CRC16_TABLE == TRUE)
-  if (crcp->config->table != NULL) {
-    for (i = 0; i < n; i++) {
-      uint8_t data = *((uint8_t*)buf + i);
-      uint8_t idx = (crcp->crc ^ data);
-      crcp->crc = (crcp->config->table[idx] ^ (crcp->crc >> 8));
+#if CRCSW_SLICE_BY == 1
+  if (config->table != NULL) {
+    const uint32_t *table = config->table;
+
+    for ( ; n > 0; n--) {
+      crc = table[(crc ^ *p++) & 0xFF] ^ (crc >> 8);
     }
-    crc = crcp->crc;
   }
 #endif
+#endif
 
-#if (CRCSW_PROGRAMMABLE == TRUE)
-  // Mask off bits to poly size
-  uint32_t mask = 1 << (crcp->config->poly_size - 1);
-  mask |= (mask - 1);
-
-  crc = crcp->crc;
-  if (crcp->config->table == NULL) {
-    for (i = 0; i < n; i++) {
-      uint8_t data = *((uint8_t*)buf + i);
-      uint8_t bit;
-
-      if (crcp->config->reflect_data) {
-        data = reflect(data, 8);
+#if CRCSW_GENERATED_TABLES
+  crc_prepare_tables(crcp);
+  if (config->reflect_data) {
+    crc = crc_slice_reflected(crcp->tables->table, crc, n, p);
+  }
+  else {
+    crc = crc_slice_normal(crcp->tables->table, crc, n, p);
+  }
+#elif CRCSW_PROGRAMMABLE == TRUE
+  if (config->table == NULL) {
+    uint8_t bit;
+
+    if (config->reflect_data) {
+      uint32_t poly = reflect(config->poly, config->poly_size);
+
+      while (n--) {
+        crc ^= *p++;
+        /* Perform modulo-2 division, a bit at a time. */
+        for (bit = 8; bit > 0; --bit) {
+          crc = (crc & 1) ? (crc >> 1) ^ poly : (crc >> 1);
+        }
       }
-
-      /* Bring the next byte into the remainder. */
-      crc ^= (data << (crcp->config->poly_size - 8));
-
-      /* Perform modulo-2 division, a bit at a time. */
-      for (bit = 8; bit > 0; --bit) {
-        /* Try to divide the current data bit. */
-        if (crc & (1 << (crcp->config->poly_size - 1))) {
-          crc = (crc << 1) ^ crcp->config->poly;
-        } else {
-          crc <<= 1;
+    }
+    else {
+      uint32_t poly = config->poly << (32 - config->poly_size);
+
+      while (n--) {
+        /* Bring the next byte into the remainder. */
+        crc ^= (uint32_t)*p++ << 24;
+        /* Perform modulo-2 division, a bit at a time. */
+        for (bit = 8; bit > 0; --bit) {
+          crc = (crc & 0x80000000) ? (crc << 1) ^ poly : (crc << 1);
         }
       }
     }
+  }
+#endif
 
-    crcp->crc = crc;
+  crcp->crc = crc;
 
-    if (crcp->config->reflect_remainder) {
-      crc = reflect(crc, crcp->config->poly_size);
+  /* Bring the remainder back to its natural bit order and width.*/
+  if (config->reflect_data) {
+    if (!config->reflect_remainder) {
+      crc = reflect(crc, config->poly_size);
     }
   }
+  else {
+    crc >>= 32 - config->poly_size;
+    if (config->reflect_remainder) {
+      crc = reflect(crc, config->poly_size);
+    }
+  }
+
+  return (crc ^ config->final_val) & crc_mask(config->poly_size);
+}
+
+/**
+ * @brief   Generates the lookup tables for the active configuration.
+ * @details The tables take a few thousand cycles per slice to build, this
+ *          is not done by @p crcStart() because it runs with the kernel
+ *          locked. Calling this function after @p crcStart() moves the
+ *          cost out of the first @p crcCalc(), which is required when
+ *          the first calculation is done by @p crcCalcI() from a locked
+ *          context.
+ * @note    Does nothing if the tables are already valid or not used by
+ *          the active configuration.
+ *
+ * @param[in] crcp      pointer to the @p CRCDriver object
+ *
+ * @api
+ */
+void crcswPrepareTable(CRCDriver *crcp) {
+
+  osalDbgCheck(crcp != NULL);
+  osalDbgAssert(crcp->state == CRC_READY, "not ready");
+
+#if CRCSW_GENERATED_TABLES
+  crc_prepare_tables(crcp);
 #endif
+}
+
+#if CRCSW_PRESETS || defined(__DOXYGEN__)
+/**
+ * @brief   Looks up a preset configuration by catalogue name.
+ *
+ * @param[in] name      catalogue name, e.g. "CRC-32C"
+ * @return              The configuration.
+ * @retval NULL         if the name is unknown.
+ *
+ * @api
+ */
+const CRCConfig *crcswFindPreset(const char *name) {
+  size_t i;
 
-  return (crc ^ crcp->config->final_val) & mask;
+  osalDbgCheck(name != NULL);
+
+  for (i = 0; i < crcsw_presets_count; i++) {
+    if (strcmp(crcsw_presets[i].name, name) == 0) {
+      return crcsw_presets[i].config;
+    }
+  }
+
+  return NULL;
 }
+#endif
 
 #endif /* CRCSW_USE_CRC1 */
 
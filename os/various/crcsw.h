@@ -59,6 +59,60 @@
 #define CRCSW_CRC16_TABLE               FALSE
 #endif
 
+/**
+ * @brief   Number of bytes processed per iteration of the table kernel.
+ * @details When set to 4, 8 or 16 a slice-by-N kernel is used, its lookup
+ *          tables are generated for any @p CRCConfig (polynomial, width
+ *          and reflection), see @p crcswPrepareTable().
+ *          When set to 1 the classic byte-wise kernel is used.
+ * @note    Each slice costs 1KiB of RAM per table set, see
+ *          @p CRCSW_TABLE_SETS, slice-by-16 takes 16KiB per set.
+ * @note    The default is 1.
+ */
+#if !defined(CRCSW_SLICE_BY) || defined(__DOXYGEN__)
+#define CRCSW_SLICE_BY                  1
+#endif
+
+/**
+ * @brief   Generates a lookup table for programmable configurations.
+ * @details If set to @p TRUE a 256 entries table is built for
+ *          configurations without @p table, so any polynomial runs at
+ *          table speed instead of a bit at a time.
+ *          Set it to @p FALSE to save the RAM when only the constant
+ *          tables are used or when speed does not matter.
+ * @note    Costs 1KiB of RAM per table set, see @p CRCSW_TABLE_SETS.
+ * @note    Only meaningful with @p CRCSW_PROGRAMMABLE and
+ *          @p CRCSW_SLICE_BY == 1, slice-by-N always uses generated tables.
+ * @note    The default is @p TRUE.
+ */
+#if !defined(CRCSW_PROGRAMMABLE_TABLE) || defined(__DOXYGEN__)
+#define CRCSW_PROGRAMMABLE_TABLE        TRUE
+#endif
+
+/**
+ * @brief   Number of generated table sets.
+ * @details The sets are shared by all the driver instances, drivers whose
+ *          configurations have the same polynomial, width and
+ *          @p reflect_data use the same set. A set stays valid after
+ *          @p crcStop(), restarting with the same polynomial does not
+ *          generate the tables again.
+ * @note    Must be at least the number of different polynomials in use at
+ *          the same time.
+ * @note    The default is 1.
+ */
+#if !defined(CRCSW_TABLE_SETS) || defined(__DOXYGEN__)
+#define CRCSW_TABLE_SETS                1
+#endif
+
+/**
+ * @brief   Enables the catalogue of named CRC configurations.
+ * @note    Requires @p CRCSW_PROGRAMMABLE.
+ * @note    The default is @p FALSE.
+ */
+#if !defined(CRCSW_PRESETS) || defined(__DOXYGEN__)
+#define CRCSW_PRESETS                   FALSE
+#endif
+
 /*===========================================================================*/
 /* Derived constants and error checks.                                       */
 /*===========================================================================*/
@@ -72,6 +126,26 @@
 #error "At least one of CRCSW_PROGRAMMABLE, CRCSW_CRC32_TABLE, or CRCSW_CRC16_TABLE must be defined"
 #endif
 
+#if (CRCSW_SLICE_BY != 1) && (CRCSW_SLICE_BY != 4) &&                       \
+    (CRCSW_SLICE_BY != 8) && (CRCSW_SLICE_BY != 16)
+#error "CRCSW_SLICE_BY must be 1, 4, 8 or 16"
+#endif
+
+#if CRCSW_TABLE_SETS < 1
+#error "CRCSW_TABLE_SETS must be at least 1"
+#endif
+
+#if CRCSW_PRESETS && (CRCSW_PROGRAMMABLE == FALSE)
+#error "CRCSW_PRESETS requires CRCSW_PROGRAMMABLE"
+#endif
+
+/**
+ * @brief   Lookup tables are generated at run time.
+ */
+#define CRCSW_GENERATED_TABLES                                              \
+  ((CRCSW_SLICE_BY > 1) ||                                                  \
+   ((CRCSW_PROGRAMMABLE == TRUE) && (CRCSW_PROGRAMMABLE_TABLE == TRUE)))
+
 /*===========================================================================*/
 /* Driver data structures and types.                                         */
 /*===========================================================================*/
@@ -111,10 +185,69 @@ typedef struct {
   /* End of the mandatory fields.*/
   /**
    * @brief The crc lookup table to use when calculating CRC.
+   * @note  When @p NULL the table is generated, if enabled.
+   * @note  The table must be in reflected (LSB first) form, it is only
+   *        used by the byte-wise kernel (@p CRCSW_SLICE_BY == 1).
    */
   const uint32_t           *table;
 } CRCConfig;
 
+#if CRCSW_GENERATED_TABLES || defined(__DOXYGEN__)
+/**
+ * @brief   Set of generated lookup tables.
+ */
+typedef struct {
+  /**
+   * @brief Polynomial the tables were generated for.
+   */
+  uint32_t                 poly;
+  /**
+   * @brief Width of the polynomial.
+   */
+  uint32_t                 poly_size;
+  /**
+   * @brief Reflected (LSB first) tables.
+   */
+  bool                     reflect_data;
+  /**
+   * @brief The tables are complete.
+   */
+  bool                     valid;
+  /**
+   * @brief Number of drivers using the set.
+   */
+  unsigned                 refs;
+  /**
+   * @brief Order of the last acquisition.
+   */
+  uint32_t                 last_use;
+  /**
+   * @brief Lookup tables.
+   */
+  uint32_t                 table[CRCSW_SLICE_BY][256];
+} CRCSWTables;
+#endif
+
+#if CRCSW_PRESETS || defined(__DOXYGEN__)
+/**
+ * @brief   Named CRC configuration.
+ */
+typedef struct {
+  /**
+   * @brief Catalogue name, e.g. "CRC-16/CCITT-FALSE".
+   */
+  const char               *name;
+  /**
+   * @brief The configuration.
+   */
+  const CRCConfig          *config;
+  /**
+   * @brief Catalogue check value, CRC of the ASCII string "123456789".
+   */
+  uint32_t                 check;
+} CRCSWPreset;
+#endif
+
 
 /**
  * @brief   Structure representing an CRC driver.
@@ -137,8 +270,21 @@ struct CRCDriver {
   /* End of the mandatory fields.*/
   /**
    * @brief Current value of calculated CRC.
+   * @note  Reflected when @p reflect_data is set, left aligned to bit 31
+   *        otherwise.
    */
   uint32_t                  crc;
+#if CRCSW_GENERATED_TABLES || defined(__DOXYGEN__)
+  /**
+   * @brief Configuration the lookup tables were acquired for.
+   * @note  @p NULL when no tables are acquired.
+   */
+  const CRCConfig           *table_config;
+  /**
+   * @brief Lookup tables shared with the drivers using the same polynomial.
+   */
+  CRCSWTables               *tables;
+#endif
 };
 
 /*===========================================================================*/
@@ -158,6 +304,24 @@ struct CRCDriver {
 #define CRCSW_CRC16_TABLE_CONFIG (&crcsw_crc16_config)
 #endif
 
+#if CRCSW_PRESETS || defined(__DOXYGEN__)
+/**
+ * @name    Preset configurations
+ * @{
+ */
+#define CRCSW_CRC8_CONFIG               (&crcsw_crc8_config)
+#define CRCSW_CRC8_MAXIM_CONFIG         (&crcsw_crc8_maxim_config)
+#define CRCSW_CRC16_ARC_CONFIG          (&crcsw_crc16_arc_config)
+#define CRCSW_CRC16_CCITT_FALSE_CONFIG  (&crcsw_crc16_ccitt_false_config)
+#define CRCSW_CRC16_KERMIT_CONFIG       (&crcsw_crc16_kermit_config)
+#define CRCSW_CRC16_MODBUS_CONFIG       (&crcsw_crc16_modbus_config)
+#define CRCSW_CRC16_XMODEM_CONFIG       (&crcsw_crc16_xmodem_config)
+#define CRCSW_CRC32_CONFIG              (&crcsw_crc32_ieee_config)
+#define CRCSW_CRC32C_CONFIG             (&crcsw_crc32c_config)
+#define CRCSW_CRC32_MPEG2_CONFIG        (&crcsw_crc32_mpeg2_config)
+/** @} */
+#endif
+
 /*===========================================================================*/
 /* Driver local definitions.                                                 */
 /*===========================================================================*/
@@ -196,6 +360,21 @@ extern const CRCConfig crcsw_crc32_config;
 extern const CRCConfig crcsw_crc16_config;
 #endif
 
+#if CRCSW_PRESETS
+extern const CRCConfig crcsw_crc8_config;
+extern const CRCConfig crcsw_crc8_maxim_config;
+extern const CRCConfig crcsw_crc16_arc_config;
+extern const CRCConfig crcsw_crc16_ccitt_false_config;
+extern const CRCConfig crcsw_crc16_kermit_config;
+extern const CRCConfig crcsw_crc16_modbus_config;
+extern const CRCConfig crcsw_crc16_xmodem_config;
+extern const CRCConfig crcsw_crc32_ieee_config;
+extern const CRCConfig crcsw_crc32c_config;
+extern const CRCConfig crcsw_crc32_mpeg2_config;
+extern const CRCSWPreset crcsw_presets[];
+extern const size_t crcsw_presets_count;
+#endif
+
 #ifdef __cplusplus
 extern "C" {
 #endif
@@ -204,6 +383,10 @@ extern "C" {
   void crc_lld_stop(CRCDriver *crcp);
   void crc_lld_reset(CRCDriver *crcp);
   uint32_t crc_lld_calc(CRCDriver *crcp, size_t n, const void *buf);
+  void crcswPrepareTable(CRCDriver *crcp);
+#if CRCSW_PRESETS
+  const CRCConfig *crcswFindPreset(const char *name);
+#endif
 #ifdef __cplusplus
 }
 #endif
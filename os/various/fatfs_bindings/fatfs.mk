@@ -2,9 +2,11 @@
 FATFSSRC = ${CHIBIOS_CONTRIB}/os/various/fatfs_bindings/fatfs_diskio.c \
            ${CHIBIOS}/os/various/fatfs_bindings/fatfs_syscall.c \
            ${CHIBIOS}/ext/fatfs/source/ff.c \
-           $(CHIBIOS)/ext/fatfs/source/ffunicode.c
+           $(CHIBIOS)/ext/fatfs/source/ffunicode.c \
+           ${CHIBIOS_CONTRIB}/os/various/blkcache.c
 
-FATFSINC = ${CHIBIOS}/ext/fatfs/source ${CHIBIOS_CONTRIB}/os/various/fatfs_bindings
+FATFSINC = ${CHIBIOS}/ext/fatfs/source ${CHIBIOS_CONTRIB}/os/various/fatfs_bindings \
+           ${CHIBIOS_CONTRIB}/os/various
 
 # Shared variables
 ALLCSRC += $(FATFSSRC)
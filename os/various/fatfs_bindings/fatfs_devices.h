@@ -38,4 +38,22 @@
 #endif
 #endif
 
+/*-----------------------------------------------------------------------*/
+/* Block cache between FatFs and the physical drives.                    */
+
+/* Enables the write-back block cache, see os/various/blkcache.c.*/
+#if !defined(FATFS_USE_BLKCACHE)
+#define FATFS_USE_BLKCACHE          FALSE
+#endif
+
+/* Number of cached sectors for each physical drive.*/
+#if !defined(FATFS_BLKCACHE_LINES)
+#define FATFS_BLKCACHE_LINES        16
+#endif
+
+/* Sectors fetched ahead of a sequential read, zero disables read-ahead.*/
+#if !defined(FATFS_BLKCACHE_READAHEAD)
+#define FATFS_BLKCACHE_READAHEAD    4
+#endif
+
 #endif /* FATFS_DEVICES_H_ */
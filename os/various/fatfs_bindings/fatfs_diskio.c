@@ -43,6 +43,64 @@ extern SDCDriver FATFS_HAL_DEVICE;
 extern RTCDriver RTCD1;
 #endif
 
+#if FATFS_USE_BLKCACHE
+#include "blkcache.h"
+
+#if defined(FATFSDEV_MSD)
+#define FATFS_BLKCACHE_DRIVES (FATFSDEV_MSD + 1)
+#else
+#define FATFS_BLKCACHE_DRIVES (FATFSDEV_MMC + 1)
+#endif
+
+static BlockCache fatfs_cache[FATFS_BLKCACHE_DRIVES];
+static BlockCacheConfig fatfs_cache_config[FATFS_BLKCACHE_DRIVES];
+static blkcache_line_t fatfs_cache_lines[FATFS_BLKCACHE_DRIVES][FATFS_BLKCACHE_LINES];
+/* Word aligned for the DMA based drivers.*/
+static uint32_t fatfs_cache_buffer[FATFS_BLKCACHE_DRIVES][FATFS_BLKCACHE_LINES * FF_MAX_SS / 4];
+
+static BaseBlockDevice *cache_device(BYTE pdrv) {
+  switch (pdrv) {
+#if HAL_USE_MMC_SPI || HAL_USE_SDC
+  case FATFSDEV_MMC:
+    return (BaseBlockDevice *)&FATFS_HAL_DEVICE;
+#endif
+#if HAL_USBH_USE_MSD
+  case FATFSDEV_MSD:
+    return (BaseBlockDevice *)&MSBLKD[0];
+#endif
+  }
+  return NULL;
+}
+
+/* Binds the cache to the drive on first use and connects it once the drive,
+   initialized externally, is ready.*/
+static DRESULT cache_ready(BYTE pdrv, BlockCache **bcpp) {
+  BaseBlockDevice *dev = cache_device(pdrv);
+  BlockCache *bcp;
+
+  if (dev == NULL)
+    return RES_PARERR;
+  bcp = &fatfs_cache[pdrv];
+  if (bcp->config == NULL) {
+    BlockCacheConfig *cfg = &fatfs_cache_config[pdrv];
+    cfg->dev       = dev;
+    cfg->lines     = fatfs_cache_lines[pdrv];
+    cfg->buffer    = (uint8_t *)fatfs_cache_buffer[pdrv];
+    cfg->nlines    = FATFS_BLKCACHE_LINES;
+    cfg->line_size = FF_MAX_SS;
+    cfg->readahead = FATFS_BLKCACHE_READAHEAD;
+    blkcacheObjectInit(bcp);
+    blkcacheStart(bcp, cfg);
+  }
+  if (blkGetDriverState(dev) != BLK_READY)
+    return RES_NOTRDY;
+  if (blkConnect(bcp))
+    return RES_ERROR;
+  *bcpp = bcp;
+  return RES_OK;
+}
+#endif /* FATFS_USE_BLKCACHE */
+
 
 /*-----------------------------------------------------------------------*/
 /* Inidialize a Drive                                                    */
@@ -140,6 +198,16 @@ DRESULT disk_read (
     UINT count        /* Number of sectors to read (1..255) */
 )
 {
+#if FATFS_USE_BLKCACHE
+  BlockCache *bcp;
+  DRESULT res = cache_ready(pdrv, &bcp);
+
+  if (res != RES_OK)
+    return res;
+  if (blkRead(bcp, sector, buff, count))
+    return RES_ERROR;
+  return RES_OK;
+#else
   switch (pdrv) {
 #if HAL_USE_MMC_SPI
   case FATFSDEV_MMC:
@@ -175,6 +243,7 @@ DRESULT disk_read (
 #endif
   }
   return RES_PARERR;
+#endif /* FATFS_USE_BLKCACHE */
 }
 
 
@@ -190,7 +259,18 @@ DRESULT disk_write (
     UINT count        /* Number of sectors to write (1..255) */
 )
 {
-
+#if FATFS_USE_BLKCACHE
+  BlockCache *bcp;
+  DRESULT res = cache_ready(pdrv, &bcp);
+
+  if (res != RES_OK)
+    return res;
+  if (blkIsWriteProtected(bcp))
+    return RES_WRPRT;
+  if (blkWrite(bcp, sector, buff, count))
+    return RES_ERROR;
+  return RES_OK;
+#else
   switch (pdrv) {
 #if HAL_USE_MMC_SPI
   case FATFSDEV_MMC:
@@ -241,6 +321,7 @@ DRESULT disk_write (
 #endif
   }
   return RES_PARERR;
+#endif /* FATFS_USE_BLKCACHE */
 }
 #endif /* _FS_READONLY */
 
@@ -257,6 +338,19 @@ DRESULT disk_ioctl (
 {
   (void)buff;
 
+#if FATFS_USE_BLKCACHE
+  if (cmd == CTRL_SYNC) {
+    BlockCache *bcp;
+    DRESULT res = cache_ready(pdrv, &bcp);
+
+    if (res != RES_OK)
+      return res;
+    if (blkSync(bcp))
+      return RES_ERROR;
+    return RES_OK;
+  }
+#endif
+
   switch (pdrv) {
 #if HAL_USE_MMC_SPI
   case FATFSDEV_MMC:
@@ -339,8 +339,78 @@ static bool data_overflow(SCSITarget *scsip, const data_request_t *req) {
   }
 }
 
+/**
+ * @brief   Starts a data phase transfer.
+ * @details Without asynchronous transport calls the transfer is only
+ *          recorded and performed by @p xfer_wait().
+ *
+ * @param[in] scsip     pointer to @p SCSITarget structure
+ * @param[in] transmit  transfer direction, @p true toward the initiator
+ * @param[in] buf       pointer to data buffer
+ * @param[in] len       number of bytes to be transferred
+ *
+ * @return              The operation status.
+ *
+ * @notapi
+ */
+static bool xfer_start(SCSITarget *scsip, bool transmit,
+                       uint8_t *buf, size_t len) {
+
+  const SCSITransport *tr = scsip->config->transport;
+
+  scsip->xfer_buf = buf;
+  scsip->xfer_len = len;
+  scsip->xfer_transmit = transmit;
+
+  if (NULL == tr->wait) {
+    return SCSI_SUCCESS;
+  }
+  else if (transmit) {
+    return tr->start_transmit(tr, buf, len);
+  }
+  else {
+    return tr->start_receive(tr, buf, len);
+  }
+}
+
+/**
+ * @brief   Waits for completion of the transfer started by @p xfer_start().
+ *
+ * @param[in] scsip     pointer to @p SCSITarget structure
+ *
+ * @return              The operation status.
+ *
+ * @notapi
+ */
+static bool xfer_wait(SCSITarget *scsip) {
+
+  const SCSITransport *tr = scsip->config->transport;
+  uint32_t done;
+
+  if (NULL != tr->wait) {
+    done = tr->wait(tr, scsip->xfer_transmit);
+  }
+  else if (scsip->xfer_transmit) {
+    done = tr->transmit(tr, scsip->xfer_buf, scsip->xfer_len);
+  }
+  else {
+    done = tr->receive(tr, scsip->xfer_buf, scsip->xfer_len);
+  }
+
+  if (done != scsip->xfer_len) {
+    return SCSI_FAILED;
+  }
+  else {
+    return SCSI_SUCCESS;
+  }
+}
+
 /**
  * @brief   SCSI read/write (10) command handler.
+ * @details The data buffer is used as two halves, the next chunk of blocks
+ *          is read from the device while the previous one is transmitted
+ *          and, when writing, the next chunk is received while the
+ *          previous one is written to the device.
  *
  * @param[in] scsip   pointer to @p SCSITarget structure
  * @param[in] cmd     pointer to SCSI command data
@@ -356,27 +426,104 @@ static bool data_read_write10(SCSITarget *scsip, const uint8_t *cmd) {
   if (data_overflow(scsip, &req)) {
     return SCSI_FAILED;
   }
-  else {
-    const SCSITransport *tr = scsip->config->transport;
+  else if (req.blk_cnt > 0) {
     BaseBlockDevice *blkdev = scsip->config->blkdev;
     BlockDeviceInfo bdi;
     blkGetInfo(blkdev, &bdi);
-    size_t bs = bdi.blk_size;
-    uint8_t *buf = scsip->config->blkbuf;
-
-    size_t i = 0;
-    for (i=0; i<req.blk_cnt; i++) {
-      if (cmd[0] == SCSI_CMD_READ_10) {
-        // TODO: block error handling
-        blkRead(blkdev, req.first_lba + i, buf, 1);
-        tr->transmit(tr, buf, bs);
+    const uint32_t bs = bdi.blk_size;
+    const bool read = (cmd[0] == SCSI_CMD_READ_10);
+    uint8_t *half[2];
+    uint32_t per_half = scsip->config->blkbuf_size / (2U * bs);
+    uint32_t lba = req.first_lba;
+    uint32_t left = req.blk_cnt;
+    uint32_t unwritten = 0;
+    uint32_t cnt, next;
+    bool media_err = false;
+    unsigned cur = 0;
+
+    if (per_half == 0U) {
+      /* Single block buffer, chunks alternate on the same block.*/
+      per_half = 1U;
+      half[0] = half[1] = scsip->config->blkbuf;
+    }
+    else {
+      half[0] = scsip->config->blkbuf;
+      half[1] = scsip->config->blkbuf + (per_half * bs);
+    }
+    cnt = (left < per_half) ? left : per_half;
+
+    if (read && blkRead(blkdev, lba, half[cur], cnt)) {
+      goto media_error;
+    }
+    if (xfer_start(scsip, read, half[cur], cnt * bs)) {
+      goto transport_error;
+    }
+
+    while (true) {
+      next = ((left - cnt) < per_half) ? (left - cnt) : per_half;
+
+      if (read) {
+        /* Fetching the next chunk while the current one is on the wire.*/
+        if ((next > 0U) && (half[0] != half[1])) {
+          media_err = blkRead(blkdev, lba + cnt, half[cur ^ 1U], next);
+        }
+        if (xfer_wait(scsip)) {
+          goto transport_error;
+        }
+        left -= cnt;
+        if ((next > 0U) && (half[0] == half[1])) {
+          media_err = blkRead(blkdev, lba + cnt, half[cur ^ 1U], next);
+        }
+        if (media_err) {
+          goto media_error;
+        }
+        if ((next > 0U) &&
+            xfer_start(scsip, true, half[cur ^ 1U], next * bs)) {
+          goto transport_error;
+        }
       }
       else {
-        // TODO: block error handling
-        tr->receive(tr, buf, bs);
-        blkWrite(blkdev, req.first_lba + i, buf, 1);
+        if (xfer_wait(scsip)) {
+          goto transport_error;
+        }
+        left -= cnt;
+        /* Receiving the next chunk while the current one is written.*/
+        if ((next > 0U) && (half[0] != half[1]) &&
+            xfer_start(scsip, false, half[cur ^ 1U], next * bs)) {
+          goto transport_error;
+        }
+        if (!media_err && blkWrite(blkdev, lba, half[cur], cnt)) {
+          /* The remaining data is still drained from the initiator.*/
+          media_err = true;
+          unwritten = left + cnt;
+        }
+        if ((next > 0U) && (half[0] == half[1]) &&
+            xfer_start(scsip, false, half[cur ^ 1U], next * bs)) {
+          goto transport_error;
+        }
+      }
+
+      if (next == 0U) {
+        break;
       }
+      lba += cnt;
+      cnt = next;
+      cur ^= 1U;
     }
+
+    if (media_err) {
+      left = unwritten;
+      goto media_error;
+    }
+    return SCSI_SUCCESS;
+
+media_error:
+    set_sense(scsip, SCSI_SENSE_KEY_MEDIUM_ERROR,
+                     SCSI_ASENSE_NO_ADDITIONAL_INFORMATION,
+                     SCSI_ASENSEQ_NO_QUALIFIER);
+transport_error:
+    scsip->residue = left * bs;
+    return SCSI_FAILED;
   }
   return SCSI_SUCCESS;
 }
@@ -500,6 +647,9 @@ void scsiObjectInit(SCSITarget *scsip) {
 
   scsip->config = NULL;
   scsip->residue = 0;
+  scsip->xfer_buf = NULL;
+  scsip->xfer_len = 0;
+  scsip->xfer_transmit = false;
   memset(&scsip->sense, 0 , sizeof(scsi_sense_response_t));
   scsip->state = SCSI_TRGT_STOP;
 }
@@ -198,6 +198,45 @@ typedef uint32_t (*scsi_transport_transmit_t)(const SCSITransport *transport,
 typedef uint32_t (*scsi_transport_receive_t)(const SCSITransport *transport,
                                              uint8_t *data, size_t len);
 
+/**
+ * @brief   Type of a SCSI transport asynchronous transmit start call.
+ *
+ * @param[in] transport pointer to the @p SCSITransport object
+ * @param[in] data      pointer to payload buffer
+ * @param[in] len       payload length
+ *
+ * @return              The operation status.
+ * @retval false        transfer started.
+ * @retval true         transfer not started.
+ */
+typedef bool (*scsi_transport_start_transmit_t)(const SCSITransport *transport,
+                                                const uint8_t *data, size_t len);
+
+/**
+ * @brief   Type of a SCSI transport asynchronous receive start call.
+ *
+ * @param[in] transport pointer to the @p SCSITransport object
+ * @param[out] data     pointer to receive buffer
+ * @param[in] len       number of bytes to be received
+ *
+ * @return              The operation status.
+ * @retval false        transfer started.
+ * @retval true         transfer not started.
+ */
+typedef bool (*scsi_transport_start_receive_t)(const SCSITransport *transport,
+                                               uint8_t *data, size_t len);
+
+/**
+ * @brief   Type of a SCSI transport asynchronous transfer wait call.
+ *
+ * @param[in] transport pointer to the @p SCSITransport object
+ * @param[in] transmit  direction of the pending transfer
+ *
+ * @return              Number of bytes transferred, zero on failure.
+ */
+typedef uint32_t (*scsi_transport_wait_t)(const SCSITransport *transport,
+                                          bool transmit);
+
 /**
  * @brief   SCSI transport structure.
  */
@@ -210,6 +249,21 @@ struct SCSITransport {
    * @brief   Receive call provided by lower level driver.
    */
   scsi_transport_receive_t      receive;
+  /**
+   * @brief   Asynchronous transmit start call, optional.
+   * @note    The three asynchronous calls must be all provided or all
+   *          @p NULL, without them data transfers do not overlap the
+   *          block device accesses.
+   */
+  scsi_transport_start_transmit_t start_transmit;
+  /**
+   * @brief   Asynchronous receive start call, optional.
+   */
+  scsi_transport_start_receive_t  start_receive;
+  /**
+   * @brief   Asynchronous transfer completion wait call, optional.
+   */
+  scsi_transport_wait_t           wait;
   /**
    * @brief   Transport handler provided by lower level driver.
    */
@@ -229,9 +283,18 @@ typedef struct {
    */
   BaseBlockDevice               *blkdev;
   /**
-   * @brief   Pointer to data buffer for single block.
+   * @brief   Pointer to data buffer.
+   * @details The buffer is split in two halves used alternately, the
+   *          transport moves one half while the block device fills or
+   *          drains the other. Each half holds as many blocks as fit.
    */
   uint8_t                       *blkbuf;
+  /**
+   * @brief   Size of the data buffer in bytes.
+   * @note    Zero means the buffer holds a single block, no overlap is
+   *          possible in this case.
+   */
+  size_t                        blkbuf_size;
   /**
    * @brief   Pointer to SCSI inquiry response object.
    */
@@ -266,6 +329,18 @@ struct SCSITarget {
    * @brief   Residue bytes.
    */
   uint32_t                      residue;
+  /**
+   * @brief   Buffer of the transfer started and not yet waited.
+   */
+  uint8_t                       *xfer_buf;
+  /**
+   * @brief   Length of the transfer started and not yet waited.
+   */
+  size_t                        xfer_len;
+  /**
+   * @brief   Direction of the transfer started and not yet waited.
+   */
+  bool                          xfer_transmit;
 };
 
 /*===========================================================================*/
@@ -127,3 +127,8 @@ uint16_t middle_of_3(uint16_t a, uint16_t b, uint16_t c)
   }
   return middle;
 }
+
+MEDIAN_HEAP_DEFINE(u16, uint16_t)
+MEDIAN_HEAP_DEFINE(s16, int16_t)
+MEDIAN_HEAP_DEFINE(s32, int32_t)
+MEDIAN_HEAP_DEFINE(f, float)
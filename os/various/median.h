@@ -39,4 +39,205 @@ void median_init(median_t* conf, uint16_t stopper, pair_t* buffer, uint16_t size
 uint16_t median_filter(median_t* conf, uint16_t datum);
 uint16_t middle_of_3(uint16_t a, uint16_t b, uint16_t c);
 
+/*
+ * Sliding window median, O(log N) per sample.
+ *
+ * The window samples are indexed by two heaps sharing one array around the
+ * median: a max-heap of the smaller samples at negative indexes, a min-heap
+ * of the larger ones at positive indexes and the median at index 0. The
+ * replaced sample is sifted from its own position, so no search is needed.
+ *
+ * MEDIAN_HEAP_DECLARE(sfx, type) declares median_heap_<sfx>_t and its
+ * functions, MEDIAN_HEAP_DEFINE(sfx, type) defines them. Both are
+ * instantiated here for uint16_t (u16), int16_t (s16), int32_t (s32) and
+ * float (f), other types may be instantiated the same way. Floats must not
+ * be NaN. With an even number of samples the upper median is returned.
+ */
+
+/* Number of int16_t of the index buffer of a window of size samples */
+#define MEDIAN_HEAP_INDEX_SIZE(size) (2U * (size))
+
+#define MEDIAN_HEAP_DECLARE(sfx, type)                                        \
+typedef struct                                                                \
+{                                                                             \
+  type* data;          /* Circular buffer of the window samples */           \
+  int16_t* pos;        /* Heap position of each sample */                     \
+  int16_t* heap;       /* Middle of the heap, heap[0] is the median */        \
+  uint16_t size;       /* Window size, 1 up to 32767 */                       \
+  uint16_t count;      /* Samples received, up to size */                     \
+  uint16_t idx;        /* Oldest sample, replaced next */                     \
+} median_heap_##sfx##_t;                                                      \
+                                                                              \
+void median_heap_##sfx##_init(median_heap_##sfx##_t* mh, type* data,          \
+                              int16_t* index, uint16_t size);                 \
+type median_heap_##sfx##_filter(median_heap_##sfx##_t* mh, type datum);       \
+void median_heap_##sfx##_filter_buffer(median_heap_##sfx##_t* mh,             \
+                                       size_t channels, const type* in,       \
+                                       type* out, size_t frames);
+
+#define MEDIAN_HEAP_DEFINE(sfx, type)                                         \
+/* Swaps heap nodes i and j if node i is the smaller, true if swapped */      \
+static inline bool median_heap_##sfx##_cmpexch(median_heap_##sfx##_t* mh,     \
+                                               int i, int j)                  \
+{                                                                             \
+  int16_t t;                                                                  \
+                                                                              \
+  if (!(mh->data[mh->heap[i]] < mh->data[mh->heap[j]]))                       \
+  {                                                                           \
+    return false;                                                             \
+  }                                                                           \
+  t = mh->heap[i];                                                            \
+  mh->heap[i] = mh->heap[j];                                                  \
+  mh->heap[j] = t;                                                            \
+  mh->pos[mh->heap[i]] = (int16_t)i;                                          \
+  mh->pos[mh->heap[j]] = (int16_t)j;                                          \
+  return true;                                                                \
+}                                                                             \
+                                                                              \
+/* Restores the min-heap from node i, compared with its parent, down */       \
+static void median_heap_##sfx##_min_down(median_heap_##sfx##_t* mh, int i)    \
+{                                                                             \
+  int last = (mh->count - 1) / 2;                                             \
+                                                                              \
+  for (; i <= last; i *= 2)                                                   \
+  {                                                                           \
+    if ((i > 1) && (i < last) &&                                              \
+        (mh->data[mh->heap[i + 1]] < mh->data[mh->heap[i]]))                  \
+    {                                                                         \
+      ++i;                             /* Smaller child */                    \
+    }                                                                         \
+    if (!median_heap_##sfx##_cmpexch(mh, i, i / 2))                           \
+    {                                                                         \
+      break;                                                                  \
+    }                                                                         \
+  }                                                                           \
+}                                                                             \
+                                                                              \
+/* Restores the max-heap from node i down, negative indexes */                \
+static void median_heap_##sfx##_max_down(median_heap_##sfx##_t* mh, int i)    \
+{                                                                             \
+  int last = -(mh->count / 2);                                                \
+                                                                              \
+  for (; i >= last; i *= 2)                                                   \
+  {                                                                           \
+    if ((i < -1) && (i > last) &&                                             \
+        (mh->data[mh->heap[i]] < mh->data[mh->heap[i - 1]]))                  \
+    {                                                                         \
+      --i;                             /* Larger child */                     \
+    }                                                                         \
+    if (!median_heap_##sfx##_cmpexch(mh, i / 2, i))                           \
+    {                                                                         \
+      break;                                                                  \
+    }                                                                         \
+  }                                                                           \
+}                                                                             \
+                                                                              \
+/* Inserts a sample in place of the oldest one, returns the median */         \
+static inline type median_heap_##sfx##_push(median_heap_##sfx##_t* mh,        \
+                                            type datum)                       \
+{                                                                             \
+  bool full = (mh->count == mh->size);                                        \
+  int p = mh->pos[mh->idx];                                                   \
+  type old = mh->data[mh->idx];                                               \
+                                                                              \
+  mh->data[mh->idx] = datum;                                                  \
+  if (++mh->idx >= mh->size)                                                  \
+  {                                                                           \
+    mh->idx = 0;                                                              \
+  }                                                                           \
+  if (!full)                                                                  \
+  {                                                                           \
+    mh->count++;                                                              \
+  }                                                                           \
+                                                                              \
+  if (p > 0)                           /* In the min-heap */                  \
+  {                                                                           \
+    if (full && (old < datum))                                                \
+    {                                                                         \
+      median_heap_##sfx##_min_down(mh, p * 2);                                \
+    }                                                                         \
+    else                                                                      \
+    {                                                                         \
+      while ((p > 0) && median_heap_##sfx##_cmpexch(mh, p, p / 2))            \
+      {                                                                       \
+        p /= 2;                                                               \
+      }                                                                       \
+      if (p == 0)                      /* New median, old one goes down */    \
+      {                                                                       \
+        median_heap_##sfx##_max_down(mh, -1);                                 \
+      }                                                                       \
+    }                                                                         \
+  }                                                                           \
+  else if (p < 0)                      /* In the max-heap */                  \
+  {                                                                           \
+    if (full && (datum < old))                                                \
+    {                                                                         \
+      median_heap_##sfx##_max_down(mh, p * 2);                                \
+    }                                                                         \
+    else                                                                      \
+    {                                                                         \
+      while ((p < 0) && median_heap_##sfx##_cmpexch(mh, p / 2, p))            \
+      {                                                                       \
+        p /= 2;                                                               \
+      }                                                                       \
+      if (p == 0)                                                             \
+      {                                                                       \
+        median_heap_##sfx##_min_down(mh, 1);                                  \
+      }                                                                       \
+    }                                                                         \
+  }                                                                           \
+  else                                 /* At the median */                    \
+  {                                                                           \
+    median_heap_##sfx##_max_down(mh, -1);                                     \
+    median_heap_##sfx##_min_down(mh, 1);                                      \
+  }                                                                           \
+  return mh->data[mh->heap[0]];                                               \
+}                                                                             \
+                                                                              \
+void median_heap_##sfx##_init(median_heap_##sfx##_t* mh, type* data,          \
+                              int16_t* index, uint16_t size)                  \
+{                                                                             \
+  int k;                                                                      \
+                                                                              \
+  chDbgCheck((size > 0) && (size <= INT16_MAX));                              \
+                                                                              \
+  mh->data = data;                                                            \
+  mh->pos = index;                                                            \
+  mh->heap = index + size + size / 2;  /* Heap spans -size/2..(size-1)/2 */  \
+  mh->size = size;                                                            \
+  mh->count = 0;                                                              \
+  mh->idx = 0;                                                                \
+  for (k = 0; k < size; ++k)           /* Median, then alternate heaps */     \
+  {                                                                           \
+    mh->pos[k] = (int16_t)(((k + 1) / 2) * ((k & 1) ? -1 : 1));               \
+    mh->heap[mh->pos[k]] = (int16_t)k;                                        \
+  }                                                                           \
+}                                                                             \
+                                                                              \
+type median_heap_##sfx##_filter(median_heap_##sfx##_t* mh, type datum)        \
+{                                                                             \
+  return median_heap_##sfx##_push(mh, datum);                                 \
+}                                                                             \
+                                                                              \
+/* Filters interleaved frames, one filter per channel, out may be in */       \
+void median_heap_##sfx##_filter_buffer(median_heap_##sfx##_t* mh,             \
+                                       size_t channels, const type* in,       \
+                                       type* out, size_t frames)              \
+{                                                                             \
+  size_t c;                                                                   \
+                                                                              \
+  while (frames-- > 0)                                                        \
+  {                                                                           \
+    for (c = 0; c < channels; ++c)                                            \
+    {                                                                         \
+      *out++ = median_heap_##sfx##_push(&mh[c], *in++);                       \
+    }                                                                         \
+  }                                                                           \
+}
+
+MEDIAN_HEAP_DECLARE(u16, uint16_t)
+MEDIAN_HEAP_DECLARE(s16, int16_t)
+MEDIAN_HEAP_DECLARE(s32, int32_t)
+MEDIAN_HEAP_DECLARE(f, float)
+
 #endif /* MEDIAN_H_ */
@@ -0,0 +1,688 @@
+/*
+    ChibiOS - Copyright (C) 2006..2018 Giovanni Di Sirio
+
+    Licensed under the Apache License, Version 2.0 (the "License");
+    you may not use this file except in compliance with the License.
+    You may obtain a copy of the License at
+
+        http://www.apache.org/licenses/LICENSE-2.0
+
+    Unless required by applicable law or agreed to in writing, software
+    distributed under the License is distributed on an "AS IS" BASIS,
+    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+    See the License for the specific language governing permissions and
+    limitations under the License.
+*/
+
+/**
+ * @file    nand_ecc.c
+ * @brief   NAND software ECC engines source.
+ * @details Two engines are provided:
+ *          - Hamming, 3 bytes per 256 or 512 bytes step, corrects one bit
+ *            and detects two, computed a word at a time;
+ *          - BCH over GF(2^13), 13 * t bits per step, corrects t bits.
+ *          Page helpers store the codes in the spare area at a given offset,
+ *          after any metadata of the upper layer.
+ *
+ * @addtogroup nand_ecc
+ * @{
+ */
+
+#include "hal.h"
+
+#if (HAL_USE_NAND == TRUE) || defined(__DOXYGEN__)
+
+#include "nand_ecc.h"
+
+#include <string.h>
+
+/*===========================================================================*/
+/* Driver local definitions.                                                 */
+/*===========================================================================*/
+
+/**
+ * @brief   GF(2^13) primitive polynomial, x^13 + x^4 + x^3 + x + 1.
+ */
+#define GF_POLY                     0x201BU
+
+/**
+ * @brief   Multiplicative group order.
+ */
+#define GF_N                        ((1U << NANDECC_BCH_M) - 1U)
+
+static const struct NandEccVMT hamming_vmt;
+
+/*===========================================================================*/
+/* Driver exported variables.                                                */
+/*===========================================================================*/
+
+/**
+ * @brief   Hamming engine, 3 bytes of code for each 256 bytes.
+ */
+const NandEcc nandeccHamming256 = {&hamming_vmt, 256U, 3U};
+
+/**
+ * @brief   Hamming engine, 3 bytes of code for each 512 bytes.
+ */
+const NandEcc nandeccHamming512 = {&hamming_vmt, 512U, 3U};
+
+/*===========================================================================*/
+/* Driver local variables.                                                   */
+/*===========================================================================*/
+
+#if (NANDECC_BCH_USE_TABLES == TRUE) || defined(__DOXYGEN__)
+/**
+ * @brief   GF(2^13) logarithms, index 0 unused.
+ */
+static uint16_t gf_log[GF_N + 1U];
+
+/**
+ * @brief   GF(2^13) powers of alpha.
+ */
+static uint16_t gf_exp[GF_N];
+
+/**
+ * @brief   Tables built.
+ */
+static bool gf_ready;
+#endif
+
+/*===========================================================================*/
+/* Driver local functions.                                                   */
+/*===========================================================================*/
+
+static uint32_t parity32(uint32_t x) {
+
+  x ^= x >> 16;
+  x ^= x >> 8;
+  x ^= x >> 4;
+  return (0x6996U >> (x & 0xFU)) & 1U;
+}
+
+/*
+ * Hamming engine.
+ * The code holds a pair of parities for each bit of the bit address within
+ * the step: the parity of the bits having that address bit set and the
+ * parity of the others. A single flipped bit toggles exactly one bit of
+ * each pair and the set ones spell its address.
+ */
+static uint32_t hamming_code(const NandEcc *eccp, const uint8_t *data,
+                             uint32_t *nbits) {
+  static const uint32_t masks[5] = {
+    0xAAAAAAAAU, 0xCCCCCCCCU, 0xF0F0F0F0U, 0xFF00FF00U, 0xFFFF0000U
+  };
+  const uint32_t nwords = eccp->step_size / 4U;
+  uint32_t acc[8] = {0U};
+  uint32_t total = 0U, code = 0U, par, i, k;
+
+  /* Bytes are assembled little endian, the five low bits of the address
+     are then the bit position within the word and the others the word
+     index.*/
+  for (i = 0; i < nwords; i++) {
+    uint32_t w = (uint32_t)data[0] | ((uint32_t)data[1] << 8) |
+                 ((uint32_t)data[2] << 16) | ((uint32_t)data[3] << 24);
+    data += 4;
+    total ^= w;
+    for (k = 0; (i >> k) != 0U; k++) {
+      if (((i >> k) & 1U) != 0U) {
+        acc[k] ^= w;
+      }
+    }
+  }
+
+  par = parity32(total);
+  for (k = 0; k < 5U; k++) {
+    uint32_t p = parity32(total & masks[k]);
+    code |= (p << (2U * k)) | ((p ^ par) << ((2U * k) + 1U));
+  }
+  for (k = 0; (1U << k) < nwords; k++) {
+    uint32_t p = parity32(acc[k]);
+    code |= (p << (2U * (k + 5U))) | ((p ^ par) << ((2U * (k + 5U)) + 1U));
+  }
+  *nbits = k + 5U;
+  return code;
+}
+
+static void hamming_calculate(const void *instance, const uint8_t *data,
+                              uint8_t *code) {
+  uint32_t nbits;
+  uint32_t v = ~hamming_code(instance, data, &nbits);
+
+  code[0] = (uint8_t)v;
+  code[1] = (uint8_t)(v >> 8);
+  code[2] = (uint8_t)(v >> 16);
+}
+
+static int32_t hamming_correct(const void *instance, uint8_t *data,
+                               const uint8_t *stored, const uint8_t *calc) {
+  const NandEcc *eccp = instance;
+  uint32_t nbits = 0U, s, mask, addr, k;
+
+  while ((1U << nbits) < (eccp->step_size * 8U)) {
+    nbits++;
+  }
+  mask = (1U << (2U * nbits)) - 1U;
+  s = ((uint32_t)(stored[0] ^ calc[0]) |
+       ((uint32_t)(stored[1] ^ calc[1]) << 8) |
+       ((uint32_t)(stored[2] ^ calc[2]) << 16)) & mask;
+
+  if (s == 0U) {
+    return 0;
+  }
+  if (((s ^ (s >> 1)) & 0x555555U & mask) == (0x555555U & mask)) {
+    addr = 0U;
+    for (k = 0; k < nbits; k++) {
+      addr |= ((s >> (2U * k)) & 1U) << k;
+    }
+    data[addr >> 3] ^= (uint8_t)(1U << (addr & 7U));
+    return 1;
+  }
+  if ((s & (s - 1U)) == 0U) {
+    /* Single bit flip in the code itself, the data is good.*/
+    return 1;
+  }
+  return NANDECC_UNCORRECTABLE;
+}
+
+static const struct NandEccVMT hamming_vmt = {
+  hamming_calculate,
+  hamming_correct
+};
+
+#if NANDECC_BCH_USE_TABLES == TRUE
+/*
+ * GF(2^13) arithmetic over the log and antilog tables.
+ */
+static void gf_init(void) {
+  uint32_t i, x = 1U;
+
+  if (gf_ready) {
+    return;
+  }
+  for (i = 0; i < GF_N; i++) {
+    gf_exp[i] = (uint16_t)x;
+    gf_log[x] = (uint16_t)i;
+    x <<= 1;
+    if ((x & (1U << NANDECC_BCH_M)) != 0U) {
+      x ^= GF_POLY;
+    }
+  }
+  gf_log[0] = 0U;
+  gf_ready = true;
+}
+
+/* Sum of two logarithms modulo GF_N.*/
+static uint32_t gf_add_log(uint32_t a, uint32_t b) {
+
+  a += b;
+  return (a >= GF_N) ? a - GF_N : a;
+}
+
+static uint32_t gf_mul(uint32_t a, uint32_t b) {
+
+  if ((a == 0U) || (b == 0U)) {
+    return 0U;
+  }
+  return gf_exp[gf_add_log(gf_log[a], gf_log[b])];
+}
+
+static uint32_t gf_pow(uint32_t a, uint32_t e) {
+
+  if (a == 0U) {
+    return (e == 0U) ? 1U : 0U;
+  }
+  return gf_exp[(uint32_t)(((uint64_t)gf_log[a] * e) % GF_N)];
+}
+
+static uint32_t gf_inv(uint32_t a) {
+
+  return gf_exp[gf_add_log(GF_N - gf_log[a], 0U)];
+}
+
+#else /* NANDECC_BCH_USE_TABLES == FALSE */
+/*
+ * GF(2^13) arithmetic, no tables.
+ */
+static void gf_init(void) {
+}
+
+static uint32_t gf_mul(uint32_t a, uint32_t b) {
+  uint32_t r = 0U;
+
+  while (b != 0U) {
+    if ((b & 1U) != 0U) {
+      r ^= a;
+    }
+    b >>= 1;
+    a <<= 1;
+    if ((a & (1U << NANDECC_BCH_M)) != 0U) {
+      a ^= GF_POLY;
+    }
+  }
+  return r;
+}
+
+static uint32_t gf_pow(uint32_t a, uint32_t e) {
+  uint32_t r = 1U;
+
+  while (e != 0U) {
+    if ((e & 1U) != 0U) {
+      r = gf_mul(r, a);
+    }
+    a = gf_mul(a, a);
+    e >>= 1;
+  }
+  return r;
+}
+
+static uint32_t gf_inv(uint32_t a) {
+
+  return gf_pow(a, GF_N - 1U);
+}
+#endif /* NANDECC_BCH_USE_TABLES == FALSE */
+
+/*
+ * Left aligned multi word register helpers.
+ */
+static void reg_shl(uint32_t *reg, unsigned n) {
+  unsigned i;
+
+  for (i = 0; i < NANDECC_BCH_WORDS - 1U; i++) {
+    reg[i] = (reg[i] << n) | (reg[i + 1U] >> (32U - n));
+  }
+  reg[i] <<= n;
+}
+
+static void reg_xor(uint32_t *reg, const uint32_t *x) {
+  unsigned i;
+
+  for (i = 0; i < NANDECC_BCH_WORDS; i++) {
+    reg[i] ^= x[i];
+  }
+}
+
+static void bch_remainder(const NandEccBch *bchp, const uint8_t *data,
+                          uint8_t *code) {
+  uint32_t reg[NANDECC_BCH_WORDS] = {0U};
+  size_t i;
+
+  for (i = 0; i < bchp->step_size; i++) {
+    uint32_t top = (reg[0] >> 24) ^ data[i];
+    reg_shl(reg, 8U);
+    reg_xor(reg, bchp->table[top]);
+  }
+  for (i = 0; i < bchp->code_size; i++) {
+    code[i] = (uint8_t)(reg[i / 4U] >> (24U - (8U * (i % 4U))));
+  }
+}
+
+static void bch_calculate(const void *instance, const uint8_t *data,
+                          uint8_t *code) {
+  const NandEccBch *bchp = instance;
+  size_t i;
+
+  bch_remainder(bchp, data, code);
+  for (i = 0; i < bchp->code_size; i++) {
+    code[i] ^= bchp->erased[i];
+  }
+}
+
+/*
+ * The codeword is the step data, MSB first, followed by the code bits, the
+ * bit at stream position p is the coefficient of x^(n - 1 - p). The codes
+ * difference is the remainder of the error polynomial, its value at the
+ * generator roots gives the syndromes.
+ */
+static int32_t bch_correct(const void *instance, uint8_t *data,
+                           const uint8_t *stored, const uint8_t *calc) {
+  const NandEccBch *bchp = instance;
+  const uint32_t t = bchp->t;
+  const uint32_t k = (uint32_t)bchp->step_size * 8U;
+  const uint32_t n = k + bchp->bits;
+  uint32_t s[2U * NANDECC_BCH_MAX_T + 1U];
+  uint32_t c[2U * NANDECC_BCH_MAX_T + 2U], b[2U * NANDECC_BCH_MAX_T + 2U];
+  uint32_t tmp[2U * NANDECC_BCH_MAX_T + 2U];
+  uint32_t term[NANDECC_BCH_MAX_T + 1U];
+#if NANDECC_BCH_USE_TABLES == FALSE
+  uint32_t step[NANDECC_BCH_MAX_T + 1U];
+#endif
+  uint32_t pos[NANDECC_BCH_MAX_T];
+  uint32_t i, j, x, v, d, coef, l = 0U, m = 1U, bd = 1U, found = 0U;
+
+  /* Syndromes, odd ones by Horner evaluation, even ones by squaring.*/
+  for (j = 1; j <= 2U * t; j++) {
+    if ((j & 1U) == 0U) {
+      s[j] = gf_mul(s[j / 2U], s[j / 2U]);
+      continue;
+    }
+    x = gf_pow(2U, j);
+    v = 0U;
+    for (i = 0; i < bchp->bits; i++) {
+      v = gf_mul(v, x) ^ (((uint32_t)(stored[i / 8U] ^ calc[i / 8U]) >>
+                           (7U - (i % 8U))) & 1U);
+    }
+    s[j] = v;
+  }
+
+  /* Berlekamp-Massey, error locator polynomial in c[].*/
+  memset(c, 0, sizeof(c));
+  memset(b, 0, sizeof(b));
+  c[0] = 1U;
+  b[0] = 1U;
+  for (j = 0; j < 2U * t; j++) {
+    d = s[j + 1U];
+    for (i = 1; i <= l; i++) {
+      d ^= gf_mul(c[i], s[j + 1U - i]);
+    }
+    if (d == 0U) {
+      m++;
+      continue;
+    }
+    coef = gf_mul(d, gf_inv(bd));
+    memcpy(tmp, c, sizeof(c));
+    for (i = 0; i + m < 2U * NANDECC_BCH_MAX_T + 2U; i++) {
+      c[i + m] ^= gf_mul(coef, b[i]);
+    }
+    if (2U * l <= j) {
+      l = j + 1U - l;
+      memcpy(b, tmp, sizeof(b));
+      bd = d;
+      m = 1U;
+    }
+    else {
+      m++;
+    }
+  }
+  if (l > t) {
+    return NANDECC_UNCORRECTABLE;
+  }
+
+  /* Chien search, the locator vanishes at alpha^-d for an error at degree
+     d.*/
+#if NANDECC_BCH_USE_TABLES == TRUE
+  /* Terms kept as logarithms, each step subtracts i from the log of the
+     term of degree i. The constant term is 1.*/
+  for (i = 1; i <= l; i++) {
+    term[i] = (c[i] != 0U) ? gf_log[c[i]] : GF_N;
+  }
+  for (j = 0; (j < n) && (found < l); j++) {
+    v = 1U;
+    for (i = 1; i <= l; i++) {
+      if (term[i] != GF_N) {
+        v ^= gf_exp[term[i]];
+        term[i] = gf_add_log(term[i], GF_N - i);
+      }
+    }
+    if (v == 0U) {
+      pos[found++] = n - 1U - j;
+    }
+  }
+#else
+  for (i = 0; i <= l; i++) {
+    term[i] = c[i];
+    step[i] = gf_pow(2U, (GF_N - i) % GF_N);
+  }
+  for (j = 0; (j < n) && (found < l); j++) {
+    v = 0U;
+    for (i = 0; i <= l; i++) {
+      v ^= term[i];
+      term[i] = gf_mul(term[i], step[i]);
+    }
+    if (v == 0U) {
+      pos[found++] = n - 1U - j;
+    }
+  }
+#endif
+  if (found != l) {
+    return NANDECC_UNCORRECTABLE;
+  }
+
+  for (i = 0; i < found; i++) {
+    if (pos[i] < k) {
+      data[pos[i] / 8U] ^= (uint8_t)(0x80U >> (pos[i] % 8U));
+    }
+  }
+  return (int32_t)found;
+}
+
+static const struct NandEccVMT bch_vmt = {
+  bch_calculate,
+  bch_correct
+};
+
+/*===========================================================================*/
+/* Driver interrupt handlers.                                                */
+/*===========================================================================*/
+
+/*===========================================================================*/
+/* Driver exported functions.                                                */
+/*===========================================================================*/
+
+/**
+ * @brief   Initializes a BCH engine.
+ * @details Builds the generator polynomial and the encoding table, the
+ *          object can be shared afterward by any number of users. The
+ *          first call also builds the field tables.
+ *
+ * @param[out] bchp         pointer to the @p NandEccBch object
+ * @param[in] step_size     data bytes covered by a code
+ * @param[in] t             correctable bits per step, up to
+ *                          @p NANDECC_BCH_MAX_T
+ *
+ * @init
+ */
+void nandeccBchObjectInit(NandEccBch *bchp, size_t step_size, uint32_t t) {
+  uint32_t g[NANDECC_BCH_M * NANDECC_BCH_MAX_T + 1U];
+  uint32_t reg[NANDECC_BCH_WORDS];
+  uint8_t code[NANDECC_MAX_CODE_SIZE];
+  uint32_t deg = 0U, i, j, r, top;
+  size_t done;
+
+  osalDbgCheck((bchp != NULL) && (t >= 1U) && (t <= NANDECC_BCH_MAX_T));
+  osalDbgCheck((step_size > 0U) &&
+               ((step_size * 8U) + (NANDECC_BCH_M * t) <= GF_N));
+
+  gf_init();
+
+  /* Generator polynomial, product of (x + alpha^r) over the cyclotomic
+     cosets of alpha^1, alpha^3, ..., alpha^(2t - 1).*/
+  memset(g, 0, sizeof(g));
+  g[0] = 1U;
+  for (i = 1; i < 2U * t; i += 2U) {
+    bool seen = false;
+
+    /* Skipping cosets already included through a smaller odd member.*/
+    r = i;
+    do {
+      if (((r & 1U) != 0U) && (r < i)) {
+        seen = true;
+      }
+      r = (r * 2U) % GF_N;
+    } while (r != i);
+    if (seen) {
+      continue;
+    }
+    r = i;
+    do {
+      uint32_t root = gf_pow(2U, r);
+      deg++;
+      for (j = deg; j > 0U; j--) {
+        g[j] = g[j - 1U] ^ gf_mul(g[j], root);
+      }
+      g[0] = gf_mul(g[0], root);
+      r = (r * 2U) % GF_N;
+    } while (r != i);
+  }
+
+  bchp->vmt       = &bch_vmt;
+  bchp->step_size = step_size;
+  bchp->t         = t;
+  bchp->bits      = deg;
+  bchp->code_size = (deg + 7U) / 8U;
+  memset(bchp->gen, 0, sizeof(bchp->gen));
+  for (j = 0; j < deg; j++) {
+    uint32_t e = deg - 1U - j;
+    if (g[j] != 0U) {
+      bchp->gen[e / 32U] |= 0x80000000U >> (e % 32U);
+    }
+  }
+
+  /* Byte remainders, computed a bit at a time.*/
+  for (top = 0; top < 256U; top++) {
+    uint32_t *reg = bchp->table[top];
+
+    memset(reg, 0, sizeof(bchp->table[top]));
+    for (i = 0; i < 8U; i++) {
+      uint32_t fb = (reg[0] >> 31) ^ ((top >> (7U - i)) & 1U);
+      reg_shl(reg, 1U);
+      if (fb != 0U) {
+        reg_xor(reg, bchp->gen);
+      }
+    }
+  }
+
+  /* The code of an erased step is mapped to all ones, the code being
+     linear the mask is simply applied to both stored and computed codes.*/
+  memset(reg, 0, sizeof(reg));
+  for (done = 0; done < step_size; done++) {
+    top = (reg[0] >> 24) ^ 0xFFU;
+    reg_shl(reg, 8U);
+    reg_xor(reg, bchp->table[top]);
+  }
+  memset(bchp->erased, 0, sizeof(bchp->erased));
+  for (i = 0; i < bchp->code_size; i++) {
+    code[i] = (uint8_t)(reg[i / 4U] >> (24U - (8U * (i % 4U))));
+    bchp->erased[i] = (uint8_t)~code[i];
+  }
+}
+
+/**
+ * @brief   Computes the codes of a page.
+ *
+ * @param[in] eccp          pointer to the @p NandEcc engine
+ * @param[in] data          page data
+ * @param[in] datalen       data bytes, multiple of the step size
+ * @param[out] codes        codes buffer, @p nandeccCodeSize() bytes
+ *
+ * @api
+ */
+void nandeccCalculatePage(const NandEcc *eccp, const uint8_t *data,
+                          size_t datalen, uint8_t *codes) {
+
+  osalDbgCheck((eccp != NULL) && ((datalen % eccp->step_size) == 0U));
+
+  while (datalen > 0U) {
+    eccp->vmt->calculate(eccp, data, codes);
+    data    += eccp->step_size;
+    codes   += eccp->code_size;
+    datalen -= eccp->step_size;
+  }
+}
+
+/**
+ * @brief   Checks and corrects the data of a page.
+ *
+ * @param[in] eccp          pointer to the @p NandEcc engine
+ * @param[in,out] data      page data
+ * @param[in] datalen       data bytes, multiple of the step size
+ * @param[in] codes         codes read from the spare area
+ * @return                  The largest number of bits corrected in a
+ *                          single step or @p NANDECC_UNCORRECTABLE.
+ *
+ * @api
+ */
+int32_t nandeccCorrectPage(const NandEcc *eccp, uint8_t *data,
+                           size_t datalen, const uint8_t *codes) {
+  uint8_t calc[NANDECC_MAX_CODE_SIZE];
+  int32_t worst = 0;
+
+  osalDbgCheck((eccp != NULL) && ((datalen % eccp->step_size) == 0U));
+
+  while (datalen > 0U) {
+    int32_t r;
+
+    eccp->vmt->calculate(eccp, data, calc);
+    if (memcmp(calc, codes, eccp->code_size) != 0) {
+      r = eccp->vmt->correct(eccp, data, codes, calc);
+      if (r == NANDECC_UNCORRECTABLE) {
+        return NANDECC_UNCORRECTABLE;
+      }
+      if (r > worst) {
+        worst = r;
+      }
+    }
+    data    += eccp->step_size;
+    codes   += eccp->code_size;
+    datalen -= eccp->step_size;
+  }
+  return worst;
+}
+
+/**
+ * @brief   Writes a whole page protected by ECC.
+ * @details The codes are computed on the page data and stored in the buffer
+ *          at @p offset bytes from the beginning of the spare area, then
+ *          data, spare bytes before the codes and codes are written.
+ *
+ * @param[in] nandp         pointer to the @p NANDDriver object
+ * @param[in] die           die number in nand flash
+ * @param[in] logun         logical unit number in nand flash
+ * @param[in] plane         plane number in nand flash
+ * @param[in] block         block number
+ * @param[in] page          page number related to begin of block
+ * @param[in,out] buf       page data followed by the spare area
+ * @param[in] eccp          pointer to the @p NandEcc engine
+ * @param[in] offset        offset of the codes in the spare area
+ *
+ * @return    The operation status reported by NAND IC (0x70 command).
+ *
+ * @api
+ */
+uint8_t nandeccWritePage(NANDDriver *nandp, uint32_t die, uint32_t logun,
+                         uint32_t plane, uint32_t block, uint32_t page,
+                         uint8_t *buf, const NandEcc *eccp, size_t offset) {
+  const size_t ds = nandp->config->page_data_size;
+
+  osalDbgCheck(offset + nandeccCodeSize(eccp, ds) <=
+               nandp->config->page_spare_size);
+
+  nandeccCalculatePage(eccp, buf, ds, &buf[ds + offset]);
+  return nandWritePageWhole(nandp, die, logun, plane, block, page, buf,
+                            ds + offset + nandeccCodeSize(eccp, ds));
+}
+
+/**
+ * @brief   Reads a whole page protected by ECC.
+ * @details Reads the page data and the spare area up to the end of the
+ *          codes, then corrects the data.
+ *
+ * @param[in] nandp         pointer to the @p NANDDriver object
+ * @param[in] die           die number in nand flash
+ * @param[in] logun         logical unit number in nand flash
+ * @param[in] plane         plane number in nand flash
+ * @param[in] block         block number
+ * @param[in] page          page number related to begin of block
+ * @param[out] buf          page data followed by the spare area
+ * @param[in] eccp          pointer to the @p NandEcc engine
+ * @param[in] offset        offset of the codes in the spare area
+ * @return                  The largest number of bits corrected in a
+ *                          single step or @p NANDECC_UNCORRECTABLE.
+ *
+ * @api
+ */
+int32_t nandeccReadPage(NANDDriver *nandp, uint32_t die, uint32_t logun,
+                        uint32_t plane, uint32_t block, uint32_t page,
+                        uint8_t *buf, const NandEcc *eccp, size_t offset) {
+  const size_t ds = nandp->config->page_data_size;
+
+  osalDbgCheck(offset + nandeccCodeSize(eccp, ds) <=
+               nandp->config->page_spare_size);
+
+  nandReadPageWhole(nandp, die, logun, plane, block, page, buf,
+                    ds + offset + nandeccCodeSize(eccp, ds));
+  return nandeccCorrectPage(eccp, buf, ds, &buf[ds + offset]);
+}
+
+#endif /* HAL_USE_NAND */
+
+/** @} */
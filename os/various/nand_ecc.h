@@ -0,0 +1,201 @@
+/*
+    ChibiOS - Copyright (C) 2006..2018 Giovanni Di Sirio
+
+    Licensed under the Apache License, Version 2.0 (the "License");
+    you may not use this file except in compliance with the License.
+    You may obtain a copy of the License at
+
+        http://www.apache.org/licenses/LICENSE-2.0
+
+    Unless required by applicable law or agreed to in writing, software
+    distributed under the License is distributed on an "AS IS" BASIS,
+    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+    See the License for the specific language governing permissions and
+    limitations under the License.
+*/
+
+/**
+ * @file    nand_ecc.h
+ * @brief   NAND software ECC engines header.
+ *
+ * @addtogroup nand_ecc
+ * @{
+ */
+
+#ifndef NAND_ECC_H_
+#define NAND_ECC_H_
+
+#if (HAL_USE_NAND == TRUE) || defined(__DOXYGEN__)
+
+/*===========================================================================*/
+/* Driver constants.                                                         */
+/*===========================================================================*/
+
+/**
+ * @brief   Returned by the correction functions when the data cannot be
+ *          recovered.
+ */
+#define NANDECC_UNCORRECTABLE       (-1)
+
+/**
+ * @brief   Largest code size of a single ECC step.
+ */
+#define NANDECC_MAX_CODE_SIZE       16U
+
+/**
+ * @brief   Galois field order of the BCH engine, GF(2^13).
+ * @details Steps up to 1010 bytes are supported.
+ */
+#define NANDECC_BCH_M               13U
+
+/*===========================================================================*/
+/* Driver pre-compile time settings.                                         */
+/*===========================================================================*/
+
+/**
+ * @name    Configuration options
+ * @{
+ */
+/**
+ * @brief   Largest number of bit errors corrected by the BCH engine in a
+ *          single step.
+ * @note    The size of @p NandEccBch objects grows with this value, about
+ *          1KiB every 2.5 bits.
+ */
+#if !defined(NANDECC_BCH_MAX_T) || defined(__DOXYGEN__)
+#define NANDECC_BCH_MAX_T           8U
+#endif
+
+/**
+ * @brief   GF(2^13) log and antilog tables for the BCH decoder.
+ * @details The tables are built by the first @p nandeccBchObjectInit(),
+ *          when disabled the field arithmetic works a bit at a time and
+ *          correcting t bits is several times slower.
+ * @note    The tables take 32KiB of RAM.
+ */
+#if !defined(NANDECC_BCH_USE_TABLES) || defined(__DOXYGEN__)
+#define NANDECC_BCH_USE_TABLES      TRUE
+#endif
+/** @} */
+
+/*===========================================================================*/
+/* Derived constants and error checks.                                       */
+/*===========================================================================*/
+
+#if (NANDECC_BCH_MAX_T < 1U) || (NANDECC_BCH_MAX_T > 9U)
+#error "NANDECC_BCH_MAX_T must be within 1 and 9"
+#endif
+
+/**
+ * @brief   Words of the BCH remainder register.
+ */
+#define NANDECC_BCH_WORDS                                                   \
+  (((NANDECC_BCH_M * NANDECC_BCH_MAX_T) + 31U) / 32U)
+
+/*===========================================================================*/
+/* Driver data structures and types.                                         */
+/*===========================================================================*/
+
+/**
+ * @brief   ECC engine methods.
+ */
+struct NandEccVMT {
+  /**
+   * @brief   Computes the code of a step.
+   */
+  void (*calculate)(const void *instance, const uint8_t *data,
+                    uint8_t *code);
+  /**
+   * @brief   Corrects a step given the stored and the computed codes.
+   * @return  The number of corrected bits or @p NANDECC_UNCORRECTABLE.
+   */
+  int32_t (*correct)(const void *instance, uint8_t *data,
+                     const uint8_t *stored, const uint8_t *calc);
+};
+
+/**
+ * @brief   @p NandEcc specific data.
+ */
+#define _nand_ecc_data                                                      \
+  /* Data bytes covered by a code.*/                                        \
+  size_t                    step_size;                                      \
+  /* Bytes of a code.*/                                                     \
+  size_t                    code_size;
+
+/**
+ * @brief   Base ECC engine.
+ * @details Codes of an erased step read as all ones, so erased pages are
+ *          valid and their bit flips are corrected as any other.
+ */
+typedef struct {
+  /** @brief Virtual Methods Table.*/
+  const struct NandEccVMT   *vmt;
+  _nand_ecc_data
+} NandEcc;
+
+/**
+ * @brief   BCH engine.
+ * @details Encoding is table driven, a byte per iteration. Decoding only
+ *          runs when the codes differ, its cost is in the order of n * t
+ *          field multiplications per step, see
+ *          @p NANDECC_BCH_USE_TABLES.
+ */
+typedef struct {
+  /** @brief Virtual Methods Table.*/
+  const struct NandEccVMT   *vmt;
+  _nand_ecc_data
+  /** @brief Correctable bits per step.*/
+  uint32_t                  t;
+  /** @brief Bits of a code, the generator polynomial degree.*/
+  uint32_t                  bits;
+  /** @brief Generator polynomial, left aligned, x^bits term omitted.*/
+  uint32_t                  gen[NANDECC_BCH_WORDS];
+  /** @brief Remainder of each byte value, left aligned.*/
+  uint32_t                  table[256][NANDECC_BCH_WORDS];
+  /** @brief Mask mapping the code of an erased step to all ones.*/
+  uint8_t                   erased[NANDECC_MAX_CODE_SIZE];
+} NandEccBch;
+
+/*===========================================================================*/
+/* Driver macros.                                                            */
+/*===========================================================================*/
+
+/**
+ * @brief   Spare bytes taken by the codes of @p datalen data bytes.
+ *
+ * @param[in] eccp      pointer to a @p NandEcc object
+ * @param[in] datalen   data bytes, multiple of the step size
+ */
+#define nandeccCodeSize(eccp, datalen)                                      \
+  (((datalen) / (eccp)->step_size) * (eccp)->code_size)
+
+/*===========================================================================*/
+/* External declarations.                                                    */
+/*===========================================================================*/
+
+extern const NandEcc nandeccHamming256;
+extern const NandEcc nandeccHamming512;
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+  void nandeccBchObjectInit(NandEccBch *bchp, size_t step_size, uint32_t t);
+  void nandeccCalculatePage(const NandEcc *eccp, const uint8_t *data,
+                            size_t datalen, uint8_t *codes);
+  int32_t nandeccCorrectPage(const NandEcc *eccp, uint8_t *data,
+                             size_t datalen, const uint8_t *codes);
+  uint8_t nandeccWritePage(NANDDriver *nandp, uint32_t die, uint32_t logun,
+                           uint32_t plane, uint32_t block, uint32_t page,
+                           uint8_t *buf, const NandEcc *eccp, size_t offset);
+  int32_t nandeccReadPage(NANDDriver *nandp, uint32_t die, uint32_t logun,
+                          uint32_t plane, uint32_t block, uint32_t page,
+                          uint8_t *buf, const NandEcc *eccp, size_t offset);
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* HAL_USE_NAND */
+
+#endif /* NAND_ECC_H_ */
+
+/** @} */
@@ -0,0 +1,774 @@
+/*
+    ChibiOS - Copyright (C) 2006..2018 Giovanni Di Sirio
+
+    Licensed under the Apache License, Version 2.0 (the "License");
+    you may not use this file except in compliance with the License.
+    You may obtain a copy of the License at
+
+        http://www.apache.org/licenses/LICENSE-2.0
+
+    Unless required by applicable law or agreed to in writing, software
+    distributed under the License is distributed on an "AS IS" BASIS,
+    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+    See the License for the specific language governing permissions and
+    limitations under the License.
+*/
+
+/**
+ * @file    nand_ftl.c
+ * @brief   NAND flash translation layer source.
+ * @details Page mapped, log structured FTL over the NAND driver:
+ *          - every host write is appended to the open block and the
+ *            previous copy of the logical page becomes stale;
+ *          - garbage collection reclaims the full block with the fewest
+ *            valid pages when the free pool runs low;
+ *          - free blocks are opened in erase count order (dynamic wear
+ *            leveling) and cold blocks are moved when the erase count
+ *            spread exceeds a threshold (static wear leveling);
+ *          - blocks failing program or erase are retired, their valid
+ *            pages are moved and the reserved pool replaces them.
+ *          The map is rebuilt at connection time from the metadata stored
+ *          in the spare area of each page. When an ECC engine is configured
+ *          its codes follow the metadata in the spare area.
+ * @note    The FTL is not reentrant, the caller must serialize accesses.
+ *
+ * @addtogroup nand_ftl
+ * @{
+ */
+
+#include "hal.h"
+
+#if (HAL_USE_NAND == TRUE) || defined(__DOXYGEN__)
+
+#include "nand_ftl.h"
+
+#include <string.h>
+
+/*===========================================================================*/
+/* Driver local definitions.                                                 */
+/*===========================================================================*/
+
+#define NO_BLOCK                    0xFFFFFFFFU
+
+/**
+ * @brief   Free blocks below which garbage collection runs.
+ */
+#define GC_FREE_THRESHOLD           3U
+
+/*===========================================================================*/
+/* Driver exported variables.                                                */
+/*===========================================================================*/
+
+/*===========================================================================*/
+/* Driver local variables.                                                   */
+/*===========================================================================*/
+
+/*===========================================================================*/
+/* Driver local functions.                                                   */
+/*===========================================================================*/
+
+typedef struct {
+  uint32_t      die;
+  uint32_t      logun;
+  uint32_t      plane;
+  uint32_t      block;
+} nand_addr_t;
+
+static uint32_t ppb(const NandFtl *ftlp) {
+
+  return ftlp->config->nandp->config->pages_per_block;
+}
+
+static uint32_t data_size(const NandFtl *ftlp) {
+
+  return ftlp->config->nandp->config->page_data_size;
+}
+
+/*
+ * Splits a block index relative to the FTL area in NAND coordinates.
+ */
+static nand_addr_t block_addr(const NandFtl *ftlp, uint32_t pb) {
+  const NANDConfig *cfg = ftlp->config->nandp->config;
+  uint32_t linear = ftlp->config->first_block + pb;
+  nand_addr_t a;
+
+  a.block  = linear % cfg->blocks;
+  linear  /= cfg->blocks;
+  a.plane  = linear % cfg->planes;
+  linear  /= cfg->planes;
+  a.logun  = linear % cfg->loguns;
+  a.die    = linear / cfg->loguns;
+  return a;
+}
+
+static void lock(NandFtl *ftlp) {
+
+#if NAND_USE_MUTUAL_EXCLUSION
+  nandAcquireBus(ftlp->config->nandp);
+#else
+  (void)ftlp;
+#endif
+}
+
+static void unlock(NandFtl *ftlp) {
+
+#if NAND_USE_MUTUAL_EXCLUSION
+  nandReleaseBus(ftlp->config->nandp);
+#else
+  (void)ftlp;
+#endif
+}
+
+static void read_spare(NandFtl *ftlp, uint32_t pb, uint32_t pg,
+                       nandftl_spare_t *spare) {
+  nand_addr_t a = block_addr(ftlp, pb);
+
+  nandReadPageSpare(ftlp->config->nandp, a.die, a.logun, a.plane, a.block,
+                    pg, spare, sizeof(nandftl_spare_t));
+}
+
+static bool spare_ours(const nandftl_spare_t *spare) {
+
+  return (spare->magic == NANDFTL_MAGIC) ||
+         (spare->magic == NANDFTL_MAGIC_LOST);
+}
+
+static bool spare_erased(const nandftl_spare_t *spare) {
+
+  return (spare->magic == 0xFFFFU) && (spare->lpn == 0xFFFFFFFFU) &&
+         (spare->seq == 0xFFFFFFFFU);
+}
+
+/*
+ * Reads a whole page in the page buffer, the data is corrected when an ECC
+ * engine is configured.
+ */
+static bool read_page(NandFtl *ftlp, uint32_t pb, uint32_t pg) {
+  nand_addr_t a = block_addr(ftlp, pb);
+  int32_t bits;
+
+  if (ftlp->config->ecc == NULL) {
+    nandReadPageWhole(ftlp->config->nandp, a.die, a.logun, a.plane, a.block,
+                      pg, ftlp->config->page_buf,
+                      data_size(ftlp) + sizeof(nandftl_spare_t));
+    return HAL_SUCCESS;
+  }
+  bits = nandeccReadPage(ftlp->config->nandp, a.die, a.logun, a.plane,
+                         a.block, pg, ftlp->config->page_buf,
+                         ftlp->config->ecc, sizeof(nandftl_spare_t));
+  if (bits == NANDECC_UNCORRECTABLE) {
+    ftlp->stats.ecc_failures++;
+    return HAL_FAILED;
+  }
+  ftlp->stats.ecc_corrected += (uint32_t)bits;
+  return HAL_SUCCESS;
+}
+
+/*
+ * Programs the page buffer content, data followed by the metadata and the
+ * ECC codes if any, in a single operation.
+ */
+static bool program_page(NandFtl *ftlp, uint32_t pb, uint32_t pg,
+                         uint32_t lpn, bool lost) {
+  nand_addr_t a = block_addr(ftlp, pb);
+  nandftl_spare_t spare;
+  uint8_t status;
+
+  spare.bbm         = 0xFFFFU;
+  spare.magic       = lost ? NANDFTL_MAGIC_LOST : NANDFTL_MAGIC;
+  spare.lpn         = lpn;
+  spare.seq         = ftlp->seq++;
+  spare.erase_count = ftlp->config->blocks[pb].erase_count;
+  memcpy(&ftlp->config->page_buf[data_size(ftlp)], &spare, sizeof(spare));
+
+  ftlp->stats.programs++;
+  if (ftlp->config->ecc != NULL) {
+    status = nandeccWritePage(ftlp->config->nandp, a.die, a.logun, a.plane,
+                              a.block, pg, ftlp->config->page_buf,
+                              ftlp->config->ecc, sizeof(spare));
+  }
+  else {
+    status = nandWritePageWhole(ftlp->config->nandp, a.die, a.logun, a.plane,
+                                a.block, pg, ftlp->config->page_buf,
+                                data_size(ftlp) + sizeof(spare));
+  }
+  return (status & NAND_STATUS_FAIL) != 0U;
+}
+
+static void retire_block(NandFtl *ftlp, uint32_t pb) {
+  nand_addr_t a = block_addr(ftlp, pb);
+
+  nandMarkBad(ftlp->config->nandp, a.die, a.logun, a.plane, a.block);
+  ftlp->config->blocks[pb].state = NANDFTL_BLK_BAD;
+  ftlp->stats.bad_blocks++;
+}
+
+static bool erase_block(NandFtl *ftlp, uint32_t pb) {
+  nandftl_block_t *blk = &ftlp->config->blocks[pb];
+  nand_addr_t a = block_addr(ftlp, pb);
+  uint8_t status;
+
+  ftlp->stats.erases++;
+  status = nandErase(ftlp->config->nandp, a.die, a.logun, a.plane, a.block);
+  if ((status & NAND_STATUS_FAIL) != 0U) {
+    retire_block(ftlp, pb);
+    return HAL_FAILED;
+  }
+  blk->erase_count++;
+  blk->valid = 0;
+  blk->state = NANDFTL_BLK_FREE;
+  ftlp->free_count++;
+  return HAL_SUCCESS;
+}
+
+/*
+ * Opens the free block with the lowest erase count.
+ */
+static uint32_t open_free_block(NandFtl *ftlp) {
+  const nandftl_block_t *blocks = ftlp->config->blocks;
+  uint32_t pb, best = NO_BLOCK;
+
+  for (pb = 0; pb < ftlp->config->nblocks; pb++) {
+    if ((blocks[pb].state == NANDFTL_BLK_FREE) &&
+        ((best == NO_BLOCK) ||
+         (blocks[pb].erase_count < blocks[best].erase_count))) {
+      best = pb;
+    }
+  }
+  if (best != NO_BLOCK) {
+    ftlp->config->blocks[best].state = NANDFTL_BLK_OPEN;
+    ftlp->free_count--;
+  }
+  return best;
+}
+
+static bool gc_collect(NandFtl *ftlp);
+static void wear_level(NandFtl *ftlp);
+
+/*
+ * Returns the next page of the open block, opening a new block if needed.
+ */
+static bool alloc_page(NandFtl *ftlp, uint32_t *pb, uint32_t *pg) {
+
+  /* Garbage collection and wear leveling may open a block themselves.*/
+  while (ftlp->open == NO_BLOCK) {
+    if (!ftlp->in_gc) {
+      uint32_t rounds = ftlp->config->nblocks;
+      while ((ftlp->free_count < GC_FREE_THRESHOLD) && (rounds-- > 0U)) {
+        if (gc_collect(ftlp)) {
+          break;
+        }
+      }
+      if (ftlp->open != NO_BLOCK) {
+        break;
+      }
+    }
+    ftlp->open = open_free_block(ftlp);
+    if (ftlp->open == NO_BLOCK) {
+      return HAL_FAILED;
+    }
+    ftlp->wp = 0;
+    if (!ftlp->in_gc) {
+      wear_level(ftlp);
+    }
+  }
+
+  *pb = ftlp->open;
+  *pg = ftlp->wp++;
+  if (ftlp->wp == ppb(ftlp)) {
+    ftlp->config->blocks[ftlp->open].state = NANDFTL_BLK_FULL;
+    ftlp->open = NO_BLOCK;
+  }
+  return HAL_SUCCESS;
+}
+
+/*
+ * Writes @p data as logical page @p lpn and updates the map. The data is
+ * copied in the page buffer after the allocation because garbage collection
+ * uses the same buffer. A @p lost page keeps failing host reads.
+ */
+static bool write_page(NandFtl *ftlp, uint32_t lpn, const uint8_t *data,
+                       bool lost) {
+  nandftl_block_t *blocks = ftlp->config->blocks;
+  uint32_t pb, pg, old;
+
+  while (true) {
+    if (alloc_page(ftlp, &pb, &pg)) {
+      return HAL_FAILED;
+    }
+    if (data != ftlp->config->page_buf) {
+      memcpy(ftlp->config->page_buf, data, data_size(ftlp));
+    }
+    if (!program_page(ftlp, pb, pg, lpn, lost)) {
+      break;
+    }
+    /* The block is closed, its valid pages are moved by the next garbage
+       collection before it is marked bad.*/
+    blocks[pb].state = NANDFTL_BLK_RETIRE;
+    if (ftlp->open == pb) {
+      ftlp->open = NO_BLOCK;
+    }
+  }
+
+  old = ftlp->config->l2p[lpn];
+  if (old != NANDFTL_NO_PAGE) {
+    blocks[old / ppb(ftlp)].valid--;
+  }
+  ftlp->config->l2p[lpn] = (pb * ppb(ftlp)) + pg;
+  blocks[pb].valid++;
+  return HAL_SUCCESS;
+}
+
+/*
+ * Moves the valid pages of a block elsewhere, then erases or retires it.
+ */
+static bool relocate_block(NandFtl *ftlp, uint32_t victim, uint32_t *moves) {
+  nandftl_block_t *blk = &ftlp->config->blocks[victim];
+  const nandftl_spare_t *spare =
+      (const nandftl_spare_t *)&ftlp->config->page_buf[data_size(ftlp)];
+  bool retire = (blk->state == NANDFTL_BLK_RETIRE);
+  uint32_t pg;
+  bool err = HAL_SUCCESS, lost;
+
+  ftlp->in_gc = true;
+  for (pg = 0; (pg < ppb(ftlp)) && (blk->valid > 0U); pg++) {
+    /* Uncorrectable pages are moved anyway, the metadata is not covered
+       by the ECC and the data is the best available. The copy gets valid
+       codes so it is marked lost, host reads keep failing.*/
+    lost = read_page(ftlp, victim, pg);
+    if (spare_ours(spare) && (spare->lpn < ftlp->lpages) &&
+        (ftlp->config->l2p[spare->lpn] == (victim * ppb(ftlp)) + pg)) {
+      if (lost && (spare->magic != NANDFTL_MAGIC_LOST)) {
+        ftlp->stats.ecc_lost++;
+      }
+      lost = lost || (spare->magic == NANDFTL_MAGIC_LOST);
+      if (write_page(ftlp, spare->lpn, ftlp->config->page_buf, lost)) {
+        err = HAL_FAILED;
+        break;
+      }
+      (*moves)++;
+    }
+  }
+  ftlp->in_gc = false;
+
+  if (err) {
+    return HAL_FAILED;
+  }
+  if (retire) {
+    retire_block(ftlp, victim);
+    return HAL_SUCCESS;
+  }
+  return erase_block(ftlp, victim);
+}
+
+/*
+ * Reclaims one block, retiring blocks first, then the full block with the
+ * fewest valid pages.
+ */
+static bool gc_collect(NandFtl *ftlp) {
+  const nandftl_block_t *blocks = ftlp->config->blocks;
+  uint32_t pb, victim = NO_BLOCK;
+
+  for (pb = 0; pb < ftlp->config->nblocks; pb++) {
+    if (blocks[pb].state == NANDFTL_BLK_RETIRE) {
+      victim = pb;
+      break;
+    }
+    if ((blocks[pb].state == NANDFTL_BLK_FULL) &&
+        ((victim == NO_BLOCK) ||
+         (blocks[pb].valid < blocks[victim].valid) ||
+         ((blocks[pb].valid == blocks[victim].valid) &&
+          (blocks[pb].erase_count < blocks[victim].erase_count)))) {
+      victim = pb;
+    }
+  }
+
+  if ((victim == NO_BLOCK) ||
+      ((blocks[victim].state == NANDFTL_BLK_FULL) &&
+       (blocks[victim].valid >= ppb(ftlp)))) {
+    /* Nothing to reclaim, the device is full.*/
+    return HAL_FAILED;
+  }
+  return relocate_block(ftlp, victim, &ftlp->stats.gc_moves);
+}
+
+/*
+ * Moves the coldest full block when the erase count spread is too large,
+ * its data is likely static and its block can take hot data instead.
+ */
+static void wear_level(NandFtl *ftlp) {
+  const nandftl_block_t *blocks = ftlp->config->blocks;
+  uint32_t pb, cold = NO_BLOCK, max = 0;
+
+  if (ftlp->config->wl_threshold == 0U) {
+    return;
+  }
+  for (pb = 0; pb < ftlp->config->nblocks; pb++) {
+    if (blocks[pb].state == NANDFTL_BLK_BAD) {
+      continue;
+    }
+    if (blocks[pb].erase_count > max) {
+      max = blocks[pb].erase_count;
+    }
+    if ((blocks[pb].state == NANDFTL_BLK_FULL) &&
+        ((cold == NO_BLOCK) ||
+         (blocks[pb].erase_count < blocks[cold].erase_count))) {
+      cold = pb;
+    }
+  }
+  if ((cold != NO_BLOCK) &&
+      (max - blocks[cold].erase_count > ftlp->config->wl_threshold)) {
+    (void)relocate_block(ftlp, cold, &ftlp->stats.wl_moves);
+  }
+}
+
+/*
+ * Rebuilds the map and the blocks state from the spare areas, fails on
+ * foreign blocks unless they can be reclaimed.
+ */
+static bool mount(NandFtl *ftlp) {
+  const NandFtlConfig *cfg = ftlp->config;
+  nandftl_block_t *blocks = cfg->blocks;
+  uint32_t pb, pg, last_pb = NO_BLOCK, last_wp = 0;
+  uint32_t ec_sum = 0, ec_known = 0;
+  bool have_seq = false;
+  nandftl_spare_t spare;
+
+  for (pb = 0; pb < ftlp->lpages; pb++) {
+    cfg->l2p[pb] = NANDFTL_NO_PAGE;
+  }
+  ftlp->seq = 0;
+  ftlp->open = NO_BLOCK;
+  ftlp->wp = 0;
+  ftlp->free_count = 0;
+
+  for (pb = 0; pb < cfg->nblocks; pb++) {
+    nand_addr_t a = block_addr(ftlp, pb);
+
+    blocks[pb].erase_count = 0;
+    blocks[pb].valid = 0;
+    if (nandIsBad(cfg->nandp, a.die, a.logun, a.plane, a.block, 0)) {
+      blocks[pb].state = NANDFTL_BLK_BAD;
+      continue;
+    }
+
+    read_spare(ftlp, pb, 0, &spare);
+    if (spare_erased(&spare)) {
+      blocks[pb].state = NANDFTL_BLK_FREE;
+      ftlp->free_count++;
+      continue;
+    }
+    if (!spare_ours(&spare)) {
+      /* Foreign content, reclaimed only if explicitly allowed.*/
+      if (!cfg->reclaim_foreign) {
+        return HAL_FAILED;
+      }
+      blocks[pb].state = NANDFTL_BLK_FULL;
+      (void)erase_block(ftlp, pb);
+      continue;
+    }
+
+    blocks[pb].state = NANDFTL_BLK_FULL;
+    blocks[pb].erase_count = spare.erase_count;
+    ec_sum += spare.erase_count;
+    ec_known++;
+
+    for (pg = 0; pg < ppb(ftlp); pg++) {
+      if (pg > 0U) {
+        read_spare(ftlp, pb, pg, &spare);
+      }
+      if (spare_erased(&spare)) {
+        break;
+      }
+      if (!spare_ours(&spare) || (spare.lpn >= ftlp->lpages)) {
+        continue;
+      }
+      if (!have_seq || (spare.seq >= ftlp->seq)) {
+        have_seq = true;
+        ftlp->seq = spare.seq;
+        last_pb = pb;
+        last_wp = pg + 1U;
+      }
+
+      uint32_t cur = cfg->l2p[spare.lpn];
+      if (cur != NANDFTL_NO_PAGE) {
+        nandftl_spare_t other;
+        read_spare(ftlp, cur / ppb(ftlp), cur % ppb(ftlp), &other);
+        if (other.seq > spare.seq) {
+          continue;
+        }
+        blocks[cur / ppb(ftlp)].valid--;
+      }
+      cfg->l2p[spare.lpn] = (pb * ppb(ftlp)) + pg;
+      blocks[pb].valid++;
+    }
+  }
+
+  /* Erase counts of erased blocks are not stored, the average of the
+     known ones is a fair estimate.*/
+  if (ec_known > 0U) {
+    for (pb = 0; pb < cfg->nblocks; pb++) {
+      if (blocks[pb].state == NANDFTL_BLK_FREE) {
+        blocks[pb].erase_count = ec_sum / ec_known;
+      }
+    }
+  }
+
+  /* Writing resumes after the most recently written page.*/
+  if ((last_pb != NO_BLOCK) && (last_wp < ppb(ftlp))) {
+    blocks[last_pb].state = NANDFTL_BLK_OPEN;
+    ftlp->open = last_pb;
+    ftlp->wp = last_wp;
+  }
+  if (have_seq) {
+    ftlp->seq++;
+  }
+  return HAL_SUCCESS;
+}
+
+/*
+ * Interface implementation.
+ */
+static bool is_inserted(void *instance) {
+  (void)instance;
+  return true;
+}
+
+static bool is_protected(void *instance) {
+  (void)instance;
+  return false;
+}
+
+static bool connect(void *instance) {
+  NandFtl *ftlp = instance;
+  bool err;
+
+  if (BLK_READY == ftlp->state) {
+    return HAL_SUCCESS;
+  }
+  lock(ftlp);
+  err = mount(ftlp);
+  unlock(ftlp);
+  if (!err) {
+    ftlp->state = BLK_READY;
+  }
+  return err;
+}
+
+static bool disconnect(void *instance) {
+  NandFtl *ftlp = instance;
+
+  if (BLK_READY == ftlp->state) {
+    ftlp->state = BLK_ACTIVE;
+  }
+  return HAL_SUCCESS;
+}
+
+static bool read(void *instance, uint32_t startblk,
+                 uint8_t *buffer, uint32_t n) {
+  NandFtl *ftlp = instance;
+  const uint32_t ds = data_size(ftlp);
+  bool err = HAL_SUCCESS;
+
+  if ((BLK_READY != ftlp->state) || (startblk + n > ftlp->lpages)) {
+    return HAL_FAILED;
+  }
+
+  lock(ftlp);
+  while (n > 0U) {
+    uint32_t ppn = ftlp->config->l2p[startblk];
+
+    if (ppn == NANDFTL_NO_PAGE) {
+      memset(buffer, 0xFF, ds);
+    }
+    else if (ftlp->config->ecc != NULL) {
+      const nandftl_spare_t *spare =
+          (const nandftl_spare_t *)&ftlp->config->page_buf[ds];
+
+      if (read_page(ftlp, ppn / ppb(ftlp), ppn % ppb(ftlp)) ||
+          (spare->magic == NANDFTL_MAGIC_LOST)) {
+        err = HAL_FAILED;
+        break;
+      }
+      memcpy(buffer, ftlp->config->page_buf, ds);
+    }
+    else {
+      nand_addr_t a = block_addr(ftlp, ppn / ppb(ftlp));
+      nandReadPageData(ftlp->config->nandp, a.die, a.logun, a.plane, a.block,
+                       ppn % ppb(ftlp), buffer, ds, NULL);
+    }
+    ftlp->stats.host_reads++;
+    startblk++;
+    buffer += ds;
+    n--;
+  }
+  unlock(ftlp);
+  return err;
+}
+
+static bool write(void *instance, uint32_t startblk,
+                  const uint8_t *buffer, uint32_t n) {
+  NandFtl *ftlp = instance;
+  const uint32_t ds = data_size(ftlp);
+  bool err = HAL_SUCCESS;
+
+  if ((BLK_READY != ftlp->state) || (startblk + n > ftlp->lpages)) {
+    return HAL_FAILED;
+  }
+
+  lock(ftlp);
+  while (n > 0U) {
+    if (write_page(ftlp, startblk, buffer, false)) {
+      err = HAL_FAILED;
+      break;
+    }
+    ftlp->stats.host_writes++;
+    startblk++;
+    buffer += ds;
+    n--;
+  }
+  unlock(ftlp);
+  return err;
+}
+
+static bool sync(void *instance) {
+  NandFtl *ftlp = instance;
+
+  /* Writes are not buffered.*/
+  if (BLK_READY != ftlp->state) {
+    return HAL_FAILED;
+  }
+  return HAL_SUCCESS;
+}
+
+static bool get_info(void *instance, BlockDeviceInfo *bdip) {
+  NandFtl *ftlp = instance;
+
+  if (BLK_READY != ftlp->state) {
+    return HAL_FAILED;
+  }
+  bdip->blk_num  = ftlp->lpages;
+  bdip->blk_size = data_size(ftlp);
+  return HAL_SUCCESS;
+}
+
+static const struct BaseBlockDeviceVMT vmt = {
+    (size_t)0,
+    is_inserted,
+    is_protected,
+    connect,
+    disconnect,
+    read,
+    write,
+    sync,
+    get_info
+};
+
+/*===========================================================================*/
+/* Driver interrupt handlers.                                                */
+/*===========================================================================*/
+
+/*===========================================================================*/
+/* Driver exported functions.                                                */
+/*===========================================================================*/
+
+/**
+ * @brief   NAND FTL object initialization.
+ *
+ * @param[in] ftlp      pointer to @p NandFtl object
+ *
+ * @init
+ */
+void nandftlObjectInit(NandFtl *ftlp) {
+
+  ftlp->vmt    = &vmt;
+  ftlp->state  = BLK_STOP;
+  ftlp->config = NULL;
+  ftlp->in_gc  = false;
+}
+
+/**
+ * @brief   Starts the NAND FTL.
+ * @details The FTL becomes usable after a successful @p blkConnect(), that
+ *          rebuilds the map from the NAND content.
+ *
+ * @param[in] ftlp      pointer to @p NandFtl object
+ * @param[in] config    pointer to the @p NandFtlConfig object
+ *
+ * @api
+ */
+void nandftlStart(NandFtl *ftlp, const NandFtlConfig *config) {
+
+  osalDbgCheck((ftlp != NULL) && (config != NULL) &&
+               (config->nandp != NULL) && (config->l2p != NULL) &&
+               (config->blocks != NULL) && (config->page_buf != NULL));
+  osalDbgCheck((config->reserved >= NANDFTL_MIN_RESERVED) &&
+               (config->nblocks > config->reserved));
+  osalDbgCheck(config->nandp->config->page_spare_size >=
+               sizeof(nandftl_spare_t) +
+               ((config->ecc != NULL) ?
+                nandeccCodeSize(config->ecc,
+                                config->nandp->config->page_data_size) : 0U));
+  osalDbgAssert((ftlp->state == BLK_STOP) || (ftlp->state == BLK_ACTIVE),
+                "invalid state");
+
+  ftlp->config = config;
+  ftlp->lpages = NANDFTL_L2P_SIZE(config->nblocks, config->reserved,
+                                  config->nandp->config->pages_per_block);
+  ftlp->open   = NO_BLOCK;
+  memset(&ftlp->stats, 0, sizeof(ftlp->stats));
+  ftlp->state  = BLK_ACTIVE;
+}
+
+/**
+ * @brief   Stops the NAND FTL.
+ *
+ * @param[in] ftlp      pointer to @p NandFtl object
+ *
+ * @api
+ */
+void nandftlStop(NandFtl *ftlp) {
+
+  osalDbgCheck(ftlp != NULL);
+  osalDbgAssert((ftlp->state == BLK_STOP) || (ftlp->state == BLK_ACTIVE) ||
+                (ftlp->state == BLK_READY), "invalid state");
+
+  ftlp->config = NULL;
+  ftlp->state  = BLK_STOP;
+}
+
+/**
+ * @brief   Erases all the good blocks of the FTL area.
+ * @note    All data is lost, the FTL must be connected again afterward.
+ *
+ * @param[in] ftlp      pointer to @p NandFtl object
+ * @return              The operation status.
+ * @retval HAL_SUCCESS  operation succeeded.
+ * @retval HAL_FAILED   the FTL is not started.
+ *
+ * @api
+ */
+bool nandftlFormat(NandFtl *ftlp) {
+  uint32_t pb;
+
+  osalDbgCheck(ftlp != NULL);
+
+  if ((BLK_ACTIVE != ftlp->state) && (BLK_READY != ftlp->state)) {
+    return HAL_FAILED;
+  }
+
+  lock(ftlp);
+  for (pb = 0; pb < ftlp->config->nblocks; pb++) {
+    nand_addr_t a = block_addr(ftlp, pb);
+    if (!nandIsBad(ftlp->config->nandp, a.die, a.logun, a.plane, a.block, 0)) {
+      (void)nandErase(ftlp->config->nandp, a.die, a.logun, a.plane, a.block);
+    }
+  }
+  unlock(ftlp);
+  ftlp->state = BLK_ACTIVE;
+  return HAL_SUCCESS;
+}
+
+#endif /* HAL_USE_NAND */
+
+/** @} */
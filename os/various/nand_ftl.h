@@ -0,0 +1,263 @@
+/*
+    ChibiOS - Copyright (C) 2006..2018 Giovanni Di Sirio
+
+    Licensed under the Apache License, Version 2.0 (the "License");
+    you may not use this file except in compliance with the License.
+    You may obtain a copy of the License at
+
+        http://www.apache.org/licenses/LICENSE-2.0
+
+    Unless required by applicable law or agreed to in writing, software
+    distributed under the License is distributed on an "AS IS" BASIS,
+    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+    See the License for the specific language governing permissions and
+    limitations under the License.
+*/
+
+/**
+ * @file    nand_ftl.h
+ * @brief   NAND flash translation layer header.
+ *
+ * @addtogroup nand_ftl
+ * @{
+ */
+
+#ifndef NAND_FTL_H_
+#define NAND_FTL_H_
+
+#if (HAL_USE_NAND == TRUE) || defined(__DOXYGEN__)
+
+#include "nand_ecc.h"
+
+/*===========================================================================*/
+/* Driver constants.                                                         */
+/*===========================================================================*/
+
+/**
+ * @brief   Unmapped logical page marker.
+ */
+#define NANDFTL_NO_PAGE             0xFFFFFFFFU
+
+/**
+ * @brief   Magic value identifying pages written by the FTL.
+ */
+#define NANDFTL_MAGIC               0x4654U
+
+/**
+ * @brief   Magic value of pages moved after an uncorrectable ECC error.
+ * @details The data is the best available but known bad, host reads of
+ *          the page fail until it is written again.
+ */
+#define NANDFTL_MAGIC_LOST          0x464CU
+
+/**
+ * @brief   Minimum number of blocks kept out of the logical capacity.
+ * @details One block is the open block, the others guarantee that garbage
+ *          collection always finds room for the pages it moves.
+ */
+#define NANDFTL_MIN_RESERVED        3U
+
+/*===========================================================================*/
+/* Driver pre-compile time settings.                                         */
+/*===========================================================================*/
+
+/*===========================================================================*/
+/* Derived constants and error checks.                                       */
+/*===========================================================================*/
+
+/*===========================================================================*/
+/* Driver data structures and types.                                         */
+/*===========================================================================*/
+
+/**
+ * @brief   Physical block states.
+ */
+typedef enum {
+  NANDFTL_BLK_FREE = 0,             /**< Erased, ready to be opened.     */
+  NANDFTL_BLK_OPEN = 1,             /**< Receiving writes.               */
+  NANDFTL_BLK_FULL = 2,             /**< All pages written.              */
+  NANDFTL_BLK_RETIRE = 3,           /**< Failed, valid pages to be moved.*/
+  NANDFTL_BLK_BAD = 4               /**< Bad, never used.                */
+} nandftlblkstate_t;
+
+/**
+ * @brief   Physical block descriptor.
+ */
+typedef struct {
+  /** @brief Number of erase cycles.*/
+  uint32_t      erase_count;
+  /** @brief Number of pages holding current data.*/
+  uint16_t      valid;
+  /** @brief Block state, see @p nandftlblkstate_t.*/
+  uint8_t       state;
+} nandftl_block_t;
+
+/**
+ * @brief   Metadata stored at the beginning of each page spare area.
+ * @note    The first half word is left erased, it is the bad block mark.
+ */
+typedef struct {
+  /** @brief Bad block mark, always 0xFFFF.*/
+  uint16_t      bbm;
+  /** @brief @p NANDFTL_MAGIC or @p NANDFTL_MAGIC_LOST for pages written
+             by the FTL.*/
+  uint16_t      magic;
+  /** @brief Logical page held by the page.*/
+  uint32_t      lpn;
+  /** @brief Write sequence number, the highest copy of a page wins.*/
+  uint32_t      seq;
+  /** @brief Erase count of the block when the page was written.*/
+  uint32_t      erase_count;
+} nandftl_spare_t;
+
+/**
+ * @brief   FTL statistics.
+ * @details Write amplification is @p programs / @p host_writes.
+ */
+typedef struct {
+  /** @brief Pages written by the host.*/
+  uint32_t      host_writes;
+  /** @brief Pages read by the host.*/
+  uint32_t      host_reads;
+  /** @brief Page program operations issued to the NAND.*/
+  uint32_t      programs;
+  /** @brief Block erase operations issued to the NAND.*/
+  uint32_t      erases;
+  /** @brief Pages moved by garbage collection.*/
+  uint32_t      gc_moves;
+  /** @brief Pages moved by static wear leveling.*/
+  uint32_t      wl_moves;
+  /** @brief Blocks retired at run time.*/
+  uint32_t      bad_blocks;
+  /** @brief Bits corrected by the ECC engine.*/
+  uint32_t      ecc_corrected;
+  /** @brief Pages the ECC engine could not correct.*/
+  uint32_t      ecc_failures;
+  /** @brief Uncorrectable pages moved and marked as lost.*/
+  uint32_t      ecc_lost;
+} nandftl_stats_t;
+
+/**
+ * @brief   FTL configuration.
+ */
+typedef struct {
+  /**
+   * @brief   NAND driver, started by the application.
+   */
+  NANDDriver            *nandp;
+  /**
+   * @brief   First physical block used by the FTL.
+   * @details Blocks are numbered linearly across planes, logical units and
+   *          dies.
+   */
+  uint32_t              first_block;
+  /**
+   * @brief   Number of physical blocks used by the FTL.
+   */
+  uint32_t              nblocks;
+  /**
+   * @brief   Blocks kept out of the logical capacity.
+   * @details At least @p NANDFTL_MIN_RESERVED, blocks going bad are taken
+   *          from this pool.
+   */
+  uint32_t              reserved;
+  /**
+   * @brief   Erase count spread triggering static wear leveling.
+   * @note    Zero disables static wear leveling, free blocks are still
+   *          allocated in erase count order.
+   */
+  uint32_t              wl_threshold;
+  /**
+   * @brief   Logical to physical page map.
+   * @details (nblocks - reserved) * pages_per_block entries.
+   */
+  uint32_t              *l2p;
+  /**
+   * @brief   Physical blocks descriptors, @p nblocks entries.
+   */
+  nandftl_block_t       *blocks;
+  /**
+   * @brief   Page buffer, page_data_size + page_spare_size bytes.
+   * @note    Half word aligned.
+   */
+  uint8_t               *page_buf;
+  /**
+   * @brief   ECC engine protecting the page data, @p NULL if none.
+   * @details The codes are stored in the spare area after the metadata.
+   */
+  const NandEcc         *ecc;
+  /**
+   * @brief   Erases blocks holding foreign content when connecting.
+   * @details A block whose first page is neither erased nor written by the
+   *          FTL is data of another user of the NAND, when @p false
+   *          @p blkConnect() fails on it and @p nandftlFormat() must be
+   *          called explicitly.
+   */
+  bool                  reclaim_foreign;
+} NandFtlConfig;
+
+typedef struct NandFtl NandFtl;
+
+#define _nand_ftl_device_data                                               \
+  _base_block_device_data                                                   \
+  const NandFtlConfig       *config;                                        \
+  uint32_t                  lpages;                                         \
+  uint32_t                  open;                                           \
+  uint32_t                  wp;                                             \
+  uint32_t                  free_count;                                     \
+  uint32_t                  seq;                                            \
+  bool                      in_gc;                                          \
+  nandftl_stats_t           stats;
+
+/**
+ * @brief   NAND FTL object, it is a block device of page sized blocks.
+ */
+struct NandFtl {
+  /** @brief Virtual Methods Table.*/
+  const struct BaseBlockDeviceVMT *vmt;
+  _nand_ftl_device_data
+};
+
+/*===========================================================================*/
+/* Driver macros.                                                            */
+/*===========================================================================*/
+
+/**
+ * @brief   Number of l2p entries needed by a configuration.
+ *
+ * @param[in] nblocks       number of physical blocks
+ * @param[in] reserved      number of reserved blocks
+ * @param[in] ppb           pages per block
+ */
+#define NANDFTL_L2P_SIZE(nblocks, reserved, ppb)                            \
+  (((nblocks) - (reserved)) * (ppb))
+
+/**
+ * @brief   Returns a pointer to the FTL statistics.
+ *
+ * @param[in] ftlp      pointer to @p NandFtl object
+ *
+ * @api
+ */
+#define nandftlGetStats(ftlp) (&(ftlp)->stats)
+
+/*===========================================================================*/
+/* External declarations.                                                    */
+/*===========================================================================*/
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+  void nandftlObjectInit(NandFtl *ftlp);
+  void nandftlStart(NandFtl *ftlp, const NandFtlConfig *config);
+  void nandftlStop(NandFtl *ftlp);
+  bool nandftlFormat(NandFtl *ftlp);
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* HAL_USE_NAND */
+
+#endif /* NAND_FTL_H_ */
+
+/** @} */
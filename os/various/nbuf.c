@@ -0,0 +1,210 @@
+/*
+    ChibiOS - Copyright (C) 2006..2018 Giovanni Di Sirio
+
+    Licensed under the Apache License, Version 2.0 (the "License");
+    you may not use this file except in compliance with the License.
+    You may obtain a copy of the License at
+
+        http://www.apache.org/licenses/LICENSE-2.0
+
+    Unless required by applicable law or agreed to in writing, software
+    distributed under the License is distributed on an "AS IS" BASIS,
+    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+    See the License for the specific language governing permissions and
+    limitations under the License.
+*/
+
+#include "osal.h"
+#include "nbuf.h"
+
+/**
+ * @file    nbuf.c
+ * @brief   Lock-free N-buffer handler source.
+ *
+ * @addtogroup NBuf
+ * @{
+ */
+
+/*===========================================================================*/
+/* Driver local definitions.                                                 */
+/*===========================================================================*/
+
+#define NBUF_STATE(index, seq)    ((uint32_t)(index) | ((uint32_t)(seq) << 8))
+#define NBUF_STATE_INDEX(state)   ((size_t)((state) & 0xFFU))
+#define NBUF_STATE_SEQ(state)     ((state) >> 8)
+
+/*
+ * Sequentially consistent accesses: a consumer pins a buffer and then
+ * checks that it is still the front one, the producer publishes a new front
+ * buffer and then looks for a buffer nobody pins, neither of the two pairs
+ * may be reordered.
+ */
+#define nbuf_load(p)              __atomic_load_n((p), __ATOMIC_SEQ_CST)
+#define nbuf_store(p, v)          __atomic_store_n((p), (v), __ATOMIC_SEQ_CST)
+
+#if defined(__ARM_ARCH_6M__) || defined(__DOXYGEN__)
+/* No exclusive access instructions, the counters are updated in a
+   critical zone.*/
+#define nbuf_add(p, v)            nbuf_add_locked((p), (v))
+#else
+/* LDREX/STREX loop on Cortex-M3 and later.*/
+#define nbuf_add(p, v)            ((void)__atomic_add_fetch((p), (v),       \
+                                                     __ATOMIC_SEQ_CST))
+#endif
+
+/*===========================================================================*/
+/* Driver exported variables.                                                */
+/*===========================================================================*/
+
+/*===========================================================================*/
+/* Driver local variables and types.                                         */
+/*===========================================================================*/
+
+/*===========================================================================*/
+/* Driver local functions.                                                   */
+/*===========================================================================*/
+
+#if defined(__ARM_ARCH_6M__) || defined(__DOXYGEN__)
+/**
+ * @brief   Adds to a reference counter from any context.
+ *
+ * @param[in] p         Pointer to the counter.
+ * @param[in] v         Value added.
+ */
+static void nbuf_add_locked(volatile uint32_t *p, uint32_t v) {
+
+  syssts_t sts;
+
+  sts = osalSysGetStatusAndLockX();
+  *p += v;
+  osalSysRestoreStatusX(sts);
+}
+#endif
+
+/*===========================================================================*/
+/* Driver interrupt handlers.                                                */
+/*===========================================================================*/
+
+/*===========================================================================*/
+/* Driver exported functions.                                                */
+/*===========================================================================*/
+
+/**
+ * @brief   Initializes the nbuf handler object.
+ * @details The first buffer is the initial front buffer, with sequence
+ *          number 0, the second one is the initial back buffer.
+ *
+ * @param[in] handler   Pointer to the nbuf handler object.
+ * @param[in] buffers   Array of buffer pointers.
+ * @param[in] n         Number of buffers, two plus the number of consumers
+ *                      which may read at the same time.
+ *
+ * @init
+ */
+void nbufObjectInit(nbuf_t *handler, void * const *buffers, size_t n) {
+
+  size_t i;
+
+  osalDbgCheck((handler != NULL) && (buffers != NULL));
+  osalDbgCheck((n >= 3U) && (n <= NBUF_MAX_BUFFERS));
+
+  for (i = 0; i < n; ++i) {
+    handler->buffers[i] = buffers[i];
+    handler->refs[i] = 0U;
+  }
+  handler->n = n;
+  handler->back = 1U;
+  handler->state = NBUF_STATE(0U, 0U);
+}
+
+/**
+ * @brief   Publishes the current back buffer.
+ *
+ * @details The back buffer, which holds new useful data, becomes the front
+ *          buffer. The next back buffer is one of the other buffers not
+ *          being read by any consumer.
+ * @note    Only the producer may call this function.
+ *
+ * @pre   There are fewer consumers reading at the same time than buffers
+ *        minus two, otherwise this function spins until a buffer gets
+ *        released.
+ * @post  A new front buffer is ready, its sequence number is incremented.
+ *
+ * @param[in] handler   Pointer to the nbuf handler object.
+ *
+ * @xclass
+ */
+void nbufSwapBackX(nbuf_t *handler) {
+
+  uint32_t state;
+  size_t front, i;
+
+  /* Only the producer writes the state, no read-modify-write needed.*/
+  front = handler->back;
+  state = NBUF_STATE(front, NBUF_STATE_SEQ(handler->state) + 1U);
+  nbuf_store(&handler->state, state);
+
+  i = front;
+  do {
+    i = (i + 1U < handler->n) ? (i + 1U) : 0U;
+  } while ((i == front) || (nbuf_load(&handler->refs[i]) != 0U));
+  handler->back = i;
+}
+
+/**
+ * @brief   Acquires the current front buffer.
+ *
+ * @details The buffer is pinned, the producer does not write it until
+ *          @p nbufReleaseFrontX() is called, even if newer frames get
+ *          published meanwhile.
+ *
+ * @param[in] handler   Pointer to the nbuf handler object.
+ * @param[out] seqp     Sequence number of the frame, may be @p NULL.
+ * @return  Pointer to the current front buffer.
+ *
+ * @xclass
+ */
+void *nbufAcquireFrontX(nbuf_t *handler, uint32_t *seqp) {
+
+  uint32_t state;
+  size_t i;
+
+  for (;;) {
+    state = nbuf_load(&handler->state);
+    i = NBUF_STATE_INDEX(state);
+    nbuf_add(&handler->refs[i], 1U);
+    if (nbuf_load(&handler->state) == state)
+      break;
+
+    /* A newer frame has been published meanwhile, the buffer may already
+       have been picked as back buffer.*/
+    nbuf_add(&handler->refs[i], (uint32_t)-1);
+  }
+
+  if (seqp != NULL)
+    *seqp = NBUF_STATE_SEQ(state);
+  return handler->buffers[i];
+}
+
+/**
+ * @brief   Releases a front buffer.
+ *
+ * @param[in] handler   Pointer to the nbuf handler object.
+ * @param[in] front     Pointer returned by @p nbufAcquireFrontX().
+ *
+ * @xclass
+ */
+void nbufReleaseFrontX(nbuf_t *handler, const void *front) {
+
+  size_t i;
+
+  for (i = 0; i < handler->n; ++i) {
+    if (handler->buffers[i] == front)
+      break;
+  }
+  osalDbgAssert(i < handler->n, "not a buffer of this handler");
+
+  nbuf_add(&handler->refs[i], (uint32_t)-1);
+}
+
+/** @} */
@@ -0,0 +1,133 @@
+/*
+    ChibiOS - Copyright (C) 2006..2018 Giovanni Di Sirio
+
+    Licensed under the Apache License, Version 2.0 (the "License");
+    you may not use this file except in compliance with the License.
+    You may obtain a copy of the License at
+
+        http://www.apache.org/licenses/LICENSE-2.0
+
+    Unless required by applicable law or agreed to in writing, software
+    distributed under the License is distributed on an "AS IS" BASIS,
+    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+    See the License for the specific language governing permissions and
+    limitations under the License.
+*/
+
+/**
+ * @file    nbuf.h
+ * @brief   Lock-free N-buffer handler header.
+ * @details Generalization of the triple buffer to one producer and several
+ *          consumers, all of them reading the latest frame published.
+ *          No kernel lock is taken, so any function may be called from
+ *          threads and ISRs alike.
+ *
+ * @addtogroup NBuf
+ * @{
+ */
+
+#ifndef NBUF_H_
+#define NBUF_H_
+
+/*===========================================================================*/
+/* Driver constants.                                                         */
+/*===========================================================================*/
+
+/*===========================================================================*/
+/* Driver pre-compile time settings.                                         */
+/*===========================================================================*/
+
+/**
+ * @name    N-buffer configuration options
+ * @{
+ */
+
+/**
+ * @brief   Maximum number of buffers of a handler.
+ * @note    A handler needs two buffers plus one per consumer reading at
+ *          the same time.
+ */
+#if !defined(NBUF_MAX_BUFFERS) || defined(__DOXYGEN__)
+#define NBUF_MAX_BUFFERS      8
+#endif
+
+/** @} */
+
+/*===========================================================================*/
+/* Derived constants and error checks.                                       */
+/*===========================================================================*/
+
+#if (NBUF_MAX_BUFFERS < 3) || (NBUF_MAX_BUFFERS > 256)
+#error "NBUF_MAX_BUFFERS must be in the 3..256 range"
+#endif
+
+/*===========================================================================*/
+/* Driver data structures and types.                                         */
+/*===========================================================================*/
+
+/**
+ * @brief   N-buffer handler object.
+ */
+typedef struct {
+  void *buffers[NBUF_MAX_BUFFERS];          /**< @brief Buffer pointers.*/
+  volatile uint32_t refs[NBUF_MAX_BUFFERS]; /**< @brief Consumers reading
+                                                        each buffer.*/
+  volatile uint32_t state;    /**< @brief Front buffer index in the low byte,
+                                          sequence number above.*/
+  size_t n;                   /**< @brief Number of buffers.*/
+  size_t back;                /**< @brief Back buffer index, owned by the
+                                          producer.*/
+} nbuf_t;
+
+/*===========================================================================*/
+/* Driver macros.                                                            */
+/*===========================================================================*/
+
+/**
+ * @brief   Gets the sequence number of the current front buffer.
+ * @details The number is incremented by each @p nbufSwapBack() and wraps
+ *          around on 24 bits, consumers poll it to detect new frames.
+ *
+ * @param[in] handler   Pointer to the nbuf handler object.
+ * @return  Sequence number of the front buffer.
+ *
+ * @xclass
+ */
+static inline
+uint32_t nbufGetSequenceX(nbuf_t *handler) {
+
+  return handler->state >> 8;
+}
+
+/**
+ * @brief   Gets the current back buffer.
+ * @note    Only the producer may call this function.
+ *
+ * @param[in] handler   Pointer to the nbuf handler object.
+ * @return  Pointer to the current back buffer.
+ *
+ * @xclass
+ */
+static inline
+void *nbufGetBackX(nbuf_t *handler) {
+
+  return handler->buffers[handler->back];
+}
+
+/*===========================================================================*/
+/* External declarations.                                                    */
+/*===========================================================================*/
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+  void nbufObjectInit(nbuf_t *handler, void * const *buffers, size_t n);
+  void nbufSwapBackX(nbuf_t *handler);
+  void *nbufAcquireFrontX(nbuf_t *handler, uint32_t *seqp);
+  void nbufReleaseFrontX(nbuf_t *handler, const void *front);
+#ifdef __cplusplus
+}
+#endif
+
+#endif  /* NBUF_H_ */
+/** @} */
@@ -134,6 +134,13 @@
 #define NAND_USE_MUTUAL_EXCLUSION   TRUE
 #endif
 
+/**
+ * @brief   Enables the on-flash bad block table.
+ */
+#if !defined(NAND_USE_BBT) || defined(__DOXYGEN__)
+#define NAND_USE_BBT                FALSE
+#endif
+
 /*===========================================================================*/
 /* 1-wire driver related settings.                                           */
 /*===========================================================================*/
@@ -192,6 +192,8 @@
 #define HAL_USBH_PORT_RESET_TIMEOUT                   500
 #define HAL_USBH_DEVICE_ADDRESS_STABILIZATION         20
 #define HAL_USBH_CONTROL_REQUEST_DEFAULT_TIMEOUT	  OSAL_MS2I(1000)
+#define HAL_USBH_USE_MAIN_THREAD                      FALSE
+#define HAL_USBH_USE_PARALLEL_ENUMERATION             FALSE
 
 /* MSD */
 #define HAL_USBH_USE_MSD                              TRUE
@@ -210,6 +212,8 @@
 #define HAL_USBHFTDI_DEFAULT_HANDSHAKE                USBHFTDI_HANDSHAKE_NONE
 #define HAL_USBHFTDI_DEFAULT_XON                      0x11
 #define HAL_USBHFTDI_DEFAULT_XOFF                     0x13
+#define HAL_USBHFTDI_IN_URBS                          2
+#define HAL_USBHFTDI_OUT_URBS                         2
 
 /* AOA */
 #define HAL_USBH_USE_AOA                              TRUE
@@ -225,6 +229,8 @@
 #define HAL_USBHAOA_DEFAULT_URI                       NULL
 #define HAL_USBHAOA_DEFAULT_SERIAL                    NULL
 #define HAL_USBHAOA_DEFAULT_AUDIO_MODE                USBHAOA_AUDIO_MODE_DISABLED
+#define HAL_USBHAOA_IN_URBS                           2
+#define HAL_USBHAOA_OUT_URBS                          2
 
 /* UVC */
 #define HAL_USBH_USE_UVC                              TRUE
@@ -233,11 +239,13 @@
 #define HAL_USBHUVC_MAX_MAILBOX_SZ                    70
 #define HAL_USBHUVC_WORK_RAM_SIZE                     20000
 #define HAL_USBHUVC_STATUS_PACKETS_COUNT              10
+#define HAL_USBHUVC_USE_FRAME_ASSEMBLY                FALSE
 
 /* HID */
 #define HAL_USBH_USE_HID                              TRUE
 #define HAL_USBHHID_MAX_INSTANCES                     2
 #define HAL_USBHHID_USE_INTERRUPT_OUT                 FALSE
+#define HAL_USBHHID_USE_REPORT_PARSER                 FALSE
 
 /* HUB */
 #define HAL_USBH_USE_HUB                              TRUE
@@ -149,6 +149,17 @@
  */
 #define ONEWIRE_USE_SEARCH_ROM      TRUE
 
+/**
+ * @brief   Enables the PWM bus master.
+ */
+#define ONEWIRE_USE_PWM             TRUE
+
+/**
+ * @brief   Enables the UART bus master.
+ * @note    Selected by setting the UART driver in the 1-wire configuration.
+ */
+#define ONEWIRE_USE_UART            FALSE
+
 /*===========================================================================*/
 /* QEI driver related settings.                                              */
 /*===========================================================================*/
@@ -0,0 +1,392 @@
+/*
+    ChibiOS - Copyright (C) 2006..2018 Giovanni Di Sirio
+
+    Licensed under the Apache License, Version 2.0 (the "License");
+    you may not use this file except in compliance with the License.
+    You may obtain a copy of the License at
+
+        http://www.apache.org/licenses/LICENSE-2.0
+
+    Unless required by applicable law or agreed to in writing, software
+    distributed under the License is distributed on an "AS IS" BASIS,
+    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+    See the License for the specific language governing permissions and
+    limitations under the License.
+*/
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "hal.h"
+#include "blkcache.h"
+#include "host_test.h"
+
+/*===========================================================================*/
+/* RAM disk with a cost model.                                               */
+/*===========================================================================*/
+
+/*
+ * Modelled device time, roughly an SD card on SPI: every operation pays a
+ * command overhead, then each block its transfer time.
+ */
+#define READ_OP_US                          200U
+#define READ_BLOCK_US                       40U
+#define WRITE_OP_US                         600U
+#define WRITE_BLOCK_US                      50U
+
+#define DISK_BYTES                          (1024U * 1024U)
+
+typedef struct {
+  const struct BaseBlockDeviceVMT *vmt;
+  _base_block_device_data
+  BlockDeviceInfo           info;
+  uint8_t                   *data;
+  uint32_t                  reads;
+  uint32_t                  writes;
+  uint64_t                  cost_us;
+} RamDisk;
+
+static bool rd_is_inserted(void *instance) {
+
+  (void)instance;
+  return true;
+}
+
+static bool rd_is_protected(void *instance) {
+
+  (void)instance;
+  return false;
+}
+
+static bool rd_connect(void *instance) {
+  RamDisk *rdp = instance;
+
+  rdp->state = BLK_READY;
+  return HAL_SUCCESS;
+}
+
+static bool rd_disconnect(void *instance) {
+  RamDisk *rdp = instance;
+
+  rdp->state = BLK_ACTIVE;
+  return HAL_SUCCESS;
+}
+
+static bool rd_read(void *instance, uint32_t startblk,
+                    uint8_t *buffer, uint32_t n) {
+  RamDisk *rdp = instance;
+
+  if ((rdp->state != BLK_READY) || (startblk + n > rdp->info.blk_num)) {
+    return HAL_FAILED;
+  }
+  memcpy(buffer, &rdp->data[startblk * rdp->info.blk_size],
+         n * rdp->info.blk_size);
+  rdp->reads++;
+  rdp->cost_us += READ_OP_US + n * READ_BLOCK_US;
+  return HAL_SUCCESS;
+}
+
+static bool rd_write(void *instance, uint32_t startblk,
+                     const uint8_t *buffer, uint32_t n) {
+  RamDisk *rdp = instance;
+
+  if ((rdp->state != BLK_READY) || (startblk + n > rdp->info.blk_num)) {
+    return HAL_FAILED;
+  }
+  memcpy(&rdp->data[startblk * rdp->info.blk_size], buffer,
+         n * rdp->info.blk_size);
+  rdp->writes++;
+  rdp->cost_us += WRITE_OP_US + n * WRITE_BLOCK_US;
+  return HAL_SUCCESS;
+}
+
+static bool rd_sync(void *instance) {
+
+  (void)instance;
+  return HAL_SUCCESS;
+}
+
+static bool rd_get_info(void *instance, BlockDeviceInfo *bdip) {
+  RamDisk *rdp = instance;
+
+  *bdip = rdp->info;
+  return HAL_SUCCESS;
+}
+
+static const struct BaseBlockDeviceVMT rd_vmt = {
+  (size_t)0,
+  rd_is_inserted,
+  rd_is_protected,
+  rd_connect,
+  rd_disconnect,
+  rd_read,
+  rd_write,
+  rd_sync,
+  rd_get_info
+};
+
+static uint8_t disk_data[DISK_BYTES];
+
+static void rd_init(RamDisk *rdp, uint32_t blk_size) {
+
+  memset(rdp, 0, sizeof(*rdp));
+  rdp->vmt = &rd_vmt;
+  rdp->state = BLK_READY;
+  rdp->info.blk_size = blk_size;
+  rdp->info.blk_num = DISK_BYTES / blk_size;
+  rdp->data = disk_data;
+}
+
+/*===========================================================================*/
+/* Tests.                                                                    */
+/*===========================================================================*/
+
+#define MAX_LINES                           32U
+#define MAX_LINE_SIZE                       4096U
+
+static RamDisk disk;
+static BlockCache cache;
+static BlockCacheConfig config;
+static blkcache_line_t lines[MAX_LINES];
+static uint8_t buffer[MAX_LINES * MAX_LINE_SIZE];
+static uint8_t ref[DISK_BYTES];
+static uint8_t tmp[MAX_LINES * MAX_LINE_SIZE];
+
+static void cache_setup(uint32_t blk_size, uint32_t nlines,
+                        uint32_t line_size, uint32_t readahead) {
+
+  rd_init(&disk, blk_size);
+  config.dev = (BaseBlockDevice *)&disk;
+  config.lines = lines;
+  config.buffer = buffer;
+  config.nlines = nlines;
+  config.line_size = line_size;
+  config.readahead = readahead;
+  blkcacheObjectInit(&cache);
+  blkcacheStart(&cache, &config);
+}
+
+static void fill_random(uint8_t *p, size_t n) {
+
+  while (n-- > 0U) {
+    *p++ = (uint8_t)hostRand();
+  }
+}
+
+/*
+ * Random reads and writes, the cache must always return the last data
+ * written and the device must match once synchronized.
+ */
+static void test_random_ops(uint32_t blk_size, uint32_t nlines,
+                            uint32_t line_size, uint32_t readahead) {
+  const uint32_t blk_num = DISK_BYTES / blk_size;
+  /* A small working set so that lines are hit, evicted and reloaded.*/
+  const uint32_t span = nlines * 4U;
+  unsigned op, errors = 0;
+
+  hostSeed(blk_size + nlines + line_size + readahead);
+  fill_random(disk_data, sizeof(disk_data));
+  memcpy(ref, disk_data, sizeof(ref));
+  cache_setup(blk_size, nlines, line_size, readahead);
+  HOST_CHECK(blkConnect(&cache) == HAL_SUCCESS, "connect");
+
+  for (op = 0; op < 20000U; op++) {
+    uint32_t r = hostRand() % 100U;
+    uint32_t n = 1U + (hostRand() % (nlines + 2U));
+    uint32_t blk = hostRand() % (span - n);
+
+    if ((hostRand() % 8U) == 0U) {
+      /* Sequential run from the previous block.*/
+      blk = (blk + 1U) % (span - n);
+    }
+    if (r < 50U) {
+      if (blkRead(&cache, blk, tmp, n) != HAL_SUCCESS) {
+        errors++;
+      }
+      else if (memcmp(tmp, &ref[blk * blk_size], n * blk_size) != 0) {
+        errors++;
+      }
+    }
+    else if (r < 98U) {
+      fill_random(&ref[blk * blk_size], n * blk_size);
+      if (blkWrite(&cache, blk, &ref[blk * blk_size], n) != HAL_SUCCESS) {
+        errors++;
+      }
+    }
+    else {
+      if (blkSync(&cache) != HAL_SUCCESS) {
+        errors++;
+      }
+      else if (memcmp(disk_data, ref, span * blk_size) != 0) {
+        errors++;
+      }
+    }
+  }
+  HOST_CHECK(errors == 0U, "blk %u, %u lines of %u, readahead %u: %u errors",
+             (unsigned)blk_size, (unsigned)nlines, (unsigned)line_size,
+             (unsigned)readahead, errors);
+
+  HOST_CHECK(blkRead(&cache, blk_num - 1U, tmp, 2) == HAL_FAILED,
+             "read past the end");
+  HOST_CHECK(blkDisconnect(&cache) == HAL_SUCCESS, "disconnect");
+  HOST_CHECK(memcmp(disk_data, ref, sizeof(ref)) == 0,
+             "blk %u, line %u: device contents after disconnect",
+             (unsigned)blk_size, (unsigned)line_size);
+}
+
+/* Blocks larger than the lines are refused.*/
+static void test_block_too_large(void) {
+
+  cache_setup(4096, 8, 512, 0);
+  HOST_CHECK(blkConnect(&cache) == HAL_FAILED, "connected");
+}
+
+/* Writes stay in the cache until synchronized.*/
+static void test_write_back(void) {
+
+  memset(disk_data, 0, sizeof(disk_data));
+  cache_setup(512, 8, 4096, 0);
+  HOST_CHECK(blkConnect(&cache) == HAL_SUCCESS, "connect");
+  memset(tmp, 0xA5, 4 * 512);
+  HOST_CHECK(blkWrite(&cache, 10, tmp, 4) == HAL_SUCCESS, "write");
+  HOST_CHECK((disk.writes == 0U) && (disk_data[10 * 512] == 0U),
+             "written through");
+  HOST_CHECK(blkSync(&cache) == HAL_SUCCESS, "sync");
+  HOST_CHECK(disk.writes == 1U, "%u device writes for 4 adjacent blocks",
+             (unsigned)disk.writes);
+  HOST_CHECK((disk_data[10 * 512] == 0xA5U) &&
+             (disk_data[14 * 512 - 1] == 0xA5U) &&
+             (disk_data[14 * 512] == 0U), "device contents");
+}
+
+/* The cache drops its contents when the device goes away.*/
+static void test_media_removal(void) {
+
+  cache_setup(512, 8, 512, 0);
+  HOST_CHECK(blkConnect(&cache) == HAL_SUCCESS, "connect");
+  HOST_CHECK(blkRead(&cache, 0, tmp, 1) == HAL_SUCCESS, "read");
+  disk.state = BLK_ACTIVE;
+  HOST_CHECK(blkRead(&cache, 0, tmp, 1) == HAL_FAILED, "read, removed");
+  HOST_CHECK(blkGetDriverState(&cache) == BLK_ACTIVE, "cache state");
+  disk.state = BLK_READY;
+  HOST_CHECK(blkConnect(&cache) == HAL_SUCCESS, "reconnect");
+  HOST_CHECK(blkcacheGetStats(&cache)->hits == 0U, "stale hit");
+}
+
+/*===========================================================================*/
+/* Benchmark.                                                                */
+/*===========================================================================*/
+
+typedef struct {
+  const char *name;
+  void (*run)(void *dev);
+} workload_t;
+
+/* Directory scan and file read, one sector at a time as FatFs does.*/
+static void wl_read(void *dev) {
+  BaseBlockDevice *bdp = dev;
+  unsigned i, pass;
+
+  for (pass = 0; pass < 4U; pass++) {
+    for (i = 0; i < 8U; i++) {
+      (void)blkRead(bdp, 100U + i, tmp, 1);
+    }
+  }
+  for (i = 0; i < 512U; i++) {
+    (void)blkRead(bdp, 1000U + i, tmp, 1);
+  }
+}
+
+/*
+ * File append: each data sector updates the FAT sector covering it and,
+ * every 16 sectors, the directory entry.
+ */
+static void wl_append(void *dev) {
+  BaseBlockDevice *bdp = dev;
+  unsigned i;
+
+  for (i = 0; i < 512U; i++) {
+    uint32_t fat = 32U + (i / 128U);
+
+    (void)blkWrite(bdp, 1000U + i, tmp, 1);
+    (void)blkRead(bdp, fat, tmp, 1);
+    (void)blkWrite(bdp, fat, tmp, 1);
+    if ((i % 16U) == 15U) {
+      (void)blkRead(bdp, 100U, tmp, 1);
+      (void)blkWrite(bdp, 100U, tmp, 1);
+    }
+  }
+  (void)blkSync(bdp);
+}
+
+/* Small random updates inside a database-like file.*/
+static void wl_random(void *dev) {
+  BaseBlockDevice *bdp = dev;
+  unsigned i;
+
+  hostSeed(7);
+  for (i = 0; i < 2000U; i++) {
+    uint32_t blk = 2000U + (hostRand() % 24U);
+
+    if ((hostRand() % 4U) == 0U) {
+      (void)blkWrite(bdp, blk, tmp, 1);
+    }
+    else {
+      (void)blkRead(bdp, blk, tmp, 1);
+    }
+  }
+  (void)blkSync(bdp);
+}
+
+static const workload_t workloads[] = {
+  {"read",   wl_read},
+  {"append", wl_append},
+  {"random", wl_random}
+};
+
+static void bench(void) {
+  unsigned w;
+
+  printf("%-8s %25s %31s\n", "", "uncached", "cached (16 x 512, ra 4)");
+  printf("%-8s %8s %8s %9s %8s %8s %9s %5s\n", "workload", "reads",
+         "writes", "dev ms", "reads", "writes", "dev ms", "x");
+  for (w = 0; w < sizeof(workloads) / sizeof(workloads[0]); w++) {
+    uint32_t r0, w0;
+    uint64_t c0;
+
+    rd_init(&disk, 512);
+    workloads[w].run(&disk);
+    r0 = disk.reads;
+    w0 = disk.writes;
+    c0 = disk.cost_us;
+
+    cache_setup(512, 16, 512, 4);
+    (void)blkConnect(&cache);
+    workloads[w].run(&cache);
+    printf("%-8s %8u %8u %9.1f %8u %8u %9.1f %5.1f\n", workloads[w].name,
+           (unsigned)r0, (unsigned)w0, c0 / 1000.0,
+           (unsigned)disk.reads, (unsigned)disk.writes,
+           disk.cost_us / 1000.0, (double)c0 / (double)disk.cost_us);
+  }
+}
+
+int main(int argc, char *argv[]) {
+
+  hostInit(argc, argv);
+
+  test_random_ops(512, 16, 512, 4);
+  test_random_ops(512, 16, 512, 0);
+  test_random_ops(512, 16, 4096, 4);
+  test_random_ops(512, 8, 2048, 2);
+  test_random_ops(1024, 16, 4096, 4);
+  test_random_ops(4096, 8, 4096, 4);
+  test_block_too_large();
+  test_write_back();
+  test_media_removal();
+
+  if (host_bench) {
+    bench();
+  }
+
+  return hostReport(argv[0]);
+}
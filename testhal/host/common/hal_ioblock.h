@@ -0,0 +1,87 @@
+/*
+    ChibiOS - Copyright (C) 2006..2018 Giovanni Di Sirio
+
+    Licensed under the Apache License, Version 2.0 (the "License");
+    you may not use this file except in compliance with the License.
+    You may obtain a copy of the License at
+
+        http://www.apache.org/licenses/LICENSE-2.0
+
+    Unless required by applicable law or agreed to in writing, software
+    distributed under the License is distributed on an "AS IS" BASIS,
+    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+    See the License for the specific language governing permissions and
+    limitations under the License.
+*/
+
+/**
+ * @file    hal_ioblock.h
+ * @brief   Host copy of the HAL block device interface.
+ */
+
+#ifndef HAL_IOBLOCK_H
+#define HAL_IOBLOCK_H
+
+/*===========================================================================*/
+/* Module data structures and types.                                         */
+/*===========================================================================*/
+
+typedef enum {
+  BLK_UNINIT = 0,
+  BLK_STOP = 1,
+  BLK_ACTIVE = 2,
+  BLK_CONNECTING = 3,
+  BLK_DISCONNECTING = 4,
+  BLK_READY = 5,
+  BLK_READING = 6,
+  BLK_WRITING = 7,
+  BLK_SYNCING = 8
+} blkstate_t;
+
+typedef struct {
+  uint32_t                  blk_size;
+  uint32_t                  blk_num;
+} BlockDeviceInfo;
+
+#define _base_block_device_methods                                          \
+  size_t instance_offset;                                                   \
+  bool (*is_inserted)(void *instance);                                      \
+  bool (*is_protected)(void *instance);                                     \
+  bool (*connect)(void *instance);                                          \
+  bool (*disconnect)(void *instance);                                       \
+  bool (*read)(void *instance, uint32_t startblk,                           \
+               uint8_t *buffer, uint32_t n);                                \
+  bool (*write)(void *instance, uint32_t startblk,                          \
+                const uint8_t *buffer, uint32_t n);                         \
+  bool (*sync)(void *instance);                                             \
+  bool (*get_info)(void *instance, BlockDeviceInfo *bdip);
+
+#define _base_block_device_data                                             \
+  blkstate_t                state;
+
+struct BaseBlockDeviceVMT {
+  _base_block_device_methods
+};
+
+typedef struct {
+  const struct BaseBlockDeviceVMT *vmt;
+  _base_block_device_data
+} BaseBlockDevice;
+
+/*===========================================================================*/
+/* Module macros.                                                            */
+/*===========================================================================*/
+
+#define blkGetDriverState(ip) ((ip)->state)
+#define blkIsInserted(ip) ((ip)->vmt->is_inserted(ip))
+#define blkIsWriteProtected(ip) ((ip)->vmt->is_protected(ip))
+#define blkConnect(ip) ((ip)->vmt->connect(ip))
+#define blkDisconnect(ip) ((ip)->vmt->disconnect(ip))
+#define blkRead(ip, startblk, buf, n)                                       \
+  ((ip)->vmt->read(ip, startblk, buf, n))
+#define blkWrite(ip, startblk, buf, n)                                      \
+  ((ip)->vmt->write(ip, startblk, buf, n))
+#define blkSync(ip) ((ip)->vmt->sync(ip))
+#define blkGetInfo(ip, bdip) ((ip)->vmt->get_info(ip, bdip))
+
+#endif /* HAL_IOBLOCK_H */
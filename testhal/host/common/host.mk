@@ -0,0 +1,52 @@
+##############################################################################
+# Common rules of the host tests.
+#
+# A test Makefile sets CHIBIOS_CONTRIB, TESTS (the programs to build) and,
+# for each program, <name>_SRC, <name>_DEFS and optionally <name>_LIBS (link
+# options), then includes this file.
+# Setting HOSTRT to yes replaces the single threaded OSAL with the emulated
+# RT kernel in common/rt (threads, virtual time and virtual timers).
+#
+# make          builds the programs.
+# make check    builds and runs them, fails on the first failing program.
+# make bench    also runs the benchmarks.
+#
+
+CC      ?= gcc
+OPT     ?= -O2 -g
+CWARN   ?= -Wall -Wextra -Wundef -Wstrict-prototypes
+HOSTDIR  = $(CHIBIOS_CONTRIB)/testhal/host/common
+ifeq ($(HOSTRT),yes)
+OSALDIR  = $(HOSTDIR)/rt
+HOSTSRC  = $(OSALDIR)/ch.c $(OSALDIR)/osal.c $(HOSTDIR)/host_test.c
+else
+OSALDIR  = $(HOSTDIR)
+HOSTSRC  = $(OSALDIR)/osal.c $(HOSTDIR)/host_test.c
+endif
+INCDIR   = -I. -I$(OSALDIR) -I$(HOSTDIR) $(patsubst %,-I%,$(UINCDIR))
+BUILDDIR = build
+HOSTDEPS = Makefile $(wildcard *.h $(OSALDIR)/*.h $(HOSTDIR)/*.h $(patsubst %,%/*.h,$(UINCDIR)))
+
+all: $(addprefix $(BUILDDIR)/,$(TESTS))
+
+define host_test_rule
+$(BUILDDIR)/$(1): $$($(1)_SRC) $$(HOSTSRC) $$(HOSTDEPS) | $(BUILDDIR)
+	$$(CC) $$(OPT) $$(CWARN) $$(UDEFS) $$($(1)_DEFS) $$(INCDIR) \
+	  $$($(1)_SRC) $$(HOSTSRC) $$($(1)_LIBS) $$(ULIBS) -o $$@
+endef
+
+$(foreach t,$(TESTS),$(eval $(call host_test_rule,$(t))))
+
+$(BUILDDIR):
+	mkdir -p $@
+
+check: all
+	@set -e; for t in $(TESTS); do ./$(BUILDDIR)/$$t; done
+
+bench: all
+	@set -e; for t in $(TESTS); do ./$(BUILDDIR)/$$t -b; done
+
+clean:
+	rm -rf $(BUILDDIR)
+
+.PHONY: all check bench clean
@@ -0,0 +1,91 @@
+/*
+    ChibiOS - Copyright (C) 2006..2018 Giovanni Di Sirio
+
+    Licensed under the Apache License, Version 2.0 (the "License");
+    you may not use this file except in compliance with the License.
+    You may obtain a copy of the License at
+
+        http://www.apache.org/licenses/LICENSE-2.0
+
+    Unless required by applicable law or agreed to in writing, software
+    distributed under the License is distributed on an "AS IS" BASIS,
+    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+    See the License for the specific language governing permissions and
+    limitations under the License.
+*/
+
+/**
+ * @file    host_test.c
+ * @brief   Checks and timing helpers for the host tests.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "host_test.h"
+
+unsigned long host_checks;
+unsigned long host_failures;
+
+/**
+ * @brief   Benchmarks are run, option @p -b.
+ */
+bool host_bench;
+
+static uint32_t rand_state = 1;
+
+/**
+ * @brief   Parses the command line.
+ */
+void hostInit(int argc, char *argv[]) {
+  int i;
+
+  for (i = 1; i < argc; i++) {
+    if (strcmp(argv[i], "-b") == 0) {
+      host_bench = true;
+    }
+  }
+}
+
+/**
+ * @brief   Prints the summary.
+ *
+ * @return              The process exit code.
+ */
+int hostReport(const char *name) {
+
+  printf("%s: %lu checks, %lu failures\n", name, host_checks, host_failures);
+  return host_failures == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+/**
+ * @brief   Monotonic time in nanoseconds.
+ */
+uint64_t hostNowNs(void) {
+  struct timespec ts;
+
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000000000U + (uint64_t)ts.tv_nsec;
+}
+
+/**
+ * @brief   Reproducible xorshift32 generator.
+ */
+uint32_t hostRand(void) {
+  uint32_t x = rand_state;
+
+  x ^= x << 13;
+  x ^= x >> 17;
+  x ^= x << 5;
+  rand_state = x;
+  return x;
+}
+
+/**
+ * @brief   Seeds @p hostRand().
+ */
+void hostSeed(uint32_t seed) {
+
+  rand_state = seed != 0U ? seed : 1U;
+}
@@ -0,0 +1,58 @@
+/*
+    ChibiOS - Copyright (C) 2006..2018 Giovanni Di Sirio
+
+    Licensed under the Apache License, Version 2.0 (the "License");
+    you may not use this file except in compliance with the License.
+    You may obtain a copy of the License at
+
+        http://www.apache.org/licenses/LICENSE-2.0
+
+    Unless required by applicable law or agreed to in writing, software
+    distributed under the License is distributed on an "AS IS" BASIS,
+    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+    See the License for the specific language governing permissions and
+    limitations under the License.
+*/
+
+/**
+ * @file    host_test.h
+ * @brief   Checks and timing helpers for the host tests.
+ */
+
+#ifndef HOST_TEST_H
+#define HOST_TEST_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+
+/**
+ * @brief   Records a failure, with a printf-like message, if @p c is false.
+ */
+#define HOST_CHECK(c, ...) do {                                             \
+  host_checks++;                                                            \
+  if (!(c)) {                                                               \
+    host_failures++;                                                        \
+    printf("FAIL %s:%d: ", __FILE__, __LINE__);                             \
+    printf(__VA_ARGS__);                                                    \
+    printf("\n");                                                           \
+  }                                                                         \
+} while (false)
+
+extern unsigned long host_checks;
+extern unsigned long host_failures;
+extern bool host_bench;
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+  void hostInit(int argc, char *argv[]);
+  int hostReport(const char *name);
+  uint64_t hostNowNs(void);
+  uint32_t hostRand(void);
+  void hostSeed(uint32_t seed);
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* HOST_TEST_H */
@@ -0,0 +1,99 @@
+/*
+    ChibiOS - Copyright (C) 2006..2018 Giovanni Di Sirio
+
+    Licensed under the Apache License, Version 2.0 (the "License");
+    you may not use this file except in compliance with the License.
+    You may obtain a copy of the License at
+
+        http://www.apache.org/licenses/LICENSE-2.0
+
+    Unless required by applicable law or agreed to in writing, software
+    distributed under the License is distributed on an "AS IS" BASIS,
+    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+    See the License for the specific language governing permissions and
+    limitations under the License.
+*/
+
+/**
+ * @file    osal.c
+ * @brief   Host OSAL for the host tests.
+ */
+
+#include "osal.h"
+#include "host_test.h"
+
+static unsigned lock_cnt;
+static uint64_t lock_start_ns;
+static uint64_t lock_max_ns;
+
+/**
+ * @brief   Enters a critical section.
+ */
+void osalSysLock(void) {
+
+  assert(lock_cnt == 0);
+  lock_cnt = 1;
+  lock_start_ns = hostNowNs();
+}
+
+/**
+ * @brief   Leaves a critical section.
+ */
+void osalSysUnlock(void) {
+  uint64_t t;
+
+  assert(lock_cnt == 1);
+  lock_cnt = 0;
+  t = hostNowNs() - lock_start_ns;
+  if (t > lock_max_ns) {
+    lock_max_ns = t;
+  }
+}
+
+/**
+ * @brief   Enters a critical section if not already inside one.
+ *
+ * @return              The previous state, for @p osalSysRestoreStatusX().
+ */
+syssts_t osalSysGetStatusAndLockX(void) {
+
+  if (lock_cnt != 0) {
+    return 1;
+  }
+  osalSysLock();
+  return 0;
+}
+
+/**
+ * @brief   Restores the state saved by @p osalSysGetStatusAndLockX().
+ */
+void osalSysRestoreStatusX(syssts_t sts) {
+
+  if (sts == 0) {
+    osalSysUnlock();
+  }
+}
+
+/**
+ * @brief   Returns @p true inside a critical section.
+ */
+bool osalIsLocked(void) {
+
+  return lock_cnt != 0;
+}
+
+/**
+ * @brief   Longest critical section since the last reset.
+ */
+uint64_t osalMaxLockedNs(void) {
+
+  return lock_max_ns;
+}
+
+/**
+ * @brief   Resets the critical section statistics.
+ */
+void osalResetLockStats(void) {
+
+  lock_max_ns = 0;
+}
@@ -0,0 +1,112 @@
+/*
+    ChibiOS - Copyright (C) 2006..2018 Giovanni Di Sirio
+
+    Licensed under the Apache License, Version 2.0 (the "License");
+    you may not use this file except in compliance with the License.
+    You may obtain a copy of the License at
+
+        http://www.apache.org/licenses/LICENSE-2.0
+
+    Unless required by applicable law or agreed to in writing, software
+    distributed under the License is distributed on an "AS IS" BASIS,
+    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+    See the License for the specific language governing permissions and
+    limitations under the License.
+*/
+
+/**
+ * @file    osal.h
+ * @brief   Host OSAL for the host tests.
+ * @details Single threaded OSAL: the kernel lock only checks nesting and
+ *          measures the time spent in critical sections, mutexes only
+ *          check their ownership.
+ */
+
+#ifndef OSAL_H
+#define OSAL_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <assert.h>
+
+/*===========================================================================*/
+/* Module constants.                                                         */
+/*===========================================================================*/
+
+#if !defined(FALSE)
+#define FALSE                               0
+#endif
+
+#if !defined(TRUE)
+#define TRUE                                1
+#endif
+
+#define MSG_OK                              0
+#define MSG_TIMEOUT                         -1
+#define MSG_RESET                           -2
+
+/*===========================================================================*/
+/* Module data structures and types.                                         */
+/*===========================================================================*/
+
+typedef int32_t msg_t;
+typedef uint32_t systime_t;
+typedef uint32_t sysinterval_t;
+typedef uint32_t syssts_t;
+typedef uint32_t eventflags_t;
+typedef void *thread_reference_t;
+
+typedef struct {
+  unsigned                  locked;
+} mutex_t;
+
+/*===========================================================================*/
+/* Module macros.                                                            */
+/*===========================================================================*/
+
+#define osalDbgCheck(c)                     assert(c)
+#define osalDbgAssert(c, remark)            assert((c) && (remark))
+#define osalDbgCheckClassI()
+#define osalDbgCheckClassS()
+#define osalSysHalt(reason)                 assert(!(reason))
+
+#define osalSysLockFromISR()                osalSysLock()
+#define osalSysUnlockFromISR()              osalSysUnlock()
+
+static inline void osalMutexObjectInit(mutex_t *mp) {
+
+  mp->locked = 0;
+}
+
+static inline void osalMutexLock(mutex_t *mp) {
+
+  assert(mp->locked == 0);
+  mp->locked = 1;
+}
+
+static inline void osalMutexUnlock(mutex_t *mp) {
+
+  assert(mp->locked == 1);
+  mp->locked = 0;
+}
+
+/*===========================================================================*/
+/* External declarations.                                                    */
+/*===========================================================================*/
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+  void osalSysLock(void);
+  void osalSysUnlock(void);
+  syssts_t osalSysGetStatusAndLockX(void);
+  void osalSysRestoreStatusX(syssts_t sts);
+  bool osalIsLocked(void);
+  uint64_t osalMaxLockedNs(void);
+  void osalResetLockStats(void);
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* OSAL_H */
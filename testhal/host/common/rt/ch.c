@@ -0,0 +1,1152 @@
+/*
+    ChibiOS - Copyright (C) 2006..2018 Giovanni Di Sirio
+
+    Licensed under the Apache License, Version 2.0 (the "License");
+    you may not use this file except in compliance with the License.
+    You may obtain a copy of the License at
+
+        http://www.apache.org/licenses/LICENSE-2.0
+
+    Unless required by applicable law or agreed to in writing, software
+    distributed under the License is distributed on an "AS IS" BASIS,
+    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+    See the License for the specific language governing permissions and
+    limitations under the License.
+*/
+/**
+ * @file    rt/ch.c
+ * @brief   Host emulation of the ChibiOS/RT API used by the drivers.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "ch.h"
+
+/*===========================================================================*/
+/* Local definitions.                                                        */
+/*===========================================================================*/
+
+#define REGISTRY_SIZE                       64
+
+static struct {
+  ch_queue_t                rlist;
+  thread_t                  *current;
+  virtual_timer_t           *vtlist;
+  uint64_t                  now;
+  unsigned                  lock;
+  bool                      isr;
+  bool                      initialized;
+  thread_t                  mainthread;
+  thread_t                  *registry[REGISTRY_SIZE];
+} ch;
+
+static const char *const state_names[] = {
+  "READY", "CURRENT", "SUSPENDED", "WTSEM", "WTMTX", "WTQUEUE", "WTEXIT",
+  "WTOREVT", "SLEEPING", "FINAL"
+};
+
+/*===========================================================================*/
+/* Queues.                                                                   */
+/*===========================================================================*/
+
+static void queue_init(ch_queue_t *qp) {
+
+  qp->next = qp;
+  qp->prev = qp;
+}
+
+static bool queue_isempty(const ch_queue_t *qp) {
+
+  return qp->next == qp;
+}
+
+/* Inserts p before the element q.*/
+static void queue_insert_before(ch_queue_t *p, ch_queue_t *q) {
+
+  p->next = q;
+  p->prev = q->prev;
+  p->prev->next = p;
+  q->prev = p;
+}
+
+static ch_queue_t *queue_dequeue(ch_queue_t *p) {
+
+  p->prev->next = p->next;
+  p->next->prev = p->prev;
+  return p;
+}
+
+static thread_t *queue_fifo_remove(ch_queue_t *qp) {
+
+  return (thread_t *)queue_dequeue(qp->next);
+}
+
+/* Priority ordered insertion, behind the threads of the same priority.*/
+static void queue_prio_insert(thread_t *tp, ch_queue_t *qp) {
+  ch_queue_t *cp = qp->next;
+
+  while ((cp != qp) && (((thread_t *)cp)->prio >= tp->prio)) {
+    cp = cp->next;
+  }
+  queue_insert_before(&tp->queue, cp);
+}
+
+/*===========================================================================*/
+/* Scheduler.                                                                */
+/*===========================================================================*/
+
+static void dump_threads(void) {
+  unsigned i;
+
+  for (i = 0; i < REGISTRY_SIZE; i++) {
+    thread_t *tp = ch.registry[i];
+
+    if (tp != NULL) {
+      fprintf(stderr, "  %-16s prio %3u %s\n",
+              tp->name != NULL ? tp->name : "?", (unsigned)tp->prio,
+              state_names[tp->state]);
+    }
+  }
+}
+
+static void vt_fire_next(void) {
+  virtual_timer_t *vtp = ch.vtlist;
+  unsigned lock = ch.lock;
+
+  if (vtp == NULL) {
+    fprintf(stderr, "deadlock at t=%llu, no thread ready and no timer\n",
+            (unsigned long long)ch.now);
+    dump_threads();
+    abort();
+  }
+  if (vtp->deadline > (uint64_t)CH_HOST_TIME_LIMIT * CH_CFG_ST_FREQUENCY) {
+    fprintf(stderr, "virtual time limit reached\n");
+    dump_threads();
+    abort();
+  }
+
+  /* Advances the time and runs the expired callbacks in ISR context,
+     outside the critical section as RT does.*/
+  ch.now = vtp->deadline;
+  ch.isr = true;
+  ch.lock = 0;
+  while (((vtp = ch.vtlist) != NULL) && (vtp->deadline <= ch.now)) {
+    ch.vtlist = vtp->next;
+    vtp->armed = false;
+    vtp->func(vtp->par);
+  }
+  ch.isr = false;
+  ch.lock = lock;
+}
+
+static void ready_i(thread_t *tp) {
+
+  tp->state = CH_STATE_READY;
+  queue_prio_insert(tp, &ch.rlist);
+}
+
+/* Ahead of the threads of the same priority, for a preempted thread.*/
+static void ready_ahead_i(thread_t *tp) {
+  ch_queue_t *cp = ch.rlist.next;
+
+  tp->state = CH_STATE_READY;
+  while ((cp != &ch.rlist) && (((thread_t *)cp)->prio > tp->prio)) {
+    cp = cp->next;
+  }
+  queue_insert_before(&tp->queue, cp);
+}
+
+static void switch_to(thread_t *ntp) {
+  thread_t *otp = ch.current;
+
+  ntp->state = CH_STATE_CURRENT;
+  ch.current = ntp;
+  if (ntp != otp) {
+    if (otp->state == CH_STATE_FINAL) {
+      setcontext(&ntp->ctx);
+    }
+    swapcontext(&otp->ctx, &ntp->ctx);
+  }
+}
+
+/* The current thread has left the ready state, runs the next one. Time
+   advances while nothing is ready.*/
+static void reschedule(void) {
+
+  while (queue_isempty(&ch.rlist)) {
+    vt_fire_next();
+  }
+  switch_to(queue_fifo_remove(&ch.rlist));
+}
+
+static void wakeup(void *p) {
+  thread_t *tp = (thread_t *)p;
+
+  chSysLockFromISR();
+  switch (tp->state) {
+  case CH_STATE_READY:
+    /* Made ready by an earlier callback of the same tick, as in RT the
+       timeout is ignored.*/
+    chSysUnlockFromISR();
+    return;
+  case CH_STATE_SUSPENDED:
+    *tp->trp = NULL;
+    break;
+  case CH_STATE_WTSEM:
+    tp->wtsem->cnt++;
+    /* Falls through.*/
+  case CH_STATE_WTQUEUE:
+  case CH_STATE_WTEXIT:
+    queue_dequeue(&tp->queue);
+    break;
+  default:
+    break;
+  }
+  tp->rdymsg = MSG_TIMEOUT;
+  ready_i(tp);
+  chSysUnlockFromISR();
+}
+
+static msg_t go_sleep_timeout_s(unsigned state, sysinterval_t timeout) {
+  thread_t *tp = ch.current;
+
+  chDbgCheckClassS();
+  if (timeout != TIME_INFINITE) {
+    chDbgCheck(timeout != TIME_IMMEDIATE);
+    chVTSetI(&tp->wakeup, timeout, wakeup, tp);
+  }
+  tp->state = state;
+  reschedule();
+  if (tp->wakeup.armed) {
+    chVTResetI(&tp->wakeup);
+  }
+  return tp->rdymsg;
+}
+
+static void wakeup_s(thread_t *ntp, msg_t msg) {
+
+  ntp->rdymsg = msg;
+  if (ntp->prio <= ch.current->prio) {
+    ready_i(ntp);
+  }
+  else {
+    ready_ahead_i(ch.current);
+    switch_to(ntp);
+  }
+}
+
+/*===========================================================================*/
+/* System.                                                                   */
+/*===========================================================================*/
+
+static void registry_add(thread_t *tp) {
+  unsigned i;
+
+  for (i = 0; i < REGISTRY_SIZE; i++) {
+    if ((ch.registry[i] == NULL) || (ch.registry[i] == tp)) {
+      ch.registry[i] = tp;
+      return;
+    }
+  }
+}
+
+/**
+ * @brief   Initializes the kernel, the caller becomes the main thread.
+ */
+void chSysInit(void) {
+  thread_t *tp = &ch.mainthread;
+
+  queue_init(&ch.rlist);
+  memset(tp, 0, sizeof(*tp));
+  tp->prio = NORMALPRIO;
+  tp->realprio = NORMALPRIO;
+  tp->state = CH_STATE_CURRENT;
+  tp->name = "main";
+  queue_init(&tp->waiting.queue);
+  chVTObjectInit(&tp->wakeup);
+  ch.current = tp;
+  ch.initialized = true;
+  registry_add(tp);
+}
+
+void chSysLock(void) {
+
+  chDbgAssert(ch.lock == 0, "already locked");
+  ch.lock = 1;
+}
+
+void chSysUnlock(void) {
+
+  chDbgAssert(ch.lock == 1, "not locked");
+  /* Same check as the RT debug build: a higher priority thread must not
+     be left ready by an S-class function.*/
+  chDbgAssert(ch.isr || queue_isempty(&ch.rlist) ||
+              (((thread_t *)ch.rlist.next)->prio <= ch.current->prio),
+              "priority order violation");
+  ch.lock = 0;
+}
+
+bool chSysIsLockedX(void) {
+
+  return ch.lock != 0;
+}
+
+bool chSysIsInISRX(void) {
+
+  return ch.isr;
+}
+
+syssts_t chSysGetStatusAndLockX(void) {
+
+  if (ch.lock != 0) {
+    return 1;
+  }
+  chSysLock();
+  return 0;
+}
+
+void chSysRestoreStatusX(syssts_t sts) {
+
+  if (sts == 0) {
+    if (!ch.isr) {
+      chSchRescheduleS();
+    }
+    chSysUnlock();
+  }
+}
+
+void chSysHalt(const char *reason) {
+
+  fprintf(stderr, "chSysHalt: %s\n", reason);
+  abort();
+}
+
+void chSchRescheduleS(void) {
+
+  chDbgCheckClassS();
+  if (!queue_isempty(&ch.rlist) &&
+      (((thread_t *)ch.rlist.next)->prio > ch.current->prio)) {
+    ready_ahead_i(ch.current);
+    reschedule();
+  }
+}
+
+/**
+ * @brief   Virtual time, in ticks, as a 64 bits counter.
+ */
+uint64_t chVTGetTimeStampX(void) {
+
+  return ch.now;
+}
+
+/*===========================================================================*/
+/* Virtual timers.                                                           */
+/*===========================================================================*/
+
+void chVTObjectInit(virtual_timer_t *vtp) {
+
+  vtp->next = NULL;
+  vtp->armed = false;
+}
+
+void chVTSetI(virtual_timer_t *vtp, sysinterval_t delay, vtfunc_t vtfunc,
+              void *par) {
+  virtual_timer_t **pp = &ch.vtlist;
+
+  chDbgCheckClassI();
+  chDbgCheck((vtfunc != NULL) && (delay != TIME_IMMEDIATE));
+  if (vtp->armed) {
+    chVTResetI(vtp);
+  }
+  vtp->deadline = ch.now + delay;
+  vtp->func = vtfunc;
+  vtp->par = par;
+  vtp->armed = true;
+  while ((*pp != NULL) && ((*pp)->deadline <= vtp->deadline)) {
+    pp = &(*pp)->next;
+  }
+  vtp->next = *pp;
+  *pp = vtp;
+}
+
+void chVTSet(virtual_timer_t *vtp, sysinterval_t delay, vtfunc_t vtfunc,
+             void *par) {
+
+  chSysLock();
+  chVTSetI(vtp, delay, vtfunc, par);
+  chSysUnlock();
+}
+
+void chVTResetI(virtual_timer_t *vtp) {
+  virtual_timer_t **pp = &ch.vtlist;
+
+  chDbgCheckClassI();
+  while (*pp != NULL) {
+    if (*pp == vtp) {
+      *pp = vtp->next;
+      break;
+    }
+    pp = &(*pp)->next;
+  }
+  vtp->armed = false;
+}
+
+void chVTReset(virtual_timer_t *vtp) {
+
+  chSysLock();
+  chVTResetI(vtp);
+  chSysUnlock();
+}
+
+/*===========================================================================*/
+/* Threads.                                                                  */
+/*===========================================================================*/
+
+static void thread_start(void) {
+  thread_t *tp = ch.current;
+
+  chSysUnlock();
+  tp->pf(tp->arg);
+  chThdExit(MSG_OK);
+}
+
+/**
+ * @brief   Creates a thread, the thread structure is at the base of the
+ *          working area as in RT, the rest is the host stack.
+ */
+thread_t *chThdCreateStatic(void *wsp, size_t size, tprio_t prio,
+                            tfunc_t pf, void *arg) {
+  thread_t *tp = (thread_t *)wsp;
+  size_t hdr = (sizeof(thread_t) + 15U) & ~(size_t)15U;
+
+  chDbgAssert(ch.initialized, "kernel not initialized");
+  chDbgCheck((wsp != NULL) && (size > hdr + 16384U) && (pf != NULL));
+
+  memset(tp, 0, sizeof(*tp));
+  tp->prio = prio;
+  tp->realprio = prio;
+  tp->name = "noname";
+  tp->pf = pf;
+  tp->arg = arg;
+  queue_init(&tp->waiting.queue);
+  chVTObjectInit(&tp->wakeup);
+  getcontext(&tp->ctx);
+  tp->ctx.uc_stack.ss_sp = (uint8_t *)wsp + hdr;
+  tp->ctx.uc_stack.ss_size = size - hdr;
+  tp->ctx.uc_link = NULL;
+  makecontext(&tp->ctx, thread_start, 0);
+  registry_add(tp);
+
+  chSysLock();
+  wakeup_s(tp, MSG_OK);
+  chSysUnlock();
+
+  return tp;
+}
+
+thread_t *chThdGetSelfX_(void) {
+
+  return ch.current;
+}
+
+tprio_t chThdSetPriority(tprio_t newprio) {
+  tprio_t oldprio;
+
+  chSysLock();
+  oldprio = ch.current->realprio;
+  if ((ch.current->mtxcnt == 0U) || (newprio > ch.current->prio)) {
+    ch.current->prio = newprio;
+  }
+  ch.current->realprio = newprio;
+  chSchRescheduleS();
+  chSysUnlock();
+
+  return oldprio;
+}
+
+void chThdTerminate(thread_t *tp) {
+
+  chSysLock();
+  tp->terminate = true;
+  chSysUnlock();
+}
+
+msg_t chThdWait(thread_t *tp) {
+  msg_t msg;
+
+  chDbgCheck(tp != ch.current);
+  chSysLock();
+  if (tp->state != CH_STATE_FINAL) {
+    queue_insert_before(&ch.current->queue, &tp->waiting.queue);
+    (void)go_sleep_timeout_s(CH_STATE_WTEXIT, TIME_INFINITE);
+  }
+  msg = tp->rdymsg;
+  chSysUnlock();
+
+  return msg;
+}
+
+void chThdExit(msg_t msg) {
+  thread_t *tp = ch.current;
+
+  chDbgAssert(tp != &ch.mainthread, "main thread exit");
+  chSysLock();
+  tp->rdymsg = msg;
+  while (!queue_isempty(&tp->waiting.queue)) {
+    thread_t *wtp = queue_fifo_remove(&tp->waiting.queue);
+
+    wtp->rdymsg = MSG_OK;
+    ready_i(wtp);
+  }
+  tp->state = CH_STATE_FINAL;
+  reschedule();
+  /* Never returns.*/
+  abort();
+}
+
+void chThdYield(void) {
+
+  chSysLock();
+  if (!queue_isempty(&ch.rlist) &&
+      (((thread_t *)ch.rlist.next)->prio >= ch.current->prio)) {
+    ready_i(ch.current);
+    reschedule();
+  }
+  chSysUnlock();
+}
+
+void chThdSleepS(sysinterval_t time) {
+
+  chDbgCheck(time != TIME_IMMEDIATE);
+  (void)go_sleep_timeout_s(CH_STATE_SLEEPING, time);
+}
+
+void chThdSleep(sysinterval_t time) {
+
+  if (time == TIME_IMMEDIATE) {
+    chThdYield();
+    return;
+  }
+  chSysLock();
+  chThdSleepS(time);
+  chSysUnlock();
+}
+
+void chThdSleepUntil(systime_t time) {
+  sysinterval_t interval = chTimeDiffX(chVTGetSystemTimeX(), time);
+
+  if (interval > 0U) {
+    chThdSleep(interval);
+  }
+}
+
+msg_t chThdSuspendTimeoutS(thread_reference_t *trp, sysinterval_t timeout) {
+
+  chDbgAssert(*trp == NULL, "not NULL");
+  if (timeout == TIME_IMMEDIATE) {
+    return MSG_TIMEOUT;
+  }
+  *trp = ch.current;
+  ch.current->trp = trp;
+  return go_sleep_timeout_s(CH_STATE_SUSPENDED, timeout);
+}
+
+void chThdResumeI(thread_reference_t *trp, msg_t msg) {
+
+  chDbgCheckClassI();
+  if (*trp != NULL) {
+    thread_t *tp = *trp;
+
+    chDbgAssert(tp->state == CH_STATE_SUSPENDED, "not suspended");
+    *trp = NULL;
+    tp->rdymsg = msg;
+    ready_i(tp);
+  }
+}
+
+void chThdResumeS(thread_reference_t *trp, msg_t msg) {
+
+  chDbgCheckClassS();
+  if (*trp != NULL) {
+    thread_t *tp = *trp;
+
+    chDbgAssert(tp->state == CH_STATE_SUSPENDED, "not suspended");
+    *trp = NULL;
+    wakeup_s(tp, msg);
+  }
+}
+
+void chThdResume(thread_reference_t *trp, msg_t msg) {
+
+  chSysLock();
+  chThdResumeS(trp, msg);
+  chSysUnlock();
+}
+
+void chThdQueueObjectInit(threads_queue_t *tqp) {
+
+  queue_init(&tqp->queue);
+}
+
+msg_t chThdEnqueueTimeoutS(threads_queue_t *tqp, sysinterval_t timeout) {
+
+  if (timeout == TIME_IMMEDIATE) {
+    return MSG_TIMEOUT;
+  }
+  queue_insert_before(&ch.current->queue, &tqp->queue);
+  return go_sleep_timeout_s(CH_STATE_WTQUEUE, timeout);
+}
+
+void chThdDequeueNextI(threads_queue_t *tqp, msg_t msg) {
+
+  chDbgCheckClassI();
+  if (!queue_isempty(&tqp->queue)) {
+    thread_t *tp = queue_fifo_remove(&tqp->queue);
+
+    tp->rdymsg = msg;
+    ready_i(tp);
+  }
+}
+
+void chThdDequeueAllI(threads_queue_t *tqp, msg_t msg) {
+
+  while (!queue_isempty(&tqp->queue)) {
+    chThdDequeueNextI(tqp, msg);
+  }
+}
+
+/*===========================================================================*/
+/* Semaphores.                                                               */
+/*===========================================================================*/
+
+void chSemObjectInit(semaphore_t *sp, cnt_t n) {
+
+  chDbgCheck(n >= 0);
+  queue_init(&sp->queue.queue);
+  sp->cnt = n;
+}
+
+void chSemResetI(semaphore_t *sp, cnt_t n) {
+
+  chDbgCheckClassI();
+  sp->cnt = n;
+  while (!queue_isempty(&sp->queue.queue)) {
+    thread_t *tp = (thread_t *)queue_dequeue(sp->queue.queue.prev);
+
+    tp->rdymsg = MSG_RESET;
+    ready_i(tp);
+  }
+}
+
+void chSemReset(semaphore_t *sp, cnt_t n) {
+
+  chSysLock();
+  chSemResetI(sp, n);
+  chSchRescheduleS();
+  chSysUnlock();
+}
+
+msg_t chSemWaitTimeoutS(semaphore_t *sp, sysinterval_t timeout) {
+
+  chDbgCheckClassS();
+  if (--sp->cnt < 0) {
+    if (timeout == TIME_IMMEDIATE) {
+      sp->cnt++;
+      return MSG_TIMEOUT;
+    }
+    ch.current->wtsem = sp;
+    queue_insert_before(&ch.current->queue, &sp->queue.queue);
+    return go_sleep_timeout_s(CH_STATE_WTSEM, timeout);
+  }
+  return MSG_OK;
+}
+
+msg_t chSemWaitTimeout(semaphore_t *sp, sysinterval_t timeout) {
+  msg_t msg;
+
+  chSysLock();
+  msg = chSemWaitTimeoutS(sp, timeout);
+  chSysUnlock();
+
+  return msg;
+}
+
+msg_t chSemWaitS(semaphore_t *sp) {
+
+  return chSemWaitTimeoutS(sp, TIME_INFINITE);
+}
+
+msg_t chSemWait(semaphore_t *sp) {
+
+  return chSemWaitTimeout(sp, TIME_INFINITE);
+}
+
+void chSemSignalI(semaphore_t *sp) {
+
+  chDbgCheckClassI();
+  if (++sp->cnt <= 0) {
+    thread_t *tp = queue_fifo_remove(&sp->queue.queue);
+
+    tp->rdymsg = MSG_OK;
+    ready_i(tp);
+  }
+}
+
+void chSemSignal(semaphore_t *sp) {
+
+  chSysLock();
+  if (++sp->cnt <= 0) {
+    wakeup_s(queue_fifo_remove(&sp->queue.queue), MSG_OK);
+  }
+  chSysUnlock();
+}
+
+/*===========================================================================*/
+/* Mutexes, priority inheritance is only applied to the owner.               */
+/*===========================================================================*/
+
+void chMtxObjectInit(mutex_t *mp) {
+
+  queue_init(&mp->queue.queue);
+  mp->owner = NULL;
+}
+
+void chMtxLockS(mutex_t *mp) {
+  thread_t *ctp = ch.current;
+
+  chDbgCheckClassS();
+  if (mp->owner == NULL) {
+    mp->owner = ctp;
+    ctp->mtxcnt++;
+    return;
+  }
+  chDbgAssert(mp->owner != ctp, "recursive lock");
+  if (mp->owner->prio < ctp->prio) {
+    mp->owner->prio = ctp->prio;
+    if (mp->owner->state == CH_STATE_READY) {
+      queue_dequeue(&mp->owner->queue);
+      ready_i(mp->owner);
+    }
+  }
+  queue_prio_insert(ctp, &mp->queue.queue);
+  (void)go_sleep_timeout_s(CH_STATE_WTMTX, TIME_INFINITE);
+  chDbgAssert(mp->owner == ctp, "not owner");
+}
+
+void chMtxLock(mutex_t *mp) {
+
+  chSysLock();
+  chMtxLockS(mp);
+  chSysUnlock();
+}
+
+bool chMtxTryLock(mutex_t *mp) {
+  bool locked = false;
+
+  chSysLock();
+  if (mp->owner == NULL) {
+    chMtxLockS(mp);
+    locked = true;
+  }
+  chSysUnlock();
+
+  return locked;
+}
+
+void chMtxUnlockS(mutex_t *mp) {
+  thread_t *ctp = ch.current;
+
+  chDbgCheckClassS();
+  chDbgAssert(mp->owner == ctp, "not owner");
+  if (--ctp->mtxcnt == 0U) {
+    ctp->prio = ctp->realprio;
+  }
+  if (queue_isempty(&mp->queue.queue)) {
+    mp->owner = NULL;
+  }
+  else {
+    thread_t *tp = queue_fifo_remove(&mp->queue.queue);
+
+    mp->owner = tp;
+    tp->mtxcnt++;
+    tp->rdymsg = MSG_OK;
+    ready_i(tp);
+  }
+}
+
+void chMtxUnlock(mutex_t *mp) {
+
+  chSysLock();
+  chMtxUnlockS(mp);
+  chSchRescheduleS();
+  chSysUnlock();
+}
+
+/*===========================================================================*/
+/* Events.                                                                   */
+/*===========================================================================*/
+
+void chEvtObjectInit(event_source_t *esp) {
+
+  esp->next = NULL;
+}
+
+void chEvtRegisterMaskWithFlags(event_source_t *esp, event_listener_t *elp,
+                                eventmask_t events, eventflags_t wflags) {
+
+  chSysLock();
+  elp->next = esp->next;
+  esp->next = elp;
+  elp->listener = ch.current;
+  elp->events = events;
+  elp->flags = 0;
+  elp->wflags = wflags;
+  chSysUnlock();
+}
+
+void chEvtUnregister(event_source_t *esp, event_listener_t *elp) {
+  event_listener_t **pp = &esp->next;
+
+  chSysLock();
+  while (*pp != NULL) {
+    if (*pp == elp) {
+      *pp = elp->next;
+      break;
+    }
+    pp = &(*pp)->next;
+  }
+  chSysUnlock();
+}
+
+eventflags_t chEvtGetAndClearFlagsI(event_listener_t *elp) {
+  eventflags_t flags = elp->flags;
+
+  elp->flags = 0;
+  return flags;
+}
+
+eventflags_t chEvtGetAndClearFlags(event_listener_t *elp) {
+  eventflags_t flags;
+
+  chSysLock();
+  flags = chEvtGetAndClearFlagsI(elp);
+  chSysUnlock();
+
+  return flags;
+}
+
+eventmask_t chEvtGetAndClearEvents(eventmask_t events) {
+  eventmask_t m;
+
+  chSysLock();
+  m = ch.current->epending & events;
+  ch.current->epending &= ~events;
+  chSysUnlock();
+
+  return m;
+}
+
+eventmask_t chEvtAddEvents(eventmask_t events) {
+  eventmask_t m;
+
+  chSysLock();
+  m = (ch.current->epending |= events);
+  chSysUnlock();
+
+  return m;
+}
+
+void chEvtSignalI(thread_t *tp, eventmask_t events) {
+
+  chDbgCheckClassI();
+  tp->epending |= events;
+  if ((tp->state == CH_STATE_WTOREVT) &&
+      ((tp->epending & tp->ewmask) != 0U)) {
+    tp->rdymsg = MSG_OK;
+    ready_i(tp);
+  }
+}
+
+void chEvtSignal(thread_t *tp, eventmask_t events) {
+
+  chSysLock();
+  chEvtSignalI(tp, events);
+  chSchRescheduleS();
+  chSysUnlock();
+}
+
+void chEvtBroadcastFlagsI(event_source_t *esp, eventflags_t flags) {
+  event_listener_t *elp;
+
+  chDbgCheckClassI();
+  for (elp = esp->next; elp != NULL; elp = elp->next) {
+    elp->flags |= flags;
+    if ((flags == 0U) || ((elp->wflags & flags) != 0U)) {
+      chEvtSignalI(elp->listener, elp->events);
+    }
+  }
+}
+
+void chEvtBroadcastFlags(event_source_t *esp, eventflags_t flags) {
+
+  chSysLock();
+  chEvtBroadcastFlagsI(esp, flags);
+  chSchRescheduleS();
+  chSysUnlock();
+}
+
+eventmask_t chEvtWaitAnyTimeout(eventmask_t events, sysinterval_t timeout) {
+  thread_t *ctp = ch.current;
+  eventmask_t m;
+
+  chSysLock();
+  if ((m = (ctp->epending & events)) == 0U) {
+    if (timeout == TIME_IMMEDIATE) {
+      chSysUnlock();
+      return 0;
+    }
+    ctp->ewmask = events;
+    if (go_sleep_timeout_s(CH_STATE_WTOREVT, timeout) < MSG_OK) {
+      chSysUnlock();
+      return 0;
+    }
+    m = ctp->epending & events;
+  }
+  ctp->epending &= ~m;
+  chSysUnlock();
+
+  return m;
+}
+
+eventmask_t chEvtWaitAny(eventmask_t events) {
+
+  return chEvtWaitAnyTimeout(events, TIME_INFINITE);
+}
+
+eventmask_t chEvtWaitOneTimeout(eventmask_t events, sysinterval_t timeout) {
+  thread_t *ctp = ch.current;
+  eventmask_t m;
+
+  chSysLock();
+  if ((m = (ctp->epending & events)) == 0U) {
+    if (timeout == TIME_IMMEDIATE) {
+      chSysUnlock();
+      return 0;
+    }
+    ctp->ewmask = events;
+    if (go_sleep_timeout_s(CH_STATE_WTOREVT, timeout) < MSG_OK) {
+      chSysUnlock();
+      return 0;
+    }
+    m = ctp->epending & events;
+  }
+  m ^= m & (m - 1U);
+  ctp->epending &= ~m;
+  chSysUnlock();
+
+  return m;
+}
+
+eventmask_t chEvtWaitOne(eventmask_t events) {
+
+  return chEvtWaitOneTimeout(events, TIME_INFINITE);
+}
+
+/*===========================================================================*/
+/* Mailboxes.                                                                */
+/*===========================================================================*/
+
+void chMBObjectInit(mailbox_t *mbp, msg_t *buf, size_t n) {
+
+  chDbgCheck((mbp != NULL) && (buf != NULL) && (n > 0U));
+  mbp->buffer = buf;
+  mbp->rdptr = buf;
+  mbp->wrptr = buf;
+  mbp->top = &buf[n];
+  mbp->cnt = 0;
+  mbp->reset = false;
+  chThdQueueObjectInit(&mbp->qw);
+  chThdQueueObjectInit(&mbp->qr);
+}
+
+void chMBResetI(mailbox_t *mbp) {
+
+  chDbgCheckClassI();
+  mbp->wrptr = mbp->buffer;
+  mbp->rdptr = mbp->buffer;
+  mbp->cnt = 0;
+  mbp->reset = true;
+  chThdDequeueAllI(&mbp->qw, MSG_RESET);
+  chThdDequeueAllI(&mbp->qr, MSG_RESET);
+}
+
+void chMBReset(mailbox_t *mbp) {
+
+  chSysLock();
+  chMBResetI(mbp);
+  chSchRescheduleS();
+  chSysUnlock();
+}
+
+void chMBResumeX(mailbox_t *mbp) {
+
+  mbp->reset = false;
+}
+
+msg_t chMBPostI(mailbox_t *mbp, msg_t msg) {
+
+  chDbgCheckClassI();
+  if (mbp->reset) {
+    return MSG_RESET;
+  }
+  if (chMBGetFreeCountI(mbp) == 0U) {
+    return MSG_TIMEOUT;
+  }
+  *mbp->wrptr++ = msg;
+  if (mbp->wrptr >= mbp->top) {
+    mbp->wrptr = mbp->buffer;
+  }
+  mbp->cnt++;
+  chThdDequeueNextI(&mbp->qr, MSG_OK);
+  return MSG_OK;
+}
+
+msg_t chMBPostTimeoutS(mailbox_t *mbp, msg_t msg, sysinterval_t timeout) {
+  msg_t rdymsg;
+
+  do {
+    rdymsg = chMBPostI(mbp, msg);
+    if (rdymsg != MSG_TIMEOUT) {
+      chSchRescheduleS();
+      return rdymsg;
+    }
+    rdymsg = chThdEnqueueTimeoutS(&mbp->qw, timeout);
+  } while (rdymsg == MSG_OK);
+
+  return rdymsg;
+}
+
+msg_t chMBPostTimeout(mailbox_t *mbp, msg_t msg, sysinterval_t timeout) {
+  msg_t rdymsg;
+
+  chSysLock();
+  rdymsg = chMBPostTimeoutS(mbp, msg, timeout);
+  chSysUnlock();
+
+  return rdymsg;
+}
+
+msg_t chMBFetchI(mailbox_t *mbp, msg_t *msgp) {
+
+  chDbgCheckClassI();
+  if (mbp->reset) {
+    return MSG_RESET;
+  }
+  if (mbp->cnt == 0U) {
+    return MSG_TIMEOUT;
+  }
+  *msgp = *mbp->rdptr++;
+  if (mbp->rdptr >= mbp->top) {
+    mbp->rdptr = mbp->buffer;
+  }
+  mbp->cnt--;
+  chThdDequeueNextI(&mbp->qw, MSG_OK);
+  return MSG_OK;
+}
+
+msg_t chMBFetchTimeoutS(mailbox_t *mbp, msg_t *msgp, sysinterval_t timeout) {
+  msg_t rdymsg;
+
+  do {
+    rdymsg = chMBFetchI(mbp, msgp);
+    if (rdymsg != MSG_TIMEOUT) {
+      chSchRescheduleS();
+      return rdymsg;
+    }
+    rdymsg = chThdEnqueueTimeoutS(&mbp->qr, timeout);
+  } while (rdymsg == MSG_OK);
+
+  return rdymsg;
+}
+
+msg_t chMBFetchTimeout(mailbox_t *mbp, msg_t *msgp, sysinterval_t timeout) {
+  msg_t rdymsg;
+
+  chSysLock();
+  rdymsg = chMBFetchTimeoutS(mbp, msgp, timeout);
+  chSysUnlock();
+
+  return rdymsg;
+}
+
+/*===========================================================================*/
+/* Memory pools and heap.                                                    */
+/*===========================================================================*/
+
+void chPoolObjectInit(memory_pool_t *mp, size_t size, memgetfunc_t provider) {
+
+  chDbgCheck((mp != NULL) && (size >= sizeof(void *)));
+  mp->next = NULL;
+  mp->object_size = size;
+  mp->provider = provider;
+}
+
+void chPoolLoadArray(memory_pool_t *mp, void *p, size_t n) {
+
+  while (n-- > 0U) {
+    chPoolFree(mp, p);
+    p = (uint8_t *)p + mp->object_size;
+  }
+}
+
+void *chPoolAllocI(memory_pool_t *mp) {
+  void *objp = mp->next;
+
+  chDbgCheckClassI();
+  if (objp != NULL) {
+    mp->next = mp->next->next;
+  }
+  else if (mp->provider != NULL) {
+    objp = mp->provider(mp->object_size, sizeof(void *));
+  }
+  return objp;
+}
+
+void *chPoolAlloc(memory_pool_t *mp) {
+  void *objp;
+
+  chSysLock();
+  objp = chPoolAllocI(mp);
+  chSysUnlock();
+
+  return objp;
+}
+
+void chPoolFreeI(memory_pool_t *mp, void *objp) {
+  struct pool_header *php = objp;
+
+  chDbgCheckClassI();
+  chDbgCheck(objp != NULL);
+  php->next = mp->next;
+  mp->next = php;
+}
+
+void chPoolFree(memory_pool_t *mp, void *objp) {
+
+  chSysLock();
+  chPoolFreeI(mp, objp);
+  chSysUnlock();
+}
+
+void *chHeapAlloc(memory_heap_t *heapp, size_t size) {
+
+  (void)heapp;
+  return malloc(size);
+}
+
+void chHeapFree(void *p) {
+
+  free(p);
+}
@@ -0,0 +1,382 @@
+/*
+    ChibiOS - Copyright (C) 2006..2018 Giovanni Di Sirio
+
+    Licensed under the Apache License, Version 2.0 (the "License");
+    you may not use this file except in compliance with the License.
+    You may obtain a copy of the License at
+
+        http://www.apache.org/licenses/LICENSE-2.0
+
+    Unless required by applicable law or agreed to in writing, software
+    distributed under the License is distributed on an "AS IS" BASIS,
+    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+    See the License for the specific language governing permissions and
+    limitations under the License.
+*/
+/**
+ * @file    rt/ch.h
+ * @brief   Host emulation of the ChibiOS/RT API used by the drivers.
+ * @details Threads are cooperative coroutines, a context switch only
+ *          happens when a thread blocks or when a higher priority thread
+ *          is made ready from the S-locked state, as on a real kernel.
+ *          Time is virtual: it only advances when no thread is ready, up
+ *          to the next virtual timer, so a test runs as on an infinitely
+ *          fast CPU and its timings are deterministic. A deadlock (every
+ *          thread blocked without timeout and no armed timer) aborts the
+ *          program.
+ */
+
+#ifndef CH_H
+#define CH_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <assert.h>
+#include <ucontext.h>
+
+/*===========================================================================*/
+/* Configuration.                                                            */
+/*===========================================================================*/
+
+/**
+ * @brief   System tick frequency.
+ */
+#if !defined(CH_CFG_ST_FREQUENCY)
+#define CH_CFG_ST_FREQUENCY                 10000
+#endif
+
+/**
+ * @brief   Stack added to every working area, the host C library needs
+ *          much more than the target code.
+ */
+#if !defined(CH_HOST_STACK_EXTRA)
+#define CH_HOST_STACK_EXTRA                 65536
+#endif
+
+/**
+ * @brief   Virtual time limit in seconds, a periodic timer hides a lost
+ *          wakeup from the deadlock detection so the test is aborted.
+ */
+#if !defined(CH_HOST_TIME_LIMIT)
+#define CH_HOST_TIME_LIMIT                  3600
+#endif
+
+/*===========================================================================*/
+/* Constants.                                                                */
+/*===========================================================================*/
+
+#if !defined(FALSE)
+#define FALSE                               0
+#endif
+
+#if !defined(TRUE)
+#define TRUE                                1
+#endif
+
+#define MSG_OK                              (msg_t)0
+#define MSG_TIMEOUT                         (msg_t)-1
+#define MSG_RESET                           (msg_t)-2
+
+#define TIME_IMMEDIATE                      ((sysinterval_t)0)
+#define TIME_INFINITE                       ((sysinterval_t)-1)
+
+#define IDLEPRIO                            (tprio_t)1
+#define LOWPRIO                             (tprio_t)2
+#define NORMALPRIO                          (tprio_t)128
+#define HIGHPRIO                            (tprio_t)255
+
+#define ALL_EVENTS                          ((eventmask_t)-1)
+#define EVENT_MASK(eid)                     ((eventmask_t)1 << (eventmask_t)(eid))
+
+#define CH_STATE_READY                      0
+#define CH_STATE_CURRENT                    1
+#define CH_STATE_SUSPENDED                  2
+#define CH_STATE_WTSEM                      3
+#define CH_STATE_WTMTX                      4
+#define CH_STATE_WTQUEUE                    5
+#define CH_STATE_WTEXIT                     6
+#define CH_STATE_WTOREVT                    7
+#define CH_STATE_SLEEPING                   8
+#define CH_STATE_FINAL                      9
+
+/*===========================================================================*/
+/* Types.                                                                    */
+/*===========================================================================*/
+
+/* Pointer sized, as on the 32 bits ports: mailboxes carry pointers.*/
+typedef intptr_t msg_t;
+typedef uint32_t tprio_t;
+typedef uint32_t systime_t;
+typedef uint32_t sysinterval_t;
+typedef uint32_t time_msecs_t;
+typedef uint32_t time_usecs_t;
+typedef uint32_t eventmask_t;
+typedef uint32_t eventflags_t;
+typedef int32_t cnt_t;
+typedef uint32_t ucnt_t;
+typedef uint32_t syssts_t;
+typedef uint64_t stkalign_t;
+typedef void (*tfunc_t)(void *p);
+typedef void (*vtfunc_t)(void *p);
+
+typedef struct ch_thread thread_t;
+typedef thread_t *thread_reference_t;
+
+typedef struct ch_queue {
+  struct ch_queue           *next;
+  struct ch_queue           *prev;
+} ch_queue_t;
+
+typedef struct {
+  ch_queue_t                queue;
+} threads_queue_t;
+
+typedef struct ch_virtual_timer {
+  struct ch_virtual_timer   *next;
+  uint64_t                  deadline;
+  vtfunc_t                  func;
+  void                      *par;
+  bool                      armed;
+} virtual_timer_t;
+
+struct ch_thread {
+  ch_queue_t                queue;
+  tprio_t                   prio;
+  tprio_t                   realprio;
+  unsigned                  state;
+  const char                *name;
+  ucontext_t                ctx;
+  msg_t                     rdymsg;
+  thread_reference_t        *trp;
+  struct ch_semaphore       *wtsem;
+  virtual_timer_t           wakeup;
+  threads_queue_t           waiting;
+  bool                      terminate;
+  eventmask_t               epending;
+  eventmask_t               ewmask;
+  unsigned                  mtxcnt;
+  tfunc_t                   pf;
+  void                      *arg;
+};
+
+typedef struct ch_semaphore {
+  threads_queue_t           queue;
+  cnt_t                     cnt;
+} semaphore_t;
+
+typedef struct ch_mutex {
+  threads_queue_t           queue;
+  thread_t                  *owner;
+} mutex_t;
+
+typedef struct event_listener {
+  struct event_listener     *next;
+  thread_t                  *listener;
+  eventmask_t               events;
+  eventflags_t              flags;
+  eventflags_t              wflags;
+} event_listener_t;
+
+typedef struct event_source {
+  event_listener_t          *next;
+} event_source_t;
+
+typedef struct {
+  msg_t                     *buffer;
+  msg_t                     *top;
+  msg_t                     *wrptr;
+  msg_t                     *rdptr;
+  size_t                    cnt;
+  bool                      reset;
+  threads_queue_t           qw;
+  threads_queue_t           qr;
+} mailbox_t;
+
+struct pool_header {
+  struct pool_header        *next;
+};
+
+typedef void *(*memgetfunc_t)(size_t size, unsigned align);
+
+typedef struct {
+  struct pool_header        *next;
+  size_t                    object_size;
+  memgetfunc_t              provider;
+} memory_pool_t;
+
+typedef struct memory_heap memory_heap_t;
+
+/*===========================================================================*/
+/* Macros.                                                                   */
+/*===========================================================================*/
+
+#define THD_FUNCTION(tname, arg)            void tname(void *arg)
+
+#define THD_WORKING_AREA_SIZE(n)                                            \
+  ((((size_t)(n) + CH_HOST_STACK_EXTRA) + sizeof(stkalign_t) - 1U) &        \
+   ~(sizeof(stkalign_t) - 1U))
+
+#define THD_WORKING_AREA(s, n)                                              \
+  stkalign_t s[THD_WORKING_AREA_SIZE(n) / sizeof(stkalign_t)]
+
+#define TIME_S2I(secs)                                                      \
+  ((sysinterval_t)((uint64_t)(secs) * CH_CFG_ST_FREQUENCY))
+#define TIME_MS2I(msecs)                                                    \
+  ((sysinterval_t)((((uint64_t)(msecs) * CH_CFG_ST_FREQUENCY) + 999U) /     \
+                   1000U))
+#define TIME_US2I(usecs)                                                    \
+  ((sysinterval_t)((((uint64_t)(usecs) * CH_CFG_ST_FREQUENCY) + 999999U) /  \
+                   1000000U))
+#define TIME_I2MS(interval)                                                 \
+  ((time_msecs_t)((((uint64_t)(interval) * 1000U) +                         \
+                   CH_CFG_ST_FREQUENCY - 1U) / CH_CFG_ST_FREQUENCY))
+#define TIME_I2US(interval)                                                 \
+  ((time_usecs_t)((((uint64_t)(interval) * 1000000U) +                      \
+                   CH_CFG_ST_FREQUENCY - 1U) / CH_CFG_ST_FREQUENCY))
+
+#define chDbgCheck(c)                       assert(c)
+#define chDbgAssert(c, r)                   assert((c) && (r))
+#define chDbgCheckClassI()                  chDbgAssert(chSysIsLockedX(), "not locked")
+#define chDbgCheckClassS()                  chDbgAssert(chSysIsLockedX() && !chSysIsInISRX(), "not S-locked")
+
+#define chTimeDiffX(start, end)             ((sysinterval_t)((systime_t)((end) - (start))))
+#define chTimeAddX(systime, interval)       ((systime_t)((systime) + (interval)))
+#define chVTGetSystemTimeX()                ((systime_t)chVTGetTimeStampX())
+#define chVTGetSystemTime()                 chVTGetSystemTimeX()
+#define chVTTimeElapsedSinceX(start)        chTimeDiffX((start), chVTGetSystemTimeX())
+#define chVTIsArmedI(vtp)                   ((vtp)->armed)
+#define chVTIsArmed(vtp)                    ((vtp)->armed)
+
+#define chSysLockFromISR()                  chSysLock()
+#define chSysUnlockFromISR()                chSysUnlock()
+
+#define chThdGetSelfX()                     chThdGetSelfX_()
+#define chThdGetPriorityX()                 (chThdGetSelfX()->prio)
+#define chThdShouldTerminateX()             (chThdGetSelfX()->terminate)
+#define chThdQueueIsEmptyI(tqp)             ((tqp)->queue.next == &(tqp)->queue)
+#define chThdSleepSeconds(sec)              chThdSleep(TIME_S2I(sec))
+#define chThdSleepMilliseconds(msec)        chThdSleep(TIME_MS2I(msec))
+#define chThdSleepMicroseconds(usec)        chThdSleep(TIME_US2I(usec))
+#define chThdSuspendS(trp)                  chThdSuspendTimeoutS((trp), TIME_INFINITE)
+#define chRegSetThreadName(p)               (chThdGetSelfX()->name = (p))
+#define chRegGetThreadNameX(tp)             ((tp)->name)
+
+#define chSemGetCounterI(sp)                ((sp)->cnt)
+#define chMtxQueueNotEmptyS(mp)             ((mp)->queue.queue.next != &(mp)->queue.queue)
+#define chMBGetSizeI(mbp)                   ((size_t)((mbp)->top - (mbp)->buffer))
+#define chMBGetUsedCountI(mbp)              ((mbp)->cnt)
+#define chMBGetFreeCountI(mbp)              (chMBGetSizeI(mbp) - (mbp)->cnt)
+#define chEvtRegisterMask(esp, elp, events)                                  \
+  chEvtRegisterMaskWithFlags(esp, elp, events, (eventflags_t)-1)
+#define chEvtRegister(esp, elp, event)                                       \
+  chEvtRegisterMask(esp, elp, EVENT_MASK(event))
+#define chEvtBroadcastI(esp)                chEvtBroadcastFlagsI(esp, 0)
+#define chEvtBroadcast(esp)                 chEvtBroadcastFlags(esp, 0)
+#define chEvtIsListeningI(esp)              ((esp)->next != NULL)
+
+/*===========================================================================*/
+/* External declarations.                                                    */
+/*===========================================================================*/
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+  /* System.*/
+  void chSysInit(void);
+  void chSysLock(void);
+  void chSysUnlock(void);
+  bool chSysIsLockedX(void);
+  bool chSysIsInISRX(void);
+  syssts_t chSysGetStatusAndLockX(void);
+  void chSysRestoreStatusX(syssts_t sts);
+  void chSysHalt(const char *reason);
+  void chSchRescheduleS(void);
+  uint64_t chVTGetTimeStampX(void);
+  /* Virtual timers.*/
+  void chVTObjectInit(virtual_timer_t *vtp);
+  void chVTSetI(virtual_timer_t *vtp, sysinterval_t delay, vtfunc_t vtfunc,
+                void *par);
+  void chVTSet(virtual_timer_t *vtp, sysinterval_t delay, vtfunc_t vtfunc,
+               void *par);
+  void chVTResetI(virtual_timer_t *vtp);
+  void chVTReset(virtual_timer_t *vtp);
+  /* Threads.*/
+  thread_t *chThdCreateStatic(void *wsp, size_t size, tprio_t prio,
+                              tfunc_t pf, void *arg);
+  thread_t *chThdGetSelfX_(void);
+  tprio_t chThdSetPriority(tprio_t newprio);
+  void chThdTerminate(thread_t *tp);
+  msg_t chThdWait(thread_t *tp);
+  void chThdExit(msg_t msg);
+  void chThdYield(void);
+  void chThdSleepS(sysinterval_t time);
+  void chThdSleep(sysinterval_t time);
+  void chThdSleepUntil(systime_t time);
+  msg_t chThdSuspendTimeoutS(thread_reference_t *trp, sysinterval_t timeout);
+  void chThdResumeI(thread_reference_t *trp, msg_t msg);
+  void chThdResumeS(thread_reference_t *trp, msg_t msg);
+  void chThdResume(thread_reference_t *trp, msg_t msg);
+  void chThdQueueObjectInit(threads_queue_t *tqp);
+  msg_t chThdEnqueueTimeoutS(threads_queue_t *tqp, sysinterval_t timeout);
+  void chThdDequeueNextI(threads_queue_t *tqp, msg_t msg);
+  void chThdDequeueAllI(threads_queue_t *tqp, msg_t msg);
+  /* Semaphores.*/
+  void chSemObjectInit(semaphore_t *sp, cnt_t n);
+  void chSemReset(semaphore_t *sp, cnt_t n);
+  void chSemResetI(semaphore_t *sp, cnt_t n);
+  msg_t chSemWait(semaphore_t *sp);
+  msg_t chSemWaitS(semaphore_t *sp);
+  msg_t chSemWaitTimeout(semaphore_t *sp, sysinterval_t timeout);
+  msg_t chSemWaitTimeoutS(semaphore_t *sp, sysinterval_t timeout);
+  void chSemSignal(semaphore_t *sp);
+  void chSemSignalI(semaphore_t *sp);
+  /* Mutexes.*/
+  void chMtxObjectInit(mutex_t *mp);
+  void chMtxLock(mutex_t *mp);
+  void chMtxLockS(mutex_t *mp);
+  bool chMtxTryLock(mutex_t *mp);
+  void chMtxUnlock(mutex_t *mp);
+  void chMtxUnlockS(mutex_t *mp);
+  /* Events.*/
+  void chEvtObjectInit(event_source_t *esp);
+  void chEvtRegisterMaskWithFlags(event_source_t *esp, event_listener_t *elp,
+                                  eventmask_t events, eventflags_t wflags);
+  void chEvtUnregister(event_source_t *esp, event_listener_t *elp);
+  eventflags_t chEvtGetAndClearFlags(event_listener_t *elp);
+  eventflags_t chEvtGetAndClearFlagsI(event_listener_t *elp);
+  eventmask_t chEvtGetAndClearEvents(eventmask_t events);
+  eventmask_t chEvtAddEvents(eventmask_t events);
+  void chEvtSignal(thread_t *tp, eventmask_t events);
+  void chEvtSignalI(thread_t *tp, eventmask_t events);
+  void chEvtBroadcastFlags(event_source_t *esp, eventflags_t flags);
+  void chEvtBroadcastFlagsI(event_source_t *esp, eventflags_t flags);
+  eventmask_t chEvtWaitOne(eventmask_t events);
+  eventmask_t chEvtWaitAny(eventmask_t events);
+  eventmask_t chEvtWaitOneTimeout(eventmask_t events, sysinterval_t timeout);
+  eventmask_t chEvtWaitAnyTimeout(eventmask_t events, sysinterval_t timeout);
+  /* Mailboxes.*/
+  void chMBObjectInit(mailbox_t *mbp, msg_t *buf, size_t n);
+  void chMBReset(mailbox_t *mbp);
+  void chMBResetI(mailbox_t *mbp);
+  void chMBResumeX(mailbox_t *mbp);
+  msg_t chMBPostTimeout(mailbox_t *mbp, msg_t msg, sysinterval_t timeout);
+  msg_t chMBPostTimeoutS(mailbox_t *mbp, msg_t msg, sysinterval_t timeout);
+  msg_t chMBPostI(mailbox_t *mbp, msg_t msg);
+  msg_t chMBFetchTimeout(mailbox_t *mbp, msg_t *msgp, sysinterval_t timeout);
+  msg_t chMBFetchTimeoutS(mailbox_t *mbp, msg_t *msgp, sysinterval_t timeout);
+  msg_t chMBFetchI(mailbox_t *mbp, msg_t *msgp);
+  /* Memory pools and heap.*/
+  void chPoolObjectInit(memory_pool_t *mp, size_t size, memgetfunc_t provider);
+  void chPoolLoadArray(memory_pool_t *mp, void *p, size_t n);
+  void *chPoolAllocI(memory_pool_t *mp);
+  void *chPoolAlloc(memory_pool_t *mp);
+  void chPoolFreeI(memory_pool_t *mp, void *objp);
+  void chPoolFree(memory_pool_t *mp, void *objp);
+  void *chHeapAlloc(memory_heap_t *heapp, size_t size);
+  void chHeapFree(void *p);
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* CH_H */
@@ -0,0 +1,216 @@
+/*
+    ChibiOS - Copyright (C) 2006..2018 Giovanni Di Sirio
+
+    Licensed under the Apache License, Version 2.0 (the "License");
+    you may not use this file except in compliance with the License.
+    You may obtain a copy of the License at
+
+        http://www.apache.org/licenses/LICENSE-2.0
+
+    Unless required by applicable law or agreed to in writing, software
+    distributed under the License is distributed on an "AS IS" BASIS,
+    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+    See the License for the specific language governing permissions and
+    limitations under the License.
+*/
+
+/**
+ * @file    rt/osal.h
+ * @brief   Host OSAL over the emulated RT kernel.
+ * @details Same mapping as the RT OSAL, used by the tests that need
+ *          threads, timeouts and virtual timers.
+ */
+
+#ifndef OSAL_H
+#define OSAL_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "ch.h"
+
+/*===========================================================================*/
+/* Module constants.                                                         */
+/*===========================================================================*/
+
+#define OSAL_ST_MODE_NONE                   0
+#define OSAL_ST_MODE_PERIODIC               1
+#define OSAL_ST_MODE_FREERUNNING            2
+
+#define OSAL_ST_MODE                        OSAL_ST_MODE_NONE
+#define OSAL_ST_FREQUENCY                   CH_CFG_ST_FREQUENCY
+
+/*===========================================================================*/
+/* Module data structures and types.                                         */
+/*===========================================================================*/
+
+
+/*===========================================================================*/
+/* Module macros.                                                            */
+/*===========================================================================*/
+
+#define osalDbgCheck(c)                     chDbgCheck(c)
+#define osalDbgAssert(c, remark)            chDbgAssert(c, remark)
+#define osalDbgCheckClassI()                chDbgCheckClassI()
+#define osalDbgCheckClassS()                chDbgCheckClassS()
+
+#define OSAL_S2I(secs)                      TIME_S2I(secs)
+#define OSAL_MS2I(msecs)                    TIME_MS2I(msecs)
+#define OSAL_US2I(usecs)                    TIME_US2I(usecs)
+
+#define osalThreadSleepSeconds(secs)        osalThreadSleep(OSAL_S2I(secs))
+#define osalThreadSleepMilliseconds(msecs)  osalThreadSleep(OSAL_MS2I(msecs))
+#define osalThreadSleepMicroseconds(usecs)  osalThreadSleep(OSAL_US2I(usecs))
+
+/*===========================================================================*/
+/* External declarations.                                                    */
+/*===========================================================================*/
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+  void osalInit(void);
+#ifdef __cplusplus
+}
+#endif
+
+/*===========================================================================*/
+/* Module inline functions.                                                  */
+/*===========================================================================*/
+
+static inline void osalSysHalt(const char *reason) {
+
+  chSysHalt(reason);
+}
+
+static inline void osalSysLock(void) {
+
+  chSysLock();
+}
+
+static inline void osalSysUnlock(void) {
+
+  chSysUnlock();
+}
+
+static inline void osalSysLockFromISR(void) {
+
+  chSysLockFromISR();
+}
+
+static inline void osalSysUnlockFromISR(void) {
+
+  chSysUnlockFromISR();
+}
+
+static inline syssts_t osalSysGetStatusAndLockX(void) {
+
+  return chSysGetStatusAndLockX();
+}
+
+static inline void osalSysRestoreStatusX(syssts_t sts) {
+
+  chSysRestoreStatusX(sts);
+}
+
+static inline void osalOsRescheduleS(void) {
+
+  chSchRescheduleS();
+}
+
+static inline systime_t osalOsGetSystemTimeX(void) {
+
+  return chVTGetSystemTimeX();
+}
+
+static inline sysinterval_t osalTimeDiffX(systime_t start, systime_t end) {
+
+  return chTimeDiffX(start, end);
+}
+
+static inline void osalThreadSleepS(sysinterval_t time) {
+
+  chThdSleepS(time);
+}
+
+static inline void osalThreadSleep(sysinterval_t time) {
+
+  chThdSleep(time);
+}
+
+static inline msg_t osalThreadSuspendS(thread_reference_t *trp) {
+
+  return chThdSuspendTimeoutS(trp, TIME_INFINITE);
+}
+
+static inline msg_t osalThreadSuspendTimeoutS(thread_reference_t *trp,
+                                              sysinterval_t timeout) {
+
+  return chThdSuspendTimeoutS(trp, timeout);
+}
+
+static inline void osalThreadResumeI(thread_reference_t *trp, msg_t msg) {
+
+  chThdResumeI(trp, msg);
+}
+
+static inline void osalThreadResumeS(thread_reference_t *trp, msg_t msg) {
+
+  chThdResumeS(trp, msg);
+}
+
+static inline void osalThreadQueueObjectInit(threads_queue_t *tqp) {
+
+  chThdQueueObjectInit(tqp);
+}
+
+static inline msg_t osalThreadEnqueueTimeoutS(threads_queue_t *tqp,
+                                              sysinterval_t timeout) {
+
+  return chThdEnqueueTimeoutS(tqp, timeout);
+}
+
+static inline void osalThreadDequeueNextI(threads_queue_t *tqp, msg_t msg) {
+
+  chThdDequeueNextI(tqp, msg);
+}
+
+static inline void osalThreadDequeueAllI(threads_queue_t *tqp, msg_t msg) {
+
+  chThdDequeueAllI(tqp, msg);
+}
+
+static inline void osalEventObjectInit(event_source_t *esp) {
+
+  chEvtObjectInit(esp);
+}
+
+static inline void osalEventBroadcastFlagsI(event_source_t *esp,
+                                            eventflags_t flags) {
+
+  chEvtBroadcastFlagsI(esp, flags);
+}
+
+static inline void osalEventBroadcastFlags(event_source_t *esp,
+                                           eventflags_t flags) {
+
+  chEvtBroadcastFlags(esp, flags);
+}
+
+static inline void osalMutexObjectInit(mutex_t *mp) {
+
+  chMtxObjectInit(mp);
+}
+
+static inline void osalMutexLock(mutex_t *mp) {
+
+  chMtxLock(mp);
+}
+
+static inline void osalMutexUnlock(mutex_t *mp) {
+
+  chMtxUnlock(mp);
+}
+
+#endif /* OSAL_H */
@@ -0,0 +1,34 @@
+/*
+    ChibiOS - Copyright (C) 2006..2018 Giovanni Di Sirio
+
+    Licensed under the Apache License, Version 2.0 (the "License");
+    you may not use this file except in compliance with the License.
+    You may obtain a copy of the License at
+
+        http://www.apache.org/licenses/LICENSE-2.0
+
+    Unless required by applicable law or agreed to in writing, software
+    distributed under the License is distributed on an "AS IS" BASIS,
+    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+    See the License for the specific language governing permissions and
+    limitations under the License.
+*/
+
+#ifndef HAL_H
+#define HAL_H
+
+#include "osal.h"
+
+#define HAL_USE_CRC                         TRUE
+#define STM32_CRC_USE_CRC1                  FALSE
+#define CRCSW_USE_CRC1                      TRUE
+#if !defined(CRCSW_PROGRAMMABLE)
+#define CRCSW_PROGRAMMABLE                  TRUE
+#endif
+#if !defined(CRCSW_PRESETS)
+#define CRCSW_PRESETS                       CRCSW_PROGRAMMABLE
+#endif
+
+#include "hal_crc.h"
+
+#endif /* HAL_H */
@@ -0,0 +1,547 @@
+/*
+    ChibiOS - Copyright (C) 2006..2018 Giovanni Di Sirio
+
+    Licensed under the Apache License, Version 2.0 (the "License");
+    you may not use this file except in compliance with the License.
+    You may obtain a copy of the License at
+
+        http://www.apache.org/licenses/LICENSE-2.0
+
+    Unless required by applicable law or agreed to in writing, software
+    distributed under the License is distributed on an "AS IS" BASIS,
+    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+    See the License for the specific language governing permissions and
+    limitations under the License.
+*/
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "hal.h"
+#include "host_test.h"
+
+/*===========================================================================*/
+/* Reference model.                                                          */
+/*===========================================================================*/
+
+static uint32_t ref_reflect(uint32_t data, unsigned nbits) {
+  uint32_t r = 0;
+
+  while (nbits--) {
+    r = (r << 1) | (data & 1U);
+    data >>= 1;
+  }
+  return r;
+}
+
+/*
+ * Bit at a time CRC, straight from the parametrized model, it shares no
+ * code with the driver.
+ */
+static uint32_t ref_crc(const CRCConfig *cfg, const uint8_t *p, size_t n) {
+  unsigned w = cfg->poly_size;
+  uint32_t top = 1UL << (w - 1);
+  uint32_t mask = top | (top - 1U);
+  uint32_t crc = cfg->initial_val & mask;
+  unsigned bit;
+
+  while (n--) {
+    uint32_t c = *p++;
+
+    if (cfg->reflect_data) {
+      c = ref_reflect(c, 8);
+    }
+    for (bit = 0; bit < 8; bit++) {
+      bool b = ((crc & top) != 0U) != ((c & 0x80U) != 0U);
+
+      crc = (crc << 1) & mask;
+      if (b) {
+        crc ^= cfg->poly & mask;
+      }
+      c <<= 1;
+    }
+  }
+  if (cfg->reflect_remainder) {
+    crc = ref_reflect(crc, w);
+  }
+  return (crc ^ cfg->final_val) & mask;
+}
+
+/*===========================================================================*/
+/* Configurations under test.                                                */
+/*===========================================================================*/
+
+typedef struct {
+  const char                *name;
+  const CRCConfig           *config;
+  uint32_t                  check;
+} test_config_t;
+
+static const test_config_t test_configs[] = {
+#if CRCSW_CRC32_TABLE
+  {"CRC-32 (const table)",   CRCSW_CRC32_TABLE_CONFIG, 0xCBF43926},
+#endif
+#if CRCSW_CRC16_TABLE
+  {"CRC-16/ARC (const table)", CRCSW_CRC16_TABLE_CONFIG, 0x0000BB3D},
+#endif
+  {NULL, NULL, 0}
+};
+
+static size_t configs_count(void) {
+  size_t n = sizeof(test_configs) / sizeof(test_configs[0]) - 1U;
+
+#if CRCSW_PRESETS
+  n += crcsw_presets_count;
+#endif
+  return n;
+}
+
+static test_config_t config_at(size_t i) {
+  size_t fixed = sizeof(test_configs) / sizeof(test_configs[0]) - 1U;
+
+  if (i < fixed) {
+    return test_configs[i];
+  }
+#if CRCSW_PRESETS
+  i -= fixed;
+  return (test_config_t){crcsw_presets[i].name, crcsw_presets[i].config,
+                         crcsw_presets[i].check};
+#else
+  abort();
+#endif
+}
+
+/*===========================================================================*/
+/* Tests.                                                                    */
+/*===========================================================================*/
+
+static const uint8_t check_string[] = "123456789";
+
+/*
+ * Catalogue check value, in one call and split at every position so that
+ * every alignment of the slice-by-N tail is exercised.
+ */
+static void test_check_values(void) {
+  size_t i, split;
+
+  for (i = 0; i < configs_count(); i++) {
+    test_config_t tc = config_at(i);
+    uint32_t crc;
+
+    crcStart(&CRCD1, tc.config);
+    crcReset(&CRCD1);
+    crc = crcCalc(&CRCD1, 9, check_string);
+    HOST_CHECK(crc == tc.check, "%s: 0x%08X, expected 0x%08X",
+               tc.name, (unsigned)crc, (unsigned)tc.check);
+    HOST_CHECK(ref_crc(tc.config, check_string, 9) == tc.check,
+               "%s: reference model disagrees with the catalogue", tc.name);
+
+    for (split = 1; split < 9; split++) {
+      crcReset(&CRCD1);
+      (void)crcCalc(&CRCD1, split, check_string);
+      crc = crcCalc(&CRCD1, 9 - split, check_string + split);
+      HOST_CHECK(crc == tc.check, "%s: split at %u: 0x%08X",
+                 tc.name, (unsigned)split, (unsigned)crc);
+    }
+    crcStop(&CRCD1);
+  }
+}
+
+/*
+ * Random lengths and misaligned buffers against the reference model.
+ */
+static void test_random_buffers(void) {
+  static uint8_t buf[1100 + 16];
+  size_t i, j, k;
+
+  hostSeed(0x1234);
+  for (k = 0; k < sizeof(buf); k++) {
+    buf[k] = (uint8_t)hostRand();
+  }
+
+  for (i = 0; i < configs_count(); i++) {
+    test_config_t tc = config_at(i);
+
+    crcStart(&CRCD1, tc.config);
+    for (j = 0; j < 200; j++) {
+      size_t off = hostRand() % 16U;
+      size_t n = 1U + hostRand() % 1100U;
+      uint32_t crc;
+
+      crcReset(&CRCD1);
+      crc = crcCalc(&CRCD1, n, buf + off);
+      HOST_CHECK(crc == ref_crc(tc.config, buf + off, n),
+                 "%s: %u bytes at offset %u", tc.name, (unsigned)n,
+                 (unsigned)off);
+    }
+    crcStop(&CRCD1);
+  }
+}
+
+#if CRCSW_PROGRAMMABLE
+/*
+ * Catalogue entries that are not presets: odd widths, polynomials with
+ * the top bit set and reflect_data != reflect_remainder.
+ */
+static const struct {
+  const char                *name;
+  CRCConfig                 config;
+  uint32_t                  check;
+} arbitrary_configs[] = {
+  {"CRC-8/DARC",      {8,  0x39,       0x00,       0x00,       1, 1, NULL},
+                      0x15},
+  {"CRC-10/ATM",      {10, 0x233,      0x000,      0x000,      0, 0, NULL},
+                      0x199},
+  {"CRC-12/DECT",     {12, 0x80F,      0x000,      0x000,      0, 0, NULL},
+                      0xF5B},
+  {"CRC-12/UMTS",     {12, 0x80F,      0x000,      0x000,      0, 1, NULL},
+                      0xDAF},
+  {"CRC-14/DARC",     {14, 0x0805,     0x0000,     0x0000,     1, 1, NULL},
+                      0x082D},
+  {"CRC-15/CAN",      {15, 0x4599,     0x0000,     0x0000,     0, 0, NULL},
+                      0x059E},
+  {"CRC-16/USB",      {16, 0x8005,     0xFFFF,     0xFFFF,     1, 1, NULL},
+                      0xB4C8},
+  {"CRC-17/CAN-FD",   {17, 0x1685B,    0x00000,    0x00000,    0, 0, NULL},
+                      0x04F03},
+  {"CRC-21/CAN-FD",   {21, 0x102899,   0x000000,   0x000000,   0, 0, NULL},
+                      0x0ED841},
+  {"CRC-24/OPENPGP",  {24, 0x864CFB,   0xB704CE,   0x000000,   0, 0, NULL},
+                      0x21CF02},
+  {"CRC-24/FLEXRAY-A",{24, 0x5D6DCB,   0xFEDCBA,   0x000000,   0, 0, NULL},
+                      0x7979BD},
+  {"CRC-31/PHILIPS",  {31, 0x04C11DB7, 0x7FFFFFFF, 0x7FFFFFFF, 0, 0, NULL},
+                      0x0CE9E46C},
+  {"CRC-32/BZIP2",    {32, 0x04C11DB7, 0xFFFFFFFF, 0xFFFFFFFF, 0, 0, NULL},
+                      0xFC891918}
+};
+
+/*
+ * Tables generated for arbitrary polynomials: catalogue check values, then
+ * random widths, polynomials, initial values, final XORs and reflections
+ * against the reference model.
+ */
+static void test_arbitrary_polynomials(void) {
+  static uint8_t buf[300];
+  size_t i, j, k;
+
+  for (i = 0; i < sizeof(arbitrary_configs) / sizeof(arbitrary_configs[0]);
+       i++) {
+    const CRCConfig *cfg = &arbitrary_configs[i].config;
+    uint32_t crc;
+
+    crcStart(&CRCD1, cfg);
+    crcReset(&CRCD1);
+    crc = crcCalc(&CRCD1, 9, check_string);
+    HOST_CHECK(crc == arbitrary_configs[i].check, "%s: 0x%08X",
+               arbitrary_configs[i].name, (unsigned)crc);
+    HOST_CHECK(ref_crc(cfg, check_string, 9) == arbitrary_configs[i].check,
+               "%s: reference model disagrees with the catalogue",
+               arbitrary_configs[i].name);
+    crcStop(&CRCD1);
+  }
+
+  hostSeed(0xC0FFEE);
+  for (k = 0; k < sizeof(buf); k++) {
+    buf[k] = (uint8_t)hostRand();
+  }
+  for (i = 0; i < 500; i++) {
+    CRCConfig cfg;
+    uint32_t mask;
+
+    cfg.poly_size         = 8U + hostRand() % 25U;
+    mask                  = 0xFFFFFFFFU >> (32U - cfg.poly_size);
+    cfg.poly              = (hostRand() & mask) | 1U;
+    cfg.initial_val       = hostRand() & mask;
+    cfg.final_val         = hostRand() & mask;
+    cfg.reflect_data      = (hostRand() & 1U) != 0U;
+    cfg.reflect_remainder = (hostRand() & 1U) != 0U;
+    cfg.table             = NULL;
+
+    crcStart(&CRCD1, &cfg);
+    for (j = 0; j < 4; j++) {
+      size_t n = 1U + hostRand() % sizeof(buf);
+      uint32_t crc;
+
+      crcReset(&CRCD1);
+      crc = crcCalc(&CRCD1, n, buf);
+      HOST_CHECK(crc == ref_crc(&cfg, buf, n),
+                 "width %u poly 0x%X init 0x%X xor 0x%X refin %d refout %d:"
+                 " %u bytes", (unsigned)cfg.poly_size, (unsigned)cfg.poly,
+                 (unsigned)cfg.initial_val, (unsigned)cfg.final_val,
+                 cfg.reflect_data, cfg.reflect_remainder, (unsigned)n);
+    }
+    crcStop(&CRCD1);
+  }
+}
+#endif
+
+#if CRC_USE_COMBINE
+/*
+ * Computes crc(A) and crc(B) from the configured initial value and checks
+ * crcCombine(crc(A), crc(B), len(B)) == crc(A|B).
+ */
+static void check_combine(const char *name, const CRCConfig *cfg,
+                          const uint8_t *buf, size_t len_a, size_t len_b) {
+  uint32_t crc_a, crc_b, crc_ab, crc;
+
+  crcStart(&CRCD1, cfg);
+  crcReset(&CRCD1);
+  crc_ab = crcCalc(&CRCD1, len_a + len_b, buf);
+  crcReset(&CRCD1);
+  crc_a = crcCalc(&CRCD1, len_a, buf);
+  crcReset(&CRCD1);
+  crc_b = crcCalc(&CRCD1, len_b, buf + len_a);
+  crc = crcCombine(&CRCD1, crc_a, crc_b, len_b);
+  HOST_CHECK(crc == crc_ab, "%s: combine %u+%u bytes: 0x%08X, expected"
+             " 0x%08X", name, (unsigned)len_a, (unsigned)len_b,
+             (unsigned)crc, (unsigned)crc_ab);
+  crcStop(&CRCD1);
+}
+
+static void test_combine(void) {
+  static uint8_t buf[2048];
+  size_t i, j, k;
+
+  hostSeed(0xBEEF);
+  for (k = 0; k < sizeof(buf); k++) {
+    buf[k] = (uint8_t)hostRand();
+  }
+
+  /* Every configuration, split points including 1 byte long parts.*/
+  for (i = 0; i < configs_count(); i++) {
+    test_config_t tc = config_at(i);
+    static const size_t splits[][2] = {
+      {1, 1}, {1, 9}, {9, 1}, {4, 4}, {7, 13}, {100, 1}, {1, 100},
+      {512, 512}, {1000, 1047}
+    };
+
+    for (j = 0; j < sizeof(splits) / sizeof(splits[0]); j++) {
+      check_combine(tc.name, tc.config, buf, splits[j][0], splits[j][1]);
+    }
+    for (j = 0; j < 50; j++) {
+      size_t len_a = 1U + hostRand() % 1024U;
+      size_t len_b = 1U + hostRand() % 1024U;
+
+      check_combine(tc.name, tc.config, buf, len_a, len_b);
+    }
+  }
+
+#if CRCSW_PROGRAMMABLE
+  /* Random configurations, non-zero initial values and final XORs.*/
+  for (i = 0; i < 200; i++) {
+    CRCConfig cfg;
+    uint32_t mask;
+
+    cfg.poly_size         = 8U + hostRand() % 25U;
+    mask                  = 0xFFFFFFFFU >> (32U - cfg.poly_size);
+    cfg.poly              = (hostRand() & mask) | 1U;
+    cfg.initial_val       = (hostRand() & mask) | 1U;
+    cfg.final_val         = (hostRand() & mask) | 1U;
+    cfg.reflect_data      = (hostRand() & 1U) != 0U;
+    cfg.reflect_remainder = (hostRand() & 1U) != 0U;
+    cfg.table             = NULL;
+
+    check_combine("random", &cfg, buf, 1U + hostRand() % 1024U,
+                  1U + hostRand() % 1024U);
+  }
+#endif
+}
+#endif
+
+#if CRCSW_GENERATED_TABLES
+/*
+ * crcStart() runs with the kernel locked, the tables must not be acquired
+ * there but by crcswPrepareTable() or the first calculation.
+ */
+static void test_tables_outside_lock(void) {
+  size_t i;
+
+  for (i = 0; i < configs_count(); i++) {
+    test_config_t tc = config_at(i);
+    bool generated = (CRCSW_SLICE_BY > 1) || (tc.config->table == NULL);
+    uint32_t crc;
+
+    crcStart(&CRCD1, tc.config);
+    HOST_CHECK((CRCD1.table_config == NULL) && (CRCD1.tables == NULL),
+               "%s: tables acquired by crcStart()", tc.name);
+
+    /* Lazy acquisition by the first calculation.*/
+    crcReset(&CRCD1);
+    crc = crcCalc(&CRCD1, 9, check_string);
+    HOST_CHECK(crc == tc.check, "%s: lazy tables: 0x%08X", tc.name,
+               (unsigned)crc);
+    HOST_CHECK((CRCD1.table_config == tc.config) == generated,
+               "%s: table_config", tc.name);
+    HOST_CHECK((CRCD1.tables != NULL) == generated, "%s: tables", tc.name);
+    crcStop(&CRCD1);
+    HOST_CHECK(CRCD1.tables == NULL, "%s: tables kept by crcStop()",
+               tc.name);
+
+    /* Explicit acquisition, the lock is released on return.*/
+    crcStart(&CRCD1, tc.config);
+    crcswPrepareTable(&CRCD1);
+    HOST_CHECK(!osalIsLocked(), "lock held");
+    HOST_CHECK((CRCD1.tables != NULL) == generated,
+               "%s: tables not acquired by crcswPrepareTable()", tc.name);
+    crcReset(&CRCD1);
+    crc = crcCalc(&CRCD1, 9, check_string);
+    HOST_CHECK(crc == tc.check, "%s: prepared tables: 0x%08X", tc.name,
+               (unsigned)crc);
+    crcStop(&CRCD1);
+  }
+}
+#endif
+
+#if CRCSW_GENERATED_TABLES && CRCSW_PROGRAMMABLE
+static const CRCConfig crc32_config = {
+  32, 0x04C11DB7, 0xFFFFFFFF, 0xFFFFFFFF, true, true, NULL
+};
+/* CRC-32/JAMCRC, same tables as CRC-32.*/
+static const CRCConfig jamcrc_config = {
+  32, 0x04C11DB7, 0xFFFFFFFF, 0x00000000, true, true, NULL
+};
+static const CRCConfig crc16_ccitt_config = {
+  16, 0x1021, 0xFFFF, 0x0000, false, false, NULL
+};
+
+static uint32_t calc_check(CRCDriver *crcp) {
+
+  crcReset(crcp);
+  return crcCalc(crcp, 9, check_string);
+}
+
+/*
+ * Two driver instances with the same polynomial share one table set, a
+ * restart with the same polynomial reuses the set without generating it.
+ * Entry 0 of table 0 is always zero, a marker written there survives
+ * only if the tables are not generated again.
+ */
+static void test_shared_tables(void) {
+  static CRCDriver crc2;
+  CRCSWTables *tp;
+
+  crcObjectInit(&crc2);
+  crc2.table_config = NULL;
+  crc2.tables = NULL;
+
+  crcStart(&CRCD1, &crc32_config);
+  crcStart(&crc2, &jamcrc_config);
+  HOST_CHECK(calc_check(&CRCD1) == 0xCBF43926U, "CRC-32");
+  HOST_CHECK(calc_check(&crc2) == 0x340BC6D9U, "CRC-32/JAMCRC");
+  tp = CRCD1.tables;
+  HOST_CHECK((tp != NULL) && (crc2.tables == tp), "set not shared");
+  HOST_CHECK(tp->refs == 2U, "refs %u", tp->refs);
+
+  /* Restart with the same polynomial.*/
+  tp->table[0][0] = 0xDEAD;
+  crcStop(&crc2);
+  HOST_CHECK(tp->refs == 1U, "refs %u after stop", tp->refs);
+  crcStart(&crc2, &crc32_config);
+  crcswPrepareTable(&crc2);
+  HOST_CHECK((crc2.tables == tp) && (tp->table[0][0] == 0xDEAD),
+             "tables generated again");
+  tp->table[0][0] = 0;
+  HOST_CHECK(calc_check(&crc2) == 0xCBF43926U, "CRC-32 after restart");
+  crcStop(&crc2);
+  crcStop(&CRCD1);
+  HOST_CHECK(tp->refs == 0U, "refs %u after stopping both", tp->refs);
+
+#if CRCSW_TABLE_SETS > 1
+  /* Another polynomial takes another set, the first one stays valid.*/
+  tp->table[0][0] = 0xDEAD;
+  crcStart(&crc2, &crc16_ccitt_config);
+  HOST_CHECK(calc_check(&crc2) == 0x29B1U, "CRC-16/CCITT-FALSE");
+  HOST_CHECK((crc2.tables != NULL) && (crc2.tables != tp), "set evicted");
+  crcStart(&CRCD1, &crc32_config);
+  crcswPrepareTable(&CRCD1);
+  HOST_CHECK((CRCD1.tables == tp) && (tp->table[0][0] == 0xDEAD),
+             "CRC-32 tables generated again");
+  tp->table[0][0] = 0;
+  HOST_CHECK(calc_check(&CRCD1) == 0xCBF43926U, "CRC-32 after eviction");
+  crcStop(&CRCD1);
+  crcStop(&crc2);
+#else
+  /* The only set is reused for another polynomial.*/
+  crcStart(&crc2, &crc16_ccitt_config);
+  HOST_CHECK(calc_check(&crc2) == 0x29B1U, "CRC-16/CCITT-FALSE");
+  HOST_CHECK(crc2.tables == tp, "set not reused");
+  crcStop(&crc2);
+#endif
+}
+#endif
+
+/*===========================================================================*/
+/* Benchmarks.                                                               */
+/*===========================================================================*/
+
+#define BENCH_BUF_SIZE      65536
+#define BENCH_ROUNDS        64
+
+static void bench(void) {
+  static uint8_t buf[BENCH_BUF_SIZE];
+  size_t i, k;
+
+  for (k = 0; k < sizeof(buf); k++) {
+    buf[k] = (uint8_t)hostRand();
+  }
+
+  printf("  %-26s %10s %12s %10s\n", "configuration", "start(ns)",
+         "prepare(ns)", "MB/s");
+  for (i = 0; i < configs_count(); i++) {
+    test_config_t tc = config_at(i);
+    uint64_t t0, t_prep, t_calc, locked;
+
+    osalResetLockStats();
+    crcStart(&CRCD1, tc.config);
+    locked = osalMaxLockedNs();
+
+    t0 = hostNowNs();
+    crcswPrepareTable(&CRCD1);
+    t_prep = hostNowNs() - t0;
+
+    t0 = hostNowNs();
+    for (k = 0; k < BENCH_ROUNDS; k++) {
+      crcReset(&CRCD1);
+      (void)crcCalc(&CRCD1, sizeof(buf), buf);
+    }
+    t_calc = hostNowNs() - t0;
+    crcStop(&CRCD1);
+
+    printf("  %-26s %10llu %12llu %10.1f\n", tc.name,
+           (unsigned long long)locked, (unsigned long long)t_prep,
+           (double)BENCH_BUF_SIZE * BENCH_ROUNDS * 1000.0 / (double)t_calc);
+  }
+}
+
+/*===========================================================================*/
+/* Main.                                                                     */
+/*===========================================================================*/
+
+int main(int argc, char *argv[]) {
+
+  hostInit(argc, argv);
+  crcInit();
+
+  test_check_values();
+  test_random_buffers();
+#if CRCSW_PROGRAMMABLE
+  test_arbitrary_polynomials();
+#endif
+#if CRC_USE_COMBINE
+  test_combine();
+#endif
+#if CRCSW_GENERATED_TABLES
+  test_tables_outside_lock();
+#endif
+#if CRCSW_GENERATED_TABLES && CRCSW_PROGRAMMABLE
+  test_shared_tables();
+#endif
+
+  if (host_bench) {
+    printf("%s, slice-by-%d\n", argv[0], CRCSW_SLICE_BY);
+    bench();
+  }
+
+  return hostReport(argv[0]);
+}
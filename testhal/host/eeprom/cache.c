@@ -0,0 +1,530 @@
+/*
+    ChibiOS - Copyright (C) 2006..2018 Giovanni Di Sirio
+
+    Licensed under the Apache License, Version 2.0 (the "License");
+    you may not use this file except in compliance with the License.
+    You may obtain a copy of the License at
+
+        http://www.apache.org/licenses/LICENSE-2.0
+
+    Unless required by applicable law or agreed to in writing, software
+    distributed under the License is distributed on an "AS IS" BASIS,
+    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+    See the License for the specific language governing permissions and
+    limitations under the License.
+*/
+
+/*
+ * Line cache of the EEPROM file streams (EEPROM_USE_CACHE) over a simulated
+ * 24xx with 32 byte pages, lines cut by the page, and a simulated 25xx with
+ * 128 byte pages, lines of EEPROM_CACHE_SIZE. Both files start in the middle
+ * of a line. The ICs are never busy, only the transactions are counted.
+ */
+
+#include <string.h>
+
+#include "hal.h"
+#include "host_test.h"
+
+/*===========================================================================*/
+/* Simulated ICs.                                                            */
+/*===========================================================================*/
+
+#define MEM_SIZE                            8192U
+#define PAGE_24XX                           32U
+#define PAGE_25XX                           128U
+
+#define CMD_WRITE                           0x02U
+#define CMD_READ                            0x03U
+#define CMD_WRDI                            0x04U
+#define CMD_RDSR                            0x05U
+#define CMD_WREN                            0x06U
+#define STAT_WEL                            0x02U
+
+typedef struct {
+  uint8_t                   mem[MEM_SIZE];
+  /* Bus transactions, of them array reads and array writes.*/
+  unsigned                  transactions;
+  unsigned                  reads;
+  unsigned                  writes;
+} sim_t;
+
+static sim_t sim24, sim25;
+
+/* Data past the end of the page wraps to its beginning.*/
+static void program(sim_t *simp, uint32_t pagesize, uint32_t pointer,
+                    const uint8_t *data, size_t n) {
+  uint32_t page = pointer & ~(pagesize - 1U);
+
+  simp->writes++;
+  while (n-- > 0U) {
+    simp->mem[page | (pointer & (pagesize - 1U))] = *data++;
+    pointer = page | ((pointer + 1U) & (pagesize - 1U));
+  }
+}
+
+static void fetch(sim_t *simp, uint32_t pointer, uint8_t *data, size_t n) {
+
+  simp->reads++;
+  while (n-- > 0U) {
+    *data++ = simp->mem[pointer];
+    pointer = (pointer + 1U) % MEM_SIZE;
+  }
+}
+
+systime_t chVTGetSystemTimeX(void) {
+
+  return 0;
+}
+
+void chThdYield(void) {
+}
+
+msg_t i2cMasterTransmitTimeout(I2CDriver *i2cp, i2caddr_t addr,
+                               const uint8_t *txbuf, size_t txbytes,
+                               uint8_t *rxbuf, size_t rxbytes,
+                               sysinterval_t timeout) {
+  uint32_t pointer;
+
+  (void)timeout;
+  osalDbgCheck((addr == 0x50U) && (txbytes >= 2U));
+
+  i2cp->errors = 0;
+  sim24.transactions++;
+  pointer = (((uint32_t)txbuf[0] << 8) | txbuf[1]) % MEM_SIZE;
+  if (txbytes > 2U) {
+    program(&sim24, PAGE_24XX, pointer, &txbuf[2], txbytes - 2U);
+  }
+  if (rxbytes > 0U) {
+    fetch(&sim24, pointer, rxbuf, rxbytes);
+  }
+  return MSG_OK;
+}
+
+/* Bytes sent since the chip select, 16 bit addresses.*/
+static struct {
+  uint8_t                   buf[3U + PAGE_25XX];
+  size_t                    len;
+  bool                      wel;
+} frame;
+
+void spiSelect(SPIDriver *spip) {
+
+  osalDbgCheck(spip->state == SPI_READY);
+  sim25.transactions++;
+  frame.len = 0;
+}
+
+void spiSend(SPIDriver *spip, size_t n, const void *txbuf) {
+
+  (void)spip;
+  osalDbgCheck(frame.len + n <= sizeof(frame.buf));
+  memcpy(&frame.buf[frame.len], txbuf, n);
+  frame.len += n;
+}
+
+void spiReceive(SPIDriver *spip, size_t n, void *rxbuf) {
+
+  (void)spip;
+  if (frame.buf[0] == CMD_RDSR) {
+    memset(rxbuf, frame.wel ? STAT_WEL : 0U, n);
+    return;
+  }
+  osalDbgCheck((frame.buf[0] == CMD_READ) && (frame.len == 3U));
+  fetch(&sim25, (((uint32_t)frame.buf[1] << 8) | frame.buf[2]) % MEM_SIZE,
+        rxbuf, n);
+}
+
+void spiUnselect(SPIDriver *spip) {
+
+  (void)spip;
+  switch (frame.buf[0]) {
+  case CMD_WREN:
+    frame.wel = true;
+    break;
+  case CMD_WRDI:
+    frame.wel = false;
+    break;
+  case CMD_WRITE:
+    osalDbgCheck(frame.wel && (frame.len > 3U));
+    program(&sim25, PAGE_25XX,
+            (((uint32_t)frame.buf[1] << 8) | frame.buf[2]) % MEM_SIZE,
+            &frame.buf[3], frame.len - 3U);
+    frame.wel = false;
+    break;
+  default:
+    break;
+  }
+}
+
+/*===========================================================================*/
+/* Helpers.                                                                  */
+/*===========================================================================*/
+
+#define FILE_START                          100U
+#define FILE_SIZE                           4096U
+/* Bytes of the first line in the file, on both ICs.*/
+#define FIRST_LINE                          28U
+
+extern EepromDevice eepdev_24xx;
+extern EepromDevice eepdev_25xx;
+
+static I2CDriver i2c;
+static uint8_t write_buf[PAGE_24XX + 2U];
+static const I2CEepromFileConfig cfg24 = {
+  FILE_START,
+  FILE_START + FILE_SIZE,
+  MEM_SIZE,
+  PAGE_24XX,
+  TIME_MS2I(5),
+  &i2c,
+  0x50,
+  write_buf
+};
+static I2CEepromFileStream ifs;
+
+static SPIDriver spid = {SPI_READY};
+static const SPIEepromFileConfig cfg25 = {
+  FILE_START,
+  FILE_START + FILE_SIZE,
+  MEM_SIZE,
+  PAGE_25XX,
+  TIME_MS2I(5),
+  &spid,
+  NULL
+};
+static SPIEepromFileStream sfs;
+
+static EepromFileStream *open_24xx(void) {
+
+  memset(&ifs, 0, sizeof(ifs));
+  return I2CEepromFileOpen(&ifs, &cfg24, &eepdev_24xx);
+}
+
+static EepromFileStream *open_25xx(void) {
+
+  memset(&sfs, 0, sizeof(sfs));
+  return SPIEepromFileOpen(&sfs, &cfg25, &eepdev_25xx);
+}
+
+typedef struct {
+  const char                *name;
+  sim_t                     *simp;
+  uint32_t                  linesize;
+  EepromFileStream          *(*open)(void);
+} device_t;
+
+static const device_t devices[] = {
+  {"24xx", &sim24, PAGE_24XX, open_24xx},
+  {"25xx", &sim25, EEPROM_CACHE_SIZE, open_25xx}
+};
+
+static EepromFileStream *efs;
+static uint8_t model[FILE_SIZE];
+
+static uint8_t mem_byte(uint32_t i) {
+
+  return (uint8_t)(i * 13U + 5U);
+}
+
+static void setup(const device_t *dp) {
+  uint32_t i;
+
+  for (i = 0; i < MEM_SIZE; i++) {
+    dp->simp->mem[i] = mem_byte(i);
+  }
+  memcpy(model, &dp->simp->mem[FILE_START], FILE_SIZE);
+  dp->simp->transactions = 0;
+  dp->simp->reads = 0;
+  dp->simp->writes = 0;
+  efs = dp->open();
+}
+
+/* The file matches the model and nothing outside it is touched.*/
+static bool chip_ok(const device_t *dp) {
+  uint32_t i;
+
+  if (memcmp(&dp->simp->mem[FILE_START], model, FILE_SIZE) != 0) {
+    return false;
+  }
+  for (i = 0; i < MEM_SIZE; i++) {
+    if (((i < FILE_START) || (i >= FILE_START + FILE_SIZE)) &&
+        (dp->simp->mem[i] != mem_byte(i))) {
+      return false;
+    }
+  }
+  return true;
+}
+
+/*===========================================================================*/
+/* Tests.                                                                    */
+/*===========================================================================*/
+
+/* Byte, halfword or word write or read at the position, little endian.*/
+static void access(uint32_t pos) {
+  uint32_t size = 1U << (hostRand() % 3U);
+  uint32_t v = hostRand(), back = 0;
+
+  if ((hostRand() % 2U) == 0U) {
+    switch (size) {
+    case 1:
+      HOST_CHECK(EepromWriteByte(efs, (uint8_t)v) == 1U, "byte write");
+      break;
+    case 2:
+      HOST_CHECK(EepromWriteHalfword(efs, (uint16_t)v) == 2U,
+                 "halfword write");
+      break;
+    default:
+      HOST_CHECK(EepromWriteWord(efs, v) == 4U, "word write");
+      break;
+    }
+    memcpy(&model[pos], &v, size);
+  }
+  else {
+    switch (size) {
+    case 1:
+      v = EepromReadByte(efs);
+      break;
+    case 2:
+      v = EepromReadHalfword(efs);
+      break;
+    default:
+      v = EepromReadWord(efs);
+      break;
+    }
+    memcpy(&back, &model[pos], size);
+    HOST_CHECK(v == back, "%u byte read at %u", (unsigned)size,
+               (unsigned)pos);
+  }
+}
+
+/*
+ * Random transfers, accessors, put/get, seeks and flushes against a model.
+ * Transfers shorter than a line reach the IC only as line fills and
+ * write-backs, the IC matches the model after each flush and the close.
+ */
+static void test_random(const device_t *dp) {
+  static uint8_t buf[300], back[300];
+  EepromCacheStats before, after;
+  unsigned seed, op, reads, writes;
+  uint32_t pos, n, i;
+  bool large;
+  msg_t b;
+
+  for (seed = 1; seed <= 5U; seed++) {
+    hostSeed(seed);
+    setup(dp);
+    pos = 0;
+    for (op = 0; op < 20000U; op++) {
+      EepromFileGetCacheStats(efs, &before);
+      reads = dp->simp->reads;
+      writes = dp->simp->writes;
+      n = 1U + hostRand() % ((hostRand() % 8U) != 0U ? 8U : sizeof(buf));
+      if (pos + n > FILE_SIZE) {
+        n = FILE_SIZE - pos;
+      }
+      large = false;
+
+      switch (hostRand() % 6U) {
+      case 0:
+        for (i = 0; i < n; i++) {
+          buf[i] = (uint8_t)hostRand();
+        }
+        large = n >= dp->linesize;
+        HOST_CHECK(fileStreamWrite(efs, buf, n) == n, "%s: write %u at %u",
+                   dp->name, (unsigned)n, (unsigned)pos);
+        memcpy(&model[pos], buf, n);
+        pos += n;
+        break;
+      case 1:
+        large = n >= dp->linesize;
+        HOST_CHECK(fileStreamRead(efs, back, n) == n, "%s: read %u at %u",
+                   dp->name, (unsigned)n, (unsigned)pos);
+        HOST_CHECK(memcmp(back, &model[pos], n) == 0, "%s: data at %u",
+                   dp->name, (unsigned)pos);
+        pos += n;
+        break;
+      case 2:
+        if (pos + 4U <= FILE_SIZE) {
+          access(pos);
+          pos = (uint32_t)fileStreamGetPosition(efs, NULL);
+        }
+        break;
+      case 3:
+        if (pos == FILE_SIZE) {
+          HOST_CHECK(fileStreamGet(efs) == STM_RESET, "%s: get at the end",
+                     dp->name);
+        }
+        else if ((hostRand() % 2U) == 0U) {
+          model[pos] = (uint8_t)hostRand();
+          HOST_CHECK(fileStreamPut(efs, model[pos]) == STM_OK, "%s: put",
+                     dp->name);
+          pos++;
+        }
+        else {
+          b = fileStreamGet(efs);
+          HOST_CHECK(b == model[pos], "%s: get at %u", dp->name,
+                     (unsigned)pos);
+          pos++;
+        }
+        break;
+      case 4:
+        pos = hostRand() % (FILE_SIZE + 1U);
+        fileStreamSeek(efs, pos);
+        break;
+      default:
+        HOST_CHECK(EepromFileFlush(efs) == FILE_OK, "%s: flush", dp->name);
+        HOST_CHECK(memcmp(&dp->simp->mem[FILE_START], model, FILE_SIZE) == 0,
+                   "%s: contents after a flush", dp->name);
+        break;
+      }
+
+      HOST_CHECK((uint32_t)fileStreamGetPosition(efs, NULL) == pos,
+                 "%s: position", dp->name);
+      if (!large) {
+        EepromFileGetCacheStats(efs, &after);
+        HOST_CHECK(dp->simp->reads - reads ==
+                   after.read_misses - before.read_misses,
+                   "%s: %u array reads for %u misses", dp->name,
+                   dp->simp->reads - reads,
+                   (unsigned)(after.read_misses - before.read_misses));
+        HOST_CHECK(dp->simp->writes - writes ==
+                   after.writebacks - before.writebacks,
+                   "%s: %u array writes for %u write-backs", dp->name,
+                   dp->simp->writes - writes,
+                   (unsigned)(after.writebacks - before.writebacks));
+      }
+    }
+
+    HOST_CHECK(fileStreamClose(efs) == FILE_OK, "%s: close", dp->name);
+    HOST_CHECK(chip_ok(dp), "%s: contents, seed %u", dp->name, seed);
+  }
+}
+
+/*
+ * Counters of a fixed sequence: line fills, reads from the line, writes
+ * merged until a flush or a seek out of the line, a write-back each.
+ */
+static void test_counters(const device_t *dp) {
+  EepromCacheStats st;
+  uint32_t i, v;
+
+  setup(dp);
+  for (i = 0; i < FIRST_LINE; i += 4U) {
+    memcpy(&v, &model[i], 4);
+    HOST_CHECK(EepromReadWord(efs) == v, "%s: word %u", dp->name,
+               (unsigned)i);
+  }
+  HOST_CHECK(EepromReadByte(efs) == model[FIRST_LINE], "%s: byte", dp->name);
+
+  fileStreamSeek(efs, 40);
+  (void)EepromWriteHalfword(efs, 0x1234U);
+  (void)EepromWriteHalfword(efs, 0x5678U);
+  memcpy(&model[40], (const uint8_t []){0x34, 0x12, 0x78, 0x56}, 4);
+  HOST_CHECK(dp->simp->writes == 0U, "%s: merged writes reached the IC",
+             dp->name);
+  fileStreamSeek(efs, 40);
+  HOST_CHECK(EepromReadHalfword(efs) == 0x1234U, "%s: merged data", dp->name);
+
+  HOST_CHECK(EepromFileFlush(efs) == FILE_OK, "%s: flush", dp->name);
+  HOST_CHECK(dp->simp->writes == 1U, "%s: %u writes after a flush",
+             dp->name, dp->simp->writes);
+  HOST_CHECK(EepromFileFlush(efs) == FILE_OK, "%s: flush", dp->name);
+  HOST_CHECK(dp->simp->writes == 1U, "%s: clean line written", dp->name);
+
+  fileStreamSeek(efs, 200);
+  (void)EepromWriteByte(efs, 0xA5U);
+  model[200] = 0xA5U;
+  fileStreamSeek(efs, 0);
+  HOST_CHECK(dp->simp->writes == 2U, "%s: no write-back on a seek",
+             dp->name);
+
+  EepromFileGetCacheStats(efs, &st);
+  HOST_CHECK((st.read_hits == 7U) && (st.read_misses == 2U) &&
+             (st.writes == 3U) && (st.writebacks == 2U),
+             "%s: %u hits, %u misses, %u writes, %u write-backs", dp->name,
+             (unsigned)st.read_hits, (unsigned)st.read_misses,
+             (unsigned)st.writes, (unsigned)st.writebacks);
+  HOST_CHECK((dp->simp->reads == 2U) && (dp->simp->writes == 2U),
+             "%s: %u array reads, %u array writes", dp->name,
+             dp->simp->reads, dp->simp->writes);
+  HOST_CHECK(fileStreamClose(efs) == FILE_OK, "%s: close", dp->name);
+  HOST_CHECK(chip_ok(dp), "%s: contents", dp->name);
+}
+
+#define RECORDS                             200U
+
+/* Writes a field through the cache or through the uncached method.*/
+static void put_field(bool cached, uint32_t v, size_t size) {
+
+  if (cached) {
+    (void)fileStreamWrite(efs, (const uint8_t *)&v, size);
+  }
+  else {
+    (void)efs->vmt->raw_write(efs, (const uint8_t *)&v, size);
+  }
+}
+
+static uint32_t get_field(bool cached, size_t size) {
+  uint32_t v = 0;
+
+  if (cached) {
+    (void)fileStreamRead(efs, (uint8_t *)&v, size);
+  }
+  else {
+    (void)efs->vmt->raw_read(efs, (uint8_t *)&v, size);
+  }
+  return v;
+}
+
+/*
+ * Records of a byte, a halfword and a word written then read back field by
+ * field, returns the bus transactions.
+ */
+static unsigned records(const device_t *dp, bool cached) {
+  uint32_t i, errors = 0;
+
+  setup(dp);
+  for (i = 0; i < RECORDS; i++) {
+    put_field(cached, i, 1);
+    put_field(cached, i * 3U, 2);
+    put_field(cached, i * 7U, 4);
+  }
+  (void)EepromFileFlush(efs);
+  fileStreamSeek(efs, 0);
+  for (i = 0; i < RECORDS; i++) {
+    errors += get_field(cached, 1) != (i & 0xFFU);
+    errors += get_field(cached, 2) != ((i * 3U) & 0xFFFFU);
+    errors += get_field(cached, 4) != i * 7U;
+  }
+  HOST_CHECK(errors == 0U, "%s: %u fields read back wrong", dp->name,
+             (unsigned)errors);
+  (void)fileStreamClose(efs);
+  return dp->simp->transactions;
+}
+
+/* Bus transactions of the records with and without the cache.*/
+static void test_records(const device_t *dp) {
+  unsigned raw = records(dp, false);
+  unsigned cached = records(dp, true);
+
+  HOST_CHECK(cached * 4U < raw, "%s: %u transactions cached, %u uncached",
+             dp->name, cached, raw);
+  if (host_bench) {
+    printf("  %s: %u records, %u bus transactions uncached, %u cached\n",
+           dp->name, RECORDS, raw, cached);
+  }
+}
+
+int main(int argc, char *argv[]) {
+  unsigned d;
+
+  hostInit(argc, argv);
+  for (d = 0; d < sizeof(devices) / sizeof(devices[0]); d++) {
+    test_random(&devices[d]);
+    test_counters(&devices[d]);
+    test_records(&devices[d]);
+  }
+
+  return hostReport(argv[0]);
+}
@@ -0,0 +1,356 @@
+/*
+    ChibiOS - Copyright (C) 2006..2018 Giovanni Di Sirio
+
+    Licensed under the Apache License, Version 2.0 (the "License");
+    you may not use this file except in compliance with the License.
+    You may obtain a copy of the License at
+
+        http://www.apache.org/licenses/LICENSE-2.0
+
+    Unless required by applicable law or agreed to in writing, software
+    distributed under the License is distributed on an "AS IS" BASIS,
+    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+    See the License for the specific language governing permissions and
+    limitations under the License.
+*/
+
+/*
+ * 24xx I2C EEPROM driver over a simulated 24LC256: 32 KiB, 64 byte pages,
+ * 400 kHz bus, 3 ms actual write cycle against the 5 ms of the datasheet.
+ * During its write cycle the IC does not acknowledge its address. The
+ * virtual time is advanced by the bus transactions only, so the time of a
+ * write is the bus time plus the write cycles not overlapped.
+ */
+
+#include <string.h>
+
+#include "hal.h"
+#include "host_test.h"
+
+/*===========================================================================*/
+/* Simulated 24LC256.                                                        */
+/*===========================================================================*/
+
+#define MEM_SIZE                            32768U
+#define PAGE_SIZE                           64U
+#define WRITE_TIME_MS                       5U
+#define TWR_NS                              3000000U
+/* One byte and its ACK at 400 kHz, start and stop conditions.*/
+#define BYTE_NS                             22500U
+#define FRAME_NS                            5000U
+
+static uint8_t mem[MEM_SIZE];
+static uint64_t now_ns;
+static uint64_t busy_until;
+static uint32_t pointer;
+static bool absent;
+/* The IC stops acknowledging during this write cycle, 0 for never.*/
+static unsigned hang_cycle;
+
+static struct {
+  unsigned                  transactions;
+  unsigned                  nacks;
+  unsigned                  cycles;
+} dev;
+
+systime_t chVTGetSystemTimeX(void) {
+
+  return (systime_t)(now_ns / (1000000000U / CH_CFG_ST_FREQUENCY));
+}
+
+void chThdYield(void) {
+}
+
+msg_t i2cMasterTransmitTimeout(I2CDriver *i2cp, i2caddr_t addr,
+                               const uint8_t *txbuf, size_t txbytes,
+                               uint8_t *rxbuf, size_t rxbytes,
+                               sysinterval_t timeout) {
+  uint32_t page;
+  size_t i;
+
+  (void)timeout;
+  osalDbgCheck((addr == 0x50U) && (txbytes >= 2U));
+
+  /* Address byte not acknowledged.*/
+  now_ns += FRAME_NS + BYTE_NS;
+  if (absent || (now_ns < busy_until)) {
+    dev.nacks++;
+    i2cp->errors = I2C_ACK_FAILURE;
+    return MSG_RESET;
+  }
+
+  dev.transactions++;
+  now_ns += (txbytes + rxbytes) * BYTE_NS;
+  i2cp->errors = 0;
+  pointer = (((uint32_t)txbuf[0] << 8) | txbuf[1]) % MEM_SIZE;
+
+  /* Data past the end of the page wraps to its beginning.*/
+  if (txbytes > 2U) {
+    page = pointer & ~(PAGE_SIZE - 1U);
+    for (i = 2; i < txbytes; i++) {
+      mem[page | (pointer & (PAGE_SIZE - 1U))] = txbuf[i];
+      pointer = page | ((pointer + 1U) & (PAGE_SIZE - 1U));
+    }
+    busy_until = now_ns + TWR_NS;
+    dev.cycles++;
+    if (dev.cycles == hang_cycle) {
+      absent = true;
+    }
+  }
+
+  for (i = 0; i < rxbytes; i++) {
+    rxbuf[i] = mem[pointer];
+    pointer = (pointer + 1U) % MEM_SIZE;
+  }
+
+  return MSG_OK;
+}
+
+static bool busy(void) {
+
+  return now_ns < busy_until;
+}
+
+/*===========================================================================*/
+/* Helpers.                                                                  */
+/*===========================================================================*/
+
+/* The file starts in the middle of a page.*/
+#define FILE_START                          100U
+#define FILE_SIZE                           8192U
+
+extern EepromDevice eepdev_24xx;
+
+static uint8_t write_buf[PAGE_SIZE + 2U];
+static const I2CEepromFileConfig eepcfg = {
+  FILE_START,
+  FILE_START + FILE_SIZE,
+  MEM_SIZE,
+  PAGE_SIZE,
+  TIME_MS2I(WRITE_TIME_MS),
+  NULL,
+  0x50,
+  write_buf
+};
+
+static I2CDriver i2c;
+static I2CEepromFileConfig config;
+static I2CEepromFileStream ifs;
+static EepromFileStream *efs;
+static uint8_t model[FILE_SIZE];
+
+static uint8_t mem_byte(uint32_t i) {
+
+  return (uint8_t)(i * 13U + 5U);
+}
+
+static void setup(void) {
+  uint32_t i;
+
+  for (i = 0; i < MEM_SIZE; i++) {
+    mem[i] = mem_byte(i);
+  }
+  memcpy(model, &mem[FILE_START], FILE_SIZE);
+  absent = false;
+  hang_cycle = 0;
+  busy_until = 0;
+  memset(&dev, 0, sizeof(dev));
+
+  config = eepcfg;
+  config.i2cp = &i2c;
+  memset(&ifs, 0, sizeof(ifs));
+  efs = I2CEepromFileOpen(&ifs, &config, &eepdev_24xx);
+}
+
+/* Bus time of a transaction, address byte included.*/
+static uint64_t xfer_ns(size_t bytes) {
+
+  return FRAME_NS + (bytes + 1U) * BYTE_NS;
+}
+
+/*===========================================================================*/
+/* Tests.                                                                    */
+/*===========================================================================*/
+
+/* Random writes and reads against a model; every write returns with the
+   IC idle and nothing outside the file is touched.*/
+static void test_random(void) {
+  static uint8_t buf[300], back[300];
+  unsigned op;
+  uint32_t pos, n, i;
+
+  setup();
+  for (op = 0; op < 4000; op++) {
+    pos = hostRand() % FILE_SIZE;
+    n = 1U + hostRand() % ((hostRand() % 4U) != 0U ? 16U : sizeof(buf));
+    if (pos + n > FILE_SIZE) {
+      n = FILE_SIZE - pos;
+    }
+    fileStreamSeek(efs, pos);
+    if ((hostRand() % 2U) == 0U) {
+      for (i = 0; i < n; i++) {
+        buf[i] = (uint8_t)hostRand();
+      }
+      HOST_CHECK(fileStreamWrite(efs, buf, n) == n, "write %u at %u", n, pos);
+      memcpy(&model[pos], buf, n);
+      HOST_CHECK(!busy(), "IC busy after a write");
+    }
+    else {
+      HOST_CHECK(fileStreamRead(efs, back, n) == n, "read %u at %u", n, pos);
+      HOST_CHECK(memcmp(back, &model[pos], n) == 0, "data at %u", pos);
+    }
+    HOST_CHECK((uint32_t)fileStreamGetPosition(efs, NULL) == pos + n,
+               "position");
+  }
+
+  HOST_CHECK(memcmp(&mem[FILE_START], model, FILE_SIZE) == 0, "contents");
+  for (i = 0; i < MEM_SIZE; i++) {
+    if ((i < FILE_START) || (i >= FILE_START + FILE_SIZE)) {
+      HOST_CHECK(mem[i] == mem_byte(i), "byte %u outside the file", i);
+    }
+  }
+
+  /* Clamped at the end of the file.*/
+  fileStreamSeek(efs, FILE_SIZE - 10U);
+  HOST_CHECK(fileStreamWrite(efs, buf, 20) == 10U, "write past the end");
+  HOST_CHECK(fileStreamRead(efs, back, 20) == 0U, "read past the end");
+  HOST_CHECK(!busy(), "IC busy after a write");
+  HOST_CHECK(fileStreamClose(efs) == FILE_OK, "close");
+}
+
+/* A page write does not wait for its own cycle: the pages of a large write
+   go out as soon as the IC acknowledges again.*/
+static void test_pipeline(void) {
+  static uint8_t data[FILE_SIZE], back[FILE_SIZE];
+  uint64_t start, elapsed, bound;
+  unsigned i, pages;
+
+  setup();
+  for (i = 0; i < FILE_SIZE; i++) {
+    data[i] = (uint8_t)(i * 7U + 3U);
+  }
+  start = now_ns;
+  HOST_CHECK(fileStreamWrite(efs, data, FILE_SIZE) == FILE_SIZE, "write");
+  elapsed = now_ns - start;
+  pages = dev.cycles;
+  HOST_CHECK(pages == (FILE_START % PAGE_SIZE + FILE_SIZE + PAGE_SIZE - 1U) /
+                     PAGE_SIZE, "%u pages", pages);
+
+  /* Each page costs its transfer and the write cycle, plus one poll.*/
+  bound = pages * (xfer_ns(PAGE_SIZE + 2U) + TWR_NS + xfer_ns(0));
+  HOST_CHECK(elapsed <= bound, "%llu us for %u pages, bound %llu us",
+             (unsigned long long)(elapsed / 1000U), pages,
+             (unsigned long long)(bound / 1000U));
+
+  fileStreamSeek(efs, 0);
+  HOST_CHECK(fileStreamRead(efs, back, FILE_SIZE) == FILE_SIZE, "read");
+  HOST_CHECK(memcmp(back, data, FILE_SIZE) == 0, "contents");
+
+  if (host_bench) {
+    printf("  8 KiB in %u pages: %.1f ms, %.1f KiB/s, %u NACKed polls; "
+           "%.1f ms with a %u ms delay per page\n", pages,
+           (double)elapsed / 1e6, FILE_SIZE / 1024.0 / ((double)elapsed / 1e9),
+           dev.nacks,
+           (double)(pages * (xfer_ns(PAGE_SIZE + 2U) +
+                             WRITE_TIME_MS * 1000000ULL)) / 1e6,
+           WRITE_TIME_MS);
+  }
+}
+
+/* A stream write returns during the last write cycle, a read or a sync
+   waits for it.*/
+static void test_stream(void) {
+  static const uint8_t data[16] = "0123456789abcdef";
+  uint8_t back[16];
+  uint64_t start;
+
+  setup();
+  fileStreamSeek(efs, 10);
+  start = now_ns;
+  HOST_CHECK(I2CEepromFileStreamWrite(&ifs, data, 16) == 16U, "stream write");
+  HOST_CHECK(busy(), "stream write waited for the cycle");
+  HOST_CHECK(now_ns - start < TWR_NS, "stream write took %llu us",
+             (unsigned long long)((now_ns - start) / 1000U));
+  if (host_bench) {
+    printf("  stream write of 16 bytes: returns after %.2f ms",
+           (double)(now_ns - start) / 1e6);
+  }
+  HOST_CHECK(I2CEepromFileSync(&ifs) == MSG_OK, "sync");
+  HOST_CHECK(!busy(), "IC busy after a sync");
+  if (host_bench) {
+    printf(", synced after %.2f ms\n", (double)(now_ns - start) / 1e6);
+  }
+
+  /* The next access polls by itself.*/
+  fileStreamSeek(efs, 100);
+  HOST_CHECK(I2CEepromFileStreamWrite(&ifs, data, 16) == 16U, "stream write");
+  HOST_CHECK(busy(), "stream write waited for the cycle");
+  fileStreamSeek(efs, 100);
+  HOST_CHECK(fileStreamRead(efs, back, 16) == 16U, "read");
+  HOST_CHECK(memcmp(back, data, 16) == 0, "read back");
+  HOST_CHECK(!busy(), "read before the end of the cycle");
+}
+
+/* An IC that never acknowledges is given up after write_time.*/
+static void test_absent(void) {
+  static const uint8_t data[4] = {1, 2, 3, 4};
+  uint64_t start;
+
+  setup();
+  absent = true;
+  start = now_ns;
+  HOST_CHECK(I2CEepromFileSync(&ifs) == MSG_RESET, "sync");
+  HOST_CHECK((now_ns - start >= WRITE_TIME_MS * 1000000ULL) &&
+             (now_ns - start <= WRITE_TIME_MS * 1000000ULL + 2U * xfer_ns(0)),
+             "gave up after %llu us", (unsigned long long)((now_ns - start) / 1000U));
+  HOST_CHECK(fileStreamWrite(efs, data, 4) == 0U, "write");
+  HOST_CHECK(fileStreamRead(efs, (uint8_t *)data, 0) == 0U, "read");
+  HOST_CHECK(memcmp(&mem[FILE_START], model, 4) == 0, "contents");
+}
+
+/* An IC that hangs in the write cycle of the third page: the write returns
+   the bytes of the first two pages and leaves the position after them.*/
+static void test_hang(void) {
+  static uint8_t data[3U * PAGE_SIZE];
+  size_t first = PAGE_SIZE - FILE_START % PAGE_SIZE;
+  uint32_t i;
+
+  setup();
+  for (i = 0; i < sizeof(data); i++) {
+    data[i] = (uint8_t)(i + 1U);
+  }
+  hang_cycle = 3;
+  HOST_CHECK(fileStreamWrite(efs, data, sizeof(data)) == first + PAGE_SIZE,
+             "short count");
+  HOST_CHECK((uint32_t)fileStreamGetPosition(efs, NULL) == first + PAGE_SIZE,
+             "position");
+
+  /* A write ending on a page boundary does not count its whole last page.*/
+  setup();
+  hang_cycle = 2;
+  HOST_CHECK(fileStreamWrite(efs, data, first + PAGE_SIZE) == first,
+             "short count at a page boundary");
+  HOST_CHECK((uint32_t)fileStreamGetPosition(efs, NULL) == first, "position");
+
+  /* A single page write returns nothing.*/
+  setup();
+  hang_cycle = 1;
+  HOST_CHECK(fileStreamWrite(efs, data, 8) == 0U, "single page");
+  HOST_CHECK(fileStreamGetPosition(efs, NULL) == 0, "position");
+}
+
+int main(int argc, char *argv[]) {
+
+  hostInit(argc, argv);
+  if (host_bench) {
+    printf("%s: 24LC256 at 400 kHz, tWR %u us, write_time %u ms\n", argv[0],
+           TWR_NS / 1000U, WRITE_TIME_MS);
+  }
+  test_random();
+  test_pipeline();
+  test_stream();
+  test_absent();
+  test_hang();
+
+  return hostReport(argv[0]);
+}
@@ -0,0 +1,379 @@
+/*
+    ChibiOS - Copyright (C) 2006..2018 Giovanni Di Sirio
+
+    Licensed under the Apache License, Version 2.0 (the "License");
+    you may not use this file except in compliance with the License.
+    You may obtain a copy of the License at
+
+        http://www.apache.org/licenses/LICENSE-2.0
+
+    Unless required by applicable law or agreed to in writing, software
+    distributed under the License is distributed on an "AS IS" BASIS,
+    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+    See the License for the specific language governing permissions and
+    limitations under the License.
+*/
+
+/*
+ * EEPROM emulation over a simulated flash: 4 sectors of 2 KiB with an 8
+ * byte program unit. The simulator rejects a second program of the same
+ * unit, counts the erases of each sector and can cut the power after a
+ * given number of bytes programmed or erased; programs are torn at the
+ * byte, erases every 256 bytes. Everything is run on flash erased to ones
+ * and on flash erased to zeros.
+ */
+
+#include <setjmp.h>
+#include <string.h>
+
+#include "hal.h"
+#include "host_test.h"
+
+/*===========================================================================*/
+/* Simulated flash.                                                          */
+/*===========================================================================*/
+
+#define SECTORS                             4U
+#define SECTOR_SIZE                         2048U
+#define UNIT                                8U
+
+struct BaseFlash {
+  flash_descriptor_t        descriptor;
+  uint8_t                   mem[SECTORS * SECTOR_SIZE];
+  bool                      programmed[SECTORS * SECTOR_SIZE / UNIT];
+  unsigned                  erases[SECTORS];
+  flash_sector_t            erasing;
+  unsigned                  reprograms;
+};
+
+static BaseFlash flash;
+static uint8_t erased;
+
+/* Bytes still programmed or erased before the power cut, -1 for none.*/
+static long power_budget = -1;
+static jmp_buf power_cut;
+
+static void power_tick(void) {
+
+  if ((power_budget >= 0) && (power_budget-- == 0)) {
+    longjmp(power_cut, 1);
+  }
+}
+
+const flash_descriptor_t *flashGetDescriptor(BaseFlash *devp) {
+
+  return &devp->descriptor;
+}
+
+flash_error_t flashRead(BaseFlash *devp, flash_offset_t offset, size_t n,
+                        uint8_t *rp) {
+
+  osalDbgCheck(offset + n <= sizeof(devp->mem));
+  memcpy(rp, &devp->mem[offset], n);
+  return FLASH_NO_ERROR;
+}
+
+flash_error_t flashProgram(BaseFlash *devp, flash_offset_t offset, size_t n,
+                           const uint8_t *pp) {
+  size_t i;
+
+  osalDbgCheck((offset % UNIT == 0U) && (offset + n <= sizeof(devp->mem)));
+  for (i = offset / UNIT; i < (offset + n + UNIT - 1U) / UNIT; i++) {
+    if (devp->programmed[i]) {
+      devp->reprograms++;
+      return FLASH_ERROR_PROGRAM;
+    }
+  }
+  for (i = 0; i < n; i++) {
+    power_tick();
+    devp->mem[offset + i] = pp[i];
+    devp->programmed[(offset + i) / UNIT] = true;
+  }
+  return FLASH_NO_ERROR;
+}
+
+flash_error_t flashStartEraseSector(BaseFlash *devp, flash_sector_t sector) {
+
+  osalDbgCheck(sector < SECTORS);
+  devp->erasing = sector;
+  return FLASH_NO_ERROR;
+}
+
+flash_error_t flashWaitErase(BaseFlash *devp) {
+  const uint32_t base = devp->erasing * SECTOR_SIZE;
+  uint32_t i;
+
+  devp->erases[devp->erasing]++;
+  for (i = 0; i < SECTOR_SIZE; i++) {
+    if ((i % 256U) == 0U) {
+      power_tick();
+    }
+    devp->mem[base + i] = erased;
+    devp->programmed[(base + i) / UNIT] = false;
+  }
+  return FLASH_NO_ERROR;
+}
+
+flash_error_t flashVerifyErase(BaseFlash *devp, flash_sector_t sector) {
+  uint32_t i;
+
+  for (i = 0; i < SECTOR_SIZE; i++) {
+    if (devp->mem[sector * SECTOR_SIZE + i] != erased) {
+      return FLASH_ERROR_VERIFY;
+    }
+  }
+  return FLASH_NO_ERROR;
+}
+
+flash_offset_t flashGetSectorOffset(BaseFlash *devp, flash_sector_t sector) {
+
+  (void)devp;
+  return sector * SECTOR_SIZE;
+}
+
+uint32_t flashGetSectorSize(BaseFlash *devp, flash_sector_t sector) {
+
+  (void)devp;
+  (void)sector;
+  return SECTOR_SIZE;
+}
+
+/*===========================================================================*/
+/* Helpers.                                                                  */
+/*===========================================================================*/
+
+#define RECORD_SIZE                         16U
+#define RECORDS                             32U
+#define EMU_SIZE                            (RECORDS * RECORD_SIZE)
+
+static flash_offset_t index_ram[RECORDS];
+static const EEFlashConfig eeflcfg = {
+  &flash,
+  0,
+  SECTORS,
+  RECORD_SIZE,
+  EMU_SIZE,
+  index_ram
+};
+
+extern EepromDevice eepdev_flash;
+
+static EEFlashDriver eefl;
+static uint8_t model[RECORDS][RECORD_SIZE];
+
+static void erase_all(bool erased_is_one) {
+
+  erased = erased_is_one ? 0xFFU : 0x00U;
+  memset(&flash, 0, sizeof(flash));
+  flash.descriptor.attributes = erased_is_one ? FLASH_ATTR_ERASED_IS_ONE : 0U;
+  flash.descriptor.page_size = UNIT;
+  flash.descriptor.sectors_count = SECTORS;
+  memset(flash.mem, erased, sizeof(flash.mem));
+  memset(model, erased, sizeof(model));
+}
+
+static bool mount(void) {
+
+  eeflashObjectInit(&eefl);
+  return eeflashStart(&eefl, &eeflcfg) == FLASH_NO_ERROR;
+}
+
+static void random_record(uint8_t *buf) {
+  unsigned i;
+
+  for (i = 0; i < RECORD_SIZE; i++) {
+    buf[i] = (uint8_t)hostRand();
+  }
+}
+
+/* Checks every record against the model, returns the first mismatch or
+   RECORDS.*/
+static unsigned compare(void) {
+  uint8_t buf[RECORD_SIZE];
+  unsigned r;
+
+  for (r = 0; r < RECORDS; r++) {
+    if ((eeflashRead(&eefl, r, buf) != FLASH_NO_ERROR) ||
+        (memcmp(buf, model[r], RECORD_SIZE) != 0)) {
+      return r;
+    }
+  }
+  return RECORDS;
+}
+
+/*===========================================================================*/
+/* Tests.                                                                    */
+/*===========================================================================*/
+
+/* Updates to a hot set of records, a few unchanged, then a remount.*/
+static void test_wear(const char *name) {
+  uint8_t buf[RECORD_SIZE];
+  EEFlashStats stats;
+  unsigned i, r, min = ~0U, max = 0U;
+
+  /* Wear statistics cover this test only.*/
+  memset(flash.erases, 0, sizeof(flash.erases));
+
+  HOST_CHECK(mount(), "%s: mount", name);
+  HOST_CHECK(compare() == RECORDS, "%s: blank records", name);
+  for (i = 0; i < 100000U; i++) {
+    r = (hostRand() % 10U) < 8U ? hostRand() % 4U : hostRand() % RECORDS;
+    if ((hostRand() % 10U) == 0U) {
+      memcpy(buf, model[r], RECORD_SIZE);
+    }
+    else {
+      random_record(buf);
+    }
+    if (eeflashWrite(&eefl, r, buf) != FLASH_NO_ERROR) {
+      HOST_CHECK(false, "%s: write %u", name, i);
+      break;
+    }
+    memcpy(model[r], buf, RECORD_SIZE);
+  }
+  HOST_CHECK(compare() == RECORDS, "%s: records after the writes", name);
+  HOST_CHECK(flash.reprograms == 0U, "%s: %u units programmed twice", name,
+             flash.reprograms);
+
+  eeflashGetStats(&eefl, &stats);
+  for (i = 0; i < SECTORS; i++) {
+    min = flash.erases[i] < min ? flash.erases[i] : min;
+    max = flash.erases[i] > max ? flash.erases[i] : max;
+  }
+  HOST_CHECK(stats.erases == flash.erases[0] + flash.erases[1] +
+             flash.erases[2] + flash.erases[3], "%s: erase count", name);
+  HOST_CHECK(max - min <= 1U, "%s: erases %u..%u per sector", name, min, max);
+  HOST_CHECK(stats.unchanged > 0U, "%s: no unchanged write skipped", name);
+  HOST_CHECK(stats.writes > 40U * stats.erases, "%s: %u writes for %u erases",
+             name, stats.writes, stats.erases);
+  if (host_bench) {
+    printf("  %-14s %u records appended, %u unchanged, %u copied, "
+           "%u erases (%u..%u per sector), %.1f updates per erase\n", name,
+           stats.writes, stats.unchanged, stats.copies, stats.erases, min, max,
+           (double)stats.writes / stats.erases);
+  }
+
+  HOST_CHECK(mount(), "%s: remount", name);
+  HOST_CHECK(compare() == RECORDS, "%s: records after the remount", name);
+}
+
+/* Power cuts inside programs and erases, again during the remount: each
+   record must hold either its old or its new value.*/
+static void test_power_fail(const char *name) {
+  static uint8_t buf[RECORD_SIZE], back[RECORD_SIZE];
+  static unsigned i, r, cuts;
+  bool ok;
+
+  HOST_CHECK(mount(), "%s: mount", name);
+  cuts = 0;
+  for (i = 0; i < 20000U; i++) {
+    r = hostRand() % RECORDS;
+    random_record(buf);
+    power_budget = (long)(hostRand() % 80U);
+    if (setjmp(power_cut) == 0) {
+      ok = eeflashWrite(&eefl, r, buf) == FLASH_NO_ERROR;
+      power_budget = -1;
+      HOST_CHECK(ok, "%s: write %u", name, i);
+      memcpy(model[r], buf, RECORD_SIZE);
+    }
+    else {
+      cuts++;
+      /* The remount may be cut as well.*/
+      while (true) {
+        power_budget = (hostRand() % 2U) != 0U ?
+                       (long)(hostRand() % 3000U) : -1;
+        if (setjmp(power_cut) == 0) {
+          ok = mount();
+          power_budget = -1;
+          break;
+        }
+        cuts++;
+      }
+      HOST_CHECK(ok, "%s: remount after a cut", name);
+      HOST_CHECK(eeflashRead(&eefl, r, back) == FLASH_NO_ERROR, "%s: read",
+                 name);
+      if (memcmp(back, buf, RECORD_SIZE) == 0) {
+        memcpy(model[r], buf, RECORD_SIZE);
+      }
+    }
+    if (compare() != RECORDS) {
+      HOST_CHECK(false, "%s: record %u neither old nor new after %u cuts",
+                 name, compare(), cuts);
+      break;
+    }
+  }
+  HOST_CHECK(flash.reprograms == 0U, "%s: %u units programmed twice", name,
+             flash.reprograms);
+  if (host_bench) {
+    printf("  %-14s %u power cuts in %u writes\n", name, cuts, i);
+  }
+}
+
+/* File stream over the emulation, partial records included.*/
+static void test_stream(const char *name) {
+  static EEFlashFileStream efs;
+  static const EEFlashFileConfig filecfg = {
+    RECORD_SIZE + 5U,
+    EMU_SIZE - 3U,
+    EMU_SIZE,
+    RECORD_SIZE,
+    0,
+    &eefl
+  };
+  const uint32_t file_size = filecfg.barrier_hi - filecfg.barrier_low;
+  uint8_t buf[64], back[64];
+  EepromFileStream *fsp;
+  unsigned i, j;
+  uint32_t pos, n;
+
+  HOST_CHECK(mount(), "%s: mount", name);
+  memset(&efs, 0, sizeof(efs));
+  fsp = EEFlashFileOpen(&efs, &filecfg, &eepdev_flash);
+  for (i = 0; i < 3000U; i++) {
+    pos = hostRand() % file_size;
+    n = 1U + hostRand() % sizeof(buf);
+    if (pos + n > file_size) {
+      n = file_size - pos;
+    }
+    fileStreamSeek(fsp, pos);
+    if ((hostRand() % 2U) == 0U) {
+      for (j = 0; j < n; j++) {
+        buf[j] = (uint8_t)hostRand();
+      }
+      HOST_CHECK(fileStreamWrite(fsp, buf, n) == n, "%s: write", name);
+      for (j = 0; j < n; j++) {
+        const uint32_t a = filecfg.barrier_low + pos + j;
+        model[a / RECORD_SIZE][a % RECORD_SIZE] = buf[j];
+      }
+    }
+    else {
+      HOST_CHECK(fileStreamRead(fsp, back, n) == n, "%s: read", name);
+      for (j = 0; j < n; j++) {
+        const uint32_t a = filecfg.barrier_low + pos + j;
+        HOST_CHECK(back[j] == model[a / RECORD_SIZE][a % RECORD_SIZE],
+                   "%s: byte %u", name, pos + j);
+      }
+    }
+  }
+  HOST_CHECK(fileStreamClose(fsp) == FILE_OK, "%s: close", name);
+  HOST_CHECK(mount(), "%s: remount", name);
+  HOST_CHECK(compare() == RECORDS, "%s: records after the stream", name);
+}
+
+int main(int argc, char *argv[]) {
+  static const char *const names[2] = {"erased to 0", "erased to 1"};
+  unsigned i;
+
+  hostInit(argc, argv);
+  if (host_bench) {
+    printf("%s: %u x %u byte sectors, %u byte unit, %u records of %u bytes\n",
+           argv[0], SECTORS, SECTOR_SIZE, UNIT, RECORDS, RECORD_SIZE);
+  }
+  for (i = 0; i < 2U; i++) {
+    erase_all(i != 0U);
+    test_wear(names[i]);
+    test_power_fail(names[i]);
+    test_stream(names[i]);
+  }
+
+  return hostReport(argv[0]);
+}
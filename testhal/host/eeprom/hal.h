@@ -0,0 +1,165 @@
+/*
+    ChibiOS - Copyright (C) 2006..2018 Giovanni Di Sirio
+
+    Licensed under the Apache License, Version 2.0 (the "License");
+    you may not use this file except in compliance with the License.
+    You may obtain a copy of the License at
+
+        http://www.apache.org/licenses/LICENSE-2.0
+
+    Unless required by applicable law or agreed to in writing, software
+    distributed under the License is distributed on an "AS IS" BASIS,
+    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+    See the License for the specific language governing permissions and
+    limitations under the License.
+*/
+
+#ifndef HAL_H
+#define HAL_H
+
+#include "osal.h"
+
+#define HAL_SUCCESS                         false
+#define HAL_FAILED                          true
+
+#define HAL_USE_EEPROM                      TRUE
+#define HAL_USE_I2C                         TRUE
+#ifndef HAL_USE_SPI
+#define HAL_USE_SPI                         FALSE
+#endif
+#define I2C_USE_MUTUAL_EXCLUSION            FALSE
+
+/*===========================================================================*/
+/* Kernel subset, the virtual time is advanced by the simulated devices.     */
+/*===========================================================================*/
+
+#define CH_CFG_ST_FREQUENCY                 100000
+#define TIME_MS2I(msecs)                                                    \
+  ((sysinterval_t)(msecs) * (CH_CFG_ST_FREQUENCY / 1000))
+#define TIME_I2US(interval)                                                 \
+  ((uint32_t)(interval) * (1000000 / CH_CFG_ST_FREQUENCY))
+
+/*===========================================================================*/
+/* Streams subset.                                                           */
+/*===========================================================================*/
+
+#define STM_OK                              MSG_OK
+#define STM_TIMEOUT                         MSG_TIMEOUT
+#define STM_RESET                           MSG_RESET
+
+#define FILE_OK                             STM_OK
+#define FILE_ERROR                          STM_TIMEOUT
+#define FILE_EOF                            STM_RESET
+
+#define _base_sequential_stream_data
+
+#define _file_stream_methods                                                \
+  size_t instance_offset;                                                   \
+  size_t (*write)(void *instance, const uint8_t *bp, size_t n);             \
+  size_t (*read)(void *instance, uint8_t *bp, size_t n);                    \
+  msg_t (*put)(void *instance, uint8_t b);                                  \
+  msg_t (*get)(void *instance);                                             \
+  msg_t (*close)(void *instance);                                           \
+  msg_t (*geterror)(void *instance);                                        \
+  msg_t (*getsize)(void *instance, fileoffset_t *offset);                   \
+  msg_t (*getposition)(void *instance, fileoffset_t *offset);               \
+  msg_t (*lseek)(void *instance, fileoffset_t offset);
+
+#define fileStreamWrite(ip, bp, n)          ((ip)->vmt->write(ip, bp, n))
+#define fileStreamRead(ip, bp, n)           ((ip)->vmt->read(ip, bp, n))
+#define fileStreamPut(ip, b)                ((ip)->vmt->put(ip, b))
+#define fileStreamGet(ip)                   ((ip)->vmt->get(ip))
+#define fileStreamClose(ip)                 ((ip)->vmt->close(ip))
+#define fileStreamGetError(ip)              ((ip)->vmt->geterror(ip))
+#define fileStreamGetSize(ip, offset)       ((ip)->vmt->getsize(ip, offset))
+#define fileStreamGetPosition(ip, offset)   ((ip)->vmt->getposition(ip, offset))
+#define fileStreamSeek(ip, offset)          ((ip)->vmt->lseek(ip, offset))
+
+/*===========================================================================*/
+/* I2C subset.                                                               */
+/*===========================================================================*/
+
+#define I2C_ACK_FAILURE                     0x04
+
+typedef uint16_t i2caddr_t;
+typedef uint32_t i2cflags_t;
+
+typedef struct {
+  i2cflags_t                errors;
+} I2CDriver;
+
+#define i2cGetErrors(i2cp)                  ((i2cp)->errors)
+
+/*===========================================================================*/
+/* SPI subset.                                                               */
+/*===========================================================================*/
+
+#define SPI_USE_MUTUAL_EXCLUSION            FALSE
+#define SPI_READY                           2
+
+typedef struct {
+  int                       state;
+} SPIDriver;
+
+typedef struct {
+  uint32_t                  cr1;
+} SPIConfig;
+
+/*===========================================================================*/
+/* Flash subset, the BaseFlash calls are served by the simulated device.     */
+/*===========================================================================*/
+
+#define FLASH_ATTR_ERASED_IS_ONE            0x00000001
+
+typedef uint32_t flash_offset_t;
+typedef uint32_t flash_sector_t;
+
+typedef enum {
+  FLASH_NO_ERROR = 0,
+  FLASH_BUSY_ERASING = 1,
+  FLASH_ERROR_READ = 2,
+  FLASH_ERROR_PROGRAM = 3,
+  FLASH_ERROR_ERASE = 4,
+  FLASH_ERROR_VERIFY = 5,
+  FLASH_ERROR_HW_FAILURE = 6,
+  FLASH_ERROR_UNIMPLEMENTED = 7
+} flash_error_t;
+
+typedef struct {
+  uint32_t                  attributes;
+  uint32_t                  page_size;
+  flash_sector_t            sectors_count;
+} flash_descriptor_t;
+
+typedef struct BaseFlash BaseFlash;
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+  const flash_descriptor_t *flashGetDescriptor(BaseFlash *devp);
+  flash_error_t flashRead(BaseFlash *devp, flash_offset_t offset, size_t n,
+                          uint8_t *rp);
+  flash_error_t flashProgram(BaseFlash *devp, flash_offset_t offset,
+                             size_t n, const uint8_t *pp);
+  flash_error_t flashStartEraseSector(BaseFlash *devp, flash_sector_t sector);
+  flash_error_t flashWaitErase(BaseFlash *devp);
+  flash_error_t flashVerifyErase(BaseFlash *devp, flash_sector_t sector);
+  flash_offset_t flashGetSectorOffset(BaseFlash *devp, flash_sector_t sector);
+  uint32_t flashGetSectorSize(BaseFlash *devp, flash_sector_t sector);
+  systime_t chVTGetSystemTimeX(void);
+  void chThdYield(void);
+  void spiSelect(SPIDriver *spip);
+  void spiUnselect(SPIDriver *spip);
+  void spiSend(SPIDriver *spip, size_t n, const void *txbuf);
+  void spiReceive(SPIDriver *spip, size_t n, void *rxbuf);
+  msg_t i2cMasterTransmitTimeout(I2CDriver *i2cp, i2caddr_t addr,
+                                 const uint8_t *txbuf, size_t txbytes,
+                                 uint8_t *rxbuf, size_t rxbytes,
+                                 sysinterval_t timeout);
+#ifdef __cplusplus
+}
+#endif
+
+#include "hal_eeprom.h"
+
+#endif /* HAL_H */
@@ -0,0 +1,329 @@
+/*
+    ChibiOS - Copyright (C) 2006..2018 Giovanni Di Sirio
+
+    Licensed under the Apache License, Version 2.0 (the "License");
+    you may not use this file except in compliance with the License.
+    You may obtain a copy of the License at
+
+        http://www.apache.org/licenses/LICENSE-2.0
+
+    Unless required by applicable law or agreed to in writing, software
+    distributed under the License is distributed on an "AS IS" BASIS,
+    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+    See the License for the specific language governing permissions and
+    limitations under the License.
+*/
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "median.h"
+#include "host_test.h"
+
+/*===========================================================================*/
+/* Reference model.                                                          */
+/*===========================================================================*/
+
+#define MAX_WINDOW          130
+#define SAMPLES             3000
+
+static int cmp_s32(const void *a, const void *b) {
+  int32_t x = *(const int32_t *)a, y = *(const int32_t *)b;
+
+  return (x > y) - (x < y);
+}
+
+static int cmp_f(const void *a, const void *b) {
+  float x = *(const float *)a, y = *(const float *)b;
+
+  return (x > y) - (x < y);
+}
+
+/*
+ * Median of the last min(n + 1, w) samples ending at hist[n], upper middle
+ * for an even count, by sorting a copy of the window.
+ */
+static int32_t ref_median_s32(const int32_t *hist, int n, int w) {
+  int32_t win[MAX_WINDOW];
+  int k = (n + 1 < w) ? n + 1 : w;
+
+  memcpy(win, hist + n + 1 - k, (size_t)k * sizeof(int32_t));
+  qsort(win, (size_t)k, sizeof(int32_t), cmp_s32);
+  return win[k / 2];
+}
+
+static float ref_median_f(const float *hist, int n, int w) {
+  float win[MAX_WINDOW];
+  int k = (n + 1 < w) ? n + 1 : w;
+
+  memcpy(win, hist + n + 1 - k, (size_t)k * sizeof(float));
+  qsort(win, (size_t)k, sizeof(float), cmp_f);
+  return win[k / 2];
+}
+
+/*===========================================================================*/
+/* Tests.                                                                    */
+/*===========================================================================*/
+
+/*
+ * Every instantiated type against a sort of the window, for each window
+ * size, the fill phase included. Odd windows get values from a small range
+ * so the window is full of duplicates.
+ */
+static void test_sorted_window(void) {
+  static int32_t hist[SAMPLES];
+  static float histf[SAMPLES];
+  int w, n;
+
+  hostSeed(1);
+  for (w = 1; w <= MAX_WINDOW; w++) {
+    uint16_t du16[MAX_WINDOW];
+    int16_t ds16[MAX_WINDOW];
+    int32_t ds32[MAX_WINDOW];
+    float df[MAX_WINDOW];
+    int16_t iu16[MEDIAN_HEAP_INDEX_SIZE(MAX_WINDOW)];
+    int16_t is16[MEDIAN_HEAP_INDEX_SIZE(MAX_WINDOW)];
+    int16_t is32[MEDIAN_HEAP_INDEX_SIZE(MAX_WINDOW)];
+    int16_t if_[MEDIAN_HEAP_INDEX_SIZE(MAX_WINDOW)];
+    median_heap_u16_t mu16;
+    median_heap_s16_t ms16;
+    median_heap_s32_t ms32;
+    median_heap_f_t mf;
+    bool ok = true;
+
+    median_heap_u16_init(&mu16, du16, iu16, (uint16_t)w);
+    median_heap_s16_init(&ms16, ds16, is16, (uint16_t)w);
+    median_heap_s32_init(&ms32, ds32, is32, (uint16_t)w);
+    median_heap_f_init(&mf, df, if_, (uint16_t)w);
+
+    for (n = 0; (n < SAMPLES) && ok; n++) {
+      int32_t r = (int32_t)hostRand();
+      int32_t m;
+      float f;
+
+      /* The same random sample, narrowed to each type.*/
+      hist[n]  = (w & 1) ? (r & 0x7FFFFFFF) % 50 : r;
+      histf[n] = (float)(r >> 8) / 1000.0f;
+
+      m = ref_median_s32(hist, n, w);
+      ok = median_heap_s32_filter(&ms32, hist[n]) == m;
+      HOST_CHECK(ok, "s32 window %d sample %d", w, n);
+
+      f = ref_median_f(histf, n, w);
+      ok = ok && (median_heap_f_filter(&mf, histf[n]) == f);
+      HOST_CHECK(ok, "f window %d sample %d", w, n);
+
+      /* The small range fits u16 and s16, their medians follow the s32
+         one.*/
+      if (w & 1) {
+        ok = ok && (median_heap_u16_filter(&mu16, (uint16_t)hist[n]) ==
+                    (uint16_t)m);
+        HOST_CHECK(ok, "u16 window %d sample %d", w, n);
+        ok = ok && (median_heap_s16_filter(&ms16, (int16_t)(hist[n] - 25)) ==
+                    (int16_t)(m - 25));
+        HOST_CHECK(ok, "s16 window %d sample %d", w, n);
+      }
+    }
+  }
+}
+
+/*
+ * Full range u16 and s16 against the sorted window, with the wide values
+ * that the narrowing above leaves out.
+ */
+static void test_full_range(void) {
+  static int32_t hist16[SAMPLES], hists[SAMPLES];
+  int w, n;
+
+  hostSeed(2);
+  for (w = 1; w <= MAX_WINDOW; w += 3) {
+    uint16_t du16[MAX_WINDOW];
+    int16_t ds16[MAX_WINDOW];
+    int16_t iu16[MEDIAN_HEAP_INDEX_SIZE(MAX_WINDOW)];
+    int16_t is16[MEDIAN_HEAP_INDEX_SIZE(MAX_WINDOW)];
+    median_heap_u16_t mu16;
+    median_heap_s16_t ms16;
+    bool ok = true;
+
+    median_heap_u16_init(&mu16, du16, iu16, (uint16_t)w);
+    median_heap_s16_init(&ms16, ds16, is16, (uint16_t)w);
+    for (n = 0; (n < SAMPLES) && ok; n++) {
+      uint32_t r = hostRand();
+
+      hist16[n] = (int32_t)(uint16_t)r;
+      hists[n]  = (int32_t)(int16_t)(r >> 16);
+      ok = median_heap_u16_filter(&mu16, (uint16_t)hist16[n]) ==
+           (uint16_t)ref_median_s32(hist16, n, w);
+      HOST_CHECK(ok, "u16 window %d sample %d", w, n);
+      ok = ok && (median_heap_s16_filter(&ms16, (int16_t)hists[n]) ==
+                  (int16_t)ref_median_s32(hists, n, w));
+      HOST_CHECK(ok, "s16 window %d sample %d", w, n);
+    }
+  }
+}
+
+#define CHANNELS            16
+#define FRAMES              20000
+#define LIST_WINDOW_MAX     255
+
+static uint16_t adc_in[FRAMES * CHANNELS];
+static uint16_t adc_out[FRAMES * CHANNELS];
+static uint16_t adc_ref[FRAMES * CHANNELS];
+
+/*
+ * ADC-like samples: noise around mid scale with occasional spikes, never
+ * zero as zero is the stopper of the list filter.
+ */
+static void fill_adc(void) {
+  size_t i;
+
+  hostSeed(3);
+  for (i = 0; i < FRAMES * CHANNELS; i++) {
+    uint32_t r = hostRand();
+
+    adc_in[i] = (uint16_t)(2049U + r % 200U +
+                           (((r >> 16) % 50U == 0U) ? (r >> 8) % 2000U : 0U));
+  }
+}
+
+typedef struct {
+  median_heap_u16_t         mh[CHANNELS];
+  uint16_t                  data[CHANNELS][LIST_WINDOW_MAX];
+  int16_t                   index[CHANNELS][MEDIAN_HEAP_INDEX_SIZE(LIST_WINDOW_MAX)];
+  median_t                  ml[CHANNELS];
+  pair_t                    pairs[CHANNELS][LIST_WINDOW_MAX];
+} filters_t;
+
+static filters_t filters;
+
+static void filters_init(uint16_t w) {
+  int c;
+
+  memset(&filters, 0, sizeof(filters));
+  for (c = 0; c < CHANNELS; c++) {
+    median_heap_u16_init(&filters.mh[c], filters.data[c], filters.index[c], w);
+    median_init(&filters.ml[c], 0, filters.pairs[c], w);
+  }
+}
+
+/*
+ * Batch API over an interleaved buffer, separate and in place, against
+ * one call per sample and against median_filter() once the window is full.
+ */
+static void test_buffer(void) {
+  static const uint16_t windows[] = {3, 7, 31, 63, 127, 255};
+  size_t i, f;
+  unsigned wi;
+  int c;
+
+  fill_adc();
+  for (wi = 0; wi < sizeof(windows) / sizeof(windows[0]); wi++) {
+    uint16_t w = windows[wi];
+    bool ok = true;
+
+    filters_init(w);
+    for (f = 0; f < FRAMES; f++) {
+      for (c = 0; c < CHANNELS; c++) {
+        i = f * CHANNELS + (size_t)c;
+        adc_ref[i] = median_heap_u16_filter(&filters.mh[c], adc_in[i]);
+        if ((median_filter(&filters.ml[c], adc_in[i]) != adc_ref[i]) &&
+            (f >= w) && ok) {
+          ok = false;
+          HOST_CHECK(false, "list window %u frame %u channel %d",
+                     (unsigned)w, (unsigned)f, c);
+        }
+      }
+    }
+
+    filters_init(w);
+    median_heap_u16_filter_buffer(filters.mh, CHANNELS, adc_in, adc_out,
+                                  FRAMES);
+    HOST_CHECK(memcmp(adc_out, adc_ref, sizeof(adc_ref)) == 0,
+               "buffer window %u", (unsigned)w);
+
+    /* Two halves in place, the filters carry over between calls.*/
+    filters_init(w);
+    memcpy(adc_out, adc_in, sizeof(adc_out));
+    median_heap_u16_filter_buffer(filters.mh, CHANNELS, adc_out, adc_out,
+                                  FRAMES / 2);
+    median_heap_u16_filter_buffer(filters.mh, CHANNELS,
+                                  adc_out + (FRAMES / 2) * CHANNELS,
+                                  adc_out + (FRAMES / 2) * CHANNELS,
+                                  FRAMES - FRAMES / 2);
+    HOST_CHECK(memcmp(adc_out, adc_ref, sizeof(adc_ref)) == 0,
+               "in place window %u", (unsigned)w);
+  }
+}
+
+/*===========================================================================*/
+/* Benchmarks.                                                               */
+/*===========================================================================*/
+
+/*
+ * Time per sample of median_filter() and of the heap filter, per call and
+ * through the batch API, on the ADC-like buffer.
+ */
+static void bench(void) {
+  static const uint16_t windows[] = {7, 31, 63, 127, 255};
+  unsigned wi;
+  size_t i, f;
+  int c;
+
+  fill_adc();
+  printf("  %6s %12s %12s %12s\n", "window", "list(ns)", "heap(ns)",
+         "buffer(ns)");
+  for (wi = 0; wi < sizeof(windows) / sizeof(windows[0]); wi++) {
+    uint16_t w = windows[wi];
+    uint64_t t0, t_list, t_heap, t_buf;
+
+    filters_init(w);
+    t0 = hostNowNs();
+    for (f = 0; f < FRAMES; f++) {
+      for (c = 0; c < CHANNELS; c++) {
+        i = f * CHANNELS + (size_t)c;
+        adc_out[i] = median_filter(&filters.ml[c], adc_in[i]);
+      }
+    }
+    t_list = hostNowNs() - t0;
+
+    t0 = hostNowNs();
+    for (f = 0; f < FRAMES; f++) {
+      for (c = 0; c < CHANNELS; c++) {
+        i = f * CHANNELS + (size_t)c;
+        adc_out[i] = median_heap_u16_filter(&filters.mh[c], adc_in[i]);
+      }
+    }
+    t_heap = hostNowNs() - t0;
+
+    filters_init(w);
+    t0 = hostNowNs();
+    median_heap_u16_filter_buffer(filters.mh, CHANNELS, adc_in, adc_out,
+                                  FRAMES);
+    t_buf = hostNowNs() - t0;
+
+    printf("  %6u %12.1f %12.1f %12.1f\n", (unsigned)w,
+           (double)t_list / (FRAMES * CHANNELS),
+           (double)t_heap / (FRAMES * CHANNELS),
+           (double)t_buf / (FRAMES * CHANNELS));
+  }
+}
+
+/*===========================================================================*/
+/* Main.                                                                     */
+/*===========================================================================*/
+
+int main(int argc, char *argv[]) {
+
+  hostInit(argc, argv);
+
+  test_sorted_window();
+  test_full_range();
+  test_buffer();
+
+  if (host_bench) {
+    printf("%s, %d channels, %d frames\n", argv[0], CHANNELS, FRAMES);
+    bench();
+  }
+
+  return hostReport(argv[0]);
+}
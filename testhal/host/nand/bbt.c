@@ -0,0 +1,324 @@
+/*
+    ChibiOS - Copyright (C) 2006..2018 Giovanni Di Sirio
+
+    Licensed under the Apache License, Version 2.0 (the "License");
+    you may not use this file except in compliance with the License.
+    You may obtain a copy of the License at
+
+        http://www.apache.org/licenses/LICENSE-2.0
+
+    Unless required by applicable law or agreed to in writing, software
+    distributed under the License is distributed on an "AS IS" BASIS,
+    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+    See the License for the specific language governing permissions and
+    limitations under the License.
+*/
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "hal.h"
+#include "host_test.h"
+
+/*===========================================================================*/
+/* Simulated NAND.                                                           */
+/*===========================================================================*/
+
+/*
+ * 4096 blocks as a 4 Gbit part. Only pages 0 and 1 of a block are read at
+ * boot, the blocks are kept short so that the array fits in a small
+ * buffer. The map takes two pages of the test device.
+ */
+#define BLOCKS                              4096U
+#define PAGES                               4U
+#define FIRST_BBT                           (BLOCKS - NAND_BBT_BLOCKS)
+
+static NANDConfig nandcfg = {
+  1,
+  1,
+  1,
+  BLOCKS,
+  256,
+  8,
+  PAGES,
+  2,
+  2,
+  NULL,
+  0xDC2CU,
+  25000U,
+  200000U,
+  1500000U,
+  25U
+};
+
+static uint8_t *storage;
+static size_t storage_size;
+static bitmap_word_t bb_words[BLOCKS / 32U];
+static bitmap_t bb_map = {bb_words, BLOCKS / 32U};
+static bitmap_word_t fail_words[BLOCKS / 32U];
+static bitmap_t fail_map = {fail_words, BLOCKS / 32U};
+
+void hook_for_chipselect_nand_flash(uint32_t die) {
+
+  nandsimSelectDie(&NANDD1, die);
+}
+
+static size_t page_size(void) {
+
+  return nandcfg.page_data_size + nandcfg.page_spare_size;
+}
+
+static uint8_t *page_ptr(uint32_t block, uint32_t page) {
+
+  return &storage[((block * nandcfg.pages_per_block) + page) * page_size()];
+}
+
+/* Erased array with factory marks on a few blocks.*/
+static void array_init(uint32_t page_data_size, uint32_t page_spare_size) {
+  static const uint32_t factory[] = {3, 100, 1025, 4000};
+  unsigned i;
+
+  nandcfg.page_data_size = page_data_size;
+  nandcfg.page_spare_size = page_spare_size;
+  storage_size = (size_t)BLOCKS * PAGES * page_size();
+  free(storage);
+  storage = malloc(storage_size);
+  nandcfg.storage = storage;
+  memset(storage, 0xFF, storage_size);
+  for (i = 0; i < sizeof(factory) / sizeof(factory[0]); i++) {
+    page_ptr(factory[i], 0)[page_data_size] = 0x00;
+  }
+  bitmapObjectInit(&fail_map, 0);
+}
+
+/* Starts the driver as at boot, returns the pages read.*/
+static uint32_t boot(void) {
+
+  nandInit();
+  nandsimSetFailMap(&NANDD1, &fail_map);
+  nandStart(&NANDD1, &nandcfg, &bb_map);
+  return nandsimGetStats(&NANDD1)->reads;
+}
+
+/* Map a full scan of the bad block marks produces.*/
+static void scan_map(bitmap_t *map) {
+  uint32_t b;
+
+  bitmapObjectInit(map, 0);
+  for (b = 0; b < BLOCKS; b++) {
+    if (page_ptr(b, 0)[nandcfg.page_data_size] != 0xFFU) {
+      bitmapSet(map, b);
+    }
+  }
+}
+
+static bool map_is(const bitmap_t *ref) {
+
+  return memcmp(bb_map.array, ref->array,
+                bb_map.len * sizeof(bitmap_word_t)) == 0;
+}
+
+/*===========================================================================*/
+/* Tests.                                                                    */
+/*===========================================================================*/
+
+static bitmap_word_t ref_words[BLOCKS / 32U];
+static bitmap_t ref_map = {ref_words, BLOCKS / 32U};
+
+static void reserved(bitmap_t *map) {
+  uint32_t b;
+
+  for (b = FIRST_BBT; b < BLOCKS; b++) {
+    bitmapSet(map, b);
+  }
+}
+
+/*
+ * First boot scans the marks and stores the table, the next boots load it
+ * with a handful of reads.
+ */
+static void test_first_boot(void) {
+  uint32_t scan_reads, reads;
+
+  array_init(256, 8);
+  scan_map(&ref_map);
+  reserved(&ref_map);
+  scan_reads = boot();
+  HOST_CHECK(map_is(&ref_map), "map after the scan");
+  HOST_CHECK(scan_reads >= 2U * BLOCKS, "%u reads, not a full scan",
+             (unsigned)scan_reads);
+
+  reads = boot();
+  HOST_CHECK(map_is(&ref_map), "map loaded from the table");
+  HOST_CHECK(reads <= NAND_BBT_BLOCKS + 2U, "%u reads loading the table",
+             (unsigned)reads);
+  HOST_CHECK(nandIsBad(&NANDD1, 0, 0, 0, FIRST_BBT, 0) &&
+             nandIsBad(&NANDD1, 0, 0, 0, BLOCKS - 1U, 0),
+             "reserved blocks usable");
+}
+
+/* Blocks marked bad at run time are in the table at the next boot.*/
+static void test_mark_bad(void) {
+  uint32_t programs;
+
+  array_init(256, 8);
+  (void)boot();
+  nandMarkBad(&NANDD1, 0, 0, 0, 2000);
+  programs = nandsimGetStats(&NANDD1)->programs;
+  nandMarkBad(&NANDD1, 0, 0, 0, 2000);
+  HOST_CHECK(nandsimGetStats(&NANDD1)->programs - programs <= 2U,
+             "table rewritten for a block already bad");
+
+  /* The mark itself is lost, only the table knows the block.*/
+  memset(page_ptr(2000, 0), 0xFF, 2U * page_size());
+  scan_map(&ref_map);
+  reserved(&ref_map);
+  bitmapSet(&ref_map, 2000);
+  (void)boot();
+  HOST_CHECK(map_is(&ref_map), "block marked bad not in the table");
+}
+
+/*
+ * An update interrupted in the first copy leaves the newest header with a
+ * corrupt map, the previous version in the second copy is loaded.
+ */
+static void test_interrupted_update(void) {
+  const size_t blk_bytes = PAGES * page_size();
+  static uint8_t saved[NAND_BBT_BLOCKS][PAGES * (256U + 8U)];
+  uint32_t i, reads;
+
+  array_init(256, 8);
+  (void)boot();
+  scan_map(&ref_map);
+  reserved(&ref_map);
+  for (i = 0; i < NAND_BBT_BLOCKS; i++) {
+    memcpy(saved[i], page_ptr(FIRST_BBT + i, 0), blk_bytes);
+  }
+  nandMarkBad(&NANDD1, 0, 0, 0, 2000);
+  memset(page_ptr(2000, 0), 0xFF, 2U * page_size());
+
+  /* Second copy not rewritten yet, first copy map half programmed.*/
+  memcpy(page_ptr(FIRST_BBT + 1U, 0), saved[1], blk_bytes);
+  memset(page_ptr(FIRST_BBT, 2), 0xFF, page_size());
+  reads = boot();
+  HOST_CHECK(map_is(&ref_map), "previous table not loaded");
+  HOST_CHECK(reads < 2U * BLOCKS, "full scan with a valid copy");
+}
+
+/* With no valid copy the marks are scanned again and the table rebuilt.*/
+static void test_corrupt_tables(void) {
+  uint32_t reads;
+
+  array_init(256, 8);
+  (void)boot();
+  page_ptr(FIRST_BBT, 1)[0] ^= 0x01U;
+  page_ptr(FIRST_BBT + 1U, 1)[0] ^= 0x01U;
+  scan_map(&ref_map);
+  reserved(&ref_map);
+  reads = boot();
+  HOST_CHECK(map_is(&ref_map), "map after the rescan");
+  HOST_CHECK(reads >= 2U * BLOCKS, "%u reads, not a full scan",
+             (unsigned)reads);
+  reads = boot();
+  HOST_CHECK(map_is(&ref_map) && (reads < 2U * BLOCKS), "table not rebuilt");
+}
+
+/* A reserved block failing erase is skipped and the copies still stored.*/
+static void test_reserved_failure(void) {
+  uint32_t reads;
+
+  array_init(256, 8);
+  bitmapSet(&fail_map, FIRST_BBT);
+  (void)boot();
+  HOST_CHECK(page_ptr(FIRST_BBT, 0)[256] != 0xFFU, "failing block not marked");
+  bitmapObjectInit(&fail_map, 0);
+  scan_map(&ref_map);
+  reserved(&ref_map);
+  reads = boot();
+  HOST_CHECK(map_is(&ref_map), "map loaded from the table");
+  HOST_CHECK(reads < 2U * BLOCKS, "%u reads, no table stored",
+             (unsigned)reads);
+}
+
+/*
+ * Data in the reserved blocks of a device without table: the table is not
+ * created, the blocks are left untouched and usable, marking a block bad
+ * does not write them. Once erased, the next start creates the table.
+ */
+static void test_foreign_data(void) {
+  const size_t area = NAND_BBT_BLOCKS * PAGES * page_size();
+  static uint8_t saved[NAND_BBT_BLOCKS * PAGES * (256U + 8U)];
+  static const struct {
+    uint32_t block, page, offset;
+  } spots[] = {
+    {FIRST_BBT, 0, 0},
+    {FIRST_BBT + 2U, 3, 100},
+    {BLOCKS - 1U, 1, 256U + 5U}             /* Spare only.*/
+  };
+  unsigned i;
+
+  for (i = 0; i < sizeof(spots) / sizeof(spots[0]); i++) {
+    array_init(256, 8);
+    page_ptr(spots[i].block, spots[i].page)[spots[i].offset] = 0x5A;
+    memcpy(saved, page_ptr(FIRST_BBT, 0), area);
+    scan_map(&ref_map);
+
+    nandInit();
+    HOST_CHECK(nandStart(&NANDD1, &nandcfg, &bb_map) == HAL_FAILED,
+               "spot %u: table created over data", i);
+    HOST_CHECK(map_is(&ref_map), "spot %u: map", i);
+    HOST_CHECK(!nandIsBad(&NANDD1, 0, 0, 0, FIRST_BBT, 0),
+               "spot %u: reserved blocks taken", i);
+    nandMarkBad(&NANDD1, 0, 0, 0, 2000);
+    HOST_CHECK(memcmp(saved, page_ptr(FIRST_BBT, 0), area) == 0,
+               "spot %u: reserved blocks written", i);
+
+    /* The area erased by the application.*/
+    memset(page_ptr(FIRST_BBT, 0), 0xFF, area);
+    scan_map(&ref_map);
+    reserved(&ref_map);
+    nandInit();
+    HOST_CHECK(nandStart(&NANDD1, &nandcfg, &bb_map) == HAL_SUCCESS,
+               "spot %u: table refused on erased blocks", i);
+    HOST_CHECK(map_is(&ref_map), "spot %u: map with the table", i);
+    HOST_CHECK(boot() < 2U * BLOCKS, "spot %u: table not stored", i);
+  }
+}
+
+/*===========================================================================*/
+/* Benchmark.                                                                */
+/*===========================================================================*/
+
+/* Boot reads and modelled time, 2 KiB pages.*/
+static void bench(void) {
+  uint64_t t_scan, t_bbt;
+  uint32_t r_scan, r_bbt;
+
+  array_init(2048, 64);
+  r_scan = boot();
+  t_scan = nandsimGetStats(&NANDD1)->time_ns;
+  r_bbt = boot();
+  t_bbt = nandsimGetStats(&NANDD1)->time_ns;
+  printf("%-6s %8s %10s\n", "boot", "reads", "ms");
+  printf("%-6s %8u %10.2f\n", "scan", (unsigned)r_scan, t_scan / 1e6);
+  printf("%-6s %8u %10.2f\n", "table", (unsigned)r_bbt, t_bbt / 1e6);
+}
+
+int main(int argc, char *argv[]) {
+
+  hostInit(argc, argv);
+
+  test_first_boot();
+  test_mark_bad();
+  test_interrupted_update();
+  test_corrupt_tables();
+  test_reserved_failure();
+  test_foreign_data();
+
+  if (host_bench) {
+    bench();
+  }
+
+  free(storage);
+  return hostReport(argv[0]);
+}
@@ -0,0 +1,285 @@
+/*
+    ChibiOS - Copyright (C) 2006..2018 Giovanni Di Sirio
+
+    Licensed under the Apache License, Version 2.0 (the "License");
+    you may not use this file except in compliance with the License.
+    You may obtain a copy of the License at
+
+        http://www.apache.org/licenses/LICENSE-2.0
+
+    Unless required by applicable law or agreed to in writing, software
+    distributed under the License is distributed on an "AS IS" BASIS,
+    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+    See the License for the specific language governing permissions and
+    limitations under the License.
+*/
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "hal.h"
+#include "host_test.h"
+
+/*===========================================================================*/
+/* Simulated NAND.                                                           */
+/*===========================================================================*/
+
+/* Two planes of 2 KiB page blocks, tR 25us, tPROG 250us, 25ns per byte.*/
+#define PLANES                              2U
+#define BLOCKS                              32U
+#define PAGES                               64U
+#define DATA_SIZE                           2048U
+#define SPARE_SIZE                          64U
+#define PAGE_SIZE                           (DATA_SIZE + SPARE_SIZE)
+
+static uint8_t *storage;
+static bitmap_word_t fail_words[(PLANES * BLOCKS + 31U) / 32U];
+static bitmap_t fail_map = {fail_words, sizeof(fail_words) / sizeof(fail_words[0])};
+
+static const NANDConfig nandcfg = {
+  1,
+  1,
+  PLANES,
+  BLOCKS,
+  DATA_SIZE,
+  SPARE_SIZE,
+  PAGES,
+  2,
+  2,
+  NULL,
+  0xDA2CU,
+  25000U,
+  250000U,
+  2000000U,
+  25U
+};
+
+static NANDConfig config;
+
+void hook_for_chipselect_nand_flash(uint32_t die) {
+
+  nandsimSelectDie(&NANDD1, die);
+}
+
+/* The plane selects a block range of the die, as the simulated array.*/
+uint32_t hook_for_calc_row_addr_with_page(uint32_t logun, uint32_t plane,
+                                          uint32_t block, uint32_t page,
+                                          const void *cfg) {
+  const NANDConfig *nandcfgp = cfg;
+
+  return ((((logun * nandcfgp->planes) + plane) * nandcfgp->blocks) + block) *
+         nandcfgp->pages_per_block + page;
+}
+
+uint32_t hook_for_calc_row_addr_with_blk(uint32_t logun, uint32_t plane,
+                                         uint32_t block, const void *cfg) {
+
+  return hook_for_calc_row_addr_with_page(logun, plane, block, 0, cfg);
+}
+
+static uint8_t *page_ptr(uint32_t plane, uint32_t block, uint32_t page) {
+
+  return &storage[(size_t)hook_for_calc_row_addr_with_page(0, plane, block,
+                                                           page, &config) *
+                  PAGE_SIZE];
+}
+
+static void nand_setup(void) {
+  const size_t size = (size_t)PLANES * BLOCKS * PAGES * PAGE_SIZE;
+
+  if (storage == NULL) {
+    storage = malloc(size);
+  }
+  memset(storage, 0xFF, size);
+  config = nandcfg;
+  config.storage = storage;
+  bitmapObjectInit(&fail_map, 0);
+  nandInit();
+  nandStart(&NANDD1, &config, NULL);
+  nandsimSetFailMap(&NANDD1, &fail_map);
+}
+
+/*===========================================================================*/
+/* Tests.                                                                    */
+/*===========================================================================*/
+
+static uint8_t wbuf[PLANES * PAGES * PAGE_SIZE];
+static uint8_t rbuf[PLANES * PAGES * PAGE_SIZE];
+
+static void fill_random(uint8_t *p, size_t n) {
+
+  while (n-- > 0U) {
+    *p++ = (uint8_t)hostRand();
+  }
+}
+
+/*
+ * Runs of pages written with cache program land where single page reads
+ * find them, cache reads return what single page writes stored.
+ */
+static void test_sequential(void) {
+  unsigned pg, errors = 0;
+
+  hostSeed(1);
+  nand_setup();
+
+  /* Whole block, data and spare.*/
+  fill_random(wbuf, PAGES * PAGE_SIZE);
+  HOST_CHECK((nandWriteSequential(&NANDD1, 0, 0, 1, 3, 0, PAGES, wbuf,
+                                  PAGE_SIZE) & NAND_STATUS_FAIL) == 0U,
+             "write status");
+  for (pg = 0; pg < PAGES; pg++) {
+    nandReadPageWhole(&NANDD1, 0, 0, 1, 3, pg, rbuf, PAGE_SIZE);
+    if (memcmp(rbuf, &wbuf[pg * PAGE_SIZE], PAGE_SIZE) != 0) {
+      errors++;
+    }
+  }
+  HOST_CHECK(errors == 0U, "%u pages differ after a cached write", errors);
+  HOST_CHECK(page_ptr(0, 3, 0)[0] == 0xFFU, "written on the wrong plane");
+
+  /* Partial run, data only, read back with cache read.*/
+  fill_random(wbuf, PAGES * DATA_SIZE);
+  for (pg = 5; pg < 21U; pg++) {
+    (void)nandWritePageData(&NANDD1, 0, 0, 0, 7, pg,
+                            &wbuf[(pg - 5U) * DATA_SIZE], DATA_SIZE, NULL);
+  }
+  nandReadSequential(&NANDD1, 0, 0, 0, 7, 5, 16, rbuf, DATA_SIZE);
+  HOST_CHECK(memcmp(rbuf, wbuf, 16U * DATA_SIZE) == 0,
+             "cached read of single page writes");
+  nandReadSequential(&NANDD1, 0, 0, 0, 7, 20, 2, rbuf, DATA_SIZE);
+  HOST_CHECK((memcmp(rbuf, &wbuf[15U * DATA_SIZE], DATA_SIZE) == 0) &&
+             (rbuf[DATA_SIZE] == 0xFFU) &&
+             (rbuf[2U * DATA_SIZE - 1U] == 0xFFU),
+             "cached read across the end of the written run");
+}
+
+/* A page or a block on every plane at once, the other blocks untouched.*/
+static void test_multiplane(void) {
+  unsigned p;
+
+  hostSeed(2);
+  nand_setup();
+  fill_random(wbuf, PLANES * PAGE_SIZE);
+  HOST_CHECK((nandWritePageMultiPlane(&NANDD1, 0, 0, 9, 4, wbuf,
+                                      PAGE_SIZE) & NAND_STATUS_FAIL) == 0U,
+             "program status");
+  for (p = 0; p < PLANES; p++) {
+    nandReadPageWhole(&NANDD1, 0, 0, p, 9, 4, rbuf, PAGE_SIZE);
+    HOST_CHECK(memcmp(rbuf, &wbuf[p * PAGE_SIZE], PAGE_SIZE) == 0,
+               "plane %u page", p);
+  }
+  for (p = 0; p < PLANES; p++) {
+    (void)nandWritePageWhole(&NANDD1, 0, 0, p, 10, 0, wbuf, PAGE_SIZE);
+  }
+  HOST_CHECK((nandEraseMultiPlane(&NANDD1, 0, 0, 9) &
+              NAND_STATUS_FAIL) == 0U, "erase status");
+  for (p = 0; p < PLANES; p++) {
+    HOST_CHECK(page_ptr(p, 9, 4)[0] == 0xFFU, "plane %u not erased", p);
+    HOST_CHECK(page_ptr(p, 10, 0)[0] == wbuf[0], "plane %u, block 10 erased",
+               p);
+  }
+}
+
+/* A failing block on a single plane or page fails the whole operation.*/
+static void test_failures(void) {
+
+  nand_setup();
+  memset(wbuf, 0, PLANES * PAGES * PAGE_SIZE);
+  bitmapSet(&fail_map, BLOCKS + 12U);
+  HOST_CHECK((nandWritePageMultiPlane(&NANDD1, 0, 0, 12, 0, wbuf,
+                                      PAGE_SIZE) & NAND_STATUS_FAIL) != 0U,
+             "multi-plane program, plane 1 failing");
+  HOST_CHECK((nandEraseMultiPlane(&NANDD1, 0, 0, 12) &
+              NAND_STATUS_FAIL) != 0U, "multi-plane erase, plane 1 failing");
+  HOST_CHECK((nandWriteSequential(&NANDD1, 0, 0, 1, 12, 0, PAGES, wbuf,
+                                  DATA_SIZE) & NAND_STATUS_FAIL) != 0U,
+             "cached program, failing block");
+  HOST_CHECK((nandWriteSequential(&NANDD1, 0, 0, 0, 12, 0, PAGES, wbuf,
+                                  DATA_SIZE) & NAND_STATUS_FAIL) == 0U,
+             "cached program, good block");
+}
+
+/*===========================================================================*/
+/* Benchmark.                                                                */
+/*===========================================================================*/
+
+static uint64_t elapsed(uint64_t *t0) {
+  uint64_t now = nandsimGetStats(&NANDD1)->time_ns, d = now - *t0;
+
+  *t0 = now;
+  return d;
+}
+
+static void report(const char *name, uint64_t single, uint64_t fast,
+                   size_t bytes) {
+
+  printf("%-10s %12.0f %12.0f %6.2f\n", name,
+         (double)bytes / 1024.0 / (single / 1e9),
+         (double)bytes / 1024.0 / (fast / 1e9), (double)single / fast);
+}
+
+/* Modelled throughput, single page calls against the new operations.*/
+static void bench(void) {
+  uint64_t t0 = 0, single, fast;
+  unsigned pg, p;
+
+  nand_setup();
+  printf("%-10s %12s %12s %6s\n", "operation", "single KB/s", "new KB/s",
+         "x");
+
+  (void)elapsed(&t0);
+  for (pg = 0; pg < PAGES; pg++) {
+    (void)nandWritePageWhole(&NANDD1, 0, 0, 0, 1, pg, &wbuf[pg * DATA_SIZE],
+                             DATA_SIZE);
+  }
+  single = elapsed(&t0);
+  (void)nandWriteSequential(&NANDD1, 0, 0, 0, 2, 0, PAGES, wbuf, DATA_SIZE);
+  fast = elapsed(&t0);
+  report("program", single, fast, PAGES * DATA_SIZE);
+
+  for (pg = 0; pg < PAGES; pg++) {
+    nandReadPageWhole(&NANDD1, 0, 0, 0, 1, pg, &rbuf[pg * DATA_SIZE],
+                      DATA_SIZE);
+  }
+  single = elapsed(&t0);
+  nandReadSequential(&NANDD1, 0, 0, 0, 2, 0, PAGES, rbuf, DATA_SIZE);
+  fast = elapsed(&t0);
+  report("read", single, fast, PAGES * DATA_SIZE);
+
+  for (pg = 0; pg < PAGES; pg++) {
+    for (p = 0; p < PLANES; p++) {
+      (void)nandWritePageWhole(&NANDD1, 0, 0, p, 3, pg,
+                               &wbuf[p * DATA_SIZE], DATA_SIZE);
+    }
+  }
+  single = elapsed(&t0);
+  for (pg = 0; pg < PAGES; pg++) {
+    (void)nandWritePageMultiPlane(&NANDD1, 0, 0, 4, pg, wbuf, DATA_SIZE);
+  }
+  fast = elapsed(&t0);
+  report("2-plane", single, fast, PLANES * PAGES * DATA_SIZE);
+
+  for (p = 0; p < PLANES; p++) {
+    (void)nandErase(&NANDD1, 0, 0, p, 3);
+  }
+  single = elapsed(&t0);
+  (void)nandEraseMultiPlane(&NANDD1, 0, 0, 4);
+  fast = elapsed(&t0);
+  report("2-erase", single, fast, PLANES * PAGES * DATA_SIZE);
+}
+
+int main(int argc, char *argv[]) {
+
+  hostInit(argc, argv);
+
+  test_sequential();
+  test_multiplane();
+  test_failures();
+
+  if (host_bench) {
+    bench();
+  }
+
+  free(storage);
+  return hostReport(argv[0]);
+}
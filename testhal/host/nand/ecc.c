@@ -0,0 +1,375 @@
+/*
+    ChibiOS - Copyright (C) 2006..2018 Giovanni Di Sirio
+
+    Licensed under the Apache License, Version 2.0 (the "License");
+    you may not use this file except in compliance with the License.
+    You may obtain a copy of the License at
+
+        http://www.apache.org/licenses/LICENSE-2.0
+
+    Unless required by applicable law or agreed to in writing, software
+    distributed under the License is distributed on an "AS IS" BASIS,
+    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+    See the License for the specific language governing permissions and
+    limitations under the License.
+*/
+
+#include <string.h>
+
+#include "hal.h"
+#include "nand_ecc.h"
+#include "host_test.h"
+
+#define STEPS                               4U
+#define MAX_STEP                            512U
+#define TRIALS                              500U
+
+/*===========================================================================*/
+/* Engines under test.                                                       */
+/*===========================================================================*/
+
+typedef struct {
+  const char        *name;
+  const NandEcc     *eccp;
+  /* Correctable bits per step.*/
+  uint32_t          t;
+  /* Significant code bits, Hamming LSB first, BCH MSB first.*/
+  uint32_t          code_bits;
+  bool              msb_first;
+} engine_t;
+
+static NandEccBch bch[4];
+static engine_t engines[6];
+static unsigned nengines;
+
+static void engines_init(void) {
+  static const uint32_t ts[4] = {1, 2, 4, NANDECC_BCH_MAX_T};
+  static char names[4][16];
+  unsigned i;
+
+  engines[0] = (engine_t){"hamming256", &nandeccHamming256, 1, 22, false};
+  engines[1] = (engine_t){"hamming512", &nandeccHamming512, 1, 24, false};
+  nengines = 2;
+  for (i = 0; i < 4U; i++) {
+    nandeccBchObjectInit(&bch[i], 512, ts[i]);
+    snprintf(names[i], sizeof(names[i]), "bch512 t=%u", (unsigned)ts[i]);
+    engines[nengines++] = (engine_t){names[i], (const NandEcc *)&bch[i],
+                                     ts[i], bch[i].bits, true};
+  }
+}
+
+/*===========================================================================*/
+/* Bit flips.                                                                */
+/*===========================================================================*/
+
+static uint8_t data[STEPS * MAX_STEP];
+static uint8_t orig[STEPS * MAX_STEP];
+static uint8_t codes[STEPS * NANDECC_MAX_CODE_SIZE];
+
+static void fill_random(uint8_t *p, size_t n) {
+
+  while (n-- > 0U) {
+    *p++ = (uint8_t)hostRand();
+  }
+}
+
+/*
+ * Flips bit b of the codeword of a step, data bits first then the
+ * significant code bits.
+ */
+static void flip(const engine_t *ep, unsigned step, uint32_t b) {
+  const uint32_t kbits = (uint32_t)ep->eccp->step_size * 8U;
+  uint8_t *code = &codes[step * ep->eccp->code_size];
+
+  if (b < kbits) {
+    data[(step * ep->eccp->step_size) + (b / 8U)] ^=
+        (uint8_t)(1U << (b % 8U));
+  }
+  else if (ep->msb_first) {
+    b -= kbits;
+    code[b / 8U] ^= (uint8_t)(0x80U >> (b % 8U));
+  }
+  else {
+    b -= kbits;
+    code[b / 8U] ^= (uint8_t)(1U << (b % 8U));
+  }
+}
+
+/* Flips n distinct bits in every step.*/
+static void flip_steps(const engine_t *ep, uint32_t n) {
+  const uint32_t nbits = ((uint32_t)ep->eccp->step_size * 8U) + ep->code_bits;
+  uint32_t pos[NANDECC_BCH_MAX_T + 1U];
+  unsigned step, i, j;
+
+  for (step = 0; step < STEPS; step++) {
+    for (i = 0; i < n; i++) {
+      do {
+        pos[i] = hostRand() % nbits;
+        for (j = 0; (j < i) && (pos[j] != pos[i]); j++) {
+        }
+      } while (j < i);
+      flip(ep, step, pos[i]);
+    }
+  }
+}
+
+static size_t page_size(const engine_t *ep) {
+
+  return STEPS * ep->eccp->step_size;
+}
+
+/* Random data, or an erased page, with its codes.*/
+static void encode(const engine_t *ep, bool erased) {
+
+  if (erased) {
+    memset(data, 0xFF, page_size(ep));
+    memset(codes, 0xFF, STEPS * ep->eccp->code_size);
+  }
+  else {
+    fill_random(data, page_size(ep));
+    nandeccCalculatePage(ep->eccp, data, page_size(ep), codes);
+  }
+  memcpy(orig, data, page_size(ep));
+}
+
+/*===========================================================================*/
+/* Tests.                                                                    */
+/*===========================================================================*/
+
+/* The codes of an erased page are all ones, it reads back as valid.*/
+static void test_erased(const engine_t *ep) {
+  uint8_t calc[STEPS * NANDECC_MAX_CODE_SIZE];
+
+  encode(ep, true);
+  nandeccCalculatePage(ep->eccp, data, page_size(ep), calc);
+  HOST_CHECK(memcmp(calc, codes, STEPS * ep->eccp->code_size) == 0,
+             "%s: erased page code", ep->name);
+}
+
+/*
+ * Up to t flipped bits per step, anywhere in the data or in the code, are
+ * corrected and counted.
+ */
+static void test_correct(const engine_t *ep) {
+  unsigned trial, errors;
+  uint32_t n;
+
+  hostSeed(ep->t + (uint32_t)ep->eccp->step_size);
+  for (n = 1; n <= ep->t; n++) {
+    errors = 0;
+    for (trial = 0; trial < TRIALS; trial++) {
+      int32_t r;
+
+      encode(ep, (trial % 8U) == 0U);
+      flip_steps(ep, n);
+      r = nandeccCorrectPage(ep->eccp, data, page_size(ep), codes);
+      if ((r < 0) || ((uint32_t)r != n) ||
+          (memcmp(data, orig, page_size(ep)) != 0)) {
+        errors++;
+      }
+    }
+    HOST_CHECK(errors == 0U, "%s: %u flips, %u of %u pages not corrected",
+               ep->name, (unsigned)n, errors, TRIALS);
+  }
+}
+
+/*
+ * Upper bound of the number of pages with t + 1 errors silently
+ * miscorrected. Hamming detects all double errors. BCH decodes a random
+ * syndrome with probability about sum(C(n, i), i <= t) / 2^(13t), that is
+ * 2^-t / t! for 4096 bit steps, the bound is twice that plus a margin for
+ * the sampling noise.
+ */
+static double miscorrect_bound(const engine_t *ep) {
+  double p = 2.0 * TRIALS;
+  uint32_t i;
+
+  if (!ep->msb_first) {
+    return 0.0;
+  }
+  for (i = 1; i <= ep->t; i++) {
+    p /= 2.0 * (double)i;
+  }
+  return p + 3.0;
+}
+
+/* t + 1 flipped bits in a single step are reported as uncorrectable.*/
+static void test_detect(const engine_t *ep) {
+  const uint32_t nbits = ((uint32_t)ep->eccp->step_size * 8U) + ep->code_bits;
+  unsigned trial, silent = 0;
+
+  hostSeed(100U + ep->t);
+  for (trial = 0; trial < TRIALS; trial++) {
+    uint32_t pos[NANDECC_BCH_MAX_T + 1U];
+    unsigned step = trial % STEPS, i, j;
+
+    encode(ep, false);
+    for (i = 0; i <= ep->t; i++) {
+      do {
+        pos[i] = hostRand() % nbits;
+        for (j = 0; (j < i) && (pos[j] != pos[i]); j++) {
+        }
+      } while (j < i);
+      flip(ep, step, pos[i]);
+    }
+    if (nandeccCorrectPage(ep->eccp, data, page_size(ep), codes) !=
+        NANDECC_UNCORRECTABLE) {
+      silent++;
+    }
+  }
+  HOST_CHECK((double)silent <= miscorrect_bound(ep),
+             "%s: %u of %u pages with %u flips not detected", ep->name,
+             silent, TRIALS, (unsigned)(ep->t + 1U));
+}
+
+/*
+ * Pages written and read through the driver, the simulated array injects
+ * t bit errors per read, too few to exceed t in any step.
+ */
+static uint8_t storage[16U * (2048U + 64U)];
+static uint16_t page_buf[(2048U + 64U) / 2U];
+
+static const NANDConfig nandcfg = {
+  1, 1, 1, 1, 2048, 64, 16, 1, 2, storage, 0xDA2CU, 25000U, 200000U,
+  1500000U, 25U
+};
+
+void hook_for_chipselect_nand_flash(uint32_t die) {
+
+  nandsimSelectDie(&NANDD1, die);
+}
+
+static void test_driver(const engine_t *ep) {
+  uint8_t *buf = (uint8_t *)page_buf;
+  unsigned pg, errors = 0;
+
+  if (ep->eccp->step_size != 512U) {
+    return;
+  }
+  memset(storage, 0xFF, sizeof(storage));
+  nandInit();
+  nandStart(&NANDD1, &nandcfg, NULL);
+  hostSeed(200U + ep->t);
+  for (pg = 0; pg < 16U; pg++) {
+    fill_random(buf, 2048);
+    memcpy(&orig[0], buf, 2048);
+    (void)nandeccWritePage(&NANDD1, 0, 0, 0, 0, pg, buf, ep->eccp, 2);
+    nandsimSetReadFlips(&NANDD1, ep->t);
+    if ((nandeccReadPage(&NANDD1, 0, 0, 0, 0, pg, buf, ep->eccp, 2) < 0) ||
+        (memcmp(buf, orig, 2048) != 0)) {
+      errors++;
+    }
+    nandsimSetReadFlips(&NANDD1, 0);
+  }
+  HOST_CHECK(errors == 0U, "%s: %u pages read with errors", ep->name,
+             errors);
+  HOST_CHECK(nandsimGetStats(&NANDD1)->flips > 0U, "%s: no bit flipped",
+             ep->name);
+  nandStop(&NANDD1);
+}
+
+/*===========================================================================*/
+/* Benchmark.                                                                */
+/*===========================================================================*/
+
+/* Host throughput of encoding, clean decoding and decoding t errors.*/
+static void bench(void) {
+  unsigned e;
+
+  printf("%-14s %10s %10s %10s\n", "engine", "enc MB/s", "check MB/s",
+         "fix t MB/s");
+  for (e = 0; e < nengines; e++) {
+    const engine_t *ep = &engines[e];
+    const unsigned iters = 2000;
+    double mbytes = (double)page_size(ep) * iters / 1e6;
+    uint64_t t0, t_enc, t_chk, t_fix = 0;
+    unsigned i;
+
+    encode(ep, false);
+    t0 = hostNowNs();
+    for (i = 0; i < iters; i++) {
+      nandeccCalculatePage(ep->eccp, data, page_size(ep), codes);
+    }
+    t_enc = hostNowNs() - t0;
+    t0 = hostNowNs();
+    for (i = 0; i < iters; i++) {
+      (void)nandeccCorrectPage(ep->eccp, data, page_size(ep), codes);
+    }
+    t_chk = hostNowNs() - t0;
+    for (i = 0; i < iters; i++) {
+      encode(ep, false);
+      flip_steps(ep, ep->t);
+      t0 = hostNowNs();
+      (void)nandeccCorrectPage(ep->eccp, data, page_size(ep), codes);
+      t_fix += hostNowNs() - t0;
+    }
+    printf("%-14s %10.1f %10.1f %10.1f\n", ep->name, mbytes / (t_enc / 1e9),
+           mbytes / (t_chk / 1e9), mbytes / (t_fix / 1e9));
+  }
+}
+
+/*
+ * Host throughput of the BCH decoder correcting t flipped data bits in
+ * every step, for several page sizes.
+ */
+static void bench_pages(void) {
+  static const size_t sizes[] = {512, 2048, 4096};
+  static uint8_t page[4096];
+  static uint8_t pcodes[(4096U / 512U) * NANDECC_MAX_CODE_SIZE];
+  unsigned e, s;
+
+  printf("%-14s %10s %10s %10s\n", "fix t MB/s", "512", "2048", "4096");
+  for (e = 0; e < nengines; e++) {
+    const engine_t *ep = &engines[e];
+
+    if (!ep->msb_first) {
+      continue;
+    }
+    printf("%-14s", ep->name);
+    for (s = 0; s < sizeof(sizes) / sizeof(sizes[0]); s++) {
+      const unsigned iters = (unsigned)((256U * 1024U) / sizes[s]);
+      uint64_t t0, t_fix = 0;
+      unsigned i, step;
+      uint32_t b;
+
+      for (i = 0; i < iters; i++) {
+        fill_random(page, sizes[s]);
+        nandeccCalculatePage(ep->eccp, page, sizes[s], pcodes);
+        for (step = 0; step < sizes[s] / 512U; step++) {
+          /* Distinct bits, one in each of t byte groups of the step.*/
+          for (b = 0; b < ep->t; b++) {
+            page[(step * 512U) + (b * (512U / ep->t)) +
+                 (hostRand() % (512U / ep->t))] ^=
+                (uint8_t)(1U << (hostRand() % 8U));
+          }
+        }
+        t0 = hostNowNs();
+        (void)nandeccCorrectPage(ep->eccp, page, sizes[s], pcodes);
+        t_fix += hostNowNs() - t0;
+      }
+      printf(" %10.1f", ((double)sizes[s] * iters / 1e6) / (t_fix / 1e9));
+    }
+    printf("\n");
+  }
+}
+
+int main(int argc, char *argv[]) {
+  unsigned e;
+
+  hostInit(argc, argv);
+  engines_init();
+
+  for (e = 0; e < nengines; e++) {
+    test_erased(&engines[e]);
+    test_correct(&engines[e]);
+    test_detect(&engines[e]);
+    test_driver(&engines[e]);
+  }
+
+  if (host_bench) {
+    bench();
+    bench_pages();
+  }
+
+  return hostReport(argv[0]);
+}
@@ -0,0 +1,439 @@
+/*
+    ChibiOS - Copyright (C) 2006..2018 Giovanni Di Sirio
+
+    Licensed under the Apache License, Version 2.0 (the "License");
+    you may not use this file except in compliance with the License.
+    You may obtain a copy of the License at
+
+        http://www.apache.org/licenses/LICENSE-2.0
+
+    Unless required by applicable law or agreed to in writing, software
+    distributed under the License is distributed on an "AS IS" BASIS,
+    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+    See the License for the specific language governing permissions and
+    limitations under the License.
+*/
+
+#include <string.h>
+
+#include "hal.h"
+#include "nand_ftl.h"
+#include "host_test.h"
+
+/*===========================================================================*/
+/* Simulated NAND.                                                           */
+/*===========================================================================*/
+
+#define BLOCKS                              128U
+#define PAGES                               32U
+#define DATA_SIZE                           512U
+#define SPARE_SIZE                          64U
+#define PAGE_SIZE                           (DATA_SIZE + SPARE_SIZE)
+#define RESERVED                            8U
+#define LPAGES                              NANDFTL_L2P_SIZE(BLOCKS, RESERVED, PAGES)
+
+static uint8_t storage[BLOCKS * PAGES * PAGE_SIZE];
+static bitmap_word_t fail_words[(BLOCKS + 31U) / 32U];
+static bitmap_t fail_map = {fail_words, sizeof(fail_words) / sizeof(fail_words[0])};
+
+/* Small SLC device timings.*/
+static const NANDConfig nandcfg = {
+  1,
+  1,
+  1,
+  BLOCKS,
+  DATA_SIZE,
+  SPARE_SIZE,
+  PAGES,
+  2,
+  2,
+  storage,
+  0xDA2CU,
+  25000U,
+  200000U,
+  1500000U,
+  25U
+};
+
+void hook_for_chipselect_nand_flash(uint32_t die) {
+
+  nandsimSelectDie(&NANDD1, die);
+}
+
+static void nand_setup(void) {
+
+  memset(storage, 0xFF, sizeof(storage));
+  bitmapObjectInit(&fail_map, 0);
+  nandInit();
+  nandStart(&NANDD1, &nandcfg, NULL);
+  nandsimSetFailMap(&NANDD1, &fail_map);
+}
+
+/*===========================================================================*/
+/* FTL.                                                                      */
+/*===========================================================================*/
+
+static NandFtl ftl;
+static NandFtlConfig ftlcfg;
+static uint32_t l2p[LPAGES];
+static nandftl_block_t blocks[BLOCKS];
+static uint16_t page_buf[PAGE_SIZE / 2U];
+static uint8_t ref[LPAGES * DATA_SIZE];
+static uint8_t buf[8U * DATA_SIZE];
+static const NandEcc *ftl_ecc;
+
+static void ftl_start(uint32_t wl_threshold, bool reclaim_foreign) {
+
+  ftlcfg.nandp = &NANDD1;
+  ftlcfg.first_block = 0;
+  ftlcfg.nblocks = BLOCKS;
+  ftlcfg.reserved = RESERVED;
+  ftlcfg.wl_threshold = wl_threshold;
+  ftlcfg.l2p = l2p;
+  ftlcfg.blocks = blocks;
+  ftlcfg.page_buf = (uint8_t *)page_buf;
+  ftlcfg.ecc = ftl_ecc;
+  ftlcfg.reclaim_foreign = reclaim_foreign;
+  nandftlObjectInit(&ftl);
+  nandftlStart(&ftl, &ftlcfg);
+}
+
+/* Restarts the FTL, the map is rebuilt from the array content.*/
+static bool ftl_remount(void) {
+
+  (void)blkDisconnect(&ftl);
+  nandftlStop(&ftl);
+  ftl_start(ftlcfg.wl_threshold, ftlcfg.reclaim_foreign);
+  return blkConnect(&ftl);
+}
+
+static void fill_random(uint8_t *p, size_t n) {
+
+  while (n-- > 0U) {
+    *p++ = (uint8_t)hostRand();
+  }
+}
+
+/* Writes n random pages at lpn, mirrored in the reference.*/
+static bool ftl_write(uint32_t lpn, uint32_t n) {
+
+  fill_random(&ref[lpn * DATA_SIZE], n * DATA_SIZE);
+  return blkWrite(&ftl, lpn, &ref[lpn * DATA_SIZE], n);
+}
+
+/* Compares the whole logical space with the reference.*/
+static unsigned ftl_compare(void) {
+  unsigned lpn, errors = 0;
+
+  for (lpn = 0; lpn < LPAGES; lpn++) {
+    if ((blkRead(&ftl, lpn, buf, 1) != HAL_SUCCESS) ||
+        (memcmp(buf, &ref[lpn * DATA_SIZE], DATA_SIZE) != 0)) {
+      errors++;
+    }
+  }
+  return errors;
+}
+
+static uint32_t erase_spread(void) {
+  uint32_t pb, min = UINT32_MAX, max = 0;
+
+  for (pb = 0; pb < BLOCKS; pb++) {
+    if (blocks[pb].state == NANDFTL_BLK_BAD) {
+      continue;
+    }
+    if (blocks[pb].erase_count < min) {
+      min = blocks[pb].erase_count;
+    }
+    if (blocks[pb].erase_count > max) {
+      max = blocks[pb].erase_count;
+    }
+  }
+  return max - min;
+}
+
+/* The whole logical space written once, then random writes of 1..8 pages.*/
+static unsigned random_writes(unsigned nops, uint32_t hot_pages) {
+  unsigned op, errors = 0;
+
+  for (op = 0; op < nops; op++) {
+    uint32_t n = 1U + (hostRand() % 8U);
+    uint32_t lpn = hostRand() % (hot_pages - n + 1U);
+
+    if (ftl_write(lpn, n) != HAL_SUCCESS) {
+      errors++;
+    }
+  }
+  return errors;
+}
+
+static void fill_all(void) {
+  uint32_t lpn;
+
+  for (lpn = 0; lpn < LPAGES; lpn += 8U) {
+    (void)ftl_write(lpn, 8);
+  }
+}
+
+/*===========================================================================*/
+/* Tests.                                                                    */
+/*===========================================================================*/
+
+/*
+ * Random writes with garbage collection, the content survives a remount
+ * and writing resumes in the open block.
+ */
+static void test_remount(void) {
+
+  hostSeed(1);
+  nand_setup();
+  ftl_start(0, false);
+  memset(ref, 0xFF, sizeof(ref));
+  HOST_CHECK(blkConnect(&ftl) == HAL_SUCCESS, "connect, erased array");
+  fill_all();
+  HOST_CHECK(random_writes(4000, LPAGES) == 0U, "write errors");
+  HOST_CHECK(nandftlGetStats(&ftl)->gc_moves > 0U, "no garbage collection");
+  HOST_CHECK(ftl_compare() == 0U, "contents");
+
+  HOST_CHECK(ftl_remount() == HAL_SUCCESS, "remount");
+  HOST_CHECK(ftl_compare() == 0U, "contents after remount");
+  HOST_CHECK(random_writes(500, LPAGES) == 0U, "write errors after remount");
+  HOST_CHECK(ftl_remount() == HAL_SUCCESS, "second remount");
+  HOST_CHECK(ftl_compare() == 0U, "contents after second remount");
+}
+
+/* Writes a page that is not FTL data, the bad block mark left erased.*/
+static void write_foreign(uint32_t block) {
+
+  memset(page_buf, 0x5A, sizeof(page_buf));
+  page_buf[DATA_SIZE / 2U] = 0xFFFFU;
+  (void)nandWritePageWhole(&NANDD1, 0, 0, 0, block, 0, page_buf,
+                           sizeof(page_buf));
+}
+
+static bool block_erased(uint32_t block) {
+  const uint8_t *p = &storage[block * PAGES * PAGE_SIZE];
+  size_t i;
+
+  for (i = 0; i < PAGES * PAGE_SIZE; i++) {
+    if (p[i] != 0xFFU) {
+      return false;
+    }
+  }
+  return true;
+}
+
+/*
+ * Blocks of another user of the array are never erased by a mount, unless
+ * reclaiming is enabled or the area is formatted.
+ */
+static void test_foreign(void) {
+
+  hostSeed(2);
+  nand_setup();
+  ftl_start(0, false);
+  HOST_CHECK(blkConnect(&ftl) == HAL_SUCCESS, "connect");
+  memset(ref, 0xFF, sizeof(ref));
+  HOST_CHECK(random_writes(200, LPAGES) == 0U, "write errors");
+  (void)blkDisconnect(&ftl);
+  write_foreign(BLOCKS - 1U);
+
+  HOST_CHECK(ftl_remount() == HAL_FAILED, "mounted over a foreign block");
+  HOST_CHECK(blkGetDriverState(&ftl) != BLK_READY, "ready");
+  HOST_CHECK(!block_erased(BLOCKS - 1U), "foreign block erased");
+  HOST_CHECK(blkRead(&ftl, 0, buf, 1) == HAL_FAILED, "read, not mounted");
+
+  ftlcfg.reclaim_foreign = true;
+  HOST_CHECK(ftl_remount() == HAL_SUCCESS, "mount, reclaiming");
+  HOST_CHECK(block_erased(BLOCKS - 1U), "foreign block not reclaimed");
+  HOST_CHECK(ftl_compare() == 0U, "contents");
+
+  (void)blkDisconnect(&ftl);
+  write_foreign(BLOCKS - 1U);
+  ftlcfg.reclaim_foreign = false;
+  HOST_CHECK(ftl_remount() == HAL_FAILED, "mounted over a foreign block");
+  HOST_CHECK(nandftlFormat(&ftl) == HAL_SUCCESS, "format");
+  HOST_CHECK(blkConnect(&ftl) == HAL_SUCCESS, "connect after format");
+  memset(ref, 0xFF, sizeof(ref));
+  HOST_CHECK(ftl_compare() == 0U, "contents after format");
+}
+
+/*
+ * Blocks failing program or erase at run time are retired without data
+ * loss, and stay retired across a remount.
+ */
+static void test_bad_blocks(void) {
+  uint32_t b;
+
+  hostSeed(3);
+  nand_setup();
+  ftl_start(0, false);
+  memset(ref, 0xFF, sizeof(ref));
+  HOST_CHECK(blkConnect(&ftl) == HAL_SUCCESS, "connect");
+  fill_all();
+  for (b = 0; b < RESERVED - NANDFTL_MIN_RESERVED; b++) {
+    bitmapSet(&fail_map, 7U + (b * 23U));
+  }
+  HOST_CHECK(random_writes(3000, LPAGES) == 0U, "write errors");
+  HOST_CHECK(nandftlGetStats(&ftl)->bad_blocks ==
+             RESERVED - NANDFTL_MIN_RESERVED, "%u bad blocks",
+             (unsigned)nandftlGetStats(&ftl)->bad_blocks);
+  HOST_CHECK(ftl_compare() == 0U, "contents");
+
+  bitmapObjectInit(&fail_map, 0);
+  HOST_CHECK(ftl_remount() == HAL_SUCCESS, "remount");
+  for (b = 0; b < RESERVED - NANDFTL_MIN_RESERVED; b++) {
+    HOST_CHECK(blocks[7U + (b * 23U)].state == NANDFTL_BLK_BAD,
+               "block %u not bad after remount", (unsigned)(7U + (b * 23U)));
+  }
+  HOST_CHECK(ftl_compare() == 0U, "contents after remount");
+}
+
+/*
+ * Hot data over cold data, static wear leveling keeps the erase counts
+ * within the threshold.
+ */
+static void test_wear_leveling(void) {
+  uint32_t spread[2];
+  unsigned i;
+
+  for (i = 0; i < 2U; i++) {
+    hostSeed(4);
+    nand_setup();
+    ftl_start(i == 0U ? 0U : 16U, false);
+    memset(ref, 0xFF, sizeof(ref));
+    (void)blkConnect(&ftl);
+    fill_all();
+    HOST_CHECK(random_writes(20000, LPAGES / 10U) == 0U, "write errors");
+    HOST_CHECK(ftl_compare() == 0U, "contents");
+    spread[i] = erase_spread();
+  }
+  HOST_CHECK(spread[1] <= 16U + 2U, "erase count spread %u",
+             (unsigned)spread[1]);
+  HOST_CHECK(spread[0] > spread[1], "spread %u without wear leveling",
+             (unsigned)spread[0]);
+}
+
+/* Random writes of the other logical pages until lpn is moved.*/
+static bool rewrite_others(uint32_t lpn) {
+  uint32_t ppn = l2p[lpn], i;
+  unsigned op;
+
+  for (op = 0; (op < 100000U) && (l2p[lpn] == ppn); op++) {
+    i = hostRand() % LPAGES;
+    if ((i != lpn) && (ftl_write(i, 1) != HAL_SUCCESS)) {
+      return HAL_FAILED;
+    }
+  }
+  return l2p[lpn] == ppn ? HAL_FAILED : HAL_SUCCESS;
+}
+
+/*
+ * A page the ECC cannot correct stays unreadable after garbage collection
+ * moved it with valid codes, across a remount and further moves, until the
+ * host writes it again.
+ */
+static void test_uncorrectable(void) {
+  const uint32_t lpn = 5;
+  uint8_t *p;
+
+  hostSeed(6);
+  nand_setup();
+  ftl_ecc = &nandeccHamming512;
+  ftl_start(0, false);
+  memset(ref, 0xFF, sizeof(ref));
+  HOST_CHECK(blkConnect(&ftl) == HAL_SUCCESS, "connect");
+  fill_all();
+
+  /* Two flipped bits in a step, Hamming only detects them.*/
+  p = &storage[l2p[lpn] * PAGE_SIZE];
+  p[0]   ^= 0x01U;
+  p[100] ^= 0x10U;
+  HOST_CHECK(blkRead(&ftl, lpn, buf, 1) == HAL_FAILED, "corrupted page read");
+  HOST_CHECK(nandftlGetStats(&ftl)->ecc_failures == 1U, "%u ECC failures",
+             (unsigned)nandftlGetStats(&ftl)->ecc_failures);
+
+  HOST_CHECK(rewrite_others(lpn) == HAL_SUCCESS, "page not moved");
+  HOST_CHECK(nandftlGetStats(&ftl)->ecc_lost == 1U, "%u lost pages",
+             (unsigned)nandftlGetStats(&ftl)->ecc_lost);
+  HOST_CHECK(blkRead(&ftl, lpn, buf, 1) == HAL_FAILED, "moved page read");
+  HOST_CHECK(ftl_compare() == 1U, "contents");
+
+  HOST_CHECK(ftl_remount() == HAL_SUCCESS, "remount");
+  HOST_CHECK(blkRead(&ftl, lpn, buf, 1) == HAL_FAILED, "read after remount");
+  HOST_CHECK(rewrite_others(lpn) == HAL_SUCCESS, "page not moved again");
+  HOST_CHECK(nandftlGetStats(&ftl)->ecc_failures == 0U, "%u ECC failures",
+             (unsigned)nandftlGetStats(&ftl)->ecc_failures);
+  HOST_CHECK(blkRead(&ftl, lpn, buf, 1) == HAL_FAILED, "read after move");
+  HOST_CHECK(ftl_compare() == 1U, "contents after remount");
+
+  HOST_CHECK(ftl_write(lpn, 1) == HAL_SUCCESS, "rewrite");
+  HOST_CHECK(ftl_compare() == 0U, "contents after rewrite");
+  HOST_CHECK(ftl_remount() == HAL_SUCCESS, "second remount");
+  HOST_CHECK(ftl_compare() == 0U, "contents after second remount");
+  ftl_ecc = NULL;
+}
+
+/*===========================================================================*/
+/* Benchmark.                                                                */
+/*===========================================================================*/
+
+static const struct {
+  const char    *name;
+  uint32_t      hot_pages;
+  uint32_t      wl_threshold;
+} workloads[] = {
+  {"uniform",       LPAGES,         0},
+  {"hot 10%",       LPAGES / 10U,   0},
+  {"hot 10% wl",    LPAGES / 10U,   16},
+  {"hot 1% wl",     LPAGES / 100U,  16}
+};
+
+/*
+ * Write amplification, erase count spread and modelled device time of
+ * random 1..8 page writes after a full sequential fill, then the modelled
+ * time of a mount.
+ */
+static void bench(void) {
+  unsigned w;
+
+  printf("%-12s %6s %8s %6s %10s %9s\n", "workload", "WA", "erases",
+         "spread", "write ms", "mount ms");
+  for (w = 0; w < sizeof(workloads) / sizeof(workloads[0]); w++) {
+    nandftl_stats_t *stp = nandftlGetStats(&ftl);
+    uint64_t t_write, t_mount;
+
+    hostSeed(5);
+    nand_setup();
+    ftl_start(workloads[w].wl_threshold, false);
+    (void)blkConnect(&ftl);
+    fill_all();
+    memset(stp, 0, sizeof(*stp));
+    nandsimGetStats(&NANDD1)->time_ns = 0;
+    (void)random_writes(20000, workloads[w].hot_pages);
+    t_write = nandsimGetStats(&NANDD1)->time_ns;
+    printf("%-12s %6.2f %8u %6u %10.1f", workloads[w].name,
+           (double)stp->programs / (double)stp->host_writes,
+           (unsigned)stp->erases, (unsigned)erase_spread(), t_write / 1e6);
+    nandsimGetStats(&NANDD1)->time_ns = 0;
+    (void)ftl_remount();
+    t_mount = nandsimGetStats(&NANDD1)->time_ns;
+    printf(" %9.1f\n", t_mount / 1e6);
+  }
+}
+
+int main(int argc, char *argv[]) {
+
+  hostInit(argc, argv);
+
+  test_remount();
+  test_foreign();
+  test_bad_blocks();
+  test_wear_leveling();
+  test_uncorrectable();
+
+  if (host_bench) {
+    bench();
+  }
+
+  return hostReport(argv[0]);
+}
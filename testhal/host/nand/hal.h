@@ -0,0 +1,32 @@
+/*
+    ChibiOS - Copyright (C) 2006..2018 Giovanni Di Sirio
+
+    Licensed under the Apache License, Version 2.0 (the "License");
+    you may not use this file except in compliance with the License.
+    You may obtain a copy of the License at
+
+        http://www.apache.org/licenses/LICENSE-2.0
+
+    Unless required by applicable law or agreed to in writing, software
+    distributed under the License is distributed on an "AS IS" BASIS,
+    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+    See the License for the specific language governing permissions and
+    limitations under the License.
+*/
+
+#ifndef HAL_H
+#define HAL_H
+
+#include "osal.h"
+
+#define HAL_SUCCESS                         false
+#define HAL_FAILED                          true
+
+#if !defined(HAL_USE_NAND)
+#define HAL_USE_NAND                        TRUE
+#endif
+
+#include "hal_ioblock.h"
+#include "hal_nand.h"
+
+#endif /* HAL_H */
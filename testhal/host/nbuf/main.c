@@ -0,0 +1,241 @@
+/*
+    ChibiOS - Copyright (C) 2006..2018 Giovanni Di Sirio
+
+    Licensed under the Apache License, Version 2.0 (the "License");
+    you may not use this file except in compliance with the License.
+    You may obtain a copy of the License at
+
+        http://www.apache.org/licenses/LICENSE-2.0
+
+    Unless required by applicable law or agreed to in writing, software
+    distributed under the License is distributed on an "AS IS" BASIS,
+    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+    See the License for the specific language governing permissions and
+    limitations under the License.
+*/
+
+/*
+ * N-buffer exchanger under real concurrency: one producer thread
+ * publishing two million frames and three consumer threads reading the
+ * latest one, each pinned to a core when there are enough of them. Every
+ * frame carries its sequence number at both ends and a payload derived
+ * from it, a consumer checks that the frame it acquired is whole, is the
+ * one announced by nbufAcquireFrontX() and is not older than the previous
+ * one. The producer reports the swap latency.
+ */
+
+#define _GNU_SOURCE
+
+#include <pthread.h>
+#include <sched.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "osal.h"
+#include "nbuf.h"
+#include "host_test.h"
+
+/*===========================================================================*/
+/* Helpers.                                                                  */
+/*===========================================================================*/
+
+#define CONSUMERS                           3U
+#define BUFFERS                             (CONSUMERS + 2U)
+#define SWAPS                               2000000U
+#define FRAME_WORDS                         128U
+
+typedef struct {
+  uint32_t                  head;
+  uint32_t                  payload[FRAME_WORDS];
+  uint32_t                  tail;
+} frame_t;
+
+typedef struct {
+  pthread_t                 thread;
+  unsigned                  core;
+  /* Results, read by main once the thread has been joined.*/
+  uint32_t                  frames;
+  uint32_t                  seen;
+  uint32_t                  torn;
+  uint32_t                  mismatched;
+  uint32_t                  backwards;
+} consumer_t;
+
+static frame_t frames[BUFFERS];
+static nbuf_t nb;
+static consumer_t consumers[CONSUMERS];
+static volatile bool done;
+
+static uint32_t word(uint32_t seq, unsigned i) {
+
+  return (seq * 2654435761U) ^ (i * 40503U);
+}
+
+static void frame_fill(frame_t *f, uint32_t seq) {
+  unsigned i;
+
+  f->head = seq;
+  for (i = 0; i < FRAME_WORDS; i++) {
+    f->payload[i] = word(seq, i);
+  }
+  f->tail = seq;
+}
+
+static bool frame_whole(const volatile frame_t *f) {
+  uint32_t seq = f->head;
+  unsigned i;
+
+  for (i = 0; i < FRAME_WORDS; i++) {
+    if (f->payload[i] != word(seq, i)) {
+      return false;
+    }
+  }
+  return f->tail == seq;
+}
+
+static void pin(unsigned core) {
+  long cores = sysconf(_SC_NPROCESSORS_ONLN);
+  cpu_set_t set;
+
+  if (cores > 1) {
+    CPU_ZERO(&set);
+    CPU_SET(core % (unsigned)cores, &set);
+    (void)pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+  }
+}
+
+static void *consumer(void *arg) {
+  consumer_t *c = arg;
+  uint32_t seq, last = 0;
+  const volatile frame_t *f;
+
+  pin(c->core);
+  while (!done) {
+    f = nbufAcquireFrontX(&nb, &seq);
+    if (!frame_whole(f)) {
+      c->torn++;
+    }
+    else if (f->head != seq) {
+      c->mismatched++;
+    }
+    nbufReleaseFrontX(&nb, (const void *)f);
+
+    if (seq < last) {
+      c->backwards++;
+    }
+    else if (seq > last) {
+      c->seen++;
+    }
+    last = seq;
+    c->frames++;
+  }
+  return NULL;
+}
+
+/*===========================================================================*/
+/* Tests.                                                                    */
+/*===========================================================================*/
+
+/* A pinned buffer is never handed back to the producer.*/
+static void test_pinned(void) {
+  void *bufs[BUFFERS];
+  void *front;
+  uint32_t seq;
+  unsigned i;
+
+  for (i = 0; i < BUFFERS; i++) {
+    bufs[i] = &frames[i];
+  }
+  nbufObjectInit(&nb, bufs, BUFFERS);
+  front = nbufAcquireFrontX(&nb, &seq);
+  HOST_CHECK((front == &frames[0]) && (seq == 0U), "initial front buffer");
+  for (i = 0; i < 4U * BUFFERS; i++) {
+    HOST_CHECK(nbufGetBackX(&nb) != front, "pinned buffer is back at swap %u",
+               i);
+    nbufSwapBackX(&nb);
+    HOST_CHECK(nbufGetSequenceX(&nb) == i + 1U, "sequence %u at swap %u",
+               (unsigned)nbufGetSequenceX(&nb), i);
+  }
+  nbufReleaseFrontX(&nb, front);
+}
+
+static void test_threads(void) {
+  void *bufs[BUFFERS];
+  uint64_t t, ns, total = 0, worst = 0, clock;
+  uint32_t seq, seen = 0;
+  unsigned i;
+
+  for (i = 0; i < BUFFERS; i++) {
+    bufs[i] = &frames[i];
+  }
+  nbufObjectInit(&nb, bufs, BUFFERS);
+  frame_fill(&frames[0], 0);
+  done = false;
+  for (i = 0; i < CONSUMERS; i++) {
+    memset(&consumers[i], 0, sizeof(consumers[i]));
+    consumers[i].core = i + 1U;
+    HOST_CHECK(pthread_create(&consumers[i].thread, NULL, consumer,
+                              &consumers[i]) == 0, "consumer %u", i);
+  }
+
+  /* Cost of the two clock reads around a swap.*/
+  pin(0);
+  t = hostNowNs();
+  for (i = 0; i < 1000U; i++) {
+    (void)hostNowNs();
+  }
+  clock = (hostNowNs() - t) / 1000U;
+
+  for (seq = 1; seq <= SWAPS; seq++) {
+    frame_fill(nbufGetBackX(&nb), seq);
+    t = hostNowNs();
+    nbufSwapBackX(&nb);
+    ns = hostNowNs() - t;
+    total += ns;
+    if (ns > worst) {
+      worst = ns;
+    }
+  }
+  done = true;
+  HOST_CHECK(nbufGetSequenceX(&nb) == SWAPS, "sequence %u after %u swaps",
+             (unsigned)nbufGetSequenceX(&nb), SWAPS);
+
+  for (i = 0; i < CONSUMERS; i++) {
+    consumer_t *c = &consumers[i];
+
+    (void)pthread_join(c->thread, NULL);
+    HOST_CHECK(c->torn == 0U, "consumer %u: %u torn frames of %u", i,
+               c->torn, c->frames);
+    HOST_CHECK(c->mismatched == 0U, "consumer %u: %u frames with another "
+               "sequence number", i, c->mismatched);
+    HOST_CHECK(c->backwards == 0U, "consumer %u: sequence went back %u times",
+               i, c->backwards);
+    seen += c->seen;
+    if (host_bench) {
+      printf("  consumer %u: %u reads, %u new frames\n", i, c->frames,
+             c->seen);
+    }
+  }
+  HOST_CHECK(seen > 0U, "no frame seen by the consumers");
+
+  if (host_bench) {
+    printf("  %u swaps, %.1f ns average, %.1f us worst, clock read "
+           "%u ns\n", SWAPS, (double)total / SWAPS - (double)clock,
+           worst / 1000.0, (unsigned)clock);
+  }
+}
+
+int main(int argc, char *argv[]) {
+
+  hostInit(argc, argv);
+  if (host_bench) {
+    printf("%s: %u consumers, %u buffers of %u bytes, %ld cores\n", argv[0],
+           CONSUMERS, BUFFERS, (unsigned)sizeof(frame_t),
+           sysconf(_SC_NPROCESSORS_ONLN));
+  }
+
+  test_pinned();
+  test_threads();
+
+  return hostReport(argv[0]);
+}
@@ -0,0 +1,165 @@
+/*
+    ChibiOS - Copyright (C) 2006..2018 Giovanni Di Sirio
+
+    Licensed under the Apache License, Version 2.0 (the "License");
+    you may not use this file except in compliance with the License.
+    You may obtain a copy of the License at
+
+        http://www.apache.org/licenses/LICENSE-2.0
+
+    Unless required by applicable law or agreed to in writing, software
+    distributed under the License is distributed on an "AS IS" BASIS,
+    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+    See the License for the specific language governing permissions and
+    limitations under the License.
+*/
+
+#ifndef HAL_H
+#define HAL_H
+
+#include "osal.h"
+
+#define HAL_SUCCESS                         false
+#define HAL_FAILED                          true
+
+#define HAL_USE_ONEWIRE                     TRUE
+#define HAL_USE_PAL                         TRUE
+#define HAL_USE_PWM                         TRUE
+#define HAL_USE_UART                        TRUE
+
+/* The masters are selected by the Makefile.*/
+#if !defined(ONEWIRE_USE_SEARCH_ROM)
+#define ONEWIRE_USE_SEARCH_ROM              TRUE
+#endif
+#if !defined(ONEWIRE_USE_STRONG_PULLUP)
+#define ONEWIRE_USE_STRONG_PULLUP           FALSE
+#endif
+
+struct owsim_bus;
+
+/*===========================================================================*/
+/* PAL subset, the port is the simulated bus.                                */
+/*===========================================================================*/
+
+#define PAL_LOW                             0U
+#define PAL_HIGH                            1U
+
+typedef struct owsim_bus *ioportid_t;
+typedef uint32_t ioportmask_t;
+typedef uint32_t iomode_t;
+typedef uint32_t ioline_t;
+
+#define palSetPadMode(port, pad, mode)                                        ((void)(port), (void)(pad), (void)(mode))
+#define palReadPad(port, pad)               ((void)(pad), owsimReadPad(port))
+
+/*===========================================================================*/
+/* PWM subset, a simulated timer with preloaded compare registers.           */
+/*===========================================================================*/
+
+#define PWM_CHANNELS                        4
+
+#define PWM_OUTPUT_DISABLED                 0x00U
+#define PWM_OUTPUT_ACTIVE_HIGH              0x01U
+#define PWM_OUTPUT_ACTIVE_LOW               0x02U
+
+typedef enum {
+  PWM_UNINIT = 0,
+  PWM_STOP = 1,
+  PWM_READY = 2
+} pwmstate_t;
+
+typedef uint32_t pwmmode_t;
+typedef uint8_t pwmchannel_t;
+typedef uint32_t pwmcnt_t;
+
+typedef struct PWMDriver PWMDriver;
+typedef void (*pwmcallback_t)(PWMDriver *pwmp);
+
+typedef struct {
+  pwmmode_t                 mode;
+  pwmcallback_t             callback;
+} PWMChannelConfig;
+
+typedef struct {
+  uint32_t                  frequency;
+  pwmcnt_t                  period;
+  pwmcallback_t             callback;
+  PWMChannelConfig          channels[PWM_CHANNELS];
+} PWMConfig;
+
+struct PWMDriver {
+  pwmstate_t                state;
+  const PWMConfig           *config;
+  /* Simulated timer.*/
+  struct owsim_bus          *bus;
+  virtual_timer_t           vt;
+  uint64_t                  period_start;
+  pwmcnt_t                  width[PWM_CHANNELS];
+  pwmcnt_t                  preload[PWM_CHANNELS];
+  uint32_t                  notifications;
+  bool                      periodic;
+};
+
+/*===========================================================================*/
+/* UART subset, a simulated UART whose TX and RX are tied to the bus.        */
+/*===========================================================================*/
+
+typedef enum {
+  UART_UNINIT = 0,
+  UART_STOP = 1,
+  UART_READY = 2
+} uartstate_t;
+
+typedef uint32_t uartflags_t;
+
+typedef struct UARTDriver UARTDriver;
+typedef void (*uartcb_t)(UARTDriver *uartp);
+typedef void (*uartccb_t)(UARTDriver *uartp, uint16_t c);
+typedef void (*uartecb_t)(UARTDriver *uartp, uartflags_t e);
+
+typedef struct {
+  uartcb_t                  txend1_cb;
+  uartcb_t                  txend2_cb;
+  uartcb_t                  rxend_cb;
+  uartccb_t                 rxchar_cb;
+  uartecb_t                 rxerr_cb;
+  uint32_t                  speed;
+} UARTConfig;
+
+struct UARTDriver {
+  uartstate_t               state;
+  const UARTConfig          *config;
+  /* Simulated UART.*/
+  struct owsim_bus          *bus;
+  virtual_timer_t           vt;
+  const uint8_t             *txbuf;
+  size_t                    txn;
+  uint8_t                   *rxbuf;
+  size_t                    rxn;
+};
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+  unsigned owsimReadPad(struct owsim_bus *bus);
+  void pwmStart(PWMDriver *pwmp, const PWMConfig *config);
+  void pwmStop(PWMDriver *pwmp);
+  void pwmEnableChannelI(PWMDriver *pwmp, pwmchannel_t channel,
+                         pwmcnt_t width);
+  void pwmDisableChannelI(PWMDriver *pwmp, pwmchannel_t channel);
+  void pwmEnableChannelNotificationI(PWMDriver *pwmp, pwmchannel_t channel);
+  void pwmEnablePeriodicNotificationI(PWMDriver *pwmp);
+  void pwmDisablePeriodicNotification(PWMDriver *pwmp);
+  void uartStart(UARTDriver *uartp, const UARTConfig *config);
+  void uartStop(UARTDriver *uartp);
+  void uartStartSendI(UARTDriver *uartp, size_t n, const void *txbuf);
+  void uartStartReceiveI(UARTDriver *uartp, size_t n, void *rxbuf);
+  size_t uartStopSendI(UARTDriver *uartp);
+  size_t uartStopReceiveI(UARTDriver *uartp);
+#ifdef __cplusplus
+}
+#endif
+
+#include "hal_onewire.h"
+
+#endif /* HAL_H */
@@ -0,0 +1,231 @@
+/*
+    ChibiOS - Copyright (C) 2006..2018 Giovanni Di Sirio
+
+    Licensed under the Apache License, Version 2.0 (the "License");
+    you may not use this file except in compliance with the License.
+    You may obtain a copy of the License at
+
+        http://www.apache.org/licenses/LICENSE-2.0
+
+    Unless required by applicable law or agreed to in writing, software
+    distributed under the License is distributed on an "AS IS" BASIS,
+    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+    See the License for the specific language governing permissions and
+    limitations under the License.
+*/
+
+/*
+ * PWM and UART bus masters over a simulated bus of 40 DS18B20s: presence,
+ * search, READ ROM, then MATCH ROM and READ SCRATCHPAD on every device.
+ * The masters built are selected by the Makefile; with both, the
+ * interrupts per byte and the bus throughput of each are compared.
+ */
+
+#include <string.h>
+
+#include "hal.h"
+#include "host_test.h"
+#include "owsim.h"
+
+/*===========================================================================*/
+/* Helpers.                                                                  */
+/*===========================================================================*/
+
+#define DEVICES                             40U
+#define FAMILY_DS18B20                      0x28U
+
+static owsim_device_t devices[DEVICES];
+static owsim_bus_t bus;
+
+typedef struct {
+  const char                *name;
+  /* Search of the whole bus.*/
+  uint32_t                  search_irqs;
+  uint64_t                  search_us;
+  /* Scratchpad reads, bytes written and read.*/
+  uint32_t                  bytes;
+  uint32_t                  irqs;
+  uint64_t                  us;
+} master_result_t;
+
+#if ONEWIRE_USE_PWM
+static PWMDriver pwmd;
+static PWMConfig pwmcfg;
+static const onewireConfig pwm_owcfg = {
+  &pwmd,
+  &pwmcfg,
+  PWM_OUTPUT_ACTIVE_LOW,
+  0,
+  1,
+  &bus,
+  0,
+  0,
+#if ONEWIRE_USE_UART
+  NULL,
+  NULL
+#endif
+};
+static master_result_t pwm_res = {"PWM", 0, 0, 0, 0, 0};
+#endif
+
+#if ONEWIRE_USE_UART
+static UARTDriver uartd;
+static UARTConfig uartcfg;
+static const onewireConfig uart_owcfg = {
+#if ONEWIRE_USE_PWM
+  NULL,
+  NULL,
+  0,
+  0,
+  0,
+#endif
+  &bus,
+  0,
+  0,
+  &uartd,
+  &uartcfg
+};
+static master_result_t uart_res = {"UART", 0, 0, 0, 0, 0};
+#endif
+
+static void attach_all(bool attached) {
+  unsigned i;
+
+  for (i = 0; i < DEVICES; i++) {
+    devices[i].attached = attached;
+  }
+}
+
+static const owsim_device_t *find_device(const uint8_t *rom) {
+  unsigned i;
+
+  for (i = 0; i < DEVICES; i++) {
+    if (memcmp(devices[i].rom, rom, 8) == 0) {
+      return &devices[i];
+    }
+  }
+  return NULL;
+}
+
+/*===========================================================================*/
+/* Tests.                                                                    */
+/*===========================================================================*/
+
+static void test_master(onewireDriver *owp, const onewireConfig *cfg,
+                        master_result_t *res) {
+  static uint8_t roms[(DEVICES + 1U) * 8U];
+  uint8_t buf[12], found[DEVICES];
+  const owsim_device_t *dev;
+  const char *name = res->name;
+  uint32_t irqs;
+  uint64_t start;
+  size_t n, i;
+
+  onewireObjectInit(owp);
+  onewireStart(owp, cfg);
+
+  /* Empty bus.*/
+  attach_all(false);
+  HOST_CHECK(!onewireReset(owp), "%s: presence on an empty bus", name);
+  HOST_CHECK(onewireSearchRom(owp, roms, DEVICES) == 0U,
+             "%s: ROMs found on an empty bus", name);
+  attach_all(true);
+  HOST_CHECK(onewireReset(owp), "%s: no presence", name);
+
+  /* Every device found once.*/
+  irqs = owsim_irqs;
+  start = chVTGetTimeStampX();
+  n = onewireSearchRom(owp, roms, DEVICES + 1U);
+  res->search_irqs = owsim_irqs - irqs;
+  res->search_us = chVTGetTimeStampX() - start;
+  HOST_CHECK(n == DEVICES, "%s: %u ROMs found", name, (unsigned)n);
+  memset(found, 0, sizeof(found));
+  for (i = 0; (i < n) && (i < DEVICES); i++) {
+    dev = find_device(&roms[i * 8U]);
+    HOST_CHECK((dev != NULL) && (found[dev - devices]++ == 0U),
+               "%s: ROM %u unknown or found twice", name, (unsigned)i);
+  }
+
+  /* READ ROM with a single device, a read longer than the UART buffer.*/
+  attach_all(false);
+  devices[7].attached = true;
+  HOST_CHECK(onewireReset(owp), "%s: no presence", name);
+  buf[0] = ONEWIRE_CMD_READ_ROM;
+  onewireWrite(owp, buf, 1, 0);
+  onewireRead(owp, buf, 12);
+  HOST_CHECK(memcmp(buf, devices[7].rom, 8) == 0, "%s: READ ROM", name);
+  HOST_CHECK((buf[8] == 0xFFU) && (buf[11] == 0xFFU),
+             "%s: bus not released after the ROM", name);
+  attach_all(true);
+
+  /* Scratchpads, MATCH ROM + READ SCRATCHPAD then 9 bytes.*/
+  irqs = owsim_irqs;
+  start = chVTGetTimeStampX();
+  res->bytes = 0;
+  for (i = 0; i < DEVICES; i++) {
+    HOST_CHECK(onewireReset(owp), "%s: no presence", name);
+    buf[0] = ONEWIRE_CMD_MATCH_ROM;
+    memcpy(&buf[1], devices[i].rom, 8);
+    buf[9] = ONEWIRE_CMD_READ_SCRATCHPAD;
+    onewireWrite(owp, buf, 10, 0);
+    onewireRead(owp, buf, OWSIM_SCRATCHPAD_LEN);
+    HOST_CHECK(memcmp(buf, devices[i].scratchpad, OWSIM_SCRATCHPAD_LEN) == 0,
+               "%s: scratchpad %u", name, (unsigned)i);
+    HOST_CHECK(onewireCRC(buf, 8) == buf[8], "%s: scratchpad CRC", name);
+    res->bytes += 10U + OWSIM_SCRATCHPAD_LEN;
+  }
+  res->irqs = owsim_irqs - irqs;
+  res->us = chVTGetTimeStampX() - start;
+
+  onewireStop(owp);
+
+  if (host_bench) {
+    printf("  %-4s search %u ROMs: %5u irqs %4.0f ms, scratchpads: "
+           "%5.2f irqs/byte %5.0f bytes/s\n", name, DEVICES,
+           res->search_irqs, res->search_us / 1000.0,
+           (double)res->irqs / res->bytes, res->bytes * 1e6 / res->us);
+  }
+}
+
+int main(int argc, char *argv[]) {
+  unsigned i;
+
+  hostInit(argc, argv);
+  chSysInit();
+
+  for (i = 0; i < DEVICES; i++) {
+    owsimDeviceInit(&devices[i], FAMILY_DS18B20, (uint16_t)i);
+  }
+  owsimBusInit(&bus, devices, DEVICES);
+  if (host_bench) {
+    printf("%s: %u DS18B20s\n", argv[0], DEVICES);
+  }
+
+#if ONEWIRE_USE_PWM
+  pwmd.state = PWM_STOP;
+  pwmd.bus = &bus;
+  chVTObjectInit(&pwmd.vt);
+  test_master(&OWD1, &pwm_owcfg, &pwm_res);
+#endif
+
+#if ONEWIRE_USE_UART
+  uartd.state = UART_STOP;
+  uartd.bus = &bus;
+  chVTObjectInit(&uartd.vt);
+  test_master(&OWD1, &uart_owcfg, &uart_res);
+#endif
+
+#if ONEWIRE_USE_PWM && ONEWIRE_USE_UART
+  /* A byte takes 8 interrupts or more with the PWM, one transfer of up
+     to ONEWIRE_UART_BUFFER_BYTES with the UART.*/
+  HOST_CHECK((double)pwm_res.irqs / pwm_res.bytes >= 8.0,
+             "PWM: %u irqs for %u bytes", pwm_res.irqs, pwm_res.bytes);
+  HOST_CHECK(uart_res.irqs * 8U < pwm_res.irqs,
+             "UART: %u irqs, PWM: %u irqs", uart_res.irqs, pwm_res.irqs);
+  HOST_CHECK(uart_res.search_irqs < pwm_res.search_irqs,
+             "search, UART: %u irqs, PWM: %u irqs", uart_res.search_irqs,
+             pwm_res.search_irqs);
+#endif
+
+  return hostReport(argv[0]);
+}
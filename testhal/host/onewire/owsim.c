@@ -0,0 +1,532 @@
+/*
+    ChibiOS - Copyright (C) 2006..2018 Giovanni Di Sirio
+
+    Licensed under the Apache License, Version 2.0 (the "License");
+    you may not use this file except in compliance with the License.
+    You may obtain a copy of the License at
+
+        http://www.apache.org/licenses/LICENSE-2.0
+
+    Unless required by applicable law or agreed to in writing, software
+    distributed under the License is distributed on an "AS IS" BASIS,
+    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+    See the License for the specific language governing permissions and
+    limitations under the License.
+*/
+
+/*
+ * Simulated 1-Wire bus shared by the onewire host tests: DS18B20-like
+ * devices answering at the time slot level, and the PWM and UART
+ * peripherals of the two bus masters, timed by the emulated RT kernel.
+ */
+
+#include <string.h>
+
+#include "hal.h"
+#include "host_test.h"
+#include "owsim.h"
+
+uint32_t owsim_irqs;
+
+/*===========================================================================*/
+/* Simulated devices.                                                        */
+/*===========================================================================*/
+
+/* Slot timings in microseconds, one tick each.*/
+#define RESET_LOW                           480U
+#define PRESENCE_DELAY                      30U
+#define PRESENCE_LOW                        120U
+#define ZERO_LOW                            60U
+#define ONE_LOW                             6U
+#define SLAVE_LOW                           30U
+
+typedef enum {
+  DEV_IDLE,
+  DEV_ROM_CMD,
+  DEV_MATCH_ROM,
+  DEV_SEARCH,
+  DEV_FUNC_CMD,
+  DEV_SEND,
+  DEV_CONVERT
+} dev_state_t;
+
+uint8_t owsimCRC(const uint8_t *buf, size_t len) {
+  uint8_t crc = 0;
+  unsigned i;
+
+  while (len-- > 0U) {
+    crc ^= *buf++;
+    for (i = 0; i < 8U; i++) {
+      crc = (crc & 1U) ? (uint8_t)((crc >> 1) ^ 0x8CU) : (uint8_t)(crc >> 1);
+    }
+  }
+  return crc;
+}
+
+static unsigned rom_bit(const owsim_device_t *dev, unsigned bit) {
+
+  return (dev->rom[bit / 8U] >> (bit % 8U)) & 1U;
+}
+
+static void dev_send(owsim_device_t *dev, const uint8_t *tx, unsigned len,
+                     dev_state_t next) {
+
+  dev->state = DEV_SEND;
+  dev->next = next;
+  dev->tx = tx;
+  dev->txbits = len * 8U;
+  dev->bit = 0;
+}
+
+/* Level driven in a read slot, 0 pulls the bus low.*/
+static unsigned dev_drive(const owsim_device_t *dev, uint64_t start) {
+
+  switch (dev->state) {
+  case DEV_SEARCH:
+    if (dev->step < 2U) {
+      return rom_bit(dev, dev->bit) ^ dev->step;
+    }
+    return 1U;
+  case DEV_SEND:
+    return (dev->tx[dev->bit / 8U] >> (dev->bit % 8U)) & 1U;
+  case DEV_CONVERT:
+    return start >= dev->convert_end ? 1U : 0U;
+  default:
+    return 1U;
+  }
+}
+
+/* Command byte received LSB first, true once complete.*/
+static bool dev_shift(owsim_device_t *dev, unsigned bit) {
+
+  dev->shift = (uint8_t)((dev->shift >> 1) | (bit << 7));
+  return ++dev->bit == 8U;
+}
+
+static void dev_sample(owsim_device_t *dev, unsigned bit, uint64_t start) {
+
+  switch (dev->state) {
+  case DEV_ROM_CMD:
+    if (!dev_shift(dev, bit)) {
+      break;
+    }
+    dev->bit = 0;
+    dev->step = 0;
+    switch (dev->shift) {
+    case ONEWIRE_CMD_READ_ROM:
+      dev_send(dev, dev->rom, 8, DEV_FUNC_CMD);
+      break;
+    case ONEWIRE_CMD_MATCH_ROM:
+      dev->state = DEV_MATCH_ROM;
+      break;
+    case ONEWIRE_CMD_SKIP_ROM:
+      dev->state = DEV_FUNC_CMD;
+      break;
+    case ONEWIRE_CMD_ALARM_SEARCH:
+      dev->state = dev->alarm ? DEV_SEARCH : DEV_IDLE;
+      break;
+    case ONEWIRE_CMD_SEARCH_ROM:
+      dev->state = DEV_SEARCH;
+      break;
+    default:
+      dev->state = DEV_IDLE;
+      break;
+    }
+    break;
+  case DEV_MATCH_ROM:
+    if (bit != rom_bit(dev, dev->bit)) {
+      dev->state = DEV_IDLE;
+    }
+    else if (++dev->bit == 64U) {
+      dev->bit = 0;
+      dev->state = DEV_FUNC_CMD;
+    }
+    break;
+  case DEV_SEARCH:
+    if (dev->step < 2U) {
+      dev->step++;
+      break;
+    }
+    dev->step = 0;
+    if (bit != rom_bit(dev, dev->bit)) {
+      dev->state = DEV_IDLE;
+    }
+    else if (++dev->bit == 64U) {
+      dev->bit = 0;
+      dev->state = DEV_FUNC_CMD;
+    }
+    break;
+  case DEV_FUNC_CMD:
+    if (!dev_shift(dev, bit)) {
+      break;
+    }
+    if (dev->shift == ONEWIRE_CMD_READ_SCRATCHPAD) {
+      if (dev->bad_reads > 0U) {
+        dev->bad_reads--;
+        memcpy(dev->bad, dev->scratchpad, OWSIM_SCRATCHPAD_LEN);
+        dev->bad[0] ^= 0x01U;
+        dev_send(dev, dev->bad, OWSIM_SCRATCHPAD_LEN, DEV_IDLE);
+      }
+      else {
+        dev_send(dev, dev->scratchpad, OWSIM_SCRATCHPAD_LEN, DEV_IDLE);
+      }
+    }
+    else if (dev->shift == ONEWIRE_CMD_CONVERT_TEMP) {
+      /* Read slots return 0 until the end of the conversion.*/
+      dev->convert_end = start + dev->convert_time;
+      dev->state = DEV_CONVERT;
+    }
+    else {
+      /* Other commands are ignored.*/
+      dev->state = DEV_IDLE;
+    }
+    break;
+  case DEV_SEND:
+    if (++dev->bit == dev->txbits) {
+      dev->bit = 0;
+      dev->state = dev->next;
+    }
+    break;
+  default:
+    break;
+  }
+}
+
+/**
+ * @brief   Makes a device with a random serial number and temperature.
+ * @details @p id goes in the first serial number bytes, so that devices
+ *          made with different ids differ.
+ */
+void owsimDeviceInit(owsim_device_t *dev, uint8_t family, uint16_t id) {
+  unsigned i;
+  int16_t temp;
+
+  memset(dev, 0, sizeof(*dev));
+  dev->rom[0] = family;
+  dev->rom[1] = (uint8_t)id;
+  dev->rom[2] = (uint8_t)(id >> 8);
+  for (i = 3; i < 7U; i++) {
+    dev->rom[i] = (uint8_t)hostRand();
+  }
+  dev->rom[7] = owsimCRC(dev->rom, 7);
+
+  /* -55..125 C in 1/16 C.*/
+  temp = (int16_t)((int32_t)(hostRand() % (180U * 16U)) - 55 * 16);
+  dev->scratchpad[0] = (uint8_t)temp;
+  dev->scratchpad[1] = (uint8_t)((uint16_t)temp >> 8);
+  dev->scratchpad[2] = 0x4B;
+  dev->scratchpad[3] = 0x46;
+  dev->scratchpad[4] = 0x7F;
+  dev->scratchpad[5] = 0xFF;
+  dev->scratchpad[6] = 0x0C;
+  dev->scratchpad[7] = 0x10;
+  dev->scratchpad[8] = owsimCRC(dev->scratchpad, 8);
+  dev->attached = true;
+}
+
+void owsimBusInit(owsim_bus_t *bus, owsim_device_t *devices, size_t count) {
+
+  memset(bus, 0, sizeof(*bus));
+  bus->devices = devices;
+  bus->count = count;
+}
+
+/**
+ * @brief   Reset pulse.
+ *
+ * @param[in] bus       simulated bus
+ * @param[in] start     start of the pulse, in ticks
+ * @return              true when a device sent a presence pulse.
+ */
+bool owsimReset(owsim_bus_t *bus, uint64_t start) {
+  bool presence = false;
+  size_t i;
+
+  bus->resets++;
+  for (i = 0; i < bus->count; i++) {
+    owsim_device_t *dev = &bus->devices[i];
+
+    dev->state = dev->attached ? DEV_ROM_CMD : DEV_IDLE;
+    dev->bit = 0;
+    presence |= dev->attached;
+  }
+  bus->master_from = start;
+  bus->master_until = start + RESET_LOW;
+  bus->slave_from = bus->master_until + PRESENCE_DELAY;
+  bus->slave_until = presence ? bus->slave_from + PRESENCE_LOW : 0U;
+  return presence;
+}
+
+/**
+ * @brief   Time slot.
+ *
+ * @param[in] bus       simulated bus
+ * @param[in] start     start of the slot, in ticks
+ * @param[in] bit       bit written by the master, 1 for a read slot
+ * @return              Level of the bus, read by the master and the devices.
+ */
+unsigned owsimSlot(owsim_bus_t *bus, uint64_t start, unsigned bit) {
+  unsigned level = bit;
+  size_t i;
+
+  bus->slots++;
+  for (i = 0; i < bus->count; i++) {
+    if (bus->devices[i].attached && (bus->devices[i].state != DEV_IDLE)) {
+      level &= dev_drive(&bus->devices[i], start);
+    }
+  }
+  for (i = 0; i < bus->count; i++) {
+    if (bus->devices[i].attached && (bus->devices[i].state != DEV_IDLE)) {
+      dev_sample(&bus->devices[i], level, start);
+    }
+  }
+  bus->master_from = start;
+  bus->master_until = start + (bit ? ONE_LOW : ZERO_LOW);
+  bus->slave_from = start;
+  bus->slave_until = (bit && !level) ? start + SLAVE_LOW : 0U;
+  return level;
+}
+
+unsigned owsimReadPad(owsim_bus_t *bus) {
+  const uint64_t now = chVTGetTimeStampX();
+
+  if (((now >= bus->master_from) && (now < bus->master_until)) ||
+      ((now >= bus->slave_from) && (now < bus->slave_until))) {
+    return PAL_LOW;
+  }
+  return PAL_HIGH;
+}
+
+/*===========================================================================*/
+/* Simulated PWM.                                                            */
+/*===========================================================================*/
+
+/*
+ * A 1 MHz up-counting timer with preloaded compare registers: the widths
+ * set by pwmEnableChannelI() are taken at the next period. A channel
+ * with an output starts a time slot when its period starts, a reset
+ * pulse for widths of 480us and more, a write 0 slot for 15us and more,
+ * a read slot otherwise.
+ */
+
+static void pwm_timer_cb(void *p);
+
+static void pwm_schedule_i(PWMDriver *pwmp) {
+  const pwmcnt_t offset = (pwmcnt_t)(chVTGetTimeStampX() - pwmp->period_start);
+  pwmcnt_t next = pwmp->config->period;
+  unsigned ch;
+
+  for (ch = 0; ch < PWM_CHANNELS; ch++) {
+    if ((pwmp->notifications & (1U << ch)) && (pwmp->width[ch] > offset) &&
+        (pwmp->width[ch] < next)) {
+      next = pwmp->width[ch];
+    }
+  }
+  chVTSetI(&pwmp->vt, next - offset, pwm_timer_cb, pwmp);
+}
+
+static void pwm_timer_cb(void *p) {
+  PWMDriver *pwmp = p;
+  pwmcnt_t offset = (pwmcnt_t)(chVTGetTimeStampX() - pwmp->period_start);
+  unsigned ch;
+
+  if (offset >= pwmp->config->period) {
+    /* Update event.*/
+    pwmp->period_start = chVTGetTimeStampX();
+    offset = 0;
+    memcpy(pwmp->width, pwmp->preload, sizeof(pwmp->width));
+    for (ch = 0; ch < PWM_CHANNELS; ch++) {
+      if ((pwmp->config->channels[ch].mode != PWM_OUTPUT_DISABLED) &&
+          (pwmp->width[ch] > 0U)) {
+        if (pwmp->width[ch] >= RESET_LOW) {
+          (void)owsimReset(pwmp->bus, pwmp->period_start);
+        }
+        else {
+          (void)owsimSlot(pwmp->bus, pwmp->period_start,
+                          pwmp->width[ch] < 15U);
+        }
+      }
+    }
+    if (pwmp->periodic && (pwmp->config->callback != NULL)) {
+      owsim_irqs++;
+      pwmp->config->callback(pwmp);
+    }
+  }
+  else {
+    for (ch = 0; ch < PWM_CHANNELS; ch++) {
+      if ((pwmp->notifications & (1U << ch)) && (pwmp->width[ch] == offset) &&
+          (pwmp->config->channels[ch].callback != NULL)) {
+        owsim_irqs++;
+        pwmp->config->channels[ch].callback(pwmp);
+      }
+    }
+  }
+
+  chSysLockFromISR();
+  if (pwmp->state == PWM_READY) {
+    pwm_schedule_i(pwmp);
+  }
+  chSysUnlockFromISR();
+}
+
+void pwmStart(PWMDriver *pwmp, const PWMConfig *config) {
+
+  osalDbgCheck((pwmp->bus != NULL) &&
+               (config->frequency == CH_CFG_ST_FREQUENCY));
+
+  osalSysLock();
+  pwmp->config = config;
+  pwmp->state = PWM_READY;
+  pwmp->period_start = chVTGetTimeStampX();
+  memset(pwmp->width, 0, sizeof(pwmp->width));
+  memset(pwmp->preload, 0, sizeof(pwmp->preload));
+  pwmp->notifications = 0;
+  pwmp->periodic = false;
+  pwm_schedule_i(pwmp);
+  osalSysUnlock();
+}
+
+void pwmStop(PWMDriver *pwmp) {
+  const uint64_t now = chVTGetTimeStampX();
+
+  osalSysLock();
+  /* The output is released, not the slaves.*/
+  if ((pwmp->state == PWM_READY) && (pwmp->bus->master_until > now)) {
+    pwmp->bus->master_until = now;
+  }
+  chVTResetI(&pwmp->vt);
+  pwmp->state = PWM_STOP;
+  osalSysUnlock();
+}
+
+void pwmEnableChannelI(PWMDriver *pwmp, pwmchannel_t channel,
+                       pwmcnt_t width) {
+
+  osalDbgCheck(channel < PWM_CHANNELS);
+  pwmp->preload[channel] = width;
+}
+
+void pwmDisableChannelI(PWMDriver *pwmp, pwmchannel_t channel) {
+
+  osalDbgCheck(channel < PWM_CHANNELS);
+  pwmp->preload[channel] = 0;
+  pwmp->notifications &= ~(1U << channel);
+}
+
+void pwmEnableChannelNotificationI(PWMDriver *pwmp, pwmchannel_t channel) {
+
+  osalDbgCheck(channel < PWM_CHANNELS);
+  pwmp->notifications |= 1U << channel;
+  pwm_schedule_i(pwmp);
+}
+
+void pwmEnablePeriodicNotificationI(PWMDriver *pwmp) {
+
+  pwmp->periodic = true;
+}
+
+void pwmDisablePeriodicNotification(PWMDriver *pwmp) {
+
+  osalSysLock();
+  pwmp->periodic = false;
+  osalSysUnlock();
+}
+
+/*===========================================================================*/
+/* Simulated UART.                                                           */
+/*===========================================================================*/
+
+/*
+ * Every character sent is a time slot on the bus and is received back,
+ * 10 bits long. The transfer completes at the end of the last character,
+ * one TX and one RX DMA interrupt. 0xF0 at 9600 baud is a reset pulse,
+ * received back with the high bits cleared by a presence pulse.
+ */
+
+static uint64_t uart_time(const UARTDriver *uartp, size_t n) {
+
+  return ((uint64_t)n * 10U * 1000000U + uartp->config->speed - 1U) /
+         uartp->config->speed;
+}
+
+static void uart_timer_cb(void *p) {
+  UARTDriver *uartp = p;
+  const uint64_t start = chVTGetTimeStampX() - uart_time(uartp, uartp->txn);
+  size_t i;
+  uint8_t c;
+
+  for (i = 0; i < uartp->txn; i++) {
+    const uint64_t t = start + uart_time(uartp, i);
+
+    c = uartp->txbuf[i];
+    if (uartp->config->speed < 20000U) {
+      c = (c == 0xF0U) && owsimReset(uartp->bus, t) ? 0xE0U : c;
+    }
+    else if (c == 0xFFU) {
+      c = owsimSlot(uartp->bus, t, 1U) ? 0xFFU : 0xFCU;
+    }
+    else {
+      c = owsimSlot(uartp->bus, t, 0U) ? c : 0x00U;
+    }
+    if (i < uartp->rxn) {
+      uartp->rxbuf[i] = c;
+    }
+  }
+  uartp->txn = 0;
+  owsim_irqs += 2U;
+  if (uartp->rxn > 0U) {
+    uartp->rxn = 0;
+    if (uartp->config->rxend_cb != NULL) {
+      uartp->config->rxend_cb(uartp);
+    }
+  }
+}
+
+void uartStart(UARTDriver *uartp, const UARTConfig *config) {
+
+  osalDbgCheck((uartp->bus != NULL) && (config->speed > 0U));
+
+  osalSysLock();
+  uartp->config = config;
+  uartp->state = UART_READY;
+  osalSysUnlock();
+}
+
+void uartStop(UARTDriver *uartp) {
+
+  osalSysLock();
+  chVTResetI(&uartp->vt);
+  uartp->state = UART_STOP;
+  osalSysUnlock();
+}
+
+void uartStartSendI(UARTDriver *uartp, size_t n, const void *txbuf) {
+
+  osalDbgCheck((uartp->state == UART_READY) && (n > 0U));
+  uartp->txbuf = txbuf;
+  uartp->txn = n;
+  chVTSetI(&uartp->vt, (sysinterval_t)uart_time(uartp, n), uart_timer_cb,
+           uartp);
+}
+
+void uartStartReceiveI(UARTDriver *uartp, size_t n, void *rxbuf) {
+
+  osalDbgCheck(uartp->state == UART_READY);
+  uartp->rxbuf = rxbuf;
+  uartp->rxn = n;
+}
+
+size_t uartStopSendI(UARTDriver *uartp) {
+  size_t n = uartp->txn;
+
+  chVTResetI(&uartp->vt);
+  uartp->txn = 0;
+  return n;
+}
+
+size_t uartStopReceiveI(UARTDriver *uartp) {
+  size_t n = uartp->rxn;
+
+  uartp->rxn = 0;
+  return n;
+}
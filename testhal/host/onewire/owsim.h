@@ -0,0 +1,88 @@
+/*
+    ChibiOS - Copyright (C) 2006..2018 Giovanni Di Sirio
+
+    Licensed under the Apache License, Version 2.0 (the "License");
+    you may not use this file except in compliance with the License.
+    You may obtain a copy of the License at
+
+        http://www.apache.org/licenses/LICENSE-2.0
+
+    Unless required by applicable law or agreed to in writing, software
+    distributed under the License is distributed on an "AS IS" BASIS,
+    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+    See the License for the specific language governing permissions and
+    limitations under the License.
+*/
+
+/*
+ * Simulated 1-Wire bus shared by the onewire host tests: DS18B20-like
+ * devices answering at the time slot level, and the PWM and UART
+ * peripherals of the two bus masters, timed by the emulated RT kernel.
+ */
+
+#ifndef OWSIM_H
+#define OWSIM_H
+
+#define OWSIM_SCRATCHPAD_LEN                9U
+
+/**
+ * @brief   Simulated device.
+ */
+typedef struct {
+  uint8_t                   rom[8];
+  uint8_t                   scratchpad[OWSIM_SCRATCHPAD_LEN];
+  /* Takes part in ALARM SEARCH.*/
+  bool                      alarm;
+  /* Answers on the bus.*/
+  bool                      attached;
+  /* Temperature conversion time in ticks, 0 for instant.*/
+  uint32_t                  convert_time;
+  uint64_t                  convert_end;
+  /* Next scratchpad reads sent with a bad CRC.*/
+  unsigned                  bad_reads;
+  uint8_t                   bad[OWSIM_SCRATCHPAD_LEN];
+  /* Protocol state.*/
+  uint8_t                   state;
+  uint8_t                   next;
+  uint8_t                   shift;
+  uint8_t                   step;
+  unsigned                  bit;
+  const uint8_t             *tx;
+  unsigned                  txbits;
+} owsim_device_t;
+
+/**
+ * @brief   Simulated bus, also the PAL port of the masters.
+ */
+struct owsim_bus {
+  owsim_device_t            *devices;
+  size_t                    count;
+  /* Line held low by the master and by the slaves, in ticks.*/
+  uint64_t                  master_from;
+  uint64_t                  master_until;
+  uint64_t                  slave_from;
+  uint64_t                  slave_until;
+  /* Reset pulses and time slots seen.*/
+  uint32_t                  resets;
+  uint32_t                  slots;
+};
+
+typedef struct owsim_bus owsim_bus_t;
+
+/* Interrupts taken by the simulated PWM and UART.*/
+extern uint32_t owsim_irqs;
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+  void owsimDeviceInit(owsim_device_t *dev, uint8_t family, uint16_t id);
+  void owsimBusInit(owsim_bus_t *bus, owsim_device_t *devices, size_t count);
+  bool owsimReset(owsim_bus_t *bus, uint64_t start);
+  unsigned owsimSlot(owsim_bus_t *bus, uint64_t start, unsigned bit);
+  unsigned owsimReadPad(owsim_bus_t *bus);
+  uint8_t owsimCRC(const uint8_t *buf, size_t len);
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* OWSIM_H */
@@ -0,0 +1,342 @@
+/*
+    ChibiOS - Copyright (C) 2006..2018 Giovanni Di Sirio
+
+    Licensed under the Apache License, Version 2.0 (the "License");
+    you may not use this file except in compliance with the License.
+    You may obtain a copy of the License at
+
+        http://www.apache.org/licenses/LICENSE-2.0
+
+    Unless required by applicable law or agreed to in writing, software
+    distributed under the License is distributed on an "AS IS" BASIS,
+    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+    See the License for the specific language governing permissions and
+    limitations under the License.
+*/
+
+/*
+ * Searches and ROM cache over a simulated bus of 300 devices, 240 of
+ * family 0x28 and 60 of family 0x10: full search, family and alarm
+ * searches, presence checks, and cache steps across hot-plug rounds with
+ * other searches in between. The costs are counted in time slots and
+ * reset pulses on the bus.
+ */
+
+#include <string.h>
+
+#include "hal.h"
+#include "host_test.h"
+#include "owsim.h"
+
+/*===========================================================================*/
+/* Helpers.                                                                  */
+/*===========================================================================*/
+
+#define DEVICES                             300U
+#define FAMILY_A                            0x28U
+#define FAMILY_B                            0x10U
+#define FAMILY_B_DEVICES                    60U
+#define FAMILY_NONE                         0x22U
+#define ALARMS                              5U
+#define HOTPLUG_ROUNDS                      20U
+
+/* Largest buffer accepted by the whole searches.*/
+#define SEARCH_MAX                          256U
+
+static owsim_device_t devices[DEVICES];
+static owsim_bus_t bus;
+static uint8_t roms[DEVICES * 8U];
+
+#if ONEWIRE_USE_PWM
+static PWMDriver pwmd;
+static PWMConfig pwmcfg;
+static const onewireConfig pwm_owcfg = {
+  &pwmd,
+  &pwmcfg,
+  PWM_OUTPUT_ACTIVE_LOW,
+  0,
+  1,
+  &bus,
+  0,
+  0,
+#if ONEWIRE_USE_UART
+  NULL,
+  NULL
+#endif
+};
+#endif
+
+#if ONEWIRE_USE_UART
+static UARTDriver uartd;
+static UARTConfig uartcfg;
+static const onewireConfig uart_owcfg = {
+#if ONEWIRE_USE_PWM
+  NULL,
+  NULL,
+  0,
+  0,
+  0,
+#endif
+  &bus,
+  0,
+  0,
+  &uartd,
+  &uartcfg
+};
+#endif
+
+typedef struct {
+  uint32_t                  slots;
+  uint32_t                  resets;
+} bus_cost_t;
+
+static bus_cost_t cost_start(void) {
+  bus_cost_t c = {bus.slots, bus.resets};
+
+  return c;
+}
+
+static void cost_end(bus_cost_t *c) {
+
+  c->slots = bus.slots - c->slots;
+  c->resets = bus.resets - c->resets;
+}
+
+static void print_cost(const char *master, const char *what, bus_cost_t c) {
+
+  if (host_bench) {
+    printf("  %-4s %-26s %6u slots %4u resets\n", master, what, c.slots,
+           c.resets);
+  }
+}
+
+/* Search order: the 0-branch first, from the least significant bit.*/
+static int rom_cmp(const uint8_t *a, const uint8_t *b) {
+  unsigned i, bit;
+
+  for (i = 0; i < 64U; i++) {
+    bit = 1U << (i % 8U);
+    if ((a[i / 8U] & bit) != (b[i / 8U] & bit)) {
+      return (a[i / 8U] & bit) ? 1 : -1;
+    }
+  }
+  return 0;
+}
+
+/* Checks that @p found holds, in search order, the ROMs of the attached
+   devices selected by @p family (negative for any) and @p alarm.*/
+static bool check_roms(const uint8_t *found, size_t n, int family,
+                       bool alarm) {
+  size_t i, expected = 0;
+
+  for (i = 0; i < DEVICES; i++) {
+    const owsim_device_t *dev = &devices[i];
+    size_t j;
+
+    if (!dev->attached || ((family >= 0) && (dev->rom[0] != family)) ||
+        (alarm && !dev->alarm)) {
+      continue;
+    }
+    expected++;
+    for (j = 0; j < n; j++) {
+      if (memcmp(&found[j * 8U], dev->rom, 8) == 0) {
+        break;
+      }
+    }
+    if (j == n) {
+      return false;
+    }
+  }
+  for (i = 1; i < n; i++) {
+    if (rom_cmp(&found[(i - 1U) * 8U], &found[i * 8U]) >= 0) {
+      return false;
+    }
+  }
+  return n == expected;
+}
+
+/*===========================================================================*/
+/* Tests.                                                                    */
+/*===========================================================================*/
+
+static void test_searches(onewireDriver *owp, const char *name) {
+  search_rom_result_t res;
+  bus_cost_t c;
+  size_t n;
+  unsigned i;
+
+  /* Full search, one pass per device.*/
+  c = cost_start();
+  onewireSearchBegin(owp, ONEWIRE_CMD_SEARCH_ROM, -1);
+  n = 0;
+  do {
+    res = onewireSearchNext(owp, &roms[(n < DEVICES ? n : DEVICES - 1U) * 8U]);
+    if ((res == ONEWIRE_SEARCH_ROM_SUCCESS) ||
+        (res == ONEWIRE_SEARCH_ROM_LAST)) {
+      n++;
+    }
+  } while (res == ONEWIRE_SEARCH_ROM_SUCCESS);
+  cost_end(&c);
+  HOST_CHECK(res == ONEWIRE_SEARCH_ROM_LAST, "%s: search ended with %d",
+             name, (int)res);
+  HOST_CHECK(check_roms(roms, n, -1, false), "%s: %u ROMs found", name,
+             (unsigned)n);
+  HOST_CHECK(c.resets == DEVICES, "%s: %u resets", name, c.resets);
+  print_cost(name, "full search", c);
+
+  /* The whole search only counts past the buffer.*/
+  HOST_CHECK(onewireSearchRom(owp, roms, SEARCH_MAX) == DEVICES,
+             "%s: onewireSearchRom()", name);
+
+  /* Family searches go straight to the family.*/
+  c = cost_start();
+  n = onewireSearchFamily(owp, FAMILY_B, roms, SEARCH_MAX);
+  cost_end(&c);
+  HOST_CHECK(check_roms(roms, n, FAMILY_B, false), "%s: %u ROMs of family",
+             name, (unsigned)n);
+  HOST_CHECK(c.resets <= FAMILY_B_DEVICES + 1U, "%s: %u resets", name,
+             c.resets);
+  print_cost(name, "family, 60 devices", c);
+
+  c = cost_start();
+  n = onewireSearchFamily(owp, FAMILY_NONE, roms, SEARCH_MAX);
+  cost_end(&c);
+  HOST_CHECK((n == 0U) && (c.resets == 1U), "%s: %u ROMs, %u resets", name,
+             (unsigned)n, c.resets);
+  print_cost(name, "family, 0 devices", c);
+
+  /* Alarm search, only the devices in alarm answer.*/
+  for (i = 0; i < ALARMS; i++) {
+    devices[hostRand() % DEVICES].alarm = true;
+  }
+  c = cost_start();
+  n = onewireAlarmSearch(owp, roms, SEARCH_MAX);
+  cost_end(&c);
+  HOST_CHECK(check_roms(roms, n, -1, true), "%s: %u ROMs in alarm", name,
+             (unsigned)n);
+  HOST_CHECK(c.resets == n, "%s: %u resets", name, c.resets);
+  print_cost(name, "alarm search", c);
+  for (i = 0; i < DEVICES; i++) {
+    devices[i].alarm = false;
+  }
+  HOST_CHECK(onewireAlarmSearch(owp, roms, SEARCH_MAX) == 0U,
+             "%s: ROMs in alarm", name);
+
+  /* Presence checks, present then unplugged.*/
+  i = hostRand() % DEVICES;
+  c = cost_start();
+  HOST_CHECK(onewireVerifyRom(owp, devices[i].rom), "%s: device %u absent",
+             name, i);
+  cost_end(&c);
+  HOST_CHECK(c.resets == 1U, "%s: %u resets", name, c.resets);
+  print_cost(name, "verify one ROM", c);
+  devices[i].attached = false;
+  HOST_CHECK(!onewireVerifyRom(owp, devices[i].rom), "%s: device %u present",
+             name, i);
+  devices[i].attached = true;
+}
+
+/* Steps until a scan started after the last bus change has completed.*/
+static void cache_rescan(onewireDriver *owp, onewireRomCache *cache,
+                         bus_cost_t *step) {
+  unsigned scans = cache->scanning ? 2U : 1U;
+
+  while (scans > 0U) {
+    bus_cost_t c = cost_start();
+
+    (void)onewireCacheStep(owp, cache);
+    cost_end(&c);
+    if (c.resets > step->resets) {
+      *step = c;
+    }
+    if (!cache->scanning) {
+      scans--;
+    }
+  }
+}
+
+static void test_cache(onewireDriver *owp, const char *name) {
+  static uint8_t cache_roms[(DEVICES + 8U) * 8U];
+  onewireRomCache cache;
+  bus_cost_t step = {0, 0};
+  unsigned round, i, j;
+
+  onewireCacheObjectInit(&cache, cache_roms, DEVICES + 8U);
+  cache_rescan(owp, &cache, &step);
+  HOST_CHECK(check_roms(cache.roms, cache.count, -1, false),
+             "%s: cache after the first scan", name);
+
+  for (round = 0; round < HOTPLUG_ROUNDS; round++) {
+    /* Part of a scan, a few devices plugged or unplugged, other searches
+       on the same driver.*/
+    for (i = hostRand() % DEVICES; i > 0U; i--) {
+      (void)onewireCacheStep(owp, &cache);
+    }
+    for (i = 1U + hostRand() % 4U; i > 0U; i--) {
+      j = hostRand() % DEVICES;
+      devices[j].attached = !devices[j].attached;
+    }
+    if ((hostRand() % 2U) == 0U) {
+      (void)onewireSearchFamily(owp, FAMILY_B, roms, SEARCH_MAX);
+    }
+    else {
+      (void)onewireVerifyRom(owp, devices[hostRand() % DEVICES].rom);
+    }
+
+    cache_rescan(owp, &cache, &step);
+    if (!check_roms(cache.roms, cache.count, -1, false)) {
+      HOST_CHECK(false, "%s: cache after hot-plug round %u", name, round);
+      break;
+    }
+  }
+  HOST_CHECK(step.resets == 1U, "%s: %u resets in a cache step", name,
+             step.resets);
+  print_cost(name, "cache step, worst", step);
+
+  for (i = 0; i < DEVICES; i++) {
+    devices[i].attached = true;
+  }
+}
+
+static void test_master(onewireDriver *owp, const onewireConfig *cfg,
+                        const char *name) {
+
+  onewireObjectInit(owp);
+  onewireStart(owp, cfg);
+  test_searches(owp, name);
+  test_cache(owp, name);
+  onewireStop(owp);
+}
+
+int main(int argc, char *argv[]) {
+  unsigned i;
+
+  hostInit(argc, argv);
+  chSysInit();
+
+  for (i = 0; i < DEVICES; i++) {
+    owsimDeviceInit(&devices[i], i < FAMILY_B_DEVICES ? FAMILY_B : FAMILY_A,
+                    (uint16_t)i);
+  }
+  owsimBusInit(&bus, devices, DEVICES);
+  if (host_bench) {
+    printf("%s: %u devices, %u of family 0x%02X\n", argv[0], DEVICES,
+           FAMILY_B_DEVICES, FAMILY_B);
+  }
+
+#if ONEWIRE_USE_PWM
+  pwmd.state = PWM_STOP;
+  pwmd.bus = &bus;
+  chVTObjectInit(&pwmd.vt);
+  test_master(&OWD1, &pwm_owcfg, "PWM");
+#endif
+
+#if ONEWIRE_USE_UART
+  uartd.state = UART_STOP;
+  uartd.bus = &bus;
+  chVTObjectInit(&uartd.vt);
+  test_master(&OWD1, &uart_owcfg, "UART");
+#endif
+
+  return hostReport(argv[0]);
+}
@@ -0,0 +1,291 @@
+/*
+    ChibiOS - Copyright (C) 2006..2018 Giovanni Di Sirio
+
+    Licensed under the Apache License, Version 2.0 (the "License");
+    you may not use this file except in compliance with the License.
+    You may obtain a copy of the License at
+
+        http://www.apache.org/licenses/LICENSE-2.0
+
+    Unless required by applicable law or agreed to in writing, software
+    distributed under the License is distributed on an "AS IS" BASIS,
+    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+    See the License for the specific language governing permissions and
+    limitations under the License.
+*/
+
+/*
+ * Temperature sweep over five simulated buses, four of ten sensors at
+ * different resolutions and one of a single sensor: the sweep takes one
+ * conversion time plus the scratchpad reads of the slowest buses, the
+ * other buses being read while those still convert. Then the CRC error,
+ * no presence and timeout statuses, with both masters.
+ */
+
+#include <string.h>
+
+#include "hal.h"
+#include "host_test.h"
+#include "owsim.h"
+
+/*===========================================================================*/
+/* Helpers.                                                                  */
+/*===========================================================================*/
+
+#define BUSES                               5U
+#define SENSORS                             10U
+#define FAMILY                              0x28U
+
+/* Conversion times at 9, 10, 11 and 12 bits, in ticks.*/
+static const uint32_t convert_time[BUSES] = {
+  93750U, 187500U, 375000U, 750000U, 750000U
+};
+static const size_t sensors[BUSES] = {
+  SENSORS, SENSORS, SENSORS, SENSORS, 1U
+};
+
+#define TIMEOUT_MS                          800U
+
+/* Polls and wake-ups in the sweep, on top of the reads.*/
+#define SLACK                               OSAL_MS2I(10)
+
+static owsim_device_t devices[BUSES][SENSORS];
+static owsim_bus_t bus[BUSES];
+static uint8_t roms[BUSES][SENSORS * 8U];
+static uint8_t pads[BUSES][SENSORS * ONEWIRE_SCRATCHPAD_LEN];
+static onewire_sweep_status_t status[BUSES][SENSORS];
+static onewireSweepBus sweep[BUSES];
+static onewireDriver owd[BUSES];
+static onewireConfig owcfg[BUSES];
+
+#if ONEWIRE_USE_PWM
+static PWMDriver pwmd[BUSES];
+static PWMConfig pwmcfg[BUSES];
+#endif
+
+#if ONEWIRE_USE_UART
+static UARTDriver uartd[BUSES];
+static UARTConfig uartcfg[BUSES];
+#endif
+
+/* Fresh sensors converting up to 10% faster than the datasheet time.*/
+static void sensors_init(void) {
+  unsigned b, i;
+
+  for (b = 0; b < BUSES; b++) {
+    for (i = 0; i < sensors[b]; i++) {
+      owsim_device_t *dev = &devices[b][i];
+
+      owsimDeviceInit(dev, FAMILY, (uint16_t)(b * SENSORS + i));
+      dev->convert_time = convert_time[b] -
+                          hostRand() % (convert_time[b] / 10U);
+      memcpy(&roms[b][i * 8U], dev->rom, 8);
+    }
+    owsimBusInit(&bus[b], devices[b], sensors[b]);
+  }
+}
+
+static void buses_start(bool uart) {
+  unsigned b;
+
+  for (b = 0; b < BUSES; b++) {
+    memset(&owcfg[b], 0, sizeof(owcfg[b]));
+    owcfg[b].port = &bus[b];
+#if ONEWIRE_USE_PWM
+    if (!uart) {
+      pwmd[b].state = PWM_STOP;
+      pwmd[b].bus = &bus[b];
+      chVTObjectInit(&pwmd[b].vt);
+      owcfg[b].pwmd = &pwmd[b];
+      owcfg[b].pwmcfg = &pwmcfg[b];
+      owcfg[b].pwmmode = PWM_OUTPUT_ACTIVE_LOW;
+      owcfg[b].master_channel = 0;
+      owcfg[b].sample_channel = 1;
+    }
+#endif
+#if ONEWIRE_USE_UART
+    if (uart) {
+      uartd[b].state = UART_STOP;
+      uartd[b].bus = &bus[b];
+      chVTObjectInit(&uartd[b].vt);
+      owcfg[b].uartd = &uartd[b];
+      owcfg[b].uartcfg = &uartcfg[b];
+    }
+#endif
+    onewireObjectInit(&owd[b]);
+    onewireStart(&owd[b], &owcfg[b]);
+
+    sweep[b].owp = &owd[b];
+    sweep[b].roms = roms[b];
+    sweep[b].count = sensors[b];
+    sweep[b].scratchpads = pads[b];
+    sweep[b].status = status[b];
+    memset(pads[b], 0, sizeof(pads[b]));
+  }
+}
+
+static void buses_stop(void) {
+  unsigned b;
+
+  for (b = 0; b < BUSES; b++) {
+    onewireStop(&owd[b]);
+  }
+}
+
+/* Time of one addressed scratchpad read.*/
+static sysinterval_t read_time(void) {
+  uint8_t cmd[10], sp[ONEWIRE_SCRATCHPAD_LEN];
+  systime_t start = chVTGetSystemTimeX();
+
+  cmd[0] = ONEWIRE_CMD_MATCH_ROM;
+  memcpy(&cmd[1], roms[0], 8);
+  cmd[9] = ONEWIRE_CMD_READ_SCRATCHPAD;
+  (void)onewireReset(&owd[0]);
+  onewireWrite(&owd[0], cmd, sizeof(cmd), 0);
+  onewireRead(&owd[0], sp, sizeof(sp));
+  return chTimeDiffX(start, chVTGetSystemTimeX());
+}
+
+static bool pad_ok(unsigned b, unsigned i) {
+
+  return memcmp(&pads[b][i * ONEWIRE_SCRATCHPAD_LEN], devices[b][i].scratchpad,
+                ONEWIRE_SCRATCHPAD_LEN) == 0;
+}
+
+/*===========================================================================*/
+/* Tests.                                                                    */
+/*===========================================================================*/
+
+static void test_sweep(bool uart, const char *name) {
+  sysinterval_t one, elapsed, longest = 0, last = 0;
+  systime_t start;
+  uint32_t irqs;
+  size_t ok, total = 0;
+  unsigned b, i;
+
+  sensors_init();
+  buses_start(uart);
+  one = read_time();
+  for (b = 0; b < BUSES; b++) {
+    total += sensors[b];
+    for (i = 0; i < sensors[b]; i++) {
+      if (devices[b][i].convert_time > longest) {
+        longest = devices[b][i].convert_time;
+      }
+    }
+  }
+  /* Only the buses still converting at the end are read afterwards.*/
+  for (b = 0; b < BUSES; b++) {
+    if (convert_time[b] - convert_time[b] / 10U < longest) {
+      last += sensors[b];
+    }
+  }
+
+  irqs = owsim_irqs;
+  start = chVTGetSystemTimeX();
+  ok = onewireSweep(sweep, BUSES, OSAL_MS2I(TIMEOUT_MS));
+  elapsed = chTimeDiffX(start, chVTGetSystemTimeX());
+  irqs = owsim_irqs - irqs;
+
+  HOST_CHECK(ok == total, "%s: %u sensors read", name, (unsigned)ok);
+  for (b = 0; b < BUSES; b++) {
+    for (i = 0; i < sensors[b]; i++) {
+      HOST_CHECK((status[b][i] == ONEWIRE_SWEEP_OK) && pad_ok(b, i),
+                 "%s: bus %u sensor %u status %d", name, b, i,
+                 (int)status[b][i]);
+    }
+  }
+  HOST_CHECK(elapsed >= longest, "%s: sweep of %u ticks", name,
+             (unsigned)elapsed);
+  HOST_CHECK(elapsed <= longest + ONEWIRE_SWEEP_POLL_INTERVAL + total * one,
+             "%s: sweep of %u ticks, more than one conversion and %u reads",
+             name, (unsigned)elapsed, (unsigned)total);
+  HOST_CHECK(elapsed <= longest + ONEWIRE_SWEEP_POLL_INTERVAL + last * one +
+                        SLACK,
+             "%s: sweep of %u ticks, more than one conversion and %u reads",
+             name, (unsigned)elapsed, (unsigned)last);
+
+  if (host_bench) {
+    printf("  %-4s %u sensors in %.1f ms, %u irqs: conversion %.1f ms, "
+           "read %.2f ms, sensor by sensor %.0f ms\n",
+           name, (unsigned)total, elapsed / 1000.0, irqs, longest / 1000.0,
+           one / 1000.0, total * (longest + one) / 1000.0);
+  }
+  buses_stop();
+}
+
+static void test_faults(bool uart, const char *name) {
+  sysinterval_t one, elapsed;
+  systime_t start;
+  size_t ok;
+  unsigned i;
+
+  sensors_init();
+  /* Bus 1: one bad read recovered by the retry, one never read.*/
+  devices[1][3].bad_reads = 1;
+  devices[1][5].bad_reads = ONEWIRE_SWEEP_RETRIES + 1U;
+  /* Bus 2: nothing attached.*/
+  for (i = 0; i < SENSORS; i++) {
+    devices[2][i].attached = false;
+  }
+  /* Bus 3: one sensor never ends its conversion in time.*/
+  devices[3][7].convert_time = 2U * TIMEOUT_MS * 1000U;
+  buses_start(uart);
+  one = read_time();
+
+  start = chVTGetSystemTimeX();
+  ok = onewireSweep(sweep, BUSES, OSAL_MS2I(TIMEOUT_MS));
+  elapsed = chTimeDiffX(start, chVTGetSystemTimeX());
+
+  HOST_CHECK(ok == 2U * SENSORS, "%s: %u sensors read", name,
+             (unsigned)ok);
+  for (i = 0; i < SENSORS; i++) {
+    HOST_CHECK((status[0][i] == ONEWIRE_SWEEP_OK) && pad_ok(0, i),
+               "%s: bus 0 sensor %u status %d", name, i, (int)status[0][i]);
+    if (i == 5U) {
+      HOST_CHECK(status[1][i] == ONEWIRE_SWEEP_CRC_ERROR,
+                 "%s: bus 1 sensor %u status %d", name, i,
+                 (int)status[1][i]);
+    }
+    else {
+      HOST_CHECK((status[1][i] == ONEWIRE_SWEEP_OK) && pad_ok(1, i),
+                 "%s: bus 1 sensor %u status %d", name, i,
+                 (int)status[1][i]);
+    }
+    HOST_CHECK(status[2][i] == ONEWIRE_SWEEP_NO_PRESENCE,
+               "%s: bus 2 sensor %u status %d", name, i, (int)status[2][i]);
+    /* The scratchpads are still read, previous temperature included.*/
+    HOST_CHECK((status[3][i] == ONEWIRE_SWEEP_TIMEOUT) && pad_ok(3, i),
+               "%s: bus 3 sensor %u status %d", name, i, (int)status[3][i]);
+  }
+  HOST_CHECK((status[4][0] == ONEWIRE_SWEEP_OK) && pad_ok(4, 0),
+             "%s: bus 4 status %d", name, (int)status[4][0]);
+  HOST_CHECK((elapsed >= OSAL_MS2I(TIMEOUT_MS)) &&
+             (elapsed <= OSAL_MS2I(TIMEOUT_MS) + ONEWIRE_SWEEP_POLL_INTERVAL +
+                         SENSORS * one + SLACK),
+             "%s: sweep of %u ticks", name, (unsigned)elapsed);
+  buses_stop();
+}
+
+int main(int argc, char *argv[]) {
+
+  hostInit(argc, argv);
+  chSysInit();
+
+  if (host_bench) {
+    printf("%s: %u buses, %u sensors\n", argv[0], BUSES,
+           4U * SENSORS + 1U);
+  }
+
+#if ONEWIRE_USE_PWM
+  test_sweep(false, "PWM");
+  test_faults(false, "PWM");
+#endif
+
+#if ONEWIRE_USE_UART
+  test_sweep(true, "UART");
+  test_faults(true, "UART");
+#endif
+
+  return hostReport(argv[0]);
+}
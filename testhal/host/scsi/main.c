@@ -0,0 +1,465 @@
+/*
+    ChibiOS - Copyright (C) 2006..2018 Giovanni Di Sirio
+
+    Licensed under the Apache License, Version 2.0 (the "License");
+    you may not use this file except in compliance with the License.
+    You may obtain a copy of the License at
+
+        http://www.apache.org/licenses/LICENSE-2.0
+
+    Unless required by applicable law or agreed to in writing, software
+    distributed under the License is distributed on an "AS IS" BASIS,
+    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+    See the License for the specific language governing permissions and
+    limitations under the License.
+*/
+
+#include <string.h>
+
+#include "hal.h"
+#include "lib_scsi.h"
+#include "ramdisk.h"
+#include "host_test.h"
+
+/*===========================================================================*/
+/* Modelled time.                                                            */
+/*===========================================================================*/
+
+/*
+ * Modelled device time, roughly an SD card on SPI, and bus time, a high
+ * speed bulk endpoint: every operation pays an overhead, then each block
+ * or byte its transfer time.
+ */
+#define READ_OP_NS                          200000U
+#define READ_BLOCK_NS                       40000U
+#define WRITE_OP_NS                         600000U
+#define WRITE_BLOCK_NS                      50000U
+#define XFER_OP_NS                          20000U
+#define XFER_BYTE_NS                        40U
+
+#define BLK_SIZE                            512U
+#define BLK_NUM                             2048U
+#define MAX_BLOCKS                          128U
+
+static uint64_t now_ns;
+
+/*===========================================================================*/
+/* RAM disk with a cost model and an injected media error.                   */
+/*===========================================================================*/
+
+static RamDisk disk;
+static struct BaseBlockDeviceVMT disk_vmt;
+static const struct BaseBlockDeviceVMT *ramdisk_vmt;
+static uint8_t disk_data[BLK_NUM * BLK_SIZE];
+static uint32_t bad_lba;
+static uint32_t disk_reads;
+static uint32_t disk_writes;
+
+static bool bad_range(uint32_t startblk, uint32_t n) {
+
+  return (bad_lba >= startblk) && (bad_lba < startblk + n);
+}
+
+static bool disk_read(void *instance, uint32_t startblk,
+                      uint8_t *buffer, uint32_t n) {
+
+  disk_reads++;
+  now_ns += READ_OP_NS + (uint64_t)n * READ_BLOCK_NS;
+  if (bad_range(startblk, n)) {
+    return HAL_FAILED;
+  }
+  return ramdisk_vmt->read(instance, startblk, buffer, n);
+}
+
+static bool disk_write(void *instance, uint32_t startblk,
+                       const uint8_t *buffer, uint32_t n) {
+
+  disk_writes++;
+  now_ns += WRITE_OP_NS + (uint64_t)n * WRITE_BLOCK_NS;
+  if (bad_range(startblk, n)) {
+    return HAL_FAILED;
+  }
+  return ramdisk_vmt->write(instance, startblk, buffer, n);
+}
+
+static void disk_init(void) {
+
+  ramdiskObjectInit(&disk);
+  ramdiskStart(&disk, disk_data, BLK_SIZE, BLK_NUM, false);
+  ramdisk_vmt = disk.vmt;
+  disk_vmt = *ramdisk_vmt;
+  disk_vmt.read = disk_read;
+  disk_vmt.write = disk_write;
+  disk.vmt = &disk_vmt;
+  bad_lba = UINT32_MAX;
+  disk_reads = 0;
+  disk_writes = 0;
+}
+
+/*===========================================================================*/
+/* Transport with a modelled initiator.                                      */
+/*===========================================================================*/
+
+/*
+ * The initiator side of a data phase: the data a READ(10) transmits and
+ * the data a WRITE(10) receives. Asynchronous transfers only touch the
+ * target buffer when waited, a buffer reused while its transfer is still
+ * in flight shows up as corrupted data.
+ */
+static uint8_t host_data[MAX_BLOCKS * BLK_SIZE];
+static size_t host_pos;
+static size_t host_len;
+static bool xfer_fail;
+
+static struct {
+  bool                      pending;
+  bool                      transmit;
+  const uint8_t             *data;
+  size_t                    len;
+  uint64_t                  done_ns;
+  unsigned                  overlapped;
+  unsigned                  misuse;
+} xfer;
+
+static uint32_t host_move(bool transmit, uint8_t *data, size_t len) {
+
+  if (xfer_fail || (host_pos + len > host_len)) {
+    return 0;
+  }
+  if (transmit) {
+    memcpy(&host_data[host_pos], data, len);
+  }
+  else {
+    memcpy(data, &host_data[host_pos], len);
+  }
+  host_pos += len;
+  return (uint32_t)len;
+}
+
+static uint64_t xfer_ns(size_t len) {
+
+  return XFER_OP_NS + (uint64_t)len * XFER_BYTE_NS;
+}
+
+static uint32_t tr_transmit(const SCSITransport *transport,
+                            const uint8_t *data, size_t len) {
+
+  (void)transport;
+  now_ns += xfer_ns(len);
+  return host_move(true, (uint8_t *)data, len);
+}
+
+static uint32_t tr_receive(const SCSITransport *transport,
+                           uint8_t *data, size_t len) {
+
+  (void)transport;
+  now_ns += xfer_ns(len);
+  return host_move(false, data, len);
+}
+
+static bool tr_start(bool transmit, const uint8_t *data, size_t len) {
+
+  if (xfer.pending) {
+    xfer.misuse++;
+  }
+  xfer.pending = true;
+  xfer.transmit = transmit;
+  xfer.data = data;
+  xfer.len = len;
+  xfer.done_ns = now_ns + xfer_ns(len);
+  return false;
+}
+
+static bool tr_start_transmit(const SCSITransport *transport,
+                              const uint8_t *data, size_t len) {
+
+  (void)transport;
+  return tr_start(true, data, len);
+}
+
+static bool tr_start_receive(const SCSITransport *transport,
+                             uint8_t *data, size_t len) {
+
+  (void)transport;
+  return tr_start(false, data, len);
+}
+
+static uint32_t tr_wait(const SCSITransport *transport, bool transmit) {
+
+  (void)transport;
+  if (!xfer.pending || (xfer.transmit != transmit)) {
+    xfer.misuse++;
+  }
+  xfer.pending = false;
+  if (now_ns < xfer.done_ns) {
+    now_ns = xfer.done_ns;
+  }
+  else {
+    xfer.overlapped++;
+  }
+  return host_move(transmit, (uint8_t *)xfer.data, xfer.len);
+}
+
+static const SCSITransport sync_transport = {
+  tr_transmit,
+  tr_receive,
+  NULL,
+  NULL,
+  NULL,
+  NULL
+};
+
+static const SCSITransport async_transport = {
+  tr_transmit,
+  tr_receive,
+  tr_start_transmit,
+  tr_start_receive,
+  tr_wait,
+  NULL
+};
+
+/*===========================================================================*/
+/* Target.                                                                   */
+/*===========================================================================*/
+
+static SCSITarget target;
+static SCSITargetConfig config;
+static uint8_t blkbuf[32U * 1024U];
+
+static void target_setup(const SCSITransport *tr, size_t blkbuf_size) {
+
+  disk_init();
+  memset(&xfer, 0, sizeof(xfer));
+  xfer_fail = false;
+  config.transport = tr;
+  config.blkdev = (BaseBlockDevice *)&disk;
+  config.blkbuf = blkbuf;
+  config.blkbuf_size = blkbuf_size;
+  config.inquiry_response = NULL;
+  config.unit_serial_number_inquiry_response = NULL;
+  scsiObjectInit(&target);
+  scsiStart(&target, &config);
+}
+
+static bool rw10(uint8_t op, uint32_t lba, uint16_t n) {
+  uint8_t cmd[10] = {op, 0,
+                     (uint8_t)(lba >> 24), (uint8_t)(lba >> 16),
+                     (uint8_t)(lba >> 8), (uint8_t)lba,
+                     0, (uint8_t)(n >> 8), (uint8_t)n, 0};
+
+  host_pos = 0;
+  host_len = (size_t)n * BLK_SIZE;
+  target.residue = 0;
+  return scsiExecCmd(&target, cmd);
+}
+
+static const char *mode_name(const SCSITransport *tr, size_t blkbuf_size) {
+  static char name[32];
+
+  snprintf(name, sizeof(name), "%s %u", tr == &async_transport ?
+           "async" : "sync", (unsigned)blkbuf_size);
+  return name;
+}
+
+/*===========================================================================*/
+/* Tests.                                                                    */
+/*===========================================================================*/
+
+static uint8_t ref[BLK_NUM * BLK_SIZE];
+
+static void fill_random(uint8_t *p, size_t n) {
+
+  while (n-- > 0U) {
+    *p++ = (uint8_t)hostRand();
+  }
+}
+
+/*
+ * Random READ(10) and WRITE(10) commands, reads must return the last data
+ * written whatever the chunking of the buffer.
+ */
+static void test_random_rw(const SCSITransport *tr, size_t blkbuf_size) {
+  unsigned op, errors = 0;
+
+  hostSeed((uint32_t)blkbuf_size + (tr == &async_transport));
+  target_setup(tr, blkbuf_size);
+  fill_random(disk_data, sizeof(disk_data));
+  memcpy(ref, disk_data, sizeof(ref));
+
+  for (op = 0; op < 2000U; op++) {
+    uint16_t n = (uint16_t)(1U + (hostRand() % MAX_BLOCKS));
+    uint32_t lba = hostRand() % (BLK_NUM - n + 1U);
+
+    if ((hostRand() % 2U) == 0U) {
+      if ((rw10(SCSI_CMD_READ_10, lba, n) != SCSI_SUCCESS) ||
+          (host_pos != host_len) ||
+          (memcmp(host_data, &ref[lba * BLK_SIZE], host_len) != 0)) {
+        errors++;
+      }
+    }
+    else {
+      fill_random(host_data, (size_t)n * BLK_SIZE);
+      memcpy(&ref[lba * BLK_SIZE], host_data, (size_t)n * BLK_SIZE);
+      if ((rw10(SCSI_CMD_WRITE_10, lba, n) != SCSI_SUCCESS) ||
+          (host_pos != host_len)) {
+        errors++;
+      }
+    }
+    if (xfer.pending || (target.residue != 0U)) {
+      errors++;
+    }
+  }
+  HOST_CHECK(xfer.misuse == 0U, "%s: %u transfers started or waited out "
+             "of order", mode_name(tr, blkbuf_size), xfer.misuse);
+  HOST_CHECK(errors == 0U, "%s: %u errors", mode_name(tr, blkbuf_size),
+             errors);
+  HOST_CHECK(memcmp(disk_data, ref, sizeof(ref)) == 0,
+             "%s: device contents", mode_name(tr, blkbuf_size));
+  if ((tr == &async_transport) && (blkbuf_size >= 2U * BLK_SIZE)) {
+    HOST_CHECK(xfer.overlapped > 0U, "%s: no transfer overlapped",
+               mode_name(tr, blkbuf_size));
+  }
+}
+
+/* Accesses past the end are refused before any data phase.*/
+static void test_out_of_range(const SCSITransport *tr, size_t blkbuf_size) {
+
+  target_setup(tr, blkbuf_size);
+  HOST_CHECK(rw10(SCSI_CMD_READ_10, BLK_NUM - 1U, 2) == SCSI_FAILED,
+             "%s: read past the end", mode_name(tr, blkbuf_size));
+  HOST_CHECK((host_pos == 0U) && (disk_reads == 0U),
+             "%s: data moved", mode_name(tr, blkbuf_size));
+  HOST_CHECK(target.sense.byte[2] == SCSI_SENSE_KEY_ILLEGAL_REQUEST,
+             "%s: sense key %u", mode_name(tr, blkbuf_size),
+             target.sense.byte[2]);
+}
+
+/*
+ * A failing block read stops the data phase, the blocks before it reach
+ * the initiator and the residue accounts for the rest.
+ */
+static void test_read_error(const SCSITransport *tr, size_t blkbuf_size) {
+  const uint16_t n = 64;
+
+  target_setup(tr, blkbuf_size);
+  fill_random(disk_data, n * BLK_SIZE);
+  bad_lba = 40;
+  HOST_CHECK(rw10(SCSI_CMD_READ_10, 0, n) == SCSI_FAILED,
+             "%s: read succeeded", mode_name(tr, blkbuf_size));
+  HOST_CHECK(target.sense.byte[2] == SCSI_SENSE_KEY_MEDIUM_ERROR,
+             "%s: sense key %u", mode_name(tr, blkbuf_size),
+             target.sense.byte[2]);
+  HOST_CHECK(host_pos + target.residue == host_len,
+             "%s: %u bytes moved, residue %u", mode_name(tr, blkbuf_size),
+             (unsigned)host_pos, (unsigned)target.residue);
+  HOST_CHECK((host_pos <= bad_lba * BLK_SIZE) &&
+             (memcmp(host_data, disk_data, host_pos) == 0),
+             "%s: data before the error", mode_name(tr, blkbuf_size));
+  HOST_CHECK(!xfer.pending && (xfer.misuse == 0U),
+             "%s: transfer left pending", mode_name(tr, blkbuf_size));
+}
+
+/*
+ * A failing block write still drains the data phase so the initiator is
+ * not stalled, the blocks before it are written.
+ */
+static void test_write_error(const SCSITransport *tr, size_t blkbuf_size) {
+  const uint16_t n = 64;
+
+  target_setup(tr, blkbuf_size);
+  memset(disk_data, 0, sizeof(disk_data));
+  fill_random(host_data, n * BLK_SIZE);
+  bad_lba = 40;
+  HOST_CHECK(rw10(SCSI_CMD_WRITE_10, 0, n) == SCSI_FAILED,
+             "%s: write succeeded", mode_name(tr, blkbuf_size));
+  HOST_CHECK(target.sense.byte[2] == SCSI_SENSE_KEY_MEDIUM_ERROR,
+             "%s: sense key %u", mode_name(tr, blkbuf_size),
+             target.sense.byte[2]);
+  HOST_CHECK(host_pos == host_len, "%s: %u bytes drained of %u",
+             mode_name(tr, blkbuf_size), (unsigned)host_pos,
+             (unsigned)host_len);
+  HOST_CHECK((target.residue > 0U) && (target.residue <= host_len) &&
+             ((target.residue % BLK_SIZE) == 0U),
+             "%s: residue %u", mode_name(tr, blkbuf_size),
+             (unsigned)target.residue);
+  HOST_CHECK(memcmp(host_data, disk_data, 32U * BLK_SIZE) == 0,
+             "%s: data before the error", mode_name(tr, blkbuf_size));
+  HOST_CHECK(!xfer.pending && (xfer.misuse == 0U),
+             "%s: transfer left pending", mode_name(tr, blkbuf_size));
+}
+
+/* A failing transfer is not a media error.*/
+static void test_transport_error(const SCSITransport *tr,
+                                 size_t blkbuf_size) {
+
+  target_setup(tr, blkbuf_size);
+  xfer_fail = true;
+  HOST_CHECK(rw10(SCSI_CMD_READ_10, 0, 16) == SCSI_FAILED,
+             "%s: read succeeded", mode_name(tr, blkbuf_size));
+  HOST_CHECK(target.sense.byte[2] != SCSI_SENSE_KEY_MEDIUM_ERROR,
+             "%s: medium error", mode_name(tr, blkbuf_size));
+  HOST_CHECK(target.residue > 0U, "%s: no residue",
+             mode_name(tr, blkbuf_size));
+}
+
+/*===========================================================================*/
+/* Benchmark.                                                                */
+/*===========================================================================*/
+
+static const struct {
+  const SCSITransport       *tr;
+  size_t                    blkbuf_size;
+} configs[] = {
+  {&sync_transport,  BLK_SIZE},
+  {&sync_transport,  8U * 1024U},
+  {&async_transport, 2U * BLK_SIZE},
+  {&async_transport, 8U * 1024U},
+  {&async_transport, 32U * 1024U}
+};
+
+/* Modelled throughput of 64 KiB commands, sequential over the disk.*/
+static void bench(void) {
+  unsigned c;
+
+  printf("%-12s %10s %10s\n", "buffer", "read KB/s", "write KB/s");
+  for (c = 0; c < sizeof(configs) / sizeof(configs[0]); c++) {
+    uint64_t t_read, t_write;
+    uint32_t lba;
+
+    target_setup(configs[c].tr, configs[c].blkbuf_size);
+    now_ns = 0;
+    for (lba = 0; lba < BLK_NUM; lba += MAX_BLOCKS) {
+      (void)rw10(SCSI_CMD_READ_10, lba, MAX_BLOCKS);
+    }
+    t_read = now_ns;
+    now_ns = 0;
+    for (lba = 0; lba < BLK_NUM; lba += MAX_BLOCKS) {
+      (void)rw10(SCSI_CMD_WRITE_10, lba, MAX_BLOCKS);
+    }
+    t_write = now_ns;
+    printf("%-12s %10.0f %10.0f\n",
+           mode_name(configs[c].tr, configs[c].blkbuf_size),
+           (double)sizeof(disk_data) / 1024.0 / ((double)t_read / 1e9),
+           (double)sizeof(disk_data) / 1024.0 / ((double)t_write / 1e9));
+  }
+}
+
+int main(int argc, char *argv[]) {
+  unsigned c;
+
+  hostInit(argc, argv);
+
+  for (c = 0; c < sizeof(configs) / sizeof(configs[0]); c++) {
+    test_random_rw(configs[c].tr, configs[c].blkbuf_size);
+    test_out_of_range(configs[c].tr, configs[c].blkbuf_size);
+    test_read_error(configs[c].tr, configs[c].blkbuf_size);
+    test_write_error(configs[c].tr, configs[c].blkbuf_size);
+    test_transport_error(configs[c].tr, configs[c].blkbuf_size);
+  }
+
+  if (host_bench) {
+    bench();
+  }
+
+  return hostReport(argv[0]);
+}
@@ -0,0 +1,236 @@
+/*
+    ChibiOS - Copyright (C) 2006..2018 Giovanni Di Sirio
+
+    Licensed under the Apache License, Version 2.0 (the "License");
+    you may not use this file except in compliance with the License.
+    You may obtain a copy of the License at
+
+        http://www.apache.org/licenses/LICENSE-2.0
+
+    Unless required by applicable law or agreed to in writing, software
+    distributed under the License is distributed on an "AS IS" BASIS,
+    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+    See the License for the specific language governing permissions and
+    limitations under the License.
+*/
+
+/*
+ * Scripted Bulk-Only SCSI disk shared by the USB host tests.
+ */
+
+#include <string.h>
+
+#include "hal.h"
+#include "disk.h"
+
+/*===========================================================================*/
+/* Simulated disk.                                                           */
+/*===========================================================================*/
+#define CBW_SIGNATURE                       0x43425355
+#define CSW_SIGNATURE                       0x53425355
+
+typedef enum {
+  BOT_CBW,
+  BOT_DATA_IN,
+  BOT_DATA_OUT,
+  BOT_CSW
+} bot_state_t;
+
+static struct {
+  bot_state_t               state;
+  uint8_t                   blocks[DISK_BLOCKS][DISK_BLOCK_SIZE];
+  uint8_t                   reply[36];
+  uint8_t                   *data;
+  uint32_t                  remaining;
+  uint32_t                  tag;
+  uint32_t                  residue;
+  uint8_t                   status;
+  /* SCSI commands received, by opcode.*/
+  uint32_t                  commands[256];
+} disk;
+
+static const uint8_t disk_device_descriptor[] = {
+  18, USBH_DT_DEVICE,
+  0x00, 0x02,                               /* bcdUSB */
+  0x00, 0x00, 0x00, 64,
+  0x83, 0x04,                               /* idVendor */
+  0x20, 0x57,                               /* idProduct */
+  0x00, 0x01,                               /* bcdDevice */
+  1, 2, 0, 1
+};
+
+static const uint8_t disk_config_descriptor[] = {
+  9, USBH_DT_CONFIG, 32, 0, 1, 1, 0, 0x80, 50,
+  9, USBH_DT_INTERFACE, 0, 0, 2, 0x08, 0x06, 0x50, 0,
+  7, USBH_DT_ENDPOINT, 0x81, USBH_EPTYPE_BULK, 0x00, 0x02, 0,
+  7, USBH_DT_ENDPOINT, 0x02, USBH_EPTYPE_BULK, 0x00, 0x02, 0
+};
+
+static const char *const disk_strings[] = {"ChibiOS", "Simulated disk"};
+
+static uint32_t get_be32(const uint8_t *p) {
+
+  return ((uint32_t)p[0] << 24) | ((uint32_t)p[1] << 16) |
+         ((uint32_t)p[2] << 8) | p[3];
+}
+
+static void put_be32(uint8_t *p, uint32_t v) {
+
+  p[0] = (uint8_t)(v >> 24);
+  p[1] = (uint8_t)(v >> 16);
+  p[2] = (uint8_t)(v >> 8);
+  p[3] = (uint8_t)v;
+}
+
+static void disk_command(const uint8_t *cbw) {
+  const uint8_t *cb = &cbw[15];
+  uint32_t length = cbw[8] | (cbw[9] << 8) | (cbw[10] << 16) |
+                    ((uint32_t)cbw[11] << 24);
+  uint32_t lba, n;
+
+  disk.tag = cbw[4] | (cbw[5] << 8) | (cbw[6] << 16) |
+             ((uint32_t)cbw[7] << 24);
+  disk.commands[cb[0]]++;
+  disk.status = 0;
+  disk.data = disk.reply;
+  disk.remaining = 0;
+  memset(disk.reply, 0, sizeof(disk.reply));
+
+  switch (cb[0]) {
+  case 0x12:                                /* INQUIRY */
+    disk.reply[4] = 31;
+    memcpy(&disk.reply[8], "ChibiOS Sim disk        0.1 ", 28);
+    disk.remaining = 36;
+    break;
+  case 0x00:                                /* TEST UNIT READY */
+    break;
+  case 0x25:                                /* READ CAPACITY(10) */
+    put_be32(&disk.reply[0], DISK_BLOCKS - 1);
+    put_be32(&disk.reply[4], DISK_BLOCK_SIZE);
+    disk.remaining = 8;
+    break;
+  case 0x03:                                /* REQUEST SENSE */
+    disk.reply[0] = 0x70;
+    disk.reply[7] = 10;
+    disk.remaining = 18;
+    break;
+  case 0x28:                                /* READ(10) */
+  case 0x2A:                                /* WRITE(10) */
+    lba = get_be32(&cb[2]);
+    n = (cb[7] << 8) | cb[8];
+    if (lba + n > DISK_BLOCKS) {
+      disk.status = 1;
+      break;
+    }
+    disk.data = disk.blocks[lba];
+    disk.remaining = n * DISK_BLOCK_SIZE;
+    break;
+  default:
+    disk.status = 1;
+    break;
+  }
+
+  if (disk.remaining > length) {
+    disk.remaining = length;
+  }
+  disk.residue = length - disk.remaining;
+  if (length == 0U) {
+    disk.state = BOT_CSW;
+  }
+  else {
+    disk.state = (cbw[12] & 0x80) ? BOT_DATA_IN : BOT_DATA_OUT;
+  }
+}
+
+static usbhsim_response_t disk_control(usbhsim_device_t *dev,
+                                       const usbh_control_request_t *req,
+                                       uint8_t *buf, uint32_t *len) {
+
+  (void)dev;
+  if ((req->bmRequestType == 0xA1) && (req->bRequest == 0xFE)) {
+    /* GET MAX LUN.*/
+    buf[0] = 0;
+    *len = 1;
+    return USBHSIM_ACK;
+  }
+  if ((req->bmRequestType == 0x21) && (req->bRequest == 0xFF)) {
+    /* Bulk-Only reset.*/
+    disk.state = BOT_CBW;
+    return USBHSIM_ACK;
+  }
+  return USBHSIM_STALL;
+}
+
+static usbhsim_response_t disk_transfer(usbhsim_device_t *dev, uint8_t ep,
+                                        uint8_t *buf, uint32_t len,
+                                        uint32_t *actual) {
+  uint32_t n;
+
+  (void)dev;
+  if (ep == 0x02) {
+    if (disk.state == BOT_CBW) {
+      if ((len != 31U) || (get_be32(buf) != 0x55534243U)) {
+        return USBHSIM_STALL;
+      }
+      disk_command(buf);
+      return USBHSIM_ACK;
+    }
+    if (disk.state != BOT_DATA_OUT) {
+      return USBHSIM_NAK;
+    }
+    n = len < disk.remaining ? len : disk.remaining;
+    memcpy(disk.data, buf, n);
+    disk.data += n;
+    disk.remaining -= n;
+    if (disk.remaining == 0U) {
+      disk.state = BOT_CSW;
+    }
+    return USBHSIM_ACK;
+  }
+
+  if (disk.state == BOT_DATA_IN) {
+    n = len < disk.remaining ? len : disk.remaining;
+    memcpy(buf, disk.data, n);
+    disk.data += n;
+    disk.remaining -= n;
+    *actual = n;
+    if (disk.remaining == 0U) {
+      disk.state = BOT_CSW;
+    }
+    return USBHSIM_ACK;
+  }
+  if (disk.state == BOT_CSW) {
+    put_be32(&buf[0], 0x55534253U);
+    buf[4] = (uint8_t)disk.tag;
+    buf[5] = (uint8_t)(disk.tag >> 8);
+    buf[6] = (uint8_t)(disk.tag >> 16);
+    buf[7] = (uint8_t)(disk.tag >> 24);
+    buf[8] = (uint8_t)disk.residue;
+    buf[9] = (uint8_t)(disk.residue >> 8);
+    buf[10] = (uint8_t)(disk.residue >> 16);
+    buf[11] = (uint8_t)(disk.residue >> 24);
+    buf[12] = disk.status;
+    *actual = 13;
+    disk.state = BOT_CBW;
+    return USBHSIM_ACK;
+  }
+  return USBHSIM_NAK;
+}
+
+const usbhsim_config_t disk_config = {
+  USBH_DEVSPEED_HIGH,
+  disk_device_descriptor,
+  disk_config_descriptor,
+  disk_strings, 2,
+  disk_control,
+  disk_transfer
+};
+
+/*===========================================================================*/
+/* Exported functions.                                                       */
+/*===========================================================================*/
+
+uint8_t *diskGetBlock(uint32_t lba) {
+
+  return disk.blocks[lba];
+}
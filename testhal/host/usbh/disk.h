@@ -0,0 +1,37 @@
+/*
+    ChibiOS - Copyright (C) 2006..2018 Giovanni Di Sirio
+
+    Licensed under the Apache License, Version 2.0 (the "License");
+    you may not use this file except in compliance with the License.
+    You may obtain a copy of the License at
+
+        http://www.apache.org/licenses/LICENSE-2.0
+
+    Unless required by applicable law or agreed to in writing, software
+    distributed under the License is distributed on an "AS IS" BASIS,
+    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+    See the License for the specific language governing permissions and
+    limitations under the License.
+*/
+
+/*
+ * Scripted Bulk-Only SCSI disk shared by the USB host tests.
+ */
+
+#ifndef DISK_H
+#define DISK_H
+
+#define DISK_BLOCKS                         256
+#define DISK_BLOCK_SIZE                     512
+
+extern const usbhsim_config_t disk_config;
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+  uint8_t *diskGetBlock(uint32_t lba);
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* DISK_H */
@@ -0,0 +1,148 @@
+/*
+    ChibiOS - Copyright (C) 2006..2018 Giovanni Di Sirio
+
+    Licensed under the Apache License, Version 2.0 (the "License");
+    you may not use this file except in compliance with the License.
+    You may obtain a copy of the License at
+
+        http://www.apache.org/licenses/LICENSE-2.0
+
+    Unless required by applicable law or agreed to in writing, software
+    distributed under the License is distributed on an "AS IS" BASIS,
+    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+    See the License for the specific language governing permissions and
+    limitations under the License.
+*/
+
+#ifndef HAL_H
+#define HAL_H
+
+#include "osal.h"
+
+/*===========================================================================*/
+/* Subset of the ChibiOS HAL used by the USB host stack.                     */
+/*===========================================================================*/
+
+#define HAL_SUCCESS                         false
+#define HAL_FAILED                          true
+
+/* CMSIS compiler abstraction.*/
+#define __PACKED_STRUCT                     struct __attribute__((packed))
+#define PACKED_VAR                          __attribute__((packed))
+#define __REV(x)                            __builtin_bswap32(x)
+
+#include "hal_ioblock.h"
+
+/* Channels, see hal_channels.h and hal_queues.h.*/
+#define Q_OK                                MSG_OK
+#define Q_TIMEOUT                           MSG_TIMEOUT
+#define Q_RESET                             MSG_RESET
+
+#define CHN_CONNECTED                       (eventflags_t)1
+#define CHN_DISCONNECTED                    (eventflags_t)2
+#define CHN_INPUT_AVAILABLE                 (eventflags_t)4
+#define CHN_OUTPUT_EMPTY                    (eventflags_t)8
+#define CHN_TRANSMISSION_END                (eventflags_t)16
+
+#define _base_asynchronous_channel_methods                                  \
+  size_t instance_offset;                                                   \
+  size_t (*write)(void *instance, const uint8_t *bp, size_t n);             \
+  size_t (*read)(void *instance, uint8_t *bp, size_t n);                    \
+  msg_t (*put)(void *instance, uint8_t b);                                  \
+  msg_t (*get)(void *instance);                                             \
+  msg_t (*putt)(void *instance, uint8_t b, sysinterval_t time);             \
+  msg_t (*gett)(void *instance, sysinterval_t time);                        \
+  size_t (*writet)(void *instance, const uint8_t *bp, size_t n,             \
+                   sysinterval_t time);                                     \
+  size_t (*readt)(void *instance, uint8_t *bp, size_t n,                    \
+                  sysinterval_t time);                                      \
+  msg_t (*ctl)(void *instance, unsigned int operation, void *arg);
+
+#define _base_asynchronous_channel_data                                     \
+  event_source_t            event;
+
+#define chnPutTimeout(ip, b, time)          ((ip)->vmt->putt(ip, b, time))
+#define chnGetTimeout(ip, time)             ((ip)->vmt->gett(ip, time))
+#define chnWriteTimeout(ip, bp, n, time)    ((ip)->vmt->writet(ip, bp, n, time))
+#define chnReadTimeout(ip, bp, n, time)     ((ip)->vmt->readt(ip, bp, n, time))
+#define chnAddFlagsI(ip, flags)             osalEventBroadcastFlagsI(&(ip)->event, flags)
+
+/*===========================================================================*/
+/* Configuration, the tests enable the class drivers from the Makefile.      */
+/*===========================================================================*/
+
+#define HAL_USE_USBH                        TRUE
+
+#define HAL_USBH_PORT_DEBOUNCE_TIME         200
+#define HAL_USBH_PORT_RESET_TIMEOUT         500
+#define HAL_USBH_DEVICE_ADDRESS_STABILIZATION 20
+#define HAL_USBH_CONTROL_REQUEST_DEFAULT_TIMEOUT OSAL_MS2I(1000)
+
+#define HAL_USBHMSD_MAX_LUNS                1
+#define HAL_USBHMSD_MAX_INSTANCES           1
+
+#define HAL_USBHHUB_MAX_INSTANCES           2
+#define HAL_USBHHUB_MAX_PORTS               6
+#define HAL_USBHHID_MAX_INSTANCES           2
+#define HAL_USBHUVC_MAX_INSTANCES           1
+#define HAL_USBHUVC_MAX_MAILBOX_SZ          10
+#define HAL_USBHUVC_WORK_RAM_SIZE           20000
+#define HAL_USBHUVC_STATUS_PACKETS_COUNT    10
+
+#define HAL_USBHFTDI_MAX_PORTS              1
+#define HAL_USBHFTDI_MAX_INSTANCES          1
+#define HAL_USBHFTDI_DEFAULT_SPEED          115200
+#define HAL_USBHFTDI_DEFAULT_FRAMING        (USBHFTDI_FRAMING_DATABITS_8 |     \
+                                             USBHFTDI_FRAMING_PARITY_NONE |   \
+                                             USBHFTDI_FRAMING_STOP_BITS_1)
+#define HAL_USBHFTDI_DEFAULT_HANDSHAKE      USBHFTDI_HANDSHAKE_NONE
+#define HAL_USBHFTDI_DEFAULT_XON            0x11
+#define HAL_USBHFTDI_DEFAULT_XOFF           0x13
+
+#define HAL_USBHAOA_MAX_INSTANCES           1
+#define HAL_USBHAOA_DEFAULT_MANUFACTURER    "ChibiOS"
+#define HAL_USBHAOA_DEFAULT_MODEL           "Host test"
+#define HAL_USBHAOA_DEFAULT_DESCRIPTION     "Host test"
+#define HAL_USBHAOA_DEFAULT_VERSION         "1.0"
+#define HAL_USBHAOA_DEFAULT_URI             NULL
+#define HAL_USBHAOA_DEFAULT_SERIAL          NULL
+#define HAL_USBHAOA_DEFAULT_AUDIO_MODE      USBHAOA_AUDIO_MODE_DISABLED
+
+#define USBH_DEBUG_ENABLE                   FALSE
+#define USBH_DEBUG_MULTI_HOST               FALSE
+#define USBH_DEBUG_ENABLE_TRACE             FALSE
+#define USBH_DEBUG_ENABLE_INFO              FALSE
+#define USBH_DEBUG_ENABLE_WARNINGS          FALSE
+#define USBH_DEBUG_ENABLE_ERRORS            FALSE
+#define USBH_LLD_DEBUG_ENABLE_TRACE         FALSE
+#define USBH_LLD_DEBUG_ENABLE_INFO          FALSE
+#define USBH_LLD_DEBUG_ENABLE_WARNINGS      FALSE
+#define USBH_LLD_DEBUG_ENABLE_ERRORS        FALSE
+#define USBHHUB_DEBUG_ENABLE_TRACE          FALSE
+#define USBHHUB_DEBUG_ENABLE_INFO           FALSE
+#define USBHHUB_DEBUG_ENABLE_WARNINGS       FALSE
+#define USBHHUB_DEBUG_ENABLE_ERRORS         FALSE
+#define USBHMSD_DEBUG_ENABLE_TRACE          FALSE
+#define USBHMSD_DEBUG_ENABLE_INFO           FALSE
+#define USBHMSD_DEBUG_ENABLE_WARNINGS       FALSE
+#define USBHMSD_DEBUG_ENABLE_ERRORS         FALSE
+#define USBHUVC_DEBUG_ENABLE_TRACE          FALSE
+#define USBHUVC_DEBUG_ENABLE_INFO           FALSE
+#define USBHUVC_DEBUG_ENABLE_WARNINGS       FALSE
+#define USBHUVC_DEBUG_ENABLE_ERRORS         FALSE
+#define USBHFTDI_DEBUG_ENABLE_TRACE         FALSE
+#define USBHFTDI_DEBUG_ENABLE_INFO          FALSE
+#define USBHFTDI_DEBUG_ENABLE_WARNINGS      FALSE
+#define USBHFTDI_DEBUG_ENABLE_ERRORS        FALSE
+#define USBHAOA_DEBUG_ENABLE_TRACE          FALSE
+#define USBHAOA_DEBUG_ENABLE_INFO           FALSE
+#define USBHAOA_DEBUG_ENABLE_WARNINGS       FALSE
+#define USBHAOA_DEBUG_ENABLE_ERRORS         FALSE
+#define USBHHID_DEBUG_ENABLE_TRACE          FALSE
+#define USBHHID_DEBUG_ENABLE_INFO           FALSE
+#define USBHHID_DEBUG_ENABLE_WARNINGS       FALSE
+#define USBHHID_DEBUG_ENABLE_ERRORS         FALSE
+
+#include "hal_usbh.h"
+
+#endif /* HAL_H */
@@ -0,0 +1,466 @@
+/*
+    ChibiOS - Copyright (C) 2006..2018 Giovanni Di Sirio
+
+    Licensed under the Apache License, Version 2.0 (the "License");
+    you may not use this file except in compliance with the License.
+    You may obtain a copy of the License at
+
+        http://www.apache.org/licenses/LICENSE-2.0
+
+    Unless required by applicable law or agreed to in writing, software
+    distributed under the License is distributed on an "AS IS" BASIS,
+    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+    See the License for the specific language governing permissions and
+    limitations under the License.
+*/
+
+/*
+ * HID report descriptor parser over descriptors of real devices: a boot
+ * keyboard and a boot mouse (HID 1.11 appendix B), a mouse with report
+ * IDs, 12 bit axes and a vendor collection, a consumer control and a
+ * gamepad with a hat switch. Then two HID devices are loaded at the same
+ * time on two simulated hosts, each with its own main thread, and each
+ * instance must get the fields of its own device.
+ */
+
+#include <string.h>
+
+#include "hal.h"
+#include "usbh/dev/hid.h"
+#include "host_test.h"
+
+/*===========================================================================*/
+/* Report descriptors.                                                       */
+/*===========================================================================*/
+
+static const uint8_t keyboard_desc[] = {
+  0x05, 0x01, 0x09, 0x06, 0xA1, 0x01, 0x05, 0x07, 0x19, 0xE0, 0x29, 0xE7,
+  0x15, 0x00, 0x25, 0x01, 0x75, 0x01, 0x95, 0x08, 0x81, 0x02, 0x95, 0x01,
+  0x75, 0x08, 0x81, 0x01, 0x95, 0x05, 0x75, 0x01, 0x05, 0x08, 0x19, 0x01,
+  0x29, 0x05, 0x91, 0x02, 0x95, 0x01, 0x75, 0x03, 0x91, 0x01, 0x95, 0x06,
+  0x75, 0x08, 0x15, 0x00, 0x25, 0x65, 0x05, 0x07, 0x19, 0x00, 0x29, 0x65,
+  0x81, 0x00, 0xC0
+};
+
+static const uint8_t mouse_desc[] = {
+  0x05, 0x01, 0x09, 0x02, 0xA1, 0x01, 0x09, 0x01, 0xA1, 0x00, 0x05, 0x09,
+  0x19, 0x01, 0x29, 0x03, 0x15, 0x00, 0x25, 0x01, 0x95, 0x03, 0x75, 0x01,
+  0x81, 0x02, 0x95, 0x01, 0x75, 0x05, 0x81, 0x01, 0x05, 0x01, 0x09, 0x30,
+  0x09, 0x31, 0x15, 0x81, 0x25, 0x7F, 0x75, 0x08, 0x95, 0x02, 0x81, 0x06,
+  0xC0, 0xC0
+};
+
+/* Report 2: 16 buttons, 12 bit X and Y, wheel. Report 0x10: vendor, 6
+   bytes each way.*/
+static const uint8_t wheel_mouse_desc[] = {
+  0x05, 0x01, 0x09, 0x02, 0xA1, 0x01, 0x85, 0x02, 0x09, 0x01, 0xA1, 0x00,
+  0x05, 0x09, 0x19, 0x01, 0x29, 0x10, 0x15, 0x00, 0x25, 0x01, 0x95, 0x10,
+  0x75, 0x01, 0x81, 0x02, 0x05, 0x01, 0x16, 0x01, 0xF8, 0x26, 0xFF, 0x07,
+  0x75, 0x0C, 0x95, 0x02, 0x09, 0x30, 0x09, 0x31, 0x81, 0x06, 0x15, 0x81,
+  0x25, 0x7F, 0x75, 0x08, 0x95, 0x01, 0x09, 0x38, 0x81, 0x06, 0xC0, 0xC0,
+  0x06, 0x00, 0xFF, 0x09, 0x01, 0xA1, 0x01, 0x85, 0x10, 0x75, 0x08, 0x95,
+  0x06, 0x15, 0x00, 0x26, 0xFF, 0x00, 0x09, 0x01, 0x81, 0x00, 0x09, 0x01,
+  0x91, 0x00, 0xC0
+};
+
+/* Report 3, one 16 bit consumer usage.*/
+static const uint8_t consumer_desc[] = {
+  0x05, 0x0C, 0x09, 0x01, 0xA1, 0x01, 0x85, 0x03, 0x15, 0x00, 0x26, 0xFF,
+  0x03, 0x19, 0x00, 0x2A, 0xFF, 0x03, 0x75, 0x10, 0x95, 0x01, 0x81, 0x00,
+  0xC0
+};
+
+/* Five 8 bit axes, a hat switch with a null state and physical units, 12
+   buttons, 8 vendor bits, 7 output bytes.*/
+static const uint8_t gamepad_desc[] = {
+  0x05, 0x01, 0x09, 0x04, 0xA1, 0x01, 0xA1, 0x02, 0x75, 0x08, 0x95, 0x05,
+  0x15, 0x00, 0x26, 0xFF, 0x00, 0x35, 0x00, 0x46, 0xFF, 0x00, 0x09, 0x30,
+  0x09, 0x30, 0x09, 0x30, 0x09, 0x30, 0x09, 0x31, 0x81, 0x02, 0x75, 0x04,
+  0x95, 0x01, 0x25, 0x07, 0x46, 0x3B, 0x01, 0x65, 0x14, 0x09, 0x39, 0x81,
+  0x42, 0x65, 0x00, 0x75, 0x01, 0x95, 0x0C, 0x25, 0x01, 0x45, 0x01, 0x05,
+  0x09, 0x19, 0x01, 0x29, 0x0C, 0x81, 0x02, 0x06, 0x00, 0xFF, 0x75, 0x01,
+  0x95, 0x08, 0x25, 0x01, 0x45, 0x01, 0x09, 0x01, 0x81, 0x02, 0xC0, 0xA1,
+  0x02, 0x75, 0x08, 0x95, 0x07, 0x46, 0xFF, 0x00, 0x26, 0xFF, 0x00, 0x09,
+  0x02, 0x91, 0x02, 0xC0, 0xC0
+};
+
+#define GAMEPAD_FIELDS                      33
+
+/*===========================================================================*/
+/* Parser tests.                                                             */
+/*===========================================================================*/
+
+#define MAX_FIELDS                          64
+
+static usbhhid_field_t fields[MAX_FIELDS];
+static int32_t values[MAX_FIELDS];
+
+static bool field_is(const usbhhid_field_t *f, uint32_t usage,
+                     usbhhid_reporttype_t type, uint16_t bit_offset,
+                     uint8_t bit_size, uint8_t flags) {
+
+  return (f->usage == usage) && (f->type == (uint8_t)type) &&
+         (f->bit_offset == bit_offset) && (f->bit_size == bit_size) &&
+         (f->flags == flags);
+}
+
+static void test_keyboard(void) {
+  static const uint8_t report[8] = {0x02, 0x00, 0x04, 0x05, 0, 0, 0, 0};
+  uint16_t n, i;
+
+  HOST_CHECK(usbhhidParseReportDescriptor(keyboard_desc, sizeof(keyboard_desc),
+                                          fields, MAX_FIELDS, &n) ==
+             HAL_SUCCESS, "keyboard: parse");
+  HOST_CHECK(n == 8 + 5 + 6, "keyboard: %u fields", n);
+  for (i = 0; i < 8; i++) {
+    HOST_CHECK(field_is(&fields[i], USBHHID_USAGE(0x07, 0xE0 + i),
+                        USBHHID_REPORTTYPE_INPUT, i, 1,
+                        USBHHID_FIELD_VARIABLE), "keyboard: modifier %u", i);
+  }
+  for (i = 0; i < 5; i++) {
+    HOST_CHECK(field_is(&fields[8 + i], USBHHID_USAGE(0x08, 1 + i),
+                        USBHHID_REPORTTYPE_OUTPUT, i, 1,
+                        USBHHID_FIELD_VARIABLE), "keyboard: LED %u", i);
+  }
+  for (i = 0; i < 6; i++) {
+    HOST_CHECK(field_is(&fields[13 + i], USBHHID_USAGE(0x07, 0),
+                        USBHHID_REPORTTYPE_INPUT, 16 + 8 * i, 8, 0) &&
+               (fields[13 + i].logical_max == 0x65), "keyboard: key %u", i);
+  }
+
+  memset(values, 0, sizeof(values));
+  HOST_CHECK(usbhhidDecodeFields(fields, n, USBHHID_REPORTTYPE_INPUT, report,
+                                 sizeof(report), values) == 14,
+             "keyboard: decode");
+  HOST_CHECK((values[0] == 0) && (values[1] == 1) && (values[13] == 4) &&
+             (values[14] == 5) && (values[15] == 0), "keyboard: values");
+}
+
+static void test_mouse(void) {
+  static const uint8_t report[3] = {0x01, 0xFE, 0x03};
+  const uint8_t rel = USBHHID_FIELD_VARIABLE | USBHHID_FIELD_RELATIVE |
+                      USBHHID_FIELD_SIGNED;
+  uint16_t n;
+
+  HOST_CHECK(usbhhidParseReportDescriptor(mouse_desc, sizeof(mouse_desc),
+                                          fields, MAX_FIELDS, &n) ==
+             HAL_SUCCESS, "mouse: parse");
+  HOST_CHECK(n == 5, "mouse: %u fields", n);
+  HOST_CHECK(field_is(&fields[2], USBHHID_USAGE(0x09, 3),
+                      USBHHID_REPORTTYPE_INPUT, 2, 1, USBHHID_FIELD_VARIABLE),
+             "mouse: button 3");
+  HOST_CHECK(field_is(&fields[3], USBHHID_USAGE(0x01, 0x30),
+                      USBHHID_REPORTTYPE_INPUT, 8, 8, rel) &&
+             (fields[3].logical_min == -127) &&
+             (fields[3].logical_max == 127), "mouse: X");
+  HOST_CHECK(field_is(&fields[4], USBHHID_USAGE(0x01, 0x31),
+                      USBHHID_REPORTTYPE_INPUT, 16, 8, rel), "mouse: Y");
+
+  HOST_CHECK(usbhhidDecodeFields(fields, n, USBHHID_REPORTTYPE_INPUT, report,
+                                 sizeof(report), values) == 5,
+             "mouse: decode");
+  HOST_CHECK((values[0] == 1) && (values[1] == 0) && (values[3] == -2) &&
+             (values[4] == 3), "mouse: values");
+}
+
+static void test_wheel_mouse(void) {
+  static const uint8_t motion[7] = {0x02, 0x01, 0x00, 0xFD, 0x5F, 0x00, 0xFF};
+  static const uint8_t vendor[7] = {0x10, 1, 2, 3, 4, 5, 250};
+  const usbhhid_field_t *x, *y;
+  uint16_t n;
+
+  HOST_CHECK(usbhhidParseReportDescriptor(wheel_mouse_desc,
+                                          sizeof(wheel_mouse_desc), fields,
+                                          MAX_FIELDS, &n) == HAL_SUCCESS,
+             "wheel mouse: parse");
+  HOST_CHECK(n == 16 + 3 + 6 + 6, "wheel mouse: %u fields", n);
+  x = usbhhidFindField(fields, n, USBHHID_REPORTTYPE_INPUT,
+                       USBHHID_USAGE(0x01, 0x30));
+  y = usbhhidFindField(fields, n, USBHHID_REPORTTYPE_INPUT,
+                       USBHHID_USAGE(0x01, 0x31));
+  HOST_CHECK((x != NULL) && (y != NULL), "wheel mouse: axes not found");
+  if ((x == NULL) || (y == NULL)) {
+    return;
+  }
+  HOST_CHECK((x->bit_offset == 16) && (y->bit_offset == 28) &&
+             (x->bit_size == 12) && (x->report_id == 2) &&
+             (x->flags & USBHHID_FIELD_SIGNED) &&
+             (x->logical_min == -2047) && (x->logical_max == 2047),
+             "wheel mouse: axes layout");
+
+  memset(values, 0, sizeof(values));
+  HOST_CHECK(usbhhidDecodeFields(fields, n, USBHHID_REPORTTYPE_INPUT, motion,
+                                 sizeof(motion), values) == 19,
+             "wheel mouse: decode");
+  HOST_CHECK((values[0] == 1) && (values[x - fields] == -3) &&
+             (values[y - fields] == 5) && (values[18] == -1),
+             "wheel mouse: values");
+
+  /* Other report ID, the motion values are left untouched.*/
+  HOST_CHECK(usbhhidDecodeFields(fields, n, USBHHID_REPORTTYPE_INPUT, vendor,
+                                 sizeof(vendor), values) == 6,
+             "wheel mouse: vendor decode");
+  HOST_CHECK((values[19] == 1) && (values[24] == 250) &&
+             (fields[24].logical_max == 255) && (values[x - fields] == -3),
+             "wheel mouse: vendor values");
+
+  /* Short report, the fields past its end are skipped.*/
+  HOST_CHECK(usbhhidDecodeFields(fields, n, USBHHID_REPORTTYPE_INPUT, motion,
+                                 3, values) == 16, "wheel mouse: short");
+
+  /* Table too small and truncated descriptor.*/
+  HOST_CHECK((usbhhidParseReportDescriptor(wheel_mouse_desc,
+                                           sizeof(wheel_mouse_desc), fields,
+                                           10, &n) == HAL_FAILED) &&
+             (n == 10), "wheel mouse: overflow");
+  HOST_CHECK(usbhhidParseReportDescriptor(wheel_mouse_desc, 33, fields,
+                                          MAX_FIELDS, &n) == HAL_FAILED,
+             "wheel mouse: truncated");
+}
+
+static void test_consumer(void) {
+  static const uint8_t report[3] = {0x03, 0xE9, 0x00};
+  uint16_t n;
+
+  HOST_CHECK(usbhhidParseReportDescriptor(consumer_desc, sizeof(consumer_desc),
+                                          fields, MAX_FIELDS, &n) ==
+             HAL_SUCCESS, "consumer: parse");
+  HOST_CHECK((n == 1) &&
+             field_is(&fields[0], USBHHID_USAGE(0x0C, 0),
+                      USBHHID_REPORTTYPE_INPUT, 0, 16, 0) &&
+             (fields[0].report_id == 3) && (fields[0].logical_max == 0x3FF),
+             "consumer: layout");
+  HOST_CHECK((usbhhidDecodeFields(fields, n, USBHHID_REPORTTYPE_INPUT, report,
+                                  sizeof(report), values) == 1) &&
+             (fields[0].usage + values[0] - fields[0].logical_min ==
+              USBHHID_USAGE(0x0C, 0xE9)), "consumer: volume up");
+}
+
+static void test_gamepad(void) {
+  static const uint8_t report[8] = {0x80, 0x80, 0x7F, 0x80, 0x80, 0x1F, 0x02,
+                                    0x00};
+  uint16_t n, i;
+
+  HOST_CHECK(usbhhidParseReportDescriptor(gamepad_desc, sizeof(gamepad_desc),
+                                          fields, MAX_FIELDS, &n) ==
+             HAL_SUCCESS, "gamepad: parse");
+  HOST_CHECK(n == GAMEPAD_FIELDS, "gamepad: %u fields", n);
+  HOST_CHECK(field_is(&fields[0], USBHHID_USAGE(0x01, 0x30),
+                      USBHHID_REPORTTYPE_INPUT, 0, 8, USBHHID_FIELD_VARIABLE) &&
+             field_is(&fields[4], USBHHID_USAGE(0x01, 0x31),
+                      USBHHID_REPORTTYPE_INPUT, 32, 8, USBHHID_FIELD_VARIABLE),
+             "gamepad: axes");
+  HOST_CHECK(field_is(&fields[5], USBHHID_USAGE(0x01, 0x39),
+                      USBHHID_REPORTTYPE_INPUT, 40, 4,
+                      USBHHID_FIELD_VARIABLE | USBHHID_FIELD_NULL_STATE) &&
+             (fields[5].logical_max == 7), "gamepad: hat");
+  for (i = 0; i < 12; i++) {
+    HOST_CHECK(field_is(&fields[6 + i], USBHHID_USAGE(0x09, 1 + i),
+                        USBHHID_REPORTTYPE_INPUT, 44 + i, 1,
+                        USBHHID_FIELD_VARIABLE), "gamepad: button %u", i + 1);
+  }
+  HOST_CHECK(field_is(&fields[25], USBHHID_USAGE(0xFF00, 1),
+                      USBHHID_REPORTTYPE_INPUT, 63, 1, USBHHID_FIELD_VARIABLE),
+             "gamepad: vendor bits");
+  HOST_CHECK(field_is(&fields[32], USBHHID_USAGE(0xFF00, 2),
+                      USBHHID_REPORTTYPE_OUTPUT, 48, 8,
+                      USBHHID_FIELD_VARIABLE), "gamepad: output");
+
+  memset(values, 0, sizeof(values));
+  HOST_CHECK(usbhhidDecodeFields(fields, n, USBHHID_REPORTTYPE_INPUT, report,
+                                 sizeof(report), values) == 26,
+             "gamepad: decode");
+  HOST_CHECK((values[0] == 0x80) && (values[2] == 0x7F) &&
+             (values[5] == 15) && (values[6] == 1) && (values[7] == 0) &&
+             (values[11] == 1), "gamepad: values");
+}
+
+/*===========================================================================*/
+/* Simulated devices.                                                        */
+/*===========================================================================*/
+
+/* A report descriptor request waits up to this long for the one of the
+   other device, so that without serialization both are on the bus at the
+   same time.*/
+#define RENDEZVOUS_MS                       20
+
+typedef struct {
+  const uint8_t             *report_desc;
+  uint16_t                  report_desc_len;
+  uint16_t                  fields;
+  bool                      asked;
+  systime_t                 asked_time;
+} hid_dev_t;
+
+static hid_dev_t hid_devs[2] = {
+  {keyboard_desc, sizeof(keyboard_desc), 19, false, 0},
+  {gamepad_desc, sizeof(gamepad_desc), GAMEPAD_FIELDS, false, 0}
+};
+
+static const uint8_t hid_device_descriptor[] = {
+  18, USBH_DT_DEVICE,
+  0x00, 0x02,                               /* bcdUSB */
+  0x00, 0x00, 0x00, 64,
+  0x83, 0x04,                               /* idVendor */
+  0x40, 0x57,                               /* idProduct */
+  0x00, 0x01,                               /* bcdDevice */
+  1, 2, 0, 1
+};
+
+#define HID_CONFIG(subclass, protocol, desc)                                \
+  {                                                                         \
+    9, USBH_DT_CONFIG, 34, 0, 1, 1, 0, 0x80, 50,                            \
+    9, USBH_DT_INTERFACE, 0, 0, 1, 0x03, subclass, protocol, 0,             \
+    9, 0x21, 0x11, 0x01, 0, 1, 0x22, sizeof(desc) & 0xFF, sizeof(desc) >> 8, \
+    7, USBH_DT_ENDPOINT, 0x81, USBH_EPTYPE_INT, 8, 0, 10                    \
+  }
+
+static const uint8_t keyboard_config_descriptor[] =
+    HID_CONFIG(0x01, 0x01, keyboard_desc);
+static const uint8_t gamepad_config_descriptor[] =
+    HID_CONFIG(0x00, 0x00, gamepad_desc);
+
+static const char *const hid_strings[] = {"ChibiOS", "Simulated HID"};
+
+static usbhsim_response_t hid_control(usbhsim_device_t *sdp,
+                                      const usbh_control_request_t *req,
+                                      uint8_t *buf, uint32_t *len) {
+  hid_dev_t *const hdp = (hid_dev_t *)sdp->user;
+  hid_dev_t *const other = hdp == &hid_devs[0] ? &hid_devs[1] : &hid_devs[0];
+
+  if ((req->bmRequestType == 0x81) && (req->bRequest == USBH_REQ_GET_DESCRIPTOR) &&
+      ((req->wValue >> 8) == 0x22)) {
+    if (!hdp->asked) {
+      hdp->asked = true;
+      hdp->asked_time = chVTGetSystemTimeX();
+    }
+    if (!other->asked &&
+        (chVTTimeElapsedSinceX(hdp->asked_time) < OSAL_MS2I(RENDEZVOUS_MS))) {
+      return USBHSIM_NAK;
+    }
+    if (*len > hdp->report_desc_len) {
+      *len = hdp->report_desc_len;
+    }
+    memcpy(buf, hdp->report_desc, *len);
+    return USBHSIM_ACK;
+  }
+  if ((req->bmRequestType & 0x60U) == 0x20U) {
+    return USBHSIM_ACK;
+  }
+  return USBHSIM_STALL;
+}
+
+static usbhsim_response_t hid_transfer(usbhsim_device_t *sdp, uint8_t ep,
+                                       uint8_t *buf, uint32_t len,
+                                       uint32_t *actual) {
+
+  (void)sdp;
+  (void)ep;
+  (void)buf;
+  (void)len;
+  (void)actual;
+  return USBHSIM_NAK;
+}
+
+static const usbhsim_config_t hid_configs[2] = {
+  {
+    USBH_DEVSPEED_FULL,
+    hid_device_descriptor,
+    keyboard_config_descriptor,
+    hid_strings, 2,
+    hid_control,
+    hid_transfer
+  }, {
+    USBH_DEVSPEED_FULL,
+    hid_device_descriptor,
+    gamepad_config_descriptor,
+    hid_strings, 2,
+    hid_control,
+    hid_transfer
+  }
+};
+
+static usbhsim_device_t sim_devs[2];
+
+/*===========================================================================*/
+/* Concurrent loads.                                                         */
+/*===========================================================================*/
+
+/* Instance loaded on the host, NULL if none.*/
+static USBHHIDDriver *hid_on(USBHDriver *host) {
+  unsigned i;
+
+  for (i = 0; i < HAL_USBHHID_MAX_INSTANCES; i++) {
+    if ((USBHHIDD[i].dev != NULL) && (USBHHIDD[i].dev->host == host) &&
+        (usbhhidGetState(&USBHHIDD[i]) == USBHHID_STATE_ACTIVE)) {
+      return &USBHHIDD[i];
+    }
+  }
+  return NULL;
+}
+
+static void test_concurrent_loads(void) {
+  USBHDriver *const hosts[2] = {&USBHD1, &USBHD2};
+  USBHHIDDriver *hidp;
+  uint16_t n, count;
+  unsigned i, ms;
+
+  for (i = 0; i < 2; i++) {
+    usbhsimDeviceObjectInit(&sim_devs[i], &hid_configs[i], &hid_devs[i]);
+  }
+  usbhsimAttach(&USBHD1, &sim_devs[0]);
+  usbhsimAttach(&USBHD2, &sim_devs[1]);
+  for (ms = 0; (ms < 5000) && ((hid_on(&USBHD1) == NULL) ||
+                               (hid_on(&USBHD2) == NULL)); ms++) {
+    chThdSleepMilliseconds(1);
+  }
+
+  for (i = 0; i < 2; i++) {
+    hidp = hid_on(hosts[i]);
+    HOST_CHECK(hidp != NULL, "host %u: HID not loaded", i + 1);
+    if (hidp == NULL) {
+      continue;
+    }
+    HOST_CHECK(hid_devs[i].asked, "host %u: report descriptor not read",
+               i + 1);
+    usbhhidGetFields(hidp, &count);
+    HOST_CHECK(count == hid_devs[i].fields, "host %u: %u fields", i + 1,
+               count);
+    HOST_CHECK((usbhhidParseReportDescriptor(hid_devs[i].report_desc,
+                                             hid_devs[i].report_desc_len,
+                                             fields, MAX_FIELDS, &n) ==
+                HAL_SUCCESS) && (n == count) &&
+               (memcmp(fields, hidp->fields, n * sizeof(fields[0])) == 0),
+               "host %u: fields of the other device", i + 1);
+  }
+
+  usbhsimDetach(&USBHD1);
+  usbhsimDetach(&USBHD2);
+  for (ms = 0; (ms < 5000) && ((hid_on(&USBHD1) != NULL) ||
+                               (hid_on(&USBHD2) != NULL)); ms++) {
+    chThdSleepMilliseconds(1);
+  }
+  HOST_CHECK((hid_on(&USBHD1) == NULL) && (hid_on(&USBHD2) == NULL),
+             "HID not unloaded");
+}
+
+int main(int argc, char *argv[]) {
+
+  hostInit(argc, argv);
+  chSysInit();
+
+  test_keyboard();
+  test_mouse();
+  test_wheel_mouse();
+  test_consumer();
+  test_gamepad();
+
+  usbhInit();
+  usbhStart(&USBHD1);
+  usbhStart(&USBHD2);
+  test_concurrent_loads();
+  usbhStop(&USBHD1);
+  usbhStop(&USBHD2);
+
+  return hostReport(argv[0]);
+}
@@ -0,0 +1,238 @@
+/*
+    ChibiOS - Copyright (C) 2006..2018 Giovanni Di Sirio
+
+    Licensed under the Apache License, Version 2.0 (the "License");
+    you may not use this file except in compliance with the License.
+    You may obtain a copy of the License at
+
+        http://www.apache.org/licenses/LICENSE-2.0
+
+    Unless required by applicable law or agreed to in writing, software
+    distributed under the License is distributed on an "AS IS" BASIS,
+    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+    See the License for the specific language governing permissions and
+    limitations under the License.
+*/
+
+/*
+ * Hot-plug latency of the USB host stack over the simulated host
+ * controller: virtual time from the attach of the scripted disk to the
+ * mass storage driver being loaded, and from the detach to the unload.
+ * Without HAL_USBH_USE_MAIN_THREAD the application calls usbhMainLoop()
+ * at several periods, with it the internal thread is woken by the port
+ * change event. The main loop passes made by an idle host are counted
+ * through the root hub status poll, the program is linked with
+ * --wrap=usbh_lld_roothub_get_statuschange_bitmap.
+ */
+
+#include "hal.h"
+#include "usbh/dev/msd.h"
+#include "disk.h"
+#include "host_test.h"
+
+/*===========================================================================*/
+/* Main loop passes.                                                         */
+/*===========================================================================*/
+
+static unsigned passes;
+
+uint8_t __real_usbh_lld_roothub_get_statuschange_bitmap(USBHDriver *usbh);
+uint8_t __wrap_usbh_lld_roothub_get_statuschange_bitmap(USBHDriver *usbh);
+
+uint8_t __wrap_usbh_lld_roothub_get_statuschange_bitmap(USBHDriver *usbh) {
+
+  passes++;
+  return __real_usbh_lld_roothub_get_statuschange_bitmap(usbh);
+}
+
+/*===========================================================================*/
+/* Helpers.                                                                  */
+/*===========================================================================*/
+
+#define TRIALS                              8
+#define IDLE_TIME_MS                        10000
+
+static USBHMassStorageLUNDriver *const lunp = &MSBLKD[0];
+static usbhsim_device_t disk_dev;
+
+typedef struct {
+  unsigned                  min;
+  unsigned                  max;
+  unsigned                  sum;
+} latency_t;
+
+static void latency_reset(latency_t *lp) {
+
+  lp->min = ~0U;
+  lp->max = 0U;
+  lp->sum = 0U;
+}
+
+static void latency_add(latency_t *lp, unsigned ms) {
+
+  if (ms < lp->min) {
+    lp->min = ms;
+  }
+  if (ms > lp->max) {
+    lp->max = ms;
+  }
+  lp->sum += ms;
+}
+
+/* Milliseconds until the LUN reaches the state, ~0 after 5s. The state is
+   sampled every millisecond, this thread does not run the main loop.*/
+static unsigned wait_lun_state(blkstate_t state) {
+  unsigned ms;
+
+  for (ms = 0; ms < 5000; ms++) {
+    if (lunp->state == state) {
+      return ms;
+    }
+    chThdSleepMilliseconds(1);
+  }
+  return ~0U;
+}
+
+#if !HAL_USBH_USE_MAIN_THREAD
+static sysinterval_t poll_period;
+static THD_WORKING_AREA(waPoller, 1024);
+
+/* Application side main loop.*/
+static THD_FUNCTION(poller, arg) {
+
+  (void)arg;
+  chRegSetThreadName("poller");
+  while (!chThdShouldTerminateX()) {
+    usbhMainLoop(&USBHD1);
+    chThdSleep(poll_period);
+  }
+}
+#endif
+
+/*===========================================================================*/
+/* Tests.                                                                    */
+/*===========================================================================*/
+
+/* Attaches and detaches the disk TRIALS times at random offsets from the
+   main loop passes, then leaves the host idle with the disk attached.*/
+static void run(const char *name, latency_t *load, latency_t *unload,
+                unsigned *idle) {
+  unsigned i, ms, before;
+
+  latency_reset(load);
+  latency_reset(unload);
+  for (i = 0; i < TRIALS; i++) {
+    chThdSleepMilliseconds(hostRand() % 100U);
+    usbhsimAttach(&USBHD1, &disk_dev);
+    ms = wait_lun_state(BLK_ACTIVE);
+    HOST_CHECK(ms != ~0U, "%s: disk not loaded", name);
+    latency_add(load, ms);
+
+    chThdSleepMilliseconds(hostRand() % 100U);
+    usbhsimDetach(&USBHD1);
+    ms = wait_lun_state(BLK_STOP);
+    HOST_CHECK(ms != ~0U, "%s: disk not unloaded", name);
+    latency_add(unload, ms);
+  }
+
+  usbhsimAttach(&USBHD1, &disk_dev);
+  HOST_CHECK(wait_lun_state(BLK_ACTIVE) != ~0U, "%s: disk not loaded", name);
+  chThdSleepMilliseconds(100);
+  before = passes;
+  chThdSleepMilliseconds(IDLE_TIME_MS);
+  *idle = passes - before;
+  usbhsimDetach(&USBHD1);
+  HOST_CHECK(wait_lun_state(BLK_STOP) != ~0U, "%s: disk not unloaded", name);
+}
+
+static void report(const char *name, const latency_t *load,
+                   const latency_t *unload, unsigned idle) {
+
+  if (host_bench) {
+    printf("  %-16s load %4u/%4u/%4u ms  unload %4u/%4u/%4u ms  "
+           "idle passes %5u/%us\n", name,
+           load->min, load->sum / TRIALS, load->max,
+           unload->min, unload->sum / TRIALS, unload->max,
+           idle, IDLE_TIME_MS / 1000U);
+  }
+}
+
+#if HAL_USBH_USE_MAIN_THREAD
+static void test_main_thread(void) {
+  static const char *const name = "main thread";
+  event_listener_t el;
+  latency_t load, unload;
+  unsigned idle;
+
+  chEvtRegisterMaskWithFlags(usbhGetEventSource(&USBHD1), &el,
+                             EVENT_MASK(1), USBH_EVENT_PORT_CHANGE);
+  run(name, &load, &unload, &idle);
+  HOST_CHECK(chEvtGetAndClearFlags(&el) & USBH_EVENT_PORT_CHANGE,
+             "no port change event");
+  chEvtUnregister(usbhGetEventSource(&USBHD1), &el);
+  report(name, &load, &unload, idle);
+
+  /* Only the enumeration delays are left.*/
+  HOST_CHECK(load.max - load.min <= 2U, "load jitter %u..%u ms",
+             load.min, load.max);
+  HOST_CHECK(unload.max <= 2U, "unload latency %u ms", unload.max);
+  HOST_CHECK(idle == 0U, "%u passes on an idle host", idle);
+}
+#else
+static void test_polled(void) {
+  static const unsigned periods[] = {1, 10, 50, 100};
+  latency_t load, unload;
+  unsigned i, idle, base = 0U;
+  char name[16];
+
+  for (i = 0; i < sizeof(periods) / sizeof(periods[0]); i++) {
+    thread_t *tp;
+
+    poll_period = OSAL_MS2I(periods[i]);
+    tp = chThdCreateStatic(waPoller, sizeof(waPoller), NORMALPRIO, poller,
+                           NULL);
+    snprintf(name, sizeof(name), "polled %ums", periods[i]);
+    run(name, &load, &unload, &idle);
+    chThdTerminate(tp);
+    chThdWait(tp);
+    report(name, &load, &unload, idle);
+
+    /* The attach waits up to a period for the next pass.*/
+    if (i == 0U) {
+      base = load.min;
+    }
+    HOST_CHECK(load.max <= base + periods[i] + 2U,
+               "%s: load latency %u ms, %u ms at 1ms", name, load.max, base);
+    HOST_CHECK(unload.max <= periods[i] + 2U, "%s: unload latency %u ms",
+               name, unload.max);
+    HOST_CHECK(idle + 1U >= IDLE_TIME_MS / periods[i], "%s: %u idle passes",
+               name, idle);
+  }
+}
+#endif
+
+int main(int argc, char *argv[]) {
+
+  hostInit(argc, argv);
+  chSysInit();
+  usbhInit();
+  usbhStart(&USBHD1);
+  usbhsimDeviceObjectInit(&disk_dev, &disk_config, NULL);
+
+  if (host_bench) {
+    printf("%s: attach to load / detach to unload, min/avg/max of %u\n",
+           argv[0], TRIALS);
+  }
+#if HAL_USBH_USE_MAIN_THREAD
+  test_main_thread();
+#else
+  test_polled();
+#endif
+
+  usbhStop(&USBHD1);
+#if HAL_USBH_USE_MAIN_THREAD
+  HOST_CHECK(USBHD1.main_thread == NULL, "main thread not joined");
+#endif
+
+  return hostReport(argv[0]);
+}
@@ -0,0 +1,367 @@
+/*
+    ChibiOS - Copyright (C) 2006..2018 Giovanni Di Sirio
+
+    Licensed under the Apache License, Version 2.0 (the "License");
+    you may not use this file except in compliance with the License.
+    You may obtain a copy of the License at
+
+        http://www.apache.org/licenses/LICENSE-2.0
+
+    Unless required by applicable law or agreed to in writing, software
+    distributed under the License is distributed on an "AS IS" BASIS,
+    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+    See the License for the specific language governing permissions and
+    limitations under the License.
+*/
+
+/*
+ * Enumeration through the hub model of the simulated host controller: the
+ * hub on the root port with a scripted vendor device behind port 1, then
+ * a device on every port, hot-plug behind the hub and the hub detached
+ * and attached again. Each device must end up configured at an address
+ * of its own, the one the simulated device answers at, and answer a
+ * vendor request through the hub. The virtual time of each enumeration
+ * and the bus statistics are reported.
+ */
+
+#include <string.h>
+
+#include "hal.h"
+#include "usbh/dev/hub.h"
+#include "usbh/internal.h"
+#include "host_test.h"
+
+/*===========================================================================*/
+/* Scripted device.                                                          */
+/*===========================================================================*/
+
+#define DEV_VID                             0x0483U
+#define DEV_PID                             0x5740U
+#define DEV_REQ_ECHO                        0x01U
+#define DEV_MAGIC                           0xC5U
+
+/* Vendor specific device without endpoints, no class driver claims it.*/
+static const uint8_t dev_device_descriptor[] = {
+  18, USBH_DT_DEVICE,
+  0x00, 0x02,                               /* bcdUSB */
+  0xFF, 0x00, 0x00, 64,
+  DEV_VID & 0xFFU, DEV_VID >> 8,            /* idVendor */
+  DEV_PID & 0xFFU, DEV_PID >> 8,            /* idProduct */
+  0x00, 0x01,                               /* bcdDevice */
+  1, 2, 0, 1
+};
+
+static const uint8_t dev_config_descriptor[] = {
+  9, USBH_DT_CONFIG, 18, 0, 1, 1, 0, 0x80, 50,
+  9, USBH_DT_INTERFACE, 0, 0, 0, 0xFF, 0x00, 0x00, 0
+};
+
+static const char *const dev_strings[] = {"ChibiOS", "Simulated device"};
+
+/* The echo request returns the address the device answers at, the
+   request value and a magic.*/
+static usbhsim_response_t dev_control(usbhsim_device_t *sdp,
+                                      const usbh_control_request_t *req,
+                                      uint8_t *buf, uint32_t *len) {
+
+  if ((req->bmRequestType != (USBH_REQTYPE_DIR_IN | USBH_REQTYPE_TYPE_VENDOR |
+                              USBH_REQTYPE_RECIP_DEVICE)) ||
+      (req->bRequest != DEV_REQ_ECHO) || (*len < 4U)) {
+    return USBHSIM_STALL;
+  }
+  buf[0] = sdp->address;
+  buf[1] = (uint8_t)req->wValue;
+  buf[2] = (uint8_t)(req->wValue >> 8);
+  buf[3] = DEV_MAGIC;
+  *len = 4;
+  return USBHSIM_ACK;
+}
+
+static usbhsim_response_t dev_transfer(usbhsim_device_t *sdp, uint8_t ep,
+                                       uint8_t *buf, uint32_t len,
+                                       uint32_t *actual) {
+
+  (void)sdp;
+  (void)ep;
+  (void)buf;
+  (void)len;
+  (void)actual;
+  return USBHSIM_STALL;
+}
+
+static const usbhsim_config_t dev_config = {
+  USBH_DEVSPEED_FULL,
+  dev_device_descriptor,
+  dev_config_descriptor,
+  dev_strings, 2,
+  dev_control,
+  dev_transfer
+};
+
+/*===========================================================================*/
+/* Helpers.                                                                  */
+/*===========================================================================*/
+
+#define HUB_PORTS                           HAL_USBHHUB_MAX_PORTS
+#define ENUM_TIMEOUT_MS                     30000U
+
+static usbhsim_hub_t hub;
+static usbhsim_device_t devices[HUB_PORTS];
+static usbhsim_device_t *plugged[HUB_PORTS + 1];
+static unsigned all_ms;
+
+static void plug(unsigned port, usbhsim_device_t *dev) {
+
+  usbhsimHubAttach(&hub, (uint8_t)port, dev);
+  plugged[port] = dev;
+}
+
+static void unplug(unsigned port) {
+
+  usbhsimHubDetach(&hub, (uint8_t)port);
+  plugged[port] = NULL;
+}
+
+/* One pass of the host, the internal thread runs it when enabled.*/
+static void host_pass(void) {
+
+#if !HAL_USBH_USE_MAIN_THREAD
+  usbhMainLoop(&USBHD1);
+#endif
+  chThdSleepMilliseconds(1);
+}
+
+static usbh_port_t *hub_port(unsigned number) {
+  usbh_port_t *port;
+
+  for (port = USBHHUBD[0].ports; port != NULL; port = port->next) {
+    if (port->number == number) {
+      return port;
+    }
+  }
+  return NULL;
+}
+
+/* Devices configured behind the hub, zero while the hub driver is not
+   loaded.*/
+static unsigned configured(void) {
+  usbh_port_t *port;
+  unsigned n = 0;
+
+  if (USBHHUBD[0].dev == NULL) {
+    return 0;
+  }
+  for (port = USBHHUBD[0].ports; port != NULL; port = port->next) {
+    if (port->device.status == USBH_DEVSTATUS_CONFIGURED) {
+      n++;
+    }
+  }
+  return n;
+}
+
+/* Milliseconds until n devices are configured behind the hub, ~0 on
+   timeout.*/
+static unsigned wait_configured(unsigned n) {
+  systime_t start = chVTGetSystemTimeX();
+
+  while (configured() != n) {
+    if (chVTTimeElapsedSinceX(start) > TIME_MS2I(ENUM_TIMEOUT_MS)) {
+      return ~0U;
+    }
+    host_pass();
+  }
+  return (unsigned)TIME_I2MS(chVTTimeElapsedSinceX(start));
+}
+
+static bool wait_unloaded(void) {
+  systime_t start = chVTGetSystemTimeX();
+
+  while (USBHHUBD[0].dev != NULL) {
+    if (chVTTimeElapsedSinceX(start) > TIME_MS2I(ENUM_TIMEOUT_MS)) {
+      return false;
+    }
+    host_pass();
+  }
+  return true;
+}
+
+/* Checks the hub and the devices on the ports of the mask: configured,
+   at distinct addresses, the ones the simulated devices answer at, and
+   reachable through the hub.*/
+static void check_tree(const char *name, unsigned mask) {
+  uint8_t used[128] = {0};
+  const usbh_device_t *hdev = USBHHUBD[0].dev;
+  usbh_port_t *port;
+  unsigned i;
+
+  HOST_CHECK((hdev != NULL) && (hdev->devDesc.idVendor == 0x1209U) &&
+             (hdev->devDesc.bDeviceClass == 0x09U) && (hdev->address != 0U) &&
+             (hdev->address == hub.dev.address),
+             "%s: hub not enumerated", name);
+  if (hdev == NULL) {
+    return;
+  }
+  used[hdev->address] = 1;
+
+  for (i = 1; i <= HUB_PORTS; i++) {
+    uint8_t buf[4];
+    usbh_urbstatus_t st;
+
+    port = hub_port(i);
+    if ((mask & (1U << i)) == 0U) {
+      HOST_CHECK((port == NULL) ||
+                 (port->device.status != USBH_DEVSTATUS_CONFIGURED),
+                 "%s: port %u configured", name, i);
+      continue;
+    }
+    if ((port == NULL) ||
+        (port->device.status != USBH_DEVSTATUS_CONFIGURED)) {
+      HOST_CHECK(false, "%s: port %u not configured", name, i);
+      continue;
+    }
+    HOST_CHECK((port->device.devDesc.idVendor == DEV_VID) &&
+               (port->device.devDesc.idProduct == DEV_PID) &&
+               (port->device.speed == USBH_DEVSPEED_FULL),
+               "%s: port %u descriptor", name, i);
+    HOST_CHECK((port->device.address != 0U) &&
+               (used[port->device.address & 0x7FU] == 0U) &&
+               (port->device.address == plugged[i]->address) &&
+               (plugged[i]->configuration == 1U),
+               "%s: port %u at address %u, simulated device at %u", name, i,
+               port->device.address, plugged[i]->address);
+    used[port->device.address & 0x7FU] = 1;
+
+    memset(buf, 0, sizeof(buf));
+    st = usbhControlRequest(&port->device,
+                            USBH_REQTYPE_DIR_IN | USBH_REQTYPE_TYPE_VENDOR |
+                            USBH_REQTYPE_RECIP_DEVICE,
+                            DEV_REQ_ECHO, (uint16_t)(0x100U + i), 0,
+                            sizeof(buf), buf);
+    HOST_CHECK((st == USBH_URBSTATUS_OK) &&
+               (buf[0] == port->device.address) && (buf[1] == i) &&
+               (buf[2] == 1U) && (buf[3] == DEV_MAGIC),
+               "%s: port %u vendor request, status %d", name, i, (int)st);
+  }
+}
+
+static void report(const char *what, unsigned ms) {
+
+  if (host_bench) {
+    printf("  %-34s %5u ms\n", what, ms);
+  }
+}
+
+/*===========================================================================*/
+/* Tests.                                                                    */
+/*===========================================================================*/
+
+static void test_one(void) {
+  unsigned ms;
+
+  plug(1, &devices[0]);
+  usbhsimAttach(&USBHD1, usbhsimHubGetDevice(&hub));
+  ms = wait_configured(1);
+  HOST_CHECK(ms != ~0U, "hub and device not enumerated");
+  check_tree("one device", 1U << 1);
+  report("hub and one device", ms);
+}
+
+static void test_all(void) {
+  unsigned i;
+
+  for (i = 2; i <= HUB_PORTS; i++) {
+    plug(i, &devices[i - 1U]);
+  }
+  all_ms = wait_configured(HUB_PORTS);
+  HOST_CHECK(all_ms != ~0U, "ports not enumerated");
+  check_tree("all ports", ((1U << HUB_PORTS) - 1U) << 1);
+  report("devices on the other ports", all_ms);
+}
+
+static void test_hotplug(void) {
+  unsigned all = ((1U << HUB_PORTS) - 1U) << 1;
+  unsigned ms;
+
+  unplug(3);
+  HOST_CHECK(wait_configured(HUB_PORTS - 1U) != ~0U, "port 3 not unloaded");
+  check_tree("port 3 detached", all & ~(1U << 3));
+
+  plug(3, &devices[2]);
+  ms = wait_configured(HUB_PORTS);
+  HOST_CHECK(ms != ~0U, "port 3 not enumerated");
+  check_tree("port 3 attached again", all);
+  report("device attached to a running hub", ms);
+
+#if HAL_USBH_USE_PARALLEL_ENUMERATION
+  /* The other ports enumerated together, not one after the other.*/
+  HOST_CHECK(all_ms < 3U * ms, "%u ms for %u ports, %u ms for one", all_ms,
+             HUB_PORTS - 1U, ms);
+#endif
+}
+
+/* A hub attached again comes back powered off with its devices at the
+   default address. The devices of the first and last ports are swapped
+   meanwhile, so that the addresses they had are given to other devices.*/
+static void test_reattach(void) {
+  unsigned all = ((1U << HUB_PORTS) - 1U) << 1;
+  unsigned i, ms;
+
+  usbhsimDetach(&USBHD1);
+  HOST_CHECK(wait_unloaded(), "hub not unloaded");
+  unplug(1);
+  unplug(HUB_PORTS);
+  plug(1, &devices[HUB_PORTS - 1U]);
+  plug(HUB_PORTS, &devices[0]);
+
+  usbhsimAttach(&USBHD1, usbhsimHubGetDevice(&hub));
+  for (i = 1; i <= HUB_PORTS; i++) {
+    HOST_CHECK((plugged[i]->address == 0U) &&
+               ((hub.ports[i - 1U].status & USBH_PORTSTATUS_ENABLE) == 0U),
+               "port %u enabled at address %u after the hub attach", i,
+               plugged[i]->address);
+  }
+  ms = wait_configured(HUB_PORTS);
+  HOST_CHECK(ms != ~0U, "tree not enumerated again");
+  check_tree("hub attached again", all);
+  report("hub attached again, all ports", ms);
+}
+
+int main(int argc, char *argv[]) {
+  const usbhsim_stats_t *stats;
+  unsigned i;
+
+  hostInit(argc, argv);
+  chSysInit();
+  usbhInit();
+  usbhStart(&USBHD1);
+
+  usbhsimHubObjectInit(&hub, USBH_DEVSPEED_FULL, HUB_PORTS);
+  for (i = 0; i < HUB_PORTS; i++) {
+    usbhsimDeviceObjectInit(&devices[i], &dev_config, NULL);
+  }
+  if (host_bench) {
+    printf("%s: %u port hub, parallel enumeration %s\n", argv[0], HUB_PORTS,
+           HAL_USBH_USE_PARALLEL_ENUMERATION ? "on" : "off");
+  }
+
+  test_one();
+  test_all();
+  test_hotplug();
+  test_reattach();
+
+  stats = usbhsimGetStats(&USBHD1);
+  HOST_CHECK((stats->stalls == 0U) && (stats->errors == 0U),
+             "%u STALLs, %u errors", (unsigned)stats->stalls,
+             (unsigned)stats->errors);
+  if (host_bench) {
+    printf("  %u frames, %u transactions, %u NAKs, %u URBs\n",
+           (unsigned)stats->frames, (unsigned)stats->transactions,
+           (unsigned)stats->naks, (unsigned)stats->urbs);
+  }
+
+  usbhsimDetach(&USBHD1);
+  HOST_CHECK(wait_unloaded(), "hub not unloaded");
+  usbhStop(&USBHD1);
+
+  return hostReport(argv[0]);
+}
@@ -0,0 +1,187 @@
+/*
+    ChibiOS - Copyright (C) 2006..2018 Giovanni Di Sirio
+
+    Licensed under the Apache License, Version 2.0 (the "License");
+    you may not use this file except in compliance with the License.
+    You may obtain a copy of the License at
+
+        http://www.apache.org/licenses/LICENSE-2.0
+
+    Unless required by applicable law or agreed to in writing, software
+    distributed under the License is distributed on an "AS IS" BASIS,
+    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+    See the License for the specific language governing permissions and
+    limitations under the License.
+*/
+
+/*
+ * USB host mass storage driver over the simulated host controller: a
+ * scripted Bulk-Only SCSI disk is enumerated, written and read back.
+ */
+
+#include <string.h>
+
+#include "hal.h"
+#include "usbh/dev/msd.h"
+#include "disk.h"
+#include "host_test.h"
+
+/*===========================================================================*/
+/* Helpers.                                                                  */
+/*===========================================================================*/
+
+static USBHMassStorageLUNDriver *const lunp = &MSBLKD[0];
+static usbhsim_device_t disk_dev;
+
+static uint8_t buf1[16 * DISK_BLOCK_SIZE];
+static uint8_t buf2[16 * DISK_BLOCK_SIZE];
+
+/* Runs the host main loop until the LUN reaches the state or 5s pass.*/
+static bool wait_lun_state(blkstate_t state) {
+  unsigned i;
+
+  for (i = 0; i < 500; i++) {
+    usbhMainLoop(&USBHD1);
+    if (lunp->state == state) {
+      return true;
+    }
+    chThdSleepMilliseconds(10);
+  }
+  return false;
+}
+
+static void fill(uint8_t *p, size_t n, uint32_t seed) {
+
+  hostSeed(seed);
+  while (n-- > 0U) {
+    *p++ = (uint8_t)hostRand();
+  }
+}
+
+#if HAL_USBHMSD_USE_ASYNC
+static unsigned callbacks;
+
+static void count_callback(usbhmsd_request_t *req) {
+
+  (void)req;
+  callbacks++;
+}
+
+static void test_unready_requests_fail(const char *when) {
+  usbhmsd_request_t req;
+  systime_t start = chVTGetSystemTimeX();
+
+  HOST_CHECK(usbhmsdLUNRead(lunp, 0, buf1, 1) == HAL_FAILED,
+             "%s: read succeeded", when);
+  HOST_CHECK(usbhmsdLUNWrite(lunp, 0, buf1, 1) == HAL_FAILED,
+             "%s: write succeeded", when);
+
+  callbacks = 0;
+  req.status = USBHMSD_REQSTATUS_IDLE;
+  usbhmsdLUNSubmitRead(lunp, &req, 0, buf1, 1, count_callback, NULL);
+  HOST_CHECK((req.status == USBHMSD_REQSTATUS_FAILED) && (callbacks == 1U),
+             "%s: submit status %d, %u callbacks", when, (int)req.status,
+             callbacks);
+  HOST_CHECK(usbhmsdRequestWait(&req) == HAL_FAILED, "%s: wait", when);
+
+  /* Nothing may have waited for a worker or a device.*/
+  HOST_CHECK(chVTGetSystemTimeX() == start, "%s: blocked for %u ticks",
+             when, (unsigned)(chVTGetSystemTimeX() - start));
+}
+#endif
+
+/*===========================================================================*/
+/* Tests.                                                                    */
+/*===========================================================================*/
+
+static void test_read_write(void) {
+  unsigned i;
+
+  fill(buf1, sizeof(buf1), 1);
+  HOST_CHECK(usbhmsdLUNWrite(lunp, 10, buf1, 16) == HAL_SUCCESS, "write");
+  HOST_CHECK(memcmp(diskGetBlock(10), buf1, sizeof(buf1)) == 0,
+             "disk contents");
+  memset(buf2, 0, sizeof(buf2));
+  HOST_CHECK(usbhmsdLUNRead(lunp, 10, buf2, 16) == HAL_SUCCESS, "read");
+  HOST_CHECK(memcmp(buf1, buf2, sizeof(buf1)) == 0, "read back");
+
+  /* Single blocks, out of order.*/
+  for (i = 0; i < 16; i++) {
+    uint32_t blk = (i * 7U) % 16U;
+
+    HOST_CHECK(usbhmsdLUNRead(lunp, 10 + blk, buf2, 1) == HAL_SUCCESS,
+               "read %u", (unsigned)blk);
+    HOST_CHECK(memcmp(&buf1[blk * DISK_BLOCK_SIZE], buf2,
+                      DISK_BLOCK_SIZE) == 0, "block %u", (unsigned)blk);
+  }
+
+  HOST_CHECK(usbhmsdLUNRead(lunp, DISK_BLOCKS - 1, buf2, 2) == HAL_FAILED,
+             "read past the end");
+}
+
+#if HAL_USBHMSD_USE_ASYNC
+static void test_async_coalescing(void) {
+  usbhmsd_request_t req[4];
+  usbhmsd_stats_t before, after;
+  unsigned i;
+
+  fill(buf1, sizeof(buf1), 2);
+  memcpy(diskGetBlock(100), buf1, sizeof(buf1));
+  memset(buf2, 0, sizeof(buf2));
+
+  usbhmsdLUNGetStats(lunp, &before);
+  for (i = 0; i < 4; i++) {
+    req[i].status = USBHMSD_REQSTATUS_IDLE;
+    usbhmsdLUNSubmitRead(lunp, &req[i], 100 + i * 4, &buf2[i * 4 * DISK_BLOCK_SIZE],
+                         4, NULL, NULL);
+  }
+  for (i = 0; i < 4; i++) {
+    HOST_CHECK(usbhmsdRequestWait(&req[i]) == HAL_SUCCESS, "request %u", i);
+  }
+  usbhmsdLUNGetStats(lunp, &after);
+  HOST_CHECK(memcmp(buf1, buf2, sizeof(buf1)) == 0, "async read back");
+  HOST_CHECK(after.transactions - before.transactions == 1U,
+             "%u transactions for 4 adjacent requests",
+             (unsigned)(after.transactions - before.transactions));
+}
+#endif
+
+int main(int argc, char *argv[]) {
+
+  hostInit(argc, argv);
+  chSysInit();
+  usbhInit();
+
+#if HAL_USBHMSD_USE_ASYNC
+  test_unready_requests_fail("host stopped");
+#endif
+
+  usbhStart(&USBHD1);
+#if HAL_USBHMSD_USE_ASYNC
+  test_unready_requests_fail("no device");
+#endif
+
+  usbhsimDeviceObjectInit(&disk_dev, &disk_config, NULL);
+  usbhsimAttach(&USBHD1, &disk_dev);
+  HOST_CHECK(wait_lun_state(BLK_ACTIVE), "device not loaded");
+#if HAL_USBHMSD_USE_ASYNC
+  test_unready_requests_fail("not connected");
+#endif
+  HOST_CHECK(usbhmsdLUNConnect(lunp) == HAL_SUCCESS, "connect");
+  HOST_CHECK((lunp->info.blk_size == DISK_BLOCK_SIZE) &&
+             (lunp->info.blk_num == DISK_BLOCKS), "capacity %u x %u",
+             (unsigned)lunp->info.blk_num, (unsigned)lunp->info.blk_size);
+
+  test_read_write();
+#if HAL_USBHMSD_USE_ASYNC
+  test_async_coalescing();
+#endif
+
+  usbhsimDetach(&USBHD1);
+  HOST_CHECK(wait_lun_state(BLK_STOP), "device not unloaded");
+#if HAL_USBHMSD_USE_ASYNC
+  test_unready_requests_fail("detached");
+#endif
+
+  return hostReport(argv[0]);
+}
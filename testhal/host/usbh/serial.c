@@ -0,0 +1,418 @@
+/*
+    ChibiOS - Copyright (C) 2006..2018 Giovanni Di Sirio
+
+    Licensed under the Apache License, Version 2.0 (the "License");
+    you may not use this file except in compliance with the License.
+    You may obtain a copy of the License at
+
+        http://www.apache.org/licenses/LICENSE-2.0
+
+    Unless required by applicable law or agreed to in writing, software
+    distributed under the License is distributed on an "AS IS" BASIS,
+    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+    See the License for the specific language governing permissions and
+    limitations under the License.
+*/
+
+/*
+ * FTDI and Android accessory serial channels over the simulated host
+ * controller, the driver is selected by HAL_USBH_USE_FTDI or
+ * HAL_USBH_USE_AOA. A scripted device receives the OUT stream and sources
+ * a known IN stream. The data must arrive in order, and a failed OUT
+ * transfer must drop exactly its own packet, with the error reported to
+ * the next writer, while the transfers queued behind it still go out.
+ * The benchmark measures the bytes moved per frame, to compare builds
+ * with one and more URBs per direction.
+ */
+
+#include <string.h>
+
+#include "hal.h"
+#include "host_test.h"
+
+#if HAL_USBH_USE_FTDI
+#include "usbh/dev/ftdi.h"
+#define OUT_URBS                            HAL_USBHFTDI_OUT_URBS
+#define IN_URBS                             HAL_USBHFTDI_IN_URBS
+/* Modem and line status bytes at the start of each IN packet.*/
+#define IN_HEADER                           2U
+#else
+#include "usbh/dev/aoa.h"
+#define OUT_URBS                            HAL_USBHAOA_OUT_URBS
+#define IN_URBS                             HAL_USBHAOA_IN_URBS
+#define IN_HEADER                           0U
+#endif
+
+/*===========================================================================*/
+/* Simulated device.                                                         */
+/*===========================================================================*/
+
+#define STREAM_SIZE                         32768
+#define PACKET_SIZE                         64U
+#define NO_PACKET                           0xFFFFFFFFU
+
+static struct {
+  /* OUT stream received.*/
+  uint8_t                   sink[STREAM_SIZE];
+  uint32_t                  sink_len;
+  uint32_t                  out_packets;
+  /* OUT packet answered with an error.*/
+  uint32_t                  err_packet;
+  /* IN stream still to send.*/
+  uint32_t                  source_pos;
+  uint32_t                  source_len;
+  uint32_t                  vendor_requests;
+} dev;
+
+#if HAL_USBH_USE_FTDI
+static const uint8_t dev_device_descriptor[] = {
+  18, USBH_DT_DEVICE,
+  0x00, 0x02,                               /* bcdUSB */
+  0x00, 0x00, 0x00, 8,
+  0x03, 0x04,                               /* idVendor */
+  0x01, 0x60,                               /* idProduct, FT232R */
+  0x00, 0x06,                               /* bcdDevice */
+  1, 2, 0, 1
+};
+
+static const uint8_t dev_config_descriptor[] = {
+  9, USBH_DT_CONFIG, 32, 0, 1, 1, 0, 0x80, 45,
+  9, USBH_DT_INTERFACE, 0, 0, 2, 0xFF, 0xFF, 0xFF, 0,
+  7, USBH_DT_ENDPOINT, 0x81, USBH_EPTYPE_BULK, 64, 0, 0,
+  7, USBH_DT_ENDPOINT, 0x02, USBH_EPTYPE_BULK, 64, 0, 0
+};
+
+static const char *const dev_strings[] = {"FTDI", "Simulated FT232R"};
+#else
+static const uint8_t dev_device_descriptor[] = {
+  18, USBH_DT_DEVICE,
+  0x00, 0x02,                               /* bcdUSB */
+  0x00, 0x00, 0x00, 64,
+  0xD1, 0x18,                               /* idVendor */
+  0x00, 0x2D,                               /* idProduct, accessory */
+  0x00, 0x01,                               /* bcdDevice */
+  1, 2, 0, 1
+};
+
+static const uint8_t dev_config_descriptor[] = {
+  9, USBH_DT_CONFIG, 32, 0, 1, 1, 0, 0x80, 50,
+  9, USBH_DT_INTERFACE, 0, 0, 2, 0xFF, 0xFF, 0x00, 0,
+  7, USBH_DT_ENDPOINT, 0x81, USBH_EPTYPE_BULK, 64, 0, 0,
+  7, USBH_DT_ENDPOINT, 0x02, USBH_EPTYPE_BULK, 64, 0, 0
+};
+
+static const char *const dev_strings[] = {"ChibiOS", "Simulated accessory"};
+#endif
+
+/* Byte i of the streams.*/
+static uint8_t stream_byte(uint32_t i) {
+
+  return (uint8_t)(i * 7U + (i >> 8) + (i >> 16));
+}
+
+static usbhsim_response_t dev_control(usbhsim_device_t *sdp,
+                                      const usbh_control_request_t *req,
+                                      uint8_t *buf, uint32_t *len) {
+
+  (void)sdp;
+  (void)buf;
+  (void)len;
+  if ((req->bmRequestType & 0x60U) ==
+      USBH_REQTYPE_TYPE_VENDOR) {
+    dev.vendor_requests++;
+    return USBHSIM_ACK;
+  }
+  return USBHSIM_STALL;
+}
+
+static usbhsim_response_t dev_transfer(usbhsim_device_t *sdp, uint8_t ep,
+                                       uint8_t *buf, uint32_t len,
+                                       uint32_t *actual) {
+  uint32_t i, n;
+
+  (void)sdp;
+  if (ep == 0x02U) {
+    if (dev.out_packets++ == dev.err_packet) {
+      return USBHSIM_ERROR;
+    }
+    if (dev.sink_len + len > STREAM_SIZE) {
+      return USBHSIM_STALL;
+    }
+    memcpy(&dev.sink[dev.sink_len], buf, len);
+    dev.sink_len += len;
+    return USBHSIM_ACK;
+  }
+
+  /* Nothing to send, the FTDI chips would send the status bytes alone
+     every 40ms.*/
+  if ((ep != 0x81U) || (dev.source_pos == dev.source_len)) {
+    return USBHSIM_NAK;
+  }
+  n = dev.source_len - dev.source_pos;
+  if (n > len - IN_HEADER) {
+    n = len - IN_HEADER;
+  }
+#if HAL_USBH_USE_FTDI
+  buf[0] = 0x01;
+  buf[1] = 0x60;
+#endif
+  for (i = 0; i < n; i++) {
+    buf[IN_HEADER + i] = stream_byte(dev.source_pos + i);
+  }
+  dev.source_pos += n;
+  *actual = IN_HEADER + n;
+  return USBHSIM_ACK;
+}
+
+static const usbhsim_config_t dev_config = {
+  USBH_DEVSPEED_FULL,
+  dev_device_descriptor,
+  dev_config_descriptor,
+  dev_strings, 2,
+  dev_control,
+  dev_transfer
+};
+
+static usbhsim_device_t sim_dev;
+
+/*===========================================================================*/
+/* Helpers.                                                                  */
+/*===========================================================================*/
+
+#if HAL_USBH_USE_FTDI
+#define chp                                 (&FTDIPD[0])
+
+static bool channel_loaded(void) {
+
+  return usbhftdipGetState(chp) == USBHFTDIP_STATE_ACTIVE;
+}
+
+static void channel_start(void) {
+
+  usbhftdipStart(chp, NULL);
+}
+
+static void channel_stop(void) {
+
+  usbhftdipStop(chp);
+}
+
+static uint32_t channel_errors(void) {
+  usbhftdip_stats_t stats;
+
+  usbhftdipGetStats(chp, &stats);
+  return stats.errors;
+}
+#else
+#define chp                                 (&USBHAOAD[0].channel)
+
+static bool channel_loaded(void) {
+
+  return usbhaoaGetChannelState(&USBHAOAD[0]) == USBHAOA_CHANNEL_STATE_ACTIVE;
+}
+
+static void channel_start(void) {
+
+  usbhaoaChannelStart(&USBHAOAD[0]);
+}
+
+static void channel_stop(void) {
+
+  usbhaoaChannelStop(&USBHAOAD[0]);
+}
+
+static uint32_t channel_errors(void) {
+  usbhaoa_channel_stats_t stats;
+
+  usbhaoaChannelGetStats(&USBHAOAD[0], &stats);
+  return stats.errors;
+}
+#endif
+
+static uint8_t out_stream[STREAM_SIZE];
+static uint8_t in_stream[STREAM_SIZE];
+
+/* Waits for the device to receive n bytes, the partial buffers are sent
+   by the driver every 16ms.*/
+static bool wait_sink(uint32_t n) {
+  unsigned i;
+
+  for (i = 0; (i < 100) && (dev.sink_len < n); i++) {
+    chThdSleepMilliseconds(1);
+  }
+  chThdSleepMilliseconds(40);
+  return dev.sink_len == n;
+}
+
+static void reset_device(void) {
+
+  dev.sink_len = 0;
+  dev.out_packets = 0;
+  dev.err_packet = NO_PACKET;
+  dev.source_pos = dev.source_len = 0;
+}
+
+/*===========================================================================*/
+/* Tests.                                                                    */
+/*===========================================================================*/
+
+static void test_order(void) {
+  size_t n;
+  uint32_t i;
+
+  reset_device();
+  for (i = 0; i < STREAM_SIZE; i++) {
+    out_stream[i] = stream_byte(i);
+  }
+
+  /* A partial packet at the end, flushed by the timer.*/
+  n = chnWriteTimeout(chp, out_stream, 100 * PACKET_SIZE + 17,
+                      OSAL_MS2I(1000));
+  HOST_CHECK(n == 100 * PACKET_SIZE + 17, "write: %u bytes", (unsigned)n);
+  HOST_CHECK(wait_sink(n), "sink: %u bytes", (unsigned)dev.sink_len);
+  HOST_CHECK(memcmp(dev.sink, out_stream, dev.sink_len) == 0,
+             "OUT stream out of order");
+
+  /* Byte by byte.*/
+  reset_device();
+  for (i = 0; i < 3 * PACKET_SIZE; i++) {
+    HOST_CHECK(chnPutTimeout(chp, out_stream[i], OSAL_MS2I(1000)) == Q_OK,
+               "put %u", (unsigned)i);
+  }
+  HOST_CHECK(wait_sink(3 * PACKET_SIZE), "sink: %u bytes",
+             (unsigned)dev.sink_len);
+  HOST_CHECK(memcmp(dev.sink, out_stream, dev.sink_len) == 0,
+             "OUT stream out of order");
+
+  /* IN stream.*/
+  reset_device();
+  dev.source_len = 50 * PACKET_SIZE + 5;
+  n = chnReadTimeout(chp, in_stream, dev.source_len, OSAL_MS2I(1000));
+  HOST_CHECK(n == dev.source_len, "read: %u bytes", (unsigned)n);
+  for (i = 0; (i < n) && (in_stream[i] == stream_byte(i)); i++) {
+  }
+  HOST_CHECK(i == n, "IN stream differs at %u", (unsigned)i);
+  HOST_CHECK(chnGetTimeout(chp, OSAL_MS2I(20)) == Q_TIMEOUT, "extra data");
+}
+
+/* Checks that the device received the first n bytes of out_stream but
+   the packet p.*/
+static void check_dropped(uint32_t n, uint32_t p) {
+  const uint32_t drop = p * PACKET_SIZE;
+
+  HOST_CHECK(wait_sink(n - PACKET_SIZE), "sink: %u bytes, written %u",
+             (unsigned)dev.sink_len, (unsigned)n);
+  HOST_CHECK(memcmp(dev.sink, out_stream, drop) == 0,
+             "before the failed packet");
+  HOST_CHECK(memcmp(&dev.sink[drop], &out_stream[drop + PACKET_SIZE],
+                    dev.sink_len - drop) == 0,
+             "after the failed packet");
+}
+
+static void test_errors(void) {
+  const uint32_t errors = channel_errors();
+  uint32_t i, n;
+  msg_t msg;
+
+  /* A failed transfer in a long write, the write stops short.*/
+  reset_device();
+  dev.err_packet = 10;
+  n = chnWriteTimeout(chp, out_stream, 100 * PACKET_SIZE, OSAL_MS2I(1000));
+  HOST_CHECK((n > 10 * PACKET_SIZE) && (n < 100 * PACKET_SIZE),
+             "write: %u bytes", (unsigned)n);
+  check_dropped(n, 10);
+  HOST_CHECK(channel_errors() == errors + 1U, "errors: %u",
+             (unsigned)channel_errors());
+
+  /* The error is reported once, the stream goes on.*/
+  i = chnWriteTimeout(chp, &out_stream[n], 10 * PACKET_SIZE,
+                      OSAL_MS2I(1000));
+  HOST_CHECK(i == 10 * PACKET_SIZE, "write after the error: %u bytes",
+             (unsigned)i);
+  check_dropped(n + i, 10);
+
+  /* Byte by byte, one put is refused.*/
+  reset_device();
+  dev.err_packet = 2;
+  n = 0;
+  for (i = 0; i < 20 * PACKET_SIZE; i++) {
+    msg = chnPutTimeout(chp, out_stream[n], OSAL_MS2I(1000));
+    if (msg == Q_RESET) {
+      break;
+    }
+    HOST_CHECK(msg == Q_OK, "put %u: %d", (unsigned)n, (int)msg);
+    n++;
+    if ((n % PACKET_SIZE) == 0U) {
+      chThdSleepMilliseconds(1);
+    }
+  }
+  HOST_CHECK(msg == Q_RESET, "error not reported");
+  check_dropped(n, 2);
+  HOST_CHECK(channel_errors() == errors + 2U, "errors: %u",
+             (unsigned)channel_errors());
+}
+
+/* Frames to move STREAM_SIZE bytes in each direction.*/
+static void bench(void) {
+  const usbhsim_stats_t *const stats = usbhsimGetStats(&USBHD1);
+  uint32_t start, out_frames, in_frames;
+  size_t n;
+
+  reset_device();
+  start = stats->frames;
+  n = chnWriteTimeout(chp, out_stream, STREAM_SIZE, OSAL_MS2I(10000));
+  while (dev.sink_len < n) {
+    chThdSleepMilliseconds(1);
+  }
+  out_frames = stats->frames - start;
+  HOST_CHECK(memcmp(dev.sink, out_stream, STREAM_SIZE) == 0,
+             "OUT stream out of order");
+
+  reset_device();
+  dev.source_len = STREAM_SIZE;
+  start = stats->frames;
+  n = chnReadTimeout(chp, in_stream, STREAM_SIZE, OSAL_MS2I(10000));
+  in_frames = stats->frames - start;
+  HOST_CHECK(n == STREAM_SIZE, "read: %u bytes", (unsigned)n);
+
+  printf("  %u OUT URBs: %5u frames, %6.1f bytes/frame\n", OUT_URBS,
+         (unsigned)out_frames, (double)STREAM_SIZE / out_frames);
+  printf("  %u IN URBs:  %5u frames, %6.1f bytes/frame\n", IN_URBS,
+         (unsigned)in_frames, (double)STREAM_SIZE / in_frames);
+}
+
+int main(int argc, char *argv[]) {
+  unsigned i;
+
+  hostInit(argc, argv);
+  chSysInit();
+  usbhInit();
+  usbhStart(&USBHD1);
+
+  reset_device();
+  usbhsimDeviceObjectInit(&sim_dev, &dev_config, NULL);
+  usbhsimAttach(&USBHD1, &sim_dev);
+  for (i = 0; (i < 500) && !channel_loaded(); i++) {
+    usbhMainLoop(&USBHD1);
+    chThdSleepMilliseconds(10);
+  }
+  HOST_CHECK(channel_loaded(), "device not loaded");
+  channel_start();
+
+  test_order();
+  test_errors();
+  if (host_bench) {
+    printf("%s: %u bytes each way\n", argv[0], STREAM_SIZE);
+    bench();
+  }
+
+  channel_stop();
+  usbhsimDetach(&USBHD1);
+  for (i = 0; (i < 500) && channel_loaded(); i++) {
+    usbhMainLoop(&USBHD1);
+    chThdSleepMilliseconds(10);
+  }
+  HOST_CHECK(!channel_loaded(), "device not unloaded");
+
+  return hostReport(argv[0]);
+}
@@ -0,0 +1,427 @@
+/*
+    ChibiOS - Copyright (C) 2006..2018 Giovanni Di Sirio
+
+    Licensed under the Apache License, Version 2.0 (the "License");
+    you may not use this file except in compliance with the License.
+    You may obtain a copy of the License at
+
+        http://www.apache.org/licenses/LICENSE-2.0
+
+    Unless required by applicable law or agreed to in writing, software
+    distributed under the License is distributed on an "AS IS" BASIS,
+    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+    See the License for the specific language governing permissions and
+    limitations under the License.
+*/
+
+/*
+ * USB video class driver in frame assembly mode over the simulated host
+ * controller: a scripted camera streams frames of known contents on an
+ * isochronous endpoint. Frames are checked for contents, sequence numbers
+ * and drops on errors, and the ownership of the ring is checked across
+ * stream restarts with frames held by the application, double frees and
+ * frames of a previous ring.
+ */
+
+#include <string.h>
+
+#include "hal.h"
+#include "usbh/dev/uvc.h"
+#include "host_test.h"
+
+/*===========================================================================*/
+/* Simulated camera.                                                         */
+/*===========================================================================*/
+
+#define PAYLOAD_SIZE                        1000
+#define FRAME_PAYLOADS                      6
+#define LONG_PAYLOADS                       10
+#define IDLE_SLOTS                          34
+#define FRAME_BYTES                         (FRAME_PAYLOADS * PAYLOAD_SIZE)
+#define NO_FRAME                            0xFFFFFFFFU
+
+static struct {
+  uint8_t                   alt;
+  uint8_t                   fid;
+  uint32_t                  frame;
+  uint32_t                  slot;
+  /* Faults, by camera frame number.*/
+  uint32_t                  err_frame;
+  uint32_t                  no_eof_frame;
+  uint32_t                  long_frame;
+  uint8_t                   pc[26];
+} cam;
+
+static const uint8_t cam_device_descriptor[] = {
+  18, USBH_DT_DEVICE,
+  0x00, 0x02,                               /* bcdUSB */
+  0xEF, 0x02, 0x01, 64,                     /* IAD device class */
+  0x83, 0x04,                               /* idVendor */
+  0x30, 0x57,                               /* idProduct */
+  0x00, 0x01,                               /* bcdDevice */
+  1, 2, 0, 1
+};
+
+#define CAM_CONFIG_SIZE                     (9 + 8 + 9 + 13 + 7 + 5 + 9 + 14 + \
+                                             11 + 30 + 9 + 7)
+
+static const uint8_t cam_config_descriptor[] = {
+  9, USBH_DT_CONFIG, CAM_CONFIG_SIZE, 0, 2, 1, 0, 0x80, 250,
+  /* Interface association.*/
+  8, USBH_DT_INTERFACE_ASSOCIATION, 0, 2, 0x0E, 0x03, 0x00, 0,
+  /* Video control, header and status endpoint.*/
+  9, USBH_DT_INTERFACE, 0, 0, 1, 0x0E, 0x01, 0x00, 0,
+  13, 0x24, 0x01, 0x00, 0x01, 13, 0, 0x80, 0x8D, 0x5B, 0x00, 1, 1,
+  7, USBH_DT_ENDPOINT, 0x83, USBH_EPTYPE_INT, 16, 0, 8,
+  5, 0x25, 0x03, 16, 0,
+  /* Video streaming, alternate 0: MJPEG 160x120.*/
+  9, USBH_DT_INTERFACE, 1, 0, 0, 0x0E, 0x02, 0x00, 0,
+  14, 0x24, 0x01, 1, 55, 0, 0x81, 0, 0, 0, 0, 0, 1, 0,
+  11, 0x24, 0x06, 1, 1, 0, 1, 0, 0, 0, 0,
+  30, 0x24, 0x07, 1, 0, 160, 0, 120, 0,
+  0x00, 0x00, 0x10, 0x00, 0x00, 0x00, 0x10, 0x00,
+  0x00, 0x96, 0x00, 0x00, 0x40, 0x0D, 0x03, 0x00,
+  1, 0x40, 0x0D, 0x03, 0x00,
+  /* Alternate 1, isochronous endpoint.*/
+  9, USBH_DT_INTERFACE, 1, 1, 1, 0x0E, 0x02, 0x00, 0,
+  7, USBH_DT_ENDPOINT, 0x81, 0x05, 0x00, 0x04, 1
+};
+
+static const char *const cam_strings[] = {"ChibiOS", "Simulated camera"};
+
+/* Byte i of the camera frame, the first four are the frame number.*/
+static uint8_t cam_byte(uint32_t frame, uint32_t i) {
+
+  if (i < 4U) {
+    return (uint8_t)(frame >> (i * 8U));
+  }
+  return (uint8_t)(frame * 13U + i * 7U + (i >> 8));
+}
+
+static usbhsim_response_t cam_control(usbhsim_device_t *dev,
+                                      const usbh_control_request_t *req,
+                                      uint8_t *buf, uint32_t *len) {
+
+  (void)dev;
+  if ((req->bmRequestType == 0x01) &&
+      (req->bRequest == USBH_REQ_SET_INTERFACE)) {
+    if ((req->wIndex == 1U) && (req->wValue != cam.alt)) {
+      /* Streaming starts with a new frame.*/
+      cam.alt = (uint8_t)req->wValue;
+      cam.frame++;
+      cam.fid ^= UVC_HDR_FID;
+      cam.slot = 0;
+    }
+    return USBHSIM_ACK;
+  }
+  if ((req->bmRequestType == 0x21) && (req->bRequest == UVC_SET_CUR)) {
+    memcpy(cam.pc, buf, *len < sizeof(cam.pc) ? *len : sizeof(cam.pc));
+    return USBHSIM_ACK;
+  }
+  if (req->bmRequestType == 0xA1) {
+    if (*len > sizeof(cam.pc)) {
+      *len = sizeof(cam.pc);
+    }
+    memcpy(buf, cam.pc, *len);
+    return USBHSIM_ACK;
+  }
+  return USBHSIM_STALL;
+}
+
+/* One payload per microframe, FRAME_PAYLOADS of them per frame, then
+   IDLE_SLOTS empty microframes.*/
+static usbhsim_response_t cam_transfer(usbhsim_device_t *dev, uint8_t ep,
+                                       uint8_t *buf, uint32_t len,
+                                       uint32_t *actual) {
+  const uint32_t payloads = cam.frame == cam.long_frame ? LONG_PAYLOADS :
+                                                          FRAME_PAYLOADS;
+  uint32_t i, offset;
+
+  (void)dev;
+  if ((ep != 0x81) || (cam.alt == 0U)) {
+    return USBHSIM_NAK;
+  }
+
+  if (cam.slot >= payloads) {
+    if (++cam.slot == payloads + IDLE_SLOTS) {
+      cam.slot = 0;
+      cam.frame++;
+      cam.fid ^= UVC_HDR_FID;
+    }
+    return USBHSIM_NAK;
+  }
+
+  buf[0] = 2;
+  buf[1] = UVC_HDR_EOH | cam.fid;
+  if ((cam.slot == payloads - 1U) && (cam.frame != cam.no_eof_frame)) {
+    buf[1] |= UVC_HDR_EOF;
+  }
+  if ((cam.slot == 1U) && (cam.frame == cam.err_frame)) {
+    buf[1] |= UVC_HDR_ERR;
+  }
+  offset = cam.slot * PAYLOAD_SIZE;
+  for (i = 0; (i < PAYLOAD_SIZE) && (i + 2U < len); i++) {
+    buf[2 + i] = cam_byte(cam.frame, offset + i);
+  }
+  *actual = 2U + i;
+  cam.slot++;
+  return USBHSIM_ACK;
+}
+
+static const usbhsim_config_t cam_config = {
+  USBH_DEVSPEED_HIGH,
+  cam_device_descriptor,
+  cam_config_descriptor,
+  cam_strings, 2,
+  cam_control,
+  cam_transfer
+};
+
+static usbhsim_device_t cam_dev;
+
+/*===========================================================================*/
+/* Helpers.                                                                  */
+/*===========================================================================*/
+
+#define RING_FRAMES                         4
+#define FRAME_BUFFER_SIZE                   8192
+
+static USBHUVCDriver *const uvcdp = &USBHUVCD[0];
+
+static usbhuvc_frame_t ring1[RING_FRAMES], ring2[RING_FRAMES];
+static uint8_t buffers1[RING_FRAMES][FRAME_BUFFER_SIZE];
+static uint8_t buffers2[RING_FRAMES][FRAME_BUFFER_SIZE];
+
+/* Next frame, the status messages are discarded.*/
+static usbhuvc_frame_t *fetch(sysinterval_t timeout) {
+  msg_t msg;
+
+  while (usbhuvcLockAndFetch(uvcdp, &msg, timeout) == MSG_OK) {
+    usbhuvc_message_base_t *const base = (usbhuvc_message_base_t *)msg;
+
+    usbhuvcUnlock(uvcdp);
+    if (base->type == USBHUVC_MESSAGETYPE_FRAME) {
+      return (usbhuvc_frame_t *)base;
+    }
+    usbhuvcFreeStatusMessage(uvcdp, (usbhuvc_message_status_t *)base);
+  }
+  return NULL;
+}
+
+/* Camera frame number of a frame with the expected contents, NO_FRAME
+   otherwise.*/
+static uint32_t frame_number(const usbhuvc_frame_t *frame) {
+  uint32_t i, n;
+
+  if (frame->len != FRAME_BYTES) {
+    return NO_FRAME;
+  }
+  n = frame->buff[0] | (frame->buff[1] << 8) | (frame->buff[2] << 16) |
+      ((uint32_t)frame->buff[3] << 24);
+  for (i = 4; i < FRAME_BYTES; i++) {
+    if (frame->buff[i] != cam_byte(n, i)) {
+      return NO_FRAME;
+    }
+  }
+  return n;
+}
+
+/* Lets the stream run without freeing frames, then takes all the frames
+   delivered. Returns how many, false if one was delivered twice or is
+   not in the ring.*/
+static bool drain(usbhuvc_frame_t **held, unsigned *n,
+                  const usbhuvc_frame_t *ring) {
+  usbhuvc_frame_t *frame;
+  unsigned i;
+
+  chThdSleepMilliseconds(100);
+  *n = 0;
+  while ((frame = fetch(TIME_IMMEDIATE)) != NULL) {
+    if ((frame < ring) || (frame >= ring + RING_FRAMES)) {
+      return false;
+    }
+    for (i = 0; i < *n; i++) {
+      if (held[i] == frame) {
+        return false;
+      }
+    }
+    held[(*n)++] = frame;
+  }
+  return true;
+}
+
+static void free_all(usbhuvc_frame_t **held, unsigned n) {
+
+  while (n-- > 0U) {
+    usbhuvcFreeFrame(uvcdp, held[n]);
+  }
+}
+
+/*===========================================================================*/
+/* Tests.                                                                    */
+/*===========================================================================*/
+
+static void test_frames(void) {
+  usbhuvc_frame_t *frame;
+  usbhuvc_stats_t stats;
+  uint32_t n, last = NO_FRAME, seq = 0;
+  unsigned i;
+
+  usbhuvcResetStats(uvcdp);
+  for (i = 0; i < 20; i++) {
+    frame = fetch(OSAL_MS2I(100));
+    HOST_CHECK(frame != NULL, "frame %u not delivered", i);
+    if (frame == NULL) {
+      return;
+    }
+    n = frame_number(frame);
+    HOST_CHECK(n != NO_FRAME, "frame %u contents", i);
+    HOST_CHECK((i == 0U) || ((n == last + 1U) &&
+               (frame->sequence == seq + 1U)), "frame %u: camera frame %u "
+               "after %u, sequence %u after %u", i, (unsigned)n,
+               (unsigned)last, (unsigned)frame->sequence, (unsigned)seq);
+    last = n;
+    seq = frame->sequence;
+    usbhuvcFreeFrame(uvcdp, frame);
+  }
+  usbhuvcGetStats(uvcdp, &stats);
+  HOST_CHECK((stats.dropped == 0U) && (stats.overruns == 0U),
+             "%u dropped, %u overruns", (unsigned)stats.dropped,
+             (unsigned)stats.overruns);
+  HOST_CHECK(stats.packets >= 20U * FRAME_PAYLOADS, "%u payloads",
+             (unsigned)stats.packets);
+}
+
+/* A frame with ERR or too long is dropped, one without EOF is ended by
+   the FID toggle.*/
+static void test_faults(void) {
+  static const struct {
+    const char *name;
+    uint32_t *fault;
+    bool delivered;
+  } faults[] = {
+    {"ERR",      &cam.err_frame,    false},
+    {"overflow", &cam.long_frame,   false},
+    {"no EOF",   &cam.no_eof_frame, true}
+  };
+  usbhuvc_frame_t *frame;
+  usbhuvc_stats_t before, after;
+  uint32_t target, n;
+  unsigned i;
+  bool seen;
+
+  for (i = 0; i < sizeof(faults) / sizeof(faults[0]); i++) {
+    usbhuvcGetStats(uvcdp, &before);
+    osalSysLock();
+    target = cam.frame + 3U;
+    *faults[i].fault = target;
+    osalSysUnlock();
+
+    seen = false;
+    do {
+      frame = fetch(OSAL_MS2I(100));
+      HOST_CHECK(frame != NULL, "%s: no frame", faults[i].name);
+      if (frame == NULL) {
+        break;
+      }
+      n = frame_number(frame);
+      HOST_CHECK(n != NO_FRAME, "%s: frame contents", faults[i].name);
+      seen |= (n == target);
+      usbhuvcFreeFrame(uvcdp, frame);
+    } while (n < target + 2U);
+    *faults[i].fault = NO_FRAME;
+
+    usbhuvcGetStats(uvcdp, &after);
+    HOST_CHECK(seen == faults[i].delivered, "%s: frame %sdelivered",
+               faults[i].name, seen ? "" : "not ");
+    HOST_CHECK(after.dropped - before.dropped ==
+               (faults[i].delivered ? 0U : 1U), "%s: %u dropped",
+               faults[i].name, (unsigned)(after.dropped - before.dropped));
+  }
+}
+
+/* Frames held by the application or purged from the mailbox by a stop
+   must be in the ring exactly once after the restart.*/
+static void test_ownership(void) {
+  usbhuvc_frame_t *held[RING_FRAMES], *kept, *stale;
+  unsigned i, n;
+
+  /* Restart with a frame held and the others in the mailbox.*/
+  kept = fetch(OSAL_MS2I(100));
+  HOST_CHECK(kept != NULL, "no frame");
+  chThdSleepMilliseconds(100);
+  HOST_CHECK(usbhuvcStreamStop(uvcdp) == HAL_SUCCESS, "stop");
+  HOST_CHECK(usbhuvcStreamStart(uvcdp, PAYLOAD_SIZE + 2) == HAL_SUCCESS,
+             "start");
+  HOST_CHECK(drain(held, &n, ring1) && (n == RING_FRAMES - 1U),
+             "held frame: %u distinct frames", n);
+  for (i = 0; i < n; i++) {
+    HOST_CHECK(held[i] != kept, "held frame delivered again");
+  }
+  free_all(held, n);
+  usbhuvcFreeFrame(uvcdp, kept);
+  HOST_CHECK(drain(held, &n, ring1) && (n == RING_FRAMES),
+             "after the free: %u distinct frames", n);
+
+  /* Double free.*/
+  usbhuvcFreeFrame(uvcdp, held[0]);
+  free_all(held, n);
+  HOST_CHECK(drain(held, &n, ring1) && (n == RING_FRAMES),
+             "double free: %u distinct frames", n);
+
+  /* A frame held across a change of ring.*/
+  stale = held[0];
+  free_all(&held[1], n - 1U);
+  HOST_CHECK(usbhuvcStreamStop(uvcdp) == HAL_SUCCESS, "stop");
+  HOST_CHECK(usbhuvcSetFrameBuffers(uvcdp, ring2, RING_FRAMES, buffers2[0],
+                                    FRAME_BUFFER_SIZE) == HAL_SUCCESS,
+             "second ring");
+  HOST_CHECK(usbhuvcStreamStart(uvcdp, PAYLOAD_SIZE + 2) == HAL_SUCCESS,
+             "start");
+  usbhuvcFreeFrame(uvcdp, stale);
+  HOST_CHECK(drain(held, &n, ring2) && (n == RING_FRAMES),
+             "stale frame: %u distinct frames", n);
+  free_all(held, n);
+}
+
+int main(int argc, char *argv[]) {
+  unsigned i;
+
+  hostInit(argc, argv);
+  chSysInit();
+  usbhInit();
+  usbhStart(&USBHD1);
+
+  cam.err_frame = cam.no_eof_frame = cam.long_frame = NO_FRAME;
+  HOST_CHECK(usbhuvcSetFrameBuffers(uvcdp, ring1, RING_FRAMES, buffers1[0],
+                                    FRAME_BUFFER_SIZE) == HAL_SUCCESS,
+             "frame ring");
+  usbhsimDeviceObjectInit(&cam_dev, &cam_config, NULL);
+  usbhsimAttach(&USBHD1, &cam_dev);
+  for (i = 0; (i < 500) && (usbhuvcGetState(uvcdp) != USBHUVC_STATE_ACTIVE);
+       i++) {
+    usbhMainLoop(&USBHD1);
+    chThdSleepMilliseconds(10);
+  }
+  HOST_CHECK(usbhuvcGetState(uvcdp) == USBHUVC_STATE_ACTIVE,
+             "camera not loaded");
+  HOST_CHECK(usbhuvcCommit(uvcdp) == HAL_SUCCESS, "commit");
+  HOST_CHECK(usbhuvcStreamStart(uvcdp, PAYLOAD_SIZE + 2) == HAL_SUCCESS,
+             "start");
+
+  test_frames();
+  test_faults();
+  test_ownership();
+
+  HOST_CHECK(usbhuvcStreamStop(uvcdp) == HAL_SUCCESS, "stop");
+  usbhsimDetach(&USBHD1);
+  for (i = 0; (i < 500) && (usbhuvcGetState(uvcdp) != USBHUVC_STATE_STOP);
+       i++) {
+    usbhMainLoop(&USBHD1);
+    chThdSleepMilliseconds(10);
+  }
+  HOST_CHECK(usbhuvcGetState(uvcdp) == USBHUVC_STATE_STOP,
+             "camera not unloaded");
+
+  return hostReport(argv[0]);
+}
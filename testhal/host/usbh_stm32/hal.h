@@ -0,0 +1,96 @@
+/*
+    ChibiOS - Copyright (C) 2006..2018 Giovanni Di Sirio
+
+    Licensed under the Apache License, Version 2.0 (the "License");
+    you may not use this file except in compliance with the License.
+    You may obtain a copy of the License at
+
+        http://www.apache.org/licenses/LICENSE-2.0
+
+    Unless required by applicable law or agreed to in writing, software
+    distributed under the License is distributed on an "AS IS" BASIS,
+    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+    See the License for the specific language governing permissions and
+    limitations under the License.
+*/
+
+#ifndef HAL_H
+#define HAL_H
+
+#include "osal.h"
+
+/*===========================================================================*/
+/* Subset of the ChibiOS HAL used by the USB host stack.                     */
+/*===========================================================================*/
+
+#define HAL_SUCCESS                         false
+#define HAL_FAILED                          true
+
+#define __PACKED_STRUCT                     struct __attribute__((packed))
+#define PACKED_VAR                          __attribute__((packed))
+
+#define HAL_USE_USBH                        TRUE
+
+#define HAL_USBH_PORT_DEBOUNCE_TIME         200
+#define HAL_USBH_PORT_RESET_TIMEOUT         500
+#define HAL_USBH_DEVICE_ADDRESS_STABILIZATION 20
+#define HAL_USBH_CONTROL_REQUEST_DEFAULT_TIMEOUT OSAL_MS2I(1000)
+
+#define USBH_DEBUG_ENABLE                   FALSE
+#define USBH_DEBUG_MULTI_HOST               FALSE
+#define USBH_DEBUG_ENABLE_TRACE             FALSE
+#define USBH_DEBUG_ENABLE_INFO              FALSE
+#define USBH_DEBUG_ENABLE_WARNINGS          FALSE
+#define USBH_DEBUG_ENABLE_ERRORS            FALSE
+#define USBH_LLD_DEBUG_ENABLE_TRACE         FALSE
+#define USBH_LLD_DEBUG_ENABLE_INFO          FALSE
+#define USBH_LLD_DEBUG_ENABLE_WARNINGS      FALSE
+#define USBH_LLD_DEBUG_ENABLE_ERRORS        FALSE
+
+/*===========================================================================*/
+/* STM32 platform subset, OTG1 is the core model in otgsim.c.                */
+/*===========================================================================*/
+
+#define CH_DBG_ENABLE_CHECKS                TRUE
+
+#define STM32_USBH_USE_OTG1                 TRUE
+#define STM32_USBH_USE_OTG2                 FALSE
+#define STM32_OTG_STEPPING                  1
+#define STM32_OTG_FS_CHANNELS_NUMBER        8
+#define STM32_OTG_HS_CHANNELS_NUMBER        12
+#define STM32_OTG1_FIFO_MEM_SIZE            320
+#define STM32_OTG2_USE_ULPI                 FALSE
+#define STM32_OTG1_NUMBER                   67
+#define STM32_USB_OTG1_IRQ_PRIORITY         14
+#define STM32_OTG_FS_HANDLER                Vector14C
+#define STM32_USBH_CHANNELS_NP              4
+#define STM32_USBH_MIN_QSPACE               4
+
+/* The NAK budget is selected by the Makefile.*/
+#define STM32_USBH_USE_STATS                TRUE
+
+#define OSAL_IRQ_HANDLER(id)                void id(void)
+#define OSAL_IRQ_PROLOGUE()
+#define OSAL_IRQ_EPILOGUE()
+
+#define nvicEnableVector(n, prio)           ((void)(n), (void)(prio))
+#define nvicDisableVector(n)                ((void)(n))
+#define rccEnableOTG_FS(lp)                 ((void)(lp))
+#define rccDisableOTG_FS()
+#define rccResetOTG_FS()
+
+/* Polled waits let the core model finish resets and FIFO flushes.*/
+#define osalSysPolledDelayX(cycles)         otgsimPolledDelay(cycles)
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+  void otgsimPolledDelay(uint32_t cycles);
+  void Vector14C(void);
+#ifdef __cplusplus
+}
+#endif
+
+#include "hal_usbh.h"
+
+#endif /* HAL_H */
@@ -0,0 +1,187 @@
+/*
+    ChibiOS - Copyright (C) 2006..2018 Giovanni Di Sirio
+
+    Licensed under the Apache License, Version 2.0 (the "License");
+    you may not use this file except in compliance with the License.
+    You may obtain a copy of the License at
+
+        http://www.apache.org/licenses/LICENSE-2.0
+
+    Unless required by applicable law or agreed to in writing, software
+    distributed under the License is distributed on an "AS IS" BASIS,
+    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+    See the License for the specific language governing permissions and
+    limitations under the License.
+*/
+
+/*
+ * Interrupt load of the STM32 OTG host driver (ports/STM32/LLD/USBHv1)
+ * with an idle Bulk IN endpoint, over the OTG core model. Re-arming the
+ * channel on every NAK (STM32_USBH_NAK_BUDGET 0) costs an interrupt per
+ * IN token. With a budget the transfer is parked after its NAKs and
+ * retried from SOF, after a wait doubling up to STM32_USBH_NAK_MAX_BACKOFF
+ * frames; the SOF interrupt stays on while it is parked, at 1kHz at full
+ * speed and 8kHz at high speed. The interrupts per second are checked
+ * against those bounds at both speeds, then the latency of the packets of
+ * a mostly idle device.
+ */
+
+#include <string.h>
+
+#include "hal.h"
+#include "otgsim.h"
+#include "host_test.h"
+
+#define EP_IN                               1U
+
+/* SOFs per frame and per second.*/
+#define SOFS_PER_FRAME(hs)                  ((hs) ? 8U : 1U)
+#define SOFS_PER_S(hs)                      (1000U * SOFS_PER_FRAME(hs))
+
+/* A packet every DATA_PERIOD frames, DATA_PACKETS times.*/
+#define DATA_PERIOD                         25U
+#define DATA_PACKETS                        40U
+
+static usbh_ep_t ep;
+static usbh_urb_t urb;
+static USBH_DEFINE_BUFFER(uint8_t buf[512]);
+
+static unsigned completed;
+static uint64_t ready_at;
+static uint64_t worst_latency;
+
+static void urb_done(usbh_urb_t *urbp) {
+  uint64_t latency = otgsimNow() - ready_at;
+
+  completed++;
+  if (latency > worst_latency) {
+    worst_latency = latency;
+  }
+  if (urbp->status == USBH_URBSTATUS_OK) {
+    usbhURBObjectResetI(urbp);
+    usbhURBSubmitI(urbp);
+  }
+}
+
+/* Host started on the core model, a configured device on the root port
+   and a read pending on its Bulk IN endpoint.*/
+static void setup(bool hs) {
+  const usbh_endpoint_descriptor_t desc = {
+    7, USBH_DT_ENDPOINT, 0x80U | EP_IN, USBH_EPTYPE_BULK,
+    hs ? 512U : 64U, 0
+  };
+  usbh_device_t *const dev = &USBHD1.rootport.device;
+
+  otgsimInit(hs);
+  usbhInit();
+  usbhStart(&USBHD1);
+  otgsimPortEnable();
+
+  USBHD1.rootport.status = USBHD1.rootport.lld_status;
+  dev->address = 1U;
+  dev->speed = hs ? USBH_DEVSPEED_HIGH : USBH_DEVSPEED_FULL;
+  dev->status = USBH_DEVSTATUS_CONFIGURED;
+  usbhEPObjectInit(&ep, dev, &desc);
+  usbhEPOpen(&ep);
+  usbhURBObjectInit(&urb, &ep, urb_done, NULL, buf, desc.wMaxPacketSize);
+  usbhURBSubmit(&urb);
+
+  completed = 0U;
+  worst_latency = 0U;
+  memset(&USBHD1.stats, 0, sizeof(USBHD1.stats));
+  memset(&otgsim_stats, 0, sizeof(otgsim_stats));
+}
+
+/*===========================================================================*/
+/* Idle endpoint.                                                            */
+/*===========================================================================*/
+
+static void test_idle(bool hs) {
+  const stm32_usbh_stats_t *const stats = &USBHD1.stats;
+
+  setup(hs);
+  otgsimRun(SOFS_PER_S(hs));
+
+  HOST_CHECK(stats->isr == otgsim_stats.irqs, "%u ISRs, %u interrupts",
+             (unsigned)stats->isr, (unsigned)otgsim_stats.irqs);
+  HOST_CHECK(stats->nak == otgsim_stats.naks, "%u NAK interrupts, %u NAKs",
+             (unsigned)stats->nak, (unsigned)otgsim_stats.naks);
+  HOST_CHECK(completed == 0U, "%u transfers completed", completed);
+#if STM32_USBH_NAK_BUDGET == 0
+  HOST_CHECK(stats->nak_parked == 0U, "%u transfers parked",
+             (unsigned)stats->nak_parked);
+  HOST_CHECK(stats->sof == 0U, "SOF on, %u SOFs", (unsigned)stats->sof);
+  HOST_CHECK(otgsim_stats.irqs == otgsim_stats.naks,
+             "%u interrupts for %u NAKs", (unsigned)otgsim_stats.irqs,
+             (unsigned)otgsim_stats.naks);
+#else
+  /* Waits of 1, 2, 4... frames, then STM32_USBH_NAK_MAX_BACKOFF.*/
+  HOST_CHECK(stats->nak_parked <= 1000U / STM32_USBH_NAK_MAX_BACKOFF + 8U,
+             "%u transfers parked", (unsigned)stats->nak_parked);
+  HOST_CHECK(stats->nak_parked >= 1000U / STM32_USBH_NAK_MAX_BACKOFF,
+             "%u transfers parked", (unsigned)stats->nak_parked);
+  HOST_CHECK(stats->sof + 1U >= SOFS_PER_S(hs), "%u SOFs",
+             (unsigned)stats->sof);
+  /* Each retry: the budget, the NAK that halts and the channel halt.*/
+  HOST_CHECK(otgsim_stats.irqs <= stats->sof + (stats->nak_parked + 1U) *
+                                  (STM32_USBH_NAK_BUDGET + 2U),
+             "%u interrupts, %u SOFs, %u transfers parked",
+             (unsigned)otgsim_stats.irqs, (unsigned)stats->sof,
+             (unsigned)stats->nak_parked);
+#endif
+
+  if (host_bench) {
+    printf("  %s speed idle: %u interrupts/s, %u SOF, %u NAK, %u parked, "
+           "%u IN tokens\n", hs ? "high" : "full",
+           (unsigned)otgsim_stats.irqs, (unsigned)stats->sof,
+           (unsigned)stats->nak, (unsigned)stats->nak_parked,
+           (unsigned)otgsim_stats.transactions);
+  }
+}
+
+/*===========================================================================*/
+/* Mostly idle endpoint.                                                     */
+/*===========================================================================*/
+
+static void test_data(bool hs) {
+  const uint64_t bound = 1000U * (STM32_USBH_NAK_BUDGET > 0 ?
+                                  STM32_USBH_NAK_MAX_BACKOFF + 1U : 1U);
+  unsigned i;
+
+  setup(hs);
+  for (i = 0; i < DATA_PACKETS; i++) {
+    ready_at = otgsimNow();
+    otgsimQueue(EP_IN, 1U);
+    otgsimRun(DATA_PERIOD * SOFS_PER_FRAME(hs));
+  }
+
+  HOST_CHECK(completed == DATA_PACKETS, "%u of %u packets", completed,
+             DATA_PACKETS);
+  HOST_CHECK(worst_latency <= bound, "latency %uus, bound %uus",
+             (unsigned)worst_latency, (unsigned)bound);
+
+  if (host_bench) {
+    printf("  %s speed, a packet every %ums: %u interrupts/s, "
+           "worst latency %uus\n", hs ? "high" : "full", DATA_PERIOD,
+           (unsigned)(otgsim_stats.irqs * 1000U /
+                      (DATA_PERIOD * DATA_PACKETS)),
+           (unsigned)worst_latency);
+  }
+}
+
+int main(int argc, char *argv[]) {
+
+  hostInit(argc, argv);
+  chSysInit();
+  if (host_bench) {
+    printf("%s: NAK budget %u, backoff up to %u frames\n", argv[0],
+           STM32_USBH_NAK_BUDGET, STM32_USBH_NAK_MAX_BACKOFF);
+  }
+
+  test_idle(false);
+  test_idle(true);
+  test_data(false);
+  test_data(true);
+
+  return hostReport(argv[0]);
+}
@@ -0,0 +1,172 @@
+/*
+    ChibiOS - Copyright (C) 2006..2018 Giovanni Di Sirio
+
+    Licensed under the Apache License, Version 2.0 (the "License");
+    you may not use this file except in compliance with the License.
+    You may obtain a copy of the License at
+
+        http://www.apache.org/licenses/LICENSE-2.0
+
+    Unless required by applicable law or agreed to in writing, software
+    distributed under the License is distributed on an "AS IS" BASIS,
+    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+    See the License for the specific language governing permissions and
+    limitations under the License.
+*/
+
+#include <string.h>
+
+#include "hal.h"
+#include "otgsim.h"
+
+stm32_otg_t otgsim_core;
+otgsim_stats_t otgsim_stats;
+
+static struct {
+  bool                      hs;
+  uint32_t                  hprt;
+  uint32_t                  frame_us;
+  uint32_t                  xact_us;
+  uint64_t                  now;
+  uint32_t                  frnum;
+  unsigned                  next;
+  /* Packets queued by each endpoint of the device.*/
+  unsigned                  packets[16];
+} sim;
+
+/*===========================================================================*/
+/* Interrupts.                                                               */
+/*===========================================================================*/
+
+/* Raises core interrupts and serves them when unmasked. The status
+   registers are write 1 to clear, so they are set again afterwards.*/
+static void irq(uint32_t gintsts) {
+  stm32_otg_t *const otg = &otgsim_core;
+
+  otg->GINTSTS = GINTSTS_CMOD | gintsts;
+  if ((otg->GAHBCFG & GAHBCFG_GINTMSK) && (gintsts & otg->GINTMSK)) {
+    otgsim_stats.irqs++;
+    if (gintsts & GINTSTS_SOF) {
+      otgsim_stats.sofs++;
+    }
+    STM32_OTG_FS_HANDLER();
+  }
+  otg->GINTSTS = GINTSTS_CMOD;
+  otg->HAINT = 0U;
+  otg->HPRT = sim.hprt;
+}
+
+/*===========================================================================*/
+/* Channels.                                                                 */
+/*===========================================================================*/
+
+static int next_channel(void) {
+  unsigned i;
+
+  for (i = 0; i < STM32_OTG_FS_CHANNELS_NUMBER; i++) {
+    unsigned ch = (sim.next + i) % STM32_OTG_FS_CHANNELS_NUMBER;
+    if (otgsim_core.hc[ch].HCCHAR & HCCHAR_CHENA) {
+      sim.next = ch + 1U;
+      return (int)ch;
+    }
+  }
+  return -1;
+}
+
+/* One transaction of an enabled channel, or its halt. A queued packet is
+   sent zero length, it ends the transfer without RX FIFO traffic.*/
+static void transaction(unsigned ch) {
+  stm32_otg_t *const otg = &otgsim_core;
+  stm32_otg_host_chn_t *const hc = &otg->hc[ch];
+  uint32_t hcint;
+
+  if (hc->HCCHAR & HCCHAR_CHDIS) {
+    hc->HCCHAR &= ~(HCCHAR_CHENA | HCCHAR_CHDIS);
+    hcint = HCINT_CHH;
+  }
+  else {
+    unsigned ep = (hc->HCCHAR & HCCHAR_EPNUM_MASK) >> 11;
+
+    hc->HCCHAR &= ~HCCHAR_CHENA;
+    otgsim_stats.transactions++;
+    if (sim.packets[ep] > 0U) {
+      sim.packets[ep]--;
+      hc->HCTSIZ = (hc->HCTSIZ ^ HCTSIZ_DPID_DATA1) - HCTSIZ_PKTCNT(1U);
+      hcint = HCINT_XFRC | HCINT_ACK;
+    }
+    else {
+      otgsim_stats.naks++;
+      hcint = HCINT_NAK;
+    }
+  }
+
+  hc->HCINT = hcint;
+  if ((hcint & hc->HCINTMSK) && (otg->HAINTMSK & (1U << ch))) {
+    otg->HAINT = 1U << ch;
+    irq(GINTSTS_HCINT);
+  }
+}
+
+/*===========================================================================*/
+/* Interface.                                                                */
+/*===========================================================================*/
+
+void otgsimPolledDelay(uint32_t cycles) {
+
+  (void)cycles;
+  otgsim_core.GRSTCTL = GRSTCTL_AHBIDL;
+}
+
+void otgsimInit(bool hs) {
+  stm32_otg_t *const otg = &otgsim_core;
+
+  memset(otg, 0, sizeof(*otg));
+  memset(&sim, 0, sizeof(sim));
+  memset(&otgsim_stats, 0, sizeof(otgsim_stats));
+  sim.hs = hs;
+  sim.frame_us = hs ? OTGSIM_HS_FRAME_US : OTGSIM_FS_FRAME_US;
+  sim.xact_us = hs ? OTGSIM_HS_XACT_US : OTGSIM_FS_XACT_US;
+  otg->GRSTCTL = GRSTCTL_AHBIDL;
+  otg->GINTSTS = GINTSTS_CMOD;
+  otg->HNPTXSTS = (8U << 16) | 0x80U;
+  otg->HPTXSTS = (8U << 16) | 0x80U;
+}
+
+void otgsimPortEnable(void) {
+
+  sim.hprt = HPRT_PPWR | HPRT_PCSTS | HPRT_PENA |
+             (sim.hs ? HPRT_PSPD_HS : HPRT_PSPD_FS);
+  otgsim_core.HPRT = sim.hprt | HPRT_PCDET | HPRT_PENCHNG;
+  irq(GINTSTS_HPRTINT);
+}
+
+/* Runs the bus for a number of (micro)frames.*/
+void otgsimRun(uint32_t sofs) {
+  stm32_otg_t *const otg = &otgsim_core;
+
+  while (sofs-- > 0U) {
+    uint64_t end = sim.now + sim.frame_us;
+    int ch;
+
+    sim.frnum = (sim.frnum + 1U) & 0x3FFFU;
+    otg->HFNUM = sim.frnum;
+    otgsim_stats.frames++;
+    irq(GINTSTS_SOF);
+
+    while ((sim.now + sim.xact_us <= end) && ((ch = next_channel()) >= 0)) {
+      sim.now += sim.xact_us;
+      transaction((unsigned)ch);
+    }
+    sim.now = end;
+  }
+}
+
+void otgsimQueue(uint8_t ep, unsigned packets) {
+
+  sim.packets[ep] += packets;
+}
+
+uint64_t otgsimNow(void) {
+
+  return sim.now;
+}
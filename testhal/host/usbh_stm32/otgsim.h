@@ -0,0 +1,64 @@
+/*
+    ChibiOS - Copyright (C) 2006..2018 Giovanni Di Sirio
+
+    Licensed under the Apache License, Version 2.0 (the "License");
+    you may not use this file except in compliance with the License.
+    You may obtain a copy of the License at
+
+        http://www.apache.org/licenses/LICENSE-2.0
+
+    Unless required by applicable law or agreed to in writing, software
+    distributed under the License is distributed on an "AS IS" BASIS,
+    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+    See the License for the specific language governing permissions and
+    limitations under the License.
+*/
+
+/*
+ * Model of the host side of the STM32 OTG core, driving the USBHv1 driver
+ * through its register file: frames and SOFs, channel halts and Bulk IN
+ * endpoints of one device that NAK every IN token until the test queues a
+ * packet. Each transaction takes a fixed bus time, in which the interrupt
+ * is served; the ISR runs synchronously, from the main thread.
+ */
+
+#ifndef OTGSIM_H
+#define OTGSIM_H
+
+/* Full speed frame and high speed microframe, in microseconds.*/
+#define OTGSIM_FS_FRAME_US                  1000U
+#define OTGSIM_HS_FRAME_US                  125U
+
+/* IN token, NAK handshake and the ISR re-arming the channel.*/
+#define OTGSIM_FS_XACT_US                   8U
+#define OTGSIM_HS_XACT_US                   2U
+
+/**
+ * @brief   Core model counters.
+ */
+typedef struct {
+  /* SOFs sent, masked or not.*/
+  uint32_t                  frames;
+  /* Interrupts taken, SOF interrupts among them.*/
+  uint32_t                  irqs;
+  uint32_t                  sofs;
+  /* IN tokens sent and NAKed.*/
+  uint32_t                  transactions;
+  uint32_t                  naks;
+} otgsim_stats_t;
+
+extern otgsim_stats_t otgsim_stats;
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+  void otgsimInit(bool hs);
+  void otgsimPortEnable(void);
+  void otgsimRun(uint32_t sofs);
+  void otgsimQueue(uint8_t ep, unsigned packets);
+  uint64_t otgsimNow(void);
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* OTGSIM_H */
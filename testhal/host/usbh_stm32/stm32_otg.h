@@ -0,0 +1,204 @@
+/*
+    ChibiOS - Copyright (C) 2006..2018 Giovanni Di Sirio
+
+    Licensed under the Apache License, Version 2.0 (the "License");
+    you may not use this file except in compliance with the License.
+    You may obtain a copy of the License at
+
+        http://www.apache.org/licenses/LICENSE-2.0
+
+    Unless required by applicable law or agreed to in writing, software
+    distributed under the License is distributed on an "AS IS" BASIS,
+    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+    See the License for the specific language governing permissions and
+    limitations under the License.
+*/
+
+/*
+ * Host side of the STM32 OTG register map, as used by the USBHv1 driver.
+ * OTG_FS is the register file of the core model in otgsim.c.
+ */
+
+#ifndef STM32_OTG_H
+#define STM32_OTG_H
+
+#define STM32_OTG_FIFO_MEM_SIZE             1024U
+
+/**
+ * @brief   Host channel registers.
+ */
+typedef struct {
+  volatile uint32_t         HCCHAR;
+  volatile uint32_t         HCSPLT;
+  volatile uint32_t         HCINT;
+  volatile uint32_t         HCINTMSK;
+  volatile uint32_t         HCTSIZ;
+  volatile uint32_t         HCDMA;
+  volatile uint32_t         resvd18;
+  volatile uint32_t         resvd1c;
+} stm32_otg_host_chn_t;
+
+/**
+ * @brief   OTG registers, the device mode block is left reserved.
+ */
+typedef struct {
+  volatile uint32_t         GOTGCTL;
+  volatile uint32_t         GOTGINT;
+  volatile uint32_t         GAHBCFG;
+  volatile uint32_t         GUSBCFG;
+  volatile uint32_t         GRSTCTL;
+  volatile uint32_t         GINTSTS;
+  volatile uint32_t         GINTMSK;
+  volatile uint32_t         GRXSTSR;
+  volatile uint32_t         GRXSTSP;
+  volatile uint32_t         GRXFSIZ;
+  volatile uint32_t         DIEPTXF0;
+  volatile uint32_t         HNPTXSTS;
+  volatile uint32_t         resvd30[2];
+  volatile uint32_t         GCCFG;
+  volatile uint32_t         CID;
+  volatile uint32_t         resvd40[48];
+  volatile uint32_t         HPTXFSIZ;
+  volatile uint32_t         DIEPTXF[15];
+  volatile uint32_t         resvd140[176];
+  volatile uint32_t         HCFG;
+  volatile uint32_t         HFIR;
+  volatile uint32_t         HFNUM;
+  volatile uint32_t         resvd40c;
+  volatile uint32_t         HPTXSTS;
+  volatile uint32_t         HAINT;
+  volatile uint32_t         HAINTMSK;
+  volatile uint32_t         resvd41c[9];
+  volatile uint32_t         HPRT;
+  volatile uint32_t         resvd444[47];
+  stm32_otg_host_chn_t      hc[16];
+  volatile uint32_t         resvd700[448];
+  volatile uint32_t         PCGCCTL;
+  volatile uint32_t         resvde04[127];
+  volatile uint32_t         FIFO[16][STM32_OTG_FIFO_MEM_SIZE];
+} stm32_otg_t;
+
+#define GAHBCFG_GINTMSK                     (1U << 0)
+
+#define GUSBCFG_FHMOD                       (1U << 29)
+#define GUSBCFG_TRDT(n)                     ((n) << 10)
+#define GUSBCFG_HNPCAP                      (1U << 9)
+#define GUSBCFG_SRPCAP                      (1U << 8)
+#define GUSBCFG_PHYSEL                      (1U << 6)
+
+#define GRSTCTL_AHBIDL                      (1U << 31)
+#define GRSTCTL_TXFNUM(n)                   ((n) << 6)
+#define GRSTCTL_TXFFLSH                     (1U << 5)
+#define GRSTCTL_RXFFLSH                     (1U << 4)
+#define GRSTCTL_CSRST                       (1U << 0)
+
+#define GINTSTS_DISCINT                     (1U << 29)
+#define GINTSTS_PTXFE                       (1U << 26)
+#define GINTSTS_HCINT                       (1U << 25)
+#define GINTSTS_HPRTINT                     (1U << 24)
+#define GINTSTS_IPXFR                       (1U << 21)
+#define GINTSTS_NPTXFE                      (1U << 5)
+#define GINTSTS_RXFLVL                      (1U << 4)
+#define GINTSTS_SOF                         (1U << 3)
+#define GINTSTS_MMIS                        (1U << 1)
+#define GINTSTS_CMOD                        (1U << 0)
+
+#define GINTMSK_DISCM                       (1U << 29)
+#define GINTMSK_PTXFEM                      (1U << 26)
+#define GINTMSK_HCM                         (1U << 25)
+#define GINTMSK_HPRTM                       (1U << 24)
+#define GINTMSK_NPTXFEM                     (1U << 5)
+#define GINTMSK_RXFLVLM                     (1U << 4)
+#define GINTMSK_SOFM                        (1U << 3)
+#define GINTMSK_MMISM                       (1U << 1)
+
+#define GRXSTSP_PKTSTS_MASK                 (15U << 17)
+#define GRXSTSP_PKTSTS(n)                   ((n) << 17)
+#define GRXSTSP_BCNT_MASK                   (0x7FFU << 4)
+#define GRXSTSP_BCNT_OFF                    4
+#define GRXSTSP_CHNUM_MASK                  (15U << 0)
+
+#define GRXFSIZ_RXFD(n)                     ((n) << 0)
+
+#define HPTXFSIZ_PTXFD(n)                   ((n) << 16)
+#define HPTXFSIZ_PTXSA(n)                   ((n) << 0)
+
+#define HPTXSTS_PTXQSAV_MASK                (0xFFU << 16)
+#define HPTXSTS_PTXFSAVL_MASK               (0xFFFFU << 0)
+
+#define GCCFG_NOVBUSSENS                    (1U << 21)
+#define GCCFG_VBDEN                         (1U << 21)
+#define GCCFG_PWRDWN                        (1U << 16)
+
+#define HCFG_FSLSS                          (1U << 2)
+#define HCFG_FSLSPCS_MASK                   (3U << 0)
+#define HCFG_FSLSPCS_48                     (1U << 0)
+#define HCFG_FSLSPCS_6                      (2U << 0)
+
+#define HPRT_PSPD_MASK                      (3U << 17)
+#define HPRT_PSPD_HS                        (0U << 17)
+#define HPRT_PSPD_FS                        (1U << 17)
+#define HPRT_PSPD_LS                        (2U << 17)
+#define HPRT_PPWR                           (1U << 12)
+#define HPRT_PLSTS_MASK                     (3U << 11)
+#define HPRT_PLSTS_DM                       (1U << 11)
+#define HPRT_PLSTS_DP                       (1U << 10)
+#define HPRT_PRST                           (1U << 8)
+#define HPRT_PSUSP                          (1U << 7)
+#define HPRT_PRES                           (1U << 6)
+#define HPRT_POCCHNG                        (1U << 5)
+#define HPRT_POCA                           (1U << 4)
+#define HPRT_PENCHNG                        (1U << 3)
+#define HPRT_PENA                           (1U << 2)
+#define HPRT_PCDET                          (1U << 1)
+#define HPRT_PCSTS                          (1U << 0)
+
+#define HCCHAR_CHENA                        (1U << 31)
+#define HCCHAR_CHDIS                        (1U << 30)
+#define HCCHAR_ODDFRM                       (1U << 29)
+#define HCCHAR_DAD(n)                       ((n) << 22)
+#define HCCHAR_MCNT(n)                      ((n) << 20)
+#define HCCHAR_EPTYP(n)                     ((n) << 18)
+#define HCCHAR_LSDEV                        (1U << 17)
+#define HCCHAR_EPDIR                        (1U << 15)
+#define HCCHAR_EPNUM_MASK                   (15U << 11)
+#define HCCHAR_EPNUM(n)                     ((n) << 11)
+#define HCCHAR_MPS(n)                       ((n) << 0)
+
+#define HCINT_DTERR                         (1U << 10)
+#define HCINT_FRMOR                         (1U << 9)
+#define HCINT_BBERR                         (1U << 8)
+#define HCINT_TRERR                         (1U << 7)
+#define HCINT_ACK                           (1U << 5)
+#define HCINT_NAK                           (1U << 4)
+#define HCINT_STALL                         (1U << 3)
+#define HCINT_AHBERR                        (1U << 2)
+#define HCINT_CHH                           (1U << 1)
+#define HCINT_XFRC                          (1U << 0)
+
+#define HCINTMSK_DTERRM                     (1U << 10)
+#define HCINTMSK_FRMORM                     (1U << 9)
+#define HCINTMSK_BBERRM                     (1U << 8)
+#define HCINTMSK_TRERRM                     (1U << 7)
+#define HCINTMSK_ACKM                       (1U << 5)
+#define HCINTMSK_NAKM                       (1U << 4)
+#define HCINTMSK_STALLM                     (1U << 3)
+#define HCINTMSK_AHBERRM                    (1U << 2)
+#define HCINTMSK_CHHM                       (1U << 1)
+#define HCINTMSK_XFRCM                      (1U << 0)
+
+#define HCTSIZ_DPID_MASK                    (3U << 29)
+#define HCTSIZ_DPID_DATA0                   (0U << 29)
+#define HCTSIZ_DPID_DATA2                   (1U << 29)
+#define HCTSIZ_DPID_DATA1                   (2U << 29)
+#define HCTSIZ_DPID_SETUP                   (3U << 29)
+#define HCTSIZ_PKTCNT_MASK                  (0x3FFU << 19)
+#define HCTSIZ_PKTCNT(n)                    ((n) << 19)
+#define HCTSIZ_XFRSIZ_MASK                  (0x7FFFFU << 0)
+#define HCTSIZ_XFRSIZ(n)                    ((n) << 0)
+
+extern stm32_otg_t otgsim_core;
+
+#define OTG_FS                              (&otgsim_core)
+
+#endif /* STM32_OTG_H */
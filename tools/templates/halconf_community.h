@@ -127,6 +127,23 @@
 #define NAND_USE_MUTUAL_EXCLUSION   TRUE
 #endif
 
+/**
+ * @brief   Enables the on-flash bad block table.
+ * @warning The table takes the last @p NAND_BBT_BLOCKS blocks of the device
+ *          and erases them when it is created. @p nandStart() refuses to
+ *          create it over programmed pages that are not table pages.
+ */
+#if !defined(NAND_USE_BBT) || defined(__DOXYGEN__)
+#define NAND_USE_BBT                FALSE
+#endif
+
+/**
+ * @brief   Number of blocks reserved for the bad block table.
+ */
+#if !defined(NAND_BBT_BLOCKS) || defined(__DOXYGEN__)
+#define NAND_BBT_BLOCKS             4
+#endif
+
 /*===========================================================================*/
 /* 1-wire driver related settings.                                           */
 /*===========================================================================*/
@@ -127,6 +127,10 @@
 #define CRCSW_CRC32_TABLE                   TRUE
 #define CRCSW_CRC16_TABLE                   TRUE
 #define CRCSW_PROGRAMMABLE                  TRUE
+#define CRCSW_SLICE_BY                      1
+#define CRCSW_PROGRAMMABLE_TABLE            TRUE
+#define CRCSW_TABLE_SETS                    1
+#define CRCSW_PRESETS                       FALSE
 
 /*
  * EICU driver system settings.